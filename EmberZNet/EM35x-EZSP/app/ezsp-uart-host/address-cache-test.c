@@ -0,0 +1,575 @@
+/** @file address-cache-test.c
+ *  @brief Checks the host address cache against a simulated NCP
+ *
+ * Runs ezsp.c against a simulated NCP, in place of the serial protocol, that
+ * knows the node id and EUI64 of every device in a network and answers the
+ * commands that look one up from the other.  A random mix of events is
+ * reported with callbacks as the NCP does: children and trust center joins,
+ * messages with and without the sender's EUI64, devices rejoining with a
+ * new id and announcing it, ZDO address responses, id conflicts and the
+ * network going down.  After each event devices are looked up both ways
+ * and the answers must match the network, whether they come from the cache
+ * or the NCP.  A gateway that looks up the EUI64 of the sender of each
+ * message it receives, and the node id of each device it sends to, is then
+ * run, with most of the traffic to and from a small part of the network,
+ * and the commands it sends counted with and without the cache.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack/include/ember-types.h"
+#include "stack/include/error.h"
+#include "app/util/ezsp/ezsp-protocol.h"
+#include "app/util/ezsp/ezsp.h"
+#include "app/util/ezsp/serial-interface.h"
+#include "app/util/ezsp/ezsp-frame-utilities.h"
+#include "app/util/ezsp/ezsp-host-configuration-defaults.h"
+
+#define DEVICE_COUNT        1000
+#define BUSY_DEVICE_COUNT   100
+#define OPERATION_COUNT     20000
+#define MESSAGE_COUNT       100000
+#define CALLBACK_QUEUE_SIZE 4
+
+//------------------------------------------------------------------------------
+// The simulated NCP.
+
+static int8u ezspFrameLength;
+int8u *ezspFrameLengthLocation = &ezspFrameLength;
+static int8u ezspFrameContentsStorage[EZSP_MAX_FRAME_LENGTH];
+int8u *ezspFrameContents = ezspFrameContentsStorage;
+
+typedef struct {
+  int8u length;
+  int8u contents[EZSP_MAX_FRAME_LENGTH];
+} Frame;
+
+typedef struct {
+  EmberNodeId id;
+  EmberEUI64 eui64;
+} Device;
+
+static Device devices[DEVICE_COUNT];
+
+static Frame response;
+static boolean responseIsWaiting = FALSE;
+static Frame callbacks[CALLBACK_QUEUE_SIZE];
+static int8u callbackCount = 0;
+static int32u commandCount = 0;
+static int8u zdoSequence = 0;
+
+int32u halCommonGetInt32uMillisecondTick(void)
+{
+  return 0;
+}
+
+static Device *findDeviceById(EmberNodeId id)
+{
+  int16u i;
+  for (i = 0; i < DEVICE_COUNT; i++) {
+    if (devices[i].id == id) {
+      return &devices[i];
+    }
+  }
+  return NULL;
+}
+
+static Device *findDeviceByEui64(EmberEUI64 eui64)
+{
+  int16u i;
+  for (i = 0; i < DEVICE_COUNT; i++) {
+    if (MEMCOMPARE(devices[i].eui64, eui64, EUI64_SIZE) == 0) {
+      return &devices[i];
+    }
+  }
+  return NULL;
+}
+
+EzspStatus serialSendCommand(void)
+{
+  int8u frameId = serialGetResponseByte(EZSP_FRAME_ID_INDEX);
+  EmberEUI64 eui64;
+  Device *device;
+
+  commandCount++;
+  ezspReadPointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+  ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+
+  switch (frameId) {
+  case EZSP_LOOKUP_EUI64_BY_NODE_ID:
+    device = findDeviceById(fetchInt16u());
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    if (device == NULL) {
+      MEMSET(eui64, 0, EUI64_SIZE);
+      appendInt8u(EMBER_ERR_FATAL);
+      appendInt8uArray(EUI64_SIZE, eui64);
+    } else {
+      appendInt8u(EMBER_SUCCESS);
+      appendInt8uArray(EUI64_SIZE, device->eui64);
+    }
+    break;
+  case EZSP_LOOKUP_NODE_ID_BY_EUI64:
+    fetchInt8uArray(EUI64_SIZE, eui64);
+    device = findDeviceByEui64(eui64);
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    appendInt16u(device == NULL ? EMBER_NULL_NODE_ID : device->id);
+    break;
+  default:
+    printf("Unexpected command 0x%02X\n", frameId);
+    exit(1);
+  }
+
+  serialSetCommandByte(EZSP_FRAME_CONTROL_INDEX, EZSP_FRAME_CONTROL_RESPONSE);
+  serialSetCommandLength(ezspWritePointer - ezspFrameContents);
+  response.length = ezspFrameLength;
+  MEMCOPY(response.contents, ezspFrameContents, ezspFrameLength);
+  responseIsWaiting = TRUE;
+  return EZSP_SUCCESS;
+}
+
+// Callbacks are only delivered when there is no response waiting, as the
+// uart serial protocol does.
+EzspStatus serialResponseReceived(void)
+{
+  Frame *frame;
+  int8u i;
+
+  if (responseIsWaiting) {
+    frame = &response;
+    responseIsWaiting = FALSE;
+  } else if (callbackCount > 0) {
+    frame = &callbacks[0];
+  } else {
+    return EZSP_ASH_NO_RX_DATA;
+  }
+  MEMCOPY(ezspFrameContents, frame->contents, frame->length);
+  serialSetCommandLength(frame->length);
+  if (frame == &callbacks[0]) {
+    callbackCount--;
+    for (i = 0; i < callbackCount; i++) {
+      callbacks[i] = callbacks[i + 1];
+    }
+  }
+  return EZSP_SUCCESS;
+}
+
+int8u serialPendingResponseCount(void)
+{
+  return callbackCount;
+}
+
+// Callbacks are built in ezspFrameContents and then set aside.
+static void startCallback(int8u frameId)
+{
+  serialSetCommandByte(EZSP_SEQUENCE_INDEX, 0);
+  serialSetCommandByte(EZSP_FRAME_CONTROL_INDEX, EZSP_FRAME_CONTROL_RESPONSE);
+  serialSetCommandByte(EZSP_FRAME_ID_INDEX, frameId);
+  ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+}
+
+static void queueCallback(void)
+{
+  Frame *callback;
+  if (callbackCount == CALLBACK_QUEUE_SIZE) {
+    printf("Too many callbacks queued\n");
+    exit(1);
+  }
+  callback = &callbacks[callbackCount++];
+  callback->length = ezspWritePointer - ezspFrameContents;
+  MEMCOPY(callback->contents, ezspFrameContents, callback->length);
+}
+
+//------------------------------------------------------------------------------
+
+void ezspErrorHandler(EzspStatus status)
+{
+  printf("EZSP error 0x%02X\n", status);
+  exit(1);
+}
+
+// EZSP callback function stubs
+
+void ezspTimerHandler(int8u timerId)
+{}
+
+void ezspStackStatusHandler(EmberStatus status)
+{}
+
+void ezspNetworkFoundHandler(EmberZigbeeNetwork *networkFound,
+                             int8u lastHopLqi,
+                             int8s lastHopRssi)
+{}
+
+void ezspScanCompleteHandler(int8u channel, EmberStatus status)
+{}
+
+void ezspMessageSentHandler(EmberOutgoingMessageType type,
+                            int16u indexOrDestination,
+                            EmberApsFrame *apsFrame,
+                            int8u messageTag,
+                            EmberStatus status,
+                            int8u messageLength,
+                            int8u *messageContents)
+{}
+
+void ezspIncomingMessageHandler(EmberIncomingMessageType type,
+                                EmberApsFrame *apsFrame,
+                                int8u lastHopLqi,
+                                int8s lastHopRssi,
+                                EmberNodeId sender,
+                                int8u bindingIndex,
+                                int8u addressIndex,
+                                int8u messageLength,
+                                int8u *messageContents)
+{}
+
+void simulatedTimePasses(void)
+{}
+
+void ashTraceEzspVerbose(char *format, ...)
+{}
+
+//------------------------------------------------------------------------------
+// Events in the network.
+
+static void randomEui64(EmberEUI64 eui64)
+{
+  int8u i;
+  for (i = 0; i < EUI64_SIZE; i++) {
+    eui64[i] = rand();
+  }
+}
+
+// Returns an id that no device has.
+static EmberNodeId unusedId(void)
+{
+  EmberNodeId id;
+  do {
+    id = rand() % 0xFFF8;
+  } while (id == 0x0000 || findDeviceById(id) != NULL);
+  return id;
+}
+
+static Device *randomDevice(void)
+{
+  return &devices[rand() % DEVICE_COUNT];
+}
+
+// Most of the traffic is to and from the busy devices.
+static Device *busyDevice(void)
+{
+  return (rand() % 10 == 0
+          ? randomDevice()
+          : &devices[rand() % BUSY_DEVICE_COUNT]);
+}
+
+static void queueIncomingMessage(EmberNodeId sender,
+                                 int16u profileId,
+                                 int16u clusterId,
+                                 int8u messageLength,
+                                 int8u *messageContents)
+{
+  EmberApsFrame apsFrame;
+  MEMSET(&apsFrame, 0, sizeof(apsFrame));
+  apsFrame.profileId = profileId;
+  apsFrame.clusterId = clusterId;
+  startCallback(EZSP_INCOMING_MESSAGE_HANDLER);
+  appendInt8u(EMBER_INCOMING_UNICAST);
+  appendEmberApsFrame(&apsFrame);
+  appendInt8u(0xFF);
+  appendInt8u(-40);
+  appendInt16u(sender);
+  appendInt8u(0xFF);
+  appendInt8u(0xFF);
+  appendInt8u(messageLength);
+  appendInt8uArray(messageLength, messageContents);
+  queueCallback();
+}
+
+static void messageArrives(Device *device, boolean withEui64)
+{
+  int8u payload[3];
+  if (withEui64) {
+    startCallback(EZSP_INCOMING_SENDER_EUI64_HANDLER);
+    appendInt8uArray(EUI64_SIZE, device->eui64);
+    queueCallback();
+  }
+  payload[0] = 0x00;
+  payload[1] = zdoSequence;
+  payload[2] = 0x0A;
+  queueIncomingMessage(device->id, 0x0104, 0x0006, sizeof(payload), payload);
+}
+
+// <sequence:1> <node id:2> <EUI64:8> <capabilities:1>
+static void deviceAnnounces(Device *device)
+{
+  int8u payload[12];
+  payload[0] = zdoSequence++;
+  payload[1] = LOW_BYTE(device->id);
+  payload[2] = HIGH_BYTE(device->id);
+  MEMCOPY(payload + 3, device->eui64, EUI64_SIZE);
+  payload[11] = 0x80;
+  queueIncomingMessage(device->id,
+                       EMBER_ZDO_PROFILE_ID,
+                       END_DEVICE_ANNOUNCE,
+                       sizeof(payload),
+                       payload);
+}
+
+// <sequence:1> <status:1> <EUI64:8> <node id:2>
+static void addressResponseArrives(Device *device, boolean success)
+{
+  int8u payload[12];
+  payload[0] = zdoSequence++;
+  payload[1] = (success ? EMBER_ZDP_SUCCESS : EMBER_ZDP_DEVICE_NOT_FOUND);
+  MEMCOPY(payload + 2, device->eui64, EUI64_SIZE);
+  payload[10] = LOW_BYTE(device->id);
+  payload[11] = HIGH_BYTE(device->id);
+  queueIncomingMessage(device->id,
+                       EMBER_ZDO_PROFILE_ID,
+                       (rand() % 2 == 0
+                        ? NETWORK_ADDRESS_RESPONSE
+                        : IEEE_ADDRESS_RESPONSE),
+                       sizeof(payload),
+                       payload);
+}
+
+static void childJoins(Device *device)
+{
+  startCallback(EZSP_CHILD_JOIN_HANDLER);
+  appendInt8u(0);
+  appendInt8u(TRUE);
+  appendInt16u(device->id);
+  appendInt8uArray(EUI64_SIZE, device->eui64);
+  appendInt8u(EMBER_SLEEPY_END_DEVICE);
+  queueCallback();
+}
+
+static void trustCenterJoins(Device *device, EmberDeviceUpdate status)
+{
+  startCallback(EZSP_TRUST_CENTER_JOIN_HANDLER);
+  appendInt16u(device->id);
+  appendInt8uArray(EUI64_SIZE, device->eui64);
+  appendInt8u(status);
+  appendInt8u(EMBER_USE_PRECONFIGURED_KEY);
+  appendInt16u(0x0000);
+  queueCallback();
+}
+
+// A device rejoins with a new id and tells the network.
+static void deviceRejoins(void)
+{
+  Device *device = busyDevice();
+  device->id = unusedId();
+  if (rand() % 2 == 0) {
+    trustCenterJoins(device, EMBER_STANDARD_SECURITY_SECURED_REJOIN);
+  } else {
+    childJoins(device);
+  }
+  deviceAnnounces(device);
+}
+
+// A device is replaced by a new one that takes over its id.
+static void deviceReplaced(void)
+{
+  Device *device = busyDevice();
+  randomEui64(device->eui64);
+  trustCenterJoins(device, EMBER_STANDARD_SECURITY_UNSECURED_JOIN);
+}
+
+// Two devices end up with the same id.  The one whose message is heard is
+// then briefly cached with it, until the NCP reports the conflict and both
+// devices choose new ids and announce them.
+static void idConflict(void)
+{
+  Device *first = busyDevice();
+  Device *second = randomDevice();
+  if (first == second) {
+    return;
+  }
+  second->id = first->id;
+  messageArrives(second, TRUE);
+  ezspTick();
+  startCallback(EZSP_ID_CONFLICT_HANDLER);
+  appendInt16u(first->id);
+  queueCallback();
+  ezspTick();
+  first->id = unusedId();
+  second->id = unusedId();
+  deviceAnnounces(first);
+  deviceAnnounces(second);
+}
+
+static void networkGoesDown(void)
+{
+  startCallback(EZSP_STACK_STATUS_HANDLER);
+  appendInt8u(EMBER_NETWORK_DOWN);
+  queueCallback();
+  ezspTick();
+  startCallback(EZSP_STACK_STATUS_HANDLER);
+  appendInt8u(EMBER_NETWORK_UP);
+  queueCallback();
+}
+
+static void makeChange(void)
+{
+  int8u choice = rand() % 100;
+  if (choice < 40) {
+    messageArrives(busyDevice(), rand() % 2 == 0);
+  } else if (choice < 55) {
+    deviceRejoins();
+  } else if (choice < 65) {
+    addressResponseArrives(randomDevice(), rand() % 4 != 0);
+  } else if (choice < 75) {
+    childJoins(randomDevice());
+  } else if (choice < 85) {
+    trustCenterJoins(randomDevice(), EMBER_STANDARD_SECURITY_SECURED_REJOIN);
+  } else if (choice < 90) {
+    deviceReplaced();
+  } else if (choice < 97) {
+    idConflict();
+  } else if (choice < 98) {
+    networkGoesDown();
+  } else {
+    ezspAddressCacheAdd(randomDevice()->id, randomDevice()->eui64);
+    ezspAddressCacheClear();
+  }
+  ezspTick();
+}
+
+//------------------------------------------------------------------------------
+// Checks
+
+static boolean checkDevice(int32u operation, Device *device)
+{
+  EmberEUI64 eui64;
+  EmberNodeId id;
+
+  if (emberLookupEui64ByNodeId(device->id, eui64) != EMBER_SUCCESS
+      || MEMCOMPARE(eui64, device->eui64, EUI64_SIZE) != 0) {
+    printf("After operation %ld, the EUI64 of 0x%04X is wrong\n",
+           (long)operation, device->id);
+    return FALSE;
+  }
+  id = emberLookupNodeIdByEui64(device->eui64);
+  if (id != device->id) {
+    printf("After operation %ld, the id of 0x%04X is 0x%04X\n",
+           (long)operation, device->id, id);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+// Ids and EUI64s that no device has must not be found.
+static boolean checkStranger(int32u operation)
+{
+  EmberEUI64 eui64;
+  EmberNodeId id = unusedId();
+
+  if (emberLookupEui64ByNodeId(id, eui64) == EMBER_SUCCESS) {
+    printf("After operation %ld, unused id 0x%04X was found\n",
+           (long)operation, id);
+    return FALSE;
+  }
+  randomEui64(eui64);
+  if (findDeviceByEui64(eui64) == NULL
+      && emberLookupNodeIdByEui64(eui64) != EMBER_NULL_NODE_ID) {
+    printf("After operation %ld, an unknown EUI64 was found\n",
+           (long)operation);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean checkChanges(void)
+{
+  int32u i;
+  int16u d;
+
+  for (i = 0; i < OPERATION_COUNT; i++) {
+    makeChange();
+    if (!checkDevice(i, busyDevice())
+        || !checkDevice(i, randomDevice())
+        || !checkStranger(i)) {
+      return FALSE;
+    }
+    if (i % 1000 == 0) {
+      for (d = 0; d < DEVICE_COUNT; d++) {
+        if (!checkDevice(i, &devices[d])) {
+          return FALSE;
+        }
+      }
+    }
+  }
+  printf("The cache agrees with the network after %d changes\n",
+         OPERATION_COUNT);
+  return TRUE;
+}
+
+//------------------------------------------------------------------------------
+// A gateway that reports each message it receives by the sender's EUI64 and
+// sends to devices by EUI64.
+
+static int32u gateway(boolean cached)
+{
+  int32u commands = commandCount;
+  EmberEUI64 eui64;
+  Device *device;
+  int32u i;
+
+  srand(2);
+  ezspAddressCacheClear();
+  for (i = 0; i < MESSAGE_COUNT; i++) {
+    device = busyDevice();
+    if (i % 2 == 0) {
+      messageArrives(device, FALSE);
+      ezspTick();
+      if (cached) {
+        emberLookupEui64ByNodeId(device->id, eui64);
+      } else {
+        ezspLookupEui64ByNodeId(device->id, eui64);
+      }
+    } else if (cached) {
+      emberLookupNodeIdByEui64(device->eui64);
+    } else {
+      ezspLookupNodeIdByEui64(device->eui64);
+    }
+    if (i % 500 == 0) {
+      deviceRejoins();
+      ezspTick();
+    }
+  }
+  return commandCount - commands;
+}
+
+int main(int argc, char *argv[])
+{
+  int32u rawCommands, cachedCommands;
+  int32u saved;
+  int16u i;
+
+  srand(1);
+  for (i = 0; i < DEVICE_COUNT; i++) {
+    devices[i].id = unusedId();
+    randomEui64(devices[i].eui64);
+  }
+  if (!checkChanges()) {
+    return 1;
+  }
+
+  rawCommands = gateway(FALSE);
+  saved = ezspAddressCacheSavedCommands();
+  cachedCommands = gateway(TRUE);
+  saved = ezspAddressCacheSavedCommands() - saved;
+  printf("%d lookups, %d devices, %d busy, %d cache entries:\n",
+         MESSAGE_COUNT, DEVICE_COUNT, BUSY_DEVICE_COUNT,
+         EZSP_HOST_ADDRESS_CACHE_SIZE);
+  printf("commands: %8ld commands\n", (long)rawCommands);
+  printf("cache:    %8ld commands  %8ld saved\n",
+         (long)cachedCommands, (long)saved);
+  return 0;
+}
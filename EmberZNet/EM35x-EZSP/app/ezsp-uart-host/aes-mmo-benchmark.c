@@ -0,0 +1,380 @@
+/** @file aes-mmo-benchmark.c
+ *  @brief Checks and times the host AES-MMO hash
+ *
+ * Hashes the test vectors from annex C.5 of the ZigBee specification, and
+ * messages on either side of the change to the 32-bit length padding at
+ * 8192 bytes, with emberAesMmoHashUpdate() and emberAesMmoHashFinal() in
+ * ezsp.c.  Random messages are then hashed in randomly sized pieces with
+ * both AES engines in ezsp.c, AES-NI where the processor has it and the
+ * tables, and against a plain byte-at-a-time AES in this file; all must
+ * agree.  Each engine is then timed over a large image, and the number of
+ * EZSP commands that passing the same image to the NCP 96 bytes at a time
+ * would have taken is shown.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack/include/ember-types.h"
+#include "stack/include/error.h"
+#include "app/util/ezsp/ezsp-protocol.h"
+#include "app/util/ezsp/ezsp.h"
+
+#define MESSAGE_COUNT       2000
+#define MAX_MESSAGE_LENGTH  20000
+#define IMAGE_LENGTH        (8 * 1024 * 1024UL)
+#define IMAGE_PASSES        4
+#define EZSP_HASH_BLOCK     96
+
+extern int8u emAesUseAesNi;
+
+typedef struct {
+  int32u length;
+  int8u result[EMBER_AES_HASH_BLOCK_SIZE];
+} TestVector;
+
+// The messages are bytes counting up from 0xC0 for the short vectors and
+// from 0x00 for the long ones.  The 1, 16 and 8191 byte vectors are from
+// annex C.5; the others were worked out separately with OpenSSL's AES.
+static const TestVector vectors[] = {
+  { 0,    { 0xBA, 0xD7, 0x8E, 0x72, 0x6C, 0x1E, 0xC0, 0x2B,
+            0x7E, 0xBF, 0xE9, 0x2B, 0x23, 0xD9, 0xEC, 0x34 } },
+  { 1,    { 0xAE, 0x3A, 0x10, 0x2A, 0x28, 0xD4, 0x3E, 0xE0,
+            0xD4, 0xA0, 0x9E, 0x22, 0x78, 0x8B, 0x20, 0x6C } },
+  { 16,   { 0xA7, 0x97, 0x7E, 0x88, 0xBC, 0x0B, 0x61, 0xE8,
+            0x21, 0x08, 0x27, 0x10, 0x9A, 0x22, 0x8F, 0x2D } },
+  { 32,   { 0xB9, 0xB3, 0xD7, 0x76, 0x30, 0x24, 0x13, 0x17,
+            0xB8, 0x1C, 0x0D, 0x82, 0x70, 0x7C, 0xC3, 0x07 } },
+  { 8191, { 0x24, 0xEC, 0x2F, 0xE7, 0x5B, 0xBF, 0xFC, 0xB3,
+            0x47, 0x89, 0xBC, 0x06, 0x10, 0xE7, 0xF1, 0x65 } },
+  { 8192, { 0xDC, 0x6B, 0x06, 0x87, 0xF0, 0x9F, 0x86, 0x07,
+            0x13, 0x1C, 0x17, 0x0B, 0x3B, 0xD3, 0x15, 0x91 } },
+};
+
+static int8u message[MAX_MESSAGE_LENGTH];
+static int8u image[IMAGE_LENGTH];
+
+//------------------------------------------------------------------------------
+// EZSP callback function stubs
+
+void ezspErrorHandler(EzspStatus status)
+{}
+
+void ezspTimerHandler(int8u timerId)
+{}
+
+void ezspStackStatusHandler(EmberStatus status)
+{}
+
+void ezspNetworkFoundHandler(EmberZigbeeNetwork *networkFound,
+                             int8u lastHopLqi,
+                             int8s lastHopRssi)
+{}
+
+void ezspScanCompleteHandler(int8u channel, EmberStatus status)
+{}
+
+void ezspMessageSentHandler(EmberOutgoingMessageType type,
+                            int16u indexOrDestination,
+                            EmberApsFrame *apsFrame,
+                            int8u messageTag,
+                            EmberStatus status,
+                            int8u messageLength,
+                            int8u *messageContents)
+{}
+
+void ezspIncomingMessageHandler(EmberIncomingMessageType type,
+                                EmberApsFrame *apsFrame,
+                                int8u lastHopLqi,
+                                int8s lastHopRssi,
+                                EmberNodeId sender,
+                                int8u bindingIndex,
+                                int8u addressIndex,
+                                int8u messageLength,
+                                int8u *messageContents)
+{}
+
+//------------------------------------------------------------------------------
+// A plain AES-128 and AES-MMO, following FIPS-197 and annex B.6 step by step.
+
+static int8u plainSbox[256];
+
+static int8u times2(int8u x)
+{
+  return (int8u)((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+}
+
+static int8u multiply(int8u a, int8u b)
+{
+  int8u product = 0;
+  while (b != 0) {
+    if (b & 1) {
+      product ^= a;
+    }
+    a = times2(a);
+    b >>= 1;
+  }
+  return product;
+}
+
+static void plainInit(void)
+{
+  int16u i;
+  for (i = 0; i < 256; i++) {
+    int8u inverse = 0;
+    int8u x;
+    int8u bit;
+    int16u j;
+    for (j = 1; j < 256 && i != 0; j++) {
+      if (multiply((int8u)i, (int8u)j) == 1) {
+        inverse = (int8u)j;
+        break;
+      }
+    }
+    x = 0x63;
+    for (bit = 0; bit < 8; bit++) {
+      int8u value = (((inverse >> bit)
+                      ^ (inverse >> ((bit + 4) % 8))
+                      ^ (inverse >> ((bit + 5) % 8))
+                      ^ (inverse >> ((bit + 6) % 8))
+                      ^ (inverse >> ((bit + 7) % 8)))
+                     & 1);
+      x ^= value << bit;
+    }
+    plainSbox[i] = x;
+  }
+}
+
+static void plainEncrypt(const int8u *key, const int8u *input, int8u *output)
+{
+  int8u roundKey[16];
+  int8u state[16];
+  int8u rcon = 1;
+  int8u round;
+  int8u i;
+
+  MEMCOPY(roundKey, key, 16);
+  for (i = 0; i < 16; i++) {
+    state[i] = input[i] ^ roundKey[i];
+  }
+  for (round = 1; round <= 10; round++) {
+    int8u shifted[16];
+    int8u c;
+    // SubBytes and ShiftRows; byte i is row i % 4 of column i / 4.
+    for (i = 0; i < 16; i++) {
+      shifted[i] = plainSbox[state[(i + 4 * (i % 4)) % 16]];
+    }
+    if (round < 10) {
+      for (c = 0; c < 4; c++) {
+        int8u *a = shifted + 4 * c;
+        state[4 * c]     = times2(a[0]) ^ multiply(a[1], 3) ^ a[2] ^ a[3];
+        state[4 * c + 1] = a[0] ^ times2(a[1]) ^ multiply(a[2], 3) ^ a[3];
+        state[4 * c + 2] = a[0] ^ a[1] ^ times2(a[2]) ^ multiply(a[3], 3);
+        state[4 * c + 3] = multiply(a[0], 3) ^ a[1] ^ a[2] ^ times2(a[3]);
+      }
+    } else {
+      MEMCOPY(state, shifted, 16);
+    }
+    roundKey[0] ^= plainSbox[roundKey[13]] ^ rcon;
+    roundKey[1] ^= plainSbox[roundKey[14]];
+    roundKey[2] ^= plainSbox[roundKey[15]];
+    roundKey[3] ^= plainSbox[roundKey[12]];
+    for (i = 4; i < 16; i++) {
+      roundKey[i] ^= roundKey[i - 4];
+    }
+    rcon = times2(rcon);
+    for (i = 0; i < 16; i++) {
+      state[i] ^= roundKey[i];
+    }
+  }
+  MEMCOPY(output, state, 16);
+}
+
+static void plainHash(const int8u *data, int32u length, int8u *result)
+{
+  int8u block[16];
+  int8u encrypted[16];
+  int32u bits = length * 8;
+  int32u paddedLength;
+  int32u offset;
+  int8u i;
+
+  // The 1 bit, zeros, and the bit count in 16 or 48 bits as in B.6.
+  if (length < 8192) {
+    paddedLength = ((length + 1 + 2 + 15) / 16) * 16;
+  } else {
+    paddedLength = ((length + 1 + 6 + 15) / 16) * 16;
+  }
+  MEMSET(result, 0, 16);
+  for (offset = 0; offset < paddedLength; offset += 16) {
+    for (i = 0; i < 16; i++) {
+      int32u n = offset + i;
+      int32u fromEnd = paddedLength - n;
+      if (n < length) {
+        block[i] = data[n];
+      } else if (n == length) {
+        block[i] = 0x80;
+      } else if (length < 8192 && fromEnd <= 2) {
+        block[i] = (int8u)(bits >> (8 * (fromEnd - 1)));
+      } else if (length >= 8192 && fromEnd <= 6 && fromEnd > 2) {
+        block[i] = (int8u)(bits >> (8 * (fromEnd - 3)));
+      } else {
+        block[i] = 0;
+      }
+    }
+    plainEncrypt(result, block, encrypted);
+    for (i = 0; i < 16; i++) {
+      result[i] = encrypted[i] ^ block[i];
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+// Hashes the message in pieces of random multiples of 16 bytes, with the
+// rest passed to emberAesMmoHashFinal().
+static EmberStatus hashInPieces(const int8u *data,
+                                int32u length,
+                                int8u *result)
+{
+  EmberAesMmoHashContext context;
+  EmberStatus status;
+  int32u offset = 0;
+
+  emberAesMmoHashInit(&context);
+  while (length - offset >= 16 && rand() % 4 != 0) {
+    int32u piece = 16 * (1 + rand() % 40);
+    if (piece > length - offset) {
+      piece = ((length - offset) / 16) * 16;
+    }
+    status = emberAesMmoHashUpdate(&context, piece, data + offset);
+    if (status != EMBER_SUCCESS) {
+      return status;
+    }
+    offset += piece;
+  }
+  status = emberAesMmoHashFinal(&context, length - offset, data + offset);
+  MEMCOPY(result, context.result, EMBER_AES_HASH_BLOCK_SIZE);
+  return status;
+}
+
+static boolean checkVectors(void)
+{
+  int8u result[EMBER_AES_HASH_BLOCK_SIZE];
+  int8u i;
+  int32u j;
+
+  for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+    int8u start = (vectors[i].length < 8191 ? 0xC0 : 0x00);
+    for (j = 0; j < vectors[i].length; j++) {
+      message[j] = (int8u)(start + j);
+    }
+    if (hashInPieces(message, vectors[i].length, result) != EMBER_SUCCESS
+        || MEMCOMPARE(result, vectors[i].result, sizeof(result)) != 0) {
+      printf("Test vector of %ld bytes failed\n", (long)vectors[i].length);
+      return FALSE;
+    }
+    plainHash(message, vectors[i].length, result);
+    if (MEMCOMPARE(result, vectors[i].result, sizeof(result)) != 0) {
+      printf("Plain hash of the %ld byte test vector failed\n",
+             (long)vectors[i].length);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static boolean checkMessages(void)
+{
+  int8u plain[EMBER_AES_HASH_BLOCK_SIZE];
+  int8u table[EMBER_AES_HASH_BLOCK_SIZE];
+  int8u hardware[EMBER_AES_HASH_BLOCK_SIZE];
+  int8u useAesNi = emAesUseAesNi;
+  int32u i, j;
+
+  for (i = 0; i < MESSAGE_COUNT; i++) {
+    // Mostly short messages, with some around and past 8192 bytes.
+    int32u length = (i % 5 == 0
+                     ? 8100 + rand() % (MAX_MESSAGE_LENGTH - 8100)
+                     : rand() % 300);
+    for (j = 0; j < length; j++) {
+      message[j] = rand();
+    }
+    plainHash(message, length, plain);
+    emAesUseAesNi = FALSE;
+    hashInPieces(message, length, table);
+    emAesUseAesNi = useAesNi;
+    hashInPieces(message, length, hardware);
+    if (MEMCOMPARE(plain, table, sizeof(plain)) != 0
+        || MEMCOMPARE(plain, hardware, sizeof(plain)) != 0) {
+      printf("Message %ld of %ld bytes hashed differently\n",
+             (long)i, (long)length);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static double timeImage(boolean useAesNi, int8u *result)
+{
+  EmberAesMmoHashContext context;
+  clock_t start = clock();
+  int8u pass;
+
+  emAesUseAesNi = useAesNi;
+  for (pass = 0; pass < IMAGE_PASSES; pass++) {
+    emberAesMmoHashInit(&context);
+    emberAesMmoHashUpdate(&context, IMAGE_LENGTH - 64, image);
+    emberAesMmoHashFinal(&context, 64, image + IMAGE_LENGTH - 64);
+  }
+  MEMCOPY(result, context.result, EMBER_AES_HASH_BLOCK_SIZE);
+  return (double)(clock() - start) / CLOCKS_PER_SEC / IMAGE_PASSES;
+}
+
+int main(int argc, char *argv[])
+{
+  int8u tableResult[EMBER_AES_HASH_BLOCK_SIZE];
+  int8u hardwareResult[EMBER_AES_HASH_BLOCK_SIZE];
+  double tableTime, hardwareTime;
+  EmberAesMmoHashContext context;
+  boolean haveAesNi;
+  int32u i;
+
+  srand(1);
+  plainInit();
+  // The first hash checks the processor for AES-NI.
+  emberAesMmoHashInit(&context);
+  emberAesMmoHashFinal(&context, 0, NULL);
+  haveAesNi = emAesUseAesNi;
+
+  if (!checkVectors() || !checkMessages()) {
+    return 1;
+  }
+  printf("Test vectors and %d messages agree (AES-NI %s)\n",
+         MESSAGE_COUNT, haveAesNi ? "used" : "not available");
+
+  for (i = 0; i < IMAGE_LENGTH; i++) {
+    image[i] = rand();
+  }
+  tableTime = timeImage(FALSE, tableResult);
+  printf("tables: %8.3f s  %8.1f MB/s\n",
+         tableTime, IMAGE_LENGTH / tableTime / 1000000.0);
+  if (haveAesNi) {
+    hardwareTime = timeImage(TRUE, hardwareResult);
+    if (MEMCOMPARE(tableResult, hardwareResult, sizeof(tableResult)) != 0) {
+      printf("Image hashed differently\n");
+      return 1;
+    }
+    printf("AES-NI: %8.3f s  %8.1f MB/s\n",
+           hardwareTime, IMAGE_LENGTH / hardwareTime / 1000000.0);
+  }
+  printf("ezsp:   %8ld commands of %d bytes for the same %ld byte image\n",
+         (long)((IMAGE_LENGTH + EZSP_HASH_BLOCK - 1) / EZSP_HASH_BLOCK),
+         EZSP_HASH_BLOCK,
+         (long)IMAGE_LENGTH);
+  return 0;
+}
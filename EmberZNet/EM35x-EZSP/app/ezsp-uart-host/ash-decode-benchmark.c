@@ -0,0 +1,262 @@
+/** @file ash-decode-benchmark.c
+ *  @brief Compares the block ASH frame decoder with the byte-wise decoder
+ *
+ * Builds a stream of encoded frames, including escaped bytes, bad CRCs,
+ * cancelled and substituted frames, then decodes it with both
+ * ashDecodeByte() and ashDecodeBlock(). The decoded frames and statuses must
+ * be identical. Each decoder is then timed over the same stream. The frames
+ * are also checked to encode the same with ashEncodeFrame() as with
+ * ashEncodeByte().
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack/include/ember-types.h"
+#include "hal/hal.h"
+#include "hal/micro/generic/ash-protocol.h"
+#include "hal/micro/generic/ash-common.h"
+#include "app/ezsp-uart-host/ash-host.h"
+
+#define FRAME_COUNT     2000
+#define STREAM_LEN      (FRAME_COUNT * 2 * (ASH_MAX_FRAME_WITH_CRC_LEN + 2))
+#define ITERATIONS      50
+#define MAX_RESULTS     (FRAME_COUNT * 2)
+
+typedef struct {
+  EzspStatus status;
+  int8u len;
+  int8u frame[ASH_MAX_FRAME_LEN];
+} DecodeResult;
+
+static int8u stream[STREAM_LEN];
+static int32u streamLen;
+static DecodeResult byteResults[MAX_RESULTS];
+static DecodeResult blockResults[MAX_RESULTS];
+
+static void addByte(int8u byte)
+{
+  stream[streamLen++] = byte;
+}
+
+// Encodes one frame into the stream. The data field of a DATA frame is
+// randomized first, as ashSend() does. The frame is also encoded with
+// ashEncodeFrame(), which must give the same bytes.
+static void addFrame(int8u *frame, int8u len)
+{
+  int8u encoded[ASH_MAX_STUFFED_FRAME_LEN];
+  int16u encodedLen;
+  int32u start = streamLen;
+  int8u offset;
+  int8u out;
+
+  if ((frame[0] & ASH_DFRAME_MASK) == ASH_CONTROL_DATA) {
+    (void)ashRandomizeArray(0, frame + 1, len - 1);
+  }
+  out = ashEncodeByte(len, frame[0], &offset);
+  addByte(out);
+  while (offset != 0xFF) {
+    out = ashEncodeByte(0, frame[offset], &offset);
+    addByte(out);
+  }
+  encodedLen = ashEncodeFrame(frame[0], frame + 1, len - 1, encoded);
+  if (encodedLen != streamLen - start
+      || memcmp(encoded, stream + start, encodedLen) != 0) {
+    printf("ashEncodeFrame() differs from ashEncodeByte()\n");
+    exit(1);
+  }
+}
+
+static void buildStream(void)
+{
+  int8u frame[ASH_MAX_FRAME_LEN];
+  int8u len;
+  int16u i;
+  int8u j;
+
+  srand(1);
+  streamLen = 0;
+  for (i = 0; i < FRAME_COUNT; i++) {
+    switch (rand() % 16) {
+    case 0:                             // ACK
+      frame[0] = ASH_CONTROL_ACK + (i & ASH_ACKNUM_MASK);
+      addFrame(frame, 1);
+      break;
+    case 1:                             // corrupted: flip a bit
+      frame[0] = ASH_CONTROL_DATA;
+      for (j = 1; j < 20; j++) {
+        frame[j] = rand();
+      }
+      addFrame(frame, 20);
+      stream[streamLen - 5] ^= 0x01;
+      break;
+    case 2:                             // cancelled part way through
+      addByte(0x42);
+      addByte(ASH_ESC);
+      addByte(0x5E);
+      addByte(ASH_CAN);
+      break;
+    case 3:                             // comm error, then the frame ends
+      addByte(0x10);
+      addByte(ASH_SUB);
+      addByte(0x11 + 0x20);
+      addByte(ASH_FLAG);
+      break;
+    default:                            // DATA frame, often with stuffing
+      len = ASH_MIN_DATA_FRAME_LEN
+            + (rand() % (ASH_MAX_FRAME_LEN - ASH_MIN_DATA_FRAME_LEN + 1));
+      frame[0] = ASH_CONTROL_DATA | ((i & 7) << ASH_FRMNUM_BIT);
+      for (j = 1; j < len; j++) {
+        frame[j] = (rand() % 8 == 0) ? ASH_FLAG : rand();
+      }
+      addFrame(frame, len);
+      break;
+    }
+  }
+}
+
+static int16u decodeBytewise(void)
+{
+  int32u i;
+  int16u count = 0;
+  int8u out;
+  int8u outLen = 0;
+  int8u index;
+  EzspStatus status;
+  DecodeResult *result = &byteResults[0];
+
+  ashDecodeInProgress = FALSE;
+  for (i = 0; i < streamLen; i++) {
+    if (!ashDecodeInProgress) {
+      outLen = 0;
+    }
+    index = outLen;
+    status = ashDecodeByte(stream[i], &out, &outLen);
+    if (outLen != index) {
+      result->frame[index] = out;
+    }
+    if (status != EZSP_ASH_IN_PROGRESS) {
+      result->status = status;
+      result->len = outLen;
+      if (status == EZSP_SUCCESS
+          && (result->frame[0] & ASH_DFRAME_MASK) == ASH_CONTROL_DATA) {
+        (void)ashRandomizeArray(0, result->frame + 1, outLen - 1);
+      }
+      count++;
+      result = &byteResults[count];
+    }
+  }
+  return count;
+}
+
+// The stream is fed to the block decoder in pieces of varying size, as
+// reads from the serial port would deliver it.
+static int16u decodeBlockwise(void)
+{
+  int32u i = 0;
+  int16u count = 0;
+  int16u chunk;
+  int16u used;
+  int8u frameLen = 0;
+  EzspStatus status;
+  DecodeResult *result = &blockResults[0];
+
+  ashDecodeInProgress = FALSE;
+  while (i < streamLen) {
+    chunk = 1 + (i % 256);
+    if (chunk > streamLen - i) {
+      chunk = streamLen - i;
+    }
+    status = ashDecodeBlock(stream + i,
+                            chunk,
+                            &used,
+                            result->frame,
+                            &frameLen,
+                            TRUE);
+    i += used;
+    if (status != EZSP_ASH_IN_PROGRESS) {
+      result->status = status;
+      result->len = frameLen;
+      count++;
+      result = &blockResults[count];
+    }
+  }
+  return count;
+}
+
+static boolean compareResults(int16u count)
+{
+  int16u i;
+
+  for (i = 0; i < count; i++) {
+    if (byteResults[i].status != blockResults[i].status) {
+      printf("Frame %d: status 0x%02X vs 0x%02X\n",
+             i, byteResults[i].status, blockResults[i].status);
+      return FALSE;
+    }
+    if (byteResults[i].status == EZSP_SUCCESS
+        && (byteResults[i].len != blockResults[i].len
+            || memcmp(byteResults[i].frame,
+                      blockResults[i].frame,
+                      byteResults[i].len) != 0)) {
+      printf("Frame %d: contents differ\n", i);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static double timeDecoder(int16u (*decoder)(void))
+{
+  clock_t start;
+  int8u i;
+
+  start = clock();
+  for (i = 0; i < ITERATIONS; i++) {
+    (void)decoder();
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+  int16u byteCount;
+  int16u blockCount;
+  double byteTime;
+  double blockTime;
+  double megabytes;
+
+  buildStream();
+  printf("Stream of %d frames, %ld bytes\n", FRAME_COUNT, (long)streamLen);
+
+  byteCount = decodeBytewise();
+  blockCount = decodeBlockwise();
+  if (byteCount != blockCount) {
+    printf("Decoded %d frames byte-wise but %d block-wise\n",
+           byteCount, blockCount);
+    return 1;
+  }
+  if (!compareResults(byteCount)) {
+    return 1;
+  }
+  printf("Both decoders agree on %d frames\n", byteCount);
+
+  byteTime = timeDecoder(decodeBytewise);
+  blockTime = timeDecoder(decodeBlockwise);
+  megabytes = (double)streamLen * ITERATIONS / 1000000.0;
+  printf("byte-wise:  %8.3f s  %8.2f MB/s\n", byteTime, megabytes / byteTime);
+  printf("block-wise: %8.3f s  %8.2f MB/s\n", blockTime, megabytes / blockTime);
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// EZSP callback function stubs
+
+boolean ncpHasCallbacks;
+
+void ezspErrorHandler(EzspStatus status)
+{}
@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include "stack/include/ember-types.h"
 #include "hal/micro/generic/ash-protocol.h"
+#include "hal/micro/generic/ash-common.h"
 #include "app/ezsp-uart-host/ash-host.h"
 #include "app/ezsp-uart-host/ash-host-io.h"
 #include "app/ezsp-uart-host/ash-host-ui.h"
@@ -87,7 +88,8 @@
 // Local Variables
 
 static int serialFd = NULL_FILE_DESCRIPTOR; // file descriptor for serial port
-static int8u outBuffer[MAX_OUT_BLOCK_LEN];  // array to buffer output
+static int8u outBuffer[MAX_OUT_BLOCK_LEN    // array to buffer output, with
+                      + ASH_MAX_STUFFED_FRAME_LEN]; // room to finish a frame
 static int8u *outBufRd;                     // outBuffer read pointer                    
 static int8u *outBufWr;                     // outBuffer write pointer
 static int16u outBlockLen;                  // bytes to buffer before writing
@@ -95,6 +97,7 @@ static int8u inBuffer[MAX_IN_BLOCK_LEN];    // array to buffer input
 static int8u *inBufRd;                      // inBuffer read pointer
 static int8u *inBufWr;                      // inBuffer write pointer
 static int16u inBlockLen;                   // bytes to read ahead
+static int8u openCount;                     // times serial port was opened
 
 #ifdef ENABLE_HOSTIO_DEBUG
 #ifdef IO_LOG
@@ -348,6 +351,7 @@ static EzspStatus ashInternalSerialInit(boolean ignoreErrors)
                                          errStr,
                                          ERR_LEN,
                                          FALSE)) {   // bootloader mode?
+    openCount++;
     return EZSP_SUCCESS;
   }
 
@@ -400,6 +404,18 @@ void ashSerialWriteByte(int8u byte)
   }
 }
 
+void ashSerialWriteFrame(int8u control, const int8u *data, int8u dataLen)
+{
+  int16u count;
+
+  count = ashEncodeFrame(control, data, dataLen, outBufWr);
+  outBufWr += count;
+  ADD_HOST_COUNTER(count, txBytes);
+  if (outBufWr >= &outBuffer[outBlockLen]) {
+    ashSerialWriteFlush();
+  }
+}
+
 EzspStatus ashSerialReadByte(int8u *byte)
 {
   EzspStatus status;
@@ -413,6 +429,21 @@ EzspStatus ashSerialReadByte(int8u *byte)
   return status;
 }
 
+EzspStatus ashSerialReadBlock(int8u **data, int16u *count)
+{
+  EzspStatus status;
+
+  status = ashSerialReadAvailable(count);
+  *data = inBufRd;
+  return status;
+}
+
+void ashSerialReadConsume(int16u count)
+{
+  inBufRd += count;
+  ADD_HOST_COUNTER(count, rxBytes);
+}
+
 #endif    // #ifndef ENABLE_HOSTIO_DEBUG
 
 EzspStatus ashSerialReadAvailable(int16u *count)
@@ -421,6 +452,7 @@ EzspStatus ashSerialReadAvailable(int16u *count)
 
   if (inBufRd == inBufWr) {
     inBufRd = inBufWr = inBuffer;
+    BUMP_HOST_COUNTER(rxSyscalls);
     bytesRead = read(serialFd, inBuffer, inBlockLen);
     if (bytesRead > 0) {
       BUMP_HOST_COUNTER(rxBlocks);
@@ -451,11 +483,11 @@ void ashSerialWriteFlush(void)
 
   if (outBufWr - outBufRd) {
     BUMP_HOST_COUNTER(txBlocks);
+    BUMP_HOST_COUNTER(txSyscalls);
     count = write(serialFd, outBufRd, outBufWr - outBufRd);
     if (count > 0) {
       outBufRd += count;
     }
-    fsync(serialFd);
     if (outBufRd == outBufWr) {
       outBufRd = outBufWr = outBuffer;
     }
@@ -484,18 +516,38 @@ int ashSerialGetFd(void)
   return serialFd;
 }
 
+int8u ashSerialGetOpenCount(void)
+{
+  return openCount;
+}
+
+boolean ashSerialInputIsBuffered(void)
+{
+  return (inBufRd != inBufWr);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // NOTE:
-// This function must be edited so that it returns TRUE only when all of the
-// data sent to the serial driver has been completely transmitted to the NCP.
-// This that the serial transmit buffer, UART FIFO and sUART serializer register
-// must all be empty.
-// This requires driver or UART hardware level software and is dependent on the
-// specific operating system/RTOS and UART hardware in use.
+// This function must return TRUE only when all of the data sent to the serial
+// driver has been completely transmitted to the NCP. This means that the
+// serial transmit buffer, UART FIFO and UART serializer register must all be
+// empty.
+// tcdrain() waits until the driver reports its output transmitted. Some
+// drivers return before the UART FIFO has emptied, so this may need to be
+// edited for the specific operating system/RTOS and UART hardware in use.
+// Writes do not wait for the data to drain, so this is the only place the
+// host blocks on the transmitter.
 ///////////////////////////////////////////////////////////////////////////////
 boolean ashSerialOutputIsIdle(void)
 {
-  return TRUE;  //replace with appropriate tests for actual OS and hardware
+  if (outBufRd != outBufWr) {
+    return FALSE;
+  }
+  if (serialFd == NULL_FILE_DESCRIPTOR) {
+    return TRUE;
+  }
+  BUMP_HOST_COUNTER(txSyscalls);
+  return (tcdrain(serialFd) == 0);
 }
 
 //------------------------------------------------------------------------------
@@ -627,4 +679,34 @@ EzspStatus ashSerialReadByte(int8u *byte)
   return EZSP_SUCCESS;
 }
 
+// The debug versions hand over one byte at a time so that all input still
+// passes through the logging and error injection in ashSerialReadByte().
+EzspStatus ashSerialReadBlock(int8u **data, int16u *count)
+{
+  static int8u byte;
+  EzspStatus status;
+
+  status = ashSerialReadByte(&byte);
+  *data = &byte;
+  *count = (status == EZSP_SUCCESS) ? 1 : 0;
+  return status;
+}
+
+void ashSerialReadConsume(int16u count)
+{
+}
+
+// Likewise, frames are output a byte at a time through ashSerialWriteByte().
+void ashSerialWriteFrame(int8u control, const int8u *data, int8u dataLen)
+{
+  int8u frame[ASH_MAX_STUFFED_FRAME_LEN];
+  int16u count;
+  int16u i;
+
+  count = ashEncodeFrame(control, data, dataLen, frame);
+  for (i = 0; i < count; i++) {
+    ashSerialWriteByte(frame[i]);
+  }
+}
+
 #endif  // #ifdef ENABLE_HOSTIO_DEBUG
@@ -45,7 +45,8 @@ void ashResetCustom(void);
 
 /** @brief Checks to see if there is space available in the serial
  *  write buffer. If the buffer is full, it is output to the serial port
- *  and it return a "no space indication".
+ *  and it return a "no space indication". Success means there is room for
+ *  at least one complete frame of the maximum length.
  *
  * @return  
  * - ::EZSP_SUCCESS
@@ -59,9 +60,23 @@ EzspStatus ashSerialWriteAvailable(void);
  */
 void ashSerialWriteByte(int8u byte);
 
-/** @brief Writes all data the write output buffer to the serial port
- *  and calls fsync(). This is called when a complete frame to be sent to
- *  the ncp has been created.
+/** @brief Encodes a complete frame directly into the serial output buffer,
+ *  with ashEncodeFrame(). ashSerialWriteAvailable() must have returned
+ *  ::EZSP_SUCCESS first. Frames written one after another are sent
+ *  together by the next ashSerialWriteFlush().
+ *
+ * @param control the frame control byte
+ *
+ * @param data    the data field of the frame
+ *
+ * @param dataLen length of the data field
+ */
+void ashSerialWriteFrame(int8u control, const int8u *data, int8u dataLen);
+
+/** @brief Writes all data the write output buffer to the serial port.
+ *  This is called when the frames to be sent to the ncp have been created.
+ *  It does not wait for the data to be transmitted; see
+ *  ashSerialOutputIsIdle().
  */
 void ashSerialWriteFlush(void);
 
@@ -75,6 +90,28 @@ void ashSerialWriteFlush(void);
  */
 EzspStatus ashSerialReadByte(int8u *byte);
 
+/** @brief Gets the block of input data that has been read from the serial
+ *  port but not yet consumed, reading more from the port if there is none.
+ *  The data remains in the input buffer until ashSerialReadConsume() is
+ *  called, and the pointer is valid only until then.
+ *
+ * @param data  pointer to a variable where a pointer to the data is written
+ *
+ * @param count pointer to a variable where the byte count will be written
+ *
+ * @return
+ * - ::EZSP_SUCCESS
+ * - ::EZSP_ASH_NO_RX_DATA
+ */
+EzspStatus ashSerialReadBlock(int8u **data, int16u *count);
+
+/** @brief Discards bytes from the front of the block returned by
+ *  ashSerialReadBlock() once they have been processed.
+ *
+ * @param count number of bytes to discard
+ */
+void ashSerialReadConsume(int16u count);
+
 /** @brief Returns number of the bytes available to read from the serial port.
  *
  * @param count pointer to a variable where the byte count will be written
@@ -112,11 +149,25 @@ void ashDebugFlush(void);
 
 int ashSerialGetFd(void);
 
+/** @brief Returns a count of the times the serial port has been opened.
+ *  A caller that keeps ashSerialGetFd() registered with the operating system
+ *  can use this to tell that the port was closed and reopened, possibly
+ *  with the same file descriptor.
+ */
+int8u ashSerialGetOpenCount(void);
+
+/** @brief Returns TRUE if data already read from the serial port is waiting
+ *  in the input buffer. Such data will not make the file descriptor
+ *  readable, so the caller should not wait for it to be.
+ */
+boolean ashSerialInputIsBuffered(void);
+
 
 /** @brief tests to see if all serial transmit data has actually been shifted
  *  out the host's serial port transmit data pin.
- *  As shipped this is a stub function that must be edited to match the actual
- *  operating system and/or UART hardware.
+ *  As shipped this waits with tcdrain() for the serial driver to finish
+ *  sending, which may need to be extended for the actual operating system
+ *  and/or UART hardware.
  * @return  TRUE if all data has been shifted out.
  */
 boolean ashSerialOutputIsIdle(void);
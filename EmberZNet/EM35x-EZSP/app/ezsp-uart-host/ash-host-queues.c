@@ -26,6 +26,11 @@
 //------------------------------------------------------------------------------
 // Preprocessor definitions
 
+// Queue and free list lengths are kept in an int8u.
+#if TX_POOL_BUFFERS > 255
+  #error The ASH buffer pools may not exceed 255 buffers.
+#endif
+
 //------------------------------------------------------------------------------
 // Global Variables
 
@@ -44,6 +49,8 @@ static AshBuffer ashRxPool[EZSP_HOST_ASH_RX_POOL_SIZE];
 //------------------------------------------------------------------------------
 // Forward Declarations
 
+static void ashInitQueue(AshQueue *queue);
+
 //#define ASH_QUEUE_TEST
 #ifdef ASH_QUEUE_TEST
 static void ashQueueTest(void);
@@ -58,14 +65,16 @@ void ashInitQueues(void)
 {
   AshBuffer *buffer;
 
-  txQueue.tail = NULL;
-  reTxQueue.tail = NULL;
+  ashInitQueue(&txQueue);
+  ashInitQueue(&reTxQueue);
   txFree.link = NULL;
+  txFree.length = 0;
   for (buffer = ashTxPool; buffer < &ashTxPool[TX_POOL_BUFFERS]; buffer++)
     ashFreeBuffer(&txFree, buffer);
 
-  rxQueue.tail = NULL;
+  ashInitQueue(&rxQueue);
   rxFree.link = NULL;
+  rxFree.length = 0;
   for (buffer = ashRxPool; 
        buffer < &ashRxPool[EZSP_HOST_ASH_RX_POOL_SIZE]; 
        buffer++)
@@ -77,6 +86,13 @@ void ashInitQueues(void)
 
 }
 
+static void ashInitQueue(AshQueue *queue)
+{
+  queue->tail = NULL;
+  queue->head = NULL;
+  queue->length = 0;
+}
+
 // Add a buffer to a free list
 void ashFreeBuffer(AshFreeList *list, AshBuffer *buffer)
 {
@@ -86,6 +102,7 @@ void ashFreeBuffer(AshFreeList *list, AshBuffer *buffer)
   }
   buffer->link = list->link;
   list->link = buffer;
+  list->length++;
 }
 
 // Get a buffer from the free list
@@ -96,6 +113,7 @@ AshBuffer *ashAllocBuffer(AshFreeList *list)
   buffer = list->link;
   if (buffer != NULL) {
     list->link = buffer->link;
+    list->length--;
     buffer->len = 0;
     memset(buffer->data, 0, ASH_MAX_DATA_FIELD_LEN);
   }
@@ -105,40 +123,25 @@ AshBuffer *ashAllocBuffer(AshFreeList *list)
 // Remove the buffer at the head of a queue
 AshBuffer *ashRemoveQueueHead(AshQueue *queue)
 {
-  AshBuffer *head, *prev;
+  AshBuffer *head;
 
-  head = queue->tail;
+  head = queue->head;
   if (head == NULL) {
     ashTraceEvent("Tried to remove head from an empty queue\r\n");
     assert(FALSE);
   }
-  if (head->link == NULL)
-    queue->tail = NULL;
-  else {
-    do {
-      prev = head;
-      head = head->link;
-    } while (head->link != NULL);
-  prev->link = NULL;
-  }
+  (void)ashRemoveQueueEntry(queue, head);
   return head;
 }
 
 // Get a pointer to the buffer at the head of a queue
 AshBuffer *ashQueueHead(AshQueue *queue)
 {
-  AshBuffer *head;
-
-  head = queue->tail;
-  if (head == NULL) {
+  if (queue->head == NULL) {
     ashTraceEvent("Tried to access head in an empty queue\r\n");
     assert(FALSE);
   }
-  if(head != NULL) {
-    while (head->link != NULL)
-      head = head->link;
-  }
-  return head;
+  return queue->head;
 }
 
 // Get a pointer to the Nth entry in a queue (the tail corresponds to N = 1)
@@ -150,14 +153,19 @@ AshBuffer *ashQueueNthEntry(AshQueue *queue, int8u n)
     ashTraceEvent("Asked for 0th element in queue\r\n");
     assert(FALSE);
   }
-  buffer = queue->tail;
-  while (--n) {
-    if (buffer == NULL) {
-      ashTraceEvent("Less than N entries in queue\r\n");
-      assert(FALSE);
-    }
-    buffer = buffer->link;
-  } 
+  if (n > queue->length) {
+    ashTraceEvent("Less than N entries in queue\r\n");
+    assert(FALSE);
+  }
+  if (n <= queue->length - n) {
+    buffer = queue->tail;
+    while (--n)
+      buffer = buffer->link;
+  } else {
+    buffer = queue->head;
+    for (n = queue->length - n; n > 0; n--)
+      buffer = buffer->preceding;
+  }
   return buffer;  
 }
 
@@ -166,22 +174,7 @@ AshBuffer *ashQueueNthEntry(AshQueue *queue, int8u n)
 // If the buffer specified is the tail, NULL is returned;
 AshBuffer *ashQueuePrecedingEntry(AshQueue *queue, AshBuffer *buffer)
 {
-  AshBuffer *ptr;
-
-  ptr = queue->tail;
-  if (ptr == buffer) {
-    return NULL;
-  } else {
-    do {
-      if (ptr->link == buffer) {      
-        return ptr;
-      }
-      ptr = ptr->link;
-    } while(ptr != NULL);
-    ashTraceEvent("Buffer not in queue\r\n");
-    assert(FALSE);
-    return NULL;
-  }
+  return (buffer == NULL) ? queue->head : buffer->preceding;
 }
 
 // Remove the specified entry from a queue, return a pointer to the preceding
@@ -190,37 +183,37 @@ AshBuffer *ashRemoveQueueEntry(AshQueue *queue, AshBuffer *buffer)
 {
   AshBuffer *ptr;
 
-  ptr = ashQueuePrecedingEntry(queue, buffer);
+  if (buffer == NULL || queue->length == 0) {
+    ashTraceEvent("Buffer not in queue\r\n");
+    assert(FALSE);
+  }
+  ptr = buffer->preceding;
   if (ptr != NULL) {
     ptr->link = buffer->link;
   } else {
     queue->tail = buffer->link;
   }
+  if (buffer->link != NULL) {
+    buffer->link->preceding = ptr;
+  } else {
+    queue->head = ptr;
+  }
+  buffer->link = NULL;
+  buffer->preceding = NULL;
+  queue->length--;
   return ptr;
 }
 
 // Get the number of buffers in a queue
 int8u ashQueueLength(AshQueue *queue)
 {
-  AshBuffer *head;
-  int8u count;
-
-  head = queue->tail;
-  for (count = 0; head != NULL; count++)
-    head = head->link;
-  return count;
+  return queue->length;
 }
 
 // Get the number of buffers in a free list
 int8u ashFreeListLength(AshFreeList *list)
 {
-  AshBuffer *next;
-  int8u count;
-
-  next = list->link;
-  for (count = 0; next != NULL; count++)
-    next = next->link;
-  return count;
+  return list->length;
 }
 
 // Add a buffer to the tail of a queue
@@ -231,7 +224,14 @@ void ashAddQueueTail(AshQueue *queue, AshBuffer *buffer)
     assert(FALSE);
   }
   buffer->link = queue->tail;
+  buffer->preceding = NULL;
+  if (queue->tail != NULL) {
+    queue->tail->preceding = buffer;
+  } else {
+    queue->head = buffer;
+  }
   queue->tail = buffer;
+  queue->length++;
 }
 
 // Return whether or not the queue is empty
@@ -368,8 +368,9 @@ static int32u ashInternalQueueTest(void)
   ashFreeBuffer(&txFree, buf);
   bufx = buf;
 
-  txQueue.tail = NULL;
+  ashInitQueue(&txQueue);
   txFree.link = NULL;
+  txFree.length = 0;
   for (buf = ashTxPool; buf < &ashTxPool[TX_POOL_BUFFERS]; buf++)
     ashFreeBuffer(&txFree, buf);
   for (i = 1; ; i++) {
@@ -386,6 +387,69 @@ static int32u ashInternalQueueTest(void)
     return 240;
   if (ashQueueLength(&txQueue) != (TX_POOL_BUFFERS-1))
     return 250;
+  if (ashQueueHead(&txQueue)->len != 1)
+    return 260;
+
+  // Refill the queue, then remove every other entry, walking from the head
+  // as serialResponseReceived() does, and check both directions still agree.
+  ashInitQueue(&txQueue);
+  txFree.link = NULL;
+  txFree.length = 0;
+  for (buf = ashTxPool; buf < &ashTxPool[TX_POOL_BUFFERS]; buf++)
+    ashFreeBuffer(&txFree, buf);
+  for (i = 1; ; i++) {
+    buf = ashAllocBuffer(&txFree);
+    if (buf == NULL) {
+      break;
+    }
+    buf->len = i;
+    ashAddQueueTail(&txQueue, buf);
+  }
+  if (ashFreeListLength(&txFree) != 0)
+    return 270;
+
+  buf = ashQueuePrecedingEntry(&txQueue, NULL);
+  while (buf != NULL) {
+    if (buf->len & 1) {
+      bufx = buf;
+      buf = ashRemoveQueueEntry(&txQueue, bufx);
+      ashFreeBuffer(&txFree, bufx);
+    } else {
+      buf = ashQueuePrecedingEntry(&txQueue, buf);
+    }
+  }
+  if (ashQueueLength(&txQueue) != TX_POOL_BUFFERS / 2)
+    return 280;
+  if (ashFreeListLength(&txFree) != (TX_POOL_BUFFERS + 1) / 2)
+    return 290;
+
+  for (i = 1, buf = ashQueueHead(&txQueue); buf != NULL; i++) {
+    if (buf->len != 2 * i)
+      return 300;
+    buf = ashQueuePrecedingEntry(&txQueue, buf);
+  }
+  for (i = 1, buf = txQueue.tail; buf != NULL; i++) {
+    if (buf != ashQueueNthEntry(&txQueue, i))
+      return 310;
+    buf = buf->link;
+  }
+  if (i != ashQueueLength(&txQueue) + 1)
+    return 320;
+
+  // Remove the tail, then drain from the head.
+  buf = ashRemoveQueueEntry(&txQueue, txQueue.tail);
+  if (buf != NULL)
+    return 330;
+  if (ashQueueNthEntry(&txQueue, 1)->len != 2 * ashQueueLength(&txQueue))
+    return 340;
+  while (!ashQueueIsEmpty(&txQueue)) {
+    buf = ashRemoveQueueHead(&txQueue);
+    ashFreeBuffer(&txFree, buf);
+  }
+  if (txQueue.head != NULL || ashQueueLength(&txQueue) != 0)
+    return 350;
+  if (ashFreeListLength(&txFree) != TX_POOL_BUFFERS - 1)
+    return 360;
 
   return 0;
 }
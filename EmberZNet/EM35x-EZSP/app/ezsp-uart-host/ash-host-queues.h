@@ -18,10 +18,11 @@
 
 /** @brief The number of transmit buffers must be set to the number of receive buffers
 * -- to hold the immediate ACKs sent for each callabck frame received --
-* plus 3 buffers for the retransmit queue and one each for an automatic ACK
-* (due to data flow control) and a command.
+* plus 3 buffers for the retransmit queue, one for an automatic ACK
+* (due to data flow control) and one for each command in the EZSP window.
 */
-#define TX_POOL_BUFFERS   (EZSP_HOST_ASH_RX_POOL_SIZE + 5)
+#define TX_POOL_BUFFERS   \
+  (EZSP_HOST_ASH_RX_POOL_SIZE + 4 + EZSP_HOST_COMMAND_WINDOW_SIZE)
 
 /** @brief Define the limits used to decide if the host will hold off the ncp from
 * sending normal priority frames.
@@ -30,23 +31,31 @@
 #define RX_FREE_HWM 12
 
 /** @brief Buffer to hold a DATA frame.
+* In a queue, link points to the next entry towards the head and preceding
+* to the next entry towards the tail. In a free list only link is used.
 */
 typedef struct ashBuffer {
   struct ashBuffer *link; 
+  struct ashBuffer *preceding;
   int8u len; 
   int8u data[ASH_MAX_DATA_FIELD_LEN];
 } AshBuffer;
 
-/** @brief Simple queue (singly-linked list)
+/** @brief Queue (doubly-linked list) with both ends and the length kept,
+* so that adding, removing and finding entries at either end, and removing
+* any entry, take constant time.
 */
 typedef struct {
   AshBuffer *tail;
+  AshBuffer *head;
+  int8u length;
 } AshQueue;
 
-/** @brief Simple free list (singly-linked list)
+/** @brief Simple free list (singly-linked list) with its length.
 */
 typedef struct {
   AshBuffer *link;
+  int8u length;
 } AshFreeList;
 
 /** @brief Initializes all queues and free lists. 
@@ -91,7 +100,8 @@ AshBuffer *ashQueueHead(AshQueue *queue);
 
 /** @brief  Get a pointer to the Nth entry in a queue. The tail is entry
  *  number 1, and if the queue has N entries, the head is entry number N.
- *  The queue must not be empty.
+ *  The queue must not be empty. The list is walked from whichever end is
+ *  nearer.
  *
  * @param queue   pointer to the queue
  * @param n       number of the entry to which a pointer will be returned
@@ -288,7 +288,11 @@ void ashPrintCounters(AshCount *counters, boolean clear)
   printf("Host Counts        Received Transmitted\n");
   printf("Total bytes      %10d  %10d\n",  a.rxBytes,       a.txBytes);
   printf("DATA bytes       %10d  %10d\n",  a.rxData,        a.txData);
-  printf("I/O blocks       %10d  %10d\n\n",a.rxBlocks,      a.txBlocks);
+  printf("I/O blocks       %10d  %10d\n",  a.rxBlocks,      a.txBlocks);
+  printf("System calls     %10d  %10d\n",  a.rxSyscalls,    a.txSyscalls);
+  printf("Calls per frame  %10.2f  %10.2f\n\n",
+         a.rxAllFrames ? (double)a.rxSyscalls / a.rxAllFrames : 0.0,
+         a.txAllFrames ? (double)a.txSyscalls / a.txAllFrames : 0.0);
   printf("Total frames     %10d  %10d\n",  a.rxAllFrames ,  a.txAllFrames);
   printf("DATA frames      %10d  %10d\n",  a.rxDataFrames,  a.txDataFrames);
   printf("ACK frames       %10d  %10d\n",  a.rxAckFrames,   a.txAckFrames);
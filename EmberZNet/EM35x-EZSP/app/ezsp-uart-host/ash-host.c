@@ -118,6 +118,7 @@ static AshHostConfig ashHostConfigArray[] =
 
 static int8u txBuffer[TX_BUFFER_LEN];       // outgoing short frames
 static int8u rxBuffer[RX_BUFFER_LEN];       // incoming short frames
+static int8u rxFrame[ASH_MAX_FRAME_LEN];    // frame being decoded
 static int8u sendState;                     // ashSendExec() state variable
 static int8u ackRx;                         // frame ack'ed from remote peer
 static int8u ackTx;                         // frame ack'ed to remote peer
@@ -392,7 +393,6 @@ static EzspStatus ashReceiveFrame(void)
       }
       ashFlags &= ~(FLG_REJ | FLG_NAK);       // clear the REJ condition
       INC8(frmRx);
-      ashRandomizeBuffer(rxDataBuffer->data, rxDataBuffer->len);
       ashAddQueueTail(&rxQueue, rxDataBuffer);// add frame to receive queue
       ashTraceEzspFrameId("add to queue", rxDataBuffer->data);
       ashTraceEzspVerbose("ashReceiveFrame(): ID=0x%x Seq=0x%x Buffer=%u",
@@ -434,9 +434,8 @@ static EzspStatus ashReceiveFrame(void)
 
 void ashSendExec(void)
 {
-  static int8u offset;
-  int8u out, in, len;
-  static AshBuffer *buffer;
+  int8u len;
+  AshBuffer *buffer;
 
   // Check for received acknowledgement timer expiry
   if (ashAckTimerHasExpired()) {
@@ -458,17 +457,13 @@ void ashSendExec(void)
     }
   } 
  
+  // Frames are encoded whole into the serial output buffer, so all of the
+  // frames sent here, DATA and ACK alike, go out in a single write.
   while (ashSerialWriteAvailable() == EZSP_SUCCESS) {
-    // Send ASH_CAN character immediately, ahead of any other transmit data
+    // Send ASH_CAN character immediately, ahead of any other transmit data.
+    // There is never a partly written frame to cancel.
     if (ashFlags & FLG_CAN) {
-      if (sendState == SEND_STATE_IDLE) {   // sending RST or just woke NCP
-        ashSerialWriteByte(ASH_CAN);
-      } else if (sendState == SEND_STATE_TX_DATA) { // cancel frame in progress
-        BUMP_HOST_COUNTER(txCancelled);
-        ashSerialWriteByte(ASH_CAN);
-        ashStopAckTimer();
-        sendState = SEND_STATE_IDLE;
-      }
+      ashSerialWriteByte(ASH_CAN);            // sending RST or just woke NCP
       ashFlags &= ~FLG_CAN;
       continue;
     }
@@ -544,29 +539,12 @@ void ashSendExec(void)
         return;
       }
 
-      // Start frame - ashEncodeByte() is inited by a non-zero length argument
+      // Encode the whole frame into the output buffer
       ashTraceFrame(TRUE);                    // trace output (if enabled)
-      out = ashEncodeByte(len, txControl, &offset);
-      ashSerialWriteByte(out);
-      break;
-
-    case SEND_STATE_SHFRAME:                  // sending short frame
-      if (offset != 0xFF) {
-        in = txBuffer[offset];
-        out = ashEncodeByte(0, in, &offset);
-        ashSerialWriteByte(out);
-      } else {
-        sendState = SEND_STATE_IDLE;
-      }
-      break;
-
-    case SEND_STATE_TX_DATA:                  // sending data frame
-    case SEND_STATE_RETX_DATA:                // resending data frame
-      if (offset != 0xFF) {
-        in = offset ? buffer->data[offset - 1] : txControl;
-        out = ashEncodeByte(0, in, &offset);
-        ashSerialWriteByte(out);
-      } else {
+      if (sendState == SEND_STATE_SHFRAME) {  // short frame
+        ashSerialWriteFrame(txControl, &txBuffer[1], len - 1);
+      } else {                                // data frame, new or resent
+        ashSerialWriteFrame(txControl, buffer->data, len - 1);
         if (sendState == SEND_STATE_TX_DATA) {
           INC8(frmTx);
           buffer = ashRemoveQueueHead(&txQueue);
@@ -578,8 +556,8 @@ void ashSendExec(void)
           ashStartAckTimer();
         }
         ackTx = frmRx;
-        sendState = SEND_STATE_IDLE;
       }
+      sendState = SEND_STATE_IDLE;
       break;
 
     }   // end of switch(sendState)
@@ -592,6 +570,28 @@ boolean ashIsConnected(void)
   return ((ashFlags & FLG_CONNECTED) != 0);
 }
 
+int16u ashMsToNextTimer(void)
+{
+  int16u next = 0xFFFF;
+  int16u elapsed;
+  int8s nrUnits;
+
+  if (ashAckTimerIsRunning()) {
+    elapsed = halCommonGetInt16uMillisecondTick() - ashAckTimer;
+    next = (elapsed >= ashAckPeriod) ? 0 : ashAckPeriod - elapsed;
+  }
+  if (ashNrTimer) {
+    nrUnits = (int8s)(ashNrTimer - (int8u)(halCommonGetInt16uMillisecondTick()
+                                           >> ASH_NR_TIMER_BIT));
+    if (nrUnits <= 0) {
+      next = 0;
+    } else if (((int16u)nrUnits << ASH_NR_TIMER_BIT) < next) {
+      next = (int16u)nrUnits << ASH_NR_TIMER_BIT;
+    }
+  }
+  return next;
+}
+
 EzspStatus ashReceive(int8u *len, int8u *inbuf)
 {
   AshBuffer *buffer;
@@ -801,9 +801,9 @@ static EzspStatus ashNcpDisconnect(int8u error)
 
 static EzspStatus ashReadFrame(void)
 {
-  int8u index;
-  int8u in;
-  int8u out;
+  int8u *in;
+  int16u count;
+  int16u used;
   EzspStatus status;
 
   if (!ashDecodeInProgress) {
@@ -812,53 +812,50 @@ static EzspStatus ashReadFrame(void)
   }
 
   do {
-    // Get next byte from serial port, return if no data
-    status = ashSerialReadByte(&in);
+    // Get the next block of data from the serial port, return if no data
+    status = ashSerialReadBlock(&in, &count);
     if (status == EZSP_ASH_NO_RX_DATA) {
       break;
     }
 
     // 0xFF byte signals a callback is pending when between frames
     // in synchronous (polled) callback mode.
-    if (!ashDecodeInProgress && (in == ASH_WAKE)) {
+    if (!ashDecodeInProgress && (*in == ASH_WAKE)) {
       if (ncpSleepEnabled) {
         ncpHasCallbacks = TRUE;
       }
+      ashSerialReadConsume(1);
       status = EZSP_ASH_IN_PROGRESS;
       continue;
     }
 
-    // Decode next input byte - note that many input bytes do not produce
-    // an output byte. Return on any error in decoding.
-    index = rxLen;
-    status = ashDecodeByte(in, &out, &rxLen);
-    if ( (status != EZSP_ASH_IN_PROGRESS) && (status != EZSP_SUCCESS) ) {
-      ashFreeNonNullRxBuffer();
-      break;                  // discard an invalid frame
-    }
+    // Decode as much of the block as belongs to the current frame. DATA
+    // frames are derandomized as they are decoded. Return on any error in
+    // decoding.
+    status = ashDecodeBlock(in,
+                            count,
+                            &used,
+                            rxFrame,
+                            &rxLen,
+                            ashReadConfig(randomize));
+    ashSerialReadConsume(used);
+  } while (status == EZSP_ASH_IN_PROGRESS);
 
-    if (rxLen != index) {           // if input byte produced an output byte
-      if (rxLen <= RX_BUFFER_LEN) { // if a short frame, return in rxBuffer
-        rxBuffer[index] = out;
-      // If a longer DATA frame, allocate an AshBuffer for it.
-      // (Note the control byte is always returned in rxControl. Even if
-      // no buffer can be allocated, the control's ackNum must be processed.)
-      } else {
-        if (rxLen == RX_BUFFER_LEN + 1)  {  // alloc buffer, copy prior data
-          rxDataBuffer = ashAllocBuffer(&rxFree);
-          ashTraceEzspVerbose("ashReadFrame(): ashAllocBuffer(): %u", rxDataBuffer);
-          if (rxDataBuffer != NULL) {
-            memcpy(rxDataBuffer->data, rxBuffer + 1, RX_BUFFER_LEN - 1);
-            rxDataBuffer->len = RX_BUFFER_LEN - 1;
-          }
-        }
-        if (rxDataBuffer != NULL) {     // copy next byte to buffer
-          rxDataBuffer->data[index-1] = out;  // -1 since control is omitted
-          rxDataBuffer->len = index;
-        }
+  // Return a short frame in rxBuffer, and copy the data field of a longer
+  // DATA frame to an AshBuffer. (Note the control byte is always returned in
+  // rxControl. Even if no buffer can be allocated, the control's ackNum must
+  // be processed.)
+  if (status == EZSP_SUCCESS) {
+    memcpy(rxBuffer, rxFrame, (rxLen < RX_BUFFER_LEN) ? rxLen : RX_BUFFER_LEN);
+    if (rxLen > RX_BUFFER_LEN) {
+      rxDataBuffer = ashAllocBuffer(&rxFree);
+      ashTraceEzspVerbose("ashReadFrame(): ashAllocBuffer(): %u", rxDataBuffer);
+      if (rxDataBuffer != NULL) {
+        memcpy(rxDataBuffer->data, rxFrame + 1, rxLen - 1);
+        rxDataBuffer->len = rxLen - 1;
       }
     }
-  } while (status == EZSP_ASH_IN_PROGRESS);
+  }
   return status;
 } // end of ashReadFrame()
 
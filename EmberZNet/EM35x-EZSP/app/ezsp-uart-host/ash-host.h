@@ -91,6 +91,7 @@ typedef struct
   int32u txN0Frames;          /*!< ACK and NAK frames with nFlag 0 transmitted */
   int32u txN1Frames;          /*!< ACK and NAK frames with nFlag 1 transmitted */
   int32u txCancelled;         /*!< frames cancelled (with ASH_CAN byte) */
+  int32u txSyscalls;          /*!< write() and tcdrain() calls */
 
   int32u rxBytes;             /*!< total bytes received */
   int32u rxBlocks;            /*!< blocks received         */
@@ -103,6 +104,7 @@ typedef struct
   int32u rxN0Frames;          /*!< ACK and NAK frames with nFlag 0 received  */
   int32u rxN1Frames;          /*!< ACK and NAK frames with nFlag 1 received  */
   int32u rxCancelled;         /*!< frames cancelled (with ASH_CAN byte) */
+  int32u rxSyscalls;          /*!< read() calls, including those with no data */
 
   int32u rxCrcErrors;         /*!< frames with CRC errors */
   int32u rxCommErrors;        /*!< frames with comm errors (with ASH_SUB byte) */
@@ -215,6 +217,14 @@ boolean ashIsConnected(void);
  */
 void ashSendExec(void);
 
+/** @brief Returns the number of milliseconds until ashSendExec() must next
+ *  be called to service the ASH timers (the received ACK timer and the
+ *  not ready timer), 0 if one has already expired, or 0xFFFF if neither is
+ *  running. A host that sleeps waiting for serial input can use this to
+ *  bound its sleep.
+ */
+int16u ashMsToNextTimer(void);
+
 /** @brief Processes all received frames.
  *  Received DATA frames are appended to the receive queue if there is room.
  *
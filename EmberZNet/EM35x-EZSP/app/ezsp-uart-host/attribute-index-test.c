@@ -0,0 +1,312 @@
+/** @file attribute-index-test.c
+ *  @brief Checks the attribute lookup index against a linear search
+ *
+ * Builds attribute-storage.c with the endpoints of attribute-storage-test.h,
+ * which has a small index so that lookups probe past collisions, and the
+ * stand-ins for the generated headers in framework-test.  After the startup
+ * endpoints are configured, and after each of a random series of dynamic
+ * endpoints being added and removed and endpoints being disabled and
+ * enabled, every attribute is looked up through the index and by searching
+ * every endpoint, and the two must agree.  The attribute written to each
+ * dynamic endpoint when it was added must still be read back from it after
+ * other endpoints have been removed and the rest moved down.
+ *
+ * Before that, a dynamic endpoint is added, removed and added again with a
+ * different profile, device or cluster list.  Only the endpoint as the NCP
+ * was first given it may be enabled on the NCP again.
+ *
+ * <!-- Copyright 2009 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include "app/framework/include/af.h"
+#include "app/framework/util/attribute-storage.h"
+
+#define FIRST_STATIC_ENDPOINT   50
+#define STATIC_ENDPOINT_COUNT   MAX_ENDPOINT_COUNT
+#define FIRST_DYNAMIC_ENDPOINT  100
+#define DYNAMIC_ENDPOINT_RANGE  (2 * EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT)
+#define OPERATION_COUNT         5000
+#define TEST_CLUSTER            1
+#define TEST_ATTRIBUTE          101
+
+// Every endpoint in attribute-storage-test.h has the first endpoint type.
+extern const EmberAfEndpointType generatedEmberAfEndpointTypes[];
+#define TEST_ENDPOINT_TYPE \
+  ((EmberAfEndpointType *)&generatedEmberAfEndpointTypes[0])
+
+//------------------------------------------------------------------------------
+// What the rest of the framework and the NCP would provide.
+
+boolean afDeviceEnabled[EMBER_AF_ENDPOINT_TABLE_SIZE];
+
+void emberAfClusterInitCallback(int8u endpoint, EmberAfClusterId clusterId)
+{
+}
+
+EmberAfStatus emberAfExternalAttributeReadCallback(int8u endpoint,
+                                                   EmberAfClusterId clusterId,
+                                                   EmberAfAttributeMetadata *attributeMetadata,
+                                                   int16u manufacturerCode,
+                                                   int8u *buffer)
+{
+  return EMBER_ZCL_STATUS_FAILURE;
+}
+
+EmberAfStatus emberAfExternalAttributeWriteCallback(int8u endpoint,
+                                                    EmberAfClusterId clusterId,
+                                                    EmberAfAttributeMetadata *attributeMetadata,
+                                                    int16u manufacturerCode,
+                                                    int8u *buffer)
+{
+  return EMBER_ZCL_STATUS_FAILURE;
+}
+
+void emberAfCopyString(int8u *dest, int8u *src, int8u size)
+{
+}
+
+void emberAfCopyLongString(int8u *dest, int8u *src, int16u size)
+{
+}
+
+EmberStatus emberAfDeactivateClusterTick(int8u endpoint,
+                                         int16u clusterId,
+                                         boolean isClient)
+{
+  return EMBER_SUCCESS;
+}
+
+EmberStatus emberAfPushEndpointNetworkIndex(int8u endpoint)
+{
+  return EMBER_SUCCESS;
+}
+
+EmberStatus emberAfPopNetworkIndex(void)
+{
+  return EMBER_SUCCESS;
+}
+
+int8u emberGetCurrentNetwork(void)
+{
+  return 0;
+}
+
+EzspStatus ezspSetEndpointFlags(int8u endpoint, EzspEndpointFlags flags)
+{
+  return EZSP_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+
+static boolean isAdded[DYNAMIC_ENDPOINT_RANGE];
+static int8u addedCount = 0;
+
+static EmberAfStatus accessAttribute(int8u endpoint,
+                                     int8u *value,
+                                     boolean write)
+{
+  EmberAfAttributeSearchRecord record;
+  record.endpoint = endpoint;
+  record.clusterId = TEST_CLUSTER;
+  record.clusterMask = CLUSTER_MASK_SERVER;
+  record.attributeId = TEST_ATTRIBUTE;
+  record.manufacturerCode = EMBER_AF_NULL_MANUFACTURER_CODE;
+  return emAfReadOrWriteAttribute(&record, NULL, value, 1, write);
+}
+
+// Each dynamic endpoint is given a value of its own when it is added.
+static boolean valuesAreKept(void)
+{
+  int8u i;
+  for (i = 0; i < DYNAMIC_ENDPOINT_RANGE; i++) {
+    int8u value;
+    if (isAdded[i]
+        && (accessAttribute(FIRST_DYNAMIC_ENDPOINT + i, &value, FALSE)
+            != EMBER_ZCL_STATUS_SUCCESS
+            || value != i + 1)) {
+      printf("Endpoint %d lost its attribute\n", FIRST_DYNAMIC_ENDPOINT + i);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static boolean addOrRemove(int8u i)
+{
+  int8u endpoint = FIRST_DYNAMIC_ENDPOINT + i;
+  int8u value = i + 1;
+  EmberStatus status;
+
+  if (isAdded[i]) {
+    status = emAfRemoveDynamicEndpoint(endpoint);
+    if (status != EMBER_SUCCESS) {
+      printf("Removing endpoint %d failed: 0x%X\n", endpoint, status);
+      return FALSE;
+    }
+    isAdded[i] = FALSE;
+    addedCount--;
+    return emberAfIndexFromEndpoint(endpoint) == 0xFF;
+  }
+
+  status = emAfAddDynamicEndpoint(endpoint,
+                                  TEST_ENDPOINT_TYPE,
+                                  0xABBA,
+                                  0xBEEF,
+                                  0,
+                                  0);
+  if (addedCount == EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT) {
+    if (status != EMBER_TABLE_FULL) {
+      printf("Adding endpoint %d to a full table gave 0x%X\n",
+             endpoint,
+             status);
+      return FALSE;
+    }
+    return TRUE;
+  }
+  if (status != EMBER_SUCCESS
+      || accessAttribute(endpoint, &value, TRUE) != EMBER_ZCL_STATUS_SUCCESS) {
+    printf("Adding endpoint %d failed: 0x%X\n", endpoint, status);
+    return FALSE;
+  }
+  isAdded[i] = TRUE;
+  addedCount++;
+  return TRUE;
+}
+
+static boolean ncpEndpointIs(int8u endpoint,
+                             EmberAfEndpointType *endpointType,
+                             int16u deviceId,
+                             EmberStatus expectedStatus,
+                             boolean expectedOnNcp)
+{
+  boolean onNcp = !expectedOnNcp;
+  EmberStatus status = emAfAddDynamicEndpoint(endpoint,
+                                              endpointType,
+                                              0xABBA,
+                                              deviceId,
+                                              0,
+                                              0);
+  if (status == EMBER_SUCCESS) {
+    status = emAfCheckNcpEndpoint(endpoint, &onNcp);
+    if (status == EMBER_SUCCESS && !onNcp) {
+      emAfNcpEndpointCreated(endpoint);
+    }
+    emAfRemoveDynamicEndpoint(endpoint);
+  }
+  if (status != expectedStatus
+      || (status == EMBER_SUCCESS && onNcp != expectedOnNcp)) {
+    printf("Checking endpoint %d against the NCP gave 0x%X\n",
+           endpoint,
+           status);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean ncpEndpointsAreChecked(void)
+{
+  // The test endpoint type without its client cluster.
+  EmberAfEndpointType serverOnly = *TEST_ENDPOINT_TYPE;
+  int8u i;
+  serverOnly.clusterCount = 2;
+  serverOnly.endpointSize = 16;
+
+  emAfClearNcpEndpoints();
+  if (!ncpEndpointIs(FIRST_DYNAMIC_ENDPOINT,
+                     TEST_ENDPOINT_TYPE, 0xBEEF, EMBER_SUCCESS, FALSE)
+      || !ncpEndpointIs(FIRST_DYNAMIC_ENDPOINT,
+                        TEST_ENDPOINT_TYPE, 0xBEEF, EMBER_SUCCESS, TRUE)
+      || !ncpEndpointIs(FIRST_DYNAMIC_ENDPOINT,
+                        &serverOnly, 0xBEEF, EMBER_INVALID_CALL, TRUE)
+      || !ncpEndpointIs(FIRST_DYNAMIC_ENDPOINT,
+                        TEST_ENDPOINT_TYPE, 0xF00D, EMBER_INVALID_CALL, TRUE)) {
+    return FALSE;
+  }
+
+  // Every endpoint number used stays on the NCP, up to the dynamic count.
+  for (i = 1; i < EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT; i++) {
+    if (!ncpEndpointIs(FIRST_DYNAMIC_ENDPOINT + i,
+                       &serverOnly, 0xBEEF, EMBER_SUCCESS, FALSE)) {
+      return FALSE;
+    }
+  }
+  if (!ncpEndpointIs(FIRST_DYNAMIC_ENDPOINT + i,
+                     &serverOnly, 0xBEEF, EMBER_TABLE_FULL, FALSE)) {
+    return FALSE;
+  }
+
+  // Resetting the NCP forgets them.
+  emAfClearNcpEndpoints();
+  return ncpEndpointIs(FIRST_DYNAMIC_ENDPOINT,
+                       &serverOnly, 0xBEEF, EMBER_SUCCESS, FALSE);
+}
+
+int main(void)
+{
+  int8u disabled = 0xFF;
+  int16u operation;
+
+  emberAfEndpointConfigure();
+  if (emberAfEndpointCount() != STATIC_ENDPOINT_COUNT
+      || !emAfAttributeIndexMatchesLinearSearch()) {
+    printf("The startup endpoints are not indexed\n");
+    return 1;
+  }
+
+  // Startup endpoints can be neither added again nor removed.
+  if (emAfAddDynamicEndpoint(FIRST_STATIC_ENDPOINT,
+                             TEST_ENDPOINT_TYPE,
+                             0,
+                             0,
+                             0,
+                             0)
+      != EMBER_INVALID_ENDPOINT
+      || emAfRemoveDynamicEndpoint(FIRST_STATIC_ENDPOINT)
+         != EMBER_INVALID_ENDPOINT) {
+    printf("A startup endpoint was added or removed\n");
+    return 1;
+  }
+
+  if (!ncpEndpointsAreChecked()) {
+    return 1;
+  }
+
+  srand(1);
+  for (operation = 0; operation < OPERATION_COUNT; operation++) {
+    if (rand() % 8 == 0) {
+      // Disabled endpoints are found by the linear search's rules.
+      if (disabled != 0xFF) {
+        emberAfEndpointEnableDisable(disabled, TRUE);
+        disabled = 0xFF;
+      } else {
+        disabled = FIRST_STATIC_ENDPOINT + rand() % STATIC_ENDPOINT_COUNT;
+        emberAfEndpointEnableDisable(disabled, FALSE);
+      }
+    } else if (!addOrRemove(rand() % DYNAMIC_ENDPOINT_RANGE)) {
+      return 1;
+    }
+    if (emberAfEndpointCount() != STATIC_ENDPOINT_COUNT + addedCount) {
+      printf("After operation %d there are %d endpoints, not %d\n",
+             operation,
+             emberAfEndpointCount(),
+             STATIC_ENDPOINT_COUNT + addedCount);
+      return 1;
+    }
+    if (!emAfAttributeIndexMatchesLinearSearch()) {
+      printf("After operation %d the index and linear search differ\n",
+             operation);
+      return 1;
+    }
+    if (!valuesAreKept()) {
+      return 1;
+    }
+  }
+
+  printf("%d operations on up to %d endpoints: the index matches\n",
+         OPERATION_COUNT,
+         STATIC_ENDPOINT_COUNT + EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT);
+  return 0;
+}
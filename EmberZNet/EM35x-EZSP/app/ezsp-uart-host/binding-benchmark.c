@@ -0,0 +1,490 @@
+/** @file binding-benchmark.c
+ *  @brief Checks the host binding table mirror against a simulated NCP
+ *
+ * Runs ezsp.c against a simulated NCP, in place of the serial protocol, that
+ * keeps a binding table and answers the binding commands.  A random mix of
+ * binding changes is made, both by the host and as remote binding requests
+ * that the NCP reports with callbacks, with the occasional NCP reset.  After
+ * each change, emberGetBinding() must return what the NCP holds for every
+ * entry and ezspFindBinding() must find the same bindings as a scan of the
+ * NCP's table for every endpoint and cluster, without sending any commands.
+ * The fan-out of a stream of reports to their bindings is then timed, and
+ * the commands it sends counted, with ezspFindBinding() and with a scan of
+ * the table by ezspGetBinding() as emberAfSendUnicastToBindings() did
+ * before.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack/include/ember-types.h"
+#include "stack/include/error.h"
+#include "app/util/ezsp/ezsp-protocol.h"
+#include "app/util/ezsp/ezsp.h"
+#include "app/util/ezsp/serial-interface.h"
+#include "app/util/ezsp/ezsp-frame-utilities.h"
+
+#define TABLE_SIZE          EZSP_HOST_BINDING_TABLE_MIRROR_SIZE
+#define ENDPOINT_COUNT      4
+#define CLUSTER_COUNT       24
+#define OPERATION_COUNT     20000
+#define RESET_PERIOD        2000
+#define REPORT_COUNT        200000
+#define CALLBACK_QUEUE_SIZE 4
+
+//------------------------------------------------------------------------------
+// The simulated NCP.
+
+static int8u ezspFrameLength;
+int8u *ezspFrameLengthLocation = &ezspFrameLength;
+static int8u ezspFrameContentsStorage[EZSP_MAX_FRAME_LENGTH];
+int8u *ezspFrameContents = ezspFrameContentsStorage;
+
+typedef struct {
+  int8u frameId;
+  int8u index;
+  EmberStatus policyDecision;
+  EmberBindingTableEntry entry;
+} RemoteCallback;
+
+static EmberBindingTableEntry ncpTable[TABLE_SIZE];
+static boolean responseReady = FALSE;
+static RemoteCallback callbacks[CALLBACK_QUEUE_SIZE];
+static int8u callbackCount = 0;
+static int32u commandCount = 0;
+
+static void appendResponseStatus(EmberStatus status, int8u index)
+{
+  appendInt8u(index < TABLE_SIZE ? status : EMBER_INDEX_OUT_OF_RANGE);
+}
+
+EzspStatus serialSendCommand(void)
+{
+  EmberBindingTableEntry entry;
+  int8u frameId = serialGetResponseByte(EZSP_FRAME_ID_INDEX);
+  int8u index = 0;
+  int8u i;
+
+  commandCount++;
+  ezspReadPointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+  if (frameId != EZSP_CLEAR_BINDING_TABLE) {
+    index = fetchInt8u();
+  }
+  if (frameId == EZSP_SET_BINDING) {
+    fetchEmberBindingTableEntry(&entry);
+  }
+  ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+
+  switch (frameId) {
+  case EZSP_CLEAR_BINDING_TABLE:
+    for (i = 0; i < TABLE_SIZE; i++) {
+      ncpTable[i].type = EMBER_UNUSED_BINDING;
+    }
+    appendInt8u(EMBER_SUCCESS);
+    break;
+  case EZSP_SET_BINDING:
+    appendResponseStatus(EMBER_SUCCESS, index);
+    if (index < TABLE_SIZE) {
+      ncpTable[index] = entry;
+    }
+    break;
+  case EZSP_GET_BINDING:
+    appendResponseStatus(EMBER_SUCCESS, index);
+    if (index < TABLE_SIZE) {
+      appendEmberBindingTableEntry(&ncpTable[index]);
+    } else {
+      MEMSET(&entry, 0, sizeof(entry));
+      appendEmberBindingTableEntry(&entry);
+    }
+    break;
+  case EZSP_DELETE_BINDING:
+    appendResponseStatus(EMBER_SUCCESS, index);
+    if (index < TABLE_SIZE) {
+      ncpTable[index].type = EMBER_UNUSED_BINDING;
+    }
+    break;
+  default:
+    printf("Unexpected command 0x%02X\n", frameId);
+    exit(1);
+  }
+
+  serialSetCommandByte(EZSP_FRAME_CONTROL_INDEX, EZSP_FRAME_CONTROL_RESPONSE);
+  serialSetCommandLength(ezspWritePointer - ezspFrameContents);
+  responseReady = TRUE;
+  return EZSP_SUCCESS;
+}
+
+// Callbacks are only delivered when there is no response waiting, as the
+// uart serial protocol does.
+EzspStatus serialResponseReceived(void)
+{
+  RemoteCallback *callback;
+  int8u i;
+
+  if (responseReady) {
+    responseReady = FALSE;
+    return EZSP_SUCCESS;
+  }
+  if (callbackCount == 0) {
+    return EZSP_ASH_NO_RX_DATA;
+  }
+
+  callback = &callbacks[0];
+  serialSetCommandByte(EZSP_SEQUENCE_INDEX, 0);
+  serialSetCommandByte(EZSP_FRAME_CONTROL_INDEX, EZSP_FRAME_CONTROL_RESPONSE);
+  serialSetCommandByte(EZSP_FRAME_ID_INDEX, callback->frameId);
+  ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+  if (callback->frameId == EZSP_REMOTE_SET_BINDING_HANDLER) {
+    appendEmberBindingTableEntry(&callback->entry);
+  }
+  appendInt8u(callback->index);
+  appendInt8u(callback->policyDecision);
+  serialSetCommandLength(ezspWritePointer - ezspFrameContents);
+
+  callbackCount--;
+  for (i = 0; i < callbackCount; i++) {
+    callbacks[i] = callbacks[i + 1];
+  }
+  return EZSP_SUCCESS;
+}
+
+int8u serialPendingResponseCount(void)
+{
+  return callbackCount;
+}
+
+//------------------------------------------------------------------------------
+
+void ezspErrorHandler(EzspStatus status)
+{
+  printf("EZSP error 0x%02X\n", status);
+  exit(1);
+}
+
+// EZSP callback function stubs
+
+void ezspTimerHandler(int8u timerId)
+{}
+
+void ezspStackStatusHandler(EmberStatus status)
+{}
+
+void ezspNetworkFoundHandler(EmberZigbeeNetwork *networkFound,
+                             int8u lastHopLqi,
+                             int8s lastHopRssi)
+{}
+
+void ezspScanCompleteHandler(int8u channel, EmberStatus status)
+{}
+
+void ezspMessageSentHandler(EmberOutgoingMessageType type,
+                            int16u indexOrDestination,
+                            EmberApsFrame *apsFrame,
+                            int8u messageTag,
+                            EmberStatus status,
+                            int8u messageLength,
+                            int8u *messageContents)
+{}
+
+void ezspIncomingMessageHandler(EmberIncomingMessageType type,
+                                EmberApsFrame *apsFrame,
+                                int8u lastHopLqi,
+                                int8s lastHopRssi,
+                                EmberNodeId sender,
+                                int8u bindingIndex,
+                                int8u addressIndex,
+                                int8u messageLength,
+                                int8u *messageContents)
+{}
+
+void simulatedTimePasses(void)
+{}
+
+int32u halCommonGetInt32uMillisecondTick(void)
+{
+  return 0;
+}
+
+void ashTraceEzspVerbose(char *format, ...)
+{}
+
+static void queueCallback(int8u frameId,
+                          int8u index,
+                          EmberStatus policyDecision,
+                          EmberBindingTableEntry *entry)
+{
+  RemoteCallback *callback = &callbacks[callbackCount++];
+  callback->frameId = frameId;
+  callback->index = index;
+  callback->policyDecision = policyDecision;
+  if (entry != NULL) {
+    callback->entry = *entry;
+  }
+}
+
+// A remote bind request goes in the first free entry, as the stack does.
+static void remoteSetBinding(EmberBindingTableEntry *entry)
+{
+  int8u i;
+  for (i = 0; i < TABLE_SIZE; i++) {
+    if (ncpTable[i].type == EMBER_UNUSED_BINDING) {
+      ncpTable[i] = *entry;
+      queueCallback(EZSP_REMOTE_SET_BINDING_HANDLER, i, EMBER_SUCCESS, entry);
+      return;
+    }
+  }
+  queueCallback(EZSP_REMOTE_SET_BINDING_HANDLER, 0xFF, EMBER_TABLE_FULL, entry);
+}
+
+static void remoteDeleteBinding(int8u index, boolean allowed)
+{
+  if (allowed) {
+    ncpTable[index].type = EMBER_UNUSED_BINDING;
+  }
+  queueCallback(EZSP_REMOTE_DELETE_BINDING_HANDLER,
+                index,
+                allowed ? EMBER_SUCCESS : EMBER_INVALID_CALL,
+                NULL);
+}
+
+//------------------------------------------------------------------------------
+
+static void randomBinding(EmberBindingTableEntry *entry)
+{
+  int8u i;
+  entry->type = (rand() % 8 == 0
+                 ? EMBER_MULTICAST_BINDING
+                 : EMBER_UNICAST_BINDING);
+  entry->local = 1 + rand() % ENDPOINT_COUNT;
+  entry->clusterId = rand() % CLUSTER_COUNT;
+  entry->remote = 1 + rand() % 240;
+  for (i = 0; i < EUI64_SIZE; i++) {
+    entry->identifier[i] = rand();
+  }
+  entry->networkIndex = 0;
+}
+
+static boolean sameBinding(EmberBindingTableEntry *a, EmberBindingTableEntry *b)
+{
+  return (a->type == b->type
+          && (a->type == EMBER_UNUSED_BINDING
+              || (a->local == b->local
+                  && a->clusterId == b->clusterId
+                  && a->remote == b->remote
+                  && MEMCOMPARE(a->identifier, b->identifier, EUI64_SIZE) == 0
+                  && a->networkIndex == b->networkIndex)));
+}
+
+static boolean checkMirror(int32u operation)
+{
+  EmberBindingTableEntry entry;
+  int32u commands = commandCount;
+  int8u endpoint;
+  int16u clusterId;
+  int8u i;
+
+  for (i = 0; i < TABLE_SIZE; i++) {
+    if (emberGetBinding(i, &entry) != EMBER_SUCCESS
+        || !sameBinding(&entry, &ncpTable[i])) {
+      printf("After operation %ld, binding %d differs\n", (long)operation, i);
+      return FALSE;
+    }
+  }
+
+  for (endpoint = 1; endpoint <= ENDPOINT_COUNT; endpoint++) {
+    for (clusterId = 0; clusterId < CLUSTER_COUNT; clusterId++) {
+      int8u index = ezspFindBinding(0xFF, endpoint, clusterId, &entry);
+      for (i = 0; i < TABLE_SIZE; i++) {
+        if (ncpTable[i].type == EMBER_UNUSED_BINDING
+            || ncpTable[i].local != endpoint
+            || ncpTable[i].clusterId != clusterId) {
+          continue;
+        }
+        if (index != i || !sameBinding(&entry, &ncpTable[i])) {
+          printf("After operation %ld, endpoint %d cluster %d found %d "
+                 "instead of %d\n",
+                 (long)operation, endpoint, clusterId, index, i);
+          return FALSE;
+        }
+        index = ezspFindBinding(index, endpoint, clusterId, &entry);
+      }
+      if (index != 0xFF) {
+        printf("After operation %ld, endpoint %d cluster %d found extra "
+               "binding %d\n",
+               (long)operation, endpoint, clusterId, index);
+        return FALSE;
+      }
+    }
+  }
+
+  if (commandCount != commands) {
+    printf("After operation %ld, reading the mirror sent %ld commands\n",
+           (long)operation, (long)(commandCount - commands));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean checkChanges(void)
+{
+  EmberBindingTableEntry entry;
+  EmberBindingTableEntry before[TABLE_SIZE];
+  int32u i;
+  int8u j;
+
+  for (i = 0; i < OPERATION_COUNT; i++) {
+    int8u index = rand() % TABLE_SIZE;
+    int16u version = ezspBindingTableVersion();
+    MEMCOPY(before, ncpTable, sizeof(before));
+    switch (rand() % 8) {
+    case 0:
+    case 1:
+      randomBinding(&entry);
+      emberSetBinding(index, &entry);
+      break;
+    case 2:
+      emberDeleteBinding(index);
+      break;
+    case 3:
+    case 4:
+      randomBinding(&entry);
+      remoteSetBinding(&entry);
+      ezspTick();
+      break;
+    case 5:
+      remoteDeleteBinding(index, rand() % 4 != 0);
+      ezspTick();
+      break;
+    case 6:
+      // Several remote changes arrive together.
+      randomBinding(&entry);
+      remoteSetBinding(&entry);
+      remoteDeleteBinding(index, TRUE);
+      randomBinding(&entry);
+      remoteSetBinding(&entry);
+      ezspTick();
+      break;
+    default:
+      if (rand() % 200 == 0) {
+        emberClearBindingTable();
+      }
+      break;
+    }
+    if (i % RESET_PERIOD == 0) {
+      ezspBindingMirrorLoad();
+    }
+    if (!checkMirror(i)) {
+      return FALSE;
+    }
+    // Anything that relies on the table must be able to tell it changed.
+    for (j = 0; j < TABLE_SIZE; j++) {
+      if (!sameBinding(&before[j], &ncpTable[j])
+          && version == ezspBindingTableVersion()) {
+        printf("After operation %ld, binding %d changed without a new "
+               "version\n",
+               (long)i, j);
+        return FALSE;
+      }
+    }
+  }
+  printf("Mirror agrees with the NCP after %d binding changes\n",
+         OPERATION_COUNT);
+  return TRUE;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  int8u endpoint;
+  int16u clusterId;
+} Report;
+
+static Report reports[REPORT_COUNT];
+
+static int32u fanOut(boolean scan, int32u *matches, double *seconds)
+{
+  int32u commands = commandCount;
+  clock_t start = clock();
+  EmberBindingTableEntry entry;
+  int32u i;
+
+  *matches = 0;
+  for (i = 0; i < REPORT_COUNT; i++) {
+    Report *report = &reports[i];
+    int8u index;
+    if (scan) {
+      for (index = 0; index < TABLE_SIZE; index++) {
+        if (ezspGetBinding(index, &entry) != EMBER_SUCCESS) {
+          break;
+        }
+        if (entry.type == EMBER_UNICAST_BINDING
+            && entry.local == report->endpoint
+            && entry.clusterId == report->clusterId) {
+          *matches += 1;
+        }
+      }
+    } else {
+      for (index = ezspFindBinding(0xFF,
+                                   report->endpoint,
+                                   report->clusterId,
+                                   &entry);
+           index != 0xFF;
+           index = ezspFindBinding(index,
+                                   report->endpoint,
+                                   report->clusterId,
+                                   &entry)) {
+        if (entry.type == EMBER_UNICAST_BINDING) {
+          *matches += 1;
+        }
+      }
+    }
+  }
+  *seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  return commandCount - commands;
+}
+
+int main(int argc, char *argv[])
+{
+  EmberBindingTableEntry entry;
+  int32u scanMatches, mirrorMatches;
+  int32u scanCommands, mirrorCommands;
+  int32u saved;
+  double scanTime, mirrorTime;
+  int32u i;
+
+  srand(1);
+  emberClearBindingTable();
+  if (!checkChanges()) {
+    return 1;
+  }
+
+  for (i = 0; i < TABLE_SIZE; i++) {
+    randomBinding(&entry);
+    emberSetBinding(i, &entry);
+  }
+  for (i = 0; i < REPORT_COUNT; i++) {
+    reports[i].endpoint = 1 + rand() % ENDPOINT_COUNT;
+    reports[i].clusterId = rand() % CLUSTER_COUNT;
+  }
+
+  saved = ezspBindingMirrorSavedCommands();
+  mirrorCommands = fanOut(FALSE, &mirrorMatches, &mirrorTime);
+  saved = ezspBindingMirrorSavedCommands() - saved;
+  scanCommands = fanOut(TRUE, &scanMatches, &scanTime);
+  if (mirrorMatches != scanMatches) {
+    printf("Mirror found %ld bindings but the scan found %ld\n",
+           (long)mirrorMatches, (long)scanMatches);
+    return 1;
+  }
+  printf("Both found %ld bindings for %d reports\n",
+         (long)scanMatches, REPORT_COUNT);
+  printf("mirror: %8.3f s  %8ld commands  %8ld saved\n",
+         mirrorTime, (long)mirrorCommands, (long)saved);
+  printf("scan:   %8.3f s  %8ld commands\n",
+         scanTime, (long)scanCommands);
+  return 0;
+}
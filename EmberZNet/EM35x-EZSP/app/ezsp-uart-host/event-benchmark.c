@@ -0,0 +1,276 @@
+/** @file event-benchmark.c
+ *  @brief Compares the host event scheduler with a scan of the event array
+ *
+ * Runs the same set of a few thousand events, a small fraction of them
+ * active at any time, through the heap-based scheduler in af-event-host.c
+ * and through a copy of the array scan it replaced. A simulated millisecond
+ * clock, started close to wrapping, is advanced between passes. Each handler
+ * reschedules its event after a delay that depends only on the event and on
+ * how often it has run, so both schedulers must run every event the same
+ * number of times and agree on the time to the next event. Each scheduler is
+ * then timed over the same passes.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack/include/ember-types.h"
+#include "hal/hal.h"
+#include "stack/include/event.h"
+
+#define EVENT_COUNT     4000
+#define ACTIVE_COUNT    (EVENT_COUNT / 50)
+#define PASS_COUNT      20000
+#define START_TIME      0xFFFFC000UL
+#define MAX_WAIT_MS     100000UL
+
+static int32u nowMS;
+
+static EmberEventControl heapControls[EVENT_COUNT];
+static EmberEventControl scanControls[EVENT_COUNT];
+// EmberEventData is const, as applications declare their events statically.
+// These are filled in at run time, so they are built with the same layout.
+typedef struct {
+  EmberEventControl *control;
+  void (*handler)(void);
+} EventEntry;
+
+static EventEntry heapEntries[EVENT_COUNT + 1];
+static EventEntry scanEntries[EVENT_COUNT + 1];
+#define heapEvents ((EmberEventData *)heapEntries)
+#define scanEvents ((EmberEventData *)scanEntries)
+static int32u heapRuns[EVENT_COUNT];
+static int32u scanRuns[EVENT_COUNT];
+static int32u passRuns;
+
+EmberTaskControl emTasks[1];
+PGM int8u emTaskCount = 1;
+
+int32u halCommonGetInt32uMillisecondTick(void)
+{
+  return nowMS;
+}
+
+int16u halCommonGetInt16uMillisecondTick(void)
+{
+  return (int16u)nowMS;
+}
+
+int16u halCommonGetInt16uQuarterSecondTick(void)
+{
+  return (int16u)(nowMS >> 8);
+}
+
+// Mostly millisecond delays, with some quarter second delays and an
+// occasional run straight away, so that all kinds of event are exercised.
+static void reschedule(EmberEventControl *control, int16u index, int32u runs)
+{
+  int32u hash = (index * 2654435761UL) ^ (runs * 40503UL);
+  hash ^= hash >> 13;
+  switch (hash % 16) {
+  case 0:
+    emberEventControlSetActive(*control);
+    break;
+  case 1:
+  case 2:
+    emberEventControlSetDelayQS(*control, 1 + (hash >> 8) % 40);
+    break;
+  default:
+    emberEventControlSetDelayMS(*control, 1 + (hash >> 8) % 5000);
+    break;
+  }
+}
+
+static void heapHandler(EmberEventControl *control)
+{
+  int16u index = control - heapControls;
+  heapRuns[index]++;
+  passRuns++;
+  reschedule(control, index, heapRuns[index]);
+}
+
+static void scanHandler(EmberEventControl *control)
+{
+  int16u index = control - scanControls;
+  scanRuns[index]++;
+  passRuns++;
+  reschedule(control, index, scanRuns[index]);
+}
+
+//------------------------------------------------------------------------------
+// The array scan that emberRunEvents() and emberMsToNextEvent() used before.
+
+static void scanRunEvents(EmberEventData *events)
+{
+  int16u times[4];
+  EmberEventData *nextEvent;
+  int32u nowMS32 = halCommonGetInt32uMillisecondTick();
+
+  times[EMBER_EVENT_MS_TIME]     = (int16u) nowMS32;
+  times[EMBER_EVENT_QS_TIME]     = (int16u) (nowMS32 >> 8);
+  times[EMBER_EVENT_MINUTE_TIME] = (int16u) (nowMS32 >> 16);
+
+  for (nextEvent = events; ; nextEvent++) {
+    EmberEventControl *control = nextEvent->control;
+    if (control == NULL)
+      break;
+    if (control->status == EMBER_EVENT_ZERO_DELAY
+        || (control->status != EMBER_EVENT_INACTIVE
+            && (elapsedTimeInt16u(control->timeToExecute,
+                                  times[control->status]) <=
+                (((int32u)MAX_INT16U_VALUE + 1) / 2))))
+    {
+      ((void (*)(EmberEventControl *))(nextEvent->handler))(control);
+    }
+  }
+}
+
+static int32u scanMsToNextEvent(EmberEventData *events, int32u maxTime)
+{
+  int16u times[4];
+  EmberEventData *nextEvent;
+  int32u time = maxTime;
+  int32u nowMS32 = halCommonGetInt32uMillisecondTick();
+
+  times[EMBER_EVENT_MS_TIME]     = (int16u) nowMS32;
+  times[EMBER_EVENT_QS_TIME]     = (int16u) (nowMS32 >> 8);
+  times[EMBER_EVENT_MINUTE_TIME] = (int16u) (nowMS32 >> 16);
+
+  for (nextEvent = events; ; nextEvent++) {
+    EmberEventControl *control = nextEvent->control;
+    int8u eventStatus;
+    int16u eventTime;
+    int32u waitTime;
+
+    if (control == NULL
+        || time == 0)
+      break;
+
+    eventStatus = control->status;
+    if (eventStatus != EMBER_EVENT_INACTIVE) {
+      eventTime = control->timeToExecute;
+      waitTime = elapsedTimeInt16u(times[eventStatus], eventTime);
+      if (control->status == EMBER_EVENT_ZERO_DELAY
+          || timeGTorEqualInt16u(times[eventStatus], eventTime)) {
+        waitTime = 0;
+      } else if (eventStatus == EMBER_EVENT_QS_TIME) {
+        waitTime = ((waitTime << 8)
+                    - (times[EMBER_EVENT_MS_TIME] & 0xFF));
+      } else if (eventStatus == EMBER_EVENT_MINUTE_TIME) {
+        waitTime = ((waitTime << 16)
+                    - times[EMBER_EVENT_MS_TIME]);
+      }
+      if (waitTime < time) {
+        time = waitTime;
+      }
+    }
+  }
+  return time;
+}
+
+//------------------------------------------------------------------------------
+
+static void setup(EmberEventControl *controls,
+                  EventEntry *events,
+                  void (*handler)(EmberEventControl *),
+                  int32u *runs)
+{
+  int16u i;
+
+  nowMS = START_TIME;
+  memset(runs, 0, EVENT_COUNT * sizeof(int32u));
+  for (i = 0; i < EVENT_COUNT; i++) {
+    emberEventControlSetInactive(controls[i]);
+    events[i].control = &controls[i];
+    events[i].handler = (void (*)(void))handler;
+  }
+  events[EVENT_COUNT].control = NULL;
+  events[EVENT_COUNT].handler = NULL;
+  // Spread the active events through the array.
+  for (i = 0; i < ACTIVE_COUNT; i++) {
+    int16u index = (i * (EVENT_COUNT / ACTIVE_COUNT)) + (i % 7);
+    reschedule(&controls[index], index, 0);
+  }
+}
+
+// The clock moves on by a varying amount after each pass, sometimes not at
+// all, as it would between calls from an application's main loop.
+static void advanceClock(int32u pass)
+{
+  nowMS += (pass * 7919) % 5;
+}
+
+static double timePasses(void (*run)(EmberEventData *),
+                         int32u (*msToNext)(EmberEventData *, int32u),
+                         EmberEventData *events)
+{
+  clock_t start = clock();
+  int32u pass;
+
+  for (pass = 0; pass < PASS_COUNT; pass++) {
+    run(events);
+    (void)msToNext(events, MAX_WAIT_MS);
+    advanceClock(pass);
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+  int32u pass;
+  int32u heapPassRuns;
+  int32u totalRuns = 0;
+  int16u i;
+  double heapTime;
+  double scanTime;
+
+  setup(heapControls, heapEntries, heapHandler, heapRuns);
+  setup(scanControls, scanEntries, scanHandler, scanRuns);
+  for (pass = 0; pass < PASS_COUNT; pass++) {
+    int32u heapWait;
+    int32u scanWait;
+    passRuns = 0;
+    emberRunEvents(heapEvents);
+    heapPassRuns = passRuns;
+    passRuns = 0;
+    scanRunEvents(scanEvents);
+    if (heapPassRuns != passRuns) {
+      printf("Pass %ld: ran %ld events from the heap but %ld from the scan\n",
+             (long)pass, (long)heapPassRuns, (long)passRuns);
+      return 1;
+    }
+    totalRuns += passRuns;
+    heapWait = emberMsToNextEvent(heapEvents, MAX_WAIT_MS);
+    scanWait = scanMsToNextEvent(scanEvents, MAX_WAIT_MS);
+    if (heapWait != scanWait) {
+      printf("Pass %ld: next event in %ld ms from the heap but %ld from "
+             "the scan\n",
+             (long)pass, (long)heapWait, (long)scanWait);
+      return 1;
+    }
+    advanceClock(pass);
+  }
+  for (i = 0; i < EVENT_COUNT; i++) {
+    if (heapRuns[i] != scanRuns[i]) {
+      printf("Event %d ran %ld times from the heap but %ld from the scan\n",
+             i, (long)heapRuns[i], (long)scanRuns[i]);
+      return 1;
+    }
+  }
+  printf("Both schedulers agree on %ld runs of %d events over %d passes\n",
+         (long)totalRuns, EVENT_COUNT, PASS_COUNT);
+
+  setup(heapControls, heapEntries, heapHandler, heapRuns);
+  heapTime = timePasses(emberRunEvents, emberMsToNextEvent, heapEvents);
+  setup(scanControls, scanEntries, scanHandler, scanRuns);
+  scanTime = timePasses(scanRunEvents, scanMsToNextEvent, scanEvents);
+  printf("heap: %8.3f s  %8.2f us/pass\n",
+         heapTime, heapTime * 1000000.0 / PASS_COUNT);
+  printf("scan: %8.3f s  %8.2f us/pass\n",
+         scanTime, scanTime * 1000000.0 / PASS_COUNT);
+  return 0;
+}
@@ -26,5 +26,11 @@
 #define EZSP_TOKEN_SIZE    8
 #define EZSP_TOKEN_ENTRIES 8
 
+// Used by binding-benchmark.
+#define EZSP_HOST_BINDING_TABLE_MIRROR_SIZE 32
+
+// Used by table-mirror-test.
+#define EZSP_HOST_CHILD_TABLE_MIRROR_SIZE 32
+
 
 #define EMBER_ASSERT_SERIAL_PORT 0
@@ -0,0 +1,728 @@
+/** @file fragmentation-test.c
+ *  @brief Simulates many fragmented packets received at once
+ *
+ * Builds the fragmentation plugin without the rest of the application
+ * framework and feeds it the fragments of a stream of packets from many
+ * senders at once, as a gateway sees from meters tunneling data.  The
+ * senders follow the APS fragmentation protocol: each sends a window of
+ * fragments, resends them until the window is acknowledged and gives up after
+ * a few tries.  The fragments of all the senders are shuffled together, some
+ * are lost, some duplicated and some held back to arrive late, and some of the
+ * acknowledgements are lost too.  Many of the senders use the same APS
+ * sequence numbers and there are more of them than there are incoming packet
+ * entries and room in the reassembly pool.  Every packet passed up must be one
+ * that was sent, passed up only once and have the right contents, every
+ * packet whose sender saw the last window acknowledged must have been passed
+ * up, and once all the timeouts have run the pool must be whole again.  This
+ * is done for several window sizes.  A number of packets are then sent at
+ * once, with their fragments acknowledged out of order, and each must be
+ * reported sent once, with the right status.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack/include/ember-types.h"
+#include "stack/include/error.h"
+#include "app/util/ezsp/ezsp-protocol.h"
+#include "app/util/ezsp/ezsp.h"
+#include "hal/hal.h"
+#include "stack/include/event.h"
+
+#define EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS 48
+#define EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS 8
+#define EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE          1500
+#define EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE         24000
+
+// The plugin is built here without af.h, which needs a generated application
+// configuration.  What it uses from there is declared and stubbed below.
+#define __AF_API__
+int8u emberAfMaximumApsPayloadLength(EmberOutgoingMessageType type,
+                                     int16u indexOrDestination,
+                                     EmberApsFrame *apsFrame);
+#include "app/framework/plugin/fragmentation/fragmentation.c"
+
+#define SENDER_COUNT        64
+#define MESSAGE_COUNT       40      // per sender
+#define FRAGMENT_LENGTH     80
+#define ACK_TIMEOUT_MS      1600
+#define ROUND_MS            250
+#define RESEND_ROUNDS       2
+#define MAX_TRIES           4
+#define LOSS_PERCENT        10
+#define DUPLICATE_PERCENT   3
+#define LATE_PERCENT        5
+#define MAX_IN_FLIGHT       (SENDER_COUNT * 8 * 2)
+#define TX_MESSAGE_COUNT    2000
+
+static int32u nowMS;
+
+int32u halCommonGetInt32uMillisecondTick(void)
+{
+  return nowMS;
+}
+
+void emEventControlSetDelayMS(EmberEventControl *event, int16u delay)
+{
+  event->status = EMBER_EVENT_MS_TIME;
+  event->timeToExecute = (int16u)(nowMS + delay);
+}
+
+EzspStatus ezspGetConfigurationValue(EzspConfigId configId, int16u *value)
+{
+  *value = ACK_TIMEOUT_MS;
+  return EZSP_SUCCESS;
+}
+
+EzspStatus emberAfSetEzspConfigValue(EzspConfigId configId,
+                                     int16u value,
+                                     PGM_P configIdName)
+{
+  return EZSP_SUCCESS;
+}
+
+int8u emberAfMaximumApsPayloadLength(EmberOutgoingMessageType type,
+                                     int16u indexOrDestination,
+                                     EmberApsFrame *apsFrame)
+{
+  return FRAGMENT_LENGTH;
+}
+
+static boolean randomPercent(int8u percent)
+{
+  return (rand() % 100) < percent;
+}
+
+static int8u messageByte(int16u sender, int8u sequence, int16u index)
+{
+  return (int8u)((sender * 31) ^ (sequence * 7) ^ (index * 13) ^ (index >> 8));
+}
+
+//------------------------------------------------------------------------------
+// Receiving.
+
+typedef struct {
+  EmberNodeId nodeId;
+  int8u firstSequence;
+  int8u messages;               // messages started
+  int8u sequence;
+  int16u length;
+  int8u fragmentCount;
+  int8u windowSize;
+  int8u windowBase;
+  int8u windowMask;             // fragments of the window acknowledged
+  int8u tries;
+  int8u roundsSinceSend;
+  int8u idleRounds;
+  boolean sending;
+  int16u lengths[MESSAGE_COUNT];
+  boolean delivered[MESSAGE_COUNT];
+  boolean reopened[MESSAGE_COUNT];   // fragments arrived after it was forgotten
+  boolean acknowledged[MESSAGE_COUNT];
+} Sender;
+
+typedef struct {
+  int16u sender;
+  int8u sequence;
+  int8u fragment;
+  int8u fragmentCount;
+} Fragment;
+
+static Sender senders[SENDER_COUNT];
+static Fragment inFlight[MAX_IN_FLIGHT];
+static int16u inFlightCount;
+static Fragment late[MAX_IN_FLIGHT];
+static int16u lateCount;
+static boolean failed;
+
+static int32u deliveredCount;
+static int32u repeatedCount;
+static int32u acknowledgedCount;
+static int32u abandonedCount;
+
+static Sender *findSender(EmberNodeId nodeId)
+{
+  int16u i;
+  for (i = 0; i < SENDER_COUNT; i++) {
+    if (senders[i].nodeId == nodeId) {
+      return &senders[i];
+    }
+  }
+  return NULL;
+}
+
+static int8u fullWindowMask(Sender *sender)
+{
+  int8u count = sender->fragmentCount - sender->windowBase;
+  if (count > sender->windowSize) {
+    count = sender->windowSize;
+  }
+  return ~lowBitMask(count);
+}
+
+static void startMessage(Sender *sender)
+{
+  sender->sequence = sender->firstSequence + sender->messages;
+  sender->length = sender->lengths[sender->messages];
+  sender->fragmentCount = (sender->length + FRAGMENT_LENGTH - 1)
+                          / FRAGMENT_LENGTH;
+  sender->windowSize = emberFragmentWindowSize;
+  sender->windowBase = 0;
+  sender->windowMask = fullWindowMask(sender);
+  sender->tries = 0;
+  sender->roundsSinceSend = RESEND_ROUNDS;
+  sender->messages++;
+  sender->sending = TRUE;
+}
+
+static void endMessage(Sender *sender, boolean acknowledged)
+{
+  sender->sending = FALSE;
+  sender->idleRounds = rand() % 8;
+  if (acknowledged) {
+    sender->acknowledged[sender->messages - 1] = TRUE;
+    acknowledgedCount++;
+  } else {
+    abandonedCount++;
+  }
+}
+
+EmberStatus ezspSendReply(EmberNodeId sender,
+                          EmberApsFrame *apsFrame,
+                          int8u messageLength,
+                          int8u *messageContents)
+{
+  Sender *s = findSender(sender);
+  int8u mask = HIGH_BYTE(apsFrame->groupId);
+  int8u base = LOW_BYTE(apsFrame->groupId);
+
+  if (s == NULL) {
+    printf("Acknowledgement sent to unknown node 0x%04X\n", sender);
+    failed = TRUE;
+    return EMBER_SUCCESS;
+  }
+  if (randomPercent(LOSS_PERCENT)
+      || !s->sending
+      || apsFrame->sequence != s->sequence
+      || base != s->windowBase) {
+    return EMBER_SUCCESS;
+  }
+  s->windowMask |= mask;
+  if (s->windowMask == 0xFF) {
+    s->windowBase += s->windowSize;
+    if (s->fragmentCount <= s->windowBase) {
+      endMessage(s, TRUE);
+    } else {
+      s->windowMask = fullWindowMask(s);
+      s->tries = 0;
+      s->roundsSinceSend = RESEND_ROUNDS;
+    }
+  }
+  return EMBER_SUCCESS;
+}
+
+static void queueFragment(Fragment *fragment)
+{
+  if (inFlightCount < MAX_IN_FLIGHT) {
+    inFlight[inFlightCount++] = *fragment;
+  }
+}
+
+// Senders that have not had their window acknowledged for a while send the
+// missing fragments of it again.
+static void sendFragments(void)
+{
+  int16u i;
+  for (i = 0; i < SENDER_COUNT; i++) {
+    Sender *s = &senders[i];
+    int8u j;
+    if (!s->sending) {
+      if (s->idleRounds > 0) {
+        s->idleRounds--;
+        continue;
+      }
+      if (s->messages == MESSAGE_COUNT) {
+        continue;
+      }
+      startMessage(s);
+    }
+    if (++s->roundsSinceSend <= RESEND_ROUNDS) {
+      continue;
+    }
+    if (s->tries == MAX_TRIES) {
+      endMessage(s, FALSE);
+      continue;
+    }
+    s->tries++;
+    s->roundsSinceSend = 0;
+    for (j = 0; j < s->windowSize; j++) {
+      Fragment fragment;
+      if (s->windowMask & BIT(j)) {
+        continue;
+      }
+      fragment.sender = i;
+      fragment.sequence = s->sequence;
+      fragment.fragment = s->windowBase + j;
+      fragment.fragmentCount = s->fragmentCount;
+      queueFragment(&fragment);
+      if (randomPercent(DUPLICATE_PERCENT)) {
+        queueFragment(&fragment);
+      }
+    }
+  }
+}
+
+// A packet whose entry has been taken for another packet is passed up again
+// if its sender sends it again, as the plugin has no record of it.
+static void checkDelivery(Sender *sender,
+                          EmberApsFrame *apsFrame,
+                          int8u *buffer,
+                          int16u bufLen)
+{
+  int8u message = apsFrame->sequence - sender->firstSequence;
+  int16u i;
+
+  if (sender->messages <= message) {
+    printf("Node 0x%04X: passed up sequence %d, which was not sent\n",
+           sender->nodeId, apsFrame->sequence);
+    failed = TRUE;
+    return;
+  }
+  if (sender->delivered[message] && !sender->reopened[message]) {
+    printf("Node 0x%04X: passed up sequence %d twice\n",
+           sender->nodeId, apsFrame->sequence);
+    failed = TRUE;
+    return;
+  }
+  if (bufLen != sender->lengths[message]) {
+    printf("Node 0x%04X: sequence %d is %d bytes long, not %d\n",
+           sender->nodeId, apsFrame->sequence, bufLen,
+           sender->lengths[message]);
+    failed = TRUE;
+    return;
+  }
+  for (i = 0; i < bufLen; i++) {
+    if (buffer[i] != messageByte(sender - senders, apsFrame->sequence, i)) {
+      printf("Node 0x%04X: sequence %d differs at byte %d\n",
+             sender->nodeId, apsFrame->sequence, i);
+      failed = TRUE;
+      return;
+    }
+  }
+  if (sender->delivered[message]) {
+    sender->reopened[message] = FALSE;
+    repeatedCount++;
+  } else {
+    sender->delivered[message] = TRUE;
+    deliveredCount++;
+  }
+}
+
+static void deliverFragment(Fragment *fragment)
+{
+  Sender *sender = &senders[fragment->sender];
+  int8u message = fragment->sequence - sender->firstSequence;
+  int16u length = sender->lengths[message];
+  int16u offset = fragment->fragment * FRAGMENT_LENGTH;
+  int8u contents[FRAGMENT_LENGTH];
+  int8u *buffer = contents;
+  int16u bufLen = (length - offset < FRAGMENT_LENGTH
+                   ? length - offset
+                   : FRAGMENT_LENGTH);
+  EmberApsFrame apsFrame;
+  int16u i;
+
+  for (i = 0; i < bufLen; i++) {
+    contents[i] = messageByte(fragment->sender, fragment->sequence, offset + i);
+  }
+  MEMSET(&apsFrame, 0, sizeof(apsFrame));
+  apsFrame.profileId = 0x0109;
+  apsFrame.clusterId = 0x0704;
+  apsFrame.sourceEndpoint = 1;
+  apsFrame.destinationEndpoint = 1;
+  apsFrame.options = EMBER_APS_OPTION_FRAGMENT | EMBER_APS_OPTION_RETRY;
+  apsFrame.groupId = HIGH_LOW_TO_INT(fragment->fragmentCount,
+                                     fragment->fragment);
+  apsFrame.sequence = fragment->sequence;
+
+  if (sender->delivered[message]
+      && rxPacketLookUp(&apsFrame, sender->nodeId) == NULL) {
+    sender->reopened[message] = TRUE;
+  }
+  if (!emAfFragmentationIncomingMessage(&apsFrame,
+                                        sender->nodeId,
+                                        &buffer,
+                                        &bufLen)) {
+    checkDelivery(sender, &apsFrame, buffer, bufLen);
+  }
+}
+
+// The fragments sent this round arrive in any order, along with those held
+// back from the last round, except for those that are lost or held back.
+static void deliverFragments(void)
+{
+  int16u count = inFlightCount;
+  int16u i;
+
+  for (i = 0; i < lateCount; i++) {
+    queueFragment(&late[i]);
+  }
+  lateCount = 0;
+  for (i = inFlightCount; i > 1; i--) {
+    int16u j = rand() % i;
+    Fragment fragment = inFlight[i - 1];
+    inFlight[i - 1] = inFlight[j];
+    inFlight[j] = fragment;
+  }
+  count = inFlightCount;
+  inFlightCount = 0;
+  for (i = 0; i < count && !failed; i++) {
+    if (randomPercent(LOSS_PERCENT)) {
+      continue;
+    }
+    if (randomPercent(LATE_PERCENT)) {
+      late[lateCount++] = inFlight[i];
+      continue;
+    }
+    deliverFragment(&inFlight[i]);
+  }
+}
+
+static void runEvent(void)
+{
+  if (emberEventControlGetActive(emAfFragmentationEvent)
+      && timeGTorEqualInt16u((int16u)nowMS,
+                             emAfFragmentationEvent.timeToExecute)) {
+    emAfFragmentationAbortReception(&emAfFragmentationEvent);
+  }
+}
+
+static boolean poolIsWhole(void)
+{
+  int16u block;
+  int16u freeBlocks = 0;
+  int16u i;
+
+  for (i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS; i++) {
+    if (rxPackets[i].status != EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE
+        || rxHashHeads[i] != EMBER_AF_PLUGIN_FRAGMENTATION_NULL_INDEX) {
+      printf("Incoming packet %d is still in use\n", i);
+      return FALSE;
+    }
+  }
+  for (block = rxFreeBlocks;
+       block != EMBER_AF_PLUGIN_FRAGMENTATION_NULL_BLOCK
+       && freeBlocks <= RX_BLOCK_COUNT;
+       block = rxBlockNext[block]) {
+    freeBlocks++;
+  }
+  if (freeBlocks != RX_BLOCK_COUNT) {
+    printf("%d of %d pool blocks are free\n", freeBlocks, RX_BLOCK_COUNT);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean checkReceiving(int8u windowSize)
+{
+  int32u rounds = 0;
+  boolean busy = TRUE;
+  int16u i, j;
+
+  emberFragmentWindowSize = windowSize;
+  emberAfPluginFragmentationInitCallback();
+  emberAfPluginFragmentationNcpInitCallback();
+  deliveredCount = 0;
+  repeatedCount = 0;
+  acknowledgedCount = 0;
+  abandonedCount = 0;
+  inFlightCount = 0;
+  lateCount = 0;
+
+  // Half of the senders start from the same sequence number.
+  for (i = 0; i < SENDER_COUNT; i++) {
+    Sender *s = &senders[i];
+    MEMSET(s, 0, sizeof(Sender));
+    s->nodeId = (EmberNodeId)(0x1000 + i * 0x0301);
+    s->firstSequence = (i % 2 == 0 ? 0xF0 : (int8u)rand());
+    s->idleRounds = rand() % 16;
+    for (j = 0; j < MESSAGE_COUNT; j++) {
+      s->lengths[j] = 1 + rand() % EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE;
+    }
+  }
+
+  while (busy && !failed) {
+    sendFragments();
+    deliverFragments();
+    nowMS += ROUND_MS;
+    runEvent();
+    rounds++;
+    busy = (lateCount > 0);
+    for (i = 0; i < SENDER_COUNT; i++) {
+      if (senders[i].sending || senders[i].messages < MESSAGE_COUNT) {
+        busy = TRUE;
+      }
+    }
+  }
+  if (failed) {
+    return FALSE;
+  }
+
+  for (i = 0; i < SENDER_COUNT; i++) {
+    for (j = 0; j < MESSAGE_COUNT; j++) {
+      if (senders[i].acknowledged[j] && !senders[i].delivered[j]) {
+        printf("Node 0x%04X: sequence %d was acknowledged but not passed up\n",
+               senders[i].nodeId, (int8u)(senders[i].firstSequence + j));
+        return FALSE;
+      }
+    }
+  }
+
+  // Let every packet time out.
+  for (i = 0; i < (ACK_TIMEOUT_MS * ZIGBEE_APSC_MAX_TRANSMIT_RETRIES)
+                  / ROUND_MS + 2; i++) {
+    nowMS += ROUND_MS;
+    runEvent();
+  }
+  if (!poolIsWhole()) {
+    return FALSE;
+  }
+
+  printf("Window %d: %d packets in %ld rounds, %ld passed up (%ld again), "
+         "%ld acknowledged, %ld abandoned\n",
+         windowSize, SENDER_COUNT * MESSAGE_COUNT, (long)rounds,
+         (long)deliveredCount, (long)repeatedCount,
+         (long)acknowledgedCount, (long)abandonedCount);
+  return TRUE;
+}
+
+//------------------------------------------------------------------------------
+// Sending.
+
+typedef struct {
+  EmberApsFrame apsFrame;
+  int16u destination;
+  int8u length;
+  int8u contents[FRAGMENT_LENGTH];
+} SentFragment;
+
+#define MAX_SENT (EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS * 8)
+
+static SentFragment sent[MAX_SENT];
+static int16u sentCount;
+static int8u nextSequence;
+
+typedef struct {
+  boolean active;
+  boolean failing;              // some of its fragments may fail
+  boolean failed;               // one of its fragments has failed
+  int8u sequence;
+  int16u length;
+  int8u contents[EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE];
+  int8u received[EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE];
+} OutgoingMessage;
+
+static OutgoingMessage outgoing[EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS];
+static int32u reportedCount;
+
+// The first fragment of a packet gets a new APS sequence number and the
+// others use the same one.
+EmberStatus ezspSendUnicast(EmberOutgoingMessageType type,
+                            int16u indexOrDestination,
+                            EmberApsFrame *apsFrame,
+                            int8u messageTag,
+                            int8u messageLength,
+                            int8u *messageContents,
+                            int8u *sequence)
+{
+  SentFragment *fragment;
+  if (sentCount == MAX_SENT) {
+    return EMBER_NO_BUFFERS;
+  }
+  if (LOW_BYTE(apsFrame->groupId) == 0) {
+    *sequence = nextSequence++;
+    outgoing[indexOrDestination].sequence = *sequence;
+  }
+  fragment = &sent[sentCount++];
+  fragment->apsFrame = *apsFrame;
+  fragment->apsFrame.sequence = *sequence;
+  fragment->destination = indexOrDestination;
+  fragment->length = messageLength;
+  MEMCOPY(fragment->contents, messageContents, messageLength);
+  return EMBER_SUCCESS;
+}
+
+void emAfFragmentationMessageSentHandler(EmberOutgoingMessageType type,
+                                         int16u indexOrDestination,
+                                         EmberApsFrame *apsFrame,
+                                         int8u *buffer,
+                                         int16u bufLen,
+                                         EmberStatus status)
+{
+  OutgoingMessage *message = &outgoing[indexOrDestination];
+  if (!message->active) {
+    printf("Packet to %d reported sent twice\n", indexOrDestination);
+    failed = TRUE;
+    return;
+  }
+  if (type != EMBER_OUTGOING_DIRECT) {
+    printf("Packet to %d reported with message type %d\n",
+           indexOrDestination, type);
+    failed = TRUE;
+  } else if (status != (message->failed
+                        ? EMBER_DELIVERY_FAILED
+                        : EMBER_SUCCESS)) {
+    printf("Packet to %d reported with status 0x%02X\n",
+           indexOrDestination, status);
+    failed = TRUE;
+  } else if (!message->failed
+             && memcmp(message->received,
+                       message->contents,
+                       message->length) != 0) {
+    printf("Packet to %d was not sent correctly\n", indexOrDestination);
+    failed = TRUE;
+  }
+  message->active = FALSE;
+  reportedCount++;
+}
+
+static EmberStatus startOutgoing(int16u destination)
+{
+  OutgoingMessage *message = &outgoing[destination];
+  EmberApsFrame apsFrame;
+  EmberStatus status;
+  int16u i;
+
+  message->length = 1 + rand() % EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE;
+  message->failing = randomPercent(5);
+  message->failed = FALSE;
+  for (i = 0; i < message->length; i++) {
+    message->contents[i] = (int8u)rand();
+  }
+  MEMSET(message->received, 0, sizeof(message->received));
+  MEMSET(&apsFrame, 0, sizeof(apsFrame));
+  apsFrame.profileId = 0x0109;
+  apsFrame.clusterId = 0x0704;
+  message->active = TRUE;
+  status = emAfFragmentationSendUnicast(EMBER_OUTGOING_DIRECT,
+                                        destination,
+                                        &apsFrame,
+                                        message->contents,
+                                        message->length);
+  if (status != EMBER_SUCCESS) {
+    message->active = FALSE;
+  }
+  return status;
+}
+
+// Packets are sent to every destination at once, and their fragments are
+// reported sent in any order, now and again with a failure, until enough
+// packets have been reported.
+static boolean checkSending(int8u windowSize)
+{
+  int32u started = 0;
+  int8u tooLong[EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE + 1];
+  EmberApsFrame apsFrame;
+  int16u i;
+
+  emberFragmentWindowSize = windowSize;
+  emberAfPluginFragmentationInitCallback();
+  sentCount = 0;
+  reportedCount = 0;
+
+  for (i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS; i++) {
+    outgoing[i].active = FALSE;
+  }
+
+  while (reportedCount < TX_MESSAGE_COUNT && !failed) {
+    int16u index;
+    SentFragment fragment;
+    OutgoingMessage *message;
+    EmberStatus status;
+    int16u offset;
+
+    for (i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS; i++) {
+      if (!outgoing[i].active && started < TX_MESSAGE_COUNT) {
+        if (startOutgoing(i) != EMBER_SUCCESS) {
+          printf("Packet to %d could not be sent\n", i);
+          return FALSE;
+        }
+        started++;
+      }
+    }
+    if (started < TX_MESSAGE_COUNT) {
+      // Every entry is in use.
+      MEMSET(&apsFrame, 0, sizeof(apsFrame));
+      if (emAfFragmentationSendUnicast(EMBER_OUTGOING_DIRECT, 0, &apsFrame,
+                                       tooLong, 10)
+          != EMBER_MAX_MESSAGE_LIMIT_REACHED) {
+        printf("A packet was sent with every entry in use\n");
+        return FALSE;
+      }
+    }
+    if (sentCount == 0) {
+      break;
+    }
+
+    index = rand() % sentCount;
+    fragment = sent[index];
+    sent[index] = sent[--sentCount];
+    message = &outgoing[fragment.destination];
+    // Fragments of a packet that has already failed are still reported.
+    status = EMBER_SUCCESS;
+    if (message->active && fragment.apsFrame.sequence == message->sequence) {
+      offset = LOW_BYTE(fragment.apsFrame.groupId) * FRAGMENT_LENGTH;
+      MEMCOPY(message->received + offset, fragment.contents, fragment.length);
+      if (message->failing && randomPercent(30)) {
+        message->failed = TRUE;
+        status = EMBER_DELIVERY_FAILED;
+      }
+    }
+    emAfFragmentationMessageSent(&fragment.apsFrame, status);
+  }
+  if (failed) {
+    return FALSE;
+  }
+  for (i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS; i++) {
+    if (outgoing[i].active) {
+      printf("Packet to %d was never reported sent\n", i);
+      return FALSE;
+    }
+  }
+
+  MEMSET(&apsFrame, 0, sizeof(apsFrame));
+  if (emAfFragmentationSendUnicast(EMBER_OUTGOING_DIRECT, 0, &apsFrame,
+                                   tooLong, sizeof(tooLong))
+      != EMBER_MESSAGE_TOO_LONG) {
+    printf("A packet longer than the buffer was sent\n");
+    return FALSE;
+  }
+
+  printf("Window %d: %ld packets sent to %d destinations at once\n",
+         windowSize, (long)reportedCount,
+         EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS);
+  return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+  static const int8u windowSizes[] = { 1, 3, 8 };
+  int8u i;
+
+  srand(1);
+  nowMS = 0xFFFF0000UL;
+  for (i = 0; i < sizeof(windowSizes); i++) {
+    if (!checkReceiving(windowSizes[i])) {
+      return 1;
+    }
+  }
+  for (i = 0; i < sizeof(windowSizes); i++) {
+    if (!checkSending(windowSizes[i])) {
+      return 1;
+    }
+  }
+  return 0;
+}
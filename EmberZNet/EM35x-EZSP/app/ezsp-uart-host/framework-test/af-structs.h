@@ -0,0 +1,4 @@
+// af-structs.h
+//
+// Stands in for the generated command argument structs of an application for the
+// framework tests, which use none of them.
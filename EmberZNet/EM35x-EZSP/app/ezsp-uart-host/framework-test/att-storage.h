@@ -0,0 +1,20 @@
+// att-storage.h
+//
+// Stands in for the generated attribute and cluster masks of an application
+// for the framework tests.
+
+#define ATTRIBUTE_MASK_WRITABLE                 (0x01)
+#define ATTRIBUTE_MASK_TOKENIZE                 (0x02)
+#define ATTRIBUTE_MASK_MIN_MAX                  (0x04)
+#define ATTRIBUTE_MASK_MANUFACTURER_SPECIFIC    (0x08)
+#define ATTRIBUTE_MASK_EXTERNAL_STORAGE         (0x10)
+#define ATTRIBUTE_MASK_SINGLETON                (0x20)
+#define ATTRIBUTE_MASK_CLIENT                   (0x40)
+
+#define CLUSTER_MASK_INIT_FUNCTION                                    (0x01)
+#define CLUSTER_MASK_ATTRIBUTE_CHANGED_FUNCTION                       (0x02)
+#define CLUSTER_MASK_DEFAULT_RESPONSE_FUNCTION                        (0x04)
+#define CLUSTER_MASK_MESSAGE_SENT_FUNCTION                            (0x08)
+#define CLUSTER_MASK_MANUFACTURER_SPECIFIC_ATTRIBUTE_CHANGED_FUNCTION (0x10)
+#define CLUSTER_MASK_SERVER                                           (0x40)
+#define CLUSTER_MASK_CLIENT                                           (0x80)
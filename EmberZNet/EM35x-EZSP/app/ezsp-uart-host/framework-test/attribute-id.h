@@ -0,0 +1,18 @@
+// attribute-id.h
+//
+// Stands in for the generated attribute ids of an application for the
+// framework tests.  Only the attributes the Scenes plugin uses are given.
+
+// Scenes cluster
+#define ZCL_SCENE_COUNT_ATTRIBUTE_ID        0x0000
+#define ZCL_CURRENT_SCENE_ATTRIBUTE_ID      0x0001
+#define ZCL_CURRENT_GROUP_ATTRIBUTE_ID      0x0002
+#define ZCL_SCENE_VALID_ATTRIBUTE_ID        0x0003
+#define ZCL_SCENE_NAME_SUPPORT_ATTRIBUTE_ID 0x0004
+
+// On/off cluster
+#define ZCL_ON_OFF_ATTRIBUTE_ID               0x0000
+#define ZCL_GLOBAL_SCENE_CONTROL_ATTRIBUTE_ID 0x4000
+
+// Level Control cluster
+#define ZCL_CURRENT_LEVEL_ATTRIBUTE_ID 0x0000
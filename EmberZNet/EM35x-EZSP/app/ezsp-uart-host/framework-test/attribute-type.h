@@ -0,0 +1,47 @@
+// attribute-type.h
+//
+// Stands in for the generated ZCL attribute types of an application for the
+// framework tests.
+
+enum {
+  ZCL_NO_DATA_ATTRIBUTE_TYPE           = 0x00,
+  ZCL_DATA8_ATTRIBUTE_TYPE             = 0x08,
+  ZCL_DATA16_ATTRIBUTE_TYPE            = 0x09,
+  ZCL_DATA24_ATTRIBUTE_TYPE            = 0x0A,
+  ZCL_DATA32_ATTRIBUTE_TYPE            = 0x0B,
+  ZCL_BOOLEAN_ATTRIBUTE_TYPE           = 0x10,
+  ZCL_BITMAP8_ATTRIBUTE_TYPE           = 0x18,
+  ZCL_BITMAP16_ATTRIBUTE_TYPE          = 0x19,
+  ZCL_BITMAP24_ATTRIBUTE_TYPE          = 0x1A,
+  ZCL_BITMAP32_ATTRIBUTE_TYPE          = 0x1B,
+  ZCL_INT8U_ATTRIBUTE_TYPE             = 0x20,
+  ZCL_INT16U_ATTRIBUTE_TYPE            = 0x21,
+  ZCL_INT24U_ATTRIBUTE_TYPE            = 0x22,
+  ZCL_INT32U_ATTRIBUTE_TYPE            = 0x23,
+  ZCL_INT48U_ATTRIBUTE_TYPE            = 0x25,
+  ZCL_INT8S_ATTRIBUTE_TYPE             = 0x28,
+  ZCL_INT16S_ATTRIBUTE_TYPE            = 0x29,
+  ZCL_INT24S_ATTRIBUTE_TYPE            = 0x2A,
+  ZCL_INT32S_ATTRIBUTE_TYPE            = 0x2B,
+  ZCL_INT48S_ATTRIBUTE_TYPE            = 0x2D,
+  ZCL_ENUM8_ATTRIBUTE_TYPE             = 0x30,
+  ZCL_ENUM16_ATTRIBUTE_TYPE            = 0x31,
+  ZCL_FLOAT_SEMI_ATTRIBUTE_TYPE        = 0x38,
+  ZCL_FLOAT_SINGLE_ATTRIBUTE_TYPE      = 0x39,
+  ZCL_FLOAT_DOUBLE_ATTRIBUTE_TYPE      = 0x3A,
+  ZCL_OCTET_STRING_ATTRIBUTE_TYPE      = 0x41,
+  ZCL_CHAR_STRING_ATTRIBUTE_TYPE       = 0x42,
+  ZCL_LONG_OCTET_STRING_ATTRIBUTE_TYPE = 0x43,
+  ZCL_LONG_CHAR_STRING_ATTRIBUTE_TYPE  = 0x44,
+  ZCL_ARRAY_ATTRIBUTE_TYPE             = 0x48,
+  ZCL_STRUCT_ATTRIBUTE_TYPE            = 0x4C,
+  ZCL_TIME_OF_DAY_ATTRIBUTE_TYPE       = 0xE0,
+  ZCL_DATE_ATTRIBUTE_TYPE              = 0xE1,
+  ZCL_UTC_TIME_ATTRIBUTE_TYPE          = 0xE2,
+  ZCL_CLUSTER_ID_ATTRIBUTE_TYPE        = 0xE8,
+  ZCL_ATTRIBUTE_ID_ATTRIBUTE_TYPE      = 0xE9,
+  ZCL_BACNET_OID_ATTRIBUTE_TYPE        = 0xEA,
+  ZCL_IEEE_ADDRESS_ATTRIBUTE_TYPE      = 0xF0,
+  ZCL_SECURITY_KEY_ATTRIBUTE_TYPE      = 0xF1,
+  ZCL_UNKNOWN_ATTRIBUTE_TYPE           = 0xFF,
+};
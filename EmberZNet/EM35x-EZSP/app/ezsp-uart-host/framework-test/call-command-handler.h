@@ -0,0 +1,4 @@
+// call-command-handler.h
+//
+// Stands in for the generated command handler prototypes of an application for the
+// framework tests, which use none of them.
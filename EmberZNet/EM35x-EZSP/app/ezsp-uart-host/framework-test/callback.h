@@ -0,0 +1,72 @@
+// callback.h
+//
+// Stands in for the generated callback prototypes of an application for the
+// framework tests.  Each test defines the callbacks the framework code it
+// builds calls.
+
+void emberAfClusterInitCallback(int8u endpoint, EmberAfClusterId clusterId);
+EmberAfStatus emberAfExternalAttributeReadCallback(int8u endpoint,
+                                                   EmberAfClusterId clusterId,
+                                                   EmberAfAttributeMetadata *attributeMetadata,
+                                                   int16u manufacturerCode,
+                                                   int8u *buffer);
+EmberAfStatus emberAfExternalAttributeWriteCallback(int8u endpoint,
+                                                    EmberAfClusterId clusterId,
+                                                    EmberAfAttributeMetadata *attributeMetadata,
+                                                    int16u manufacturerCode,
+                                                    int8u *buffer);
+
+// Reporting plugin
+void emberAfPluginReportingInitCallback(void);
+void emberAfPluginReportingTickEventHandler(void);
+EmberStatus emberAfClearReportTableCallback(void);
+EmberStatus emberAfClearEndpointReportTableCallback(int8u endpoint);
+void emberAfReportingAttributeChangeCallback(int8u endpoint,
+                                             EmberAfClusterId clusterId,
+                                             EmberAfAttributeId attributeId,
+                                             int8u mask,
+                                             int16u manufacturerCode,
+                                             EmberAfAttributeType type,
+                                             int8u *data);
+
+// Groups Server Cluster plugin
+boolean emberAfGroupsClusterEndpointInGroupCallback(int8u endpoint,
+                                                    int16u groupId);
+
+// Scenes plugin
+void emberAfScenesClusterServerInitCallback(int8u endpoint);
+boolean emberAfScenesClusterAddSceneCallback(int16u groupId,
+                                             int8u sceneId,
+                                             int16u transitionTime,
+                                             int8u *sceneName,
+                                             int8u *extensionFieldSets);
+boolean emberAfScenesClusterViewSceneCallback(int16u groupId, int8u sceneId);
+boolean emberAfScenesClusterRemoveSceneCallback(int16u groupId, int8u sceneId);
+boolean emberAfScenesClusterRemoveAllScenesCallback(int16u groupId);
+boolean emberAfScenesClusterStoreSceneCallback(int16u groupId, int8u sceneId);
+boolean emberAfScenesClusterRecallSceneCallback(int16u groupId, int8u sceneId);
+boolean emberAfScenesClusterGetSceneMembershipCallback(int16u groupId);
+EmberAfStatus emberAfScenesClusterStoreCurrentSceneCallback(int8u endpoint,
+                                                            int16u groupId,
+                                                            int8u sceneId);
+EmberAfStatus emberAfScenesClusterRecallSavedSceneCallback(int8u endpoint,
+                                                           int16u groupId,
+                                                           int8u sceneId);
+void emberAfScenesClusterClearSceneTableCallback(int8u endpoint);
+EmberAfStatus emberAfScenesClusterMakeInvalidCallback(int8u endpoint);
+void emberAfScenesClusterRemoveScenesInGroupCallback(int8u endpoint,
+                                                       int16u groupId);
+
+// ZLL Scenes Server Cluster Enhancements plugin
+boolean emberAfScenesClusterEnhancedAddSceneCallback(int16u groupId,
+                                                     int8u sceneId,
+                                                     int16u transitionTime,
+                                                     int8u *sceneName,
+                                                     int8u *extensionFieldSets);
+boolean emberAfScenesClusterEnhancedViewSceneCallback(int16u groupId,
+                                                      int8u sceneId);
+boolean emberAfScenesClusterCopySceneCallback(int8u mode,
+                                              int16u groupIdFrom,
+                                              int8u sceneIdFrom,
+                                              int16u groupIdTo,
+                                              int8u sceneIdTo);
@@ -0,0 +1,50 @@
+// client-command-macro.h
+//
+// Stands in for the generated command fill macros of an application for the
+// framework tests.  Only the Scenes responses the framework fills are given.
+
+#define emberAfFillCommandScenesClusterRemoveSceneResponse(status,           \
+                                                           groupId,          \
+                                                           sceneId)          \
+  emberAfFillExternalBuffer((ZCL_CLUSTER_SPECIFIC_COMMAND                    \
+                             | ZCL_FRAME_CONTROL_SERVER_TO_CLIENT),          \
+                            ZCL_SCENES_CLUSTER_ID,                           \
+                            ZCL_REMOVE_SCENE_RESPONSE_COMMAND_ID,            \
+                            "uvu",                                           \
+                            status,                                          \
+                            groupId,                                         \
+                            sceneId);
+
+#define emberAfFillCommandScenesClusterRemoveAllScenesResponse(status,       \
+                                                               groupId)      \
+  emberAfFillExternalBuffer((ZCL_CLUSTER_SPECIFIC_COMMAND                    \
+                             | ZCL_FRAME_CONTROL_SERVER_TO_CLIENT),          \
+                            ZCL_SCENES_CLUSTER_ID,                           \
+                            ZCL_REMOVE_ALL_SCENES_RESPONSE_COMMAND_ID,       \
+                            "uv",                                            \
+                            status,                                          \
+                            groupId);
+
+#define emberAfFillCommandScenesClusterStoreSceneResponse(status,            \
+                                                          groupId,           \
+                                                          sceneId)           \
+  emberAfFillExternalBuffer((ZCL_CLUSTER_SPECIFIC_COMMAND                    \
+                             | ZCL_FRAME_CONTROL_SERVER_TO_CLIENT),          \
+                            ZCL_SCENES_CLUSTER_ID,                           \
+                            ZCL_STORE_SCENE_RESPONSE_COMMAND_ID,             \
+                            "uvu",                                           \
+                            status,                                          \
+                            groupId,                                         \
+                            sceneId);
+
+#define emberAfFillCommandScenesClusterCopySceneResponse(status,             \
+                                                         groupIdFrom,        \
+                                                         sceneIdFrom)        \
+  emberAfFillExternalBuffer((ZCL_CLUSTER_SPECIFIC_COMMAND                    \
+                             | ZCL_FRAME_CONTROL_SERVER_TO_CLIENT),          \
+                            ZCL_SCENES_CLUSTER_ID,                           \
+                            ZCL_COPY_SCENE_RESPONSE_COMMAND_ID,              \
+                            "uvu",                                           \
+                            status,                                          \
+                            groupIdFrom,                                     \
+                            sceneIdFrom);
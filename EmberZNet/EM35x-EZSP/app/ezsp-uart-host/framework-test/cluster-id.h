@@ -0,0 +1,10 @@
+// cluster-id.h
+//
+// Stands in for the generated cluster ids of an application for the
+// framework tests.
+
+#define ZCL_BASIC_CLUSTER_ID         0x0000
+#define ZCL_IDENTIFY_CLUSTER_ID      0x0003
+#define ZCL_SCENES_CLUSTER_ID        0x0005
+#define ZCL_ON_OFF_CLUSTER_ID        0x0006
+#define ZCL_LEVEL_CONTROL_CLUSTER_ID 0x0008
@@ -0,0 +1,43 @@
+// command-id.h
+//
+// Stands in for the generated command ids of an application for the
+// framework tests.  Only the global commands the framework sends and the
+// commands of the Scenes cluster are given.
+
+#define ZCL_READ_ATTRIBUTES_COMMAND_ID                       0x00
+#define ZCL_READ_ATTRIBUTES_RESPONSE_COMMAND_ID              0x01
+#define ZCL_WRITE_ATTRIBUTES_COMMAND_ID                      0x02
+#define ZCL_WRITE_ATTRIBUTES_UNDIVIDED_COMMAND_ID            0x03
+#define ZCL_WRITE_ATTRIBUTES_RESPONSE_COMMAND_ID             0x04
+#define ZCL_WRITE_ATTRIBUTES_NO_RESPONSE_COMMAND_ID          0x05
+#define ZCL_CONFIGURE_REPORTING_COMMAND_ID                   0x06
+#define ZCL_CONFIGURE_REPORTING_RESPONSE_COMMAND_ID          0x07
+#define ZCL_READ_REPORTING_CONFIGURATION_COMMAND_ID          0x08
+#define ZCL_READ_REPORTING_CONFIGURATION_RESPONSE_COMMAND_ID 0x09
+#define ZCL_REPORT_ATTRIBUTES_COMMAND_ID                     0x0A
+#define ZCL_DEFAULT_RESPONSE_COMMAND_ID                      0x0B
+#define ZCL_DISCOVER_ATTRIBUTES_COMMAND_ID                   0x0C
+#define ZCL_DISCOVER_ATTRIBUTES_RESPONSE_COMMAND_ID          0x0D
+
+// Scenes cluster, client to server
+#define ZCL_ADD_SCENE_COMMAND_ID                             0x00
+#define ZCL_VIEW_SCENE_COMMAND_ID                            0x01
+#define ZCL_REMOVE_SCENE_COMMAND_ID                          0x02
+#define ZCL_REMOVE_ALL_SCENES_COMMAND_ID                     0x03
+#define ZCL_STORE_SCENE_COMMAND_ID                           0x04
+#define ZCL_RECALL_SCENE_COMMAND_ID                          0x05
+#define ZCL_GET_SCENE_MEMBERSHIP_COMMAND_ID                  0x06
+#define ZCL_ENHANCED_ADD_SCENE_COMMAND_ID                    0x40
+#define ZCL_ENHANCED_VIEW_SCENE_COMMAND_ID                   0x41
+#define ZCL_COPY_SCENE_COMMAND_ID                            0x42
+
+// Scenes cluster, server to client
+#define ZCL_ADD_SCENE_RESPONSE_COMMAND_ID                    0x00
+#define ZCL_VIEW_SCENE_RESPONSE_COMMAND_ID                   0x01
+#define ZCL_REMOVE_SCENE_RESPONSE_COMMAND_ID                 0x02
+#define ZCL_REMOVE_ALL_SCENES_RESPONSE_COMMAND_ID            0x03
+#define ZCL_STORE_SCENE_RESPONSE_COMMAND_ID                  0x04
+#define ZCL_GET_SCENE_MEMBERSHIP_RESPONSE_COMMAND_ID         0x06
+#define ZCL_ENHANCED_ADD_SCENE_RESPONSE_COMMAND_ID           0x40
+#define ZCL_ENHANCED_VIEW_SCENE_RESPONSE_COMMAND_ID          0x41
+#define ZCL_COPY_SCENE_RESPONSE_COMMAND_ID                   0x42
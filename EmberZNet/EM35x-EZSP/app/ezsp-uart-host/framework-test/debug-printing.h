@@ -0,0 +1,32 @@
+// debug-printing.h
+//
+// Stands in for the generated debug printing switches of an application for
+// the framework tests.  Printing is off for every area the tests build.
+
+#define emberAfCorePrint(...)
+#define emberAfCorePrintln(...)
+#define emberAfCoreFlush()
+#define emberAfCoreDebugExec(x)
+#define emberAfCorePrintBuffer(buffer, len, withSpace)
+#define emberAfCorePrintString(buffer)
+
+#define emberAfDebugPrint(...)
+#define emberAfDebugPrintln(...)
+#define emberAfDebugFlush()
+#define emberAfDebugDebugExec(x)
+#define emberAfDebugPrintBuffer(buffer, len, withSpace)
+#define emberAfDebugPrintString(buffer)
+
+#define emberAfReportingPrint(...)
+#define emberAfReportingPrintln(...)
+#define emberAfReportingFlush()
+#define emberAfReportingDebugExec(x)
+#define emberAfReportingPrintBuffer(buffer, len, withSpace)
+#define emberAfReportingPrintString(buffer)
+
+#define emberAfScenesClusterPrint(...)
+#define emberAfScenesClusterPrintln(...)
+#define emberAfScenesClusterFlush()
+#define emberAfScenesClusterDebugExec(x)
+#define emberAfScenesClusterPrintBuffer(buffer, len, withSpace)
+#define emberAfScenesClusterPrintString(buffer)
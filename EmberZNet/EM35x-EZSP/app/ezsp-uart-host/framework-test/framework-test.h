@@ -0,0 +1,8 @@
+// framework-test.h
+//
+// Stands in for the configuration AppBuilder generates for an application,
+// included by app/framework/util/config.h as ZA_GENERATED_HEADER, for the
+// framework tests built by the ezsp-uart-host Makefile.  The endpoints are
+// those of app/framework/util/attribute-storage-test.h.
+
+#define ATTRIBUTE_STORAGE_CONFIGURATION "attribute-storage-test.h"
@@ -0,0 +1,4 @@
+// hal-callback.h
+//
+// Stands in for the generated HAL callback prototypes of an application for the
+// framework tests, which use none of them.
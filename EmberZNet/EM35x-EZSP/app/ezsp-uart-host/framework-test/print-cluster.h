@@ -0,0 +1,4 @@
+// print-cluster.h
+//
+// Stands in for the generated cluster names for printing of an application for the
+// framework tests, which use none of them.
@@ -0,0 +1,6 @@
+// reporting-callback.h
+//
+// Stands in for the generated callback prototypes of the Reporting plugin for
+// the framework tests.
+
+EmberAfStatus emberAfPluginReportingConfiguredCallback(const EmberAfPluginReportingEntry *entry);
@@ -0,0 +1,4 @@
+// stack-handlers.h
+//
+// Stands in for the generated stack handler switches of an application for the
+// framework tests, which use none of them.
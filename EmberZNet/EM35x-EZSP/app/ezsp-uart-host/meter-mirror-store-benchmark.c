@@ -0,0 +1,345 @@
+/** @file meter-mirror-store-benchmark.c
+ *  @brief Times the meter mirror store with a fleet of meters
+ *
+ * Fills a meter mirror store in a temporary directory with a week of the
+ * readings a gateway receives from a fleet of meters: every hour each meter
+ * delivers a Get Profile Response with its last six 15 minute intervals, so
+ * that each interval arrives more than once, and reports its summation.  The
+ * ingest is timed and the size of the store compared with fixed size
+ * readings.  The store is then closed and opened again, the mirrors saved
+ * before it was closed are loaded and checked, and random day long ranges of
+ * intervals and summations are read and random Get Profile commands answered
+ * from it, each checked against the readings the meters made, and timed.
+ *
+ * <!-- Copyright 2012 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "stack/include/ember-types.h"
+#include "stack/include/error.h"
+#include "app/framework/plugin/meter-mirror-store/meter-mirror-store.h"
+
+#define METER_COUNT            5000
+#define DAY_COUNT              7
+#define INTERVAL_PERIOD        3         // 15 minutes
+#define INTERVAL_SECONDS       900
+#define INTERVALS_PER_HOUR     4
+#define PERIODS_PER_RESPONSE   6
+#define START_TIME             0x17000000UL
+#define HOUR_COUNT             (DAY_COUNT * 24)
+#define DAY_SECONDS            86400UL
+#define QUERY_COUNT            20000
+#define FIXED_READING_SIZE     (sizeof(int32u) + sizeof(int64u))
+
+static char directory[] = "/tmp/meter-mirror-store-XXXXXX";
+static int64u summations[METER_COUNT];
+
+static void meterEui64(int16u meter, EmberEUI64 eui64)
+{
+  eui64[0] = LOW_BYTE(meter);
+  eui64[1] = HIGH_BYTE(meter);
+  eui64[2] = 0x5A;
+  eui64[3] = 0x00;
+  eui64[4] = 0x0D;
+  eui64[5] = 0x6F;
+  eui64[6] = 0x00;
+  eui64[7] = 0x00;
+}
+
+// The consumption of a meter in the interval ending at a time: a daily
+// pattern with some noise.
+static int32u intervalValue(int16u meter, int32u time)
+{
+  int32u hour = (time / 3600) % 24;
+  int32u hash = (meter * 2654435761UL) ^ (time * 40503UL);
+  hash ^= hash >> 13;
+  return (200
+          + (hour >= 7 && hour < 23 ? 300 : 0)
+          + (meter % 7) * 50
+          + hash % 120);
+}
+
+static int64u summationAt(int16u meter, int32u hourEnd)
+{
+  int64u summation = (int64u)meter * 1000;
+  int32u time;
+  for (time = START_TIME + INTERVAL_SECONDS;
+       time <= hourEnd;
+       time += INTERVAL_SECONDS) {
+    summation += intervalValue(meter, time);
+  }
+  return summation;
+}
+
+static double seconds(clock_t start)
+{
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static boolean ingest(void)
+{
+  int32u intervals[PERIODS_PER_RESPONSE];
+  EmberEUI64 eui64;
+  int32u hourEnd;
+  int16u meter;
+  int16u hour;
+  int8u i;
+
+  for (meter = 0; meter < METER_COUNT; meter++) {
+    summations[meter] = (int64u)meter * 1000;
+  }
+  for (hour = 0; hour < HOUR_COUNT; hour++) {
+    hourEnd = START_TIME + (hour + 1) * 3600UL;
+    for (meter = 0; meter < METER_COUNT; meter++) {
+      meterEui64(meter, eui64);
+      for (i = 0; i < PERIODS_PER_RESPONSE; i++) {
+        intervals[i] = intervalValue(meter, hourEnd - i * INTERVAL_SECONDS);
+      }
+      for (i = 0; i < INTERVALS_PER_HOUR; i++) {
+        summations[meter] += intervals[i];
+      }
+      if (emberAfPluginMeterMirrorStoreAppendProfile(eui64,
+                                                     EMBER_AF_PLUGIN_METER_MIRROR_STORE_INTERVAL_DELIVERED,
+                                                     hourEnd,
+                                                     INTERVAL_PERIOD,
+                                                     (hour == 0
+                                                      ? INTERVALS_PER_HOUR
+                                                      : PERIODS_PER_RESPONSE),
+                                                     intervals)
+            != EMBER_SUCCESS
+          || emberAfPluginMeterMirrorStoreAppend(eui64,
+                                                 EMBER_AF_PLUGIN_METER_MIRROR_STORE_SUMMATION_DELIVERED,
+                                                 hourEnd,
+                                                 summations[meter])
+             != EMBER_SUCCESS) {
+        printf("Failed to store the readings of meter %d at hour %d\n",
+               meter, hour);
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+static boolean readRanges(void)
+{
+  EmberAfMeterReading readings[100];
+  EmberEUI64 eui64;
+  int32u startTime, expected, count, q, i;
+  int16u meter;
+  int16u day;
+
+  for (q = 0; q < QUERY_COUNT; q++) {
+    meter = rand() % METER_COUNT;
+    meterEui64(meter, eui64);
+    day = rand() % DAY_COUNT;
+    startTime = START_TIME + day * DAY_SECONDS + 1;
+
+    count = emberAfPluginMeterMirrorStoreRead(eui64,
+                                              EMBER_AF_PLUGIN_METER_MIRROR_STORE_INTERVAL_DELIVERED,
+                                              startTime,
+                                              startTime + DAY_SECONDS - 1,
+                                              readings,
+                                              100);
+    if (count != DAY_SECONDS / INTERVAL_SECONDS) {
+      printf("Read %ld intervals of meter %d on day %d\n",
+             (long)count, meter, day);
+      return FALSE;
+    }
+    for (i = 0; i < count; i++) {
+      expected = startTime - 1 + (i + 1) * INTERVAL_SECONDS;
+      if (readings[i].time != expected
+          || readings[i].value != intervalValue(meter, expected)) {
+        printf("Interval %ld of meter %d on day %d is wrong\n",
+               (long)i, meter, day);
+        return FALSE;
+      }
+    }
+
+    count = emberAfPluginMeterMirrorStoreRead(eui64,
+                                              EMBER_AF_PLUGIN_METER_MIRROR_STORE_SUMMATION_DELIVERED,
+                                              startTime,
+                                              startTime + DAY_SECONDS - 1,
+                                              readings,
+                                              100);
+    if (count != 24
+        || readings[23].value != summationAt(meter, readings[23].time)) {
+      printf("The summations of meter %d on day %d are wrong\n", meter, day);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static boolean getProfiles(void)
+{
+  int32u intervals[EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS];
+  EmberEUI64 eui64;
+  int32u endTime, requested, q;
+  int16u meter;
+  int8u intervalPeriod;
+  int8u count, i;
+
+  for (q = 0; q < QUERY_COUNT; q++) {
+    meter = rand() % METER_COUNT;
+    meterEui64(meter, eui64);
+    // An end time in the middle of an interval gets the interval before.
+    requested = (START_TIME
+                 + DAY_SECONDS
+                 + rand() % ((DAY_COUNT - 1) * DAY_SECONDS));
+    endTime = requested;
+    count = emberAfPluginMeterMirrorStoreGetProfile(eui64,
+                                                    EMBER_AF_PLUGIN_METER_MIRROR_STORE_INTERVAL_DELIVERED,
+                                                    &endTime,
+                                                    &intervalPeriod,
+                                                    24,
+                                                    intervals);
+    if (count != 24
+        || intervalPeriod != INTERVAL_PERIOD
+        || endTime != requested - (requested - START_TIME) % INTERVAL_SECONDS) {
+      printf("Get Profile of meter %d at 0x%08lX gave %d intervals to 0x%08lX\n",
+             meter, (long)requested, count, (long)endTime);
+      return FALSE;
+    }
+    for (i = 0; i < count; i++) {
+      if (intervals[i] != intervalValue(meter,
+                                        endTime - i * INTERVAL_SECONDS)) {
+        printf("Get Profile interval %d of meter %d is wrong\n", i, meter);
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+// Every other endpoint mirrors a meter.
+static void mirrorsOf(EmberEUI64 *meters, boolean *isMirror)
+{
+  int16u endpoint;
+  for (endpoint = 0;
+       endpoint < EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT;
+       endpoint++) {
+    isMirror[endpoint] = (endpoint % 2 == 1);
+    meterEui64(endpoint * 19, meters[endpoint]);
+  }
+}
+
+static boolean saveMirrors(void)
+{
+  EmberEUI64 meters[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+  boolean isMirror[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+  mirrorsOf(meters, isMirror);
+  if (emberAfPluginMeterMirrorStoreSaveMirrors(meters, isMirror)
+      != EMBER_SUCCESS) {
+    printf("Failed to save the mirrors\n");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean checkMirrors(void)
+{
+  EmberEUI64 meters[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+  boolean isMirror[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+  EmberEUI64 loadedMeters[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+  boolean loadedIsMirror[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+  int16u endpoint;
+
+  mirrorsOf(meters, isMirror);
+  if (emberAfPluginMeterMirrorStoreLoadMirrors(loadedMeters, loadedIsMirror)
+      != EMBER_SUCCESS) {
+    printf("Failed to load the mirrors\n");
+    return FALSE;
+  }
+  for (endpoint = 0;
+       endpoint < EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT;
+       endpoint++) {
+    if (loadedIsMirror[endpoint] != isMirror[endpoint]
+        || (isMirror[endpoint]
+            && MEMCOMPARE(loadedMeters[endpoint],
+                          meters[endpoint],
+                          EUI64_SIZE) != 0)) {
+      printf("Mirror endpoint %d was not loaded\n", endpoint);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static void removeStore(void)
+{
+  char path[1000];
+  struct dirent *entry;
+  DIR *dir = opendir(directory);
+  if (dir != NULL) {
+    while ((entry = readdir(dir)) != NULL) {
+      if (entry->d_name[0] != '.') {
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        unlink(path);
+      }
+    }
+    closedir(dir);
+  }
+  rmdir(directory);
+}
+
+int main(int argc, char *argv[])
+{
+  int32u readingCount = ((int32u)METER_COUNT
+                         * HOUR_COUNT
+                         * (INTERVALS_PER_HOUR + 1));
+  double ingestTime, rangeTime, profileTime;
+  int64u size;
+  boolean ok;
+  clock_t start;
+
+  if (mkdtemp(directory) == NULL
+      || emberAfPluginMeterMirrorStoreOpen(directory) != EMBER_SUCCESS) {
+    printf("Failed to open a store in %s\n", directory);
+    return 1;
+  }
+
+  start = clock();
+  ok = ingest();
+  ingestTime = seconds(start);
+  ok = ok && saveMirrors();
+  size = emberAfPluginMeterMirrorStoreSize();
+  emberAfPluginMeterMirrorStoreFlush();
+  emberAfPluginMeterMirrorStoreClose();
+
+  if (ok) {
+    srand(1);
+    emberAfPluginMeterMirrorStoreOpen(directory);
+    ok = checkMirrors();
+    start = clock();
+    ok = ok && readRanges();
+    rangeTime = seconds(start);
+    start = clock();
+    ok = ok && getProfiles();
+    profileTime = seconds(start);
+    emberAfPluginMeterMirrorStoreClose();
+  }
+  removeStore();
+  if (!ok) {
+    return 1;
+  }
+
+  printf("%d meters, %d days of 15 minute intervals and hourly summations:\n",
+         METER_COUNT, DAY_COUNT);
+  printf("ingest:     %8ld readings  %8.3f s  %10.0f readings/s\n",
+         (long)readingCount, ingestTime, readingCount / ingestTime);
+  // The size is an int64u, which a long may not hold.
+  printf("store:      %8.0f bytes     %8.2f bytes/reading  (%d fixed)\n",
+         (double)size, (double)size / readingCount, (int)FIXED_READING_SIZE);
+  printf("day ranges: %8d queries   %8.3f s  %10.0f queries/s\n",
+         QUERY_COUNT * 2, rangeTime, QUERY_COUNT * 2 / rangeTime);
+  printf("profiles:   %8d queries   %8.3f s  %10.0f queries/s\n",
+         QUERY_COUNT, profileTime, QUERY_COUNT / profileTime);
+  return 0;
+}
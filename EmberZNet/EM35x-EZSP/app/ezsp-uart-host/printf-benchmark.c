@@ -0,0 +1,116 @@
+/** @file printf-benchmark.c
+ *  @brief Compares cached and uncached conversion of Ember printf formats
+ *
+ * Converts a set of Ember printf formats of the kind the application
+ * framework prints with transformEmberPrintfToStandardPrintf(), which
+ * allocates a new string every time, and with the cached version that
+ * linux-serial.c now uses.  The two must give the same string for every
+ * format, including formats built at run time in a buffer that is reused for
+ * different text.  Both are then timed over the same sequence of formats.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack/include/ember-types.h"
+#include "app/util/serial/ember-printf-convert.h"
+
+#define CALL_COUNT    2000000
+#define BUFFER_PERIOD 7
+
+static const char* formats[] = {
+  "%p: %x",
+  "Ezsp Config: set %p to 0x%2x:",
+  "RX len %d, ep %x, clus 0x%2x (%p) FC %x seq %x cmd %x payload[",
+  "%x ",
+  "]\r\n",
+  "T%4x:RX len %d, ep %x, clus 0x%2x (%p) mfgId %2x FC %x seq %x cmd %x",
+  "Device Announce: 0x%2x\r\n",
+  "node [(>)%x%x%x%x%x%x%x%x] chan [%d] pwr [%d] panid [0x%2x]",
+  "EMBER_NETWORK_UP 0x%2x\r\n",
+  "%p %l %l %l\r\n",
+  "Processing message: len=%d profile=%2x cluster=%2x\r\n",
+  "no route, percent %d%%, counter %l\n",
+  "plain text with no conversions at all\r\n",
+  "%4X %2X %X\r\n",
+};
+#define FORMAT_COUNT (sizeof(formats) / sizeof(formats[0]))
+
+// A buffer reused for different formats, as code that builds a format with
+// sprintf() does.
+static char buffer[64];
+
+static const char* nextFormat(int32u call)
+{
+  if (call % BUFFER_PERIOD == 0) {
+    sprintf(buffer, "%s %%x %%2x", ((call / BUFFER_PERIOD) & 1) ? "odd" : "ev");
+    return buffer;
+  }
+  return formats[(call * 2654435761UL >> 8) % FORMAT_COUNT];
+}
+
+static boolean check(void)
+{
+  int32u call;
+  for (call = 0; call < CALL_COUNT / 10; call++) {
+    const char* format = nextFormat(call);
+    boolean filter = (call & 8) != 0;
+    char* converted = transformEmberPrintfToStandardPrintf(format, filter);
+    const char* cached = transformEmberPrintfToStandardPrintfCached(format,
+                                                                    filter);
+    if (converted == NULL || cached == NULL || strcmp(converted, cached) != 0) {
+      printf("Call %ld: \"%s\" converted to \"%s\" but cached as \"%s\"\n",
+             (long)call, format,
+             converted == NULL ? "(null)" : converted,
+             cached == NULL ? "(null)" : cached);
+      return FALSE;
+    }
+    free(converted);
+  }
+  printf("Cached and uncached conversions agree over %d calls\n",
+         CALL_COUNT / 10);
+  return TRUE;
+}
+
+static double timeCalls(boolean cached)
+{
+  clock_t start = clock();
+  int32u call;
+  int32u total = 0;
+
+  for (call = 0; call < CALL_COUNT; call++) {
+    const char* format = nextFormat(call);
+    if (cached) {
+      total += transformEmberPrintfToStandardPrintfCached(format, TRUE)[0];
+    } else {
+      char* converted = transformEmberPrintfToStandardPrintf(format, TRUE);
+      total += converted[0];
+      free(converted);
+    }
+  }
+  if (total == 0) {
+    printf("No output\n");
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+  double cachedTime;
+  double convertTime;
+
+  if (!check()) {
+    return 1;
+  }
+  cachedTime = timeCalls(TRUE);
+  convertTime = timeCalls(FALSE);
+  printf("cached:    %8.3f s  %8.3f us/call\n",
+         cachedTime, cachedTime * 1000000.0 / CALL_COUNT);
+  printf("converted: %8.3f s  %8.3f us/call\n",
+         convertTime, convertTime * 1000000.0 / CALL_COUNT);
+  return 0;
+}
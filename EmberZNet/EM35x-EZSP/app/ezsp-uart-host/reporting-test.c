@@ -0,0 +1,585 @@
+/** @file reporting-test.c
+ *  @brief Checks the reporting plugin against a model of the reporting rules
+ *
+ * Builds the Reporting plugin with the stand-ins for the generated headers in
+ * framework-test and a simulation of the parts of the framework it calls: a
+ * millisecond clock started close to wrapping, the attributes of a few
+ * endpoints and the frames it sends.  A model keeps the reporting
+ * configuration of every attribute and applies the ZCL rules to it: an
+ * attribute is reported once its minimum interval has passed after a
+ * reportable change, or once its maximum interval, if it has one, has passed
+ * since its last report.  A random series of configurations, removals,
+ * attribute writes and endpoints being cleared is applied to both, with the
+ * clock advanced between steps, now and then past a tick that is run late.
+ * After each step the plugin's tick must be scheduled for the model's next
+ * report, and each tick must report exactly the attributes the model says are
+ * due, with their current values, in as few Report Attributes frames as the
+ * records fit in for each destination.
+ *
+ * <!-- Copyright 2011 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app/framework/include/af.h"
+#include "app/framework/util/common.h"
+#include "app/framework/plugin/reporting/reporting.h"
+
+// Clusters 1 and 2 have analog int16u attributes and clusters 3 and 4 have
+// discrete, manufacturer specific IEEE address attributes.  Server and client
+// attributes are configured and written separately.
+#define ENDPOINT_COUNT      4
+#define CLUSTER_COUNT       4
+#define ATTRIBUTE_COUNT     64
+#define MASK_COUNT          2
+#define VALUE_SIZE          8
+#define STEP_COUNT          200000
+#define CONFIGURE_STEPS     2600
+#define START_TIME          0xFFF00000UL
+#define MAX_STEP_MS         40
+#define LATE_TICK_ODDS      500
+#define MAX_LATE_MS         30000
+
+#define isAnalog(cluster) ((cluster) <= 2)
+#define attributeType(cluster)       \
+  (isAnalog(cluster)                 \
+   ? ZCL_INT16U_ATTRIBUTE_TYPE       \
+   : ZCL_IEEE_ADDRESS_ATTRIBUTE_TYPE)
+#define attributeSize(cluster) (isAnalog(cluster) ? 2 : 8)
+#define manufacturerCodeOf(cluster) \
+  (isAnalog(cluster) ? EMBER_AF_NULL_MANUFACTURER_CODE : 0x1002)
+#define maskOf(m) ((m) == 0 ? CLUSTER_MASK_SERVER : CLUSTER_MASK_CLIENT)
+
+// Report Attributes records are the attribute id, the type and the value,
+// after a ZCL header of three bytes, or five with a manufacturer code.  The
+// IEEE address records exactly fill a manufacturer specific frame.
+#define headerSize(cluster) (isAnalog(cluster) ? 3 : 5)
+#define RECORDS_PER_FRAME(cluster)                         \
+  (((EMBER_AF_RESPONSE_BUFFER_LEN) - headerSize(cluster))  \
+   / (3 + attributeSize(cluster)))
+
+typedef struct {
+  boolean isConfigured;
+  int16u minInterval;
+  int16u maxInterval;
+  int32u reportableChange;
+  boolean hasChanged;     // a reportable change since the last report
+  boolean isDue;          // to be reported by the current tick
+  int32u lastReportTime;
+  int8u lastReportValue[VALUE_SIZE];
+} Configuration;
+
+static Configuration configurations[ENDPOINT_COUNT]
+                                   [CLUSTER_COUNT]
+                                   [ATTRIBUTE_COUNT]
+                                   [MASK_COUNT];
+static int8u values[ENDPOINT_COUNT]
+                   [CLUSTER_COUNT]
+                   [ATTRIBUTE_COUNT]
+                   [MASK_COUNT]
+                   [VALUE_SIZE];
+static int16u configuredCount = 0;
+
+#define configuration(endpoint, cluster, attribute, m) \
+  (&configurations[(endpoint) - 1][(cluster) - 1][attribute][m])
+#define attributeValue(endpoint, cluster, attribute, m) \
+  (values[(endpoint) - 1][(cluster) - 1][attribute][m])
+
+//------------------------------------------------------------------------------
+// The simulated framework.
+
+extern EmberEventControl emberAfPluginReportingTickEventControl;
+
+static int32u now = START_TIME;
+
+// Host event controls do not have room for a millisecond time, so the time
+// the tick is scheduled for is kept here.
+static int32u tickTime;
+
+int8u appResponseData[EMBER_AF_RESPONSE_BUFFER_LEN];
+int16u appResponseLength;
+
+static EmberApsFrame apsFrame;
+static EmberAfClusterId frameCluster;
+static int8u frameMask;
+static Configuration *frameRecord;
+static int32u reportCount;
+static int32u frameCount;
+static boolean reportIsWrong;
+
+int32u halCommonGetInt32uMillisecondTick(void)
+{
+  return now;
+}
+
+EmberStatus emberAfEventControlSetDelay(EmberEventControl *eventControl,
+                                        int32u timeMs)
+{
+  eventControl->status = EMBER_EVENT_MS_TIME;
+  tickTime = now + timeMs;
+  return EMBER_SUCCESS;
+}
+
+boolean emberAfIsDeviceEnabled(int8u endpoint)
+{
+  return TRUE;
+}
+
+int8u emberAfGetAttributeAnalogOrDiscreteType(int8u dataType)
+{
+  return (dataType == ZCL_INT16U_ATTRIBUTE_TYPE
+          ? EMBER_AF_DATA_TYPE_ANALOG
+          : EMBER_AF_DATA_TYPE_DISCRETE);
+}
+
+int8u emberAfGetDataSize(int8u dataType)
+{
+  return (dataType == ZCL_INT16U_ATTRIBUTE_TYPE ? 2 : 8);
+}
+
+boolean emberAfIsThisDataTypeAStringType(int8u dataType)
+{
+  return FALSE;
+}
+
+boolean emberAfIsTypeSigned(int8u dataType)
+{
+  return FALSE;
+}
+
+int8u emberAfStringLength(const int8u *buffer)
+{
+  return 0;
+}
+
+// The configuration commands are not parsed; the test configures entries
+// directly.
+int32u emberAfGetInt(const int8u* message,
+                     int16u currentIndex,
+                     int16u msgLen,
+                     int8u bytes)
+{
+  return 0;
+}
+
+int16u emberAfGetInt16u(const int8u* message,
+                        int16u currentIndex,
+                        int16u msgLen)
+{
+  return 0;
+}
+
+EmberAfAttributeMetadata *emberAfLocateAttributeMetadata(int8u endpoint,
+                                                         EmberAfClusterId cluster,
+                                                         EmberAfAttributeId attributeId,
+                                                         int8u mask,
+                                                         int16u manufacturerCode)
+{
+  static EmberAfAttributeMetadata metadata;
+  if (endpoint < 1 || ENDPOINT_COUNT < endpoint
+      || cluster < 1 || CLUSTER_COUNT < cluster
+      || ATTRIBUTE_COUNT <= attributeId
+      || manufacturerCode != manufacturerCodeOf(cluster)) {
+    return NULL;
+  }
+  metadata.attributeId = attributeId;
+  metadata.attributeType = attributeType(cluster);
+  metadata.size = attributeSize(cluster);
+  return &metadata;
+}
+
+EmberAfStatus emAfReadAttribute(int8u endpoint,
+                                EmberAfClusterId cluster,
+                                EmberAfAttributeId attributeID,
+                                int8u mask,
+                                int16u manufacturerCode,
+                                int8u* dataPtr,
+                                int16u maxLength,
+                                int8u* dataType)
+{
+  int8u m = (mask == CLUSTER_MASK_SERVER ? 0 : 1);
+  MEMCOPY(dataPtr,
+          attributeValue(endpoint, cluster, attributeID, m),
+          attributeSize(cluster));
+  *dataType = attributeType(cluster);
+  return EMBER_ZCL_STATUS_SUCCESS;
+}
+
+EmberAfStatus emberAfPluginReportingConfiguredCallback(const EmberAfPluginReportingEntry *entry)
+{
+  return EMBER_ZCL_STATUS_SUCCESS;
+}
+
+EmberApsFrame *emberAfGetCommandApsFrame(void)
+{
+  return &apsFrame;
+}
+
+int16u emberAfFillExternalManufacturerSpecificBuffer(int8u frameControl,
+                                                     EmberAfClusterId clusterId,
+                                                     int16u manufacturerCode,
+                                                     int8u commandId,
+                                                     PGM_P format,
+                                                     ...)
+{
+  if (commandId != ZCL_REPORT_ATTRIBUTES_COMMAND_ID
+      || clusterId < 1 || CLUSTER_COUNT < clusterId
+      || manufacturerCode != manufacturerCodeOf(clusterId)) {
+    reportIsWrong = TRUE;
+  }
+  frameCluster = clusterId;
+  apsFrame.clusterId = clusterId;
+  frameMask = ((frameControl & ZCL_FRAME_CONTROL_SERVER_TO_CLIENT)
+               ? CLUSTER_MASK_SERVER
+               : CLUSTER_MASK_CLIENT);
+  appResponseLength = (manufacturerCode == EMBER_AF_NULL_MANUFACTURER_CODE
+                       ? 3
+                       : 5);
+  return appResponseLength;
+}
+
+// Each record starts with the attribute id, which must be one of the
+// attributes due for the frame's destination.
+void emberAfPutInt16uInResp(int16u value)
+{
+  int8u m = (frameMask == CLUSTER_MASK_SERVER ? 0 : 1);
+  frameRecord = NULL;
+  if (apsFrame.sourceEndpoint < 1 || ENDPOINT_COUNT < apsFrame.sourceEndpoint
+      || frameCluster < 1 || CLUSTER_COUNT < frameCluster
+      || ATTRIBUTE_COUNT <= value) {
+    reportIsWrong = TRUE;
+  } else {
+    frameRecord = configuration(apsFrame.sourceEndpoint,
+                                frameCluster,
+                                value,
+                                m);
+    if (!frameRecord->isDue) {
+      printf("Attribute 0x%X of cluster %d on endpoint %d is not due\n",
+             value,
+             frameCluster,
+             apsFrame.sourceEndpoint);
+      reportIsWrong = TRUE;
+    }
+    frameRecord->isDue = FALSE;
+    reportCount++;
+  }
+  appResponseLength += 2;
+}
+
+void emberAfPutInt8uInResp(int8u value)
+{
+  if (frameCluster < 1 || CLUSTER_COUNT < frameCluster
+      || value != attributeType(frameCluster)) {
+    reportIsWrong = TRUE;
+  }
+  appResponseLength++;
+}
+
+void emberAfPutBlockInResp(const int8u* data, int16u length)
+{
+  appResponseLength += length;
+  if (EMBER_AF_RESPONSE_BUFFER_LEN < appResponseLength
+      || frameRecord == NULL
+      || MEMCOMPARE(data, frameRecord->lastReportValue, length) != 0) {
+    reportIsWrong = TRUE;
+  }
+}
+
+EmberStatus emberAfSendCommandUnicastToBindings(void)
+{
+  frameCount++;
+  return EMBER_SUCCESS;
+}
+
+EmberStatus emberAfSendResponse(void)
+{
+  return EMBER_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// The model.
+
+static void configure(int8u endpoint,
+                      EmberAfClusterId cluster,
+                      EmberAfAttributeId attribute,
+                      int8u m,
+                      int16u minInterval,
+                      int16u maxInterval,
+                      int32u reportableChange)
+{
+  Configuration *c = configuration(endpoint, cluster, attribute, m);
+  EmberAfClusterCommand cmd;
+  EmberApsFrame commandApsFrame;
+  EmberAfStatus status;
+  EmberAfStatus expected = EMBER_ZCL_STATUS_SUCCESS;
+
+  MEMSET(&cmd, 0, sizeof(cmd));
+  MEMSET(&commandApsFrame, 0, sizeof(commandApsFrame));
+  commandApsFrame.destinationEndpoint = endpoint;
+  commandApsFrame.clusterId = cluster;
+  cmd.apsFrame = &commandApsFrame;
+  cmd.mfgCode = manufacturerCodeOf(cluster);
+  status = emAfPluginReportingConfigureReportedAttribute(&cmd,
+                                                         attribute,
+                                                         maskOf(m),
+                                                         attributeType(cluster),
+                                                         minInterval,
+                                                         maxInterval,
+                                                         reportableChange);
+
+  if (maxInterval == 0xFFFF) {
+    if (c->isConfigured) {
+      c->isConfigured = FALSE;
+      configuredCount--;
+    }
+  } else if (!c->isConfigured
+             && configuredCount == EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE) {
+    expected = EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
+  } else {
+    if (!c->isConfigured) {
+      c->isConfigured = TRUE;
+      c->hasChanged = FALSE;
+      c->lastReportTime = now;
+      MEMSET(c->lastReportValue, 0, VALUE_SIZE);
+      configuredCount++;
+    }
+    c->minInterval = minInterval;
+    c->maxInterval = maxInterval;
+    c->reportableChange = reportableChange;
+  }
+  if (status != expected) {
+    printf("Configuring attribute 0x%X of cluster %d on endpoint %d gave 0x%X\n",
+           attribute,
+           cluster,
+           endpoint,
+           status);
+    exit(1);
+  }
+}
+
+static void clearEndpoint(int8u endpoint)
+{
+  EmberAfClusterId cluster;
+  EmberAfAttributeId attribute;
+  int8u m;
+  emberAfClearEndpointReportTableCallback(endpoint);
+  for (cluster = 1; cluster <= CLUSTER_COUNT; cluster++) {
+    for (attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++) {
+      for (m = 0; m < MASK_COUNT; m++) {
+        Configuration *c = configuration(endpoint, cluster, attribute, m);
+        if (c->isConfigured) {
+          c->isConfigured = FALSE;
+          configuredCount--;
+        }
+      }
+    }
+  }
+}
+
+static void writeAttribute(int8u endpoint,
+                           EmberAfClusterId cluster,
+                           EmberAfAttributeId attribute,
+                           int8u m)
+{
+  Configuration *c = configuration(endpoint, cluster, attribute, m);
+  int8u *data = attributeValue(endpoint, cluster, attribute, m);
+
+  if (isAnalog(cluster)) {
+    int16u newValue = rand() % 3000;
+    data[0] = LOW_BYTE(newValue);
+    data[1] = HIGH_BYTE(newValue);
+  } else {
+    data[rand() % VALUE_SIZE] = rand();
+  }
+
+  if (c->isConfigured && !c->hasChanged) {
+    if (isAnalog(cluster)) {
+      int16u now16 = HIGH_LOW_TO_INT(data[1], data[0]);
+      int16u last16 = HIGH_LOW_TO_INT(c->lastReportValue[1],
+                                      c->lastReportValue[0]);
+      int16u difference = (now16 < last16 ? last16 - now16 : now16 - last16);
+      c->hasChanged = (c->reportableChange <= difference);
+    } else {
+      c->hasChanged = (MEMCOMPARE(data, c->lastReportValue, VALUE_SIZE) != 0);
+    }
+  }
+  emberAfReportingAttributeChangeCallback(endpoint,
+                                          cluster,
+                                          attribute,
+                                          maskOf(m),
+                                          manufacturerCodeOf(cluster),
+                                          attributeType(cluster),
+                                          data);
+}
+
+// Returns how long until the next report is due, or MAX_INT32U_VALUE if none
+// is.
+static int32u nextReportDelay(void)
+{
+  int32u delay = MAX_INT32U_VALUE;
+  int8u e, cl, m;
+  int16u a;
+  for (e = 0; e < ENDPOINT_COUNT; e++) {
+    for (cl = 0; cl < CLUSTER_COUNT; cl++) {
+      for (a = 0; a < ATTRIBUTE_COUNT; a++) {
+        for (m = 0; m < MASK_COUNT; m++) {
+          Configuration *c = &configurations[e][cl][a][m];
+          int32u elapsed = now - c->lastReportTime;
+          int32u interval;
+          if (!c->isConfigured
+              || (!c->hasChanged && c->maxInterval == 0)) {
+            continue;
+          }
+          interval = ((c->hasChanged ? c->minInterval : c->maxInterval)
+                      * MILLISECOND_TICKS_PER_SECOND);
+          if (interval <= elapsed) {
+            return 0;
+          } else if (interval - elapsed < delay) {
+            delay = interval - elapsed;
+          }
+        }
+      }
+    }
+  }
+  return delay;
+}
+
+// Marks the attributes that are due and returns how many there are, and in
+// frames the number of frames they fit in.
+static int32u dueReports(int32u *frames)
+{
+  int32u due = 0;
+  int8u e, cl, m;
+  int16u a;
+  *frames = 0;
+  for (e = 0; e < ENDPOINT_COUNT; e++) {
+    for (cl = 0; cl < CLUSTER_COUNT; cl++) {
+      for (m = 0; m < MASK_COUNT; m++) {
+        int32u records = 0;
+        for (a = 0; a < ATTRIBUTE_COUNT; a++) {
+          Configuration *c = &configurations[e][cl][a][m];
+          int32u elapsed = now - c->lastReportTime;
+          if (!c->isConfigured
+              || elapsed < c->minInterval * MILLISECOND_TICKS_PER_SECOND
+              || (!c->hasChanged
+                  && (c->maxInterval == 0
+                      || (elapsed
+                          < c->maxInterval * MILLISECOND_TICKS_PER_SECOND)))) {
+            continue;
+          }
+          c->isDue = TRUE;
+          c->hasChanged = FALSE;
+          c->lastReportTime = now;
+          MEMCOPY(c->lastReportValue, values[e][cl][a][m], VALUE_SIZE);
+          records++;
+        }
+        due += records;
+        *frames += ((records + RECORDS_PER_FRAME(cl + 1) - 1)
+                    / RECORDS_PER_FRAME(cl + 1));
+      }
+    }
+  }
+  return due;
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+  int32u totalReports = 0;
+  int32u totalFrames = 0;
+  int32u step;
+
+  srand(7);
+  emberAfPluginReportingInitCallback();
+  for (step = 0; step < STEP_COUNT; step++) {
+    EmberEventControl *tick = &emberAfPluginReportingTickEventControl;
+    boolean isActive;
+    boolean isDue;
+    int32u delay;
+
+    if (step < CONFIGURE_STEPS || rand() % 50 == 0) {
+      int16u minInterval = rand() % 5;
+      int16u maxInterval = (rand() % 20 == 0
+                            ? 0xFFFF
+                            : rand() % 4 == 0
+                            ? 0
+                            : 10 * (1 + rand() % 6));
+      configure(1 + rand() % ENDPOINT_COUNT,
+                1 + rand() % CLUSTER_COUNT,
+                rand() % ATTRIBUTE_COUNT,
+                rand() % MASK_COUNT,
+                minInterval,
+                maxInterval,
+                rand() % 500);
+    }
+    if (rand() % 3 == 0) {
+      writeAttribute(1 + rand() % ENDPOINT_COUNT,
+                     1 + rand() % CLUSTER_COUNT,
+                     rand() % ATTRIBUTE_COUNT,
+                     rand() % MASK_COUNT);
+    }
+    if (rand() % 20000 == 0) {
+      clearEndpoint(1 + rand() % ENDPOINT_COUNT);
+    }
+
+    // A late tick is as good as one on time as long as it is due.
+    delay = nextReportDelay();
+    isActive = (tick->status != EMBER_EVENT_INACTIVE);
+    isDue = (isActive && (int32s)(tickTime - now) <= 0);
+    if (delay == MAX_INT32U_VALUE
+        ? isActive
+        : delay == 0
+        ? !isDue
+        : (!isActive || tickTime - now != delay)) {
+      printf("At step %ld the tick is %s, with %ld ms to go, not %ld\n",
+             (long)step,
+             isActive ? "active" : "inactive",
+             (long)(tickTime - now),
+             (long)delay);
+      return 1;
+    }
+
+    if (isDue) {
+      int32u frames;
+      int32u due = dueReports(&frames);
+      reportCount = 0;
+      frameCount = 0;
+      reportIsWrong = FALSE;
+      emberEventControlSetInactive(*tick);
+      emberAfPluginReportingTickEventHandler();
+      if (reportIsWrong || reportCount != due || frameCount != frames) {
+        printf("At step %ld %ld of %ld reports were sent in %ld frames, "
+               "not %ld\n",
+               (long)step,
+               (long)reportCount,
+               (long)due,
+               (long)frameCount,
+               (long)frames);
+        return 1;
+      }
+      totalReports += due;
+      totalFrames += frames;
+    }
+
+    // The clock stops at the next tick, except now and then when the tick is
+    // run late and many reports fall due at once.
+    if (rand() % LATE_TICK_ODDS == 0) {
+      now += rand() % MAX_LATE_MS;
+    } else {
+      now += rand() % MAX_STEP_MS;
+      if (tick->status != EMBER_EVENT_INACTIVE
+          && (int32s)(tickTime - now) < 0) {
+        now = tickTime;
+      }
+    }
+  }
+
+  printf("%ld steps: %ld reports in %ld frames, all as the rules require\n",
+         (long)STEP_COUNT,
+         (long)totalReports,
+         (long)totalFrames);
+  return 0;
+}
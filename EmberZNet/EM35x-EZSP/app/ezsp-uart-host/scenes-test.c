@@ -0,0 +1,719 @@
+/** @file scenes-test.c
+ *  @brief Checks the host's scene table against a model of the scenes
+ *
+ * Builds the Scenes and ZLL Scenes Server plugins with the stand-ins for the
+ * generated headers in framework-test and a simulation of the parts of the
+ * framework they call: the On/off and Level Control attributes of a few
+ * endpoints, group membership and the responses they send.  The table starts
+ * with EMBER_AF_PLUGIN_SCENES_TABLE_SIZE entries, far fewer than the scenes
+ * the test stores, so it grows and rehashes many times over.  A random series
+ * of Store, Recall, Remove, Remove All, Copy (now and then of a scene onto
+ * itself) and Get Scene Membership commands, group walks that remove scenes
+ * as they go, scene tables being cleared and endpoints being initialized is
+ * applied to the plugin and to a model.  Now and then the attribute locations
+ * change, as when an endpoint is added, and the attributes move.  Each command
+ * must give the model's status and Get Scene Membership the model's scenes,
+ * a recalled scene must write the values it stored, each extension attribute
+ * must be located again only when the locations have changed, and after each
+ * step the table must hold exactly the model's scenes.
+ *
+ * <!-- Copyright 2011 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "app/framework/include/af.h"
+#include "app/framework/util/common.h"
+#include "app/framework/util/attribute-storage.h"
+#include "app/framework/plugin/scenes/scenes.h"
+
+// Endpoints 1 to 3, the last of which is on the second network and has no
+// Level Control cluster.  The last group is one the endpoints are not in.
+#define ENDPOINT_COUNT  3
+#define GROUP_COUNT     4
+#define SCENE_COUNT     40
+#define STEP_COUNT      50000
+#define LEVEL_ENDPOINTS 2
+#define OTHER_NETWORK_ENDPOINT 3
+
+#define groupIdOf(g) ((int16u)((g) == 0 ? 0x0000 : (g) * 0x0203))
+#define sceneIdOf(s) ((int8u)((s) * 6 + 1))
+#define isInGroup(g) ((g) < GROUP_COUNT - 1)
+#define hasLevel(endpoint) ((endpoint) <= LEVEL_ENDPOINTS)
+
+enum {
+  ON_OFF,
+  LEVEL,
+  ATTRIBUTE_COUNT
+};
+
+typedef struct {
+  boolean isUsed;
+  int8u onOff;
+  int8u level;
+  boolean hasLevel;
+} Scene;
+
+static Scene scenes[ENDPOINT_COUNT][GROUP_COUNT][SCENE_COUNT];
+static int16u scenesInUse = 0;
+static int16u peakScenesInUse = 0;
+
+#define scene(endpoint, g, s) (&scenes[(endpoint) - 1][g][s])
+
+// Where the plugin should have found the extension attributes, as of which
+// location version.
+static boolean isLocated[ENDPOINT_COUNT][ATTRIBUTE_COUNT];
+static int16u locatedVersion[ENDPOINT_COUNT][ATTRIBUTE_COUNT];
+
+//------------------------------------------------------------------------------
+// The simulated framework.
+
+// The attributes move to the other copy whenever the locations change, and
+// the copy they have left is spoiled.
+#define SPOILED 0xEE
+static int8u attributes[ENDPOINT_COUNT][2][ATTRIBUTE_COUNT];
+static int16u locationVersion = 0;
+static EmberAfAttributeMetadata metadata;
+
+#define attribute(endpoint, a) \
+  (&attributes[(endpoint) - 1][locationVersion & 1][a])
+
+static EmberApsFrame apsFrame;
+static EmberAfClusterCommand command;
+EmberAfClusterCommand *emAfCurrentCommand = &command;
+EmberAfDefinedEndpoint emAfEndpoints[EMBER_AF_ENDPOINT_TABLE_SIZE];
+
+int8u appResponseData[EMBER_AF_RESPONSE_BUFFER_LEN];
+int16u appResponseLength;
+
+static int8u responseStatus;
+static int32u locateCount;
+static boolean locationIsStale;
+
+int8u emberAfEndpointCount(void)
+{
+  return ENDPOINT_COUNT;
+}
+
+int8u emberAfEndpointFromIndex(int8u index)
+{
+  return emAfEndpoints[index].endpoint;
+}
+
+int8u emberAfNetworkIndexFromEndpoint(int8u endpoint)
+{
+  return (endpoint == OTHER_NETWORK_ENDPOINT ? 1 : 0);
+}
+
+int8u emberGetCurrentNetwork(void)
+{
+  return 0;
+}
+
+boolean emberIsZllNetwork(void)
+{
+  return FALSE;
+}
+
+boolean emberAfGroupsClusterEndpointInGroupCallback(int8u endpoint,
+                                                    int16u groupId)
+{
+  return groupId != groupIdOf(GROUP_COUNT - 1);
+}
+
+// The Scenes attributes themselves are not kept.
+EmberAfStatus emberAfWriteServerAttribute(int8u endpoint,
+                                          EmberAfClusterId cluster,
+                                          EmberAfAttributeId attributeID,
+                                          int8u* dataPtr,
+                                          EmberAfAttributeType dataType)
+{
+  return EMBER_ZCL_STATUS_SUCCESS;
+}
+
+int16u emAfAttributeLocationVersion(void)
+{
+  return locationVersion;
+}
+
+void emAfLocateAttribute(EmberAfAttributeSearchRecord *attRecord,
+                         EmAfAttributeLocation *location)
+{
+  locateCount++;
+  if (attRecord->clusterId == ZCL_ON_OFF_CLUSTER_ID) {
+    location->metadata = &metadata;
+    location->data = attribute(attRecord->endpoint, ON_OFF);
+  } else if (hasLevel(attRecord->endpoint)) {
+    location->metadata = &metadata;
+    location->data = attribute(attRecord->endpoint, LEVEL);
+  } else {
+    location->metadata = NULL;
+    location->data = NULL;
+  }
+}
+
+static void checkLocation(const EmberAfAttributeSearchRecord *attRecord,
+                          const EmAfAttributeLocation *location)
+{
+  int8u a = (attRecord->clusterId == ZCL_ON_OFF_CLUSTER_ID ? ON_OFF : LEVEL);
+  if (location->data != attribute(attRecord->endpoint, a)) {
+    locationIsStale = TRUE;
+  }
+}
+
+EmberAfStatus emAfReadOrWriteLocatedAttribute(EmberAfAttributeSearchRecord *attRecord,
+                                              const EmAfAttributeLocation *location,
+                                              int8u *buffer,
+                                              int16u readLength,
+                                              boolean write)
+{
+  checkLocation(attRecord, location);
+  if (write) {
+    *location->data = *buffer;
+  } else {
+    *buffer = *location->data;
+  }
+  return EMBER_ZCL_STATUS_SUCCESS;
+}
+
+EmberAfStatus emAfWriteLocatedAttribute(EmberAfAttributeSearchRecord *record,
+                                        const EmAfAttributeLocation *location,
+                                        int8u *data,
+                                        EmberAfAttributeType dataType,
+                                        boolean overrideReadOnlyAndDataType,
+                                        boolean justTest)
+{
+  checkLocation(record, location);
+  *location->data = *data;
+  return EMBER_ZCL_STATUS_SUCCESS;
+}
+
+int16u emberAfFillExternalBuffer(int8u frameControl,
+                                 EmberAfClusterId clusterId,
+                                 int8u commandId,
+                                 PGM_P format,
+                                 ...)
+{
+  va_list args;
+  va_start(args, format);
+  responseStatus = (int8u)va_arg(args, int);
+  va_end(args);
+  appResponseLength = 0;
+  return 0;
+}
+
+void emberAfPutInt8uInResp(int8u value)
+{
+  appResponseData[appResponseLength++] = value;
+}
+
+void emberAfPutInt16uInResp(int16u value)
+{
+  emberAfPutInt8uInResp(LOW_BYTE(value));
+  emberAfPutInt8uInResp(HIGH_BYTE(value));
+}
+
+EmberStatus emberAfSendResponse(void)
+{
+  return EMBER_SUCCESS;
+}
+
+EmberStatus emberAfSendImmediateDefaultResponse(EmberAfStatus status)
+{
+  responseStatus = status;
+  return EMBER_SUCCESS;
+}
+
+// Add Scene and View Scene are not sent; the test stores scenes instead.
+int8u emberAfStringLength(const int8u *buffer)
+{
+  return buffer[0];
+}
+
+int16u emberAfGetInt16u(const int8u* message,
+                        int16u currentIndex,
+                        int16u msgLen)
+{
+  return HIGH_LOW_TO_INT(message[currentIndex + 1], message[currentIndex]);
+}
+
+//------------------------------------------------------------------------------
+// The model.
+
+static void setCommand(int8u endpoint)
+{
+  apsFrame.destinationEndpoint = endpoint;
+  command.apsFrame = &apsFrame;
+  command.type = EMBER_INCOMING_UNICAST;
+  responseStatus = 0xFF;
+}
+
+static void removeScene(int8u endpoint, int8u g, int8u s)
+{
+  if (scene(endpoint, g, s)->isUsed) {
+    scene(endpoint, g, s)->isUsed = FALSE;
+    scenesInUse--;
+  }
+}
+
+static void setScene(int8u endpoint, int8u g, int8u s, const Scene *from)
+{
+  if (!scene(endpoint, g, s)->isUsed) {
+    scenesInUse++;
+    if (peakScenesInUse < scenesInUse) {
+      peakScenesInUse = scenesInUse;
+    }
+  }
+  *scene(endpoint, g, s) = *from;
+}
+
+// Storing a scene reads, and recalling one writes, the attributes of its
+// extensions, each of which must be located again only if the locations
+// have changed since it was last located on the endpoint.
+static int32u expectedLocates(int8u endpoint, boolean level)
+{
+  int32u count = 0;
+  int8u a;
+  for (a = 0; a < ATTRIBUTE_COUNT; a++) {
+    if ((a == LEVEL && !level)
+        || (isLocated[endpoint - 1][a]
+            && locatedVersion[endpoint - 1][a] == locationVersion)) {
+      continue;
+    }
+    isLocated[endpoint - 1][a] = TRUE;
+    locatedVersion[endpoint - 1][a] = locationVersion;
+    count++;
+  }
+  return count;
+}
+
+static void changeLocations(void)
+{
+  int8u e, a;
+  for (e = 1; e <= ENDPOINT_COUNT; e++) {
+    for (a = 0; a < ATTRIBUTE_COUNT; a++) {
+      attributes[e - 1][(locationVersion + 1) & 1][a] = *attribute(e, a);
+      *attribute(e, a) = SPOILED;
+    }
+  }
+  locationVersion++;
+}
+
+static boolean storeScene(int8u endpoint, int8u g, int8u s)
+{
+  int32u locates;
+  int8u status = (isInGroup(g)
+                  ? EMBER_ZCL_STATUS_SUCCESS
+                  : EMBER_ZCL_STATUS_INVALID_FIELD);
+  *attribute(endpoint, ON_OFF) = rand() % 2;
+  *attribute(endpoint, LEVEL) = rand() % 0xFF;
+  locates = (isInGroup(g) ? expectedLocates(endpoint, TRUE) : 0);
+  locateCount = 0;
+  setCommand(endpoint);
+  emberAfScenesClusterStoreSceneCallback(groupIdOf(g), sceneIdOf(s));
+  if (responseStatus != status || locateCount != locates) {
+    printf("Storing scene 0x%x in group 0x%2x on endpoint %d gave 0x%x "
+           "after %ld lookups, not 0x%x after %ld\n",
+           sceneIdOf(s),
+           groupIdOf(g),
+           endpoint,
+           responseStatus,
+           (long)locateCount,
+           status,
+           (long)locates);
+    return FALSE;
+  }
+  if (status == EMBER_ZCL_STATUS_SUCCESS) {
+    Scene stored;
+    stored.isUsed = TRUE;
+    stored.onOff = *attribute(endpoint, ON_OFF);
+    stored.hasLevel = hasLevel(endpoint);
+    stored.level = (stored.hasLevel ? *attribute(endpoint, LEVEL) : 0);
+    setScene(endpoint, g, s, &stored);
+  }
+  return TRUE;
+}
+
+static boolean recallScene(int8u endpoint, int8u g, int8u s)
+{
+  Scene *recalled = scene(endpoint, g, s);
+  int8u status = (!isInGroup(g)
+                  ? EMBER_ZCL_STATUS_INVALID_FIELD
+                  : !recalled->isUsed
+                  ? EMBER_ZCL_STATUS_NOT_FOUND
+                  : EMBER_ZCL_STATUS_SUCCESS);
+  int32u locates = (status == EMBER_ZCL_STATUS_SUCCESS
+                    ? expectedLocates(endpoint, recalled->hasLevel)
+                    : 0);
+  *attribute(endpoint, ON_OFF) = 0xFF;
+  *attribute(endpoint, LEVEL) = 0xFF;
+  locateCount = 0;
+  setCommand(endpoint);
+  emberAfScenesClusterRecallSceneCallback(groupIdOf(g), sceneIdOf(s));
+  if (responseStatus != status
+      || locateCount != locates
+      || (status == EMBER_ZCL_STATUS_SUCCESS
+          && (*attribute(endpoint, ON_OFF) != recalled->onOff
+              || (*attribute(endpoint, LEVEL)
+                  != (recalled->hasLevel ? recalled->level : 0xFF))))) {
+    printf("Recalling scene 0x%x in group 0x%2x on endpoint %d gave 0x%x "
+           "after %ld lookups, with on/off %d and level %d\n",
+           sceneIdOf(s),
+           groupIdOf(g),
+           endpoint,
+           responseStatus,
+           (long)locateCount,
+           *attribute(endpoint, ON_OFF),
+           *attribute(endpoint, LEVEL));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean removeOneScene(int8u endpoint, int8u g, int8u s)
+{
+  int8u status = (!isInGroup(g)
+                  ? EMBER_ZCL_STATUS_INVALID_FIELD
+                  : !scene(endpoint, g, s)->isUsed
+                  ? EMBER_ZCL_STATUS_NOT_FOUND
+                  : EMBER_ZCL_STATUS_SUCCESS);
+  setCommand(endpoint);
+  emberAfScenesClusterRemoveSceneCallback(groupIdOf(g), sceneIdOf(s));
+  if (responseStatus != status) {
+    printf("Removing scene 0x%x in group 0x%2x on endpoint %d gave 0x%x, "
+           "not 0x%x\n",
+           sceneIdOf(s),
+           groupIdOf(g),
+           endpoint,
+           responseStatus,
+           status);
+    return FALSE;
+  }
+  if (status == EMBER_ZCL_STATUS_SUCCESS) {
+    removeScene(endpoint, g, s);
+  }
+  return TRUE;
+}
+
+static void removeGroupScenes(int8u endpoint, int8u g)
+{
+  int8u s;
+  for (s = 0; s < SCENE_COUNT; s++) {
+    removeScene(endpoint, g, s);
+  }
+}
+
+static boolean removeAllScenes(int8u endpoint, int8u g)
+{
+  int8u status = (isInGroup(g)
+                  ? EMBER_ZCL_STATUS_SUCCESS
+                  : EMBER_ZCL_STATUS_INVALID_FIELD);
+  setCommand(endpoint);
+  emberAfScenesClusterRemoveAllScenesCallback(groupIdOf(g));
+  if (responseStatus != status) {
+    printf("Removing all scenes in group 0x%2x on endpoint %d gave 0x%x, "
+           "not 0x%x\n",
+           groupIdOf(g),
+           endpoint,
+           responseStatus,
+           status);
+    return FALSE;
+  }
+  if (status == EMBER_ZCL_STATUS_SUCCESS) {
+    removeGroupScenes(endpoint, g);
+  }
+  return TRUE;
+}
+
+// Copy Scene copies one scene, or every scene of the "from" group, within an
+// endpoint, onto whatever is already there.  The "from" and "to" scenes may be
+// the same.
+static boolean copyScenes(int8u endpoint,
+                          boolean copyAll,
+                          int8u gFrom,
+                          int8u sFrom,
+                          int8u gTo,
+                          int8u sTo)
+{
+  int8u status = EMBER_ZCL_STATUS_INVALID_FIELD;
+  int8u s;
+  if (isInGroup(gFrom) && isInGroup(gTo)) {
+    for (s = 0; s < SCENE_COUNT; s++) {
+      Scene from = *scene(endpoint, gFrom, s);
+      if (!from.isUsed || (!copyAll && s != sFrom)) {
+        continue;
+      }
+      setScene(endpoint, gTo, (copyAll ? s : sTo), &from);
+      status = EMBER_ZCL_STATUS_SUCCESS;
+    }
+  }
+  setCommand(endpoint);
+  emberAfScenesClusterCopySceneCallback((copyAll ? BIT(0) : 0),
+                                        groupIdOf(gFrom),
+                                        sceneIdOf(sFrom),
+                                        groupIdOf(gTo),
+                                        sceneIdOf(sTo));
+  if (responseStatus != status) {
+    printf("Copying %s 0x%x in group 0x%2x to 0x%x in group 0x%2x on "
+           "endpoint %d gave 0x%x, not 0x%x\n",
+           copyAll ? "all from" : "scene",
+           sceneIdOf(sFrom),
+           groupIdOf(gFrom),
+           sceneIdOf(sTo),
+           groupIdOf(gTo),
+           endpoint,
+           responseStatus,
+           status);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean getSceneMembership(int8u endpoint, int8u g)
+{
+  boolean listed[SCENE_COUNT];
+  int8u count = 0;
+  int8u i, s;
+  MEMSET(listed, 0, sizeof(listed));
+  setCommand(endpoint);
+  emberAfScenesClusterGetSceneMembershipCallback(groupIdOf(g));
+  if (isInGroup(g)
+      ? (responseStatus != EMBER_ZCL_STATUS_SUCCESS
+         || appResponseLength != 1 + appResponseData[0])
+      : responseStatus != EMBER_ZCL_STATUS_INVALID_FIELD) {
+    printf("Getting the scenes in group 0x%2x on endpoint %d gave 0x%x\n",
+           groupIdOf(g),
+           endpoint,
+           responseStatus);
+    return FALSE;
+  } else if (!isInGroup(g)) {
+    return TRUE;
+  }
+  for (i = 0; i < appResponseData[0]; i++) {
+    int8u sceneId = appResponseData[1 + i];
+    s = (sceneId - 1) / 6;
+    if ((sceneId - 1) % 6 != 0
+        || SCENE_COUNT <= s
+        || listed[s]
+        || !scene(endpoint, g, s)->isUsed) {
+      printf("Scene 0x%x of group 0x%2x on endpoint %d was listed wrongly\n",
+             sceneId,
+             groupIdOf(g),
+             endpoint);
+      return FALSE;
+    }
+    listed[s] = TRUE;
+  }
+  for (s = 0; s < SCENE_COUNT; s++) {
+    count += scene(endpoint, g, s)->isUsed;
+  }
+  if (count != appResponseData[0]) {
+    printf("%d of the %d scenes of group 0x%2x on endpoint %d were listed\n",
+           appResponseData[0],
+           count,
+           groupIdOf(g),
+           endpoint);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+// Walks through the scenes of a group, removing those with an odd scene
+// number as it goes, and checks that each scene of the group is reached
+// exactly once.
+static boolean walkGroup(int8u endpoint, int8u g)
+{
+  boolean reached[SCENE_COUNT];
+  EmberAfPluginScenesServerIndex i
+    = emberAfPluginScenesServerFirstSceneInGroup(endpoint, groupIdOf(g));
+  int8u s;
+  MEMSET(reached, 0, sizeof(reached));
+  while (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    EmberAfSceneTableEntry entry;
+    emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
+    s = (entry.sceneId - 1) / 6;
+    if (entry.endpoint != endpoint
+        || entry.groupId != groupIdOf(g)
+        || SCENE_COUNT <= s
+        || reached[s]) {
+      printf("The walk through group 0x%2x on endpoint %d reached scene 0x%x "
+             "in group 0x%2x on endpoint %d\n",
+             groupIdOf(g),
+             endpoint,
+             entry.sceneId,
+             entry.groupId,
+             entry.endpoint);
+      return FALSE;
+    }
+    reached[s] = TRUE;
+    if (s & 1) {
+      entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
+      emberAfPluginScenesServerSaveSceneEntry(entry, i);
+      emberAfPluginScenesServerDecrNumSceneEntriesInUse();
+    }
+    i = emberAfPluginScenesServerNextSceneInGroup(endpoint, groupIdOf(g), i);
+  }
+  for (s = 0; s < SCENE_COUNT; s++) {
+    if (reached[s] != scene(endpoint, g, s)->isUsed) {
+      printf("The walk through group 0x%2x on endpoint %d %s scene 0x%x\n",
+             groupIdOf(g),
+             endpoint,
+             reached[s] ? "reached" : "missed",
+             sceneIdOf(s));
+      return FALSE;
+    }
+    if (s & 1) {
+      removeScene(endpoint, g, s);
+    }
+  }
+  return TRUE;
+}
+
+static void clearSceneTable(int8u endpoint)
+{
+  int8u e, g;
+  emberAfScenesClusterClearSceneTableCallback(endpoint);
+  for (e = 1; e <= ENDPOINT_COUNT; e++) {
+    if (endpoint == e
+        || (endpoint == EMBER_BROADCAST_ENDPOINT
+            && e != OTHER_NETWORK_ENDPOINT)) {
+      for (g = 0; g < GROUP_COUNT; g++) {
+        removeGroupScenes(e, g);
+      }
+    }
+  }
+}
+
+static void initEndpoint(int8u endpoint)
+{
+  int8u g;
+  emberAfScenesClusterServerInitCallback(endpoint);
+  for (g = 0; g < GROUP_COUNT; g++) {
+    removeGroupScenes(endpoint, g);
+  }
+}
+
+// The table must hold exactly the model's scenes.
+static boolean checkTable(void)
+{
+  int8u e, g, s;
+  if (emberAfPluginScenesServerNumSceneEntriesInUse() != scenesInUse) {
+    printf("%d scenes are in use, not %d\n",
+           emberAfPluginScenesServerNumSceneEntriesInUse(),
+           scenesInUse);
+    return FALSE;
+  }
+  for (e = 1; e <= ENDPOINT_COUNT; e++) {
+    for (g = 0; g < GROUP_COUNT; g++) {
+      for (s = 0; s < SCENE_COUNT; s++) {
+        Scene *expected = scene(e, g, s);
+        EmberAfPluginScenesServerIndex i
+          = emberAfPluginScenesServerFindScene(e, groupIdOf(g), sceneIdOf(s));
+        EmberAfSceneTableEntry entry;
+        if ((i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX)
+            != expected->isUsed) {
+          printf("Scene 0x%x in group 0x%2x on endpoint %d is %s\n",
+                 sceneIdOf(s),
+                 groupIdOf(g),
+                 e,
+                 expected->isUsed ? "missing" : "not removed");
+          return FALSE;
+        }
+        if (!expected->isUsed) {
+          continue;
+        }
+        emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
+        if (entry.endpoint != e
+            || entry.groupId != groupIdOf(g)
+            || entry.sceneId != sceneIdOf(s)
+            || entry.onOffValue != expected->onOff
+            || entry.hasCurrentLevelValue != expected->hasLevel
+            || (expected->hasLevel
+                && entry.currentLevelValue != expected->level)) {
+          printf("Scene 0x%x in group 0x%2x on endpoint %d is wrong\n",
+                 sceneIdOf(s),
+                 groupIdOf(g),
+                 e);
+          return FALSE;
+        }
+      }
+    }
+  }
+  return TRUE;
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+  int32u step;
+  int8u e;
+
+  srand(11);
+  for (e = 1; e <= ENDPOINT_COUNT; e++) {
+    emAfEndpoints[e - 1].endpoint = e;
+    emAfEndpoints[e - 1].networkIndex = emberAfNetworkIndexFromEndpoint(e);
+    emberAfScenesClusterServerInitCallback(e);
+  }
+
+  for (step = 0; step < STEP_COUNT; step++) {
+    int8u endpoint = 1 + rand() % ENDPOINT_COUNT;
+    int8u g = rand() % GROUP_COUNT;
+    int8u s = rand() % SCENE_COUNT;
+    int32u choice = rand() % 1000;
+    boolean ok = TRUE;
+
+    if (choice < 600) {
+      ok = storeScene(endpoint, g, s);
+    } else if (choice < 740) {
+      ok = recallScene(endpoint, g, s);
+    } else if (choice < 750) {
+      ok = removeOneScene(endpoint, g, s);
+    } else if (choice < 754) {
+      ok = removeAllScenes(endpoint, g);
+    } else if (choice < 757) {
+      // As the Groups plugin does when an endpoint leaves a group.
+      emberAfScenesClusterRemoveScenesInGroupCallback(endpoint, groupIdOf(g));
+      removeGroupScenes(endpoint, g);
+    } else if (choice < 850) {
+      boolean copyAll = (rand() % 2 == 0);
+      boolean ontoItself = (rand() % 3 == 0);
+      ok = copyScenes(endpoint,
+                      copyAll,
+                      g,
+                      s,
+                      (ontoItself ? g : rand() % GROUP_COUNT),
+                      (ontoItself ? s : rand() % SCENE_COUNT));
+    } else if (choice < 920) {
+      ok = getSceneMembership(endpoint, g);
+    } else if (choice < 935) {
+      ok = walkGroup(endpoint, g);
+    } else if (choice < 990) {
+      changeLocations();
+    } else if (choice < 997) {
+      clearSceneTable(rand() % 2 == 0 ? endpoint : EMBER_BROADCAST_ENDPOINT);
+    } else {
+      initEndpoint(endpoint);
+    }
+
+    if (locationIsStale) {
+      printf("At step %ld an attribute was reached through a stale location\n",
+             (long)step);
+      return 1;
+    }
+    if (!ok || !checkTable()) {
+      printf("at step %ld\n", (long)step);
+      return 1;
+    }
+  }
+
+  printf("%ld steps: up to %d scenes in a table that started with %d entries, "
+         "all as the model says\n",
+         (long)STEP_COUNT,
+         peakScenesInUse,
+         EMBER_AF_PLUGIN_SCENES_TABLE_SIZE);
+  return 0;
+}
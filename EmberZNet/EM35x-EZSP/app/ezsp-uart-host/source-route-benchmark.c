@@ -0,0 +1,331 @@
+/** @file source-route-benchmark.c
+ *  @brief Replays route record storms into the host source route table
+ *
+ * Builds a random tree of routers below the gateway and replays a storm of
+ * route records from them, as a concentrator sees after a many-to-one route
+ * request, through ezspIncomingRouteRecordHandler().  Routers are moved to new
+ * parents now and again.  The same records are applied to a copy of the
+ * linear table that source-route-common.c used before, widened to two-byte
+ * indexes, and emberFindSourceRoute() must return the same relays for every
+ * router.  This is checked with a table large enough for the whole network and
+ * with one small enough that old entries are replaced.  Both tables are then
+ * timed over the same storm.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack/include/ember-types.h"
+#include "app/util/ezsp/ezsp-utils.h"
+#include "app/util/source-route-common.h"
+#include "app/util/source-route-host.h"
+
+#define ROUTER_COUNT    1000
+#define MAX_DEPTH       11
+#define RECORD_COUNT    200000
+#define MOVE_PERIOD     50
+#define CHECK_PERIOD    5000
+#define LARGE_TABLE     (ROUTER_COUNT + 24)
+#define SMALL_TABLE     300
+
+void ezspIncomingRouteRecordHandler(EmberNodeId source,
+                                    EmberEUI64 sourceEui,
+                                    int8u lastHopLqi,
+                                    int8s lastHopRssi,
+                                    int8u relayCount,
+                                    int8u *relayList);
+
+// Router 0 is the gateway.
+static EmberNodeId nodeIds[ROUTER_COUNT + 1];
+static int16u parents[ROUTER_COUNT + 1];
+static int8u depths[ROUTER_COUNT + 1];
+
+typedef struct {
+  int16u router;
+  int8u relayCount;
+  int8u relayList[MAX_DEPTH * 2];
+} RouteRecord;
+
+static RouteRecord records[RECORD_COUNT];
+static SourceRouteTableEntry table[LARGE_TABLE];
+
+//------------------------------------------------------------------------------
+// The linear table that source-route-common.c used before.
+
+typedef struct {
+  EmberNodeId destination;
+  int16u closerIndex;
+  int16u olderIndex;
+} LinearEntry;
+
+#define LINEAR_NULL_INDEX 0xFFFF
+
+static LinearEntry linearTable[LARGE_TABLE];
+static int16u linearTableSize;
+static int16u linearEntryCount;
+static int16u linearNewestIndex;
+
+static int16u linearFindIndex(EmberNodeId id)
+{
+  int16u i;
+  for (i = 0; i < linearEntryCount; i++) {
+    if (linearTable[i].destination == id) {
+      return i;
+    }
+  }
+  return LINEAR_NULL_INDEX;
+}
+
+static int16u linearAddEntry(EmberNodeId id, int16u furtherIndex)
+{
+  int16u index = linearFindIndex(id);
+  int16u i;
+
+  if (index == LINEAR_NULL_INDEX) {
+    if (linearEntryCount < linearTableSize) {
+      index = linearEntryCount;
+      linearEntryCount += 1;
+    } else {
+      index = linearNewestIndex;
+      while (linearTable[index].olderIndex != LINEAR_NULL_INDEX) {
+        index = linearTable[index].olderIndex;
+      }
+    }
+  }
+
+  if (index != linearNewestIndex) {
+    for (i = 0; i < linearEntryCount; i++) {
+      if (linearTable[i].olderIndex == index) {
+        linearTable[i].olderIndex = linearTable[index].olderIndex;
+        break;
+      }
+    }
+    linearTable[index].olderIndex = linearNewestIndex;
+    linearNewestIndex = index;
+  }
+
+  linearTable[index].destination = id;
+  linearTable[index].closerIndex = LINEAR_NULL_INDEX;
+  if (furtherIndex != LINEAR_NULL_INDEX) {
+    linearTable[furtherIndex].closerIndex = index;
+  }
+  return index;
+}
+
+static void linearRouteRecord(EmberNodeId source,
+                              int8u relayCount,
+                              int8u *relayList)
+{
+  int16u previous = linearAddEntry(source, LINEAR_NULL_INDEX);
+  int8u i;
+  for (i = 0; i < relayCount; i++) {
+    previous = linearAddEntry(emberFetchLowHighInt16u(relayList + i * 2),
+                              previous);
+  }
+}
+
+static boolean linearFindSourceRoute(EmberNodeId destination,
+                                     int8u *relayCount,
+                                     int16u *relayList)
+{
+  int16u index = linearFindIndex(destination);
+  if (index == LINEAR_NULL_INDEX) {
+    return FALSE;
+  }
+  *relayCount = 0;
+  while (linearTable[index].closerIndex != LINEAR_NULL_INDEX) {
+    index = linearTable[index].closerIndex;
+    relayList[*relayCount] = linearTable[index].destination;
+    *relayCount += 1;
+  }
+  return TRUE;
+}
+
+//------------------------------------------------------------------------------
+
+static void setTableSize(int16u size)
+{
+  sourceRouteTable = table;
+  sourceRouteTableSize = size;
+  sourceRouteInit();
+  linearTableSize = size;
+  linearEntryCount = 0;
+  linearNewestIndex = LINEAR_NULL_INDEX;
+}
+
+static void setParent(int16u router)
+{
+  do {
+    parents[router] = rand() % router;
+  } while (depths[parents[router]] >= MAX_DEPTH);
+  depths[router] = depths[parents[router]] + 1;
+}
+
+// A router that moves goes to another parent at the same depth, so that the
+// routers below it stay within the depth limit.
+static void moveRouter(int16u router)
+{
+  int16u parent;
+  do {
+    parent = rand() % router;
+  } while (depths[parent] + 1 != depths[router]);
+  parents[router] = parent;
+}
+
+// The routers are added in order, each below one added before it, so the
+// network is a tree rooted at the gateway.
+static void buildNetwork(void)
+{
+  int16u i, j;
+
+  nodeIds[0] = 0x0000;
+  depths[0] = 0;
+  for (i = 1; i <= ROUTER_COUNT; i++) {
+    boolean unique;
+    do {
+      nodeIds[i] = 1 + rand() % 0xFFF7;
+      unique = TRUE;
+      for (j = 0; j < i; j++) {
+        if (nodeIds[j] == nodeIds[i]) {
+          unique = FALSE;
+        }
+      }
+    } while (!unique);
+    setParent(i);
+  }
+}
+
+static void makeRecord(RouteRecord *record, int16u router)
+{
+  int16u relay = parents[router];
+  record->router = router;
+  record->relayCount = 0;
+  while (relay != 0) {
+    record->relayList[record->relayCount * 2] = LOW_BYTE(nodeIds[relay]);
+    record->relayList[record->relayCount * 2 + 1] = HIGH_BYTE(nodeIds[relay]);
+    record->relayCount++;
+    relay = parents[relay];
+  }
+}
+
+// Routers deep in the network send most of the route records, as they are
+// the ones that have to be reached through source routes.
+static void buildStorm(void)
+{
+  int32u i;
+  for (i = 0; i < RECORD_COUNT; i++) {
+    int16u router = 1 + rand() % ROUTER_COUNT;
+    int16u other = 1 + rand() % ROUTER_COUNT;
+    if (depths[other] > depths[router]) {
+      router = other;
+    }
+    if (i % MOVE_PERIOD == 0) {
+      moveRouter(1 + rand() % ROUTER_COUNT);
+    }
+    makeRecord(&records[i], router);
+  }
+}
+
+static boolean compareRoutes(int32u record)
+{
+  int16u relays[MAX_DEPTH];
+  int16u linearRelays[MAX_DEPTH];
+  int8u relayCount;
+  int8u linearRelayCount;
+  int16u i;
+
+  for (i = 1; i <= ROUTER_COUNT; i++) {
+    boolean found = emberFindSourceRoute(nodeIds[i], &relayCount, relays);
+    boolean linearFound = linearFindSourceRoute(nodeIds[i],
+                                                &linearRelayCount,
+                                                linearRelays);
+    if (found != linearFound
+        || (found
+            && (relayCount != linearRelayCount
+                || memcmp(relays,
+                          linearRelays,
+                          relayCount * sizeof(int16u)) != 0))) {
+      printf("After record %ld, routes to 0x%04X differ\n",
+             (long)record, nodeIds[i]);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static boolean checkStorm(int16u tableSize)
+{
+  int32u i;
+
+  setTableSize(tableSize);
+  for (i = 0; i < RECORD_COUNT; i++) {
+    RouteRecord *record = &records[i];
+    ezspIncomingRouteRecordHandler(nodeIds[record->router],
+                                   NULL,
+                                   0xFF,
+                                   0,
+                                   record->relayCount,
+                                   record->relayList);
+    linearRouteRecord(nodeIds[record->router],
+                      record->relayCount,
+                      record->relayList);
+    if (i % CHECK_PERIOD == 0 || i == RECORD_COUNT - 1) {
+      if (!compareRoutes(i)) {
+        return FALSE;
+      }
+    }
+  }
+  printf("Both tables of %d entries agree after %d route records\n",
+         tableSize, RECORD_COUNT);
+  return TRUE;
+}
+
+static double timeStorm(boolean linear)
+{
+  clock_t start = clock();
+  int32u i;
+
+  setTableSize(LARGE_TABLE);
+  for (i = 0; i < RECORD_COUNT; i++) {
+    RouteRecord *record = &records[i];
+    if (linear) {
+      linearRouteRecord(nodeIds[record->router],
+                        record->relayCount,
+                        record->relayList);
+    } else {
+      ezspIncomingRouteRecordHandler(nodeIds[record->router],
+                                     NULL,
+                                     0xFF,
+                                     0,
+                                     record->relayCount,
+                                     record->relayList);
+    }
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+  double hashTime;
+  double linearTime;
+
+  srand(1);
+  buildNetwork();
+  buildStorm();
+
+  if (!checkStorm(LARGE_TABLE) || !checkStorm(SMALL_TABLE)) {
+    return 1;
+  }
+
+  hashTime = timeStorm(FALSE);
+  linearTime = timeStorm(TRUE);
+  printf("hashed: %8.3f s  %8.2f us/record\n",
+         hashTime, hashTime * 1000000.0 / RECORD_COUNT);
+  printf("linear: %8.3f s  %8.2f us/record\n",
+         linearTime, linearTime * 1000000.0 / RECORD_COUNT);
+  return 0;
+}
@@ -0,0 +1,842 @@
+/** @file table-mirror-test.c
+ *  @brief Checks the host stack table mirrors against a simulated NCP
+ *
+ * Runs ezsp.c against a simulated NCP, in place of the serial protocol, that
+ * keeps child, neighbor, route and key tables and answers the commands that
+ * read and write them.  Responses are queued so that pipelined commands can
+ * be outstanding together.  A random mix of changes is made to the tables:
+ * children join and leave, keys are established, devices leave the trust
+ * center and the host writes the key table, all reported with callbacks as
+ * the NCP does, while neighbors, routes and frame counters change without
+ * the host being told.  Routes also fail with route errors, and now and
+ * again the stack status changes or the NCP is reset.  After each change
+ * every entry of every table is read.  Child and key entries must match the
+ * NCP, key frame counters included, and neighbor and route entries may only
+ * differ if the NCP changed them silently less than
+ * EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS ago.  ezspTableMirrorSnapshot() must
+ * return the same entries.  A monitoring loop that reads every table
+ * several times a second is then run, and the commands it sends counted,
+ * with the mirrors, with snapshots and with the commands themselves.
+ *
+ * <!-- Copyright 2010 by Ember Corporation. All rights reserved.        *80*-->
+ */
+
+#include PLATFORM_HEADER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack/include/ember-types.h"
+#include "stack/include/error.h"
+#include "app/util/ezsp/ezsp-protocol.h"
+#include "app/util/ezsp/ezsp.h"
+#include "app/util/ezsp/serial-interface.h"
+#include "app/util/ezsp/ezsp-frame-utilities.h"
+#include "app/util/ezsp/ezsp-host-configuration-defaults.h"
+
+#define CHILD_SIZE          EZSP_HOST_CHILD_TABLE_MIRROR_SIZE
+#define NEIGHBOR_SIZE       EZSP_HOST_NEIGHBOR_TABLE_MIRROR_SIZE
+#define ROUTE_SIZE          EZSP_HOST_ROUTE_TABLE_MIRROR_SIZE
+#define KEY_SIZE            24
+#define MAX_AGE_MS          EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS
+#define PARTNER_COUNT       40
+#define OPERATION_COUNT     20000
+#define POLL_COUNT          3000
+#define POLL_PERIOD_MS      200
+#define RESPONSE_QUEUE_SIZE 8
+#define CALLBACK_QUEUE_SIZE 4
+#define START_TIME          0xFFFF0000UL
+
+//------------------------------------------------------------------------------
+// The simulated NCP.
+
+static int8u ezspFrameLength;
+int8u *ezspFrameLengthLocation = &ezspFrameLength;
+static int8u ezspFrameContentsStorage[EZSP_MAX_FRAME_LENGTH];
+int8u *ezspFrameContents = ezspFrameContentsStorage;
+
+typedef struct {
+  int8u length;
+  int8u contents[EZSP_MAX_FRAME_LENGTH];
+} Frame;
+
+typedef struct {
+  boolean used;
+  EmberNodeId id;
+  EmberEUI64 eui64;
+  EmberNodeType type;
+} Child;
+
+typedef struct {
+  boolean used;
+  EmberKeyStruct key;
+} Key;
+
+static Child ncpChildren[CHILD_SIZE];
+static EmberNeighborTableEntry ncpNeighbors[NEIGHBOR_SIZE];
+static int8u ncpNeighborCount;
+static EmberRouteTableEntry ncpRoutes[ROUTE_SIZE];
+static Key ncpKeys[KEY_SIZE];
+static EmberEUI64 partners[PARTNER_COUNT];
+
+// When each neighbor and route entry, and the neighbor count, last changed
+// without the host being told.
+static int32u neighborChangeTimes[NEIGHBOR_SIZE];
+static int32u neighborCountChangeTime;
+static int32u routeChangeTimes[ROUTE_SIZE];
+
+static Frame responses[RESPONSE_QUEUE_SIZE];
+static int8u responseHead = 0;
+static int8u responseCount = 0;
+static int8u maxResponseCount = 0;
+static Frame callbacks[CALLBACK_QUEUE_SIZE];
+static int8u callbackCount = 0;
+static int32u commandCount = 0;
+static int32u nowMS = START_TIME;
+
+int32u halCommonGetInt32uMillisecondTick(void)
+{
+  return nowMS;
+}
+
+static void appendKey(int8u index)
+{
+  EmberKeyStruct erased;
+  if (ncpKeys[index].used) {
+    appendInt8u(EMBER_SUCCESS);
+    appendEmberKeyStruct(&ncpKeys[index].key);
+  } else {
+    MEMSET(&erased, 0, sizeof(erased));
+    appendInt8u(EMBER_TABLE_ENTRY_ERASED);
+    appendEmberKeyStruct(&erased);
+  }
+}
+
+static void storeKey(int8u index, EmberEUI64 partner, EmberKeyData *keyData)
+{
+  Key *key = &ncpKeys[index];
+  MEMSET(key, 0, sizeof(Key));
+  key->used = TRUE;
+  key->key.bitmask = (EMBER_KEY_HAS_PARTNER_EUI64
+                      | EMBER_KEY_HAS_OUTGOING_FRAME_COUNTER
+                      | EMBER_KEY_HAS_INCOMING_FRAME_COUNTER);
+  key->key.type = EMBER_APPLICATION_LINK_KEY;
+  MEMCOPY(key->key.key.contents, keyData->contents, EMBER_ENCRYPTION_KEY_SIZE);
+  MEMCOPY(key->key.partnerEUI64, partner, EUI64_SIZE);
+}
+
+static int8u findKey(EmberEUI64 partner)
+{
+  int8u i;
+  for (i = 0; i < KEY_SIZE; i++) {
+    if (ncpKeys[i].used
+        && MEMCOMPARE(ncpKeys[i].key.partnerEUI64, partner, EUI64_SIZE) == 0) {
+      return i;
+    }
+  }
+  for (i = 0; i < KEY_SIZE; i++) {
+    if (!ncpKeys[i].used) {
+      return i;
+    }
+  }
+  return 0xFF;
+}
+
+EzspStatus serialSendCommand(void)
+{
+  int8u frameId = serialGetResponseByte(EZSP_FRAME_ID_INDEX);
+  EmberEUI64 eui64;
+  EmberKeyData keyData;
+  EmberNeighborTableEntry neighbor;
+  int8u index = 0;
+  int8u i;
+  Frame *response;
+
+  commandCount++;
+  ezspReadPointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+  ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+
+  switch (frameId) {
+  case EZSP_GET_CHILD_DATA:
+    index = fetchInt8u();
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    if (ncpChildren[index].used) {
+      appendInt8u(EMBER_SUCCESS);
+      appendInt16u(ncpChildren[index].id);
+      appendInt8uArray(EUI64_SIZE, ncpChildren[index].eui64);
+      appendInt8u(ncpChildren[index].type);
+    } else {
+      appendInt8u(EMBER_NOT_JOINED);
+      appendInt16u(EMBER_NULL_NODE_ID);
+      MEMSET(eui64, 0, EUI64_SIZE);
+      appendInt8uArray(EUI64_SIZE, eui64);
+      appendInt8u(EMBER_UNKNOWN_DEVICE);
+    }
+    break;
+  case EZSP_GET_NEIGHBOR:
+    index = fetchInt8u();
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    if (index < ncpNeighborCount) {
+      appendInt8u(EMBER_SUCCESS);
+      appendEmberNeighborTableEntry(&ncpNeighbors[index]);
+    } else {
+      MEMSET(&neighbor, 0, sizeof(neighbor));
+      appendInt8u(EMBER_ERR_FATAL);
+      appendEmberNeighborTableEntry(&neighbor);
+    }
+    break;
+  case EZSP_NEIGHBOR_COUNT:
+    appendInt8u(ncpNeighborCount);
+    break;
+  case EZSP_GET_ROUTE_TABLE_ENTRY:
+    index = fetchInt8u();
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    appendInt8u(EMBER_SUCCESS);
+    appendEmberRouteTableEntry(&ncpRoutes[index]);
+    break;
+  case EZSP_GET_KEY_TABLE_ENTRY:
+    index = fetchInt8u();
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    appendKey(index);
+    break;
+  case EZSP_SET_KEY_TABLE_ENTRY:
+    index = fetchInt8u();
+    fetchInt8uArray(EUI64_SIZE, eui64);
+    (void)fetchInt8u();
+    fetchEmberKeyData(&keyData);
+    storeKey(index, eui64, &keyData);
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    appendInt8u(EMBER_SUCCESS);
+    break;
+  case EZSP_ADD_OR_UPDATE_KEY_TABLE_ENTRY:
+    fetchInt8uArray(EUI64_SIZE, eui64);
+    (void)fetchInt8u();
+    fetchEmberKeyData(&keyData);
+    index = findKey(eui64);
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    if (index == 0xFF) {
+      appendInt8u(EMBER_TABLE_FULL);
+    } else {
+      storeKey(index, eui64, &keyData);
+      appendInt8u(EMBER_SUCCESS);
+    }
+    break;
+  case EZSP_ERASE_KEY_TABLE_ENTRY:
+    index = fetchInt8u();
+    ncpKeys[index].used = FALSE;
+    ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+    appendInt8u(EMBER_SUCCESS);
+    break;
+  case EZSP_CLEAR_KEY_TABLE:
+    for (i = 0; i < KEY_SIZE; i++) {
+      ncpKeys[i].used = FALSE;
+    }
+    appendInt8u(EMBER_SUCCESS);
+    break;
+  default:
+    printf("Unexpected command 0x%02X\n", frameId);
+    exit(1);
+  }
+
+  serialSetCommandByte(EZSP_FRAME_CONTROL_INDEX, EZSP_FRAME_CONTROL_RESPONSE);
+  serialSetCommandLength(ezspWritePointer - ezspFrameContents);
+  if (responseCount == RESPONSE_QUEUE_SIZE) {
+    printf("Too many commands outstanding\n");
+    exit(1);
+  }
+  response = &responses[(responseHead + responseCount) % RESPONSE_QUEUE_SIZE];
+  response->length = ezspFrameLength;
+  MEMCOPY(response->contents, ezspFrameContents, ezspFrameLength);
+  responseCount++;
+  if (maxResponseCount < responseCount) {
+    maxResponseCount = responseCount;
+  }
+  return EZSP_SUCCESS;
+}
+
+// Callbacks are only delivered when there is no response waiting, as the
+// uart serial protocol does.
+EzspStatus serialResponseReceived(void)
+{
+  Frame *frame;
+  int8u i;
+
+  if (responseCount > 0) {
+    frame = &responses[responseHead];
+    responseHead = (responseHead + 1) % RESPONSE_QUEUE_SIZE;
+    responseCount--;
+  } else if (callbackCount > 0) {
+    frame = &callbacks[0];
+  } else {
+    return EZSP_ASH_NO_RX_DATA;
+  }
+  MEMCOPY(ezspFrameContents, frame->contents, frame->length);
+  serialSetCommandLength(frame->length);
+  if (frame == &callbacks[0]) {
+    callbackCount--;
+    for (i = 0; i < callbackCount; i++) {
+      callbacks[i] = callbacks[i + 1];
+    }
+  }
+  return EZSP_SUCCESS;
+}
+
+int8u serialPendingResponseCount(void)
+{
+  return callbackCount;
+}
+
+// Callbacks are built in ezspFrameContents and then set aside.
+static void startCallback(int8u frameId)
+{
+  serialSetCommandByte(EZSP_SEQUENCE_INDEX, 0);
+  serialSetCommandByte(EZSP_FRAME_CONTROL_INDEX, EZSP_FRAME_CONTROL_RESPONSE);
+  serialSetCommandByte(EZSP_FRAME_ID_INDEX, frameId);
+  ezspWritePointer = ezspFrameContents + EZSP_PARAMETERS_INDEX;
+}
+
+static void queueCallback(void)
+{
+  Frame *callback = &callbacks[callbackCount++];
+  callback->length = ezspWritePointer - ezspFrameContents;
+  MEMCOPY(callback->contents, ezspFrameContents, callback->length);
+}
+
+//------------------------------------------------------------------------------
+
+void ezspErrorHandler(EzspStatus status)
+{
+  printf("EZSP error 0x%02X\n", status);
+  exit(1);
+}
+
+// EZSP callback function stubs
+
+void ezspTimerHandler(int8u timerId)
+{}
+
+void ezspStackStatusHandler(EmberStatus status)
+{}
+
+void ezspNetworkFoundHandler(EmberZigbeeNetwork *networkFound,
+                             int8u lastHopLqi,
+                             int8s lastHopRssi)
+{}
+
+void ezspScanCompleteHandler(int8u channel, EmberStatus status)
+{}
+
+void ezspMessageSentHandler(EmberOutgoingMessageType type,
+                            int16u indexOrDestination,
+                            EmberApsFrame *apsFrame,
+                            int8u messageTag,
+                            EmberStatus status,
+                            int8u messageLength,
+                            int8u *messageContents)
+{}
+
+void ezspIncomingMessageHandler(EmberIncomingMessageType type,
+                                EmberApsFrame *apsFrame,
+                                int8u lastHopLqi,
+                                int8s lastHopRssi,
+                                EmberNodeId sender,
+                                int8u bindingIndex,
+                                int8u addressIndex,
+                                int8u messageLength,
+                                int8u *messageContents)
+{}
+
+void simulatedTimePasses(void)
+{}
+
+void ashTraceEzspVerbose(char *format, ...)
+{}
+
+//------------------------------------------------------------------------------
+// Changes to the NCP's tables.
+
+static void randomEui64(EmberEUI64 eui64)
+{
+  int8u i;
+  for (i = 0; i < EUI64_SIZE; i++) {
+    eui64[i] = rand();
+  }
+}
+
+static void randomKeyData(EmberKeyData *keyData)
+{
+  int8u i;
+  for (i = 0; i < EMBER_ENCRYPTION_KEY_SIZE; i++) {
+    keyData->contents[i] = rand();
+  }
+}
+
+static void childJoinsOrLeaves(void)
+{
+  int8u index = rand() % CHILD_SIZE;
+  Child *child = &ncpChildren[index];
+  child->used = !child->used;
+  if (child->used) {
+    child->id = rand() % 0xFFF8;
+    randomEui64(child->eui64);
+    child->type = (rand() % 2 == 0
+                   ? EMBER_SLEEPY_END_DEVICE
+                   : EMBER_END_DEVICE);
+  }
+  startCallback(EZSP_CHILD_JOIN_HANDLER);
+  appendInt8u(index);
+  appendInt8u(child->used);
+  appendInt16u(child->id);
+  appendInt8uArray(EUI64_SIZE, child->eui64);
+  appendInt8u(child->type);
+  queueCallback();
+}
+
+static void keyEstablished(void)
+{
+  EmberEUI64 partner;
+  EmberKeyData keyData;
+  int8u index;
+  MEMCOPY(partner, partners[rand() % PARTNER_COUNT], EUI64_SIZE);
+  randomKeyData(&keyData);
+  index = findKey(partner);
+  if (index != 0xFF) {
+    storeKey(index, partner, &keyData);
+  }
+  startCallback(EZSP_ZIGBEE_KEY_ESTABLISHMENT_HANDLER);
+  appendInt8uArray(EUI64_SIZE, partner);
+  appendInt8u(EMBER_APP_LINK_KEY_ESTABLISHED);
+  queueCallback();
+}
+
+// The trust center is told when a device leaves, and this NCP then erases
+// the device's key.
+static void deviceLeaves(void)
+{
+  EmberEUI64 partner;
+  int8u i;
+  MEMCOPY(partner, partners[rand() % PARTNER_COUNT], EUI64_SIZE);
+  for (i = 0; i < KEY_SIZE; i++) {
+    if (ncpKeys[i].used
+        && MEMCOMPARE(ncpKeys[i].key.partnerEUI64, partner, EUI64_SIZE) == 0) {
+      ncpKeys[i].used = FALSE;
+    }
+  }
+  startCallback(EZSP_TRUST_CENTER_JOIN_HANDLER);
+  appendInt16u(rand() % 0xFFF8);
+  appendInt8uArray(EUI64_SIZE, partner);
+  appendInt8u(EMBER_DEVICE_LEFT);
+  appendInt8u(EMBER_USE_PRECONFIGURED_KEY);
+  appendInt16u(0x0000);
+  queueCallback();
+}
+
+static void hostWritesKeyTable(void)
+{
+  EmberKeyData keyData;
+  int8u choice = rand() % 20;
+  randomKeyData(&keyData);
+  if (choice < 8) {
+    emberSetKeyTableEntry(rand() % KEY_SIZE,
+                          partners[rand() % PARTNER_COUNT],
+                          TRUE,
+                          &keyData);
+  } else if (choice < 14) {
+    emberAddOrUpdateKeyTableEntry(partners[rand() % PARTNER_COUNT],
+                                  TRUE,
+                                  &keyData);
+  } else if (choice < 19) {
+    emberEraseKeyTableEntry(rand() % KEY_SIZE);
+  } else {
+    emberClearKeyTable();
+  }
+}
+
+static void frameCountersChange(void)
+{
+  Key *key = &ncpKeys[rand() % KEY_SIZE];
+  key->key.outgoingFrameCounter += 1 + rand() % 10;
+  key->key.incomingFrameCounter += 1 + rand() % 10;
+}
+
+static void neighborChanges(void)
+{
+  int8u index;
+  int8u i;
+  if (ncpNeighborCount < NEIGHBOR_SIZE && rand() % 2 == 0) {
+    index = ncpNeighborCount++;
+    neighborCountChangeTime = nowMS;
+    randomEui64(ncpNeighbors[index].longId);
+    ncpNeighbors[index].shortId = rand() % 0xFFF8;
+  } else if (ncpNeighborCount > 0 && rand() % 4 == 0) {
+    // The entries after the one removed move down.
+    index = rand() % ncpNeighborCount;
+    ncpNeighborCount--;
+    neighborCountChangeTime = nowMS;
+    for (i = index; i < ncpNeighborCount; i++) {
+      ncpNeighbors[i] = ncpNeighbors[i + 1];
+      neighborChangeTimes[i] = nowMS;
+    }
+    index = ncpNeighborCount;
+  } else if (ncpNeighborCount > 0) {
+    index = rand() % ncpNeighborCount;
+  } else {
+    return;
+  }
+  ncpNeighbors[index].averageLqi = rand();
+  ncpNeighbors[index].inCost = 1 + rand() % 7;
+  ncpNeighbors[index].outCost = rand() % 8;
+  ncpNeighbors[index].age = rand() % 4;
+  neighborChangeTimes[index] = nowMS;
+}
+
+static void routeChanges(void)
+{
+  int8u index = rand() % ROUTE_SIZE;
+  EmberRouteTableEntry *route = &ncpRoutes[index];
+  route->destination = rand() % 0xFFF8;
+  route->nextHop = rand() % 0xFFF8;
+  route->status = 0;
+  route->age = rand() % 8;
+  routeChangeTimes[index] = nowMS;
+}
+
+// The NCP drops the failed route and reports it, so the host has no excuse
+// for returning it.
+static void routeFails(void)
+{
+  int8u index = rand() % ROUTE_SIZE;
+  EmberRouteTableEntry *route = &ncpRoutes[index];
+  EmberNodeId target = route->destination;
+  if (route->status == 3) {
+    return;
+  }
+  route->destination = EMBER_NULL_NODE_ID;
+  route->status = 3;
+  startCallback(EZSP_INCOMING_ROUTE_ERROR_HANDLER);
+  appendInt8u(EMBER_SOURCE_ROUTE_FAILURE);
+  appendInt16u(target);
+  queueCallback();
+}
+
+static void stackStatusChanges(void)
+{
+  startCallback(EZSP_STACK_STATUS_HANDLER);
+  appendInt8u(EMBER_NETWORK_UP);
+  queueCallback();
+}
+
+// A reset NCP forgets its neighbors and routes, and the host drops its
+// copies, as emAfResetAndInitNCP() does.
+static void ncpResets(void)
+{
+  int8u i;
+  ncpNeighborCount = 0;
+  neighborCountChangeTime = nowMS;
+  for (i = 0; i < ROUTE_SIZE; i++) {
+    ncpRoutes[i].destination = EMBER_NULL_NODE_ID;
+    ncpRoutes[i].status = 3;
+    routeChangeTimes[i] = nowMS;
+  }
+  ezspTableMirrorInvalidate(EZSP_ALL_TABLE_MIRRORS);
+}
+
+static void makeChange(void)
+{
+  int8u choice = rand() % 100;
+  if (choice < 15) {
+    childJoinsOrLeaves();
+  } else if (choice < 25) {
+    keyEstablished();
+  } else if (choice < 30) {
+    deviceLeaves();
+  } else if (choice < 40) {
+    hostWritesKeyTable();
+  } else if (choice < 50) {
+    frameCountersChange();
+  } else if (choice < 65) {
+    neighborChanges();
+  } else if (choice < 78) {
+    routeChanges();
+  } else if (choice < 88) {
+    routeFails();
+  } else if (choice < 89) {
+    stackStatusChanges();
+  } else if (choice < 90) {
+    ncpResets();
+  } else {
+    nowMS += rand() % (MAX_AGE_MS / 2);
+  }
+  ezspTick();
+}
+
+//------------------------------------------------------------------------------
+// Checks
+
+static boolean silentlyChanged(int32u changeTime)
+{
+  return (int32u)(nowMS - changeTime) < MAX_AGE_MS;
+}
+
+static boolean checkChildren(int32u operation)
+{
+  EmberNodeId id;
+  EmberEUI64 eui64;
+  EmberNodeType type;
+  int8u i;
+  for (i = 0; i < CHILD_SIZE; i++) {
+    EmberStatus status = ezspGetChildData(i, &id, eui64, &type);
+    Child *child = &ncpChildren[i];
+    if (status != (child->used ? EMBER_SUCCESS : EMBER_NOT_JOINED)
+        || (child->used
+            && (id != child->id
+                || MEMCOMPARE(eui64, child->eui64, EUI64_SIZE) != 0
+                || type != child->type))) {
+      printf("After operation %ld, child %d differs\n", (long)operation, i);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static boolean checkKeys(int32u operation)
+{
+  EmberKeyStruct key;
+  int8u i;
+  for (i = 0; i < KEY_SIZE; i++) {
+    EmberStatus status = emberGetKeyTableEntry(i, &key);
+    Key *ncpKey = &ncpKeys[i];
+    if (status != (ncpKey->used ? EMBER_SUCCESS : EMBER_TABLE_ENTRY_ERASED)
+        || (ncpKey->used
+            && (key.bitmask != ncpKey->key.bitmask
+                || key.type != ncpKey->key.type
+                || MEMCOMPARE(key.key.contents,
+                              ncpKey->key.key.contents,
+                              EMBER_ENCRYPTION_KEY_SIZE) != 0
+                || MEMCOMPARE(key.partnerEUI64,
+                              ncpKey->key.partnerEUI64,
+                              EUI64_SIZE) != 0
+                || key.outgoingFrameCounter != ncpKey->key.outgoingFrameCounter
+                || (key.incomingFrameCounter
+                    != ncpKey->key.incomingFrameCounter)))) {
+      printf("After operation %ld, key %d differs\n", (long)operation, i);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static boolean checkNeighbors(int32u operation)
+{
+  EmberNeighborTableEntry neighbor;
+  int8u count = emberNeighborCount();
+  int8u i;
+  if (count != ncpNeighborCount && !silentlyChanged(neighborCountChangeTime)) {
+    printf("After operation %ld, neighbor count differs\n", (long)operation);
+    return FALSE;
+  }
+  for (i = 0; i < NEIGHBOR_SIZE; i++) {
+    EmberStatus status = emberGetNeighbor(i, &neighbor);
+    boolean same = (i < ncpNeighborCount
+                    ? (status == EMBER_SUCCESS
+                       && MEMCOMPARE(&neighbor,
+                                     &ncpNeighbors[i],
+                                     sizeof(neighbor)) == 0)
+                    : status == EMBER_ERR_FATAL);
+    if (!same
+        && !silentlyChanged(neighborChangeTimes[i])
+        && !silentlyChanged(neighborCountChangeTime)) {
+      printf("After operation %ld, neighbor %d differs\n",
+             (long)operation, i);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static boolean checkRoutes(int32u operation)
+{
+  EmberRouteTableEntry route;
+  int8u i;
+  for (i = 0; i < ROUTE_SIZE; i++) {
+    EmberStatus status = emberGetRouteTableEntry(i, &route);
+    if (status != EMBER_SUCCESS
+        || (MEMCOMPARE(&route, &ncpRoutes[i], sizeof(route)) != 0
+            && !silentlyChanged(routeChangeTimes[i]))) {
+      printf("After operation %ld, route %d differs\n", (long)operation, i);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// The entries that snapshots read must be the ones the NCP has.
+static boolean checkSnapshots(int32u operation)
+{
+  if (ezspTableMirrorSnapshot(EZSP_CHILD_TABLE_MIRROR, 0, 0xFF) != CHILD_SIZE
+      || (ezspTableMirrorSnapshot(EZSP_NEIGHBOR_TABLE_MIRROR, 0, 0xFF)
+          != NEIGHBOR_SIZE)
+      || (ezspTableMirrorSnapshot(EZSP_ROUTE_TABLE_MIRROR, 3, 5) != 5)) {
+    printf("After operation %ld, a snapshot is incomplete\n",
+           (long)operation);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static boolean checkTables(int32u operation)
+{
+  return (checkChildren(operation)
+          && checkKeys(operation)
+          && checkNeighbors(operation)
+          && checkRoutes(operation));
+}
+
+static boolean checkChanges(void)
+{
+  int16u versions[EZSP_TABLE_MIRROR_COUNT];
+  int32u i;
+  int8u t;
+
+  for (i = 0; i < OPERATION_COUNT; i++) {
+    makeChange();
+    if (!checkTables(i)) {
+      return FALSE;
+    }
+    if (i % 7 == 0) {
+      ezspTableMirrorInvalidate(rand() % EZSP_TABLE_MIRROR_COUNT);
+      if (!checkSnapshots(i) || !checkTables(i)) {
+        return FALSE;
+      }
+    }
+    // Reading the tables again straight away changes nothing.
+    for (t = 0; t < EZSP_TABLE_MIRROR_COUNT; t++) {
+      versions[t] = ezspTableMirrorVersion(t);
+    }
+    if (!checkChildren(i) || !checkKeys(i)) {
+      return FALSE;
+    }
+    for (t = 0; t < EZSP_TABLE_MIRROR_COUNT; t++) {
+      if (versions[t] != ezspTableMirrorVersion(t)) {
+        printf("After operation %ld, rereading table %d changed it\n",
+               (long)i, t);
+        return FALSE;
+      }
+    }
+  }
+  printf("The mirrors agree with the NCP after %d changes\n",
+         OPERATION_COUNT);
+  return TRUE;
+}
+
+//------------------------------------------------------------------------------
+// A monitoring loop that reads every table each poll while the network
+// changes slowly.
+
+enum {
+  READ_COMMANDS,
+  READ_MIRRORS,
+  READ_SNAPSHOTS
+};
+
+static void readTables(int8u how)
+{
+  EmberNodeId id;
+  EmberEUI64 eui64;
+  EmberNodeType type;
+  EmberNeighborTableEntry neighbor;
+  EmberRouteTableEntry route;
+  EmberKeyStruct key;
+  int8u count;
+  int8u i;
+
+  if (how == READ_SNAPSHOTS) {
+    ezspTableMirrorSnapshot(EZSP_CHILD_TABLE_MIRROR, 0, 0xFF);
+    ezspTableMirrorSnapshot(EZSP_NEIGHBOR_TABLE_MIRROR, 0, 0xFF);
+    ezspTableMirrorSnapshot(EZSP_ROUTE_TABLE_MIRROR, 0, 0xFF);
+  }
+  if (how == READ_COMMANDS) {
+    count = ezspReadNeighborCount();
+  } else {
+    count = emberNeighborCount();
+  }
+  for (i = 0; i < count; i++) {
+    if (how == READ_COMMANDS) {
+      ezspReadNeighbor(i, &neighbor);
+    } else {
+      emberGetNeighbor(i, &neighbor);
+    }
+  }
+  for (i = 0; i < CHILD_SIZE; i++) {
+    if (how == READ_COMMANDS) {
+      ezspReadChildData(i, &id, eui64, &type);
+    } else {
+      ezspGetChildData(i, &id, eui64, &type);
+    }
+  }
+  for (i = 0; i < ROUTE_SIZE; i++) {
+    if (how == READ_COMMANDS) {
+      ezspReadRouteTableEntry(i, &route);
+    } else {
+      emberGetRouteTableEntry(i, &route);
+    }
+  }
+  // Keys are always read from the NCP.
+  for (i = 0; i < KEY_SIZE; i++) {
+    emberGetKeyTableEntry(i, &key);
+  }
+}
+
+static int32u monitor(int8u how)
+{
+  int32u commands = commandCount;
+  int32u poll;
+
+  srand(2);
+  ezspTableMirrorInvalidate(EZSP_ALL_TABLE_MIRRORS);
+  for (poll = 0; poll < POLL_COUNT; poll++) {
+    nowMS += POLL_PERIOD_MS;
+    if (poll % 10 == 0) {
+      makeChange();
+    }
+    readTables(how);
+  }
+  return commandCount - commands;
+}
+
+int main(int argc, char *argv[])
+{
+  int32u rawCommands, mirrorCommands, snapshotCommands;
+  int32u saved;
+  int8u i;
+
+  srand(1);
+  for (i = 0; i < PARTNER_COUNT; i++) {
+    randomEui64(partners[i]);
+  }
+  for (i = 0; i < ROUTE_SIZE; i++) {
+    ncpRoutes[i].destination = EMBER_NULL_NODE_ID;
+    ncpRoutes[i].status = 3;
+  }
+  if (!checkChanges()) {
+    return 1;
+  }
+  if (maxResponseCount != EZSP_HOST_COMMAND_WINDOW_SIZE) {
+    printf("Snapshots had %d commands outstanding, not %d\n",
+           maxResponseCount, EZSP_HOST_COMMAND_WINDOW_SIZE);
+    return 1;
+  }
+
+  rawCommands = monitor(READ_COMMANDS);
+  saved = ezspTableMirrorSavedCommands();
+  mirrorCommands = monitor(READ_MIRRORS);
+  saved = ezspTableMirrorSavedCommands() - saved;
+  snapshotCommands = monitor(READ_SNAPSHOTS);
+  printf("%d polls of every table, %d ms apart:\n",
+         POLL_COUNT, POLL_PERIOD_MS);
+  printf("commands:  %8ld commands\n", (long)rawCommands);
+  printf("mirrors:   %8ld commands  %8ld saved\n",
+         (long)mirrorCommands, (long)saved);
+  printf("snapshots: %8ld commands, up to %d at once\n",
+         (long)snapshotCommands, EZSP_HOST_COMMAND_WINDOW_SIZE);
+  return 0;
+}
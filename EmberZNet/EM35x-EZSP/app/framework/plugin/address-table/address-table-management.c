@@ -41,9 +41,13 @@ EmberStatus emberAfSendCommandUnicastToEui64(EmberEUI64 destination)
 EmberStatus emberAfGetCurrentSenderEui64(EmberEUI64 address)
 {
   int8u index = emberAfGetAddressIndex();
-  if (index == EMBER_NULL_ADDRESS_TABLE_INDEX)
-    return EMBER_INVALID_CALL;
-  else {
+  if (index == EMBER_NULL_ADDRESS_TABLE_INDEX) {
+    // The sender is not in the address table, but the stack may still know
+    // its EUI64.
+    return (emberGetSenderEui64(address) == EMBER_SUCCESS
+            ? EMBER_SUCCESS
+            : EMBER_INVALID_CALL);
+  } else {
     return emberAfPluginAddressTableLookupByIndex(index, address);
   }
 }
@@ -17,7 +17,7 @@
 // For CLI
 #include "app/util/serial/command-interpreter2.h"
 
-EmberEventControl emAfFragmentationEvents[10];
+EmberEventControl emAfFragmentationEvent;
 
 #ifdef EZSP_HOST
 static int16u emberApsAckTimeoutMs    = 0;
@@ -27,6 +27,9 @@ static int8u  emberFragmentWindowSize =
 extern int8u  emberFragmentWindowSize;
 #endif //EZSP_HOST
 
+// Tick values are compared allowing for wrapping, as elsewhere.
+#define isEarlier(a, b) ((int32s)((a) - (b)) < 0)
+
 //------------------------------------------------------------------------------
 // Sending
 
@@ -34,9 +37,17 @@ static EmberStatus sendNextFragments(txFragmentedPacket* txPacket);
 static void abortTransmission(txFragmentedPacket *txPacket, EmberStatus status);
 static txFragmentedPacket* getFreeTxPacketEntry(void);
 static txFragmentedPacket* txPacketLookUp(EmberApsFrame *apsFrame);
+static void fileTxPacket(txFragmentedPacket *txPacket);
+static void releaseTxPacket(txFragmentedPacket *txPacket);
 
 static txFragmentedPacket txPackets[EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS];
 
+// Outgoing packets are filed by the APS sequence number of their fragments,
+// with those that hash the same in a list.
+#define txHash(sequence) \
+  ((sequence) % EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS)
+static int8u txHashHeads[EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS];
+
 EmberStatus emAfFragmentationSendUnicast(EmberOutgoingMessageType type,
                                          int16u indexOrDestination,
                                          EmberApsFrame *apsFrame,
@@ -51,6 +62,10 @@ EmberStatus emAfFragmentationSendUnicast(EmberOutgoingMessageType type,
     return EMBER_INVALID_CALL;
   }
 
+  if (bufLen > EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE) {
+    return EMBER_MESSAGE_TOO_LONG;
+  }
+
   txPacket = getFreeTxPacketEntry();
   if (txPacket == NULL) {
     return EMBER_MAX_MESSAGE_LIMIT_REACHED;
@@ -72,18 +87,21 @@ EmberStatus emAfFragmentationSendUnicast(EmberOutgoingMessageType type,
                                                          indexOrDestination,
                                                          &txPacket->apsFrame);
   fragments = ((bufLen + txPacket->fragmentLen - 1) / txPacket->fragmentLen);
-  if (fragments > MAX_INT8U_VALUE
-      || bufLen > EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE) {
+  if (fragments > MAX_INT8U_VALUE) {
     return EMBER_MESSAGE_TOO_LONG;
   }
   txPacket->messageType = type;
   txPacket->fragmentCount = (int8u)fragments;
   txPacket->fragmentBase = 0;
   txPacket->fragmentsInTransit = 0;
+  txPacket->windowSize = emberFragmentWindowSize;
+  txPacket->sequence = txPacket->apsFrame.sequence;
+  txPacket->next = txHashHeads[txHash(txPacket->sequence)];
+  txHashHeads[txHash(txPacket->sequence)] = txPacket - txPackets;
 
   status = sendNextFragments(txPacket);
-  if (status != EMBER_SUCCESS) {
-    txPacket->messageType = 0xFF;
+  if (status != EMBER_SUCCESS && txPacket->messageType != 0xFF) {
+    releaseTxPacket(txPacket);
   }
   return status;
 }
@@ -101,7 +119,7 @@ boolean emAfFragmentationMessageSent(EmberApsFrame *apsFrame,
     if (status == EMBER_SUCCESS) {
       txPacket->fragmentsInTransit--;
       if (txPacket->fragmentsInTransit == 0) {
-        txPacket->fragmentBase += emberFragmentWindowSize;
+        txPacket->fragmentBase += txPacket->windowSize;
         abortTransmission(txPacket, sendNextFragments(txPacket));
       }
     } else {
@@ -122,7 +140,7 @@ static EmberStatus sendNextFragments(txFragmentedPacket* txPacket)
 
   // Send fragments until the window is full.
   for (i = txPacket->fragmentBase;
-       i < txPacket->fragmentBase + emberFragmentWindowSize
+       i < txPacket->fragmentBase + txPacket->windowSize
        && i < txPacket->fragmentCount;
        i++) {
     EmberStatus status;
@@ -175,13 +193,15 @@ static EmberStatus sendNextFragments(txFragmentedPacket* txPacket)
       return status;
     }
 
+    fileTxPacket(txPacket);
     txPacket->fragmentsInTransit++;
     offset += fragmentLen;
   } // close inner for
 
   if (txPacket->fragmentsInTransit == 0) {
-    txPacket->messageType = 0xFF;
-    emAfFragmentationMessageSentHandler(txPacket->messageType,
+    EmberOutgoingMessageType type = txPacket->messageType;
+    releaseTxPacket(txPacket);
+    emAfFragmentationMessageSentHandler(type,
                                         txPacket->indexOrDestination,
                                         &txPacket->apsFrame,
                                         txPacket->buffer,
@@ -202,7 +222,7 @@ static void abortTransmission(txFragmentedPacket *txPacket,
                                         txPacket->buffer,
                                         txPacket->bufLen,
                                         status);
-    txPacket->messageType = 0xFF;
+    releaseTxPacket(txPacket);
   }
 }
 
@@ -220,21 +240,45 @@ static txFragmentedPacket* getFreeTxPacketEntry(void)
 
 static txFragmentedPacket* txPacketLookUp(EmberApsFrame *apsFrame)
 {
-  int8u i;
-  for(i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS; i++) {
+  int8u i = txHashHeads[txHash(apsFrame->sequence)];
+  while (i != EMBER_AF_PLUGIN_FRAGMENTATION_NULL_INDEX) {
     txFragmentedPacket *txPacket = &(txPackets[i]);
-    if (txPacket->messageType == 0xFF) {
-      continue;
-    }
-
     // Each node has a single source APS counter.
-    if (apsFrame->sequence == txPacket->apsFrame.sequence) {
+    if (apsFrame->sequence == txPacket->sequence) {
       return txPacket;
     }
+    i = txPacket->next;
   }
   return NULL;
 }
 
+static void unfileTxPacket(txFragmentedPacket *txPacket)
+{
+  int8u *link = &txHashHeads[txHash(txPacket->sequence)];
+  while (&txPackets[*link] != txPacket) {
+    link = &txPackets[*link].next;
+  }
+  *link = txPacket->next;
+}
+
+// Sending a fragment gives the APS frame the sequence number used, so the
+// packet is filed again if it has changed.
+static void fileTxPacket(txFragmentedPacket *txPacket)
+{
+  if (txPacket->sequence != txPacket->apsFrame.sequence) {
+    unfileTxPacket(txPacket);
+    txPacket->sequence = txPacket->apsFrame.sequence;
+    txPacket->next = txHashHeads[txHash(txPacket->sequence)];
+    txHashHeads[txHash(txPacket->sequence)] = txPacket - txPackets;
+  }
+}
+
+static void releaseTxPacket(txFragmentedPacket *txPacket)
+{
+  unfileTxPacket(txPacket);
+  txPacket->messageType = 0xFF;
+}
+
 
 //------------------------------------------------------------------------------
 // Receiving.
@@ -246,17 +290,49 @@ static boolean storeRxFragment(rxFragmentedPacket *rxPacket,
                                int8u *buffer,
                                int16u bufLen);
 static void moveRxWindow(rxFragmentedPacket *rxPacket);
+static boolean moveLastRxFragment(rxFragmentedPacket *rxPacket,
+                                  int8u fragmentLen);
+static void setRxTimeout(rxFragmentedPacket *rxPacket);
+static void abortReception(rxFragmentedPacket *rxPacket);
 static rxFragmentedPacket* getFreeRxPacketEntry(void);
 static rxFragmentedPacket* rxPacketLookUp(EmberApsFrame *apsFrame,
                                           EmberNodeId sender);
+static void fileRxPacket(rxFragmentedPacket *rxPacket);
+static void unfileRxPacket(rxFragmentedPacket *rxPacket);
+static boolean growRxPacket(rxFragmentedPacket *rxPacket, int16u length);
+static void copyRxPacket(rxFragmentedPacket *rxPacket,
+                         int16u index,
+                         int8u *buffer,
+                         int16u bufLen,
+                         boolean store);
+static void releaseRxBlocks(rxFragmentedPacket *rxPacket);
 
 static rxFragmentedPacket rxPackets[EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS];
 
+// Incoming packets are filed by sender and APS sequence number, with those
+// that hash the same in a list.  Every packet that is not available is filed.
+#define rxHash(sender, sequence)                             \
+  (((int16u)(sender) ^ ((int16u)(sequence) * 0x0101))        \
+   % EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS)
+static int8u rxHashHeads[EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS];
+
+// The pool of blocks that incoming packets are reassembled in.  Each packet
+// has a list of blocks, in order, that is extended as fragments arrive.  A
+// complete packet is copied out of its blocks into a single buffer to be
+// passed to the application, and its blocks are freed straight away.
+#define RX_BLOCK_SIZE  EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_SIZE
+#define RX_BLOCK_COUNT EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_COUNT
+static int8u rxBlocks[RX_BLOCK_COUNT][RX_BLOCK_SIZE];
+static int16u rxBlockNext[RX_BLOCK_COUNT];
+static int16u rxFreeBlocks;
+static int8u rxBuffer[EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE];
+
 static void ageAllAckedRxPackets(void)
 {
   int8u i;
   for(i=0; i<EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS; i++) {
-    if (rxPackets[i].status == EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_ACKED) {
+    if (rxPackets[i].status == EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_ACKED
+        && rxPackets[i].ackedPacketAge < MAX_INT8U_VALUE) {
       rxPackets[i].ackedPacketAge++;
     }
   }
@@ -267,7 +343,6 @@ boolean emAfFragmentationIncomingMessage(EmberApsFrame *apsFrame,
                                          int8u **buffer,
                                          int16u *bufLen)
 {
-  static boolean rxWindowMoved = FALSE;
   boolean newFragment;
   int8u fragment;
   int8u mask;
@@ -284,69 +359,89 @@ boolean emAfFragmentationIncomingMessage(EmberApsFrame *apsFrame,
 
   // First fragment for this packet, we need to set up a new entry.
   if (rxPacket == NULL) {
+    if (fragment >= emberFragmentWindowSize)
+      return TRUE;
     rxPacket = getFreeRxPacketEntry();
-    if (rxPacket == NULL || fragment >= emberFragmentWindowSize)
+    if (rxPacket == NULL)
       return TRUE;
 
+    if (rxPacket->status != EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE) {
+      unfileRxPacket(rxPacket);
+    }
     rxPacket->status = EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_IN_USE;
     rxPacket->fragmentSource = sender;
     rxPacket->fragmentSequenceNumber = apsFrame->sequence;
+    fileRxPacket(rxPacket);
+    rxPacket->windowSize = emberFragmentWindowSize;
+    rxPacket->windowMoved = FALSE;
     rxPacket->fragmentBase = 0;
     rxPacket->windowFinger = 0;
     rxPacket->fragmentsReceived = 0;
     rxPacket->fragmentsExpected = 0xFF;
     rxPacket->fragmentLen = (int8u)(*bufLen);
+    rxPacket->packetLength = 0;
+    rxPacket->blockCount = 0;
     setFragmentMask(rxPacket);
+    setRxTimeout(rxPacket);
+  }
 
-    emberEventControlSetDelayMS(*(rxPacket->fragmentEventControl),
-                                (emberApsAckTimeoutMs
-                                 * ZIGBEE_APSC_MAX_TRANSMIT_RETRIES));
+  // A late copy of a fragment from a window that has already been received.
+  if (fragment < rxPacket->fragmentBase) {
+    return TRUE;
   }
 
   // All fragments inside the rx window have been received and the incoming
   // fragment is outside the receiving window: let's move the rx window.
   if (rxPacket->fragmentMask == 0xFF
-      && rxPacket->fragmentBase + emberFragmentWindowSize <= fragment) {
+      && rxPacket->fragmentBase + rxPacket->windowSize <= fragment) {
     moveRxWindow(rxPacket);
     setFragmentMask(rxPacket);
-    rxWindowMoved = TRUE;
-
-    emberEventControlSetDelayMS(*(rxPacket->fragmentEventControl),
-                                (emberApsAckTimeoutMs
-                                 * ZIGBEE_APSC_MAX_TRANSMIT_RETRIES));
+    rxPacket->windowMoved = TRUE;
+    setRxTimeout(rxPacket);
   }
 
   // Fragment outside the rx window.
-  if (rxPacket->fragmentBase + emberFragmentWindowSize <= fragment) {
+  if (rxPacket->fragmentBase + rxPacket->windowSize <= fragment) {
     return TRUE;
   } else { // Fragment inside the rx window.
-    if (rxWindowMoved){
+    if (rxPacket->windowMoved){
       // We assume that the fragment length for the new rx window is the length
       // of the first fragment received inside the window. However, if the first
       // fragment received is the last fragment of the packet, we do not
       // consider it for setting the fragment length.
       if (fragment < rxPacket->fragmentsExpected - 1) {
         rxPacket->fragmentLen = (int8u)(*bufLen);
-        rxWindowMoved = FALSE;
+        rxPacket->windowMoved = FALSE;
       }
-    } else {
+    } else if (fragment < rxPacket->fragmentsExpected - 1
+               && rxPacket->fragmentLen != (int8u)(*bufLen)) {
       // We enforce that all the subsequent fragments (except for the last
       // fragment) inside the rx window have the same length as the first one.
-      if (fragment < rxPacket->fragmentsExpected - 1
-          && rxPacket->fragmentLen != (int8u)(*bufLen)) {
+      // Until the first fragment arrives we do not know which is the last, so
+      // a shorter fragment is taken to be the last one, and a longer one means
+      // that the one that set the fragment length was the last one.
+      if (rxPacket->fragmentsExpected != 0xFF) {
         goto kickout;
+      } else if ((int8u)(*bufLen) > rxPacket->fragmentLen) {
+        if (rxPacket->fragmentsReceived != 1
+            || !moveLastRxFragment(rxPacket, (int8u)(*bufLen))) {
+          goto kickout;
+        }
       }
     }
   }
 
-  mask = 1 << (fragment % emberFragmentWindowSize);
+  mask = 1 << (fragment % rxPacket->windowSize);
   newFragment = !(mask & rxPacket->fragmentMask);
 
-  // First fragment, setting the total number of expected fragments.
+  // First fragment, setting the total number of expected fragments.  Any
+  // later fragments inside the window may have arrived already.
   if (fragment == 0) {
     rxPacket->fragmentsExpected = HIGH_BYTE(apsFrame->groupId);
-    if (rxPacket->fragmentsExpected < emberFragmentWindowSize) {
+    if (rxPacket->fragmentsExpected < rxPacket->windowSize) {
+      int8u received = rxPacket->fragmentMask;
       setFragmentMask(rxPacket);
+      rxPacket->fragmentMask |= received;
     }
   }
 
@@ -360,7 +455,7 @@ boolean emAfFragmentationIncomingMessage(EmberApsFrame *apsFrame,
 
   if (fragment == rxPacket->fragmentsExpected - 1
       || (rxPacket->fragmentMask
-          | lowBitMask(fragment % emberFragmentWindowSize)) == 0xFF) {
+          | lowBitMask(fragment % rxPacket->windowSize)) == 0xFF) {
 #ifdef EZSP_HOST
     apsFrame->groupId =
         HIGH_LOW_TO_INT(rxPacket->fragmentMask, rxPacket->fragmentBase);
@@ -374,11 +469,6 @@ boolean emAfFragmentationIncomingMessage(EmberApsFrame *apsFrame,
 
   // Received all the expected fragments.
   if (rxPacket->fragmentsReceived == rxPacket->fragmentsExpected) {
-    int8u fragmentsInLastWindow =
-        rxPacket->fragmentsExpected % emberFragmentWindowSize;
-    if (fragmentsInLastWindow == 0)
-      fragmentsInLastWindow = emberFragmentWindowSize;
-
     // Pass the reassembled packet only once to the application.
     if (rxPacket->status == EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_IN_USE) {
       //Age all acked packets first
@@ -392,42 +482,77 @@ boolean emAfFragmentationIncomingMessage(EmberApsFrame *apsFrame,
       // from sending a duplicate reply.
       apsFrame->options &= ~EMBER_APS_OPTION_RETRY;
 
-      // The total size is the window finger + (n-1) full fragments + the last
-      // fragment.
-      *bufLen = rxPacket->windowFinger + rxPacket->lastfragmentLen
-                 + (fragmentsInLastWindow - 1)*rxPacket->fragmentLen;
-      *buffer = rxPacket->buffer;
+      // The total size is up to the end of the last fragment.
+      *bufLen = rxPacket->packetLength;
+      copyRxPacket(rxPacket, 0, rxBuffer, *bufLen, FALSE);
+      releaseRxBlocks(rxPacket);
+      *buffer = rxBuffer;
       return FALSE;
     }
   }
   return TRUE;
 
 kickout:
-  emAfFragmentationAbortReception(rxPacket->fragmentEventControl);
+  abortReception(rxPacket);
   return TRUE;
 }
 
+// Drops every incoming packet whose time is up, and sets the event again for
+// the next one.
 void emAfFragmentationAbortReception(EmberEventControl *control)
 {
+  int32u now = halCommonGetInt32uMillisecondTick();
+  int32u next = now;
+  boolean pending = FALSE;
   int8u i;
   emberEventControlSetInactive(*control);
 
   for(i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS; i++) {
     rxFragmentedPacket *rxPacket = &(rxPackets[i]);
-    if (rxPacket->fragmentEventControl == control) {
-      rxPacket->status = EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE;
+    if (rxPacket->status == EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE) {
+      continue;
     }
+    if (!isEarlier(now, rxPacket->timeout)) {
+      abortReception(rxPacket);
+    } else if (!pending || isEarlier(rxPacket->timeout, next)) {
+      next = rxPacket->timeout;
+      pending = TRUE;
+    }
+  }
+
+  if (pending) {
+    emberEventControlSetDelayMS(*control, (int16u)(next - now));
+  }
+}
+
+static void setRxTimeout(rxFragmentedPacket *rxPacket)
+{
+  int16u delay = emberApsAckTimeoutMs * ZIGBEE_APSC_MAX_TRANSMIT_RETRIES;
+  rxPacket->timeout = halCommonGetInt32uMillisecondTick() + delay;
+  // Every packet has the same delay, so an event already set is due no later
+  // than this packet.
+  if (!emberEventControlGetActive(emAfFragmentationEvent)) {
+    emberEventControlSetDelayMS(emAfFragmentationEvent, delay);
+  }
+}
+
+static void abortReception(rxFragmentedPacket *rxPacket)
+{
+  if (rxPacket->status != EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE) {
+    unfileRxPacket(rxPacket);
+    releaseRxBlocks(rxPacket);
+    rxPacket->status = EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE;
   }
 }
 
 static void setFragmentMask(rxFragmentedPacket *rxPacket)
 {
   // Unused bits must be 1.
-  int8u highestZeroBit = emberFragmentWindowSize;
+  int8u highestZeroBit = rxPacket->windowSize;
   // If we are in the final window, there may be additional unused bits.
   if (rxPacket->fragmentsExpected
-      < rxPacket->fragmentBase + emberFragmentWindowSize) {
-    highestZeroBit = (rxPacket->fragmentsExpected % emberFragmentWindowSize);
+      < rxPacket->fragmentBase + rxPacket->windowSize) {
+    highestZeroBit = (rxPacket->fragmentsExpected % rxPacket->windowSize);
   }
   rxPacket->fragmentMask = ~ lowBitMask(highestZeroBit);
 }
@@ -437,27 +562,113 @@ static boolean storeRxFragment(rxFragmentedPacket *rxPacket,
                                int8u *buffer,
                                int16u bufLen)
 {
-  int16u index = rxPacket->windowFinger;
+  int16u index = rxPacket->windowFinger
+                 + (fragment - rxPacket->fragmentBase)*rxPacket->fragmentLen;
 
-  if (index + bufLen > EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE) {
+  if (index + bufLen > EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE
+      || !growRxPacket(rxPacket, index + bufLen)) {
     return FALSE;
   }
 
-  index += (fragment - rxPacket->fragmentBase)*rxPacket->fragmentLen;
-  MEMCOPY(rxPacket->buffer + index, buffer, bufLen);
+  copyRxPacket(rxPacket, index, buffer, bufLen, TRUE);
 
-  // If this is the last fragment of the packet, store its length.
-  if (fragment == rxPacket->fragmentsExpected - 1) {
-    rxPacket->lastfragmentLen = (int8u)bufLen;
+  if (rxPacket->packetLength < index + bufLen) {
+    rxPacket->packetLength = index + bufLen;
   }
 
   return TRUE;
 }
 
+// The only fragment received so far in the first window set the fragment
+// length, but was the last fragment of the packet, as a longer one has
+// arrived.  It is moved to where it belongs for the new fragment length.
+static boolean moveLastRxFragment(rxFragmentedPacket *rxPacket,
+                                  int8u fragmentLen)
+{
+  int8u length = rxPacket->fragmentLen;
+  int8u fragment = 0;
+  int16u index;
+
+  while (!(rxPacket->fragmentMask & BIT(fragment))) {
+    fragment++;
+  }
+  index = fragment * length;
+  copyRxPacket(rxPacket, index, rxBuffer, length, FALSE);
+  rxPacket->fragmentLen = fragmentLen;
+  index = fragment * fragmentLen;
+  if (index + length > EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE
+      || !growRxPacket(rxPacket, index + length)) {
+    return FALSE;
+  }
+  copyRxPacket(rxPacket, index, rxBuffer, length, TRUE);
+  rxPacket->packetLength = index + length;
+  return TRUE;
+}
+
 static void moveRxWindow(rxFragmentedPacket *rxPacket)
 {
-  rxPacket->fragmentBase += emberFragmentWindowSize;
-  rxPacket->windowFinger += emberFragmentWindowSize*rxPacket->fragmentLen;
+  rxPacket->fragmentBase += rxPacket->windowSize;
+  rxPacket->windowFinger += rxPacket->windowSize*rxPacket->fragmentLen;
+}
+
+// Adds blocks from the pool until the packet has room for length bytes.
+static boolean growRxPacket(rxFragmentedPacket *rxPacket, int16u length)
+{
+  while ((int32u)rxPacket->blockCount * RX_BLOCK_SIZE < length) {
+    int16u block = rxFreeBlocks;
+    if (block == EMBER_AF_PLUGIN_FRAGMENTATION_NULL_BLOCK) {
+      return FALSE;
+    }
+    rxFreeBlocks = rxBlockNext[block];
+    rxBlockNext[block] = EMBER_AF_PLUGIN_FRAGMENTATION_NULL_BLOCK;
+    if (rxPacket->blockCount == 0) {
+      rxPacket->firstBlock = block;
+    } else {
+      rxBlockNext[rxPacket->lastBlock] = block;
+    }
+    rxPacket->lastBlock = block;
+    rxPacket->blockCount++;
+  }
+  return TRUE;
+}
+
+// Copies bytes into the packet's blocks, starting at index, if store is TRUE,
+// or out of them if it is FALSE.
+static void copyRxPacket(rxFragmentedPacket *rxPacket,
+                         int16u index,
+                         int8u *buffer,
+                         int16u bufLen,
+                         boolean store)
+{
+  int16u block = rxPacket->firstBlock;
+  while (index >= RX_BLOCK_SIZE) {
+    block = rxBlockNext[block];
+    index -= RX_BLOCK_SIZE;
+  }
+  while (bufLen > 0) {
+    int16u length = RX_BLOCK_SIZE - index;
+    if (length > bufLen) {
+      length = bufLen;
+    }
+    if (store) {
+      MEMCOPY(rxBlocks[block] + index, buffer, length);
+    } else {
+      MEMCOPY(buffer, rxBlocks[block] + index, length);
+    }
+    buffer += length;
+    bufLen -= length;
+    index = 0;
+    block = rxBlockNext[block];
+  }
+}
+
+static void releaseRxBlocks(rxFragmentedPacket *rxPacket)
+{
+  if (rxPacket->blockCount != 0) {
+    rxBlockNext[rxPacket->lastBlock] = rxFreeBlocks;
+    rxFreeBlocks = rxPacket->firstBlock;
+    rxPacket->blockCount = 0;
+  }
 }
 
 static rxFragmentedPacket* getFreeRxPacketEntry(void)
@@ -490,37 +701,63 @@ static rxFragmentedPacket* getFreeRxPacketEntry(void)
 static rxFragmentedPacket* rxPacketLookUp(EmberApsFrame *apsFrame,
                                           EmberNodeId sender)
 {
-  int8u i;
-  for(i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS; i++) {
+  int8u i = rxHashHeads[rxHash(sender, apsFrame->sequence)];
+  while (i != EMBER_AF_PLUGIN_FRAGMENTATION_NULL_INDEX) {
     rxFragmentedPacket *rxPacket = &(rxPackets[i]);
-    if (rxPacket->status == EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE) {
-      continue;
-    }
     // Each packet is univocally identified by the pair (node id, seq. number).
     if (apsFrame->sequence == rxPacket->fragmentSequenceNumber
         && sender == rxPacket->fragmentSource) {
       return rxPacket;
     }
+    i = rxPacket->next;
   }
   return NULL;
 }
 
+static void fileRxPacket(rxFragmentedPacket *rxPacket)
+{
+  int8u *head = &rxHashHeads[rxHash(rxPacket->fragmentSource,
+                                    rxPacket->fragmentSequenceNumber)];
+  rxPacket->next = *head;
+  *head = rxPacket - rxPackets;
+}
+
+static void unfileRxPacket(rxFragmentedPacket *rxPacket)
+{
+  int8u *link = &rxHashHeads[rxHash(rxPacket->fragmentSource,
+                                    rxPacket->fragmentSequenceNumber)];
+  while (&rxPackets[*link] != rxPacket) {
+    link = &rxPackets[*link].next;
+  }
+  *link = rxPacket->next;
+}
+
 //------------------------------------------------------------------------------
 // Initialization
 void emberAfPluginFragmentationInitCallback(void)
 {
-  int8u i;
+  int16u i;
 #ifndef EZSP_HOST
   emberFragmentWindowSize = EMBER_AF_PLUGIN_FRAGMENTATION_RX_WINDOW_SIZE;
 #endif //EZSP_HOST
 
+  emberEventControlSetInactive(emAfFragmentationEvent);
   for(i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS; i++) {
     rxPackets[i].status = EMBER_AF_PLUGIN_FRAGMENTATION_RX_PACKET_AVAILABLE;
-    rxPackets[i].fragmentEventControl = &(emAfFragmentationEvents[i]);
+    rxPackets[i].blockCount = 0;
+    rxHashHeads[i] = EMBER_AF_PLUGIN_FRAGMENTATION_NULL_INDEX;
+  }
+
+  for(i = 0; i < RX_BLOCK_COUNT; i++) {
+    rxBlockNext[i] = (i + 1 < RX_BLOCK_COUNT
+                      ? i + 1
+                      : EMBER_AF_PLUGIN_FRAGMENTATION_NULL_BLOCK);
   }
+  rxFreeBlocks = 0;
 
   for(i = 0; i < EMBER_AF_PLUGIN_FRAGMENTATION_MAX_OUTGOING_PACKETS; i++) {
     txPackets[i].messageType = 0xFF;
+    txHashHeads[i] = EMBER_AF_PLUGIN_FRAGMENTATION_NULL_INDEX;
   }
 }
 
@@ -26,34 +26,48 @@
 #define EMBER_AF_PLUGIN_FRAGMENTATION_RX_WINDOW_SIZE 1
 #endif //EMBER_AF_PLUGIN_FRAGMENTATION_RX_WINDOW_SIZE
 
-// TODO: We should have the App Builder generating these events. For now, I
-// manually added 10 events which means we will be able to set and accept up to
-// 10 incoming distinct fragmented packets. In AppBuilder the max incoming
-// packets number is capped to 10, therefore we will never run out of events.
+// Incoming fragmented packets are reassembled in blocks taken from a pool
+// shared by all of them, so that many packets can be received at once without
+// each needing a buffer for the largest packet.  The pool holds
+// EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE bytes.  If that is undefined or 0,
+// the pool is made large enough for every incoming packet to be of the largest
+// size.  Otherwise it must hold at least one packet of the largest size.
+#if defined(EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE) \
+    && EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE == 0
+#undef EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE
+#endif
+#ifndef EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE
+#define EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE \
+  (EMBER_AF_PLUGIN_FRAGMENTATION_MAX_INCOMING_PACKETS \
+   * EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE)
+#endif //EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE
+
+#if EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE \
+    < EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE
+  #error "The fragmentation reassembly pool is smaller than the max packet size."
+#endif
+
+#ifndef EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_SIZE
+#define EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_SIZE 64
+#endif //EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_SIZE
+
+#define EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_COUNT      \
+  ((EMBER_AF_PLUGIN_FRAGMENTATION_RX_POOL_SIZE            \
+    + EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_SIZE - 1)    \
+   / EMBER_AF_PLUGIN_FRAGMENTATION_RX_BLOCK_SIZE)
+
+#define EMBER_AF_PLUGIN_FRAGMENTATION_NULL_INDEX 0xFF
+#define EMBER_AF_PLUGIN_FRAGMENTATION_NULL_BLOCK 0xFFFF
+
+// A single event times out all the incoming fragmented packets, so the number
+// of them is not limited by the number of events.
 #define EMBER_AF_FRAGMENTATION_EVENTS \
-  {&(emAfFragmentationEvents[0]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[1]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[3]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[4]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[5]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[6]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[7]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[8]), (void (*)(void))emAfFragmentationAbortReception}, \
-  {&(emAfFragmentationEvents[9]), (void (*)(void))emAfFragmentationAbortReception},
+  {&emAfFragmentationEvent, (void (*)(void))emAfFragmentationAbortReception},
 
 #define EMBER_AF_FRAGMENTATION_EVENT_STRINGS \
-  "Frag 0", \
-  "Frag 1", \
-  "Frag 2", \
-  "Frag 3", \
-  "Frag 4", \
-  "Frag 5", \
-  "Frag 6", \
-  "Frag 7", \
-  "Frag 8", \
-  "Frag 9",
-
-extern EmberEventControl emAfFragmentationEvents[10];
+  "Frag timeout",
+
+extern EmberEventControl emAfFragmentationEvent;
 
 //------------------------------------------------------------------------------
 // Sending
@@ -61,7 +75,8 @@ extern EmberEventControl emAfFragmentationEvents[10];
 typedef struct {
   EmberOutgoingMessageType  messageType;
   int16u                    indexOrDestination;
-  int8u                     sequence;
+  int8u                     sequence; // APS sequence number it is filed under
+  int8u                     next;     // next packet filed under the same hash
   EmberApsFrame             apsFrame;
 #ifdef EZSP_APPLICATION_HAS_ROUTE_RECORD_HANDLER
   boolean                   sourceRoute;
@@ -74,6 +89,7 @@ typedef struct {
   int8u                     fragmentCount;
   int8u                     fragmentBase;
   int8u                     fragmentsInTransit;
+  int8u                     windowSize; // tx window size when the packet started.
 }txFragmentedPacket;
 
 EmberStatus emAfFragmentationSendUnicast(EmberOutgoingMessageType type,
@@ -104,19 +120,25 @@ typedef enum {
 typedef struct {
   rxPacketStatus status;
   int8u       ackedPacketAge;
-  int8u       buffer[EMBER_AF_PLUGIN_FRAGMENTATION_BUFFER_SIZE];
   EmberNodeId fragmentSource;
   int8u       fragmentSequenceNumber;
+  int8u       next; // next packet filed under the same hash.
+  int8u       windowSize; // rx window size when the packet started.
+  boolean     windowMoved; // the rx window has moved, but no fragment inside
+                           // it has set the fragment length yet.
   int8u       fragmentBase; // first fragment inside the rx window.
   int16u      windowFinger; //points to the first byte inside the rx window.
   int8u       fragmentsExpected; // total number of fragments expected.
   int8u       fragmentsReceived; // fragments received so far.
   int8u       fragmentMask; // bitmask of received fragments inside the rx window.
-  int8u       lastfragmentLen; // Length of the last fragment.
   int8u       fragmentLen; // Length of the fragment inside the rx window.
                            // All the fragments inside the rx window should have
                            // the same length.
-  EmberEventControl *fragmentEventControl;
+  int16u      packetLength; // bytes up to the end of the furthest fragment.
+  int16u      firstBlock; // pool blocks holding the packet received so far.
+  int16u      lastBlock;
+  int16u      blockCount;
+  int32u      timeout; // millisecond tick at which the packet is dropped.
 }rxFragmentedPacket;
 
 boolean emAfFragmentationIncomingMessage(EmberApsFrame *apsFrame,
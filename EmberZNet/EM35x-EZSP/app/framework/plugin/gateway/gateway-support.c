@@ -16,6 +16,7 @@
 #include "app/ezsp-uart-host/ash-host.h"
 #include "app/ezsp-uart-host/ash-host-io.h"
 #include "app/ezsp-uart-host/ash-host-ui.h"
+#include "app/util/ezsp/serial-interface.h"
 
 #include "app/util/serial/command-interpreter2.h"
 #include "app/util/serial/linux-serial.h"
@@ -26,21 +27,42 @@
 #include <unistd.h>     // ""
 #include <errno.h>      // ""
 
+// Linux can wait with epoll, which keeps the descriptors registered between
+// calls and reports which of them are ready.
+#if defined(__linux__)
+  #define GATEWAY_USE_EPOLL
+  #include <sys/epoll.h>
+  #include <sys/timerfd.h>
+#endif
+
 //------------------------------------------------------------------------------
 // Globals
 
 // This defines how long select() will wait for data.  0 = wait forever.
 // Because ASH needs to check for timeout in messages sends, we
 // must periodically wakeup.  Timeouts are rare but could occur.
+// The epoll loop instead wakes for the ASH timers themselves, and only
+// uses this while the NCP is not connected or an asynchronous EZSP command
+// is waiting for its response.
 #define READ_TIMEOUT_MS  100
-#define MAX_FDS 10
+#define MAX_FDS EMBER_AF_PLUGIN_GATEWAY_MAX_FDS
 #define INVALID_FD -1
+#define NO_TIMEOUT 0xFFFFFFFFUL
 
 static const char* debugLabel = "gateway-debug";
 static const boolean debugOn = FALSE;
 
 static const char cliPrompt[] = ZA_PROMPT;
 
+#ifdef GATEWAY_USE_EPOLL
+static int epollFd = INVALID_FD;
+static int timerFd = INVALID_FD;
+static boolean timerArmed = FALSE;
+static int32u timerDeadline;            // millisecond tick the timer is set for
+static int watchedFds[MAX_FDS];         // registered with epollFd
+static int8u ashOpenCount;              // when the ASH fd was registered
+#endif
+
 //------------------------------------------------------------------------------
 // External Declarations
 
@@ -49,6 +71,12 @@ static const char cliPrompt[] = ZA_PROMPT;
 
 static void getFdsToWatch(int* list, int maxSize);
 static void debugPrint(const char* formatString, ...);
+#ifdef GATEWAY_USE_EPOLL
+static boolean gatewayEpollInit(void);
+static void updateWatchedFds(void);
+static void setWakeupTimer(int32u timeoutMs);
+static void dispatchReadyFd(int fd);
+#endif
 
 //------------------------------------------------------------------------------
 // Functions
@@ -104,6 +132,220 @@ boolean emberAfMainStartCallback(int* returnCode,
   return FALSE;
 }
 
+// Returns how long the gateway may sleep before something needs doing:
+// the next application event, the next ASH timer, or right away if received
+// data is already waiting to be processed.
+static int32u gatewayMsToNextWakeup(void)
+{
+  int32u timeoutMs = emberAfMsToNextEvent(NO_TIMEOUT);
+  int16u ashMs = ashMsToNextTimer();
+
+  if (ashSerialInputIsBuffered() || serialPendingResponseCount() > 0) {
+    return 0;
+  }
+  if (ashMs != 0xFFFF && ashMs < timeoutMs) {
+    timeoutMs = ashMs;
+  }
+  if ((!ashIsConnected() || ezspPendingCommandCount() > 0)
+      && timeoutMs > READ_TIMEOUT_MS) {
+    timeoutMs = READ_TIMEOUT_MS;
+  }
+  return timeoutMs;
+}
+
+#ifdef GATEWAY_USE_EPOLL
+
+// Every descriptor stays registered with a single epoll instance, so each
+// wait is one epoll_wait() call.  The sleep is bounded by a timerfd set for
+// exactly the next wakeup time; it is only reprogrammed when that time
+// changes.  Descriptors that become ready are handed straight to whoever
+// reads them.
+
+static boolean gatewayEpollInit(void)
+{
+  struct epoll_event event;
+  int i;
+
+  if (epollFd != INVALID_FD) {
+    return TRUE;
+  }
+  epollFd = epoll_create(MAX_FDS + 1);
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (epollFd < 0 || timerFd < 0) {
+    fprintf(stderr, "FATAL: epoll setup failed: %s\n", strerror(errno));
+    assert(FALSE);
+  }
+  MEMSET(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = timerFd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event) < 0) {
+    fprintf(stderr, "FATAL: epoll_ctl() returned error: %s\n",
+            strerror(errno));
+    assert(FALSE);
+  }
+  for (i = 0; i < MAX_FDS; i++) {
+    watchedFds[i] = INVALID_FD;
+  }
+  return TRUE;
+}
+
+static boolean fdInList(int fd, const int* list)
+{
+  int i;
+  for (i = 0; i < MAX_FDS; i++) {
+    if (list[i] == fd) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+// Brings the epoll registrations in line with the current descriptors.
+// Usually nothing has changed and no system calls are made.  A descriptor
+// that was closed has already been dropped by the kernel, so a failure to
+// remove it is expected.  The ASH port is registered again whenever it has
+// been reopened, since the new descriptor may have the same number.
+static void updateWatchedFds(void)
+{
+  int fdsToWatch[MAX_FDS];
+  struct epoll_event event;
+  int ashFd = ashSerialGetFd();
+  int i;
+
+  getFdsToWatch(fdsToWatch, MAX_FDS);
+
+  if (ashOpenCount != ashSerialGetOpenCount()) {
+    ashOpenCount = ashSerialGetOpenCount();
+    for (i = 0; i < MAX_FDS; i++) {
+      if (watchedFds[i] == ashFd) {
+        watchedFds[i] = INVALID_FD;
+      }
+    }
+    if (ashFd != INVALID_FD) {
+      (void)epoll_ctl(epollFd, EPOLL_CTL_DEL, ashFd, NULL);
+    }
+  }
+
+  for (i = 0; i < MAX_FDS; i++) {
+    if (watchedFds[i] != INVALID_FD
+        && !fdInList(watchedFds[i], fdsToWatch)) {
+      debugPrint("No longer watching FD %d.", watchedFds[i]);
+      (void)epoll_ctl(epollFd, EPOLL_CTL_DEL, watchedFds[i], NULL);
+      watchedFds[i] = INVALID_FD;
+    }
+  }
+
+  for (i = 0; i < MAX_FDS; i++) {
+    int fd = fdsToWatch[i];
+    int slot;
+    if (fd == INVALID_FD || fdInList(fd, watchedFds)) {
+      continue;
+    }
+    debugPrint("Watching FD %d for data.", fd);
+    MEMSET(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0
+        && errno != EEXIST) {
+      fprintf(stderr, "FATAL: epoll_ctl() returned error for FD %d: %s\n",
+              fd, strerror(errno));
+      assert(FALSE);
+    }
+    slot = 0;
+    while (watchedFds[slot] != INVALID_FD) {
+      slot++;
+    }
+    watchedFds[slot] = fd;
+  }
+}
+
+static void setWakeupTimer(int32u timeoutMs)
+{
+  struct itimerspec timerSpec;
+  int32u deadline = halCommonGetInt32uMillisecondTick() + timeoutMs;
+
+  if (timeoutMs == NO_TIMEOUT) {
+    if (!timerArmed) {
+      return;
+    }
+    timerArmed = FALSE;
+    MEMSET(&timerSpec, 0, sizeof(timerSpec));   // disarms the timer
+  } else {
+    if (timerArmed && deadline == timerDeadline) {
+      return;
+    }
+    timerArmed = TRUE;
+    timerDeadline = deadline;
+    MEMSET(&timerSpec, 0, sizeof(timerSpec));
+    timerSpec.it_value.tv_sec = timeoutMs / 1000;
+    timerSpec.it_value.tv_nsec = (timeoutMs % 1000) * 1000000L;
+  }
+  if (timerfd_settime(timerFd, 0, &timerSpec, NULL) < 0) {
+    fprintf(stderr, "FATAL: timerfd_settime() returned error: %s\n",
+            strerror(errno));
+    assert(FALSE);
+  }
+}
+
+static void dispatchReadyFd(int fd)
+{
+  int8u expirations[8];
+
+  if (fd == timerFd) {
+    (void)read(timerFd, expirations, sizeof(expirations));
+    timerArmed = FALSE;
+  } else if (fd == ashSerialGetFd()) {
+    ezspTick();
+  } else if (fd == emberSerialGetInputFd(0)
+             || fd == emberSerialGetInputFd(1)) {
+    // The CLI input is read by emberProcessCommandInput() as soon as
+    // this returns to the main loop.
+  } else {
+    emberAfPluginGatewayFileDescriptorReadyCallback(fd);
+  }
+}
+
+static void gatewayWaitForEventsWithTimeout(int32u timeoutMs)
+{
+  struct epoll_event events[MAX_FDS + 1];
+  int fdsWithData;
+  int i;
+
+  static boolean firstRun = TRUE;
+  if (firstRun) {
+    firstRun = FALSE;
+    debugPrint("gatewayWaitForEvents() first run, not waiting for data.");
+    return;
+  }
+
+  gatewayEpollInit();
+  updateWatchedFds();
+
+  if (timeoutMs == 0) {
+    fdsWithData = epoll_wait(epollFd, events, MAX_FDS + 1, 0);
+  } else {
+    setWakeupTimer(timeoutMs);
+    fdsWithData = epoll_wait(epollFd, events, MAX_FDS + 1, -1);
+  }
+  if (fdsWithData < 0) {
+    if (errno == EINTR) {
+      return;
+    }
+    fprintf(stderr, "FATAL: epoll_wait() returned error: %s\n",
+            strerror(errno));
+    assert(FALSE);
+  }
+
+  for (i = 0; i < fdsWithData; i++) {
+    if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+      debugPrint("FD %d hung up or failed.", events[i].data.fd);
+    }
+    dispatchReadyFd(events[i].data.fd);
+  }
+}
+
+#else // GATEWAY_USE_EPOLL
+
 // Rather than looping like a simple em250 application we can actually
 // do the proper thing here, which is wait for EZSP or CLI events to fire.
 // This is done via our good friend select().  As a warning, the select() call
@@ -186,10 +428,12 @@ static void gatewayWaitForEventsWithTimeout(int32u timeoutMs)
   }
 }
 
+#endif // GATEWAY_USE_EPOLL
+
 int32u emberAfCheckForSleepCallback(void)
 {
   int32u start = halCommonGetInt32uMillisecondTick();
-  gatewayWaitForEventsWithTimeout(emberAfMsToNextEvent(0xFFFFFFFFUL));
+  gatewayWaitForEventsWithTimeout(gatewayMsToNextWakeup());
   return elapsedTimeInt32u(start, halCommonGetInt32uMillisecondTick());
 }
 
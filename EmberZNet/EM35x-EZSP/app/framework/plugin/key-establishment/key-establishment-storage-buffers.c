@@ -15,14 +15,19 @@
 // this file contains all the common includes for clusters in the zcl-util
 #include "../../util/common.h"
 
+#include "key-establishment.h"
 #include "key-establishment-storage.h"
 #include "stack/include/cbke-crypto-engine.h"
 
 //------------------------------------------------------------------------------
 // Globals
 
-static EmberMessageBuffer certAndPublicKeyBuffer = EMBER_NULL_MESSAGE_BUFFER;
-static EmberMessageBuffer smacBuffer = EMBER_NULL_MESSAGE_BUFFER;
+// These are set to EMBER_NULL_MESSAGE_BUFFER by the first call to
+// clearAllTemporaryPublicData(), which the plugin makes for every session
+// when it is initialized.
+static boolean buffersInitialized = FALSE;
+static EmberMessageBuffer certAndPublicKeyBuffers[EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS];
+static EmberMessageBuffer smacBuffers[EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS];
 
 #define CERTIFICATE_OFFSET 0
 #define PUBLIC_KEY_OFFSET  EMBER_CERTIFICATE_SIZE
@@ -34,93 +39,107 @@ static void releaseAndNullBuffer(EmberMessageBuffer* buffer);
 
 //------------------------------------------------------------------------------
 
-boolean storePublicPartnerData(boolean isCertificate,
+boolean storePublicPartnerData(int8u session,
+                               boolean isCertificate,
                                int8u* data)
 {
+  EmberMessageBuffer *certAndPublicKeyBuffer = &certAndPublicKeyBuffers[session];
+
   // The expectation is that the certificate must be stored first
   // and the public key is stored second.  The first time this is called
   // the buffer should be null while second time around it should not be.
   if (isCertificate
-      ? certAndPublicKeyBuffer != EMBER_NULL_MESSAGE_BUFFER 
-      : certAndPublicKeyBuffer == EMBER_NULL_MESSAGE_BUFFER) {
+      ? *certAndPublicKeyBuffer != EMBER_NULL_MESSAGE_BUFFER 
+      : *certAndPublicKeyBuffer == EMBER_NULL_MESSAGE_BUFFER) {
     return FALSE;
   }
   if (isCertificate) {
-    certAndPublicKeyBuffer = emberFillLinkedBuffers(data,
-                                                    EMBER_CERTIFICATE_SIZE);
-    if ( certAndPublicKeyBuffer == EMBER_NULL_MESSAGE_BUFFER ) {
+    *certAndPublicKeyBuffer = emberFillLinkedBuffers(data,
+                                                     EMBER_CERTIFICATE_SIZE);
+    if ( *certAndPublicKeyBuffer == EMBER_NULL_MESSAGE_BUFFER ) {
       return FALSE;
     }
   } else {
     if (EMBER_SUCCESS
-        != emberAppendToLinkedBuffers(certAndPublicKeyBuffer,
+        != emberAppendToLinkedBuffers(*certAndPublicKeyBuffer,
                                       data,
                                       EMBER_PUBLIC_KEY_SIZE)) {
-      releaseAndNullBuffer(&certAndPublicKeyBuffer);
+      releaseAndNullBuffer(certAndPublicKeyBuffer);
       return FALSE;
     }
   }
   return TRUE;
 }
 
-boolean retrieveAndClearPublicPartnerData(EmberCertificateData* partnerCertificate, 
+boolean retrieveAndClearPublicPartnerData(int8u session,
+                                          EmberCertificateData* partnerCertificate, 
                                           EmberPublicKeyData* partnerEphemeralPublicKey)
 {
-  int8u length = emberMessageBufferLength(certAndPublicKeyBuffer);
-  if ( certAndPublicKeyBuffer == EMBER_NULL_MESSAGE_BUFFER ) {
+  EmberMessageBuffer *certAndPublicKeyBuffer = &certAndPublicKeyBuffers[session];
+  int8u length;
+  if ( *certAndPublicKeyBuffer == EMBER_NULL_MESSAGE_BUFFER ) {
     return FALSE;
   }
 
+  length = emberMessageBufferLength(*certAndPublicKeyBuffer);
   if ((EMBER_CERTIFICATE_SIZE + EMBER_PUBLIC_KEY_SIZE) > length) {
     return FALSE;
   }
-  emberCopyFromLinkedBuffers(certAndPublicKeyBuffer,
+  emberCopyFromLinkedBuffers(*certAndPublicKeyBuffer,
                              CERTIFICATE_OFFSET,
                              emberCertificateContents(partnerCertificate),
                              EMBER_CERTIFICATE_SIZE);
   
-  emberCopyFromLinkedBuffers(certAndPublicKeyBuffer,
+  emberCopyFromLinkedBuffers(*certAndPublicKeyBuffer,
                              PUBLIC_KEY_OFFSET,
                              emberPublicKeyContents(partnerEphemeralPublicKey),
                              EMBER_PUBLIC_KEY_SIZE);
 
-  releaseAndNullBuffer(&certAndPublicKeyBuffer);
+  releaseAndNullBuffer(certAndPublicKeyBuffer);
   return TRUE;
 }
 
-boolean storeSmac(EmberSmacData* smac)
+boolean storeSmac(int8u session, EmberSmacData* smac)
 {
-  if ( smacBuffer != EMBER_NULL_MESSAGE_BUFFER ) {
-    emberReleaseMessageBuffer(smacBuffer);
+  EmberMessageBuffer *smacBuffer = &smacBuffers[session];
+  if ( *smacBuffer != EMBER_NULL_MESSAGE_BUFFER ) {
+    emberReleaseMessageBuffer(*smacBuffer);
   }
   emberAfKeyEstablishmentClusterPrintln("Storing SMAC");
   emberAfPrintZigbeeKey(emberKeyContents(smac));
-  smacBuffer = emberFillLinkedBuffers(emberSmacContents(smac),
-                                      EMBER_SMAC_SIZE);
-  if ( smacBuffer == EMBER_NULL_MESSAGE_BUFFER ) {
+  *smacBuffer = emberFillLinkedBuffers(emberSmacContents(smac),
+                                       EMBER_SMAC_SIZE);
+  if ( *smacBuffer == EMBER_NULL_MESSAGE_BUFFER ) {
     return FALSE;
   }
   return TRUE;
 }
 
-boolean getSmacPointer(EmberSmacData** smacPtr)
+boolean getSmacPointer(int8u session, EmberSmacData** smacPtr)
 {
-  if ( smacBuffer == EMBER_NULL_MESSAGE_BUFFER ) {
+  if ( smacBuffers[session] == EMBER_NULL_MESSAGE_BUFFER ) {
     return FALSE;
   }
-  *smacPtr = (EmberSmacData*)emberMessageBufferContents(smacBuffer);
+  *smacPtr = (EmberSmacData*)emberMessageBufferContents(smacBuffers[session]);
   return TRUE;
 }
 
-void clearAllTemporaryPublicData(void)
+void clearAllTemporaryPublicData(int8u session)
 {
-  EmberMessageBuffer* buffer = &certAndPublicKeyBuffer;
+  EmberMessageBuffer* buffer = &certAndPublicKeyBuffers[session];
   int8u i;
+  if (!buffersInitialized) {
+    for (i = 0; i < EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS; i++) {
+      certAndPublicKeyBuffers[i] = EMBER_NULL_MESSAGE_BUFFER;
+      smacBuffers[i] = EMBER_NULL_MESSAGE_BUFFER;
+    }
+    buffersInitialized = TRUE;
+  }
   for ( i = 0; i < 2; i++ ) {
     if ( *buffer != EMBER_NULL_MESSAGE_BUFFER ) { 
       releaseAndNullBuffer(buffer);
     }
-    buffer = &smacBuffer;
+    buffer = &smacBuffers[session];
   }
 }
 
@@ -16,6 +16,7 @@
 // this file contains all the common includes for clusters in the zcl-util
 #include "../../util/common.h"
 
+#include "key-establishment.h"
 #include "key-establishment-storage.h"
 
 #ifndef EZSP_HOST
@@ -25,18 +26,19 @@
 //------------------------------------------------------------------------------
 // Globals
 
-static EmberCertificateData partnerCert;
-static EmberPublicKeyData partnerPublicKey;
-static EmberSmacData storedSmac;
+static EmberCertificateData partnerCerts[EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS];
+static EmberPublicKeyData partnerPublicKeys[EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS];
+static EmberSmacData storedSmacs[EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS];
 
 //------------------------------------------------------------------------------
 
-boolean storePublicPartnerData(boolean isCertificate,
+boolean storePublicPartnerData(int8u session,
+                               boolean isCertificate,
                                int8u* data)
 {
   int8u* ptr = (isCertificate
-                ? emberCertificateContents(&partnerCert)
-                : emberPublicKeyContents(&partnerPublicKey));
+                ? emberCertificateContents(&partnerCerts[session])
+                : emberPublicKeyContents(&partnerPublicKeys[session]));
   int8u size = (isCertificate 
                 ? EMBER_CERTIFICATE_SIZE
                 : EMBER_PUBLIC_KEY_SIZE);
@@ -44,38 +46,39 @@ boolean storePublicPartnerData(boolean isCertificate,
   return TRUE;
 }
 
-boolean retrieveAndClearPublicPartnerData(EmberCertificateData* partnerCertificate,
+boolean retrieveAndClearPublicPartnerData(int8u session,
+                                          EmberCertificateData* partnerCertificate,
                                           EmberPublicKeyData* partnerEphemeralPublicKey)
 {
   if ( partnerCertificate != NULL ) {
     MEMCOPY(partnerCertificate,
-            &partnerCert,
+            &partnerCerts[session],
             EMBER_CERTIFICATE_SIZE);
   }
   if ( partnerEphemeralPublicKey != NULL ) {
     MEMCOPY(partnerEphemeralPublicKey,
-            &partnerPublicKey,
+            &partnerPublicKeys[session],
             EMBER_PUBLIC_KEY_SIZE);
   }
-  MEMSET(&partnerCert, 0, EMBER_CERTIFICATE_SIZE);
-  MEMSET(&partnerPublicKey, 0, EMBER_PUBLIC_KEY_SIZE);
+  MEMSET(&partnerCerts[session], 0, EMBER_CERTIFICATE_SIZE);
+  MEMSET(&partnerPublicKeys[session], 0, EMBER_PUBLIC_KEY_SIZE);
   return TRUE;
 }
 
-boolean storeSmac(EmberSmacData* smac)
+boolean storeSmac(int8u session, EmberSmacData* smac)
 {
-  MEMCOPY(&storedSmac, smac, EMBER_SMAC_SIZE);
+  MEMCOPY(&storedSmacs[session], smac, EMBER_SMAC_SIZE);
   return TRUE;
 }
 
-boolean getSmacPointer(EmberSmacData** smacPtr)
+boolean getSmacPointer(int8u session, EmberSmacData** smacPtr)
 {
-  *smacPtr = &storedSmac;
+  *smacPtr = &storedSmacs[session];
   return TRUE;
 }
 
-void clearAllTemporaryPublicData(void)
+void clearAllTemporaryPublicData(int8u session)
 {
-  MEMSET(&storedSmac, 0, EMBER_SMAC_SIZE);
-  retrieveAndClearPublicPartnerData(NULL, NULL);
+  MEMSET(&storedSmacs[session], 0, EMBER_SMAC_SIZE);
+  retrieveAndClearPublicPartnerData(session, NULL, NULL);
 }
@@ -6,16 +6,21 @@
 // * - Partner Ephemeral Public Key
 // * - A single SMAC
 // *
+// * Each key establishment in progress has its own copy of this data,
+// * picked by its session index.
+// *
 // * Copyright 2008 by Ember Corporation. All rights reserved.              *80*
 // *******************************************************************
 
 // If isCertificate is FALSE, data is a public key.
-boolean storePublicPartnerData(boolean isCertificate,
+boolean storePublicPartnerData(int8u session,
+                               boolean isCertificate,
                                int8u* data);
-boolean retrieveAndClearPublicPartnerData(EmberCertificateData* partnerCertificate, 
+boolean retrieveAndClearPublicPartnerData(int8u session,
+                                          EmberCertificateData* partnerCertificate, 
                                           EmberPublicKeyData* partnerEphemeralPublicKey);
 
-boolean storeSmac(EmberSmacData* smac);
-boolean getSmacPointer(EmberSmacData** smacPtr);
+boolean storeSmac(int8u session, EmberSmacData* smac);
+boolean getSmacPointer(int8u session, EmberSmacData** smacPtr);
 
-void clearAllTemporaryPublicData(void);
+void clearAllTemporaryPublicData(int8u session);
@@ -39,9 +39,6 @@ typedef int8u KeyEstablishMessage;
 
 #define LAST_KEY_ESTABLISH_EVENT INITIATOR_RECEIVED_CONFIRM_KEY
 
-// These are initialized by the init routine.
-static KeyEstablishEvent lastEvent;
-
 typedef struct {
   EmberEUI64 eui64;
   EmberPanId panId;
@@ -64,7 +61,47 @@ typedef struct {
   int8u sequenceNumber;
 } KeyEstablishmentPartner;
 
-static KeyEstablishmentPartner partner;
+// We record the sequence numbers of our partner device's messages so
+// we can filter out dupes.  3 messages can be received during normal
+// KE, plus 1 for a possible Terminate message.
+#define NUM_SEQ_NUMBER 4
+
+// One key establishment with one partner.  A session that is not in use
+// keeps its last partner so that retried messages from that partner are
+// still recognized as duplicates.
+typedef struct {
+  KeyEstablishmentPartner partner;
+  KeyEstablishEvent lastEvent;
+  int8u endpoint;
+  int8u apsSequenceNumbersReceived;
+  int8u apsSequenceNumbers[NUM_SEQ_NUMBER];
+  // This relates the KeyEstablishEvent enum to the timeouts for each event.
+  // We will setup the values when we receive the first message.
+  // Values in seconds.  The timeout values passed in the protocol are 8-bit
+  // but that means when we add our fudge factor it can overflow beyond
+  // 255.  So we make these 16-bit values to prevent problems.
+  int16u eventTimeoutsSec[LAST_KEY_ESTABLISH_EVENT];
+  // The millisecond tick at which lastEvent times out.
+  int32u timeoutMs;
+} KeyEstablishmentSession;
+
+#define MAX_SESSIONS EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS
+
+// These are initialized by the init routine.
+static KeyEstablishmentSession sessions[MAX_SESSIONS];
+
+// The session being worked on.  Everything below acts on this session.
+static KeyEstablishmentSession *session = &sessions[0];
+
+#define sessionIndex() ((int8u)(session - sessions))
+
+// The CBKE library keeps the ephemeral keys, and later the new link key, for
+// one key establishment at a time, from generating the keys to storing or
+// clearing the link key.  That session owns the CBKE library; any others
+// that are ready to generate keys wait in order in cryptoQueue.
+static KeyEstablishmentSession *cryptoSession = NULL;
+static KeyEstablishmentSession *cryptoQueue[MAX_SESSIONS];
+static int8u cryptoQueueLength = 0;
 
 #define KEY_ESTABLISHMENT_TIMEOUT_BASE_SECONDS 10
 
@@ -154,24 +191,10 @@ static const EmberAfAmiKeyEstablishmentStatus appNotifyMessageToKeyEstablishStat
   (sendNextKeyEstablishMessage(ZCL_CONFIRM_KEY_DATA_REQUEST_COMMAND_ID, \
                                (smac)))
 
-// This relates the KeyEstablishEvent enum to the timeouts for each event.
-// We will setup the values when we receive the first message.
-// Values in seconds.  The timeout values passed in the protocol are 8-bit
-// but that means when we add our fudge factor it can overflow beyond
-// 255.  So we make these 16-bit values to prevent problems.
-static int16u eventTimeoutsSec[LAST_KEY_ESTABLISH_EVENT];
-
 // This is the last endpoint that was initialized for key establishment
 // it is the one we use for all our event scheduling
 static int8u keyEstablishmentEndpoint = 0xFF;
 
-// We record the sequence numbers of our partner device's messages so
-// we can filter out dupes.  3 messages can be received during normal
-// KE, plus 1 for a possible Terminate message.
-#define NUM_SEQ_NUMBER 4
-static int8u apsSequenceNumbersReceived = 0;
-static int8u apsSequenceNumbers[NUM_SEQ_NUMBER];
-
 // The offset within the certificate struct where the issuer field
 // lives.  22-bytes for Public Key Reconstruction data, and 8-bytes for subject.
 #define CERT_SUBJECT_OFFSET 22
@@ -218,8 +241,16 @@ static void messageSentHandler(EmberOutgoingMessageType type,
                                int16u msgLen,
                                int8u *message,
                                EmberStatus status);
-static boolean commandIsFromOurPartner(const EmberAfClusterCommand *cmd);
+static boolean commandIsFromPartner(const KeyEstablishmentPartner *partner,
+                                    const EmberAfClusterCommand *cmd);
 static boolean setPartnerFromCommand(const EmberAfClusterCommand *cmd);
+static KeyEstablishmentSession *findSessionForCommand(const EmberAfClusterCommand *cmd,
+                                                      boolean inProgressOnly);
+static KeyEstablishmentSession *findIdleSession(void);
+static boolean generateKeys(void);
+static void startQueuedKeyGeneration(void);
+static void releaseCrypto(void);
+static void scheduleTimeoutTick(void);
 #if defined(EMBER_AF_PRINT_ENABLE) && defined(EMBER_AF_PRINT_KEY_ESTABLISHMENT_CLUSTER)
   static void debugPrintSmac(boolean initiatorSmac, int8u *smac);
   static void debugPrintOtherSmac(boolean received, int8u *smac);
@@ -328,8 +359,10 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
   }
 
   if (cmd != NULL) {
-    if (commandIsFromOurPartner(cmd)
-        && (partner.isInitiator || lastEvent != NO_KEY_ESTABLISHMENT_EVENT)) {
+    KeyEstablishmentSession *match = findSessionForCommand(cmd, FALSE);
+    if (match != NULL
+        && (match->partner.isInitiator
+            || match->lastEvent != NO_KEY_ESTABLISHMENT_EVENT)) {
       // Filter out duplicate APS messages.
 
       // Edge Case: If the same partner initiates key establishment with us and
@@ -337,32 +370,42 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
       // time, this will fail since we assume it is a duplicate message.  The
       // hope is that the partner will retry and it should succeed.
       int8u i;
-      for (i = 0; i < apsSequenceNumbersReceived; i++) {
-        if (cmd->apsFrame->sequence == apsSequenceNumbers[i]) {
+      session = match;
+      for (i = 0; i < session->apsSequenceNumbersReceived; i++) {
+        if (cmd->apsFrame->sequence == session->apsSequenceNumbers[i]) {
           emberAfKeyEstablishmentClusterPrintln("Got duplicate APS message (seq:%d), dropping!",
                                                 cmd->apsFrame->sequence);
           return;
         }
       }
-    } else if (!initSuccess || lastEvent != NO_KEY_ESTABLISHMENT_EVENT) {
-      // If we have not successfully initialized or we are already in doing
-      // key establishment with another partner, tell this new partner to go
-      // away and maybe try again later.  The sendTerminateMessage function
-      // assumes it is sending to the current partner, so we have to temporarily
-      // switch to the new partner, send the terminate, and then switch back to
-      // our real partner.
-      KeyEstablishmentPartner tmpPartner;
-      MEMCOPY(&tmpPartner, &partner, sizeof(KeyEstablishmentPartner));
-      emberAfKeyEstablishmentClusterPrintln(initSuccess
-                                            ? "Second Key estabishment not supported, terminating it."
-                                            : "Key Est. FAILED INITIALIZATION, terminating");
-      if (setPartnerFromCommand(cmd)) {
-        partner.sequenceNumber = cmd->seqNum;
-        sendTerminateMessage(EMBER_ZCL_AMI_KEY_ESTABLISHMENT_STATUS_NO_RESOURCES,
-                             BACK_OFF_TIME_REPORTED_TO_PARTNER);
+    } else {
+      // A session that last did key establishment with this partner is
+      // reused, so that it keeps filtering duplicates; otherwise any idle
+      // session will do.
+      if (match == NULL) {
+        match = findIdleSession();
       }
-      MEMCOPY(&partner, &tmpPartner, sizeof(KeyEstablishmentPartner));
-      return;
+      if (!initSuccess || match == NULL) {
+        // If we have not successfully initialized or we are already doing
+        // as many key establishments as we can, tell this new partner to go
+        // away and maybe try again later.  The sendTerminateMessage function
+        // sends to the partner of the current session, so we use a
+        // temporary session for the new partner.
+        KeyEstablishmentSession tmpSession;
+        KeyEstablishmentSession *realSession = session;
+        emberAfKeyEstablishmentClusterPrintln(initSuccess
+                                              ? "No free key establishment session, terminating it."
+                                              : "Key Est. FAILED INITIALIZATION, terminating");
+        session = &tmpSession;
+        if (setPartnerFromCommand(cmd)) {
+          session->partner.sequenceNumber = cmd->seqNum;
+          sendTerminateMessage(EMBER_ZCL_AMI_KEY_ESTABLISHMENT_STATUS_NO_RESOURCES,
+                               BACK_OFF_TIME_REPORTED_TO_PARTNER);
+        }
+        session = realSession;
+        return;
+      }
+      session = match;
     }
 
     // If we got here and we're not currently doing key establishment, it means
@@ -370,37 +413,38 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
     // partner and clear the previous set of sequence numbers.  We must handle
     // the case where the same partner is initiating key establishment with us
     // that did it last time.  We can't use the above else clause to do that.
-    if (lastEvent == NO_KEY_ESTABLISHMENT_EVENT) {
+    if (session->lastEvent == NO_KEY_ESTABLISHMENT_EVENT) {
       if (!setPartnerFromCommand(cmd)) {
         return;
       }
-      apsSequenceNumbersReceived = 0;
+      session->apsSequenceNumbersReceived = 0;
     }
 
     // Remember the received APS sequence numbers so we can filter duplicates.
-    if (partner.isIntraPan) {
-      apsSequenceNumbers[apsSequenceNumbersReceived] = cmd->apsFrame->sequence;
-      apsSequenceNumbersReceived++;
+    if (session->partner.isIntraPan
+        && session->apsSequenceNumbersReceived < NUM_SEQ_NUMBER) {
+      session->apsSequenceNumbers[session->apsSequenceNumbersReceived] = cmd->apsFrame->sequence;
+      session->apsSequenceNumbersReceived++;
     }
 
     // Remember the received ZCL sequence number for the response.
-    if (partner.isInitiator) {
-      partner.sequenceNumber = cmd->seqNum;
+    if (session->partner.isInitiator) {
+      session->partner.sequenceNumber = cmd->seqNum;
     }
   }
 
   // If we receive an unexpected message, we terminate and hope the partner
   // tries again.
-  if (newEvent != lastEvent + 1) {
+  if (newEvent != session->lastEvent + 1) {
     emberAfKeyEstablishmentClusterPrintln("Got wrong message in the sequence.");
     cleanupAndStop(INVALID_PARTNER_MESSAGE);
     return;
   }
 
   // Key establishment can only takes place with the trust center.
-  if (partner.isIntraPan
+  if (session->partner.isIntraPan
       && emberAfGetNodeId() != EMBER_TRUST_CENTER_NODE_ID
-      && partner.pan.intraPan.nodeId != EMBER_TRUST_CENTER_NODE_ID) {
+      && session->partner.pan.intraPan.nodeId != EMBER_TRUST_CENTER_NODE_ID) {
     cleanupAndStop(NO_ESTABLISHMENT_ALLOWED);
     return;
   }
@@ -420,7 +464,7 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
   case BEGIN_KEY_ESTABLISHMENT:
     {
       EmberAfKeyEstablishmentNotifyMessage result = NO_APP_MESSAGE;
-      if (partner.isInitiator) {
+      if (session->partner.isInitiator) {
         if (!checkRequestedSuite(data1)
             || !checkIssuer(data2 + CERT_ISSUER_OFFSET)
             || !checkKeyTable(data2 + CERT_SUBJECT_OFFSET)) {
@@ -432,7 +476,8 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
         debugPrintCert(TRUE, data2);
 
         if (!askApplication(RECEIVED_PARTNER_CERTIFICATE)
-            || !storePublicPartnerData(TRUE, // certificate?
+            || !storePublicPartnerData(sessionIndex(),
+                                       TRUE, // certificate?
                                        data2)) {
           result = NO_LOCAL_RESOURCES;
         } else {
@@ -453,7 +498,7 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
   // For initiator, we received responder cert it is time to generate keys.
   // For responder, we received ephemeral data it is time to generate keys.
   case GENERATE_KEYS:
-    if (!partner.isInitiator) {
+    if (!session->partner.isInitiator) {
       if (!checkRequestedSuite(data1)
           || !checkIssuer(data2 + CERT_ISSUER_OFFSET)
           || !checkKeyTable(data2 + CERT_SUBJECT_OFFSET)) {
@@ -470,15 +515,15 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
     }
 
     if (!askApplication(GENERATING_EPHEMERAL_KEYS)
-        || !storePublicPartnerData(!partner.isInitiator, // certificate?
-                                   (!partner.isInitiator
+        || !storePublicPartnerData(sessionIndex(),
+                                   !session->partner.isInitiator, // certificate?
+                                   (!session->partner.isInitiator
                                     ? data2              // partner cert
                                     : data1))            // partner key
-        || emberGenerateCbkeKeys() != EMBER_OPERATION_IN_PROGRESS) {
+        || !generateKeys()) {
       cleanupAndStop(NO_LOCAL_RESOURCES);
       return;
     }
-    emAfSetCryptoOperationInProgress();
     break;
 
   // For both roles, we are done generating keys.  Send the message.
@@ -498,7 +543,7 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
       EmberPublicKeyData partnerEphemeralPublicKey;
 
 #if defined(EMBER_AF_PRINT_ENABLE) && defined(EMBER_AF_PRINT_KEY_ESTABLISHMENT_CLUSTER)
-      if (!partner.isInitiator) {
+      if (!session->partner.isInitiator) {
         debugPrintKey(FALSE, data1);
       } else {
         debugPrintOtherSmac(TRUE, data1);
@@ -509,13 +554,15 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
       // the public key but then immediately retrieve it.  However it
       // saves on flash to treat responder and initiator the same.
       if (!askApplication(GENERATING_SHARED_SECRET)
-          || (!partner.isInitiator
-              ? !storePublicPartnerData(FALSE, data1)
-              : !storeSmac((EmberSmacData *)data1))
-          || !retrieveAndClearPublicPartnerData(&partnerCert,
+          || session != cryptoSession
+          || (!session->partner.isInitiator
+              ? !storePublicPartnerData(sessionIndex(), FALSE, data1)
+              : !storeSmac(sessionIndex(), (EmberSmacData *)data1))
+          || !retrieveAndClearPublicPartnerData(sessionIndex(),
+                                                &partnerCert,
                                                 &partnerEphemeralPublicKey)
           || (EMBER_OPERATION_IN_PROGRESS
-              != calculateSmacs(!partner.isInitiator,
+              != calculateSmacs(!session->partner.isInitiator,
                                 &partnerCert,
                                 &partnerEphemeralPublicKey))) {
         cleanupAndStop(NO_LOCAL_RESOURCES);
@@ -536,12 +583,13 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
       debugPrintSmac(FALSE, emberSmacContents(responderSmac));
 
       if (!askApplication(GENERATE_SHARED_SECRET_DONE)
-          || (!partner.isInitiator && !storeSmac(responderSmac))) {
+          || (!session->partner.isInitiator
+              && !storeSmac(sessionIndex(), responderSmac))) {
         cleanupAndStop(NO_LOCAL_RESOURCES);
         return;
       }
 
-      if (partner.isInitiator) {
+      if (session->partner.isInitiator) {
         EmberAfKeyEstablishmentNotifyMessage result = verifySmac(initiatorSmac);
         if (result != NO_APP_MESSAGE) {
           cleanupAndStop(result);
@@ -549,11 +597,11 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
         }
       }
 
-      sendConfirmKey(emberSmacContents(!partner.isInitiator
+      sendConfirmKey(emberSmacContents(!session->partner.isInitiator
                                        ? initiatorSmac
                                        : responderSmac));
 
-      if (partner.isInitiator) {
+      if (session->partner.isInitiator) {
         // TODO:  Wait for the APS Ack from the initiator and then store
         // the link key.
 
@@ -582,29 +630,22 @@ static void keyEstablishStateMachine(KeyEstablishEvent newEvent,
     return;
   }
 
-  {
-    // We assume that the MILLISECOND_TICKS_PER_SECOND is 1024,
-    // and thus a bit-shift by 10 is done to avoid a 32-bit divide operation.
-    int32u timeMs = (int32u)(eventTimeoutsSec[newEvent]) << 10;
-    emberAfScheduleClusterTick(keyEstablishmentEndpoint,
-                               ZCL_KEY_ESTABLISHMENT_CLUSTER_ID,
-                               EMBER_AF_SERVER_CLUSTER_TICK,
-                               timeMs,
-                               EMBER_AF_OK_TO_NAP);
-  }
-  lastEvent = newEvent;
+  // We assume that the MILLISECOND_TICKS_PER_SECOND is 1024,
+  // and thus a bit-shift by 10 is done to avoid a 32-bit divide operation.
+  session->timeoutMs = (halCommonGetInt32uMillisecondTick()
+                        + ((int32u)(session->eventTimeoutsSec[newEvent]) << 10));
+  session->lastEvent = newEvent;
+  scheduleTimeoutTick();
   return;
 }
 
 static void clearKeyEstablishmentState(void)
 {
-  partner.isInitiator = TRUE;
-  lastEvent = NO_KEY_ESTABLISHMENT_EVENT;
-  clearAllTemporaryPublicData();
-  emberClearTemporaryDataMaybeStoreLinkKey(FALSE);
-  emberAfDeactivateClusterTick(keyEstablishmentEndpoint,
-                               ZCL_KEY_ESTABLISHMENT_CLUSTER_ID,
-                               EMBER_AF_SERVER_CLUSTER_TICK);
+  session->partner.isInitiator = TRUE;
+  session->lastEvent = NO_KEY_ESTABLISHMENT_EVENT;
+  clearAllTemporaryPublicData(sessionIndex());
+  releaseCrypto();
+  scheduleTimeoutTick();
 
   // NOTE: When clearing the state, we intentionally retain information about
   // the partner (e.g., node id, APS sequence numbers, etc.).  That information
@@ -613,12 +654,147 @@ static void clearKeyEstablishmentState(void)
   // have completed key establishment, we must remember the partner information.
 }
 
+// Generates the ephemeral keys for the current session, or queues it to do so
+// once the sessions ahead of it are done with the CBKE library.  The queued
+// session's timeout keeps running, so it is not left waiting longer than its
+// partner will wait.
+static boolean generateKeys(void)
+{
+  if (cryptoSession == NULL
+      && cryptoQueueLength == 0
+      && !emAfIsCryptoOperationInProgress()) {
+    cryptoSession = session;
+    if (emberGenerateCbkeKeys() != EMBER_OPERATION_IN_PROGRESS) {
+      return FALSE;
+    }
+    emAfSetCryptoOperationInProgress();
+  } else {
+    emberAfKeyEstablishmentClusterPrintln("Waiting for CBKE library (%d queued)",
+                                          cryptoQueueLength);
+    cryptoQueue[cryptoQueueLength] = session;
+    cryptoQueueLength++;
+  }
+  return TRUE;
+}
+
+// Passes the CBKE library to the next queued session.  This runs from the
+// cluster tick, which does not run while a crypto operation is in progress.
+static void startQueuedKeyGeneration(void)
+{
+  while (cryptoSession == NULL && cryptoQueueLength > 0) {
+    session = cryptoQueue[0];
+    cryptoQueueLength--;
+    MEMCOPY(cryptoQueue,
+            cryptoQueue + 1,
+            cryptoQueueLength * sizeof(cryptoQueue[0]));
+    cryptoSession = session;
+    if (emberGenerateCbkeKeys() == EMBER_OPERATION_IN_PROGRESS) {
+      emAfSetCryptoOperationInProgress();
+    } else {
+      cleanupAndStop(NO_LOCAL_RESOURCES);
+    }
+  }
+}
+
+// Gives up the current session's hold on the CBKE library, or its place in
+// the queue for it.
+static void releaseCrypto(void)
+{
+  int8u i;
+  if (session == cryptoSession) {
+    emberClearTemporaryDataMaybeStoreLinkKey(FALSE);
+    cryptoSession = NULL;
+  }
+  for (i = 0; i < cryptoQueueLength; i++) {
+    if (cryptoQueue[i] == session) {
+      cryptoQueueLength--;
+      MEMCOPY(cryptoQueue + i,
+              cryptoQueue + i + 1,
+              (cryptoQueueLength - i) * sizeof(cryptoQueue[0]));
+      break;
+    }
+  }
+}
+
+// Schedules the cluster tick for the first session timeout, or right away if
+// a queued session can have the CBKE library.
+static void scheduleTimeoutTick(void)
+{
+  int32u now = halCommonGetInt32uMillisecondTick();
+  int32u delayMs = MAX_INT32U_VALUE;
+  int8u i;
+
+  if (keyEstablishmentEndpoint == 0xFF) {
+    return;
+  }
+  if (cryptoSession == NULL && cryptoQueueLength > 0) {
+    delayMs = 0;
+  }
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    if (sessions[i].lastEvent != NO_KEY_ESTABLISHMENT_EVENT) {
+      int32u remainingMs = (timeGTorEqualInt32u(now, sessions[i].timeoutMs)
+                            ? 0
+                            : elapsedTimeInt32u(now, sessions[i].timeoutMs));
+      if (remainingMs < delayMs) {
+        delayMs = remainingMs;
+      }
+    }
+  }
+  if (delayMs == MAX_INT32U_VALUE) {
+    emberAfDeactivateClusterTick(keyEstablishmentEndpoint,
+                                 ZCL_KEY_ESTABLISHMENT_CLUSTER_ID,
+                                 EMBER_AF_SERVER_CLUSTER_TICK);
+  } else {
+    emberAfScheduleClusterTick(keyEstablishmentEndpoint,
+                               ZCL_KEY_ESTABLISHMENT_CLUSTER_ID,
+                               EMBER_AF_SERVER_CLUSTER_TICK,
+                               delayMs,
+                               EMBER_AF_OK_TO_NAP);
+  }
+}
+
+// Returns the session doing key establishment with the sender of the
+// command.  Unless inProgressOnly is set, an idle session whose last partner
+// was the sender is returned if no session is in progress with it.
+static KeyEstablishmentSession *findSessionForCommand(const EmberAfClusterCommand *cmd,
+                                                      boolean inProgressOnly)
+{
+  KeyEstablishmentSession *idleMatch = NULL;
+  int8u i;
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    if (commandIsFromPartner(&sessions[i].partner, cmd)) {
+      if (sessions[i].lastEvent != NO_KEY_ESTABLISHMENT_EVENT) {
+        return &sessions[i];
+      } else if (idleMatch == NULL) {
+        idleMatch = &sessions[i];
+      }
+    }
+  }
+  return (inProgressOnly ? NULL : idleMatch);
+}
+
+static KeyEstablishmentSession *findIdleSession(void)
+{
+  int8u i;
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    if (sessions[i].lastEvent == NO_KEY_ESTABLISHMENT_EVENT) {
+      return &sessions[i];
+    }
+  }
+  return NULL;
+}
+
 static void cleanupAndStopWithDelay(EmberAfKeyEstablishmentNotifyMessage message,
                                     int8u delayInSec)
 {
   EmberAfAmiKeyEstablishmentStatus status;
   boolean linkKeyEstablished = (message == LINK_KEY_ESTABLISHED);
-  EmberStatus storeLinkKeyStatus = emberClearTemporaryDataMaybeStoreLinkKey(linkKeyEstablished);
+  // Only the session that owns the CBKE library has a link key to store.
+  EmberStatus storeLinkKeyStatus = (session == cryptoSession
+                                    ? emberClearTemporaryDataMaybeStoreLinkKey(linkKeyEstablished)
+                                    : (linkKeyEstablished
+                                       ? EMBER_INVALID_CALL
+                                       : EMBER_SUCCESS));
   
   if (delayInSec == 0) {
     delayInSec = INTERNAL_ERROR_BACK_OFF_TIME;
@@ -639,11 +815,11 @@ static void cleanupAndStopWithDelay(EmberAfKeyEstablishmentNotifyMessage message
   // prematurely, or it succeeded.
   askApplicationWithDelay(message, delayInSec);
 
-  if (!partner.isInitiator && linkKeyEstablished) {
+  if (!session->partner.isInitiator && linkKeyEstablished) {
     emberAfSendImmediateDefaultResponse(EMBER_ZCL_STATUS_SUCCESS);
   } else if (status != EMBER_ZCL_AMI_KEY_ESTABLISHMENT_STATUS_SUCCESS
              && message != PARTNER_SENT_DEFAULT_RESPONSE_ERROR
-             && (partner.isInitiator || lastEvent != NO_KEY_ESTABLISHMENT_EVENT)) {
+             && (session->partner.isInitiator || session->lastEvent != NO_KEY_ESTABLISHMENT_EVENT)) {
     // No point in sending a terminate when this is the first step and we are
     // the initiator.
     sendTerminateMessage(status, BACK_OFF_TIME_REPORTED_TO_PARTNER);
@@ -664,7 +840,7 @@ static boolean askApplicationWithDelay(EmberAfKeyEstablishmentNotifyMessage mess
 
   emberAfKeyEstablishmentClusterFlush();
   emberAfKeyEstablishmentClusterPrint("%p: %p %p: %p (%d), %p ",
-                                      (!partner.isInitiator
+                                      (!session->partner.isInitiator
                                        ? "Initiator"
                                        : "Responder"),
                                       "Key Establish",
@@ -676,19 +852,19 @@ static boolean askApplicationWithDelay(EmberAfKeyEstablishmentNotifyMessage mess
                                       appNotifyText[message],
                                       message,
                                       "partner");
-  if (partner.isIntraPan) {
-    emberAfKeyEstablishmentClusterPrintln("0x%2x", partner.pan.intraPan.nodeId);
+  if (session->partner.isIntraPan) {
+    emberAfKeyEstablishmentClusterPrintln("0x%2x", session->partner.pan.intraPan.nodeId);
     return emberAfKeyEstablishmentCallback(message,
-                                           !partner.isInitiator,
-                                           partner.pan.intraPan.nodeId,
+                                           !session->partner.isInitiator,
+                                           session->partner.pan.intraPan.nodeId,
                                            delayInSec);
   } else {
-    emberAfKeyEstablishmentClusterDebugExec(emberAfPrintBigEndianEui64(partner.pan.interPan.eui64));
+    emberAfKeyEstablishmentClusterDebugExec(emberAfPrintBigEndianEui64(session->partner.pan.interPan.eui64));
     emberAfKeyEstablishmentClusterPrintln("");
     return emberAfInterPanKeyEstablishmentCallback(message,
-                                                   !partner.isInitiator,
-                                                   partner.pan.interPan.panId,
-                                                   partner.pan.interPan.eui64,
+                                                   !session->partner.isInitiator,
+                                                   session->partner.pan.interPan.panId,
+                                                   session->partner.pan.interPan.eui64,
                                                    delayInSec);
   }
 }
@@ -700,30 +876,30 @@ static void sendKeyEstablishMessage(KeyEstablishMessage message)
   // including the message overhead that will be filled in by this function.
   int8u *ptr = appResponseData;
   *ptr++ = (ZCL_CLUSTER_SPECIFIC_COMMAND
-            | (!partner.isInitiator
+            | (!session->partner.isInitiator
                ? ZCL_FRAME_CONTROL_CLIENT_TO_SERVER
                : ZCL_FRAME_CONTROL_SERVER_TO_CLIENT));
-  *ptr++ = partner.sequenceNumber;
+  *ptr++ = session->partner.sequenceNumber;
   *ptr   = message;
 
   if (!emAfKeyEstablishmentTestHarnessMessageSendCallback(message)) {
     return;
   }
 
-  if (partner.isIntraPan) {
+  if (session->partner.isIntraPan) {
     EmberApsFrame apsFrame;
     apsFrame.clusterId = ZCL_KEY_ESTABLISHMENT_CLUSTER_ID;
-    apsFrame.sourceEndpoint = keyEstablishmentEndpoint;
-    apsFrame.destinationEndpoint = partner.pan.intraPan.endpoint;
+    apsFrame.sourceEndpoint = session->endpoint;
+    apsFrame.destinationEndpoint = session->partner.pan.intraPan.endpoint;
     apsFrame.options = (EMBER_AF_DEFAULT_APS_OPTIONS | EMBER_APS_OPTION_RETRY);
     emberAfSendUnicast(EMBER_OUTGOING_DIRECT,
-                       partner.pan.intraPan.nodeId,
+                       session->partner.pan.intraPan.nodeId,
                        &apsFrame,
                        appResponseLength,
                        appResponseData);
   } else {
-    emberAfSendInterPan(partner.pan.interPan.panId,
-                        partner.pan.interPan.eui64,
+    emberAfSendInterPan(session->partner.pan.interPan.panId,
+                        session->partner.pan.interPan.eui64,
                         EMBER_NULL_NODE_ID,
                         0, // multicast id - unused
                         ZCL_KEY_ESTABLISHMENT_CLUSTER_ID,
@@ -793,7 +969,7 @@ static EmberAfKeyEstablishmentNotifyMessage verifySmac(EmberSmacData *otherSmac)
   // For the responder, the stored SMAC will be the initiator's version
   //   received via the Confirm Key request message.
   EmberSmacData *ptr;
-  if (!getSmacPointer(&ptr)) {
+  if (!getSmacPointer(sessionIndex(), &ptr)) {
     return NO_LOCAL_RESOURCES;
   }
 
@@ -847,23 +1023,23 @@ static void setupEventTimeouts(int8u theirGenerateKeyTimeSeconds,
                                int8u theirConfirmKeyTimeSeconds)
 {
   int8u i;
-  eventTimeoutsSec[0] = 0;  // NO_KEY_ESTABLISHMENT_EVENT
+  session->eventTimeoutsSec[0] = 0;  // NO_KEY_ESTABLISHMENT_EVENT
 
   for (i = 1; i < LAST_KEY_ESTABLISH_EVENT; i++) {
-    eventTimeoutsSec[i] = KEY_ESTABLISHMENT_TIMEOUT_BASE_SECONDS;
+    session->eventTimeoutsSec[i] = KEY_ESTABLISHMENT_TIMEOUT_BASE_SECONDS;
   }
-  eventTimeoutsSec[BEGIN_KEY_ESTABLISHMENT]     += (!partner.isInitiator
+  session->eventTimeoutsSec[BEGIN_KEY_ESTABLISHMENT]     += (!session->partner.isInitiator
                                                     ? 0
                                                     : theirGenerateKeyTimeSeconds);
-  eventTimeoutsSec[GENERATE_KEYS]               += EPHEMERAL_DATA_GENERATE_TIME_SECONDS;
-  eventTimeoutsSec[GENERATE_SHARED_SECRET]      += GENERATE_SHARED_SECRET_TIME_SECONDS;
-  eventTimeoutsSec[SEND_EPHEMERAL_DATA_MESSAGE] += (!partner.isInitiator
+  session->eventTimeoutsSec[GENERATE_KEYS]               += EPHEMERAL_DATA_GENERATE_TIME_SECONDS;
+  session->eventTimeoutsSec[GENERATE_SHARED_SECRET]      += GENERATE_SHARED_SECRET_TIME_SECONDS;
+  session->eventTimeoutsSec[SEND_EPHEMERAL_DATA_MESSAGE] += (!session->partner.isInitiator
                                                     ? theirGenerateKeyTimeSeconds
                                                     : theirConfirmKeyTimeSeconds);
   // Only initiator needs this timeout while waiting for the event
   // INITIATER_RECEIVED_CONFIRM_KEY_MESSAGE.  Responder ends KE when
   // getting to this event.
-  eventTimeoutsSec[SEND_CONFIRM_KEY_MESSAGE]    += theirConfirmKeyTimeSeconds;
+  session->eventTimeoutsSec[SEND_CONFIRM_KEY_MESSAGE]    += theirConfirmKeyTimeSeconds;
 }
 
 static EmberStatus calculateSmacs(boolean amInitiator,
@@ -918,12 +1094,19 @@ static void messageSentHandler(EmberOutgoingMessageType type,
                                int8u *message,
                                EmberStatus status)
 {
-  if (!partner.isIntraPan
-      || lastEvent == NO_KEY_ESTABLISHMENT_EVENT
-      || partner.pan.intraPan.nodeId != indexOrDestination) {
+  int8u i;
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    if (sessions[i].partner.isIntraPan
+        && sessions[i].lastEvent != NO_KEY_ESTABLISHMENT_EVENT
+        && sessions[i].partner.pan.intraPan.nodeId == indexOrDestination) {
+      break;
+    }
+  }
+  if (i == MAX_SESSIONS) {
     // Unknown APS Ack, or an Ack for key establishment not in progress.
     return;
   }
+  session = &sessions[i];
 
   if (status != EMBER_SUCCESS) {
     emberAfKeyEstablishmentClusterPrintln("Error: Failed to send key establish message to 0x%2x, status: 0x%x",
@@ -939,30 +1122,31 @@ static void messageSentHandler(EmberOutgoingMessageType type,
 // network.
 static boolean setPartnerFromCommand(const EmberAfClusterCommand *cmd)
 {
-  partner.isInitiator = TRUE;
-  partner.isIntraPan = (cmd->interPanHeader == NULL);
-  if (partner.isIntraPan) {
-    partner.pan.intraPan.nodeId = cmd->source;
-    partner.pan.intraPan.endpoint = cmd->apsFrame->sourceEndpoint;
-    keyEstablishmentEndpoint = cmd->apsFrame->destinationEndpoint;
+  session->partner.isInitiator = TRUE;
+  session->partner.isIntraPan = (cmd->interPanHeader == NULL);
+  if (session->partner.isIntraPan) {
+    session->partner.pan.intraPan.nodeId = cmd->source;
+    session->partner.pan.intraPan.endpoint = cmd->apsFrame->sourceEndpoint;
+    session->endpoint = cmd->apsFrame->destinationEndpoint;
   } else {
     if (!(cmd->interPanHeader->options
           & EMBER_AF_INTERPAN_OPTION_MAC_HAS_LONG_ADDRESS)) {
       return FALSE;
     }
-    partner.pan.interPan.panId = cmd->interPanHeader->panId;
-    MEMCOPY(partner.pan.interPan.eui64,
+    session->partner.pan.interPan.panId = cmd->interPanHeader->panId;
+    MEMCOPY(session->partner.pan.interPan.eui64,
             cmd->interPanHeader->longAddress,
             EUI64_SIZE);
-    keyEstablishmentEndpoint = emberAfPrimaryEndpointForCurrentNetworkIndex();
-    if (keyEstablishmentEndpoint == 0xFF) {
+    session->endpoint = emberAfPrimaryEndpointForCurrentNetworkIndex();
+    if (session->endpoint == 0xFF) {
       return FALSE;
     }
   }
   return TRUE;
 }
 
-static boolean commandIsFromOurPartner(const EmberAfClusterCommand *cmd)
+static boolean commandIsFromPartner(const KeyEstablishmentPartner *partner,
+                                    const EmberAfClusterCommand *cmd)
 {
   // For intra-PAN commands, we should check that the source and destination
   // endpoints and the sequence numbers of the request/response pairs match.
@@ -971,8 +1155,8 @@ static boolean commandIsFromOurPartner(const EmberAfClusterCommand *cmd)
   // problems.  Neither endpoint nor sequence number mismatches are likely to
   // cause serious problems in practice because Key Establishment is intended
   // to be device-wide rather than per-endpoint and we only support a single
-  // partner at a time, so checking our partner and correlating requests and
-  // responses is not difficult.
+  // key establishment at a time with each partner, so checking the partner
+  // and correlating requests and responses is not difficult.
   
   // We generally make sure that the direction bit is set correctly, but for a 
   // terminate command we do not.  This is due to timeouts and the fact that
@@ -980,15 +1164,15 @@ static boolean commandIsFromOurPartner(const EmberAfClusterCommand *cmd)
   // key establishment, then it is the server.  In that case it will send the 
   // Terminate message with the direction set 'server-to-client' even if
   // the request was also 'server-to-client'.
-  return (((partner.isInitiator
+  return (((partner->isInitiator
             == (cmd->direction == ZCL_DIRECTION_CLIENT_TO_SERVER))
            || (cmd->commandId == ZCL_TERMINATE_KEY_ESTABLISHMENT_COMMAND_ID))
-          && partner.isIntraPan == (cmd->interPanHeader == NULL)
-          && (partner.isIntraPan
-              ? partner.pan.intraPan.nodeId == cmd->source
+          && partner->isIntraPan == (cmd->interPanHeader == NULL)
+          && (partner->isIntraPan
+              ? partner->pan.intraPan.nodeId == cmd->source
               : ((cmd->interPanHeader->options
                   & EMBER_AF_INTERPAN_OPTION_MAC_HAS_LONG_ADDRESS)
-                 && (MEMCOMPARE(partner.pan.interPan.eui64,
+                 && (MEMCOMPARE(partner->pan.interPan.eui64,
                                 cmd->interPanHeader->longAddress,
                                 EUI64_SIZE) == 0))));
 }
@@ -1038,24 +1222,42 @@ static EmberStatus initiateKeyEstablishment(const EmberEUI64 eui64,
                                             int16u nodeIdOrPanId,
                                             int8u endpoint)
 {
-  if (initSuccess && lastEvent == NO_KEY_ESTABLISHMENT_EVENT) {
-    keyEstablishmentEndpoint = emberAfPrimaryEndpointForCurrentNetworkIndex();
-    if (keyEstablishmentEndpoint == 0xFF) {
+  KeyEstablishmentSession *idle = findIdleSession();
+  int8u i;
+
+  // Only one key establishment at a time is allowed with each partner.
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    if (sessions[i].lastEvent != NO_KEY_ESTABLISHMENT_EVENT
+        && sessions[i].partner.isIntraPan == (eui64 == NULL)
+        && (eui64 == NULL
+            ? sessions[i].partner.pan.intraPan.nodeId == nodeIdOrPanId
+            : MEMCOMPARE(sessions[i].partner.pan.interPan.eui64,
+                         eui64,
+                         EUI64_SIZE) == 0)) {
+      return EMBER_INVALID_CALL;
+    }
+  }
+
+  if (initSuccess && idle != NULL) {
+    int8u localEndpoint = emberAfPrimaryEndpointForCurrentNetworkIndex();
+    if (localEndpoint == 0xFF) {
       return EMBER_INVALID_CALL;
     }
-    partner.isInitiator = FALSE;
-    partner.isIntraPan = (eui64 == NULL);
-    if (partner.isIntraPan) {
-      partner.pan.intraPan.nodeId = nodeIdOrPanId;
-      partner.pan.intraPan.endpoint = endpoint;
+    session = idle;
+    session->endpoint = localEndpoint;
+    session->partner.isInitiator = FALSE;
+    session->partner.isIntraPan = (eui64 == NULL);
+    if (session->partner.isIntraPan) {
+      session->partner.pan.intraPan.nodeId = nodeIdOrPanId;
+      session->partner.pan.intraPan.endpoint = endpoint;
     } else {
-      partner.pan.interPan.panId = nodeIdOrPanId;
-      MEMCOPY(partner.pan.interPan.eui64, eui64, EUI64_SIZE);
+      session->partner.pan.interPan.panId = nodeIdOrPanId;
+      MEMCOPY(session->partner.pan.interPan.eui64, eui64, EUI64_SIZE);
     }
-    partner.sequenceNumber = emberAfNextSequence();
-    apsSequenceNumbersReceived = 0;
+    session->partner.sequenceNumber = emberAfNextSequence();
+    session->apsSequenceNumbersReceived = 0;
     keyEstablishStateMachine(BEGIN_KEY_ESTABLISHMENT, NULL, NULL);
-    return (lastEvent == NO_KEY_ESTABLISHMENT_EVENT
+    return (session->lastEvent == NO_KEY_ESTABLISHMENT_EVENT
             ? EMBER_ERR_FATAL
             : EMBER_SUCCESS);
   }
@@ -1079,14 +1281,29 @@ EmberStatus emberAfInitiateInterPanKeyEstablishmentCallback(EmberPanId panId,
 
 boolean emberAfPerformingKeyEstablishmentCallback(void)
 {
-  return (lastEvent != NO_KEY_ESTABLISHMENT_EVENT);
+  int8u i;
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    if (sessions[i].lastEvent != NO_KEY_ESTABLISHMENT_EVENT) {
+      return TRUE;
+    }
+  }
+  return FALSE;
 }
 
 void emberAfKeyEstablishmentClusterServerInitCallback(int8u endpoint)
 {
-  clearKeyEstablishmentState();
-  setupEventTimeouts(0, 0);
+  int8u i;
   keyEstablishmentEndpoint = endpoint;
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    session = &sessions[i];
+    clearKeyEstablishmentState();
+    setupEventTimeouts(0, 0);
+    session->endpoint = endpoint;
+  }
+  session = &sessions[0];
+  cryptoSession = NULL;
+  cryptoQueueLength = 0;
+  emberClearTemporaryDataMaybeStoreLinkKey(FALSE);
 
   // This checks presence of a certificate, and the libraries.
   initSuccess = emberAfIsFullSmartEnergySecurityPresent();
@@ -1138,7 +1355,17 @@ void emberAfKeyEstablishmentClusterServerInitCallback(int8u endpoint)
 
 void emberAfKeyEstablishmentClusterServerTickCallback(int8u endpoint)
 {
-  cleanupAndStop(TIMEOUT_OCCURRED);
+  int32u now = halCommonGetInt32uMillisecondTick();
+  int8u i;
+  for (i = 0; i < MAX_SESSIONS; i++) {
+    if (sessions[i].lastEvent != NO_KEY_ESTABLISHMENT_EVENT
+        && timeGTorEqualInt32u(now, sessions[i].timeoutMs)) {
+      session = &sessions[i];
+      cleanupAndStop(TIMEOUT_OCCURRED);
+    }
+  }
+  startQueuedKeyGeneration();
+  scheduleTimeoutTick();
 }
 
 boolean emberAfKeyEstablishmentClusterServerCommandReceivedCallback(EmberAfClusterCommand *cmd)
@@ -1177,15 +1404,19 @@ boolean emberAfKeyEstablishmentClusterTerminateKeyEstablishmentCallback(int8u st
                                                                         int16u keyEstablishmentSuite)
 {
   EmberAfClusterCommand *cmd = emberAfCurrentCommand();
+  KeyEstablishmentSession *match;
   if (cmd != NULL && cmd->type >= EMBER_INCOMING_MULTICAST) {
     emberAfKeyEstablishmentClusterPrintln("Ignoring Broadcast KE terminate");
     return TRUE;
   }
 
-  if (lastEvent != NO_KEY_ESTABLISHMENT_EVENT && commandIsFromOurPartner(cmd)) {
-    if (partner.isIntraPan) {
-      apsSequenceNumbers[apsSequenceNumbersReceived] = cmd->apsFrame->sequence;
-      apsSequenceNumbersReceived++;
+  match = findSessionForCommand(cmd, TRUE);
+  if (match != NULL) {
+    session = match;
+    if (session->partner.isIntraPan
+        && session->apsSequenceNumbersReceived < NUM_SEQ_NUMBER) {
+      session->apsSequenceNumbers[session->apsSequenceNumbersReceived] = cmd->apsFrame->sequence;
+      session->apsSequenceNumbersReceived++;
     }
     emberAfKeyEstablishmentClusterPrintln("Terminate Received, Status(%d): %p",
                                           statusCode,
@@ -1213,6 +1444,7 @@ static void defaultResponseCallback(int8u endpoint,
                                     EmberAfStatus status)
 {
   EmberAfClusterCommand *cmd = emberAfCurrentCommand();
+  KeyEstablishmentSession *match;
 
   if (cmd != NULL && cmd->type >= EMBER_INCOMING_MULTICAST) {
     emberAfKeyEstablishmentClusterPrintln("Ignoring Broadcast KE default resp");
@@ -1220,8 +1452,8 @@ static void defaultResponseCallback(int8u endpoint,
   }
 
   if (status != EMBER_ZCL_STATUS_SUCCESS
-      && lastEvent != NO_KEY_ESTABLISHMENT_EVENT
-      && commandIsFromOurPartner(cmd)) {
+      && (match = findSessionForCommand(cmd, TRUE)) != NULL) {
+    session = match;
     emberAfKeyEstablishmentClusterPrintln("Got Default Response with error code: %d", 
                                           status);
     // While the actual status code may be more meaningful, we don't really care.
@@ -1297,6 +1529,13 @@ void emAfPluginKeyEstablishmentGenerateCbkeKeysHandler(EmberStatus status,
                                          status);
   emAfCryptoOperationComplete();
 
+  // The result belongs to the session that owns the CBKE library.  If that
+  // session has already ended there is nothing to do with it.
+  if (cryptoSession == NULL) {
+    return;
+  }
+  session = cryptoSession;
+
   if (status != EMBER_SUCCESS) {
     cleanupAndStop(NO_LOCAL_RESOURCES);
     return;
@@ -1320,6 +1559,11 @@ void emAfPluginKeyEstablishmentCalculateSmacsHandler(EmberStatus status,
   emberAfKeyEstablishmentClusterPrintln("CalculateSmacsHandler() returned: 0x%x",
                                          status);
   emAfCryptoOperationComplete();
+
+  if (cryptoSession == NULL) {
+    return;
+  }
+  session = cryptoSession;
   debugPrintSmac(TRUE,  emberSmacContents(initiatorSmacReturn));
   debugPrintSmac(FALSE, emberSmacContents(responderSmacReturn));
 
@@ -0,0 +1,134 @@
+// *****************************************************************************
+// * meter-mirror-store.h
+// *
+// * Keeps the interval data and summations of mirrored meters on a gateway.
+// *
+// * Each meter's readings are kept in a file per channel in the store
+// * directory.  The file is made of fixed size segments, each starting with a
+// * header that gives the time and value of its first and last readings.  The
+// * rest of each reading is encoded as the difference from the one before it,
+// * as a varint, so a segment holds around a thousand readings.  Readings are
+// * only ever appended, in time order, and the file is memory mapped, so a
+// * range of readings is found by a binary search of the segment headers and
+// * then decoded from the mapping without a read call.
+// *
+// * Copyright 2012 by Ember Corporation. All rights reserved.              *80*
+// *****************************************************************************
+
+#ifndef EMBER_AF_PLUGIN_METER_MIRROR_STORE_DIRECTORY
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_DIRECTORY "meter-mirror-store"
+#endif //EMBER_AF_PLUGIN_METER_MIRROR_STORE_DIRECTORY
+
+// The meters are hashed by EUI64 and channel.
+#ifndef EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS 4096
+#endif //EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS
+
+// The channels a meter's readings are kept in.  The interval channels match
+// the interval channels of the Get Profile command.
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_INTERVAL_DELIVERED  0x00
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_INTERVAL_RECEIVED   0x01
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_SUMMATION_DELIVERED 0x02
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_SUMMATION_RECEIVED  0x03
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_CHANNEL_COUNT       4
+
+// The mirror endpoints are indexed by endpoint number.
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT 256
+
+// The most intervals a Get Profile Response may carry.
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS 24
+
+// Stands for an interval period that is not known.
+#define EMBER_AF_PLUGIN_METER_MIRROR_STORE_NO_INTERVAL_PERIOD 0xFF
+
+typedef struct {
+  int32u time;      // UTC seconds; the end of the interval for interval data
+  int64u value;
+} EmberAfMeterReading;
+
+// Opens the store kept in a directory, creating the directory if need be.
+// Any store already open is closed first.  Meters' files are opened the
+// first time their readings are used.
+EmberStatus emberAfPluginMeterMirrorStoreOpen(const char *directory);
+
+// Unmaps and forgets every meter's file.
+void emberAfPluginMeterMirrorStoreClose(void);
+
+// Asks for everything appended so far to be written to disk.
+void emberAfPluginMeterMirrorStoreFlush(void);
+
+// Appends a reading to a meter's channel.  Readings must be appended in time
+// order; EMBER_BAD_ARGUMENT is returned for one older than the channel's
+// latest reading.
+EmberStatus emberAfPluginMeterMirrorStoreAppend(EmberEUI64 meter,
+                                               int8u channel,
+                                               int32u time,
+                                               int64u value);
+
+// Appends the intervals of a Get Profile Response, which are given most
+// recent first, ending at endTime and intervalPeriod apart (a ZCL interval
+// period).  Intervals that are not newer than the channel's latest reading
+// have been stored before and are skipped.
+EmberStatus emberAfPluginMeterMirrorStoreAppendProfile(EmberEUI64 meter,
+                                                      int8u channel,
+                                                      int32u endTime,
+                                                      int8u intervalPeriod,
+                                                      int8u numberOfPeriods,
+                                                      const int32u *intervals);
+
+// Reads up to maxReadings readings of a meter's channel, oldest first, whose
+// times are from startTime to endTime, both included.  Returns the number
+// read.
+int32u emberAfPluginMeterMirrorStoreRead(EmberEUI64 meter,
+                                         int8u channel,
+                                         int32u startTime,
+                                         int32u endTime,
+                                         EmberAfMeterReading *readings,
+                                         int32u maxReadings);
+
+// Returns the time of the latest reading of a meter's channel at or before
+// time, or 0 if there is none.
+int32u emberAfPluginMeterMirrorStoreLatestTime(EmberEUI64 meter,
+                                               int8u channel,
+                                               int32u time);
+
+// Answers a Get Profile command from the intervals stored for a meter.  An
+// endTime of 0 asks for the latest intervals.  On return endTime is the end
+// of the latest interval delivered and intervalPeriod the channel's interval
+// period, and intervals holds the intervals most recent first, with 0 for any
+// that were never received.  Returns the number of intervals delivered, which
+// is 0 if the meter has none at or before endTime.
+int8u emberAfPluginMeterMirrorStoreGetProfile(EmberEUI64 meter,
+                                              int8u channel,
+                                              int32u *endTime,
+                                              int8u *intervalPeriod,
+                                              int8u numberOfPeriods,
+                                              int32u *intervals);
+
+// Returns the number of bytes of the open meters' files that hold readings,
+// not counting the space set aside for readings yet to come.  A file that
+// could not be mapped again after failing to grow is not counted.
+int64u emberAfPluginMeterMirrorStoreSize(void);
+
+// Mirrors.  The simple metering client tells the store which endpoint
+// mirrors which meter, so that the summations written to a mirror and the
+// Get Profile commands sent to one can be matched with the meter's readings.
+void emberAfPluginMeterMirrorStoreMirrorAdded(int8u endpoint,
+                                              EmberEUI64 meter);
+void emberAfPluginMeterMirrorStoreMirrorRemoved(int8u endpoint);
+
+// Keeps which endpoint mirrors which meter in the store directory, so that
+// the mirrors are known again when the store is next opened.  Both arrays
+// are indexed by endpoint and have one entry per endpoint number.  Loading a
+// store that has never saved its mirrors finds none.
+EmberStatus emberAfPluginMeterMirrorStoreSaveMirrors(EmberEUI64 *meters,
+                                                     const boolean *isMirror);
+EmberStatus emberAfPluginMeterMirrorStoreLoadMirrors(EmberEUI64 *meters,
+                                                     boolean *isMirror);
+
+// Answers a Get Profile command sent to a mirror endpoint from the store.
+// Returns FALSE if the endpoint is not a mirror.
+boolean emberAfPluginMeterMirrorStoreGetProfileCommand(int8u endpoint,
+                                                       int8u intervalChannel,
+                                                       int32u endTime,
+                                                       int8u numberOfPeriods);
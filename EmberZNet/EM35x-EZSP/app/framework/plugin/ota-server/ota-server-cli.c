@@ -82,6 +82,11 @@
  *        <b>plugin ota-server policy page-req-sup</b>
  *        - <i></i>
  *
+ *        <b>plugin ota-server page-requests</b>
+ *        - <i>Prints the page request sessions of recent clients, with the
+ *             blocks sent, send failures and bytes per second of each.  A
+ *             '*' marks the sessions still in progress.</i>
+ *
  */
 #define EMBER_AF_DOXYGEN_CLI__OTA_SERVER_COMMANDS
 /** @} END addtogroup */
@@ -145,6 +150,10 @@ static const PGM_P notifyArguments[] = {
                                      "Send a notification about a new OTA image", \
                                      notifyArguments),                  \
   emberCommandEntryAction("upgrade",     otaSendUpgradeCommand, "vu", "" ),  \
+  emberCommandEntryAction("page-requests",                          \
+                          emAfOtaPageRequestPrintSessions,          \
+                          "",                                       \
+                          "Print the page request sessions"),       \
   LOAD_FILE_COMMAND \
 POLICY_COMMANDS \
 emberCommandEntryTerminator(),
@@ -27,23 +27,61 @@
 
 #define MAXIMUM_PAGE_SIZE 1024
 
-static EmberNodeId requesterNodeId = EMBER_NULL_NODE_ID;
-static int32u requesterBaseOffset;
-static int16u requesterPageSize;
-static int16u totalBytesSent;
-static int8u requesterMaxDataSize;
-static EmberAfOtaImageId requesterImageId;
-static boolean handlingPageRequest = FALSE;
-static int16u requesterResponseSpacing;
+// The number of clients that may have a page request in progress at once.
+#ifndef EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SESSIONS
+  #define EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SESSIONS 4
+#endif
+
+// Each client's page request is sent as a stream of image block responses,
+// spaced by the response spacing the client asked for.  The streams of all
+// clients are interleaved: each tick sends one block for the session that
+// is due soonest, so a client that asked for a shorter spacing gets a larger
+// share of the sends.  A block that could not be handed to the stack is
+// tried again after a longer wait, doubled on each failure, so that a client
+// whose route is congested slows down without holding up the others.
+//
+// A session's counters are kept after its page has been sent, until the
+// entry is needed for another client, so that they can be printed.
+typedef struct {
+  boolean used;
+  boolean active;
+  EmberNodeId nodeId;
+  int8u endpoint;               // the client's endpoint
+  int8u sequenceNumber;         // of the page request
+  EmberAfOtaImageId imageId;
+  int32u baseOffset;
+  int16u pageSize;
+  int16u totalBytesSent;        // within the page
+  int8u maxDataSize;
+  int8u backoff;                // failures in a row; doubles the spacing
+  int16u responseSpacing;
+  int32u nextSendMs;
+  int32u startMs;
+  int32u lastSendMs;
+  int32u blocksSent;
+  int32u sendFailures;
+} PageRequestSession;
+
+static PageRequestSession sessions[EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SESSIONS];
+static int8u lastSession = 0;
+
+// The session whose block is being sent, if any.
+static PageRequestSession* currentSession = NULL;
 
 #define SHORTEST_SEND_RATE 10L  // ms.
+#define MAX_BACKOFF        5    // failures in a row before the page is
+                                // abandoned, the last wait being 32 times
+                                // the spacing
+
+// Tick values are compared allowing for wrapping, as elsewhere.
+#define isEarlier(a, b) ((int32s)((a) - (b)) < 0)
 
 // -----------------------------------------------------------------------------
 // Forward Declarations
 // -----------------------------------------------------------------------------
 
-static void sendBlockRequest(void);
-static void abortPageRequest(void);
+static void sendBlockRequest(PageRequestSession* session);
+static void abortPageRequest(PageRequestSession* session);
 
 #if defined(EM_AF_TEST_HARNESS_CODE)
   #define pageRequestTickCallback(x,y)             \
@@ -54,6 +92,44 @@ static void abortPageRequest(void);
 
 // -----------------------------------------------------------------------------
 
+// A client that sends a new page request replaces its old one.  Otherwise a
+// session that is not in use is taken, preferring one that never was.
+static PageRequestSession* findSession(EmberNodeId nodeId)
+{
+  PageRequestSession* unused = NULL;
+  int8u i;
+  for (i = 0; i < EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SESSIONS; i++) {
+    if (sessions[i].used && sessions[i].nodeId == nodeId) {
+      return &sessions[i];
+    }
+    if (!sessions[i].active
+        && (unused == NULL || !sessions[i].used)) {
+      unused = &sessions[i];
+    }
+  }
+  return unused;
+}
+
+// Returns the active session that is due soonest.  Ties go to the session
+// after the one served last, so that sessions due at the same time take
+// turns.
+static PageRequestSession* nextSession(void)
+{
+  PageRequestSession* next = NULL;
+  int8u i;
+  for (i = 1; i <= EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SESSIONS; i++) {
+    PageRequestSession* session
+      = &sessions[(lastSession + i)
+                  % EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SESSIONS];
+    if (session->active
+        && (next == NULL
+            || isEarlier(session->nextSendMs, next->nextSendMs))) {
+      next = session;
+    }
+  }
+  return next;
+}
+
 int8u emAfOtaPageRequestHandler(int8u endpoint,
                                 const EmberAfOtaImageId* id,
                                 int32u offset,
@@ -63,6 +139,7 @@ int8u emAfOtaPageRequestHandler(int8u endpoint,
 {
   int32u totalSize;
   int8u status;
+  PageRequestSession* session;
   emberAfOtaBootloadClusterPrintln("RX ImagePageReq mfgId:%2x imageType:%2x, file:%4x, offset:%4x dataSize:%d pageSize%2x spacing:%d",
                                    id->manufacturerId, 
                                    id->imageTypeId, 
@@ -72,9 +149,9 @@ int8u emAfOtaPageRequestHandler(int8u endpoint,
                                    pageSize, 
                                    responseSpacing);
 
-  // Only allow 1 page request at a time.
-  if (requesterNodeId != EMBER_NULL_NODE_ID) {
-    otaPrintln("2nd page request not supported");
+  session = findSession(emberAfResponseDestination);
+  if (session == NULL) {
+    otaPrintln("No free page request session");
     return EMBER_ZCL_STATUS_FAILURE;
   }
 
@@ -83,7 +160,6 @@ int8u emAfOtaPageRequestHandler(int8u endpoint,
     return status;
   }
   
-  MEMCOPY(&requesterImageId, id, sizeof(EmberAfOtaImageId));
   totalSize = emberAfOtaStorageGetTotalImageSizeCallback(id);
 
   if (totalSize == 0) {
@@ -92,92 +168,122 @@ int8u emAfOtaPageRequestHandler(int8u endpoint,
     return EMBER_ZCL_STATUS_INVALID_VALUE;
   }
 
-  requesterNodeId = emberAfResponseDestination;
-  requesterBaseOffset = offset;
-  requesterPageSize = pageSize;
-  requesterMaxDataSize = maxDataSize;
-  requesterResponseSpacing = (responseSpacing < SHORTEST_SEND_RATE
+  MEMSET(session, 0, sizeof(PageRequestSession));
+  MEMCOPY(&session->imageId, id, sizeof(EmberAfOtaImageId));
+  session->used = TRUE;
+  session->active = TRUE;
+  session->nodeId = emberAfResponseDestination;
+  session->endpoint = emberAfResponseApsFrame.destinationEndpoint;
+  session->sequenceNumber = emberAfIncomingZclSequenceNumber;
+  session->baseOffset = offset;
+  session->pageSize = pageSize;
+  session->maxDataSize = maxDataSize;
+  session->responseSpacing = (responseSpacing < SHORTEST_SEND_RATE
                               ? SHORTEST_SEND_RATE
                               : responseSpacing);
-  totalBytesSent = 0;
-  
-  emAfOtaPageRequestTick(endpoint);
+  session->startMs = halCommonGetInt32uMillisecondTick();
+  session->lastSendMs = session->startMs;
+  session->nextSendMs = session->startMs;
+
+  // The first block is sent from the tick rather than from here, as the tick
+  // may pick another session's block and sending overwrites the response
+  // destination and sequence number of the command being processed.
+  emberAfScheduleClusterTick(endpoint,
+                             ZCL_OTA_BOOTLOAD_CLUSTER_ID,
+                             EMBER_AF_SERVER_CLUSTER_TICK,
+                             0,
+                             EMBER_AF_OK_TO_NAP);
 
   return EMBER_ZCL_STATUS_SUCCESS;
 }
 
 void emAfOtaPageRequestTick(int8u endpoint)
 {
-  if (requesterNodeId == EMBER_NULL_NODE_ID) {
+  int32u now = halCommonGetInt32uMillisecondTick();
+  PageRequestSession* next = nextSession();
+
+  if (next != NULL && !isEarlier(now, next->nextSendMs)) {
+    lastSession = next - sessions;
+    sendBlockRequest(next);
+    next = nextSession();
+  }
+  if (next == NULL) {
     return;
   }
 
-  sendBlockRequest();
   emberAfScheduleClusterTick(endpoint,
                              ZCL_OTA_BOOTLOAD_CLUSTER_ID,
                              EMBER_AF_SERVER_CLUSTER_TICK,
-                             requesterResponseSpacing,
+                             (isEarlier(now, next->nextSendMs)
+                              ? next->nextSendMs - now
+                              : 0),
                              EMBER_AF_OK_TO_NAP);
 }
 
 boolean emAfOtaPageRequestErrorHandler(void)
 {
-  if (handlingPageRequest) {
-    abortPageRequest();
+  if (currentSession != NULL) {
+    abortPageRequest(currentSession);
     return TRUE;
   }
   return FALSE;
 }
 
-static void abortPageRequest(void)
+static void abortPageRequest(PageRequestSession* session)
 {
-  requesterNodeId = EMBER_NULL_NODE_ID;
+  session->active = FALSE;
 }
 
-static void sendBlockRequest(void)
+static void sendBlockRequest(PageRequestSession* session)
 {
   int8u bytesSentThisTime = 0;
-  int32u totalSize = emberAfOtaStorageGetTotalImageSizeCallback(&requesterImageId);
+  int32u totalSize = emberAfOtaStorageGetTotalImageSizeCallback(&session->imageId);
   int8u maxDataToSend;
   int32u bytesLeft;
+  int32u now = halCommonGetInt32uMillisecondTick();
+  boolean sent = TRUE;
 
   if (totalSize == 0) {
     // The image no longer exists.  
-    abortPageRequest();
+    abortPageRequest(session);
     return;
   }
 
-  bytesLeft = totalSize - (requesterBaseOffset + totalBytesSent);
+  bytesLeft = totalSize - (session->baseOffset + session->totalBytesSent);
   
   // 3 possibilities for how much data to send
   //   - Up to requesterMaxSize
   //   - As many bytes are left in the file
   //   - As many bytes are left to fill up client's page size
-  if ((requesterPageSize - totalBytesSent) > requesterMaxDataSize) {
-    maxDataToSend = (bytesLeft > requesterMaxDataSize
-                     ? requesterMaxDataSize
+  if ((session->pageSize - session->totalBytesSent) > session->maxDataSize) {
+    maxDataToSend = (bytesLeft > session->maxDataSize
+                     ? session->maxDataSize
                      : (int8u)bytesLeft);
   } else {
-    maxDataToSend = requesterPageSize - totalBytesSent;
+    maxDataToSend = session->pageSize - session->totalBytesSent;
   }
 
-  emberAfResponseDestination = requesterNodeId;
-  handlingPageRequest = TRUE;
+  // The response is addressed as it would have been when the page request
+  // was received, since other messages may have been handled since.
+  emberAfResponseDestination = session->nodeId;
+  emberAfResponseApsFrame.destinationEndpoint = session->endpoint;
+  emberAfIncomingZclSequenceNumber = session->sequenceNumber;
+  currentSession = session;
 
   // To enable sending as fast as possible without the receiver
   // having to waste battery power by responding, we clear the
   // retry flag.
   emberAfResponseApsFrame.options &= ~EMBER_APS_OPTION_RETRY;
 
-  if (pageRequestTickCallback(totalBytesSent,
-                              requesterMaxDataSize)) {
+  if (pageRequestTickCallback(session->totalBytesSent,
+                              session->maxDataSize)) {
     // Simulate a block request to the server that we will generate
     // a response to.
     EmberAfImageBlockRequestCallbackStruct callbackStruct;
     MEMSET(&callbackStruct, 0, sizeof(EmberAfImageBlockRequestCallbackStruct));
-    callbackStruct.source = requesterNodeId;
-    callbackStruct.id = &requesterImageId;
-    callbackStruct.offset = requesterBaseOffset + totalBytesSent;
+    callbackStruct.source = session->nodeId;
+    callbackStruct.id = &session->imageId;
+    callbackStruct.offset = session->baseOffset + session->totalBytesSent;
     callbackStruct.maxDataSize = maxDataToSend;
 
     // This is implied by the MEMSET().  We don't care about those options
@@ -185,30 +291,85 @@ static void sendBlockRequest(void)
     //    callbackStruct.bitmask = EMBER_AF_IMAGE_BLOCK_REQUEST_OPTIONS_NONE
 
     bytesSentThisTime = emAfOtaImageBlockRequestHandler(&callbackStruct);
-    emberAfSendResponse();
+    sent = (emberAfSendResponse() == EMBER_SUCCESS);
   } else {
     bytesSentThisTime += maxDataToSend;
   }
-  handlingPageRequest = FALSE;
+  currentSession = NULL;
+  if (!session->active) {
+    // The error handler gave up on the page.
+    return;
+  }
   if (bytesSentThisTime == 0) {
     emberAfOtaBootloadClusterPrintln("Failed to send image block for page request");
     // We don't need to call abortPageRequest();
     // here because the server will call into our otaPageRequestErrorHandler()
     // if that occurs.
+  } else if (!sent) {
+    // The stack could not take the message, so the same block is tried again
+    // after a longer wait.
+    session->sendFailures++;
+    if (session->backoff == MAX_BACKOFF) {
+      emberAfOtaBootloadClusterPrintln("Giving up on page request to 0x%2x",
+                                       session->nodeId);
+      abortPageRequest(session);
+      return;
+    }
+    session->backoff++;
   } else {
-    totalBytesSent += bytesSentThisTime;
+    session->backoff = 0;
+    session->blocksSent++;
+    session->lastSendMs = now;
+    session->totalBytesSent += bytesSentThisTime;
 
-    if (totalBytesSent >= totalSize
-        || totalBytesSent >= requesterPageSize) {
+    if (session->totalBytesSent >= totalSize
+        || session->totalBytesSent >= session->pageSize) {
       emberAfOtaBootloadClusterPrintln("Done sending blocks for page request.");
-      abortPageRequest();
+      abortPageRequest(session);
+      return;
     }
   }
+  session->nextSendMs = now + ((int32u)session->responseSpacing
+                               << session->backoff);
 }
 
 boolean emAfOtaServerHandlingPageRequest(void)
 {
-  return handlingPageRequest;
+  return (currentSession != NULL);
+}
+
+void emAfOtaPageRequestPrintSessions(void)
+{
+  int32u now = halCommonGetInt32uMillisecondTick();
+  int8u i;
+
+  otaPrintln("#  node   image          sent/page  spacing blocks     fail       bytes/s");
+  otaPrintFlush();
+  for (i = 0; i < EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SESSIONS; i++) {
+    PageRequestSession* session = &sessions[i];
+    int32u elapsedMs;
+    if (!session->used) {
+      continue;
+    }
+    elapsedMs = (session->active ? now : session->lastSendMs) - session->startMs;
+    otaPrintln("%d%p 0x%2x %2x:%2x:%4x %2x/%2x  %l ms %l %l %l",
+               i,
+               (session->active ? "*" : " "),
+               session->nodeId,
+               session->imageId.manufacturerId,
+               session->imageId.imageTypeId,
+               session->imageId.firmwareVersion,
+               session->totalBytesSent,
+               session->pageSize,
+               (int32u)session->responseSpacing << session->backoff,
+               session->blocksSent,
+               session->sendFailures,
+               (elapsedMs == 0
+                ? 0
+                : (int32u)(((int32u)session->totalBytesSent * 1000UL)
+                           / elapsedMs)));
+    otaPrintFlush();
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -238,5 +399,10 @@ boolean emAfOtaServerHandlingPageRequest(void)
   return FALSE;
 }
 
+void emAfOtaPageRequestPrintSessions(void)
+{
+  otaPrintln("Page request support is not enabled.");
+}
+
 
 #endif //  defined (EMBER_AF_PLUGIN_OTA_SERVER_PAGE_REQUEST_SUPPORT)
@@ -6,8 +6,10 @@
  * 
  * This implements the image storage for a standard POSIX-style operating system 
  * with an underlying filesystem.  It creates a linked list cache of all
- * the OTA image headers and uses that for quick access to requests for an
- * image.  Full image data requires that we read the file from disk.
+ * the OTA image headers, hashed by manufacturer and image type, and uses that
+ * for quick access to requests for an image.  Full image data is read with
+ * pread() from the file, which is opened the first time a block of the image
+ * is requested and kept open until the image is removed from the cache.
  *
  * It can also be a OTA client storage device, receiving bytes over the air
  * and storing them to a temporary file.  Once that is done is can validate the
@@ -49,6 +51,14 @@
 
 #include <dirent.h>     // opendir, readdir
 
+#if defined(__linux__)
+  #include <sys/inotify.h>  // inotify_init1, inotify_add_watch
+#endif
+
+#if !defined(WIN32)
+  #include <fcntl.h>      // open
+#endif
+
 #ifdef __APPLE__
 #define strnlen(string, n) strlen((string))
 #endif
@@ -62,6 +72,8 @@ static boolean storageDeviceIsDirectory = FALSE;
 static char* tempStorageFilepath  = NULL;
 
 static const char* tempStorageFile = "temporary-storage.ota";
+static const char* headerIndexFile = ".ota-header-index";
+static const char* headerIndexTempFile = ".ota-header-index.tmp";
 
 typedef struct {
   EmberAfOtaHeader* header;
@@ -69,12 +81,29 @@ typedef struct {
   const char* filenameStart;  // ptr to data in 'filepath'
   struct OtaImage* next;
   struct OtaImage* prev;
+  struct OtaImage* hashNext;  // next image in the same hash bucket
   off_t fileSize;
+  int32u modifiedTime;
+  int fileDescriptor;         // -1 until the first block is read
+  boolean openFailed;         // read blocks with fread() instead
 } OtaImage;
 
 static OtaImage* imageListFirst = NULL;
 static OtaImage* imageListLast = NULL;
-static int8u imageCount = 0;
+static int16u imageCount = 0;
+
+// Images are also hashed by manufacturer ID and image type ID, which every
+// search specifies.  Each bucket keeps its images in the same order as the
+// list above, so that searches find the same image as a walk of the list.
+#ifndef OTA_IMAGE_HASH_BUCKETS
+  #define OTA_IMAGE_HASH_BUCKETS 64
+#endif
+
+static OtaImage* imageHash[OTA_IMAGE_HASH_BUCKETS];
+
+#define imageBucket(manufacturerId, imageTypeId)                  \
+  (&imageHash[(((int32u)(manufacturerId) << 16) | (imageTypeId))  \
+              % OTA_IMAGE_HASH_BUCKETS])
 
 #define OTA_MAX_FILENAME_LENGTH 1000
 
@@ -171,6 +200,8 @@ static EmAfOtaStorageLinuxConfig config = {
   TRUE,   // ignoreFilesWithUnderscorePrefix
   TRUE,   // printFileDiscoveryOrRemoval
   NULL,   // fileAddedHandler
+  TRUE,   // useHeaderIndex
+  TRUE,   // watchDirectory
 };
 
 const char* messagePrefix = NULL;  // prefix for all printed messages
@@ -186,9 +217,20 @@ static int allocations = 0;
 static EmberAfOtaStorageStatus createDefaultStorageDirectory(void);
 static EmberAfOtaStorageStatus initImageDirectory(void);
 static OtaImage* addImageFileToList(const char* filename, 
+                                    EmberAfOtaHeader* header,
                                     boolean printImageInfo);
+static void considerFile(const char* filename);
+static void loadHeaderIndex(void);
+static void freeHeaderIndex(void);
+static EmberAfOtaHeader* findIndexedHeader(const char* filename,
+                                           const struct stat* statInfo);
+static void saveHeaderIndex(void);
+static void watchDirectory(void);
+static void stopWatchingDirectory(void);
 static OtaImage* findImageById(const EmberAfOtaImageId* id);
 static void freeOtaImage(OtaImage* image);
+static void freeIfNotNull(void** ptr);
+static boolean checkMagicNumber(FILE* fileHandle, boolean printError);
 static void mapHeaderFieldDefinitionToDataStruct(EmberAfOtaHeader* header);
 static void unmapHeaderFieldDefinitions(void);
 static EmberAfOtaStorageStatus readHeaderDataFromBuffer(EmberAfOtaHeaderFieldDefinition* definition,
@@ -207,6 +249,8 @@ static EmberAfOtaStorageStatus writeRawData(int32u offset,
                                             const int8u* data);
 static OtaImage* findImageByFilename(const char* tempFilepath);
 static void removeImage(OtaImage* image);
+static boolean openImage(OtaImage* image);
+static void closeImage(OtaImage* image);
 
 static void* myMalloc(size_t size, const char* allocName);
 static void myFree(void* ptr);
@@ -324,7 +368,7 @@ EmberAfOtaStorageStatus emberAfOtaStorageInitCallback(void)
   if (storageDeviceIsDirectory) {
     status = initImageDirectory();
   } else {
-    OtaImage* newImage = addImageFileToList(storageDevice, TRUE);
+    OtaImage* newImage = addImageFileToList(storageDevice, NULL, TRUE);
     if (config.fileAddedHandler != NULL
         && newImage != NULL) {
       (config.fileAddedHandler)(newImage->header);
@@ -354,6 +398,8 @@ void emAfOtaStorageClose(void)
   }
   imageListLast = NULL;
   imageListFirst = NULL;
+  MEMSET(imageHash, 0, sizeof(imageHash));
+  stopWatchingDirectory();
   
   if (storageDevice != NULL) {
     myFree(storageDevice);
@@ -369,7 +415,8 @@ void emAfOtaStorageClose(void)
 
 int8u emberAfOtaStorageGetCountCallback(void)
 {
-  return imageCount;
+  emAfOtaStorageCheckDirectory();
+  return (imageCount > 0xFF ? 0xFF : (int8u)imageCount);
 }
 
 EmberAfOtaImageId emberAfOtaStorageSearchCallback(int16u manufacturerId, 
@@ -382,6 +429,7 @@ EmberAfOtaImageId emberAfOtaStorageSearchCallback(int16u manufacturerId,
     INVALID_FIRMWARE_VERSION,
     INVALID_EUI64,
   };
+  emAfOtaStorageCheckDirectory();
   OtaImage* image = imageSearchInternal(&id);
   if (image == NULL) {
     return emberAfInvalidImageId;
@@ -410,6 +458,7 @@ const char* emAfOtaStorageGetFilepath(const EmberAfOtaImageId* id)
 
 EmberAfOtaImageId emberAfOtaStorageIteratorFirstCallback(void)
 {
+  emAfOtaStorageCheckDirectory();
   iterator = imageListFirst;
   return getIteratorImageId();
 }
@@ -437,6 +486,26 @@ EmberAfOtaStorageStatus emberAfOtaStorageReadImageDataCallback(const EmberAfOtaI
     return EMBER_AF_OTA_STORAGE_ERROR;
   }
 
+#if !defined(WIN32)
+  if (openImage(image)) {
+    // As with fread(), a block that runs past the end of the file is cut
+    // short and one that starts past the end is empty.
+    ssize_t dataRead = pread(image->fileDescriptor,
+                             returnData,
+                             length,
+                             offset);
+    if (dataRead < 0) {
+      error("Failed to read file '%s' at offset %d: %s\n",
+            image->filenameStart,
+            offset,
+            strerror(errno));
+      return EMBER_AF_OTA_STORAGE_ERROR;
+    }
+    *returnedLength = dataRead;
+    return EMBER_AF_OTA_STORAGE_SUCCESS;
+  }
+#endif
+
   // Windows requires the 'b' (binary) as part of the mode so that line endings
   // are not truncated.  POSIX ignores this.
   FILE* fileHandle = fopen(image->filepath, "rb");
@@ -519,6 +588,7 @@ EmberAfOtaStorageStatus emAfOtaStorageCreateImage(EmberAfOtaHeader* header,
 EmberAfOtaStorageStatus emAfOtaStorageAddImageFile(const char* filename)
 {
   return (NULL == addImageFileToList(filename,
+                                     NULL,     // read the header
                                      FALSE)    // print image info?
           ? EMBER_AF_OTA_STORAGE_ERROR
           : EMBER_AF_OTA_STORAGE_SUCCESS);
@@ -618,6 +688,13 @@ EmberAfOtaStorageStatus emberAfOtaStorageWriteTempDataCallback(int32u offset,
   if (tempStorageFilepath == NULL) {
     return EMBER_AF_OTA_STORAGE_ERROR;
   }
+
+  // The temporary file may already be in the cache and open.  It is opened
+  // again when next read, in case writing it replaces the file.
+  OtaImage* image = findImageByFilename(tempStorageFilepath);
+  if (image != NULL) {
+    closeImage(image);
+  }
   return writeRawData(offset, tempStorageFilepath, length, data);
 }
 
@@ -631,7 +708,7 @@ EmberAfOtaStorageStatus emberAfOtaStorageCheckTempDataCallback(int32u* returnOff
     return EMBER_AF_OTA_STORAGE_ERROR;
   }
   
-  image = addImageFileToList(tempStorageFilepath, TRUE);
+  image = addImageFileToList(tempStorageFilepath, NULL, TRUE);
   if (image == NULL) {
     return EMBER_AF_OTA_STORAGE_ERROR;
   }
@@ -748,6 +825,46 @@ static boolean doEui64sMatch(const int8u* firstEui64,
   return (0 == MEMCOMPARE(firstEui64, secondEui64, EUI64_SIZE));
 }
 
+// Opens the image file read-only the first time it is needed, and returns
+// FALSE if it cannot be opened.  The file is read with pread(), which sees
+// its length and contents as they are at the time of each read.
+static boolean openImage(OtaImage* image)
+{
+  if (image->fileDescriptor >= 0) {
+    return TRUE;
+  }
+  if (image->openFailed) {
+    return FALSE;
+  }
+#if defined(WIN32)
+  image->openFailed = TRUE;
+  return FALSE;
+#else
+  image->fileDescriptor = open(image->filepath, O_RDONLY);
+  if (image->fileDescriptor < 0) {
+    error("Failed to open file '%s' for reading: %s\n",
+          image->filenameStart,
+          strerror(errno));
+    return FALSE;
+  }
+  debug(config.fileDebug,
+        "Opened '%s'\n",
+        image->filenameStart);
+  return TRUE;
+#endif
+}
+
+static void closeImage(OtaImage* image)
+{
+#if !defined(WIN32)
+  if (image->fileDescriptor >= 0) {
+    close(image->fileDescriptor);
+  }
+#endif
+  image->fileDescriptor = -1;
+  image->openFailed = FALSE;
+}
+
 static OtaImage* findImageByFilename(const char* tempFilepath)
 {
   OtaImage* ptr = imageListFirst;
@@ -811,6 +928,12 @@ static void removeImage(OtaImage* image)
 {
   OtaImage* before = (OtaImage*)image->prev;
   OtaImage* after = (OtaImage*)image->next;
+  OtaImage** bucket = imageBucket(image->header->manufacturerId,
+                                  image->header->imageTypeId);
+  while (*bucket != image) {
+    bucket = (OtaImage**)&((*bucket)->hashNext);
+  }
+  *bucket = (OtaImage*)image->hashNext;
   if (before) {
     before->next = (struct OtaImage*)after;
   }
@@ -823,6 +946,9 @@ static void removeImage(OtaImage* image)
   if (image == imageListLast) {
     imageListLast = before;
   }
+  if (image == iterator) {
+    iterator = after;
+  }
   freeOtaImage(image);
   imageCount--;
 }
@@ -863,22 +989,28 @@ static void printHeaderInfo(const EmberAfOtaHeader* header)
   //  printf("\n");
 }
 
+// If a header is passed it is used instead of reading the file's header.
+// It is either kept with the image or freed.
 static OtaImage* addImageFileToList(const char* filename, 
+                                    EmberAfOtaHeader* header,
                                     boolean printImageInfo)
 {
   OtaImage* newImage = (OtaImage*)myMalloc(sizeof(OtaImage), 
                                            "addImageFileToList():OtaImage");
   if (newImage == NULL) {
+    freeIfNotNull((void**)&header);
     return NULL;
   }
   memset(newImage, 0, sizeof(OtaImage));
+  newImage->fileDescriptor = -1;
+  newImage->header = header;
   
   struct stat statInfo;
   if (0 != stat(filename, &statInfo)) {
-    myFree(newImage);
-    return NULL;
+    goto dontAdd;
   }
   newImage->fileSize = statInfo.st_size;
+  newImage->modifiedTime = statInfo.st_mtime;
 
   int length = 1 + strnlen(filename, OTA_MAX_FILENAME_LENGTH);
   newImage->filepath = myMalloc(length, "filename");
@@ -895,7 +1027,9 @@ static OtaImage* addImageFileToList(const char* filename,
     newImage->filenameStart++;  // +1 for the '/' character
   }
 
-  newImage->header = readImageHeader(filename);
+  if (newImage->header == NULL) {
+    newImage->header = readImageHeader(filename);
+  }
   if (newImage->header == NULL) {
     goto dontAdd;
   }
@@ -963,6 +1097,12 @@ static OtaImage* addImageFileToList(const char* filename,
     newImage->prev = (struct OtaImage*)imageListLast;
     imageListLast = newImage;
   }
+  OtaImage** bucket = imageBucket(newImage->header->manufacturerId,
+                                  newImage->header->imageTypeId);
+  while (*bucket != NULL) {
+    bucket = (OtaImage**)&((*bucket)->hashNext);
+  }
+  *bucket = newImage;
 
   if (printImageInfo) {
     printHeaderInfo(newImage->header);
@@ -993,118 +1133,490 @@ static boolean checkMagicNumber(FILE* fileHandle, boolean printError)
   return TRUE;
 }
 
-static EmberAfOtaStorageStatus initImageDirectory(void)
+// Adds a file found in the storage directory to the cache if it is an OTA
+// image.  The header is taken from the header index if the file has not
+// changed since the index was written.
+static void considerFile(const char* filename)
 {
-  DIR* dir = opendir(storageDevice);
-  if (dir == NULL) {
-    error("Could not open directory: %s\n", strerror(errno));
-    return EMBER_AF_OTA_STORAGE_ERROR;
-  }
+  FILE* fileHandle = NULL;
+  EmberAfOtaHeader* header = NULL;
+  char* filePath = NULL;
+  debug(config.fileDebug, "Considering file '%s'\n", filename);
 
-  debug(config.fileDebug, "Opened Storage Directory: %s\n", storageDevice);
+  if (0 == strcmp(filename, headerIndexFile)
+      || 0 == strcmp(filename, headerIndexTempFile)) {
+    return;
+  }
 
-  struct dirent* dirEntry = readdir(dir);
-  while (dirEntry != NULL) {
-    FILE* fileHandle = NULL;
-    debug(config.fileDebug, "Considering file '%s'\n", dirEntry->d_name);
-
-    // +2 for trailing '/' and '\0'
-    int pathLength = strlen(storageDevice) + strlen(dirEntry->d_name) + 2;
-    if (pathLength > MAX_FILEPATH_LENGTH) {
-      error("Filepath too long (max: %d) skipping file '%s'",
-            MAX_FILEPATH_LENGTH,
-            dirEntry->d_name);
-      goto continueReadingDir;
-    }
-    char* filePath = myMalloc(pathLength, "initImageDirectory(): filepath");
-    if (filePath == NULL) {
-      error("Failed to allocate memory for filepath.\n");
-      goto continueReadingDir;
-    }
+  // +2 for trailing '/' and '\0'
+  int pathLength = strlen(storageDevice) + strlen(filename) + 2;
+  if (pathLength > MAX_FILEPATH_LENGTH) {
+    error("Filepath too long (max: %d) skipping file '%s'",
+          MAX_FILEPATH_LENGTH,
+          filename);
+    goto considerFileDone;
+  }
+  filePath = myMalloc(pathLength, "considerFile(): filepath");
+  if (filePath == NULL) {
+    error("Failed to allocate memory for filepath.\n");
+    goto considerFileDone;
+  }
     
-    sprintf(filePath, "%s%s", 
-            storageDevice, 
-            dirEntry->d_name);
-    debug(config.fileDebug, "Full filepath: '%s'\n", filePath);
-
-    struct stat buffer;
-    if (0 != stat(filePath, &buffer)) {
-      fprintf(stderr,
-              "Error: Could not stat file '%s': %s\n", 
-              filePath,
-              strerror(errno));
-      goto continueReadingDir;
-    } else if (S_ISDIR(buffer.st_mode) || !S_ISREG(buffer.st_mode)) {
-      debug(config.fileDebug, 
-            "Ignoring '%s' because it is not a regular file.\n",
-            dirEntry->d_name);
-
-      goto continueReadingDir;
-    }
+  sprintf(filePath, "%s%s", 
+          storageDevice, 
+          filename);
+  debug(config.fileDebug, "Full filepath: '%s'\n", filePath);
+
+  struct stat buffer;
+  if (0 != stat(filePath, &buffer)) {
+    fprintf(stderr,
+            "Error: Could not stat file '%s': %s\n", 
+            filePath,
+            strerror(errno));
+    goto considerFileDone;
+  } else if (S_ISDIR(buffer.st_mode) || !S_ISREG(buffer.st_mode)) {
+    debug(config.fileDebug, 
+          "Ignoring '%s' because it is not a regular file.\n",
+          filename);
+
+    goto considerFileDone;
+  }
     
-    // NOTE:  dirent.d_name may have a limited length due to POSIX compliance.
-    // Not sure if it will work for all possible filenames.  However
-    // the length does NOT include the directory portion, so it should be
-    // able to store most all filenames (<256 characters).
+  // NOTE:  dirent.d_name may have a limited length due to POSIX compliance.
+  // Not sure if it will work for all possible filenames.  However
+  // the length does NOT include the directory portion, so it should be
+  // able to store most all filenames (<256 characters).
 
-    // Windows requires the 'b' (binary) as part of the mode so that line endings
-    // are not truncated.  POSIX ignores this.
+  header = findIndexedHeader(filename, &buffer);
+  if (header == NULL) {
+    // Windows requires the 'b' (binary) as part of the mode so that line
+    // endings are not truncated.  POSIX ignores this.
     fileHandle = fopen(filePath, "rb");
     if (fileHandle == NULL) {
       error("Could not open file '%s' for reading: %s\n",
             filePath,
             strerror(errno));
-      goto continueReadingDir;
+      goto considerFileDone;
     }
 
     if (!checkMagicNumber(fileHandle, FALSE)) {
-      goto continueReadingDir;
-    }
-    if (config.ignoreFilesWithUnderscorePrefix
-        && dirEntry->d_name[0] == '_') {
-      // As a means of making this program omit certain OTA files from 
-      // processing, we arbitrarily choose to ignore files starting with '_'.
-      // This is done in part to be able to store multiple OTA files in
-      // the same directory that have the same unique manufacturer and image 
-      // type ID.  Normally when this code finds a second image with the
-      // same manufacturer and image type ID it picks the one with latest 
-      // version number. 
-      // By changing the file name we can keep the file intact and
-      // have this code just skip it.
-      printf("Ignoring OTA file '%s' since it starts with '_'.\n",
-             dirEntry->d_name);
-      goto continueReadingDir;
-    }
-    if (config.printFileDiscoveryOrRemoval) {
-      note("Found OTA file '%s'\n", dirEntry->d_name);
+      goto considerFileDone;
     }
+  }
+  if (config.ignoreFilesWithUnderscorePrefix
+      && filename[0] == '_') {
+    // As a means of making this program omit certain OTA files from 
+    // processing, we arbitrarily choose to ignore files starting with '_'.
+    // This is done in part to be able to store multiple OTA files in
+    // the same directory that have the same unique manufacturer and image 
+    // type ID.  Normally when this code finds a second image with the
+    // same manufacturer and image type ID it picks the one with latest 
+    // version number. 
+    // By changing the file name we can keep the file intact and
+    // have this code just skip it.
+    printf("Ignoring OTA file '%s' since it starts with '_'.\n",
+           filename);
+    goto considerFileDone;
+  }
+  if (config.printFileDiscoveryOrRemoval) {
+    note("Found OTA file '%s'\n", filename);
+  }
 
-    // We don't really care about the return code because we want to keep trying
-    // to add files.
-    OtaImage* newImage = addImageFileToList(filePath, TRUE);
-    if (config.fileAddedHandler != NULL
-        && newImage != NULL) {
-      (config.fileAddedHandler)(newImage->header);
-    }
+  // We don't really care about the return code because we want to keep trying
+  // to add files.
+  OtaImage* newImage = addImageFileToList(filePath, header, TRUE);
+  header = NULL;  // freed by addImageFileToList() if not added
+  if (config.fileAddedHandler != NULL
+      && newImage != NULL) {
+    (config.fileAddedHandler)(newImage->header);
+  }
 
-  continueReadingDir:
-    if (fileHandle) {
-      fclose(fileHandle);
-      fileHandle = NULL;
-    }
-    if (filePath) {
-      myFree(filePath);
-      filePath = NULL;
-    }
+ considerFileDone:
+  if (fileHandle) {
+    fclose(fileHandle);
+  }
+  freeIfNotNull((void**)&header);
+  freeIfNotNull((void**)&filePath);
+}
+
+static EmberAfOtaStorageStatus initImageDirectory(void)
+{
+  DIR* dir = opendir(storageDevice);
+  if (dir == NULL) {
+    error("Could not open directory: %s\n", strerror(errno));
+    return EMBER_AF_OTA_STORAGE_ERROR;
+  }
+
+  debug(config.fileDebug, "Opened Storage Directory: %s\n", storageDevice);
+
+  // Files that change while the directory is being read are seen again
+  // by emAfOtaStorageCheckDirectory().
+  watchDirectory();
+  loadHeaderIndex();
+  struct dirent* dirEntry = readdir(dir);
+  while (dirEntry != NULL) {
+    considerFile(dirEntry->d_name);
     dirEntry = readdir(dir);
   }
   if (config.printFileDiscoveryOrRemoval) {
     printf("Found %d files\n\n", imageCount);
   }
   closedir(dir);
+  freeHeaderIndex();
+  saveHeaderIndex();
   return EMBER_AF_OTA_STORAGE_SUCCESS;
 }
 
+//------------------------------------------------------------------------------
+// Header index
+//
+// The headers of the images in the storage directory are saved in an index
+// file there, each with the size and modification time of its file.  When
+// the directory is next scanned, a file that still has the same size and
+// modification time takes its header from the index rather than being
+// opened and parsed.  The index is only a cache: it is written in the host's
+// byte order, and one that cannot be read is ignored and replaced.
+
+typedef struct {
+  int32u magicNumber;
+  int16u headerSize;            // sizeof(EmberAfOtaHeader)
+  int16u entryCount;
+} HeaderIndexFileHeader;
+
+typedef struct {
+  int32u fileSize;
+  int32u modifiedTime;
+  int16u filenameLength;        // the filename follows, then the header
+} HeaderIndexFileEntry;
+
+typedef struct {
+  char* filename;
+  int32u fileSize;
+  int32u modifiedTime;
+  EmberAfOtaHeader header;
+} HeaderIndexEntry;
+
+#define HEADER_INDEX_MAGIC_NUMBER 0x0BEEF1D1L
+
+static HeaderIndexEntry* headerIndex = NULL;
+static int16u headerIndexCount = 0;
+
+static char* storagePath(const char* filename)
+{
+  int length = strlen(storageDevice) + strlen(filename) + 1;
+  char* path = myMalloc(length, "storagePath()");
+  if (path != NULL) {
+    snprintf(path, length, "%s%s", storageDevice, filename);
+  }
+  return path;
+}
+
+static int compareIndexEntries(const void* a, const void* b)
+{
+  return strcmp(((const HeaderIndexEntry*)a)->filename,
+                ((const HeaderIndexEntry*)b)->filename);
+}
+
+static void loadHeaderIndex(void)
+{
+  HeaderIndexFileHeader fileHeader;
+  HeaderIndexFileEntry fileEntry;
+  char* path;
+  FILE* fileHandle;
+
+  if (!config.useHeaderIndex) {
+    return;
+  }
+  path = storagePath(headerIndexFile);
+  if (path == NULL) {
+    return;
+  }
+  fileHandle = fopen(path, "rb");
+  myFree(path);
+  if (fileHandle == NULL) {
+    return;
+  }
+
+  if (1 != fread(&fileHeader, sizeof(fileHeader), 1, fileHandle)
+      || fileHeader.magicNumber != HEADER_INDEX_MAGIC_NUMBER
+      || fileHeader.headerSize != sizeof(EmberAfOtaHeader)
+      || fileHeader.entryCount == 0) {
+    goto loadDone;
+  }
+  headerIndex = myMalloc(fileHeader.entryCount * sizeof(HeaderIndexEntry),
+                         "loadHeaderIndex(): headerIndex");
+  if (headerIndex == NULL) {
+    goto loadDone;
+  }
+  while (headerIndexCount < fileHeader.entryCount) {
+    HeaderIndexEntry* entry = &headerIndex[headerIndexCount];
+    if (1 != fread(&fileEntry, sizeof(fileEntry), 1, fileHandle)
+        || fileEntry.filenameLength == 0
+        || fileEntry.filenameLength > OTA_MAX_FILENAME_LENGTH) {
+      break;
+    }
+    entry->filename = myMalloc(fileEntry.filenameLength + 1,
+                               "loadHeaderIndex(): filename");
+    if (entry->filename == NULL) {
+      break;
+    }
+    if (1 != fread(entry->filename, fileEntry.filenameLength, 1, fileHandle)
+        || 1 != fread(&entry->header, sizeof(EmberAfOtaHeader), 1, fileHandle)) {
+      myFree(entry->filename);
+      break;
+    }
+    entry->filename[fileEntry.filenameLength] = '\0';
+    entry->fileSize = fileEntry.fileSize;
+    entry->modifiedTime = fileEntry.modifiedTime;
+    headerIndexCount++;
+  }
+  if (headerIndexCount < fileHeader.entryCount) {
+    error("Header index is damaged, ignoring it.\n");
+    freeHeaderIndex();
+    goto loadDone;
+  }
+  qsort(headerIndex, headerIndexCount, sizeof(HeaderIndexEntry),
+        compareIndexEntries);
+  debug(config.fileDebug, "Loaded %d headers from index\n", headerIndexCount);
+
+ loadDone:
+  fclose(fileHandle);
+}
+
+static void freeHeaderIndex(void)
+{
+  while (headerIndexCount > 0) {
+    headerIndexCount--;
+    myFree(headerIndex[headerIndexCount].filename);
+  }
+  freeIfNotNull((void**)&headerIndex);
+}
+
+// Returns a copy of the indexed header for the file, or NULL if the file is
+// not in the index or has changed since.
+static EmberAfOtaHeader* findIndexedHeader(const char* filename,
+                                           const struct stat* statInfo)
+{
+  HeaderIndexEntry key;
+  HeaderIndexEntry* entry;
+  EmberAfOtaHeader* header;
+
+  if (headerIndex == NULL) {
+    return NULL;
+  }
+  key.filename = (char*)filename;
+  entry = bsearch(&key, headerIndex, headerIndexCount,
+                  sizeof(HeaderIndexEntry), compareIndexEntries);
+  if (entry == NULL
+      || entry->fileSize != (int32u)statInfo->st_size
+      || entry->modifiedTime != (int32u)statInfo->st_mtime) {
+    return NULL;
+  }
+  header = myMalloc(sizeof(EmberAfOtaHeader), "findIndexedHeader(): header");
+  if (header != NULL) {
+    MEMCOPY(header, &entry->header, sizeof(EmberAfOtaHeader));
+  }
+  return header;
+}
+
+// Writes the index of the images in the cache.  It is written to a temporary
+// file that then replaces the index, so that the index is never left half
+// written.
+static void saveHeaderIndex(void)
+{
+  HeaderIndexFileHeader fileHeader;
+  HeaderIndexFileEntry fileEntry;
+  OtaImage* image;
+  char* tempPath;
+  char* path;
+  FILE* fileHandle;
+  boolean written = TRUE;
+
+  if (!config.useHeaderIndex || !storageDeviceIsDirectory) {
+    return;
+  }
+  tempPath = storagePath(headerIndexTempFile);
+  path = storagePath(headerIndexFile);
+  if (tempPath == NULL || path == NULL) {
+    goto saveDone;
+  }
+  fileHandle = fopen(tempPath, "wb");
+  if (fileHandle == NULL) {
+    debug(config.fileDebug,
+          "Could not write header index '%s': %s\n",
+          tempPath,
+          strerror(errno));
+    goto saveDone;
+  }
+
+  fileHeader.magicNumber = HEADER_INDEX_MAGIC_NUMBER;
+  fileHeader.headerSize = sizeof(EmberAfOtaHeader);
+  fileHeader.entryCount = 0;
+  for (image = imageListFirst; image != NULL; image = (OtaImage*)image->next) {
+    fileHeader.entryCount++;
+  }
+  written = (1 == fwrite(&fileHeader, sizeof(fileHeader), 1, fileHandle));
+  for (image = imageListFirst;
+       written && image != NULL;
+       image = (OtaImage*)image->next) {
+    fileEntry.fileSize = image->fileSize;
+    fileEntry.modifiedTime = image->modifiedTime;
+    fileEntry.filenameLength = strlen(image->filenameStart);
+    written = (1 == fwrite(&fileEntry, sizeof(fileEntry), 1, fileHandle)
+               && 1 == fwrite(image->filenameStart,
+                              fileEntry.filenameLength,
+                              1,
+                              fileHandle)
+               && 1 == fwrite(image->header,
+                              sizeof(EmberAfOtaHeader),
+                              1,
+                              fileHandle));
+  }
+  if (0 != fclose(fileHandle)) {
+    written = FALSE;
+  }
+  if (!written || 0 != rename(tempPath, path)) {
+    error("Could not write header index '%s'\n", path);
+    remove(tempPath);
+  }
+
+ saveDone:
+  freeIfNotNull((void**)&tempPath);
+  freeIfNotNull((void**)&path);
+}
+
+//------------------------------------------------------------------------------
+// Directory watch
+//
+// On Linux the storage directory is watched with inotify once it has been
+// scanned.  Images written, moved into or removed from the directory are
+// added to or removed from the cache by emAfOtaStorageCheckDirectory(),
+// without scanning the rest of the directory.  The temporary file used for
+// downloads is left alone, as it is handled by the temporary data callbacks.
+
+#if defined(__linux__)
+
+static int watchFd = -1;
+
+#define WATCH_EVENTS \
+  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+
+static void watchDirectory(void)
+{
+  if (!config.watchDirectory || watchFd >= 0) {
+    return;
+  }
+  watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watchFd < 0) {
+    error("Could not watch storage directory: %s\n", strerror(errno));
+    return;
+  }
+  if (inotify_add_watch(watchFd, storageDevice, WATCH_EVENTS) < 0) {
+    error("Could not watch storage directory '%s': %s\n",
+          storageDevice,
+          strerror(errno));
+    stopWatchingDirectory();
+  }
+}
+
+static void stopWatchingDirectory(void)
+{
+  if (watchFd >= 0) {
+    close(watchFd);
+    watchFd = -1;
+  }
+}
+
+static void removeFileFromList(const char* filename)
+{
+  char* path = storagePath(filename);
+  OtaImage* image;
+  if (path == NULL) {
+    return;
+  }
+  image = findImageByFilename(path);
+  if (image != NULL) {
+    if (config.printFileDiscoveryOrRemoval) {
+      note("Image '%s' removed from storage list.\n", image->filenameStart);
+    }
+    removeImage(image);
+  }
+  myFree(path);
+}
+
+void emAfOtaStorageCheckDirectory(void)
+{
+  char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  boolean changed = FALSE;
+  ssize_t length;
+
+  if (watchFd < 0) {
+    return;
+  }
+  while (0 < (length = read(watchFd, buffer, sizeof(buffer)))) {
+    char* ptr = buffer;
+    while (ptr < buffer + length) {
+      const struct inotify_event* event = (const struct inotify_event*)ptr;
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Some changes were lost, so the whole directory is scanned again.
+        // The index makes this quick for the files that have not changed.
+        note("Storage directory changed too quickly, rescanning.\n");
+        saveHeaderIndex();
+        while (imageListFirst != NULL) {
+          removeImage(imageListFirst);
+        }
+        stopWatchingDirectory();
+        initImageDirectory();
+        return;
+      }
+      if (event->len == 0
+          || 0 == strcmp(event->name, tempStorageFile)
+          || 0 == strcmp(event->name, headerIndexFile)
+          || 0 == strcmp(event->name, headerIndexTempFile)) {
+        continue;
+      }
+
+      // A file that is rewritten is removed and added again.
+      removeFileFromList(event->name);
+      if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        considerFile(event->name);
+      }
+      changed = TRUE;
+    }
+  }
+  if (changed) {
+    saveHeaderIndex();
+  }
+}
+
+int emAfOtaStorageGetWatchFd(void)
+{
+  return watchFd;
+}
+
+#else
+
+static void watchDirectory(void)
+{
+}
+
+static void stopWatchingDirectory(void)
+{
+}
+
+void emAfOtaStorageCheckDirectory(void)
+{
+}
+
+int emAfOtaStorageGetWatchFd(void)
+{
+  return -1;
+}
+
+#endif
+
 static void freeIfNotNull(void** ptr)
 {
   if (*ptr != NULL) {
@@ -1118,6 +1630,7 @@ static void freeOtaImage(OtaImage* image)
   if (image == NULL) {
     return;
   }
+  closeImage(image);
   freeIfNotNull((void**)&(image->header));
   freeIfNotNull((void**)&(image->filepath));
   myFree(image);
@@ -1323,14 +1836,14 @@ static void unmapHeaderFieldDefinitions(void)
 
 static OtaImage* findImageById(const EmberAfOtaImageId* id)
 {
-  OtaImage* ptr = imageListFirst;
+  OtaImage* ptr = *imageBucket(id->manufacturerId, id->imageTypeId);
   while (ptr != NULL) {
     if (id->manufacturerId == ptr->header->manufacturerId
         && id->imageTypeId == ptr->header->imageTypeId
         && id->firmwareVersion == ptr->header->firmwareVersion) {
       return ptr;
     }
-    ptr = (OtaImage*)ptr->next;
+    ptr = (OtaImage*)ptr->hashNext;
   }
   return NULL;
 }
@@ -1394,7 +1907,7 @@ static int16u calculateOtaFileHeaderLength(EmberAfOtaHeader* header)
 
 static OtaImage* imageSearchInternal(const EmberAfOtaImageId* id)
 {
-  OtaImage* ptr = imageListFirst;
+  OtaImage* ptr = *imageBucket(id->manufacturerId, id->imageTypeId);
   OtaImage* newest = NULL;
   while (ptr != NULL) {
     /*
@@ -1436,7 +1949,7 @@ static OtaImage* imageSearchInternal(const EmberAfOtaImageId* id)
         }
       }
     }
-    ptr = (OtaImage*)ptr->next;
+    ptr = (OtaImage*)ptr->hashNext;
   }
   return newest;
 }
@@ -12,6 +12,6 @@ EmberAfStatus emAfPluginReportingConfigureReportedAttribute(const EmberAfCluster
                                                             int16u minInterval,
                                                             int16u maxInterval,
                                                             int32u reportableChange);
-void emAfPluginReportingGetEntry(int8u index, EmberAfPluginReportingEntry *result);
-void emAfPluginReportingSetEntry(int8u index, EmberAfPluginReportingEntry *value);
-EmberStatus emAfPluginReportingRemoveEntry(int8u index);
+void emAfPluginReportingGetEntry(int16u index, EmberAfPluginReportingEntry *result);
+void emAfPluginReportingSetEntry(int16u index, EmberAfPluginReportingEntry *value);
+EmberStatus emAfPluginReportingRemoveEntry(int16u index);
@@ -40,7 +40,9 @@ boolean emberAfScenesClusterCopySceneCallback(int8u mode,
 {
   EmberAfStatus status = EMBER_ZCL_STATUS_INVALID_FIELD;
   boolean copyAllScenes = (mode & ZCL_SCENES_CLUSTER_MODE_COPY_ALL_SCENES_MASK);
-  int8u i;
+  int8u sceneIds[32]; // one bit for each scene id to copy
+  int16u sceneId;
+  EmberAfPluginScenesServerIndex i;
 
   emberAfScenesClusterPrintln("RX: CopyScene 0x%x, 0x%2x, 0x%x, 0x%2x, 0x%x",
                               mode,
@@ -60,56 +62,70 @@ boolean emberAfScenesClusterCopySceneCallback(int8u mode,
     goto kickout;
   }
 
-  for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+  // The scenes to copy are picked out before any are copied, because adding
+  // entries to the table would upset a walk through the "from" group.
+  MEMSET(sceneIds, 0, sizeof(sceneIds));
+  if (copyAllScenes) {
+    i = emberAfPluginScenesServerFirstSceneInGroup(emberAfCurrentEndpoint(),
+                                                   groupIdFrom);
+    while (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+      EmberAfSceneTableEntry from;
+      emberAfPluginScenesServerRetrieveSceneEntry(from, i);
+      sceneIds[from.sceneId >> 3] |= BIT(from.sceneId & 0x07);
+      i = emberAfPluginScenesServerNextSceneInGroup(emberAfCurrentEndpoint(),
+                                                    groupIdFrom,
+                                                    i);
+    }
+  } else {
+    sceneIds[sceneIdFrom >> 3] |= BIT(sceneIdFrom & 0x07);
+  }
+
+  for (sceneId = 0; sceneId < 256; sceneId++) {
     EmberAfSceneTableEntry from;
+    EmberAfPluginScenesServerIndex index;
+    boolean newEntry = FALSE;
+
+    if (!(sceneIds[sceneId >> 3] & BIT(sceneId & 0x07))) {
+      continue;
+    }
+    i = emberAfPluginScenesServerFindScene(emberAfCurrentEndpoint(),
+                                           groupIdFrom,
+                                           (int8u)sceneId);
+    if (i == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+      continue;
+    }
     emberAfPluginScenesServerRetrieveSceneEntry(from, i);
-    if (from.endpoint == emberAfCurrentEndpoint()
-        && from.groupId == groupIdFrom
-        && (copyAllScenes || from.sceneId == sceneIdFrom)) {
-      int8u j, index = EMBER_AF_SCENE_TABLE_NULL_INDEX;
-      for (j = 0; j < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; j++) {
-        EmberAfSceneTableEntry to;
-        if (i == j) {
-          continue;
-        }
-        emberAfPluginScenesServerRetrieveSceneEntry(to, j);
-        if (to.endpoint == emberAfCurrentEndpoint()
-            && to.groupId == groupIdTo
-            && to.sceneId == (copyAllScenes ? from.sceneId : sceneIdTo)) {
-          index = j;
-          break;
-        } else if (index == EMBER_AF_SCENE_TABLE_NULL_INDEX
-                   && to.endpoint == EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID) {
-          index = j;
-        }
-      }
-
-      // If the target index is still zero, the table is full.
-      if (index == EMBER_AF_SCENE_TABLE_NULL_INDEX) {
-        status = EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
-        goto kickout;
-      }
-
-      // Save the "from" entry to the "to" index.  This makes a copy of "from"
-      // with the correct group and scene ids and leaves the original in tact.
-      from.groupId = groupIdTo;
-      if (!copyAllScenes) {
-        from.sceneId = sceneIdTo;
-      }
-      emberAfPluginScenesServerSaveSceneEntry(from, index);
-
-      if (j != index) {
-        emberAfPluginScenesServerIncrNumSceneEntriesInUse();
-        emberAfScenesSetSceneCountAttribute(emberAfCurrentEndpoint(),
-                                            emberAfPluginScenesServerNumSceneEntriesInUse());
-     }
-
-      // If we aren't copying all scenes, we can stop here.
-      status = EMBER_ZCL_STATUS_SUCCESS;
-      if (!copyAllScenes) {
-        goto kickout;
-      }
+
+    index = emberAfPluginScenesServerFindScene(emberAfCurrentEndpoint(),
+                                               groupIdTo,
+                                               (copyAllScenes
+                                                ? from.sceneId
+                                                : sceneIdTo));
+    if (index == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+      index = emberAfPluginScenesServerFindUnusedEntry();
+      newEntry = TRUE;
+    }
+
+    // If there is still no target index, the table is full.
+    if (index == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+      status = EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
+      goto kickout;
+    }
+
+    // Save the "from" entry to the "to" index.  This makes a copy of "from"
+    // with the correct group and scene ids and leaves the original in tact.
+    from.groupId = groupIdTo;
+    if (!copyAllScenes) {
+      from.sceneId = sceneIdTo;
+    }
+    emberAfPluginScenesServerSaveSceneEntry(from, index);
+
+    if (newEntry) {
+      emberAfPluginScenesServerIncrNumSceneEntriesInUse();
+      emberAfScenesSetSceneCountAttribute(emberAfCurrentEndpoint(),
+                                          emberAfPluginScenesServerNumSceneEntriesInUse());
     }
+    status = EMBER_ZCL_STATUS_SUCCESS;
   }
 
 kickout:
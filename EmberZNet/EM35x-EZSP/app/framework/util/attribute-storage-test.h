@@ -13,10 +13,18 @@
 // endpoints.
 #define ATTRIBUTE_MAX_SIZE 1000
 
+// Memory for the singleton attributes, which are shared by all endpoints.
+#define ATTRIBUTE_SINGLETONS_SIZE 2
+
 // Maximum number of allowed endpoints. Actual number of endpoints
 // is calculated at runtime.
 #define MAX_ENDPOINT_COUNT 10
 
+// Smaller than the default, so that lookups have to probe past collisions.
+// emAfAttributeIndexMatchesLinearSearch() checks the index against the
+// linear search.
+#define EMBER_AF_ATTRIBUTE_INDEX_SIZE 256
+
 // This is defined if we have attributes of more than 2 bytes
 #define GENERATED_DEFAULTS {  \
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 \
@@ -24,24 +32,36 @@
 
 // These are all the EmberAfAttributeMetadata objects that
 // this application supports on any cluster.
-#define GENERATED_ATTRIBUTES   {                         \
-    { 101, 1, 1, 0, { (int8u*)(generatedDefaults+0) } }, \
-    { 102, 1, 2, 0, { (int8u*)1 } },                     \
-    { 103, 1, 3, 0, { (int8u*)1 } },                     \
-    { 104, 1, 4, 0, { (int8u*)1 } },                     \
-    { 105, 1, 5, 0, { (int8u*)1 } }                      \
+#define GENERATED_ATTRIBUTES   {                                            \
+    { 101, 1, 1, 0, { (int8u*)(generatedDefaults+0) } },                    \
+    { 102, 1, 2, 0, { (int8u*)1 } },                                        \
+    { 103, 1, 3, 0, { (int8u*)(generatedDefaults+0) } },                    \
+    { 104, 1, 4, 0, { (int8u*)(generatedDefaults+0) } },                    \
+    { 105, 1, 5, 0, { (int8u*)(generatedDefaults+0) } },                    \
+    { 101, 1, 1, 0, { (int8u*)1 } },                                        \
+    { 101, 1, 1, 0, { (int8u*)1 } },                                        \
+    { 106, 1, 2, ATTRIBUTE_MASK_SINGLETON, { (int8u*)1 } },                 \
+    { 107, 1, 2, 0, { (int8u*)1 } },                                        \
+    { 107, 1, 2, ATTRIBUTE_MASK_EXTERNAL_STORAGE, { (int8u*)1 } }           \
   }
 
 // These are the EmberAfCluster structures that the application
 // supports. These clusters can be organized to any endpoints.
-#define GENERATED_CLUSTERS {                                               \
-    { 1, (EmberAfAttributeMetadata*)generatedAttributes, 5, 5*5, 0, NULL } \
+// The second cluster is manufacturer specific and the third, a client, has
+// two manufacturer specific attributes with the same id.
+#define GENERATED_CLUSTERS {                                                \
+    { 1, (EmberAfAttributeMetadata*)&(generatedAttributes[0]), 5, 15,      \
+      CLUSTER_MASK_SERVER, NULL },                                          \
+    { 0xFC01, (EmberAfAttributeMetadata*)&(generatedAttributes[5]), 1, 1,  \
+      CLUSTER_MASK_SERVER, NULL },                                          \
+    { 1, (EmberAfAttributeMetadata*)&(generatedAttributes[6]), 4, 3,       \
+      CLUSTER_MASK_CLIENT, NULL }                                           \
   }
 
 // These are the EmberAfEndpointType structs that the application supports.
 // Each endpoint can be one of these endpoint types.
 #define GENERATED_ENDPOINT_TYPES {              \
-    { (EmberAfCluster*)&generatedClusters, 1, 5*5 } \
+    { (EmberAfCluster*)&generatedClusters, 3, 19 } \
   }
 
 // These are the EmberAfNetwork structs that the application supports.
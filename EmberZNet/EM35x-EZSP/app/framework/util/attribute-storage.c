@@ -14,7 +14,7 @@
 // Globals
 // This is not declared CONST in order to handle dynamic endpoint information
 // retrieved from tokens.
-EmberAfDefinedEndpoint emAfEndpoints[MAX_ENDPOINT_COUNT];
+EmberAfDefinedEndpoint emAfEndpoints[EMBER_AF_ENDPOINT_TABLE_SIZE];
 
 #if ( ATTRIBUTE_MAX_SIZE == 0 )
 #define ACTUAL_ATTRIBUTE_SIZE 1
@@ -34,6 +34,12 @@ int8u singletonAttributeData[ACTUAL_SINGLETONS_SIZE];
 
 int8u emberEndpointCount = 0;
 
+// Where the attributes of each endpoint are stored, other than the singleton
+// and externally stored ones.  The endpoints configured at startup are laid
+// out one after another in attributeData[], and each dynamic endpoint has a
+// block from dynamicEndpointPool[].
+static int8u *endpointData[EMBER_AF_ENDPOINT_TABLE_SIZE];
+
 // If we have attributes that are more than 2 bytes, then
 // we need this data block for the defaults
 #ifdef GENERATED_DEFAULTS
@@ -62,14 +68,101 @@ const int16u clusterManufacturerCodeCount = GENERATED_CLUSTER_MANUFACTURER_CODE_
 const EmberAfManufacturerCodeEntry attributeManufacturerCodes[] = GENERATED_ATTRIBUTE_MANUFACTURER_CODES;
 const int16u attributeManufacturerCodeCount = GENERATED_ATTRIBUTE_MANUFACTURER_CODE_COUNT;
 
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+
+#if EMBER_AF_ENDPOINT_TABLE_SIZE > 255
+  #error "Too many endpoints: an endpoint index must fit in an int8u."
+#endif
+
+// The endpoints configured at startup come first in emAfEndpoints[], and the
+// dynamic endpoints follow them.
+static int8u staticEndpointCount;
+
+// The attribute storage for dynamic endpoints is allocated in fixed size
+// blocks.  The free blocks are kept on a stack.
+static int8u dynamicEndpointPool[EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT]
+                                [EMBER_AF_DYNAMIC_ENDPOINT_DATA_SIZE];
+static int8u *freeDynamicEndpointData[EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT];
+static int8u freeDynamicEndpointDataCount;
+
+// The index in emAfEndpoints[] of each endpoint number, or 0xFF.  If two
+// endpoints have the same number this is the first.
+static int8u endpointIndexMap[256];
+
+// The value of findClusterEndpointIndex() for each cluster of each endpoint
+// configured at startup.  Those of endpoint index i start at
+// clusterEndpointIndexes[clusterEndpointIndexStart[i]], in the order of the
+// clusters in its endpoint type.  An endpoint type is a range of
+// generatedClusters[], so it has no more clusters than that.
+#define GENERATED_CLUSTER_COUNT \
+  (sizeof(generatedClusters) / sizeof(generatedClusters[0]))
+static int8u clusterEndpointIndexes[MAX_ENDPOINT_COUNT * GENERATED_CLUSTER_COUNT];
+static int16u clusterEndpointIndexStart[MAX_ENDPOINT_COUNT];
+
+// Device enabled state, by endpoint index, from util.c.
+extern boolean afDeviceEnabled[];
+
+#endif // EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+
 //------------------------------------------------------------------------------
 // Forward declarations
 
 // Returns endpoint index within a given cluster
 static int8u findClusterEndpointIndex(int8u endpoint, EmberAfClusterId clusterId, int8u mask);
 
+static EmberAfCluster *emberAfFindClusterInType(EmberAfEndpointType *endpointType,
+                                                EmberAfClusterId clusterId,
+                                                int8u mask);
+static void initializeEndpoint(EmberAfDefinedEndpoint* definedEndpoint);
+
 //------------------------------------------------------------------------------
 
+// Attribute locations handed out by emAfLocateAttribute() are good until the
+// endpoints change, which bumps this.
+static int16u attributeLocationVersion = 0;
+
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+static void mapEndpointIndexes(void)
+{
+  int8u ep = emberEndpointCount;
+  MEMSET(endpointIndexMap, 0xFF, sizeof(endpointIndexMap));
+  while (ep-- > 0) {
+    endpointIndexMap[emAfEndpoints[ep].endpoint] = ep;
+  }
+}
+
+// Counts, for each cluster of each endpoint, the endpoints before it that
+// have the same cluster on the same side.
+static void setClusterEndpointIndexes(void)
+{
+  int8u ep;
+  int16u next = 0;
+  for (ep = 0; ep < staticEndpointCount; ep++) {
+    EmberAfEndpointType *endpointType = emAfEndpoints[ep].endpointType;
+    int8u clusterIndex;
+    clusterEndpointIndexStart[ep] = next;
+    for (clusterIndex = 0;
+         clusterIndex < endpointType->clusterCount;
+         clusterIndex++) {
+      EmberAfCluster *cluster = &(endpointType->cluster[clusterIndex]);
+      int8u mask = (emberAfClusterIsClient(cluster)
+                    ? CLUSTER_MASK_CLIENT
+                    : CLUSTER_MASK_SERVER);
+      int8u count = 0;
+      int8u prior;
+      for (prior = 0; prior < ep; prior++) {
+        if (emberAfFindClusterInType(emAfEndpoints[prior].endpointType,
+                                     cluster->clusterId,
+                                     mask) != NULL) {
+          count++;
+        }
+      }
+      clusterEndpointIndexes[next++] = count;
+    }
+  }
+}
+#endif // EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+
 // Initial configuration
 void emberAfEndpointConfigure(void) {
   int8u ep;
@@ -107,6 +200,26 @@ void emberAfEndpointConfigure(void) {
     }
   }
 #endif // FIXED_ENDPOINT_COUNT
+
+  {
+    int16u offset = 0;
+    for (ep = 0; ep < emberEndpointCount; ep++) {
+      endpointData[ep] = attributeData + offset;
+      offset += emAfEndpoints[ep].endpointType->endpointSize;
+    }
+  }
+
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+  staticEndpointCount = emberEndpointCount;
+  for (ep = 0; ep < EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT; ep++) {
+    freeDynamicEndpointData[ep] = dynamicEndpointPool[ep];
+  }
+  freeDynamicEndpointDataCount = EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT;
+  mapEndpointIndexes();
+  setClusterEndpointIndexes();
+#endif
+
+  emAfBuildAttributeIndex();
 }
 
 int8u emberAfEndpointCount() 
@@ -402,36 +515,18 @@ boolean emAfMatchAttribute(EmberAfCluster *cluster,
                   == attRecord->manufacturerCode)));
 }
 
-// The callbacks to read and write externals have the same signature, so it is
-// easy to use function pointers to call the right one.  This typedef covers
-// both and makes the code a bit easier to read.
-typedef EmberAfStatus (*ExternalReadWriteCallback)(int8u, EmberAfClusterId, EmberAfAttributeMetadata *, int16u, int8u *);
-
-// When reading non-string attributes, this function returns an error when destination
-// buffer isn't large enough to accommodate the attribute type.  For strings, the
-// function will copy at most readLength bytes.  This means the resulting string
-// may be truncated.  The length byte(s) in the resulting string will reflect
-// any truncation.  If readLength is zero, we are working with backwards-
-// compatibility wrapper functions and we just cross our fingers and hope for
-// the best.
-//
-// When writing attributes, readLength is ignored.  For non-string attributes,
-// this function assumes the source buffer is the same size as the attribute
-// type.  For strings, the function will copy as many bytes as will fit in the
-// attribute.  This means the resulting string may be truncated.  The length
-// byte(s) in the resulting string will reflect any truncated.
-EmberAfStatus emAfReadOrWriteAttribute(EmberAfAttributeSearchRecord *attRecord,
-                                       EmberAfAttributeMetadata **metadata,
-                                       int8u *buffer,
-                                       int16u readLength,
-                                       boolean write)
+// Finds an attribute by searching every endpoint, cluster and attribute in
+// turn.  Returns the metadata, or NULL if it is not found, and sets location
+// to where the attribute is stored.
+static EmberAfAttributeMetadata *findAttributeLinear(EmberAfAttributeSearchRecord *attRecord,
+                                                     int8u **location)
 {
   int8u i;
-  int16u attributeOffsetIndex = 0;
 
   for (i = 0; i < emberAfEndpointCount(); i++) {
     if (emAfEndpoints[i].endpoint == attRecord->endpoint) {
       EmberAfEndpointType *endpointType = emAfEndpoints[i].endpointType;
+      int16u attributeOffsetIndex = 0;
       int8u clusterIndex;
       if (!emberAfEndpointIndexIsEnabled(i)) {
         continue;
@@ -449,44 +544,10 @@ EmberAfStatus emAfReadOrWriteAttribute(EmberAfAttributeSearchRecord *attRecord,
             if (emAfMatchAttribute(cluster,
                                    am,
                                    attRecord)) { // Got the attribute
-
-              // If passed metadata location is not null, populate
-              if (metadata != NULL) {
-                *metadata = am;
-              }
-
-              {
-                int8u *attributeLocation = (am->mask & ATTRIBUTE_MASK_SINGLETON
-                                            ? singletonAttributeLocation(am)
-                                            : attributeData + attributeOffsetIndex);
-                int8u *src, *dst;
-                ExternalReadWriteCallback callback;
-                if (write) {
-                  src = buffer;
-                  dst = attributeLocation;
-                  callback = &emberAfExternalAttributeWriteCallback;
-                } else {
-                  if (buffer == NULL) {
-                    return EMBER_ZCL_STATUS_SUCCESS;
-                  }
-
-                  src = attributeLocation;
-                  dst = buffer;
-                  callback = &emberAfExternalAttributeReadCallback;
-                }
-
-                return (am->mask & ATTRIBUTE_MASK_EXTERNAL_STORAGE
-                        ? (*callback)(attRecord->endpoint,
-                                      attRecord->clusterId,
-                                      am,
-                                      emAfGetManufacturerCodeForAttribute(cluster, am),
-                                      buffer)
-                        : typeSensitiveMemCopy(dst,
-                                               src,
-                                               am,
-                                               write,
-                                               readLength));
-              }
+              *location = (am->mask & ATTRIBUTE_MASK_SINGLETON
+                           ? singletonAttributeLocation(am)
+                           : endpointData[i] + attributeOffsetIndex);
+              return am;
             } else { // Not the attribute we are looking for
               // Increase the index if attribute is not externally stored
               if (!(am->mask & ATTRIBUTE_MASK_EXTERNAL_STORAGE)
@@ -499,11 +560,371 @@ EmberAfStatus emAfReadOrWriteAttribute(EmberAfAttributeSearchRecord *attRecord,
           attributeOffsetIndex += cluster->clusterSize;
         }
       }
-    } else { // Not the endpoint we are looking for
-      attributeOffsetIndex += emAfEndpoints[i].endpointType->endpointSize;
     }
   }
-  return EMBER_ZCL_STATUS_UNSUPPORTED_ATTRIBUTE; // Sorry, attribute was not found.
+  *location = NULL;
+  return NULL;
+}
+
+#if EMBER_AF_ATTRIBUTE_INDEX_SIZE > 0
+
+#if (EMBER_AF_ATTRIBUTE_INDEX_SIZE & (EMBER_AF_ATTRIBUTE_INDEX_SIZE - 1)) != 0
+  #error "EMBER_AF_ATTRIBUTE_INDEX_SIZE must be a power of two."
+#endif
+
+// The index is an open addressed hash table with linear probing.  Each entry
+// holds the complete key, so that a lookup never has to touch the endpoint or
+// cluster tables, together with the metadata and the offset of the attribute
+// in the endpoint's data, or in singletonAttributeData[] for a singleton.  An
+// unused entry has NULL metadata.
+typedef struct {
+  EmberAfAttributeMetadata *metadata;
+  int16u offset;
+  EmberAfClusterId clusterId;
+  EmberAfAttributeId attributeId;
+  int16u manufacturerCode;
+  int8u endpointIndex;  // into emAfEndpoints[]
+  int8u clusterMask;    // CLUSTER_MASK_CLIENT or CLUSTER_MASK_SERVER
+} AttributeIndexEntry;
+
+// Probes stay short if the table is no more than three quarters full, which
+// also guarantees that every probe sequence ends at an unused entry.
+#define ATTRIBUTE_INDEX_MAX_ENTRIES \
+  (EMBER_AF_ATTRIBUTE_INDEX_SIZE - EMBER_AF_ATTRIBUTE_INDEX_SIZE / 4)
+
+static AttributeIndexEntry attributeIndex[EMBER_AF_ATTRIBUTE_INDEX_SIZE];
+static int16u attributeIndexCount = 0;
+static boolean attributeIndexValid = FALSE;
+
+static int16u attributeIndexHash(int8u endpoint,
+                                 EmberAfClusterId clusterId,
+                                 EmberAfAttributeId attributeId,
+                                 int16u manufacturerCode,
+                                 int8u clusterMask)
+{
+  int32u hash = (((int32u)clusterId << 16) | attributeId) * 0x9E3779B1UL;
+  hash ^= (((int32u)manufacturerCode << 16) | ((int16u)endpoint << 8) | clusterMask)
+          * 0x85EBCA6BUL;
+  hash ^= hash >> 15;
+  return (int16u)(hash & (EMBER_AF_ATTRIBUTE_INDEX_SIZE - 1));
+}
+
+// Adds an attribute to the index under one cluster direction.  If an entry
+// with the same key is already present it is kept, since the linear search
+// would find that one first.  Returns FALSE if the index is full.
+static boolean addIndexEntry(int8u endpointIndex,
+                             EmberAfCluster *cluster,
+                             EmberAfAttributeMetadata *am,
+                             int8u clusterMask,
+                             int16u offset)
+{
+  int8u endpoint = emAfEndpoints[endpointIndex].endpoint;
+  int16u manufacturerCode = emAfGetManufacturerCodeForAttribute(cluster, am);
+  int16u i = attributeIndexHash(endpoint,
+                                cluster->clusterId,
+                                am->attributeId,
+                                manufacturerCode,
+                                clusterMask);
+  AttributeIndexEntry *entry;
+
+  for (entry = &attributeIndex[i];
+       entry->metadata != NULL;
+       i = (i + 1) & (EMBER_AF_ATTRIBUTE_INDEX_SIZE - 1),
+         entry = &attributeIndex[i]) {
+    if (entry->attributeId == am->attributeId
+        && entry->clusterId == cluster->clusterId
+        && entry->manufacturerCode == manufacturerCode
+        && entry->clusterMask == clusterMask
+        && emAfEndpoints[entry->endpointIndex].endpoint == endpoint) {
+      return TRUE;
+    }
+  }
+  if (attributeIndexCount == ATTRIBUTE_INDEX_MAX_ENTRIES) {
+    return FALSE;
+  }
+  attributeIndexCount++;
+  entry->metadata = am;
+  entry->offset = offset;
+  entry->clusterId = cluster->clusterId;
+  entry->attributeId = am->attributeId;
+  entry->manufacturerCode = manufacturerCode;
+  entry->endpointIndex = endpointIndex;
+  entry->clusterMask = clusterMask;
+  return TRUE;
+}
+
+// Adds the attributes of one endpoint to the index.  The offsets follow the
+// storage layout that the linear search assumes: clusters, then attributes,
+// each in order, with external and singleton attributes taking no space.
+// Returns FALSE if the index is full.
+static boolean indexEndpointAttributes(int8u ep)
+{
+  EmberAfEndpointType *endpointType = emAfEndpoints[ep].endpointType;
+  int16u clusterOffset = 0;
+  int8u clusterIndex;
+  for (clusterIndex = 0;
+       clusterIndex < endpointType->clusterCount;
+       clusterIndex++) {
+    EmberAfCluster *cluster = &(endpointType->cluster[clusterIndex]);
+    int16u attributeOffset = clusterOffset;
+    int16u attrIndex;
+    for (attrIndex = 0; attrIndex < cluster->attributeCount; attrIndex++) {
+      EmberAfAttributeMetadata *am = &(cluster->attributes[attrIndex]);
+      int16u offset = attributeOffset;
+      if (am->mask & ATTRIBUTE_MASK_SINGLETON) {
+        offset = singletonAttributeLocation(am) - singletonAttributeData;
+      } else if (!(am->mask & ATTRIBUTE_MASK_EXTERNAL_STORAGE)) {
+        attributeOffset += emberAfAttributeSize(am);
+      }
+      if (((cluster->mask & CLUSTER_MASK_CLIENT)
+           && !addIndexEntry(ep, cluster, am, CLUSTER_MASK_CLIENT, offset))
+          || ((cluster->mask & CLUSTER_MASK_SERVER)
+              && !addIndexEntry(ep, cluster, am, CLUSTER_MASK_SERVER, offset))) {
+        return FALSE;
+      }
+    }
+    clusterOffset += cluster->clusterSize;
+  }
+  return TRUE;
+}
+
+void emAfBuildAttributeIndex(void)
+{
+  int8u ep;
+
+  attributeLocationVersion++;
+  MEMSET(attributeIndex, 0, sizeof(attributeIndex));
+  attributeIndexCount = 0;
+  attributeIndexValid = FALSE;
+
+  for (ep = 0; ep < emberAfEndpointCount(); ep++) {
+    if (!indexEndpointAttributes(ep)) {
+      return;
+    }
+  }
+  attributeIndexValid = TRUE;
+}
+
+// Finds an attribute with the index, which covers searches for either
+// clients or servers.  Anything else is left to the linear search, as is an
+// attribute on a disabled endpoint, which the search skips in favor of any
+// later endpoint with the same number.
+static EmberAfAttributeMetadata *findAttribute(EmberAfAttributeSearchRecord *attRecord,
+                                               int8u **location)
+{
+  int16u i;
+  AttributeIndexEntry *entry;
+
+  if (!attributeIndexValid
+      || (attRecord->clusterMask != CLUSTER_MASK_CLIENT
+          && attRecord->clusterMask != CLUSTER_MASK_SERVER)) {
+    return findAttributeLinear(attRecord, location);
+  }
+
+  i = attributeIndexHash(attRecord->endpoint,
+                         attRecord->clusterId,
+                         attRecord->attributeId,
+                         attRecord->manufacturerCode,
+                         attRecord->clusterMask);
+  for (entry = &attributeIndex[i];
+       entry->metadata != NULL;
+       i = (i + 1) & (EMBER_AF_ATTRIBUTE_INDEX_SIZE - 1),
+         entry = &attributeIndex[i]) {
+    if (entry->attributeId == attRecord->attributeId
+        && entry->clusterId == attRecord->clusterId
+        && entry->manufacturerCode == attRecord->manufacturerCode
+        && entry->clusterMask == attRecord->clusterMask
+        && emAfEndpoints[entry->endpointIndex].endpoint == attRecord->endpoint) {
+      if (!emberAfEndpointIndexIsEnabled(entry->endpointIndex)) {
+        return findAttributeLinear(attRecord, location);
+      }
+      *location = (entry->metadata->mask & ATTRIBUTE_MASK_SINGLETON
+                   ? singletonAttributeData + entry->offset
+                   : endpointData[entry->endpointIndex] + entry->offset);
+      return entry->metadata;
+    }
+  }
+  *location = NULL;
+  return NULL;
+}
+
+#else // EMBER_AF_ATTRIBUTE_INDEX_SIZE == 0
+
+void emAfBuildAttributeIndex(void)
+{
+  attributeLocationVersion++;
+}
+
+#define findAttribute(attRecord, location) \
+  findAttributeLinear((attRecord), (location))
+
+#endif // EMBER_AF_ATTRIBUTE_INDEX_SIZE > 0
+
+#if defined(EMBER_TEST) || defined(EMBER_AF_ATTRIBUTE_INDEX_TEST)
+static boolean lookupsMatch(EmberAfAttributeSearchRecord *attRecord)
+{
+  int8u *indexLocation, *linearLocation;
+  EmberAfAttributeMetadata *indexMetadata, *linearMetadata;
+  indexMetadata = findAttribute(attRecord, &indexLocation);
+  linearMetadata = findAttributeLinear(attRecord, &linearLocation);
+  return (indexMetadata == linearMetadata
+          && (linearMetadata == NULL
+              || (linearMetadata->mask & ATTRIBUTE_MASK_EXTERNAL_STORAGE)
+              || indexLocation == linearLocation));
+}
+
+boolean emAfAttributeIndexMatchesLinearSearch(void)
+{
+  static const int8u masks[] = {
+    CLUSTER_MASK_CLIENT,
+    CLUSTER_MASK_SERVER,
+    CLUSTER_MASK_CLIENT | CLUSTER_MASK_SERVER,
+  };
+  int8u ep;
+  for (ep = 0; ep < emberAfEndpointCount(); ep++) {
+    EmberAfEndpointType *endpointType = emAfEndpoints[ep].endpointType;
+    int8u clusterIndex;
+    for (clusterIndex = 0;
+         clusterIndex < endpointType->clusterCount;
+         clusterIndex++) {
+      EmberAfCluster *cluster = &(endpointType->cluster[clusterIndex]);
+      int16u attrIndex;
+      for (attrIndex = 0; attrIndex < cluster->attributeCount; attrIndex++) {
+        EmberAfAttributeMetadata *am = &(cluster->attributes[attrIndex]);
+        EmberAfAttributeSearchRecord record;
+        int8u m;
+        record.endpoint = emAfEndpoints[ep].endpoint;
+        record.clusterId = cluster->clusterId;
+        record.attributeId = am->attributeId;
+        for (m = 0; m < sizeof(masks); m++) {
+          record.clusterMask = masks[m];
+          // The right manufacturer code, no code, and a wrong one.
+          record.manufacturerCode
+            = emAfGetManufacturerCodeForAttribute(cluster, am);
+          if (!lookupsMatch(&record)) {
+            return FALSE;
+          }
+          record.manufacturerCode = EMBER_AF_NULL_MANUFACTURER_CODE;
+          if (!lookupsMatch(&record)) {
+            return FALSE;
+          }
+          record.manufacturerCode = 0xFFFF;
+          if (!lookupsMatch(&record)) {
+            return FALSE;
+          }
+        }
+        // Attributes and endpoints that do not exist.
+        record.clusterMask = CLUSTER_MASK_SERVER;
+        record.manufacturerCode = EMBER_AF_NULL_MANUFACTURER_CODE;
+        record.attributeId = am->attributeId + 0x8000;
+        if (!lookupsMatch(&record)) {
+          return FALSE;
+        }
+        record.attributeId = am->attributeId;
+        record.endpoint = 0xFF;
+        if (!lookupsMatch(&record)) {
+          return FALSE;
+        }
+      }
+    }
+  }
+  return TRUE;
+}
+#endif // EMBER_TEST || EMBER_AF_ATTRIBUTE_INDEX_TEST
+
+// The callbacks to read and write externals have the same signature, so it is
+// easy to use function pointers to call the right one.  This typedef covers
+// both and makes the code a bit easier to read.
+typedef EmberAfStatus (*ExternalReadWriteCallback)(int8u, EmberAfClusterId, EmberAfAttributeMetadata *, int16u, int8u *);
+
+// When reading non-string attributes, this function returns an error when destination
+// buffer isn't large enough to accommodate the attribute type.  For strings, the
+// function will copy at most readLength bytes.  This means the resulting string
+// may be truncated.  The length byte(s) in the resulting string will reflect
+// any truncation.  If readLength is zero, we are working with backwards-
+// compatibility wrapper functions and we just cross our fingers and hope for
+// the best.
+//
+// When writing attributes, readLength is ignored.  For non-string attributes,
+// this function assumes the source buffer is the same size as the attribute
+// type.  For strings, the function will copy as many bytes as will fit in the
+// attribute.  This means the resulting string may be truncated.  The length
+// byte(s) in the resulting string will reflect any truncated.
+EmberAfStatus emAfReadOrWriteAttribute(EmberAfAttributeSearchRecord *attRecord,
+                                       EmberAfAttributeMetadata **metadata,
+                                       int8u *buffer,
+                                       int16u readLength,
+                                       boolean write)
+{
+  EmAfAttributeLocation location;
+  emAfLocateAttribute(attRecord, &location);
+
+  // If passed metadata location is not null, populate
+  if (metadata != NULL && location.metadata != NULL) {
+    *metadata = location.metadata;
+  }
+
+  return emAfReadOrWriteLocatedAttribute(attRecord,
+                                         &location,
+                                         buffer,
+                                         readLength,
+                                         write);
+}
+
+void emAfLocateAttribute(EmberAfAttributeSearchRecord *attRecord,
+                         EmAfAttributeLocation *location)
+{
+  location->metadata = findAttribute(attRecord, &location->data);
+}
+
+EmberAfStatus emAfReadOrWriteLocatedAttribute(EmberAfAttributeSearchRecord *attRecord,
+                                              const EmAfAttributeLocation *location,
+                                              int8u *buffer,
+                                              int16u readLength,
+                                              boolean write)
+{
+  EmberAfAttributeMetadata *am = location->metadata;
+
+  if (am == NULL) {
+    return EMBER_ZCL_STATUS_UNSUPPORTED_ATTRIBUTE; // Sorry, attribute was not found.
+  }
+
+  {
+    int8u *src, *dst;
+    ExternalReadWriteCallback callback;
+    if (write) {
+      src = buffer;
+      dst = location->data;
+      callback = &emberAfExternalAttributeWriteCallback;
+    } else {
+      if (buffer == NULL) {
+        return EMBER_ZCL_STATUS_SUCCESS;
+      }
+
+      src = location->data;
+      dst = buffer;
+      callback = &emberAfExternalAttributeReadCallback;
+    }
+
+    // A matching attribute always has the manufacturer code that was sought,
+    // as given by emAfGetManufacturerCodeForAttribute().
+    return (am->mask & ATTRIBUTE_MASK_EXTERNAL_STORAGE
+            ? (*callback)(attRecord->endpoint,
+                          attRecord->clusterId,
+                          am,
+                          attRecord->manufacturerCode,
+                          buffer)
+            : typeSensitiveMemCopy(dst,
+                                   src,
+                                   am,
+                                   write,
+                                   readLength));
+  }
+}
+
+int16u emAfAttributeLocationVersion(void)
+{
+  return attributeLocationVersion;
 }
 
 // mask = 0 -> find either client or server
@@ -579,6 +1000,27 @@ int8u emberAfFindClusterClientEndpointIndex(int8u endpoint, EmberAfClusterId clu
 }
 
 // Returns the endpoint index within a given cluster
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+// Per cluster state is kept in arrays sized for the endpoints configured at
+// startup, so a dynamic endpoint has no index.
+static int8u findClusterEndpointIndex(int8u endpoint, EmberAfClusterId clusterId, int8u mask)
+{
+  int8u ep = emAfStaticIndexFromEndpoint(endpoint);
+  EmberAfCluster *cluster;
+
+  if (ep == 0xFF) {
+    return 0xFF;
+  }
+  cluster = emberAfFindClusterInType(emAfEndpoints[ep].endpointType,
+                                     clusterId,
+                                     mask);
+  if (cluster == NULL) {
+    return 0xFF;
+  }
+  return clusterEndpointIndexes[clusterEndpointIndexStart[ep]
+                                + (cluster - emAfEndpoints[ep].endpointType->cluster)];
+}
+#else
 static int8u findClusterEndpointIndex(int8u endpoint, EmberAfClusterId clusterId, int8u mask)
 {
   int8u i, epi = 0;
@@ -596,11 +1038,24 @@ static int8u findClusterEndpointIndex(int8u endpoint, EmberAfClusterId clusterId
 
   return epi;
 }
+#endif // EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
 
 static int8u findIndexFromEndpoint(int8u endpoint, boolean ignoreDisabledEndpoints)
 {
   int8u epi;
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+  epi = endpointIndexMap[endpoint];
+  if (epi == 0xFF
+      || !ignoreDisabledEndpoints
+      || emAfEndpoints[epi].bitmask & EMBER_AF_ENDPOINT_ENABLED) {
+    return epi;
+  }
+  // The first endpoint with this number is disabled, but a later one with
+  // the same number may not be.
+  for (epi++; epi < emberAfEndpointCount(); epi++) {
+#else
   for (epi = 0; epi < emberAfEndpointCount(); epi++) {
+#endif
     if (emAfEndpoints[epi].endpoint == endpoint
         && (!ignoreDisabledEndpoints 
             || emAfEndpoints[epi].bitmask & EMBER_AF_ENDPOINT_ENABLED)) {
@@ -650,6 +1105,8 @@ boolean emberAfEndpointEnableDisable(int8u endpoint, boolean enable)
 #endif
 
   if (currentlyEnabled ^ enable) {
+    // Searches skip disabled endpoints.
+    attributeLocationVersion++;
     if (enable) {
       initializeEndpoint(&(emAfEndpoints[index]));
     } else {
@@ -676,6 +1133,176 @@ boolean emberAfEndpointEnableDisable(int8u endpoint, boolean enable)
   return TRUE;
 }
 
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+EmberStatus emAfAddDynamicEndpoint(int8u endpoint,
+                                   EmberAfEndpointType *endpointType,
+                                   EmberAfProfileId profileId,
+                                   int16u deviceId,
+                                   int8u deviceVersion,
+                                   int8u networkIndex)
+{
+  int8u index = emberEndpointCount;
+  EmberAfDefinedEndpoint *de = &(emAfEndpoints[index]);
+
+  if (endpoint == 0
+      || endpoint == EMBER_BROADCAST_ENDPOINT
+      || endpointIndexMap[endpoint] != 0xFF) {
+    return EMBER_INVALID_ENDPOINT;
+  }
+  if (endpointType->endpointSize > EMBER_AF_DYNAMIC_ENDPOINT_DATA_SIZE) {
+    return EMBER_BAD_ARGUMENT;
+  }
+  if (index == EMBER_AF_ENDPOINT_TABLE_SIZE
+      || freeDynamicEndpointDataCount == 0) {
+    return EMBER_TABLE_FULL;
+  }
+
+  de->endpoint      = endpoint;
+  de->profileId     = profileId;
+  de->deviceId      = deviceId;
+  de->deviceVersion = deviceVersion;
+  de->endpointType  = endpointType;
+  de->networkIndex  = networkIndex;
+  de->bitmask       = EMBER_AF_ENDPOINT_ENABLED;
+  freeDynamicEndpointDataCount--;
+  endpointData[index] = freeDynamicEndpointData[freeDynamicEndpointDataCount];
+  afDeviceEnabled[index] = TRUE;
+  endpointIndexMap[endpoint] = index;
+  emberEndpointCount++;
+  attributeLocationVersion++;
+
+#if EMBER_AF_ATTRIBUTE_INDEX_SIZE > 0
+  if (attributeIndexValid && !indexEndpointAttributes(index)) {
+    attributeIndexValid = FALSE;
+  }
+#endif
+
+  emberAfLoadAttributesFromDefaults(endpoint);
+  initializeEndpoint(de);
+  return EMBER_SUCCESS;
+}
+
+boolean emAfIsDynamicEndpoint(int8u endpoint)
+{
+  int8u index = findIndexFromEndpoint(endpoint,
+                                      FALSE);    // ignore disabled endpoints?
+  return (index != 0xFF && index >= staticEndpointCount);
+}
+
+// Removal closes the gap in emAfEndpoints[], which changes the index of any
+// later dynamic endpoints, so the index tables are rebuilt.
+EmberStatus emAfRemoveDynamicEndpoint(int8u endpoint)
+{
+  int8u index = findIndexFromEndpoint(endpoint,
+                                      FALSE);    // ignore disabled endpoints?
+  int8u i;
+
+  if (!emAfIsDynamicEndpoint(endpoint)) {
+    return EMBER_INVALID_ENDPOINT;
+  }
+
+  emberAfEndpointEnableDisable(endpoint, FALSE);
+
+  freeDynamicEndpointData[freeDynamicEndpointDataCount] = endpointData[index];
+  freeDynamicEndpointDataCount++;
+  for (i = index + 1; i < emberEndpointCount; i++) {
+    emAfEndpoints[i - 1] = emAfEndpoints[i];
+    endpointData[i - 1] = endpointData[i];
+    afDeviceEnabled[i - 1] = afDeviceEnabled[i];
+  }
+  emberEndpointCount--;
+
+  mapEndpointIndexes();
+  emAfBuildAttributeIndex();
+  return EMBER_SUCCESS;
+}
+
+// What the NCP was given for an endpoint: its profile, device id and version
+// and its server clusters followed by its client clusters.
+typedef struct {
+  int8u endpoint;
+  EmberAfProfileId profileId;
+  int16u deviceId;
+  int8u deviceVersion;
+  int8u inClusterCount;
+  int8u outClusterCount;
+  int16u clusterList[EMBER_AF_NCP_ENDPOINT_MAX_CLUSTER];
+} NcpEndpoint;
+
+// The dynamic endpoints created on the NCP since it was last reset.  The NCP
+// cannot remove an endpoint, so these include removed ones.
+static NcpEndpoint ncpEndpoints[EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT];
+static int8u ncpEndpointCount = 0;
+
+static void describeNcpEndpoint(int8u endpoint, NcpEndpoint *ncpEndpoint)
+{
+  int8u index = emberAfIndexFromEndpoint(endpoint);
+  MEMSET(ncpEndpoint, 0, sizeof(NcpEndpoint));
+  ncpEndpoint->endpoint = endpoint;
+  ncpEndpoint->profileId = emberAfProfileIdFromIndex(index);
+  ncpEndpoint->deviceId = emberAfDeviceIdFromIndex(index);
+  ncpEndpoint->deviceVersion = emberAfDeviceVersionFromIndex(index);
+  ncpEndpoint->inClusterCount
+    = emberAfGetClustersFromEndpoint(endpoint,
+                                     ncpEndpoint->clusterList,
+                                     EMBER_AF_NCP_ENDPOINT_MAX_CLUSTER,
+                                     TRUE);  // server?
+  ncpEndpoint->outClusterCount
+    = emberAfGetClustersFromEndpoint(endpoint,
+                                     (ncpEndpoint->clusterList
+                                      + ncpEndpoint->inClusterCount),
+                                     (EMBER_AF_NCP_ENDPOINT_MAX_CLUSTER
+                                      - ncpEndpoint->inClusterCount),
+                                     FALSE); // server?
+}
+
+static NcpEndpoint *findNcpEndpoint(int8u endpoint)
+{
+  int8u i;
+  for (i = 0; i < ncpEndpointCount; i++) {
+    if (ncpEndpoints[i].endpoint == endpoint) {
+      return &ncpEndpoints[i];
+    }
+  }
+  return NULL;
+}
+
+void emAfClearNcpEndpoints(void)
+{
+  ncpEndpointCount = 0;
+}
+
+EmberStatus emAfCheckNcpEndpoint(int8u endpoint, boolean *onNcp)
+{
+  NcpEndpoint *created = findNcpEndpoint(endpoint);
+  NcpEndpoint current;
+
+  *onNcp = (created != NULL);
+  if (created == NULL) {
+    return (ncpEndpointCount < EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT
+            ? EMBER_SUCCESS
+            : EMBER_TABLE_FULL);
+  }
+  describeNcpEndpoint(endpoint, &current);
+  return (MEMCOMPARE(created, &current, sizeof(NcpEndpoint)) == 0
+          ? EMBER_SUCCESS
+          : EMBER_INVALID_CALL);
+}
+
+void emAfNcpEndpointCreated(int8u endpoint)
+{
+  NcpEndpoint *created = findNcpEndpoint(endpoint);
+  if (created == NULL) {
+    if (ncpEndpointCount == EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT) {
+      return;
+    }
+    created = &ncpEndpoints[ncpEndpointCount];
+    ncpEndpointCount++;
+  }
+  describeNcpEndpoint(endpoint, created);
+}
+#endif // EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+
 // Returns the index of a given endpoint.  Does not consider disabled endpoints.
 int8u emberAfIndexFromEndpoint(int8u endpoint) 
 {
@@ -683,6 +1310,19 @@ int8u emberAfIndexFromEndpoint(int8u endpoint)
                                TRUE);    // ignore disabled endpoints?
 }
 
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+int8u emAfStaticIndexFromEndpoint(int8u endpoint)
+{
+  int8u index = emberAfIndexFromEndpoint(endpoint);
+  return (index < staticEndpointCount ? index : 0xFF);
+}
+#else
+int8u emAfStaticIndexFromEndpoint(int8u endpoint)
+{
+  return emberAfIndexFromEndpoint(endpoint);
+}
+#endif
+
 int8u emberAfEndpointFromIndex(int8u index)
 {
   return emAfEndpoints[index].endpoint;
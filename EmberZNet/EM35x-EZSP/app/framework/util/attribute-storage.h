@@ -35,6 +35,44 @@
 #define MAX_ENDPOINT_COUNT FIXED_ENDPOINT_COUNT
 #endif
 
+// Number of endpoints that a host application may add and remove at run
+// time with emberAfAddDynamicEndpoint(), in addition to those configured at
+// startup.  Each takes a block of EMBER_AF_DYNAMIC_ENDPOINT_DATA_SIZE bytes
+// of attribute storage, into which the endpointSize of its endpoint type must
+// fit.
+#ifndef EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT
+  #ifdef EZSP_HOST
+    #define EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT 32
+  #else
+    #define EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT 0
+  #endif
+#endif
+#ifndef EMBER_AF_DYNAMIC_ENDPOINT_DATA_SIZE
+  #define EMBER_AF_DYNAMIC_ENDPOINT_DATA_SIZE 256
+#endif
+
+// The most clusters, server and client together, that an endpoint can give
+// the NCP.
+#define EMBER_AF_NCP_ENDPOINT_MAX_CLUSTER 58
+
+// Size of emAfEndpoints[] and of anything else indexed by endpoint index.
+#define EMBER_AF_ENDPOINT_TABLE_SIZE \
+  (MAX_ENDPOINT_COUNT + EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT)
+
+// Number of entries in the hash index used to look up attributes by
+// endpoint, cluster, direction, manufacturer code and attribute id.  It must
+// be a power of two and at least a third larger than the total number of
+// attributes on all endpoints; if the attributes do not fit, lookups fall
+// back to searching every endpoint.  Zero disables the index.  The index
+// costs RAM, so it is only enabled by default on a host.
+#ifndef EMBER_AF_ATTRIBUTE_INDEX_SIZE
+  #ifdef EZSP_HOST
+    #define EMBER_AF_ATTRIBUTE_INDEX_SIZE 1024
+  #else
+    #define EMBER_AF_ATTRIBUTE_INDEX_SIZE 0
+  #endif
+#endif
+
 
 #define CLUSTER_TICK_FREQ_ALL            (0x00)
 #define CLUSTER_TICK_FREQ_QUARTER_SECOND (0x04)
@@ -72,6 +110,85 @@ EmberAfStatus emAfReadOrWriteAttribute(EmberAfAttributeSearchRecord *attRecord,
                                        int16u maxLength,
                                        boolean write);
 
+// Where an attribute is kept, found once so that it can be read and written
+// again without another search.  A location stays good for as long as
+// emAfAttributeLocationVersion() returns the same value.
+typedef struct {
+  EmberAfAttributeMetadata *metadata;  // NULL if there is no such attribute
+  int8u *data;                         // unused for external attributes
+} EmAfAttributeLocation;
+
+void emAfLocateAttribute(EmberAfAttributeSearchRecord *attRecord,
+                         EmAfAttributeLocation *location);
+
+// As emAfReadOrWriteAttribute(), for an attribute already located with the
+// same search record.
+EmberAfStatus emAfReadOrWriteLocatedAttribute(EmberAfAttributeSearchRecord *attRecord,
+                                              const EmAfAttributeLocation *location,
+                                              int8u *buffer,
+                                              int16u readLength,
+                                              boolean write);
+
+// Changes whenever endpoints are configured, added, removed, enabled or
+// disabled, any of which may change where an attribute is found.
+int16u emAfAttributeLocationVersion(void);
+
+// Rebuilds the attribute lookup index from emAfEndpoints[].  This is called
+// by emberAfEndpointConfigure() and must be called again whenever the set of
+// endpoints or their endpoint types change.  Enabling or disabling an
+// endpoint does not require it.
+void emAfBuildAttributeIndex(void);
+
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+// Adds an endpoint to the framework's tables and loads its attribute
+// defaults.  emberAfAddDynamicEndpoint() also registers it with the NCP.
+EmberStatus emAfAddDynamicEndpoint(int8u endpoint,
+                                   EmberAfEndpointType *endpointType,
+                                   EmberAfProfileId profileId,
+                                   int16u deviceId,
+                                   int8u deviceVersion,
+                                   int8u networkIndex);
+
+// Returns TRUE for an endpoint added by emAfAddDynamicEndpoint(), whether or
+// not it is enabled.
+boolean emAfIsDynamicEndpoint(int8u endpoint);
+
+// Disables and then removes an endpoint added by emAfAddDynamicEndpoint().
+EmberStatus emAfRemoveDynamicEndpoint(int8u endpoint);
+
+// The NCP cannot remove an endpoint, so an endpoint number keeps the profile,
+// device id, version and clusters it was first created with there until the
+// NCP is reset.  These keep track of that for dynamic endpoints, and keep at
+// most EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT of them.
+
+// Forgets every endpoint created on the NCP, for when it has been reset.
+void emAfClearNcpEndpoints(void);
+
+// Checks a dynamic endpoint that has just been added against the NCP.
+// onNcp is set if the endpoint was created there before.  Returns
+// EMBER_SUCCESS if it was created with the same description, or if it was
+// not created and there is room to record it, EMBER_INVALID_CALL if it was
+// created with a different description, or EMBER_TABLE_FULL.
+EmberStatus emAfCheckNcpEndpoint(int8u endpoint, boolean *onNcp);
+
+// Records that a dynamic endpoint has been created on the NCP as it is now.
+void emAfNcpEndpointCreated(int8u endpoint);
+#endif
+
+// Returns the index of an enabled endpoint configured at startup, or 0xFF for
+// a dynamic endpoint or one that is missing or disabled.  Tables generated
+// for the startup endpoints, such as per endpoint event controls, have no
+// room for dynamic endpoints.
+int8u emAfStaticIndexFromEndpoint(int8u endpoint);
+
+#if defined(EMBER_TEST) || defined(EMBER_AF_ATTRIBUTE_INDEX_TEST)
+// Checks that looking up every attribute, and some that do not exist, through
+// the index gives the same result as searching every endpoint.  Simulation
+// builds have it, and app/ezsp-uart-host/attribute-index-test builds it with
+// EMBER_AF_ATTRIBUTE_INDEX_TEST.
+boolean emAfAttributeIndexMatchesLinearSearch(void);
+#endif
+
 boolean emAfMatchCluster(EmberAfCluster *cluster,
                          EmberAfAttributeSearchRecord *attRecord);
 boolean emAfMatchAttribute(EmberAfCluster *cluster,
@@ -587,18 +587,35 @@ EmberAfStatus emAfWriteAttribute(int8u endpoint,
                                  boolean overrideReadOnlyAndDataType,
                                  boolean justTest)
 {
-  EmberAfAttributeMetadata *metadata = NULL;
+  EmAfAttributeLocation location;
   EmberAfAttributeSearchRecord record;
   record.endpoint = endpoint;
   record.clusterId = cluster;
   record.clusterMask = mask;
   record.attributeId = attributeID;
   record.manufacturerCode = manufacturerCode;
-  emAfReadOrWriteAttribute(&record,
-                           &metadata,
-                           NULL,   // buffer
-                           0,      // buffer size
-                           FALSE); // write?
+  emAfLocateAttribute(&record, &location);
+  return emAfWriteLocatedAttribute(&record,
+                                   &location,
+                                   data,
+                                   dataType,
+                                   overrideReadOnlyAndDataType,
+                                   justTest);
+}
+
+EmberAfStatus emAfWriteLocatedAttribute(EmberAfAttributeSearchRecord *record,
+                                        const EmAfAttributeLocation *location,
+                                        int8u *data,
+                                        EmberAfAttributeType dataType,
+                                        boolean overrideReadOnlyAndDataType,
+                                        boolean justTest)
+{
+  EmberAfAttributeMetadata *metadata = location->metadata;
+  int8u endpoint = record->endpoint;
+  EmberAfClusterId cluster = record->clusterId;
+  EmberAfAttributeId attributeID = record->attributeId;
+  int8u mask = record->clusterMask;
+  int16u manufacturerCode = record->manufacturerCode;
 
   // if we dont support that attribute
   if (metadata == NULL) {
@@ -670,11 +687,11 @@ EmberAfStatus emAfWriteAttribute(int8u endpoint,
                                       data );
 
     // write the attribute
-    status = emAfReadOrWriteAttribute(&record,
-                                      NULL,    // metadata
-                                      data,
-                                      0,       // buffer size - unused
-                                      TRUE);   // write?
+    status = emAfReadOrWriteLocatedAttribute(record,
+                                             location,
+                                             data,
+                                             0,       // buffer size - unused
+                                             TRUE);   // write?
 
     if (status != EMBER_ZCL_STATUS_SUCCESS){
         return status;
@@ -569,7 +569,7 @@ int8u ezspGetParentChildParameters(
   return childCount;
 }
 
-EmberStatus ezspGetChildData(
+EmberStatus ezspReadChildData(
       int8u index,
       EmberNodeId *childId,
       EmberEUI64 childEui64,
@@ -586,7 +586,7 @@ EmberStatus ezspGetChildData(
   return status;
 }
 
-EmberStatus emberGetNeighbor(
+EmberStatus ezspReadNeighbor(
       int8u index,
       EmberNeighborTableEntry *value)
 {
@@ -599,7 +599,7 @@ EmberStatus emberGetNeighbor(
   return status;
 }
 
-int8u emberNeighborCount(void)
+int8u ezspReadNeighborCount(void)
 {
   int8u value;
   startCommand(EZSP_NEIGHBOR_COUNT);
@@ -608,7 +608,7 @@ int8u emberNeighborCount(void)
   return value;
 }
 
-EmberStatus emberGetRouteTableEntry(
+EmberStatus ezspReadRouteTableEntry(
       int8u index,
       EmberRouteTableEntry *value)
 {
@@ -670,7 +670,7 @@ EmberStatus ezspSetConcentrator(
 // Binding Frames
 //------------------------------------------------------------------------------
 
-EmberStatus emberClearBindingTable(void)
+EmberStatus ezspClearBindingTable(void)
 {
   int8u status;
   startCommand(EZSP_CLEAR_BINDING_TABLE);
@@ -679,7 +679,7 @@ EmberStatus emberClearBindingTable(void)
   return status;
 }
 
-EmberStatus emberSetBinding(
+EmberStatus ezspSetBinding(
       int8u index,
       EmberBindingTableEntry *value)
 {
@@ -692,7 +692,7 @@ EmberStatus emberSetBinding(
   return status;
 }
 
-EmberStatus emberGetBinding(
+EmberStatus ezspGetBinding(
       int8u index,
       EmberBindingTableEntry *value)
 {
@@ -705,7 +705,7 @@ EmberStatus emberGetBinding(
   return status;
 }
 
-EmberStatus emberDeleteBinding(
+EmberStatus ezspDeleteBinding(
       int8u index)
 {
   int8u status;
@@ -1016,7 +1016,7 @@ EmberStatus ezspReplaceAddressTableEntry(
   return status;
 }
 
-EmberNodeId emberLookupNodeIdByEui64(
+EmberNodeId ezspLookupNodeIdByEui64(
       EmberEUI64 eui64)
 {
   int16u nodeId;
@@ -1027,7 +1027,7 @@ EmberNodeId emberLookupNodeIdByEui64(
   return nodeId;
 }
 
-EmberStatus emberLookupEui64ByNodeId(
+EmberStatus ezspLookupEui64ByNodeId(
       EmberNodeId nodeId,
       EmberEUI64 eui64)
 {
@@ -1716,6 +1716,8 @@ static void callbackDispatch(void)
   case EZSP_STACK_STATUS_HANDLER: {
     int8u status;
     status = fetchInt8u();
+    tableMirrorStackStatus(status);
+    addressCacheStackStatus(status);
     ezspStackStatusHandler(status);
     break;
   }
@@ -1760,6 +1762,10 @@ static void callbackDispatch(void)
     childId = fetchInt16u();
     fetchInt8uArray(8, childEui64);
     childType = fetchInt8u();
+    childMirrorJoin(index, joining, childId, childEui64, childType);
+    if (joining) {
+      ezspAddressCacheAdd(childId, childEui64);
+    }
     ezspChildJoinHandler(index, joining, childId, childEui64, childType);
     break;
   }
@@ -1771,6 +1777,7 @@ static void callbackDispatch(void)
     fetchEmberBindingTableEntry(&entry);
     index = fetchInt8u();
     policyDecision = fetchInt8u();
+    bindingMirrorRemoteSet(&entry, index, policyDecision);
     ezspRemoteSetBindingHandler(&entry, index, policyDecision);
     break;
   }
@@ -1780,6 +1787,7 @@ static void callbackDispatch(void)
     int8u policyDecision;
     index = fetchInt8u();
     policyDecision = fetchInt8u();
+    bindingMirrorRemoteDelete(index, policyDecision);
     ezspRemoteDeleteBindingHandler(index, policyDecision);
     break;
   }
@@ -1820,6 +1828,7 @@ static void callbackDispatch(void)
   case EZSP_INCOMING_SENDER_EUI64_HANDLER: {
     int8u senderEui64[8];
     fetchInt8uArray(8, senderEui64);
+    addressCacheSenderEui64(senderEui64);
     ezspIncomingSenderEui64Handler(senderEui64);
     break;
   }
@@ -1843,6 +1852,7 @@ static void callbackDispatch(void)
     addressIndex = fetchInt8u();
     messageLength = fetchInt8u();
     messageContents = fetchInt8uPointer(messageLength);
+    addressCacheIncomingMessage(&apsFrame, sender, messageLength, messageContents);
     ezspIncomingMessageHandler(type, &apsFrame, lastHopLqi, lastHopRssi, sender, bindingIndex, addressIndex, messageLength, messageContents);
     break;
   }
@@ -1880,6 +1890,7 @@ static void callbackDispatch(void)
     int16u target;
     status = fetchInt8u();
     target = fetchInt16u();
+    routeMirrorError(target);
     ezspIncomingRouteErrorHandler(status, target);
     break;
   }
@@ -1887,6 +1898,7 @@ static void callbackDispatch(void)
   case EZSP_ID_CONFLICT_HANDLER: {
     int16u id;
     id = fetchInt16u();
+    addressCacheIdConflict(id);
     ezspIdConflictHandler(id);
     break;
   }
@@ -1957,6 +1969,9 @@ static void callbackDispatch(void)
     status = fetchInt8u();
     policyDecision = fetchInt8u();
     parentOfNewNodeId = fetchInt16u();
+    if (status != EMBER_DEVICE_LEFT) {
+      ezspAddressCacheAdd(newNodeId, newNodeEui64);
+    }
     ezspTrustCenterJoinHandler(newNodeId, newNodeEui64, status, policyDecision, parentOfNewNodeId);
     break;
   }
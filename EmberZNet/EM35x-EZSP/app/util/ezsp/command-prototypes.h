@@ -577,7 +577,7 @@ int8u ezspGetParentChildParameters(
 // Returns information about a child of the local node.
 // Return: EMBER_SUCCESS if there is a child at index. EMBER_NOT_JOINED if there
 // is no child at index.
-EmberStatus ezspGetChildData(
+EmberStatus ezspReadChildData(
       // The index of the child of interest in the child table. Possible indexes
       // range from zero to EMBER_CHILD_TABLE_SIZE.
       int8u index,
@@ -593,7 +593,7 @@ EmberStatus ezspGetChildData(
 // Return: EMBER_ERR_FATAL if the index is greater or equal to the number of
 // active neighbors, or if the device is an end device. Returns EMBER_SUCCESS
 // otherwise.
-EmberStatus emberGetNeighbor(
+EmberStatus ezspReadNeighbor(
       // The index of the neighbor of interest. Neighbors are stored in
       // ascending order by node id, with all unused entries at the end of the
       // table.
@@ -603,13 +603,13 @@ EmberStatus emberGetNeighbor(
 
 // Returns the number of active entries in the neighbor table.
 // Return: The number of active entries in the neighbor table.
-int8u emberNeighborCount(void);
+int8u ezspReadNeighborCount(void);
 
 // Returns the route table entry at the given index. The route table size can be
 // obtained using the getConfigurationValue command.
 // Return: EMBER_ERR_FATAL if the index is out of range or the device is an end
 // device, and EMBER_SUCCESS otherwise.
-EmberStatus emberGetRouteTableEntry(
+EmberStatus ezspReadRouteTableEntry(
       // The index of the route table entry of interest.
       int8u index,
       // Return: The contents of the route table entry.
@@ -675,11 +675,11 @@ EmberStatus ezspSetConcentrator(
 
 // Deletes all binding table entries.
 // Return: An EmberStatus value indicating success or the reason for failure.
-EmberStatus emberClearBindingTable(void);
+EmberStatus ezspClearBindingTable(void);
 
 // Sets an entry in the binding table.
 // Return: An EmberStatus value indicating success or the reason for failure.
-EmberStatus emberSetBinding(
+EmberStatus ezspSetBinding(
       // The index of a binding table entry.
       int8u index,
       // The contents of the binding entry.
@@ -687,7 +687,7 @@ EmberStatus emberSetBinding(
 
 // Gets an entry from the binding table.
 // Return: An EmberStatus value indicating success or the reason for failure.
-EmberStatus emberGetBinding(
+EmberStatus ezspGetBinding(
       // The index of a binding table entry.
       int8u index,
       // Return: The contents of the binding entry.
@@ -695,7 +695,7 @@ EmberStatus emberGetBinding(
 
 // Deletes a binding table entry.
 // Return: An EmberStatus value indicating success or the reason for failure.
-EmberStatus emberDeleteBinding(
+EmberStatus ezspDeleteBinding(
       // The index of a binding table entry.
       int8u index);
 
@@ -1219,7 +1219,7 @@ EmberStatus ezspReplaceAddressTableEntry(
 // found by searching through all stack tables for the specified EUI64.
 // Return: The short ID of the node or EMBER_NULL_NODE_ID if the short ID is not
 // known.
-EmberNodeId emberLookupNodeIdByEui64(
+EmberNodeId ezspLookupNodeIdByEui64(
       // The EUI64 of the node to look up.
       EmberEUI64 eui64);
 
@@ -1227,7 +1227,7 @@ EmberNodeId emberLookupNodeIdByEui64(
 // found by searching through all stack tables for the specified node ID.
 // Return: EMBER_SUCCESS if the EUI64 was found, EMBER_ERR_FATAL if the EUI64 is
 // not known.
-EmberStatus emberLookupEui64ByNodeId(
+EmberStatus ezspLookupEui64ByNodeId(
       // The short ID of the node to look up.
       EmberNodeId nodeId,
       // Return: The EUI64 of the node.
@@ -28,21 +28,103 @@
  * ::EMBER_SOURCE_ROUTE_TABLE_SIZE sets ::EZSP_CONFIG_SOURCE_ROUTE_TABLE_SIZE
  * if ezsp-utils.c is used, which sets the size of the source route table on
  * the NCP.  
+ *
+ * The host table may have up to 65535 entries.
  */
   #define EZSP_HOST_SOURCE_ROUTE_TABLE_SIZE 32
 #endif
 
+#ifndef EZSP_HOST_BINDING_TABLE_MIRROR_SIZE
+/** @brief The number of binding table entries the EZSP host keeps a copy of.
+ *
+ * Reading a mirrored entry with emberGetBinding() does not need a command
+ * to the NCP.  The default covers the whole of the table set up with
+ * ::EMBER_BINDING_TABLE_SIZE.  A value of 0 turns the copy off.  At most 255
+ * entries can be mirrored.
+ */
+  #define EZSP_HOST_BINDING_TABLE_MIRROR_SIZE EMBER_BINDING_TABLE_SIZE
+#endif
+
+#ifndef EZSP_HOST_CHILD_TABLE_MIRROR_SIZE
+/** @brief The number of child table entries the EZSP host keeps a copy of.
+ *
+ * Reading a copied entry with ezspGetChildData() does not need a command to
+ * the NCP.  The default covers the whole of the table set up with
+ * ::EMBER_CHILD_TABLE_SIZE.  A value of 0 turns the copy off.  At most 255
+ * entries can be copied.
+ */
+  #define EZSP_HOST_CHILD_TABLE_MIRROR_SIZE EMBER_CHILD_TABLE_SIZE
+#endif
+
+#ifndef EZSP_HOST_NEIGHBOR_TABLE_MIRROR_SIZE
+/** @brief The number of neighbor table entries the EZSP host keeps a copy
+ * of.
+ *
+ * A copied entry read with emberGetNeighbor() is answered without a command
+ * to the NCP for ::EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS.  A value of 0 turns
+ * the copy off.
+ */
+  #define EZSP_HOST_NEIGHBOR_TABLE_MIRROR_SIZE EMBER_NEIGHBOR_TABLE_SIZE
+#endif
+
+#ifndef EZSP_HOST_ROUTE_TABLE_MIRROR_SIZE
+/** @brief The number of route table entries the EZSP host keeps a copy of.
+ *
+ * A copied entry read with emberGetRouteTableEntry() is answered without a
+ * command to the NCP for ::EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS.  A value of 0
+ * turns the copy off.
+ */
+  #define EZSP_HOST_ROUTE_TABLE_MIRROR_SIZE EMBER_ROUTE_TABLE_SIZE
+#endif
+
+#ifndef EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS
+/** @brief How long, in milliseconds, the EZSP host uses its copies of
+ * neighbor and route table entries.
+ *
+ * The NCP changes these tables without telling the host, so a copied entry
+ * is read again once it is this old.  A value of 0 turns both copies off.
+ */
+  #define EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS 1000
+#endif
+
+#ifndef EZSP_HOST_ADDRESS_CACHE_SIZE
+/** @brief The number of node id and EUI64 pairs the EZSP host remembers.
+ *
+ * emberLookupEui64ByNodeId() and emberLookupNodeIdByEui64() answer from
+ * these without a command to the NCP.  When the cache is full the least
+ * recently used pair is forgotten.  A value of 0 turns the cache off.  At
+ * most 65534 pairs can be cached.
+ */
+  #define EZSP_HOST_ADDRESS_CACHE_SIZE 256
+#endif
+
 #ifndef EZSP_HOST_ASH_RX_POOL_SIZE
 /** @brief Define the size of the ASH receive buffer pool on the EZSP host.
  *
  * The number of receive buffers does not need to be greater than the
  * number of packet buffers available on the ncp, because this
  * in turn is the maximum number of callbacks that could be received between
- * commands.  In reality a value of 20 is a generous allocation.
+ * commands.  In reality a value of 20 is a generous allocation.  Queue
+ * operations take constant time, so a larger pool for bursts of callbacks
+ * costs memory but not processing time.  The transmit pool, which is sized
+ * from this value (see ash-host-queues.h), is limited to 255 buffers.
  */
   #define EZSP_HOST_ASH_RX_POOL_SIZE 20
 #endif
 
+#ifndef EZSP_HOST_COMMAND_WINDOW_SIZE
+/** @brief The maximum number of EZSP commands the host may have outstanding
+ * on the NCP at once (uart only).
+ *
+ * Commands sent with the asynchronous API in ezsp.h are pipelined through
+ * the ASH transmit window, and their responses are matched by sequence
+ * number.  The blocking EZSP functions count against the same window.  The
+ * default matches the default ASH transmit window (txK).  A value of 1
+ * restores strict one-command-at-a-time behavior.
+ */
+  #define EZSP_HOST_COMMAND_WINDOW_SIZE 3
+#endif
+
 #ifndef EZSP_HOST_FORM_AND_JOIN_BUFFER_SIZE
 /** @brief The size of the buffer for caching data during scans.
  *
@@ -17,6 +17,7 @@
 #include "app/util/ezsp/ezsp.h"
 #include "app/util/ezsp/serial-interface.h"
 #include "app/util/ezsp/ezsp-frame-utilities.h"
+#include "app/util/ezsp/ezsp-host-configuration-defaults.h"
 
 #ifdef EZSP_UART
   #include "app/ezsp-uart-host/ash-host-priv.h"
@@ -36,6 +37,7 @@
 
 static void startCommand(int8u command);
 static void sendCommand(void);
+static EzspStatus sendCommandAsync(EzspResponseHandler handler);
 static void callbackDispatch(void);
 static void callbackPointerInit(void);
 static int8u *fetchInt8uPointer(int8u length);
@@ -52,6 +54,28 @@ int8u ezspSleepMode = EZSP_FRAME_CONTROL_IDLE;
 static boolean sendingCommand = FALSE;
 static int8u ezspSequence = 0;
 
+// Commands sent with sendCommandAsync() that are still waiting for their
+// response, oldest first.  The NCP processes commands in the order they are
+// received, so each response is matched against the oldest entry by its
+// sequence number.
+typedef struct {
+  int8u sequence;
+  int8u frameId;
+  EzspResponseHandler handler;
+} EzspPendingCommand;
+
+#ifdef EZSP_UART
+  #define COMMAND_WINDOW_SIZE EZSP_HOST_COMMAND_WINDOW_SIZE
+#else
+  // The SPI protocol can only carry one command at a time.
+  #define COMMAND_WINDOW_SIZE 1
+#endif
+
+static EzspPendingCommand pendingCommands[COMMAND_WINDOW_SIZE];
+static int8u pendingHead = 0;
+static int8u pendingCount = 0;
+static boolean dispatchingResponse = FALSE;
+
 // Multi-network support: this variable is equivalent to the
 // emApplicationNetworkIndex vaiable for SOC. It stores the ezsp network index.
 // It gets included in the frame control of every EZSP message to the NCP.
@@ -134,60 +158,290 @@ EzspStatus ezspGetEndpointFlags(int8u endpoint,
 
 //----------------------------------------------------------------
 // Special Handling for AES functions.
+//
+// The host computes AES-MMO hashes itself rather than passing the data to
+// the NCP a frame at a time.  The padding follows annex B.6 of the ZigBee
+// specification, as on the NCP, so the digests are the same.  Messages of
+// 8192 bytes or more use the 32-bit length form of the padding, and there is
+// no other limit on the length.
+//
+// AES-128 encryption uses the AES-NI instructions on x86 processors that
+// have them, and otherwise a table implementation that combines SubBytes,
+// ShiftRows and MixColumns.  The tables are built on first use.  The key
+// schedule is expanded for every block, as each block is encrypted with the
+// hash so far as the key.
+
+#define AES_BLOCK_SIZE    EMBER_AES_HASH_BLOCK_SIZE
+#define AES_ROUNDS        10
+
+// The padded length is a 16-bit count of bits for shorter messages.
+#define AES_MMO_SHORT_MESSAGE_LIMIT 8192
+#define AES_MMO_MAX_MESSAGE_LENGTH  0x1FFFFFFFUL
+
+static int8u aesSbox[256];
+static int32u aesTable[256];       // MixColumns of the S-box, row 0 first
+static boolean aesTablesReady = FALSE;
+
+#define ROTATE8(x, n)  ((int8u)(((x) << (n)) | ((x) >> (8 - (n)))))
+#define ROTATE32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// Builds the S-box from the field inverses.  p steps through the nonzero
+// elements as powers of 3 while q steps through their inverses.
+static void aesInitTables(void)
+{
+  int8u p = 1;
+  int8u q = 1;
+  int16u i;
+
+  do {
+    int8u x;
+    p = p ^ (p << 1) ^ ((p & 0x80) ? 0x1B : 0);
+    q ^= q << 1;
+    q ^= q << 2;
+    q ^= q << 4;
+    if (q & 0x80) {
+      q ^= 0x09;
+    }
+    x = q ^ ROTATE8(q, 1) ^ ROTATE8(q, 2) ^ ROTATE8(q, 3) ^ ROTATE8(q, 4);
+    aesSbox[p] = x ^ 0x63;
+  } while (p != 1);
+  aesSbox[0] = 0x63;
+
+  for (i = 0; i < 256; i++) {
+    int8u s = aesSbox[i];
+    int8u s2 = (int8u)((s << 1) ^ ((s & 0x80) ? 0x1B : 0));
+    aesTable[i] = (((int32u)s2 << 24)
+                   | ((int32u)s << 16)
+                   | ((int32u)s << 8)
+                   | (int8u)(s2 ^ s));
+  }
+  aesTablesReady = TRUE;
+}
 
-// This is a copy of the function available on the SOC.  It would be a waste
-// to have this be an actual EZSP call.
-void emberAesMmoHashInit(EmberAesMmoHashContext *context)
+#define LOAD32(p) (((int32u)(p)[0] << 24) | ((int32u)(p)[1] << 16) \
+                   | ((int32u)(p)[2] << 8) | (p)[3])
+
+static void store32(int8u *p, int32u value)
 {
-  MEMSET(context, 0, sizeof(EmberAesMmoHashContext));
+  p[0] = (int8u)(value >> 24);
+  p[1] = (int8u)(value >> 16);
+  p[2] = (int8u)(value >> 8);
+  p[3] = (int8u)value;
+}
+
+#define SUB_WORD(w) (((int32u)aesSbox[(w) >> 24] << 24)          \
+                     | ((int32u)aesSbox[((w) >> 16) & 0xFF] << 16) \
+                     | ((int32u)aesSbox[((w) >> 8) & 0xFF] << 8)   \
+                     | aesSbox[(w) & 0xFF])
+
+// The state is kept as four columns, each with row 0 in the top byte.
+#define AES_COLUMN(s, c)                                   \
+  (aesTable[(s)[(c)] >> 24]                                \
+   ^ ROTATE32(aesTable[((s)[((c) + 1) & 3] >> 16) & 0xFF], 8)  \
+   ^ ROTATE32(aesTable[((s)[((c) + 2) & 3] >> 8) & 0xFF], 16)  \
+   ^ ROTATE32(aesTable[(s)[((c) + 3) & 3] & 0xFF], 24))
+
+static void aesTableEncrypt(const int8u *key,
+                            const int8u *input,
+                            int8u *output)
+{
+  static const int8u rcon[AES_ROUNDS] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36
+  };
+  int32u roundKey[4];
+  int32u state[4];
+  int32u next[4];
+  int8u round;
+  int8u c;
+
+  if (!aesTablesReady) {
+    aesInitTables();
+  }
+
+  for (c = 0; c < 4; c++) {
+    roundKey[c] = LOAD32(key + 4 * c);
+    state[c] = LOAD32(input + 4 * c) ^ roundKey[c];
+  }
+
+  for (round = 0; round < AES_ROUNDS; round++) {
+    int32u last = roundKey[3];
+    roundKey[0] ^= SUB_WORD((last << 8) | (last >> 24)) ^ ((int32u)rcon[round] << 24);
+    roundKey[1] ^= roundKey[0];
+    roundKey[2] ^= roundKey[1];
+    roundKey[3] ^= roundKey[2];
+
+    if (round < AES_ROUNDS - 1) {
+      for (c = 0; c < 4; c++) {
+        next[c] = AES_COLUMN(state, c) ^ roundKey[c];
+      }
+    } else {
+      // The last round has no MixColumns.
+      for (c = 0; c < 4; c++) {
+        next[c] = ((((int32u)aesSbox[state[c] >> 24]) << 24)
+                   | (((int32u)aesSbox[(state[(c + 1) & 3] >> 16) & 0xFF]) << 16)
+                   | (((int32u)aesSbox[(state[(c + 2) & 3] >> 8) & 0xFF]) << 8)
+                   | aesSbox[state[(c + 3) & 3] & 0xFF]) ^ roundKey[c];
+      }
+    }
+    MEMCOPY(state, next, sizeof(state));
+  }
+
+  for (c = 0; c < 4; c++) {
+    store32(output + 4 * c, state[c]);
+  }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <wmmintrin.h>
+
+#define AES_NI_TARGET __attribute__((target("aes,sse2")))
+
+AES_NI_TARGET
+static __m128i aesNiNextKey(__m128i key, __m128i assist)
+{
+  assist = _mm_shuffle_epi32(assist, 0xFF);
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
 }
 
-// Here we convert the normal Ember AES hash call to the specialized EZSP call.
-// This came about because we cannot pass a block of data that is
-// both input and output into EZSP.  The block must be broken up into two
-// elements.  We unify the two pieces here to make it invisible to
-// the users.
+// The round constant must be an immediate operand.
+#define AES_NI_ROUND(rcon)                                            \
+  do {                                                                \
+    key = aesNiNextKey(key, _mm_aeskeygenassist_si128(key, (rcon)));  \
+    state = _mm_aesenc_si128(state, key);                             \
+  } while (0)
+
+AES_NI_TARGET
+static void aesNiEncrypt(const int8u *keyBytes,
+                         const int8u *input,
+                         int8u *output)
+{
+  __m128i key = _mm_loadu_si128((const __m128i *)keyBytes);
+  __m128i state = _mm_xor_si128(_mm_loadu_si128((const __m128i *)input), key);
+  AES_NI_ROUND(0x01);
+  AES_NI_ROUND(0x02);
+  AES_NI_ROUND(0x04);
+  AES_NI_ROUND(0x08);
+  AES_NI_ROUND(0x10);
+  AES_NI_ROUND(0x20);
+  AES_NI_ROUND(0x40);
+  AES_NI_ROUND(0x80);
+  AES_NI_ROUND(0x1B);
+  key = aesNiNextKey(key, _mm_aeskeygenassist_si128(key, 0x36));
+  state = _mm_aesenclast_si128(state, key);
+  _mm_storeu_si128((__m128i *)output, state);
+}
 
-static EmberStatus aesMmoHash(EmberAesMmoHashContext *context,
-                              boolean finalize,
-                              int32u length,
-                              int8u *data)
+static boolean aesNiAvailable(void)
 {
-  EmberAesMmoHashContext returnData;
-  EmberStatus status;
-  if (length > 255) {
-    return EMBER_INVALID_CALL;
+  __builtin_cpu_init();
+  return (__builtin_cpu_supports("aes") != 0);
+}
+
+#else
+
+#define aesNiEncrypt aesTableEncrypt
+#define aesNiAvailable() FALSE
+
+#endif
+
+// Whether to use AES-NI: 0xFF until the processor has been checked.  Tests
+// may clear it to use the tables.
+int8u emAesUseAesNi = 0xFF;
+
+static void aesEncrypt(const int8u *key, const int8u *input, int8u *output)
+{
+  if (emAesUseAesNi == 0xFF) {
+    emAesUseAesNi = aesNiAvailable();
   }
-  // In theory we could use 'context' structure as the 'returnData',
-  // however that could be risky if the EZSP function tries to memset() the 
-  // 'returnData' prior to storing data in it.
-  status = ezspAesMmoHash(context,
-                          finalize,
-                          (int8u)length,
-                          data,
-                          &returnData);
-  MEMCOPY(context, &returnData, sizeof(EmberAesMmoHashContext));
-  return status;
+  if (emAesUseAesNi) {
+    aesNiEncrypt(key, input, output);
+  } else {
+    aesTableEncrypt(key, input, output);
+  }
+}
+
+// Each block is encrypted with the hash so far as the key, and the result
+// combined with the block is the new hash.
+static void aesMmoHashBlocks(EmberAesMmoHashContext *context,
+                             int32u count,
+                             const int8u *data)
+{
+  int8u encrypted[AES_BLOCK_SIZE];
+  int8u i;
+  for (; count > 0; count--, data += AES_BLOCK_SIZE) {
+    aesEncrypt(context->result, data, encrypted);
+    for (i = 0; i < AES_BLOCK_SIZE; i++) {
+      context->result[i] = encrypted[i] ^ data[i];
+    }
+  }
+}
+
+// This is a copy of the function available on the SOC.  It would be a waste
+// to have this be an actual EZSP call.
+void emberAesMmoHashInit(EmberAesMmoHashContext *context)
+{
+  MEMSET(context, 0, sizeof(EmberAesMmoHashContext));
 }
 
 EmberStatus emberAesMmoHashUpdate(EmberAesMmoHashContext *context,
                                   int32u length,
-                                  int8u *data)
+                                  const int8u *data)
 {
-  return aesMmoHash(context,
-                    FALSE,   // finalize?
-                    length,
-                    data);
+  if (length % AES_BLOCK_SIZE != 0) {
+    return EMBER_INVALID_CALL;
+  }
+  if (length > AES_MMO_MAX_MESSAGE_LENGTH - context->length) {
+    return EMBER_INDEX_OUT_OF_RANGE;
+  }
+  aesMmoHashBlocks(context, length / AES_BLOCK_SIZE, data);
+  context->length += length;
+  return EMBER_SUCCESS;
 }
 
 EmberStatus emberAesMmoHashFinal(EmberAesMmoHashContext *context,
                                  int32u length,
-                                 int8u *data)
+                                 const int8u *finalData)
 {
-  return aesMmoHash(context,
-                    TRUE,    // finalize?
-                    length,
-                    data);
+  int8u padding[2 * AES_BLOCK_SIZE];
+  int32u blocks = length / AES_BLOCK_SIZE;
+  int8u remainder = (int8u)(length % AES_BLOCK_SIZE);
+  int8u trailerLength;
+  int8u paddingLength;
+  int32u totalLength;
+  int32u bits;
+
+  if (length > AES_MMO_MAX_MESSAGE_LENGTH - context->length) {
+    return EMBER_INDEX_OUT_OF_RANGE;
+  }
+  totalLength = context->length + length;
+  bits = totalLength * 8;
+
+  aesMmoHashBlocks(context, blocks, finalData);
+
+  // A 1 bit and zeros, then the bit count: two bytes, or four bytes and two
+  // zero bytes for longer messages, at the end of one or two blocks.
+  trailerLength = (totalLength < AES_MMO_SHORT_MESSAGE_LIMIT ? 2 : 6);
+  paddingLength = (remainder + 1 + trailerLength <= AES_BLOCK_SIZE
+                   ? AES_BLOCK_SIZE
+                   : 2 * AES_BLOCK_SIZE);
+  MEMSET(padding, 0, sizeof(padding));
+  if (remainder != 0) {
+    MEMCOPY(padding, finalData + blocks * AES_BLOCK_SIZE, remainder);
+  }
+  padding[remainder] = 0x80;
+  if (trailerLength == 2) {
+    padding[paddingLength - 2] = HIGH_BYTE(bits);
+    padding[paddingLength - 1] = LOW_BYTE(bits);
+  } else {
+    store32(padding + paddingLength - 6, bits);
+  }
+  aesMmoHashBlocks(context, paddingLength / AES_BLOCK_SIZE, padding);
+  context->length = totalLength;
+  return EMBER_SUCCESS;
 }
 
 // This is a convenience routine for hashing short blocks of data,
@@ -201,7 +455,7 @@ EmberStatus emberAesHashSimple(int8u totalLength,
   emberAesMmoHashInit(&context);
   status = emberAesMmoHashFinal(&context,
                                 totalLength,
-                                (int8u*)data);
+                                data);
   MEMCOPY(result, context.result, 16);
   return status;
 }
@@ -421,6 +675,937 @@ EmberLeaveReason emberGetLastLeaveReason(EmberNodeId* id)
   return data[0];
 }
 
+//------------------------------------------------------------------------------
+// Binding table mirror
+//
+// The host keeps a copy of the NCP's binding table so that reading it does
+// not cost a command.  The copy is read from the NCP when it is first needed
+// and again by ezspBindingMirrorLoad(), and is kept up to date by the binding
+// functions below and by the remote binding callbacks.  Bindings in use are
+// chained by local endpoint and cluster, in index order, so that
+// ezspFindBinding() only visits bindings that may match.
+
+#define BINDING_MIRROR_NULL_INDEX 0xFF
+
+static int32u bindingMirrorSavedCommands = 0;
+static int16u bindingTableVersion = 0;
+
+#if EZSP_HOST_BINDING_TABLE_MIRROR_SIZE > 0
+
+#define BINDING_MIRROR_BUCKETS 16
+
+static EmberBindingTableEntry bindingMirror[EZSP_HOST_BINDING_TABLE_MIRROR_SIZE];
+static int8u bindingMirrorNext[EZSP_HOST_BINDING_TABLE_MIRROR_SIZE];
+static int8u bindingMirrorHeads[BINDING_MIRROR_BUCKETS];
+static int8u bindingMirrorCount = 0;  // entries read from the NCP
+static boolean bindingMirrorLoaded = FALSE;
+
+static int8u *bindingMirrorBucket(int8u endpoint, int16u clusterId)
+{
+  int8u hash = (int8u)(clusterId ^ (clusterId >> 8) ^ (endpoint * 7));
+  return &bindingMirrorHeads[hash % BINDING_MIRROR_BUCKETS];
+}
+
+static void bindingMirrorUnlink(int8u index)
+{
+  EmberBindingTableEntry *entry = &bindingMirror[index];
+  int8u *link;
+  if (entry->type == EMBER_UNUSED_BINDING) {
+    return;
+  }
+  link = bindingMirrorBucket(entry->local, entry->clusterId);
+  while (*link != index) {
+    link = &bindingMirrorNext[*link];
+  }
+  *link = bindingMirrorNext[index];
+}
+
+static void bindingMirrorLink(int8u index)
+{
+  EmberBindingTableEntry *entry = &bindingMirror[index];
+  int8u *link;
+  if (entry->type == EMBER_UNUSED_BINDING) {
+    return;
+  }
+  link = bindingMirrorBucket(entry->local, entry->clusterId);
+  while (*link != BINDING_MIRROR_NULL_INDEX && *link < index) {
+    link = &bindingMirrorNext[*link];
+  }
+  bindingMirrorNext[index] = *link;
+  *link = index;
+}
+
+static boolean bindingMirrorReady(void)
+{
+  if (!bindingMirrorLoaded) {
+    ezspBindingMirrorLoad();
+  }
+  return bindingMirrorLoaded;
+}
+
+static void bindingMirrorStore(int8u index, EmberBindingTableEntry *value)
+{
+  if (bindingMirrorLoaded && index < bindingMirrorCount) {
+    bindingMirrorUnlink(index);
+    MEMCOPY(&bindingMirror[index], value, sizeof(EmberBindingTableEntry));
+    bindingMirrorLink(index);
+  }
+}
+
+static void bindingMirrorErase(int8u index)
+{
+  if (bindingMirrorLoaded && index < bindingMirrorCount) {
+    bindingMirrorUnlink(index);
+    bindingMirror[index].type = EMBER_UNUSED_BINDING;
+  }
+}
+
+static void bindingMirrorClear(void)
+{
+  int8u i;
+  for (i = 0; i < bindingMirrorCount; i++) {
+    bindingMirror[i].type = EMBER_UNUSED_BINDING;
+  }
+  MEMSET(bindingMirrorHeads,
+         BINDING_MIRROR_NULL_INDEX,
+         sizeof(bindingMirrorHeads));
+}
+
+int8u ezspBindingMirrorLoad(void)
+{
+  int8u i;
+  bindingTableVersion++;
+  bindingMirrorLoaded = FALSE;
+  bindingMirrorCount = 0;
+  MEMSET(bindingMirrorHeads,
+         BINDING_MIRROR_NULL_INDEX,
+         sizeof(bindingMirrorHeads));
+  // The NCP's table may be smaller than the mirror.  Entries past its end
+  // are not mirrored, and reading them still goes to the NCP.
+  for (i = 0; i < EZSP_HOST_BINDING_TABLE_MIRROR_SIZE; i++) {
+    if (ezspGetBinding(i, &bindingMirror[i]) != EMBER_SUCCESS) {
+      break;
+    }
+    bindingMirrorLink(i);
+    bindingMirrorCount++;
+  }
+  bindingMirrorLoaded = TRUE;
+  return bindingMirrorCount;
+}
+
+#else
+
+int8u ezspBindingMirrorLoad(void)
+{
+  bindingTableVersion++;
+  return 0;
+}
+
+#define bindingMirrorStore(index, value)
+#define bindingMirrorErase(index)
+#define bindingMirrorClear()
+
+#endif // EZSP_HOST_BINDING_TABLE_MIRROR_SIZE > 0
+
+int32u ezspBindingMirrorSavedCommands(void)
+{
+  return bindingMirrorSavedCommands;
+}
+
+int16u ezspBindingTableVersion(void)
+{
+  return bindingTableVersion;
+}
+
+EmberStatus emberSetBinding(int8u index, EmberBindingTableEntry *value)
+{
+  EmberStatus status = ezspSetBinding(index, value);
+  if (status == EMBER_SUCCESS) {
+    bindingTableVersion++;
+    bindingMirrorStore(index, value);
+  }
+  return status;
+}
+
+EmberStatus emberGetBinding(int8u index, EmberBindingTableEntry *value)
+{
+#if EZSP_HOST_BINDING_TABLE_MIRROR_SIZE > 0
+  if (bindingMirrorReady() && index < bindingMirrorCount) {
+    MEMCOPY(value, &bindingMirror[index], sizeof(EmberBindingTableEntry));
+    bindingMirrorSavedCommands++;
+    return EMBER_SUCCESS;
+  }
+#endif
+  return ezspGetBinding(index, value);
+}
+
+EmberStatus emberDeleteBinding(int8u index)
+{
+  EmberStatus status = ezspDeleteBinding(index);
+  if (status == EMBER_SUCCESS) {
+    bindingTableVersion++;
+    bindingMirrorErase(index);
+  }
+  return status;
+}
+
+EmberStatus emberClearBindingTable(void)
+{
+  EmberStatus status = ezspClearBindingTable();
+  if (status == EMBER_SUCCESS) {
+    bindingTableVersion++;
+    bindingMirrorClear();
+  }
+  return status;
+}
+
+int8u ezspFindBinding(int8u index,
+                      int8u localEndpoint,
+                      int16u clusterId,
+                      EmberBindingTableEntry *entry)
+{
+#if EZSP_HOST_BINDING_TABLE_MIRROR_SIZE > 0
+  if (bindingMirrorReady()) {
+    // Starting a search saves reading every entry from the NCP.
+    if (index == BINDING_MIRROR_NULL_INDEX) {
+      index = *bindingMirrorBucket(localEndpoint, clusterId);
+      bindingMirrorSavedCommands += bindingMirrorCount;
+    } else {
+      index = bindingMirrorNext[index];
+    }
+    while (index != BINDING_MIRROR_NULL_INDEX
+           && (bindingMirror[index].local != localEndpoint
+               || bindingMirror[index].clusterId != clusterId)) {
+      index = bindingMirrorNext[index];
+    }
+    if (index != BINDING_MIRROR_NULL_INDEX) {
+      MEMCOPY(entry, &bindingMirror[index], sizeof(EmberBindingTableEntry));
+    }
+    return index;
+  }
+#endif
+  // Without a mirror, read the table from the NCP until it runs out.
+  for (index++; index != BINDING_MIRROR_NULL_INDEX; index++) {
+    if (ezspGetBinding(index, entry) != EMBER_SUCCESS) {
+      break;
+    }
+    if (entry->type != EMBER_UNUSED_BINDING
+        && entry->local == localEndpoint
+        && entry->clusterId == clusterId) {
+      return index;
+    }
+  }
+  return BINDING_MIRROR_NULL_INDEX;
+}
+
+// Called from callbackDispatch() before the application's handlers.  The NCP
+// has already applied its policy decision to its table.
+static void bindingMirrorRemoteSet(EmberBindingTableEntry *entry,
+                                   int8u index,
+                                   EmberStatus policyDecision)
+{
+  if (policyDecision == EMBER_SUCCESS) {
+    bindingTableVersion++;
+    bindingMirrorStore(index, entry);
+  }
+}
+
+static void bindingMirrorRemoteDelete(int8u index, EmberStatus policyDecision)
+{
+  if (policyDecision == EMBER_SUCCESS) {
+    bindingTableVersion++;
+    bindingMirrorErase(index);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Stack table mirrors
+//
+// The host keeps a copy of each child, neighbor and route table entry it
+// reads from the NCP, together with the status the NCP returned for it.
+// Nothing is read until it is asked for, and dropping an entry only means
+// that it is read again the next time.  An entry is dropped, rather than
+// changed, whenever the host cannot tell exactly what the NCP has done to
+// it.  Neighbor and route entries also go out of date after
+// EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS, as the NCP changes those tables
+// without telling the host.  Key table entries are not copied, as their
+// frame counters change with every secured message.
+
+typedef struct {
+  EmberNodeId id;
+  EmberEUI64 eui64;
+  EmberNodeType type;
+} ChildMirrorEntry;
+
+typedef union {
+  ChildMirrorEntry child;
+  EmberNeighborTableEntry neighbor;
+  EmberRouteTableEntry route;
+} TableMirrorEntry;
+
+typedef struct {
+  boolean valid;
+  int8u status;
+  int32u readTime;
+} TableMirrorState;
+
+typedef struct {
+  int8u frameId;        // the command that reads an entry
+  int8u size;           // the number of entries copied
+  boolean aged;         // TRUE if entries go out of date
+  TableMirrorState *states;
+  TableMirrorEntry *entries;
+  void (*fetch)(TableMirrorEntry *entry);
+  int16u version;
+} TableMirror;
+
+#if EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS > 0
+  #define AGED_MIRROR_SIZE(size) (size)
+#else
+  #define AGED_MIRROR_SIZE(size) 0
+#endif
+
+// A copy that is turned off still has an entry, which is never used, so
+// that the arrays are not empty.
+#define TABLE_MIRROR_ARRAY_SIZE(size) ((size) > 0 ? (size) : 1)
+
+static TableMirrorState childMirrorStates[TABLE_MIRROR_ARRAY_SIZE(EZSP_HOST_CHILD_TABLE_MIRROR_SIZE)];
+static TableMirrorEntry childMirrorEntries[TABLE_MIRROR_ARRAY_SIZE(EZSP_HOST_CHILD_TABLE_MIRROR_SIZE)];
+static TableMirrorState neighborMirrorStates[TABLE_MIRROR_ARRAY_SIZE(EZSP_HOST_NEIGHBOR_TABLE_MIRROR_SIZE)];
+static TableMirrorEntry neighborMirrorEntries[TABLE_MIRROR_ARRAY_SIZE(EZSP_HOST_NEIGHBOR_TABLE_MIRROR_SIZE)];
+static TableMirrorState routeMirrorStates[TABLE_MIRROR_ARRAY_SIZE(EZSP_HOST_ROUTE_TABLE_MIRROR_SIZE)];
+static TableMirrorEntry routeMirrorEntries[TABLE_MIRROR_ARRAY_SIZE(EZSP_HOST_ROUTE_TABLE_MIRROR_SIZE)];
+
+static void fetchChildMirrorEntry(TableMirrorEntry *entry)
+{
+  entry->child.id = fetchInt16u();
+  fetchInt8uArray(EUI64_SIZE, entry->child.eui64);
+  entry->child.type = fetchInt8u();
+}
+
+static void fetchNeighborMirrorEntry(TableMirrorEntry *entry)
+{
+  fetchEmberNeighborTableEntry(&entry->neighbor);
+}
+
+static void fetchRouteMirrorEntry(TableMirrorEntry *entry)
+{
+  fetchEmberRouteTableEntry(&entry->route);
+}
+
+// Indexed by EZSP_CHILD_TABLE_MIRROR etc.
+static TableMirror tableMirrors[EZSP_TABLE_MIRROR_COUNT] = {
+  { EZSP_GET_CHILD_DATA,
+    EZSP_HOST_CHILD_TABLE_MIRROR_SIZE,
+    FALSE,
+    childMirrorStates,
+    childMirrorEntries,
+    fetchChildMirrorEntry,
+    0 },
+  { EZSP_GET_NEIGHBOR,
+    AGED_MIRROR_SIZE(EZSP_HOST_NEIGHBOR_TABLE_MIRROR_SIZE),
+    TRUE,
+    neighborMirrorStates,
+    neighborMirrorEntries,
+    fetchNeighborMirrorEntry,
+    0 },
+  { EZSP_GET_ROUTE_TABLE_ENTRY,
+    AGED_MIRROR_SIZE(EZSP_HOST_ROUTE_TABLE_MIRROR_SIZE),
+    TRUE,
+    routeMirrorStates,
+    routeMirrorEntries,
+    fetchRouteMirrorEntry,
+    0 },
+};
+
+static int32u tableMirrorSavedCommands = 0;
+
+// The neighbor count goes out of date along with the neighbor entries.
+static boolean neighborCountValid = FALSE;
+static int8u neighborCount;
+static int32u neighborCountReadTime;
+
+// The index read by each pipelined snapshot command, by sequence number.
+static int8u snapshotIndexes[256];
+
+static boolean tableMirrorIsCurrent(boolean aged, int32u readTime)
+{
+  return (!aged
+          || ((int32u)(halCommonGetInt32uMillisecondTick() - readTime)
+              < EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS));
+}
+
+static boolean tableMirrorHolds(TableMirror *mirror, int8u index)
+{
+  return (index < mirror->size
+          && mirror->states[index].valid
+          && tableMirrorIsCurrent(mirror->aged,
+                                  mirror->states[index].readTime));
+}
+
+static void tableMirrorStore(TableMirror *mirror,
+                             int8u index,
+                             EmberStatus status,
+                             TableMirrorEntry *entry)
+{
+  TableMirrorState *state = &mirror->states[index];
+  if (!state->valid
+      || state->status != status
+      || MEMCOMPARE(&mirror->entries[index],
+                    entry,
+                    sizeof(TableMirrorEntry)) != 0) {
+    mirror->version++;
+  }
+  state->valid = TRUE;
+  state->status = status;
+  state->readTime = halCommonGetInt32uMillisecondTick();
+  MEMCOPY(&mirror->entries[index], entry, sizeof(TableMirrorEntry));
+}
+
+static void tableMirrorDrop(TableMirror *mirror, int8u index)
+{
+  if (mirror->states[index].valid) {
+    mirror->states[index].valid = FALSE;
+    mirror->version++;
+  }
+}
+
+// Returns the NCP's status for an entry, from the copy if it holds the entry.
+// The entry is zeroed before it is read from the NCP so that the padding in
+// it does not count as a change to the copy.
+static EmberStatus tableMirrorRead(int8u table,
+                                   int8u index,
+                                   TableMirrorEntry *entry)
+{
+  TableMirror *mirror = &tableMirrors[table];
+  EmberStatus status;
+  if (tableMirrorHolds(mirror, index)) {
+    MEMCOPY(entry, &mirror->entries[index], sizeof(TableMirrorEntry));
+    tableMirrorSavedCommands++;
+    return mirror->states[index].status;
+  }
+  MEMSET(entry, 0, sizeof(TableMirrorEntry));
+  startCommand(mirror->frameId);
+  appendInt8u(index);
+  sendCommand();
+  status = fetchInt8u();
+  mirror->fetch(entry);
+  if (index < mirror->size) {
+    tableMirrorStore(mirror, index, status, entry);
+  }
+  return status;
+}
+
+static void tableMirrorSnapshotHandler(EzspStatus status,
+                                       int8u frameId,
+                                       int8u sequence)
+{
+  TableMirrorEntry entry;
+  EmberStatus entryStatus;
+  int8u table;
+  if (status != EZSP_SUCCESS) {
+    return;
+  }
+  for (table = 0; table < EZSP_TABLE_MIRROR_COUNT; table++) {
+    TableMirror *mirror = &tableMirrors[table];
+    if (mirror->frameId == frameId) {
+      MEMSET(&entry, 0, sizeof(TableMirrorEntry));
+      entryStatus = fetchInt8u();
+      mirror->fetch(&entry);
+      tableMirrorStore(mirror, snapshotIndexes[sequence], entryStatus, &entry);
+      return;
+    }
+  }
+}
+
+int8u ezspTableMirrorSnapshot(int8u table, int8u start, int8u count)
+{
+  TableMirror *mirror = &tableMirrors[table];
+  int8u held = 0;
+  int8u i;
+
+  if (start >= mirror->size || sendingCommand || dispatchingResponse) {
+    return 0;
+  }
+  if (count > mirror->size - start) {
+    count = mirror->size - start;
+  }
+  for (i = start; i < start + count; i++) {
+    if (!tableMirrorHolds(mirror, i)) {
+      snapshotIndexes[ezspSequence] = i;
+      startCommand(mirror->frameId);
+      appendInt8u(i);
+      if (sendCommandAsync(tableMirrorSnapshotHandler) != EZSP_SUCCESS) {
+        break;
+      }
+    }
+  }
+  ezspWaitForPendingCommands();
+  for (i = start; i < start + count; i++) {
+    if (tableMirrorHolds(mirror, i)) {
+      held++;
+    }
+  }
+  return held;
+}
+
+void ezspTableMirrorInvalidate(int8u table)
+{
+  int8u t;
+  int8u i;
+  for (t = 0; t < EZSP_TABLE_MIRROR_COUNT; t++) {
+    if (table == t || table == EZSP_ALL_TABLE_MIRRORS) {
+      for (i = 0; i < tableMirrors[t].size; i++) {
+        tableMirrorDrop(&tableMirrors[t], i);
+      }
+      if (t == EZSP_NEIGHBOR_TABLE_MIRROR) {
+        neighborCountValid = FALSE;
+      }
+    }
+  }
+}
+
+int16u ezspTableMirrorVersion(int8u table)
+{
+  return tableMirrors[table].version;
+}
+
+int32u ezspTableMirrorSavedCommands(void)
+{
+  return tableMirrorSavedCommands;
+}
+
+EmberStatus ezspGetChildData(int8u index,
+                             EmberNodeId *childId,
+                             EmberEUI64 childEui64,
+                             EmberNodeType *childType)
+{
+  TableMirrorEntry entry;
+  EmberStatus status = tableMirrorRead(EZSP_CHILD_TABLE_MIRROR, index, &entry);
+  *childId = entry.child.id;
+  MEMCOPY(childEui64, entry.child.eui64, EUI64_SIZE);
+  *childType = entry.child.type;
+  return status;
+}
+
+EmberStatus emberGetNeighbor(int8u index, EmberNeighborTableEntry *value)
+{
+  TableMirrorEntry entry;
+  EmberStatus status = tableMirrorRead(EZSP_NEIGHBOR_TABLE_MIRROR,
+                                       index,
+                                       &entry);
+  MEMCOPY(value, &entry.neighbor, sizeof(EmberNeighborTableEntry));
+  return status;
+}
+
+int8u emberNeighborCount(void)
+{
+  TableMirror *mirror = &tableMirrors[EZSP_NEIGHBOR_TABLE_MIRROR];
+  int8u count;
+  if (mirror->size == 0) {
+    return ezspReadNeighborCount();
+  }
+  if (neighborCountValid
+      && tableMirrorIsCurrent(TRUE, neighborCountReadTime)) {
+    tableMirrorSavedCommands++;
+    return neighborCount;
+  }
+  count = ezspReadNeighborCount();
+  if (!neighborCountValid || count != neighborCount) {
+    mirror->version++;
+  }
+  neighborCount = count;
+  neighborCountReadTime = halCommonGetInt32uMillisecondTick();
+  neighborCountValid = TRUE;
+  return count;
+}
+
+EmberStatus emberGetRouteTableEntry(int8u index, EmberRouteTableEntry *value)
+{
+  TableMirrorEntry entry;
+  EmberStatus status = tableMirrorRead(EZSP_ROUTE_TABLE_MIRROR,
+                                       index,
+                                       &entry);
+  MEMCOPY(value, &entry.route, sizeof(EmberRouteTableEntry));
+  return status;
+}
+
+// The functions below are called from callbackDispatch() before the
+// application's handlers.
+
+static void tableMirrorStackStatus(EmberStatus status)
+{
+  ezspTableMirrorInvalidate(EZSP_ALL_TABLE_MIRRORS);
+}
+
+static void childMirrorJoin(int8u index,
+                            boolean joining,
+                            EmberNodeId childId,
+                            EmberEUI64 childEui64,
+                            EmberNodeType childType)
+{
+  TableMirror *mirror = &tableMirrors[EZSP_CHILD_TABLE_MIRROR];
+  TableMirrorEntry entry;
+  if (index >= mirror->size) {
+    return;
+  }
+  if (joining) {
+    MEMSET(&entry, 0, sizeof(TableMirrorEntry));
+    entry.child.id = childId;
+    MEMCOPY(entry.child.eui64, childEui64, EUI64_SIZE);
+    entry.child.type = childType;
+    tableMirrorStore(mirror, index, EMBER_SUCCESS, &entry);
+  } else {
+    tableMirrorDrop(mirror, index);
+  }
+}
+
+static void routeMirrorError(EmberNodeId target)
+{
+  TableMirror *mirror = &tableMirrors[EZSP_ROUTE_TABLE_MIRROR];
+  int8u i;
+  for (i = 0; i < mirror->size; i++) {
+    if (mirror->states[i].valid
+        && mirror->entries[i].route.destination == target) {
+      tableMirrorDrop(mirror, i);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Address cache
+//
+// Each pair is filed twice, in chains hanging off hash buckets by node id
+// and by EUI64, and is on a list from the most to the least recently used.
+// Unused entries are kept at the least recently used end of the list, so
+// the entry at that end is always the one to take for a new pair.
+
+#define ADDRESS_CACHE_NULL_INDEX 0xFFFF
+
+static int32u addressCacheSavedCommands = 0;
+
+#if EZSP_HOST_ADDRESS_CACHE_SIZE > 0
+
+typedef struct {
+  EmberNodeId id;       // EMBER_NULL_NODE_ID if the entry is unused
+  EmberEUI64 eui64;
+  int16u nextById;
+  int16u nextByEui64;
+  int16u newer;
+  int16u older;
+} AddressCacheEntry;
+
+static AddressCacheEntry addressCache[EZSP_HOST_ADDRESS_CACHE_SIZE];
+static int16u addressCacheIdHeads[EZSP_HOST_ADDRESS_CACHE_SIZE];
+static int16u addressCacheEui64Heads[EZSP_HOST_ADDRESS_CACHE_SIZE];
+static int16u addressCacheNewest;
+static int16u addressCacheOldest;
+static boolean addressCacheReady = FALSE;
+
+// The NCP passes the EUI64 of a message's sender just before the message.
+static EmberEUI64 pendingSenderEui64;
+static boolean pendingSenderEui64IsValid = FALSE;
+
+#define addressCacheIdBucket(id) \
+  (&addressCacheIdHeads[(id) % EZSP_HOST_ADDRESS_CACHE_SIZE])
+
+static int16u *addressCacheEui64Bucket(EmberEUI64 eui64)
+{
+  int16u hash = 0;
+  int8u i;
+  for (i = 0; i < EUI64_SIZE; i++) {
+    hash = (hash * 31) + eui64[i];
+  }
+  return &addressCacheEui64Heads[hash % EZSP_HOST_ADDRESS_CACHE_SIZE];
+}
+
+static void addressCacheUnlinkUse(int16u index)
+{
+  AddressCacheEntry *entry = &addressCache[index];
+  if (entry->newer == ADDRESS_CACHE_NULL_INDEX) {
+    addressCacheNewest = entry->older;
+  } else {
+    addressCache[entry->newer].older = entry->older;
+  }
+  if (entry->older == ADDRESS_CACHE_NULL_INDEX) {
+    addressCacheOldest = entry->newer;
+  } else {
+    addressCache[entry->older].newer = entry->newer;
+  }
+}
+
+static void addressCacheMakeNewest(int16u index)
+{
+  AddressCacheEntry *entry = &addressCache[index];
+  addressCacheUnlinkUse(index);
+  entry->newer = ADDRESS_CACHE_NULL_INDEX;
+  entry->older = addressCacheNewest;
+  if (addressCacheNewest == ADDRESS_CACHE_NULL_INDEX) {
+    addressCacheOldest = index;
+  } else {
+    addressCache[addressCacheNewest].newer = index;
+  }
+  addressCacheNewest = index;
+}
+
+static void addressCacheMakeOldest(int16u index)
+{
+  AddressCacheEntry *entry = &addressCache[index];
+  addressCacheUnlinkUse(index);
+  entry->older = ADDRESS_CACHE_NULL_INDEX;
+  entry->newer = addressCacheOldest;
+  if (addressCacheOldest == ADDRESS_CACHE_NULL_INDEX) {
+    addressCacheNewest = index;
+  } else {
+    addressCache[addressCacheOldest].older = index;
+  }
+  addressCacheOldest = index;
+}
+
+static int16u addressCacheFindId(EmberNodeId id)
+{
+  int16u index = *addressCacheIdBucket(id);
+  while (index != ADDRESS_CACHE_NULL_INDEX && addressCache[index].id != id) {
+    index = addressCache[index].nextById;
+  }
+  return index;
+}
+
+static int16u addressCacheFindEui64(EmberEUI64 eui64)
+{
+  int16u index = *addressCacheEui64Bucket(eui64);
+  while (index != ADDRESS_CACHE_NULL_INDEX
+         && MEMCOMPARE(addressCache[index].eui64, eui64, EUI64_SIZE) != 0) {
+    index = addressCache[index].nextByEui64;
+  }
+  return index;
+}
+
+static void addressCacheForget(int16u index)
+{
+  AddressCacheEntry *entry = &addressCache[index];
+  int16u *link = addressCacheIdBucket(entry->id);
+  while (*link != index) {
+    link = &addressCache[*link].nextById;
+  }
+  *link = entry->nextById;
+  link = addressCacheEui64Bucket(entry->eui64);
+  while (*link != index) {
+    link = &addressCache[*link].nextByEui64;
+  }
+  *link = entry->nextByEui64;
+  entry->id = EMBER_NULL_NODE_ID;
+  addressCacheMakeOldest(index);
+}
+
+void ezspAddressCacheClear(void)
+{
+  int16u i;
+  for (i = 0; i < EZSP_HOST_ADDRESS_CACHE_SIZE; i++) {
+    addressCache[i].id = EMBER_NULL_NODE_ID;
+    addressCache[i].newer = (i == 0 ? ADDRESS_CACHE_NULL_INDEX : i - 1);
+    addressCache[i].older = (i + 1 == EZSP_HOST_ADDRESS_CACHE_SIZE
+                             ? ADDRESS_CACHE_NULL_INDEX
+                             : i + 1);
+    addressCacheIdHeads[i] = ADDRESS_CACHE_NULL_INDEX;
+    addressCacheEui64Heads[i] = ADDRESS_CACHE_NULL_INDEX;
+  }
+  addressCacheNewest = 0;
+  addressCacheOldest = EZSP_HOST_ADDRESS_CACHE_SIZE - 1;
+  addressCacheReady = TRUE;
+}
+
+void ezspAddressCacheAdd(EmberNodeId nodeId, EmberEUI64 eui64)
+{
+  AddressCacheEntry *entry;
+  int16u index;
+
+  // Broadcast and reserved addresses never belong to a node.
+  if (nodeId >= EMBER_BROADCAST_ADDRESS) {
+    return;
+  }
+  if (!addressCacheReady) {
+    ezspAddressCacheClear();
+  }
+
+  index = addressCacheFindEui64(eui64);
+  if (index != ADDRESS_CACHE_NULL_INDEX) {
+    if (addressCache[index].id == nodeId) {
+      addressCacheMakeNewest(index);
+      return;
+    }
+    addressCacheForget(index);
+  }
+  index = addressCacheFindId(nodeId);
+  if (index != ADDRESS_CACHE_NULL_INDEX) {
+    addressCacheForget(index);
+  }
+
+  index = addressCacheOldest;
+  entry = &addressCache[index];
+  if (entry->id != EMBER_NULL_NODE_ID) {
+    addressCacheForget(index);
+  }
+  entry->id = nodeId;
+  MEMCOPY(entry->eui64, eui64, EUI64_SIZE);
+  entry->nextById = *addressCacheIdBucket(nodeId);
+  *addressCacheIdBucket(nodeId) = index;
+  entry->nextByEui64 = *addressCacheEui64Bucket(eui64);
+  *addressCacheEui64Bucket(eui64) = index;
+  addressCacheMakeNewest(index);
+}
+
+EmberStatus ezspAddressCacheLookupEui64(EmberNodeId nodeId, EmberEUI64 eui64)
+{
+  int16u index;
+  if (!addressCacheReady) {
+    return EMBER_ERR_FATAL;
+  }
+  index = addressCacheFindId(nodeId);
+  if (index == ADDRESS_CACHE_NULL_INDEX) {
+    return EMBER_ERR_FATAL;
+  }
+  MEMCOPY(eui64, addressCache[index].eui64, EUI64_SIZE);
+  addressCacheMakeNewest(index);
+  return EMBER_SUCCESS;
+}
+
+EmberNodeId ezspAddressCacheLookupNodeId(EmberEUI64 eui64)
+{
+  int16u index;
+  if (!addressCacheReady) {
+    return EMBER_NULL_NODE_ID;
+  }
+  index = addressCacheFindEui64(eui64);
+  if (index == ADDRESS_CACHE_NULL_INDEX) {
+    return EMBER_NULL_NODE_ID;
+  }
+  addressCacheMakeNewest(index);
+  return addressCache[index].id;
+}
+
+// The functions below are called from callbackDispatch() before the
+// application's handlers.
+
+static void addressCacheStackStatus(EmberStatus status)
+{
+  if (status == EMBER_NETWORK_DOWN && addressCacheReady) {
+    ezspAddressCacheClear();
+  }
+}
+
+static void addressCacheIdConflict(EmberNodeId id)
+{
+  int16u index;
+  if (addressCacheReady) {
+    index = addressCacheFindId(id);
+    if (index != ADDRESS_CACHE_NULL_INDEX) {
+      addressCacheForget(index);
+    }
+  }
+}
+
+static void addressCacheSenderEui64(EmberEUI64 senderEui64)
+{
+  MEMCOPY(pendingSenderEui64, senderEui64, EUI64_SIZE);
+  pendingSenderEui64IsValid = TRUE;
+}
+
+static void addressCacheIncomingMessage(EmberApsFrame *apsFrame,
+                                        EmberNodeId sender,
+                                        int8u messageLength,
+                                        int8u *messageContents)
+{
+  if (pendingSenderEui64IsValid) {
+    pendingSenderEui64IsValid = FALSE;
+    ezspAddressCacheAdd(sender, pendingSenderEui64);
+  }
+  if (apsFrame->profileId != EMBER_ZDO_PROFILE_ID) {
+    return;
+  }
+  switch (apsFrame->clusterId) {
+  case END_DEVICE_ANNOUNCE:
+    // <sequence:1> <node id:2> <EUI64:8> <capabilities:1>
+    if (messageLength >= 11) {
+      ezspAddressCacheAdd(HIGH_LOW_TO_INT(messageContents[2],
+                                          messageContents[1]),
+                          messageContents + 3);
+    }
+    break;
+  case NETWORK_ADDRESS_RESPONSE:
+  case IEEE_ADDRESS_RESPONSE:
+    // <sequence:1> <status:1> <EUI64:8> <node id:2> ...
+    if (messageLength >= 12 && messageContents[1] == EMBER_ZDP_SUCCESS) {
+      ezspAddressCacheAdd(HIGH_LOW_TO_INT(messageContents[11],
+                                          messageContents[10]),
+                          messageContents + 2);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+#else
+
+void ezspAddressCacheClear(void)
+{
+}
+
+void ezspAddressCacheAdd(EmberNodeId nodeId, EmberEUI64 eui64)
+{
+}
+
+EmberStatus ezspAddressCacheLookupEui64(EmberNodeId nodeId, EmberEUI64 eui64)
+{
+  return EMBER_ERR_FATAL;
+}
+
+EmberNodeId ezspAddressCacheLookupNodeId(EmberEUI64 eui64)
+{
+  return EMBER_NULL_NODE_ID;
+}
+
+#define addressCacheStackStatus(status)
+#define addressCacheIdConflict(id)
+#define addressCacheSenderEui64(senderEui64)
+#define addressCacheIncomingMessage(apsFrame, sender, length, contents)
+
+#endif // EZSP_HOST_ADDRESS_CACHE_SIZE > 0
+
+int32u ezspAddressCacheSavedCommands(void)
+{
+  return addressCacheSavedCommands;
+}
+
+EmberStatus emberLookupEui64ByNodeId(EmberNodeId nodeId, EmberEUI64 eui64)
+{
+  EmberStatus status;
+  if (ezspAddressCacheLookupEui64(nodeId, eui64) == EMBER_SUCCESS) {
+    addressCacheSavedCommands++;
+    return EMBER_SUCCESS;
+  }
+  status = ezspLookupEui64ByNodeId(nodeId, eui64);
+  if (status == EMBER_SUCCESS) {
+    ezspAddressCacheAdd(nodeId, eui64);
+  }
+  return status;
+}
+
+EmberNodeId emberLookupNodeIdByEui64(EmberEUI64 eui64)
+{
+  EmberNodeId nodeId = ezspAddressCacheLookupNodeId(eui64);
+  if (nodeId != EMBER_NULL_NODE_ID) {
+    addressCacheSavedCommands++;
+    return nodeId;
+  }
+  nodeId = ezspLookupNodeIdByEui64(eui64);
+  if (nodeId != EMBER_NULL_NODE_ID) {
+    ezspAddressCacheAdd(nodeId, eui64);
+  }
+  return nodeId;
+}
+
 //------------------------------------------------------------------------------
 
 #include "command-functions.h"
@@ -437,9 +1622,41 @@ static void startCommand(int8u command)
 enum {
   RESPONSE_SUCCESS,
   RESPONSE_WAITING,
-  RESPONSE_ERROR
+  RESPONSE_ERROR,
+  RESPONSE_PIPELINED    // consumed by an asynchronous command's handler
 };
 
+// Removes the oldest pending asynchronous command and passes the result to
+// its handler.  The entry is released before the handler runs so that the
+// handler can send another command.
+static void completePendingCommand(EzspStatus status)
+{
+  EzspPendingCommand pending = pendingCommands[pendingHead];
+  pendingHead = (pendingHead + 1) % COMMAND_WINDOW_SIZE;
+  pendingCount--;
+  if (pending.handler != NULL) {
+    dispatchingResponse = TRUE;
+    pending.handler(status, pending.frameId, pending.sequence);
+    dispatchingResponse = FALSE;
+  }
+}
+
+// An error that is not tied to a particular response frame means that the
+// outstanding commands have been lost.
+static void failPendingCommands(EzspStatus status)
+{
+  while (pendingCount > 0) {
+    completePendingCommand(status);
+  }
+}
+
+static boolean isPendingResponse(void)
+{
+  return (pendingCount > 0
+          && (serialGetResponseByte(EZSP_SEQUENCE_INDEX)
+              == pendingCommands[pendingHead].sequence));
+}
+
 static int8u responseReceived(void)
 {
   EzspStatus status;
@@ -478,6 +1695,19 @@ static int8u responseReceived(void)
     ezspCallbackNetworkIndex =
         (responseFrameControl & EZSP_FRAME_CONTROL_NETWORK_INDEX_MASK)
          >> EZSP_FRAME_CONTROL_NETWORK_INDEX_OFFSET;
+
+    // Responses to pipelined commands go to their handlers rather than to
+    // the caller, which is waiting for a blocking command or a callback.
+    if (isPendingResponse()) {
+      if (status != EZSP_SUCCESS) {
+        EZSP_UART_TRACE("responseReceived(): ezspErrorHandler(): 0x%x", status);
+        ezspErrorHandler(status);
+      }
+      completePendingCommand(status);
+      return RESPONSE_PIPELINED;
+    }
+  } else {
+    failPendingCommands(status);
   }
   if (status != EZSP_SUCCESS) {
     EZSP_UART_TRACE("responseReceived(): ezspErrorHandler(): 0x%x", status);
@@ -488,9 +1718,37 @@ static int8u responseReceived(void)
   }
 }
 
-static void sendCommand(void)
+// Processes responses until fewer than limit asynchronous commands are
+// outstanding.  Returns FALSE if that would mean blocking inside a response
+// handler or a blocking command.
+static boolean waitForCommandWindow(int8u limit)
+{
+  int8u command[EZSP_MAX_FRAME_LENGTH];
+  int16u length;
+
+  if (pendingCount < limit) {
+    return TRUE;
+  } else if (sendingCommand || dispatchingResponse) {
+    return FALSE;
+  }
+  // Received responses are copied into ezspFrameContents, so set aside the
+  // command that is being built while we wait.
+  length = ezspWritePointer - ezspFrameContents;
+  MEMCOPY(command, ezspFrameContents, length);
+  while (pendingCount >= limit) {
+    if (responseReceived() == RESPONSE_WAITING) {
+      ezspWaitingForResponse();
+    }
+  }
+  MEMCOPY(ezspFrameContents, command, length);
+  ezspWritePointer = ezspFrameContents + length;
+  return TRUE;
+}
+
+// Fills in the sequence number and frame control of the command in
+// ezspFrameContents and hands it to the serial protocol.
+static EzspStatus transmitCommand(void)
 {
-  EzspStatus status;
   int16u length = ezspWritePointer - ezspFrameContents;
   serialSetCommandByte(EZSP_SEQUENCE_INDEX, ezspSequence);
   ezspSequence++;
@@ -500,20 +1758,31 @@ static void sendCommand(void)
                         | ezspApplicationNetworkIndex // we always set the network index in the
                           << EZSP_FRAME_CONTROL_NETWORK_INDEX_OFFSET)); // ezsp frame control.
   if (length > EZSP_MAX_FRAME_LENGTH) {
-    EZSP_UART_TRACE("sendCommand(): ezspErrorHandler(): EZSP_ERROR_COMMAND_TOO_LONG");
-    ezspErrorHandler(EZSP_ERROR_COMMAND_TOO_LONG);
-    return;
+    return EZSP_ERROR_COMMAND_TOO_LONG;
   }
   serialSetCommandLength(length);
+  return serialSendCommand();
+}
+
+static void sendCommand(void)
+{
+  EzspStatus status;
+  int8u result;
   // Ensure that a second command is not sent before the response to the first
   // command has been processed.
   assert(!sendingCommand);
+  // Pipelined commands ahead of this one count against the window.  Their
+  // responses arrive first and are passed to their handlers while we wait.
+  (void)waitForCommandWindow(COMMAND_WINDOW_SIZE);
   sendingCommand = TRUE;
-  status = serialSendCommand();
+  status = transmitCommand();
   if (status == EZSP_SUCCESS) {
-    while (responseReceived() == RESPONSE_WAITING) {
-      ezspWaitingForResponse();
-    }
+    do {
+      result = responseReceived();
+      if (result == RESPONSE_WAITING) {
+        ezspWaitingForResponse();
+      }
+    } while (result == RESPONSE_WAITING || result == RESPONSE_PIPELINED);
   } else {
     EZSP_UART_TRACE("sendCommand(): ezspErrorHandler(): 0x%x", status);
     ezspErrorHandler(status);
@@ -521,6 +1790,85 @@ static void sendCommand(void)
   sendingCommand = FALSE;
 }
 
+static EzspStatus sendCommandAsync(EzspResponseHandler handler)
+{
+  EzspStatus status;
+  EzspPendingCommand *pending;
+  // A blocking command that is waiting for its response occupies one slot.
+  if (!waitForCommandWindow(sendingCommand
+                            ? COMMAND_WINDOW_SIZE - 1
+                            : COMMAND_WINDOW_SIZE)) {
+    return EZSP_ERROR_QUEUE_FULL;
+  }
+  pending = &pendingCommands[(pendingHead + pendingCount)
+                             % COMMAND_WINDOW_SIZE];
+  pending->sequence = ezspSequence;
+  pending->frameId = ezspFrameContents[EZSP_FRAME_ID_INDEX];
+  pending->handler = handler;
+  status = transmitCommand();
+  if (status == EZSP_SUCCESS) {
+    pendingCount++;
+  } else {
+    EZSP_UART_TRACE("sendCommandAsync(): 0x%x", status);
+  }
+  return status;
+}
+
+int8u ezspPendingCommandCount(void)
+{
+  return pendingCount;
+}
+
+void ezspWaitForPendingCommands(void)
+{
+  assert(!sendingCommand && !dispatchingResponse);
+  while (pendingCount > 0) {
+    if (responseReceived() == RESPONSE_WAITING) {
+      ezspWaitingForResponse();
+    }
+  }
+}
+
+EzspStatus ezspSendCommandAsync(int8u frameId,
+                                int8u parametersLength,
+                                int8u *parameters,
+                                EzspResponseHandler handler)
+{
+  startCommand(frameId);
+  appendInt8uArray(parametersLength, parameters);
+  return sendCommandAsync(handler);
+}
+
+EzspStatus ezspSetValueAsync(EzspValueId valueId,
+                             int8u valueLength,
+                             int8u *value,
+                             EzspResponseHandler handler)
+{
+  startCommand(EZSP_SET_VALUE);
+  appendInt8u(valueId);
+  appendInt8u(valueLength);
+  appendInt8uArray(valueLength, value);
+  return sendCommandAsync(handler);
+}
+
+EzspStatus ezspSendUnicastAsync(EmberOutgoingMessageType type,
+                                EmberNodeId indexOrDestination,
+                                EmberApsFrame *apsFrame,
+                                int8u messageTag,
+                                int8u messageLength,
+                                int8u *messageContents,
+                                EzspResponseHandler handler)
+{
+  startCommand(EZSP_SEND_UNICAST);
+  appendInt8u(type);
+  appendInt16u(indexOrDestination);
+  appendEmberApsFrame(apsFrame);
+  appendInt8u(messageTag);
+  appendInt8u(messageLength);
+  appendInt8uArray(messageLength, messageContents);
+  return sendCommandAsync(handler);
+}
+
 static void callbackPointerInit(void)
 {
 #ifndef EZSP_DISABLE_CALLBACK_COPY
@@ -539,10 +1887,16 @@ static int8u *fetchInt8uPointer(int8u length)
 void ezspTick(void)
 {
   int8u count = serialPendingResponseCount() + 1;
+  int8u result;
   // Ensure that we are not being called from within a command.
   assert(!sendingCommand);
-  while (count > 0 && responseReceived() == RESPONSE_SUCCESS) {
-    callbackDispatch();
+  while (count > 0) {
+    result = responseReceived();
+    if (result == RESPONSE_SUCCESS) {
+      callbackDispatch();
+    } else if (result != RESPONSE_PIPELINED) {
+      break;
+    }
     count--;
   }
   simulatedTimePasses();
@@ -39,6 +39,13 @@ boolean ezspOkToSleep(void);
 // layer to handle asynchronous events.
 void ezspTick(void);
 
+// Waits up to timeoutMs for the NCP to send something, so that a Host with
+// nothing to do but wait for the NCP (for instance while it is busy with ECC)
+// need not call ezspTick() in a tight loop.  Returns early if there is
+// already input to process or an ASH timer needs servicing.  For ezsp-spi
+// this returns immediately.
+void ezspWaitForNcp(int32u timeoutMs);
+
 // The EZSP layer calls this function after sending a command while waiting for
 // the response. The Host application can use this function to perform any tasks
 // that do not involve the EM260.
@@ -56,6 +63,172 @@ void ezspErrorHandler(EzspStatus status);
 // EM260.
 void ezspClose(void);
 
+//----------------------------------------------------------------
+// Pipelined commands
+//
+// The asynchronous functions below send a command and return as soon as it
+// has been handed to the serial protocol, without waiting for the response.
+// Up to EZSP_HOST_COMMAND_WINDOW_SIZE commands may be outstanding at once
+// (uart only; SPI allows one).  If the window is full they first process
+// responses until a slot frees up.  Responses are passed to the command's
+// handler from within ezspTick(), ezspWaitForPendingCommands() or while a
+// blocking command waits for its own response.  The blocking EZSP functions
+// may be freely mixed with the asynchronous ones.
+
+// Called with the response to a command sent asynchronously. If status is
+// EZSP_SUCCESS the response parameters can be read with fetchInt8u() and the
+// other fetch functions in ezsp-frame-utilities.h, exactly as in the blocking
+// functions.  Otherwise the command failed and there are no parameters. The
+// handler may send further asynchronous commands, but it must not call a
+// blocking EZSP function and must finish reading the response first.
+typedef void (*EzspResponseHandler)(EzspStatus status,
+                                    int8u frameId,
+                                    int8u sequence);
+
+// Sends an arbitrary command frame.  The parameters are the serialized
+// command parameters as they appear after the frame ID.  Returns
+// EZSP_SUCCESS if the command was sent, EZSP_ERROR_QUEUE_FULL if called from
+// a response handler while the window is full, or a serial protocol error.
+EzspStatus ezspSendCommandAsync(int8u frameId,
+                                int8u parametersLength,
+                                int8u *parameters,
+                                EzspResponseHandler handler);
+
+// Asynchronous versions of ezspSetValue() and ezspSendUnicast().  The
+// EmberStatus (and for a unicast, the APS sequence number) are read from the
+// response in the handler.
+EzspStatus ezspSetValueAsync(EzspValueId valueId,
+                             int8u valueLength,
+                             int8u *value,
+                             EzspResponseHandler handler);
+EzspStatus ezspSendUnicastAsync(EmberOutgoingMessageType type,
+                                EmberNodeId indexOrDestination,
+                                EmberApsFrame *apsFrame,
+                                int8u messageTag,
+                                int8u messageLength,
+                                int8u *messageContents,
+                                EzspResponseHandler handler);
+
+// Returns the number of asynchronous commands awaiting a response.
+int8u ezspPendingCommandCount(void);
+
+// Blocks until every asynchronous command has completed.
+void ezspWaitForPendingCommands(void);
+
+//----------------------------------------------------------------
+// Binding table mirror
+//
+// emberSetBinding(), emberGetBinding(), emberDeleteBinding() and
+// emberClearBindingTable() keep a copy of the NCP's binding table on the
+// host, of up to EZSP_HOST_BINDING_TABLE_MIRROR_SIZE entries, together with
+// the remote binding callbacks.  emberGetBinding() is answered from the copy
+// without a command.  The binding commands are available without the copy
+// as ezspSetBinding() etc.
+
+// Reads the whole binding table from the NCP into the copy.  This happens
+// when the copy is first needed, but should be done again after the NCP is
+// reset.  Returns the number of entries copied.
+int8u ezspBindingMirrorLoad(void);
+
+// Returns the index of the next binding in use after index, which is 0xFF to
+// start the search, with the given local endpoint and cluster, or 0xFF if
+// there are no more.  The binding is copied to entry.  Bindings are found in
+// index order.
+int8u ezspFindBinding(int8u index,
+                      int8u localEndpoint,
+                      int16u clusterId,
+                      EmberBindingTableEntry *entry);
+
+// Returns the number of binding table reads the copy has answered without a
+// command to the NCP.  A search with ezspFindBinding() counts as a read of
+// every entry, as that is what it replaces.
+int32u ezspBindingMirrorSavedCommands(void);
+
+// Returns a number that changes whenever the binding table is changed by the
+// functions above or by a remote device, or the copy is loaded again, so
+// that anything derived from the table can tell that it is out of date.
+int16u ezspBindingTableVersion(void);
+
+//----------------------------------------------------------------
+// Stack table mirrors
+//
+// ezspGetChildData(), emberGetNeighbor(), emberNeighborCount() and
+// emberGetRouteTableEntry() keep a copy of what they read from the NCP and
+// answer later reads from it without a command.  The child table copy is
+// kept up to date by the child join callback, and all copies are dropped
+// when the stack status changes.  The NCP changes its neighbor and route
+// tables without telling the host, so those copies are only used for
+// EZSP_HOST_TABLE_MIRROR_MAX_AGE_MS, and a route error drops the routes to
+// its target.  The commands are available without the copies as
+// ezspReadChildData(), ezspReadNeighbor() etc.  emberGetKeyTableEntry()
+// always reads from the NCP, so that the frame counters it returns are
+// current.
+
+enum {
+  EZSP_CHILD_TABLE_MIRROR,
+  EZSP_NEIGHBOR_TABLE_MIRROR,
+  EZSP_ROUTE_TABLE_MIRROR,
+  EZSP_TABLE_MIRROR_COUNT
+};
+
+// Passed to ezspTableMirrorInvalidate() in place of a table.
+#define EZSP_ALL_TABLE_MIRRORS 0xFF
+
+// Reads the count entries of a table from index start that are not already
+// in the copy.  The reads are pipelined through the command window, so a
+// whole table takes a fraction of the round trips that reading it entry by
+// entry does.  Returns the number of entries of the range held by the copy
+// afterwards.  Entries past the end of the copy are not read.  This must not
+// be called from a response handler or while a command is waiting for its
+// response, and waits for any other pipelined commands to complete.
+int8u ezspTableMirrorSnapshot(int8u table, int8u start, int8u count);
+
+// Drops the copy of a table, or of all of them.  This should be done after
+// the NCP is reset.
+void ezspTableMirrorInvalidate(int8u table);
+
+// Returns a number that changes whenever an entry in the copy of a table is
+// changed or dropped, so that a reader can tell whether it needs to look at
+// the table again.
+int16u ezspTableMirrorVersion(int8u table);
+
+// Returns the number of stack table reads the copies have answered without a
+// command to the NCP.
+int32u ezspTableMirrorSavedCommands(void);
+
+//----------------------------------------------------------------
+// Address cache
+//
+// emberLookupEui64ByNodeId() and emberLookupNodeIdByEui64() are answered
+// from a cache of up to EZSP_HOST_ADDRESS_CACHE_SIZE node id and EUI64
+// pairs, and go to the NCP only for a pair the host has not seen.  Pairs
+// are learned from child joins, trust center joins, incoming messages that
+// carry the sender's EUI64, device announcements, ZDO network and IEEE
+// address responses and the lookups themselves.  A pair is replaced when
+// either half turns up with a new partner, and when the cache is full the
+// least recently used pair is forgotten.  An id conflict forgets the id and
+// the network going down empties the cache.  The commands are available
+// without the cache as ezspLookupEui64ByNodeId() and
+// ezspLookupNodeIdByEui64().
+
+// Remembers a pair that the application has learned some other way.
+void ezspAddressCacheAdd(EmberNodeId nodeId, EmberEUI64 eui64);
+
+// Looks up the EUI64 of a node in the cache only.  Returns EMBER_SUCCESS if
+// it is known and EMBER_ERR_FATAL if not.
+EmberStatus ezspAddressCacheLookupEui64(EmberNodeId nodeId, EmberEUI64 eui64);
+
+// Looks up the node id of an EUI64 in the cache only.  Returns
+// EMBER_NULL_NODE_ID if it is not known.
+EmberNodeId ezspAddressCacheLookupNodeId(EmberEUI64 eui64);
+
+// Forgets every pair.
+void ezspAddressCacheClear(void);
+
+// Returns the number of lookups the cache has answered without a command to
+// the NCP.
+int32u ezspAddressCacheSavedCommands(void);
+
 //----------------------------------------------------------------
 // Functions with special handling
 
@@ -78,6 +251,19 @@ EmberStatus emberStopWritingStackTokens(void);
 EmberStatus emberSetExtendedSecurityBitmask(EmberExtendedSecurityBitmask mask);
 EmberStatus emberGetExtendedSecurityBitmask(EmberExtendedSecurityBitmask* mask);
 EmberStatus emberSetNodeId(EmberNodeId nodeId);
+EmberStatus emberClearBindingTable(void);
+EmberStatus emberSetBinding(int8u index, EmberBindingTableEntry *value);
+EmberStatus emberGetBinding(int8u index, EmberBindingTableEntry *value);
+EmberStatus emberDeleteBinding(int8u index);
+EmberStatus ezspGetChildData(int8u index,
+                             EmberNodeId *childId,
+                             EmberEUI64 childEui64,
+                             EmberNodeType *childType);
+EmberStatus emberGetNeighbor(int8u index, EmberNeighborTableEntry *value);
+int8u emberNeighborCount(void);
+EmberStatus emberGetRouteTableEntry(int8u index, EmberRouteTableEntry *value);
+EmberNodeId emberLookupNodeIdByEui64(EmberEUI64 eui64);
+EmberStatus emberLookupEui64ByNodeId(EmberNodeId nodeId, EmberEUI64 eui64);
 void emberSetMaximumIncomingTransferSize(int16u size);
 void emberSetMaximumOutgoingTransferSize(int16u size);
 void emberSetDescriptorCapability(int8u capability);
@@ -85,6 +271,13 @@ int8u emberGetLastStackZigDevRequestSequence(void);
 EmberStatus emberSendUnicastNetworkKeyUpdate(EmberNodeId targetShort,
                                              EmberEUI64  targetLong,
                                              EmberKeyData* newKey);
+void emberAesMmoHashInit(EmberAesMmoHashContext *context);
+EmberStatus emberAesMmoHashUpdate(EmberAesMmoHashContext *context,
+                                  int32u length,
+                                  const int8u *data);
+EmberStatus emberAesMmoHashFinal(EmberAesMmoHashContext *context,
+                                 int32u length,
+                                 const int8u *finalData);
 EmberStatus emberAesHashSimple(int8u totalLength,
                                const int8u* data,
                                int8u* result);
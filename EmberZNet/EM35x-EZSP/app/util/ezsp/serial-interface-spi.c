@@ -46,6 +46,11 @@ boolean ezspCallbackPending(void)
   }
 }
 
+void ezspWaitForNcp(int32u timeoutMs)
+{
+  // The SPI driver has nothing to wait on; the caller polls with ezspTick().
+}
+
 void ezspWakeUp(void)
 {
   halNcpWakeUp();
@@ -7,6 +7,8 @@
 
 #include PLATFORM_HEADER
 
+#include <sys/select.h>
+
 #include "stack/include/ember-types.h"
 
 #include "hal/hal.h"
@@ -27,7 +29,10 @@
 //------------------------------------------------------------------------------
 // Global Variables
 
-static boolean waitingForResponse = FALSE;
+// The number of commands sent whose response has not yet been collected. The
+// EZSP layer may pipeline several commands (see ezsp.h); their responses
+// arrive in order.
+static int8u responsesPending = 0;
 static int16u waitStartTime;
 #define WAIT_FOR_RESPONSE_TIMEOUT (ASH_MAX_TIMEOUTS * ashReadConfig(ackTimeMax))
 
@@ -43,6 +48,7 @@ EzspStatus ezspInit(void)
 {
   EzspStatus status;
   int8u i;
+  responsesPending = 0;
   for (i = 0; i < 5; i++) {
     status = ashResetNcp();
     if (status != EZSP_SUCCESS) {
@@ -63,6 +69,34 @@ boolean ezspCallbackPending(void)
 }
 
 
+void ezspWaitForNcp(int32u timeoutMs)
+{
+  int fd = ashSerialGetFd();
+  int16u timerMs = ashMsToNextTimer();
+  fd_set readSet;
+  struct timeval timeout;
+
+  if (fd < 0
+      || ncpHasCallbacks
+      || ashSerialInputIsBuffered()
+      || !ashQueueIsEmpty(&rxQueue)) {
+    return;
+  }
+  if (timerMs < timeoutMs) {
+    timeoutMs = timerMs;
+  }
+  if (timeoutMs == 0) {
+    return;
+  }
+  FD_ZERO(&readSet);
+  FD_SET(fd, &readSet);
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_usec = (timeoutMs % 1000) * 1000;
+  // Readable data, a timeout and an interrupted wait are all handled by the
+  // caller's next ezspTick().
+  select(fd + 1, &readSet, NULL, NULL, &timeout);
+}
+
 void ezspClose(void)
 {
   ashSerialClose();
@@ -102,10 +136,10 @@ EzspStatus serialResponseReceived(void)
                         status);
     return status;
   }
-  if (waitingForResponse
+  if (responsesPending > 0
       && elapsedTimeInt16u(waitStartTime, halCommonGetInt16uMillisecondTick())
          > WAIT_FOR_RESPONSE_TIMEOUT) {
-    waitingForResponse = FALSE;
+    responsesPending = 0;
     ashTraceEzspFrameId("no response", ezspFrameContents);
     ashTraceEzspVerbose("serialResponseReceived(): EZSP_ERROR_NO_RESPONSE");
     return EZSP_ERROR_NO_RESPONSE;
@@ -117,7 +151,7 @@ EzspStatus serialResponseReceived(void)
     // callback flag to ignore asynchronous callbacks. This allows our caller
     // to assume that no callbacks will appear between sending a command and
     // receiving its response.
-    if (waitingForResponse
+    if (responsesPending > 0
         && (buffer->data[EZSP_FRAME_CONTROL_INDEX]
             & EZSP_FRAME_CONTROL_ASYNCH_CB)
          ) {
@@ -138,7 +172,11 @@ EzspStatus serialResponseReceived(void)
       ashTraceEzspVerbose("serialResponseReceived(): ashFreeBuffer(): %u", buffer);
       buffer = NULL;
       status = EZSP_SUCCESS;
-      waitingForResponse = FALSE;
+      if (responsesPending > 0) {
+        responsesPending--;
+        // Time the next pipelined response from the arrival of this one.
+        waitStartTime = halCommonGetInt16uMillisecondTick();
+      }
     }
   }
   if (dropBuffer != NULL) {
@@ -165,11 +203,13 @@ EzspStatus serialSendCommand()
     ashTraceEzspVerbose("serialSendCommand(): ashSend(): 0x%x", status);
     return status;
   }
-  waitingForResponse = TRUE;
+  if (responsesPending == 0) {
+    waitStartTime = halCommonGetInt16uMillisecondTick();
+  }
+  responsesPending++;
   ashTraceEzspVerbose("serialSendCommand(): ID=0x%x Seq=0x%x",
                       ezspFrameContents[EZSP_FRAME_ID_INDEX],
                       ezspFrameContents[EZSP_SEQUENCE_INDEX]);
-  waitStartTime = halCommonGetInt16uMillisecondTick();
   return status;
 }
 
@@ -41,6 +41,11 @@ EmberStatus backchannelSend(int8u port, int8u * data, int8u length)
   return EMBER_LIBRARY_NOT_PRESENT;
 }
 
+int backchannelGetConnectionFd(int8u port)
+{
+  return -1;
+}
+
 EmberStatus backchannelGetConnection(int8u port, 
                                      boolean remapStdinStdout)
 {
@@ -226,6 +226,16 @@ EmberStatus backchannelSend(int8u port, int8u * data, int8u length)
   return EMBER_INVALID_CALL;
 }
 
+// Returns the socket of the current client connection, or INVALID_FD if there
+// is none.  The serial layer reads client input from its own copy of this.
+int backchannelGetConnectionFd(int8u port)
+{
+  if (!backchannelEnable || port > 1) {
+    return INVALID_FD;
+  }
+  return clientFd[port];
+}
+
 // Checks on the state of the current backchannel connection.
 // If one doesn't exist, it can wait for a new connection and return
 // the result.
@@ -17,6 +17,7 @@ EmberStatus backchannelStartServer(int8u port);
 EmberStatus backchannelStopServer(int8u port);
 EmberStatus backchannelReceive(int8u port, char* data);
 EmberStatus backchannelSend(int8u port, int8u * data, int8u length);
+int backchannelGetConnectionFd(int8u port);
 
 EmberStatus backchannelClientConnectionCleanup(int8u port);
 
@@ -176,3 +176,91 @@ char* transformEmberPrintfToStandardPrintf(const char* input,
   return newFormatString;
 }
 
+
+//------------------------------------------------------------------------------
+// Converted format cache
+
+// Format strings are nearly always literals, so the same few hundred pointers
+// are converted over and over.  Converted strings are kept in a hash table
+// keyed on the pointer.  A pointer may also be a buffer that is reused for
+// different formats, so a copy of the whole original is kept and compared
+// before a cached conversion is used.
+
+#ifndef EMBER_PRINTF_CONVERT_CACHE_SIZE
+  #define EMBER_PRINTF_CONVERT_CACHE_SIZE 256    // must be a power of two
+#endif
+
+#define CACHE_PROBE_LIMIT 4
+
+typedef struct {
+  const char* input;
+  char* original;
+  char* converted;
+  boolean filterSlashR;
+} ConvertCacheEntry;
+
+static ConvertCacheEntry convertCache[EMBER_PRINTF_CONVERT_CACHE_SIZE];
+
+static int16u convertCacheHash(const char* input, boolean filterSlashR)
+{
+  int32u hash = (int32u)((unsigned long)input >> 2) * 2654435761UL;
+  return (int16u)(((hash >> 16) ^ filterSlashR)
+                  & (EMBER_PRINTF_CONVERT_CACHE_SIZE - 1));
+}
+
+static void convertCacheFree(ConvertCacheEntry* entry)
+{
+  free(entry->original);
+  free(entry->converted);
+  entry->input = NULL;
+  entry->original = NULL;
+  entry->converted = NULL;
+}
+
+// Returns the converted form of an Ember printf format, converting it only
+// the first time it is seen.  The string belongs to the cache and stays valid
+// until the next call.  The cache is not locked, so this must only be called
+// from one thread.
+const char* transformEmberPrintfToStandardPrintfCached(const char* input,
+                                                       boolean filterSlashR)
+{
+  int16u home = convertCacheHash(input, filterSlashR);
+  ConvertCacheEntry* slot = NULL;
+  ConvertCacheEntry* entry;
+  size_t length;
+  int8u i;
+
+  for (i = 0; i < CACHE_PROBE_LIMIT; i++) {
+    entry = &convertCache[(home + i) & (EMBER_PRINTF_CONVERT_CACHE_SIZE - 1)];
+    if (entry->input == input && entry->filterSlashR == filterSlashR) {
+      if (strcmp(entry->original, input) == 0) {
+        return entry->converted;
+      }
+      slot = entry;
+      break;
+    }
+    if (slot == NULL && entry->input == NULL) {
+      slot = entry;
+    }
+  }
+
+  // Not found, so convert it and replace either the stale entry for this
+  // pointer, an empty entry, or the entry in the home slot.
+  if (slot == NULL) {
+    slot = &convertCache[home];
+  }
+  convertCacheFree(slot);
+  slot->converted = transformEmberPrintfToStandardPrintf(input, filterSlashR);
+  length = strlen(input) + 1;   // add 1 for '\0'
+  slot->original = malloc(length);
+  if (slot->original != NULL) {
+    MEMCOPY(slot->original, input, length);
+  }
+  if (slot->converted == NULL || slot->original == NULL) {
+    convertCacheFree(slot);
+    return NULL;
+  }
+  slot->input = input;
+  slot->filterSlashR = filterSlashR;
+  return slot->converted;
+}
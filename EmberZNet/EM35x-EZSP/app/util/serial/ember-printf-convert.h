@@ -7,3 +7,10 @@
 // must free. 
 char* transformEmberPrintfToStandardPrintf(const char* input, 
                                            boolean filterSlashR);
+
+// Like transformEmberPrintfToStandardPrintf(), but keeps the converted string
+// so that later calls with the same format need not convert it again.  The
+// string belongs to the cache and must not be freed.  Returns NULL if it
+// failed to allocate memory.
+const char* transformEmberPrintfToStandardPrintfCached(const char* input,
+                                                       boolean filterSlashR);
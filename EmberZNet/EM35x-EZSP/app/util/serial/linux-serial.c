@@ -24,7 +24,7 @@
 #include <sys/stat.h>          // ""
 #include <fcntl.h>             // for fcntl()
 #include <stdlib.h>      
-#include <unistd.h>            // for pipe(), fork()
+#include <unistd.h>            // for pipe(), read()
 
 #if defined NO_READLINE
   #define READLINE_SUPPORT 0
@@ -38,7 +38,11 @@
 #include <signal.h>            // for trapping SIGTERM
 #include <errno.h>             // for strerror() and errno
 #include <stdarg.h>            // for vfprintf()
-#include <sys/wait.h>          // for wait()
+#include <pthread.h>           // for the input and output threads
+#include <semaphore.h>         // ""
+#if defined(__linux__)
+  #include <sys/eventfd.h>     // for eventfd()
+#endif
 
 // All needed For ashSerialGetFd()
 #include "app/util/ezsp/ezsp-protocol.h"
@@ -56,6 +60,12 @@
 #include "linux-serial.h"
 #include "ember-printf-convert.h"
 
+// Output to stdout may be handed to a separate thread through a ring buffer
+// of this many bytes, a power of two.  Zero writes it directly, as before.
+#ifndef EMBER_SERIAL_ASYNC_OUTPUT_SIZE
+  #define EMBER_SERIAL_ASYNC_OUTPUT_SIZE 0
+#endif
+
 // Don't like readline and the GPL requirements?  Use 'libedit'.
 // It is a call-for-call compatible with the readline library but is
 // released under the BSD license.
@@ -66,33 +76,51 @@
 
 #define NUM_PORTS              2
 #define INVALID_FD             -1
-#define INVALID_PID            0
 #define MAX_PROMPT_LENGTH      20
 #define MAX_NUMBER_OF_COMMANDS 500
 #define LINE_FEED              0x0A
 #define EOF_CHAR               0x04
 #define MAX_STRING_LENGTH      250  // arbitrary limit
+#define INPUT_QUEUE_SIZE       512  // a power of two, longer than any line
+#define INPUT_WAIT_US          1000
 
 static int STDIN = 0;
 
-// The first index is the port, the second
-// is the pipe number.  The first two are the data pipes,
-// the second two are the control pipes.
-static int pipeFileDescriptors[NUM_PORTS][4] = { 
-  { INVALID_FD, INVALID_FD, INVALID_FD, INVALID_FD },
-  { INVALID_FD, INVALID_FD, INVALID_FD, INVALID_FD }
-};
-#define DATA_READER(__port) pipeFileDescriptors[(__port)][0]
-#define DATA_WRITER(__port) pipeFileDescriptors[(__port)][1]
-#define CONTROL_READER(__port) pipeFileDescriptors[(__port)][2]
-#define CONTROL_WRITER(__port) pipeFileDescriptors[(__port)][3]
-
-static boolean amParent = TRUE;
+// Each port's input is read by a thread of its own, which can block in
+// readline() or read() without holding up the main loop.  The thread copies
+// what it reads into a ring buffer that the application reads from.  Only the
+// input thread moves head and only the application moves tail, so the ring
+// needs no lock.
+//
+// After adding to the ring the thread counts a signal in posted and then
+// signals wakeFd, so that a gateway can wait for input along with its other
+// file descriptors.  The application counts the signals it reads from wakeFd
+// in cleared, and only reads wakeFd when the two differ, so checking for
+// input costs no system call.
+typedef struct {
+  boolean active;               // started and not yet joined
+  boolean ended;                // the thread has stopped reading
+  boolean inReadline;
+  pthread_t thread;
+  sem_t goAhead;                // posted by the application for each line
+  int fd;                       // what the thread reads from
+  FILE* in;                     // for readline() on a backchannel client
+  FILE* out;
+  int wakeFd;
+  int wakeWriteFd;
+  int32u posted;
+  int32u cleared;
+  int32u head;
+  int32u tail;
+  char buffer[INPUT_QUEUE_SIZE];
+} InputPort;
+
+static InputPort inputPorts[NUM_PORTS];
+
 static boolean useControlChannel = TRUE;
 static boolean debugOn = FALSE;
 static boolean promptSet = FALSE;
 static char prompt[MAX_PROMPT_LENGTH];
-static pid_t childPid[NUM_PORTS] = { INVALID_PID, INVALID_PID };
 
 static boolean usingCommandInterpreter = FALSE;
 
@@ -109,18 +137,19 @@ static const EmberCommandEntry* allCommands = NULL;
 static const char readlineHistoryFilename[] = ".linux-serial.history";
 static char readlineHistoryPath[MAX_STRING_LENGTH];
 
-static int childProcessPort = -1;
-
 //------------------------------------------------------------------------------
 // Forward Declarations
 
 static EmberStatus serialInitInternal(int8u port);
-static void childRun(int8u port);
+static void inputStop(int8u port);
 static void setNonBlockingFD(int fd);
 static void debugPrint(const char* formatString, ...);
-static void processSerialInput(int8u port);
+static void* processSerialInput(void* context);
 static void shiftStringRight(char* string, int8u length, int8u charsToShift);
 static EmberStatus internalPrintf(PGM_P formatString, va_list ap);
+static EmberStatus stdoutVprintf(const char* formatString, va_list ap);
+static EmberStatus stdoutWrite(const int8u* data, int16u length);
+static void stdoutFlush(void);
 
 #if READLINE_SUPPORT
   char** commandCompletion(const char *text, int start, int end);
@@ -135,17 +164,14 @@ static char* duplicateString(const char* source);
   #define add_history(x)
 #endif
 
-static void parentCleanupAfterChildDied(void);
 static void installSignalHandler(void);
-static void childCleanupAndExit(void);
-static void handleBackchannelConnection(int8u port);
 
 //------------------------------------------------------------------------------
 // Initialization Functions
 
 // In order to handle input more effeciently and cleanly,
-// we use readline().  This is a blocking call, so we create a second
-// process to handle the serial input while the main one can simply
+// we use readline().  This is a blocking call, so we create a thread
+// to handle the serial input while the main one can simply
 // loop executing ezspTick() and other functionality.
 
 EmberStatus emberSerialInit(int8u port, 
@@ -160,7 +186,7 @@ EmberStatus emberSerialInit(int8u port,
     return EMBER_SERIAL_INVALID_PORT;
   }
 
-  if (childPid[port] != INVALID_PID) {
+  if (inputPorts[port].active) {
     debugPrint("Serial port %d already initialized.\n", port);
     return EMBER_SUCCESS;
   }
@@ -181,8 +207,8 @@ EmberStatus emberSerialInit(int8u port,
       debugPrint("Failed to get new backchannel connection.\n");
       return EMBER_ERR_FATAL;
     } else if ( !(state == NEW_CONNECTION || state == CONNECTION_EXISTS) ) {
-      // We will defer initializing the RAW serial port (spawning the child
-      // and that jazz) until we actually have a new client connection.
+      // We will defer initializing the RAW serial port (starting the input
+      // thread and that jazz) until we actually have a new client connection.
       return EMBER_SUCCESS;
     }
   }
@@ -197,85 +223,120 @@ EmberStatus emberSerialInit(int8u port,
   return status;
 }
 
-static EmberStatus serialInitInternal(int8u port)
+static void createWakeFd(InputPort* input)
 {
-  // Create two pipes, control and data.
-  // Fork
-  // Parent closes the write end of the data pipe and read end of the control, 
-  //   child closes the read end of the data pipe and write end of the control.
-  // Child sits and waits for input via readline() (or read())
-  //   When it receives input it writes it to the data pipe.  It then blocks
-  //   on a read call to the control pipe (if it is running the CLI).
-  // Parent loops normally, calling emberSerialReadByte() or emberSeriaReadLine()
-  //   to get the input.  These calls map to reads of the data pipe, the former
-  //   would NOT be blocking while the latter would be.
-  //   Parent calls indirectly readyForSerialInput() after reading an entire 
-  //   line of data (via the next emberSerialReadByte()).
+#if defined(__linux__)
+  input->wakeFd = eventfd(0, EFD_NONBLOCK);
+  input->wakeWriteFd = input->wakeFd;
+  if (input->wakeFd < 0) {
+#else
+  int fds[2];
+  if (pipe(fds) == 0) {
+    input->wakeFd = fds[0];
+    input->wakeWriteFd = fds[1];
+    setNonBlockingFD(input->wakeFd);
+  } else {
+#endif
+    fprintf(stderr,
+            "FATAL: Could not create input wakeup (%d): %s\n",
+            errno,
+            strerror(errno));
+    assert(FALSE);
+  }
+}
 
+static EmberStatus serialInitInternal(int8u port)
+{
+  // The input thread reads a line with readline() (or read()) and copies
+  // it into the port's ring buffer.  For the CLI it then waits on goAhead
+  // until the application has read the whole line, so that the prompt comes
+  // after the output of the command.  The application calls
+  // emberSerialReadByte() or emberSerialReadLine() to get the input, which
+  // never block, and posts goAhead via readyForSerialInput() after reading
+  // an entire line of data (via the next emberSerialReadByte()).
+
+  InputPort* input = &inputPorts[port];
+  static boolean wakeFdsCreated = FALSE;
   int status;
-  int i;
-  pid_t pid;
-
-  for (i = 0; i < 2; i++) {
-    char* string = (i == 0
-                    ? "data"
-                    : "control");
-    int* pipePtr = (i == 0
-                    ? &(pipeFileDescriptors[port][0])
-                    : &(pipeFileDescriptors[port][2])); 
-    status = pipe(pipePtr);
-    if (status != 0) {
-      fprintf(stderr, 
-              "FATAL: Could not create %s pipe (%d): %s",
-              string,
-              status,
-              strerror(status));
-      assert(FALSE);
+
+  if (!wakeFdsCreated) {
+    int8u i;
+    for (i = 0; i < NUM_PORTS; i++) {
+      createWakeFd(&inputPorts[i]);
     }
-    debugPrint("Serial Port %d, Created %s Pipe, Reader: %d, Writer %d\n",
-               port,
-               string,
-               pipePtr[0],
-               pipePtr[1]);
+    wakeFdsCreated = TRUE;
   }
 
-  // Change the data reader to non-blocking so that we will
-  // continue to be able to execute ezspTick().
-  setNonBlockingFD(DATA_READER(port));
+  // A new backchannel client may connect before the application has seen
+  // that the last one went away.
+  if (input->active) {
+    inputStop(port);
+  }
 
-  pid = fork();
-  if (pid == 0) {  // Child
-    amParent = FALSE;
-    childRun(port);
-    return EMBER_ERR_FATAL;  // should never get here
+  input->fd = STDIN;
+  input->in = NULL;
+  input->out = NULL;
+  if (backchannelEnable) {
+    // BugzId:12928 Read from a copy of the client socket, which the thread
+    // can close when it is done without disturbing output to the client.
+    input->fd = dup(backchannelGetConnectionFd(port));
+    if (input->fd < 0) {
+      debugPrint("Could not copy backchannel connection: %s\n",
+                 strerror(errno));
+      return EMBER_ERR_FATAL;
+    }
+    if (port == SERIAL_PORT_CLI) {
+      input->in = fdopen(input->fd, "r");
+      input->out = fdopen(dup(input->fd), "a");
+      if (input->in == NULL || input->out == NULL) {
+        debugPrint("Could not open backchannel connection: %s\n",
+                   strerror(errno));
+        if (input->in != NULL) {
+          fclose(input->in);
+        } else {
+          close(input->fd);
+        }
+        if (input->out != NULL) {
+          fclose(input->out);
+        }
+        return EMBER_ERR_FATAL;
+      }
+      fprintf(input->out, "Connected.\r\n");
+      fflush(input->out);
+    } // else
+      //   Raw port, don't print anything.
+  }
 
-  } else if (pid == -1) {
-    fprintf(stderr, "FATAL: Could not fork! (%d): %s\n",
+  input->ended = FALSE;
+  input->inReadline = FALSE;
+  input->head = 0;
+  input->tail = 0;
+  if (0 != sem_init(&input->goAhead, 0, 0)) {
+    fprintf(stderr, "FATAL: Could not create semaphore (%d): %s\n",
             errno,
             strerror(errno));
     assert(FALSE);
   }
-  // Parent
-  debugPrint("fork(): My child's pid is %d\n", pid);
 
-  // BugzId:12928 Parent retains allCommands for other children it might spawn
-
-  close(DATA_WRITER(port));
-  close(CONTROL_READER(port));
-  DATA_WRITER(port) = INVALID_FD;
-  CONTROL_READER(port) = INVALID_FD;
-
-  // BugzId:12928 Leave STDIN open for subsequent forked children to use
-
-  childPid[port] = pid;
+  status = pthread_create(&input->thread,
+                          NULL,
+                          processSerialInput,
+                          (void*)(unsigned long)port);
+  if (status != 0) {
+    fprintf(stderr, "FATAL: Could not start input thread (%d): %s\n",
+            status,
+            strerror(status));
+    assert(FALSE);
+  }
+  debugPrint("Started input thread for port %d\n", port);
+  input->active = TRUE;
 
   setMicroRebootHandler(&emberSerialCleanup);
   return EMBER_SUCCESS;
 }
 
 // Checks to see if there is a remote connection in place, or if a new
-// one has come in.  When a new one comes in, spawn a child process to
-// deal with it.
+// one has come in.  When a new one comes in, start a thread to deal with it.
 static boolean handleRemoteConnection(int8u port)
 {
   BackchannelState state = 
@@ -283,8 +344,8 @@ static boolean handleRemoteConnection(int8u port)
                                FALSE); // don't wait for new connection
   if (state == CONNECTION_ERROR
       || state == NO_CONNECTION) {
-    // BugzId:12928 If child still exists, return TRUE to suck pipe 'til empty
-    return (childPid[port] != INVALID_PID);
+    // BugzId:12928 If thread still exists, return TRUE to empty the queue
+    return inputPorts[port].active;
   } else if (state == CONNECTION_EXISTS) {
     return TRUE;
   } // else
@@ -293,62 +354,46 @@ static boolean handleRemoteConnection(int8u port)
   return (EMBER_SUCCESS == serialInitInternal(port));
 }
 
-static void handleBackchannelConnection(int8u port)
+// Waits for the input thread of a port to finish, stopping it first if it
+// is still reading, and releases what it used.  The queue is emptied.
+static void inputStop(int8u port)
 {
-  // BugzId:12928 Close out sockets used by other children but not this one
-  int i;
-  for (i = 0; i < NUM_PORTS; i++) {
-    if (i != port) {
-      backchannelCloseConnection(i);
-    }
-  }
+  InputPort* input = &inputPorts[port];
+  void* result;
 
-  if (EMBER_SUCCESS 
-      ==  backchannelMapStandardInputOutputToRemoteConnection(port)) {
-    if (port == SERIAL_PORT_CLI) {
-      fprintf(stdout, "Connected.\r\n");
-      fflush(stdout);
-    } // else
-    //   Raw port, don't print anything.
-  } else {
-    childCleanupAndExit();
+  if (!input->active) {
+    return;
   }
-}
-
-static void childRun(int8u port)
-{
-  childProcessPort = port;
-
-  close(DATA_READER(port));
-  close(CONTROL_WRITER(port));
+  if (!__atomic_load_n(&input->ended, __ATOMIC_ACQUIRE)) {
+    debugPrint("Stopping input thread for port %d.\n", port);
+    pthread_cancel(input->thread);
+  }
+  pthread_join(input->thread, &result);
+  debugPrint("Input thread for port %d stopped.\n", port);
 
-  if (backchannelEnable) {
-    handleBackchannelConnection(port);
-  } // else
-    //   don't do anything
-
-
-  // This fixes a bug on Cygwin where a process that
-  // holds onto an open file descriptor after a fork()
-  // can prevent the other parent process from performing a
-  // close() and re-open() on it.  Specifically this only seems
-  // to affect serial port FDs, which is what ASH uses.
-  if (INVALID_FD != ashSerialGetFd()) {
-    int port = ashSerialGetFd();
-    if (0 != close(port)) {
-      fprintf(stderr, "FATAL: Could not close EZSP file descriptor %d: %s\n",
-              port,
-              strerror(errno));
-      assert(FALSE);
+  if (result == PTHREAD_CANCELED && port == SERIAL_PORT_CLI) {
+#if READLINE_SUPPORT
+    if (input->inReadline) {
+      // Put the terminal back the way readline() found it.
+      rl_free_line_state();
+      rl_cleanup_after_signal();
     }
+#endif
+    writeHistory();
   }
 
-  installSignalHandler();
-  processSerialInput(port);
-
-  // Normally the above function NEVER returns
-  // If we get here it is an error.
-  assert(0);
+  if (input->in != NULL) {
+    fclose(input->in);
+    fclose(input->out);
+  } else if (input->fd != STDIN) {
+    close(input->fd);
+  }
+  input->in = NULL;
+  input->out = NULL;
+  input->fd = INVALID_FD;
+  sem_destroy(&input->goAhead);
+  input->tail = input->head;
+  input->active = FALSE;
 }
 
 void emberSerialSetPrompt(const char* thePrompt)
@@ -368,7 +413,7 @@ void emberSerialSetPrompt(const char* thePrompt)
 static void setNonBlockingFD(int fd)
 {
   int flags = fcntl(fd, F_GETFL);
-  int status = fcntl(fd, F_SETFD, flags | O_NONBLOCK);
+  int status = fcntl(fd, F_SETFL, flags | O_NONBLOCK);
   if (status != 0) {
     fprintf(stderr, 
             "FATAL: Could not set pipe reader to non-blocking (%d): %s\n",
@@ -378,75 +423,17 @@ static void setNonBlockingFD(int fd)
   }
 }
 
-// It is expected this is only called within the parent process.
+// It is expected this is only called by the main thread.
 void emberSerialCleanup(void)
 {
   int8u port;
-  for (port = 0; port < 2; port++) {
-    if (childPid[port] != INVALID_PID) {
-      int status;
-      close(DATA_READER(port));
-      close(CONTROL_WRITER(port));
-      DATA_READER(port) = INVALID_FD;
-      CONTROL_WRITER(port) = INVALID_FD;
-      debugPrint("Waiting for child on port %d to terminate.\n", port);
-      kill(childPid[port], SIGTERM);
-      wait(&status);
-      debugPrint("Child on port %d exited with status: %d\n", port, status);
-      childPid[port] = INVALID_PID;
-    }
+  for (port = 0; port < NUM_PORTS; port++) {
+    inputStop(port);
   }
+  stdoutFlush();
   gatewayBackchannelStop();
 }
 
-static void parentCleanupAfterChildDied(void)
-{
-  // First we need to determine which child died.  
-  // We assume that a child has really died, otherwise the 
-  // wait() call will block.
-  int status;
-  pid_t pid = wait(&status);
-  int i;
-  int childPort = -1;
-  for (i = 0; i < NUM_PORTS; i++) {
-    if (childPid[i] == pid) {
-      childPort = i;
-      break;
-    }
-  }
-  if (childPort == -1) {
-    // A child process died that we didn't know about!
-    assert(0);
-  }
-  childPid[childPort] = INVALID_PID;
-  close(DATA_READER(childPort));
-  close(CONTROL_WRITER(childPort));
-  DATA_READER(childPort) = INVALID_FD;
-  CONTROL_WRITER(childPort) = INVALID_FD;
-  // BugzId:12928 Parent needs to close its socket too
-  if (backchannelEnable) {
-    backchannelCloseConnection(childPort);
-  }
-}
-
-
-static void childCleanupAndExit(void)
-{
-  if (childProcessPort == SERIAL_PORT_CLI) {
-    writeHistory();
-  }
-  if (childProcessPort != -1) {
-    if (backchannelEnable) {
-      backchannelStopServer(childProcessPort);
-
-    }
-    close(DATA_WRITER(childProcessPort));
-    close(CONTROL_READER(childProcessPort));
-  }
-
-  exit(0);
-}
-
 // This works only for the command interpreter.
 // Loop and get pointers to all the strings of the available commands.
 void emberSerialCommandCompletionInit(EmberCommandEntry listOfCommands[])
@@ -471,28 +458,35 @@ void emberSerialCommandCompletionInitCli(cliSerialCmdEntry cliCmdList[],
 //------------------------------------------------------------------------------
 // Serial Input
 
+// Returns a file descriptor that is readable when there is input on the
+// port, for use with select() or epoll.  Reading the input clears it.
 int emberSerialGetInputFd(int8u port)
 {
-  if (port > (NUM_PORTS - 1)) {
+  if (port > (NUM_PORTS - 1)
+      || !inputPorts[port].active) {
     return INVALID_FD;
   }
-  return DATA_READER(port);
+  return inputPorts[port].wakeFd;
 }
 
 static boolean readyForSerialInput(int8u port)
 {
   if (useControlChannel) {
-    char data = '1';
-    if (1 == write(CONTROL_WRITER(port), &data, 1)) {
-      debugPrint("Sent reader process 'go-ahead' signal.\n");
+    if (inputPorts[port].active) {
+      // The prompt must not come out ahead of the command's output.
+      if (!backchannelEnable) {
+        stdoutFlush();
+      }
+      sem_post(&inputPorts[port].goAhead);
+      debugPrint("Sent input thread 'go-ahead' signal.\n");
     } else {
       // We assume this function is only used for CLI input.
-      // If the CLI process died, then the parent should also
+      // If the CLI input has ended, then the application should also
       // go away.
       // BugzId:12928: Except in the case of backchannel CLI
-      // client, where parent cleans up and awaits a new client.
+      // client, where we clean up and await a new client.
       // For the RAW input, which is only accessible with the
-      // backchannel enabled, that child process may come and go
+      // backchannel enabled, that thread may come and go
       // and we don't need to worry about it.
       if (backchannelEnable) {
         return TRUE; // Let caller know we didn't deliver go-ahead
@@ -504,45 +498,115 @@ static boolean readyForSerialInput(int8u port)
   return FALSE; // go-ahead delivered ok
 }
 
+// Called by the input thread to add to the queue.  When the queue is full
+// it waits for the application to read some of it.
+static void inputQueue(InputPort* input, const char* data, int16u length)
+{
+  while (length > 0) {
+    int32u head = input->head;
+    int32u space = (INPUT_QUEUE_SIZE
+                    - (head - __atomic_load_n(&input->tail, __ATOMIC_ACQUIRE)));
+    int32u start = head & (INPUT_QUEUE_SIZE - 1);
+    int32u chunk = length;
+
+    if (space == 0) {
+      usleep(INPUT_WAIT_US);
+      continue;
+    }
+    if (chunk > space) {
+      chunk = space;
+    }
+    if (start + chunk > INPUT_QUEUE_SIZE) {
+      chunk = INPUT_QUEUE_SIZE - start;
+    }
+    MEMCOPY(input->buffer + start, data, chunk);
+    __atomic_store_n(&input->head, head + chunk, __ATOMIC_RELEASE);
+    data += chunk;
+    length -= chunk;
+  }
+}
+
+// Called by the input thread once it has added to the queue.
+static void inputWake(InputPort* input)
+{
+  __atomic_add_fetch(&input->posted, 1, __ATOMIC_SEQ_CST);
+#if defined(__linux__)
+  (void)eventfd_write(input->wakeWriteFd, 1);
+#else
+  char wake = 1;
+  (void)write(input->wakeWriteFd, &wake, 1);
+#endif
+}
+
+// Clears wakeFd if the input thread has signalled it since it was last
+// cleared.  A signal that has been counted but not yet written is read
+// next time.
+static void inputClearWake(InputPort* input)
+{
+  if (__atomic_load_n(&input->posted, __ATOMIC_SEQ_CST) != input->cleared) {
+#if defined(__linux__)
+    eventfd_t count;
+    if (0 == eventfd_read(input->wakeFd, &count)) {
+      input->cleared += (int32u)count;
+    }
+#else
+    int8u discard[16];
+    ssize_t bytes;
+    while (0 < (bytes = read(input->wakeFd, discard, sizeof(discard)))) {
+      input->cleared += bytes;
+    }
+#endif
+  }
+}
+
 // returns # bytes available for reading
 int16u emberSerialReadAvailable(int8u port)
 {
-  // I am not aware of a good way to get the exact number
-  // of bytes available for reading from an anonymous pipe.
-  // We use select() to see if there is any data available for
-  // reading and that means there is at least one byte present
-  // or EOF (pipe closed) has happened.
-  fd_set readSet;
-  struct timeval timeout = { 0, 0 }; // return immediately
-  int fdsWithData;
-
-  if (DATA_READER(port) == INVALID_FD) {
+  InputPort* input = &inputPorts[port];
+  int32u count;
+
+  if (!input->active) {
     return 0;
   }
 
-  FD_ZERO(&readSet);
-  FD_SET(DATA_READER(port), &readSet);
+  count = __atomic_load_n(&input->head, __ATOMIC_ACQUIRE) - input->tail;
+  if (count == 0) {
+    // The queue is looked at again once wakeFd is cleared, as the input
+    // thread may have added to it, and signalled, after it was first seen
+    // to be empty.  Otherwise that signal would be lost.
+    inputClearWake(input);
+    count = __atomic_load_n(&input->head, __ATOMIC_ACQUIRE) - input->tail;
+    // Once the thread has stopped reading, report one byte, as select()
+    // would for a pipe that has been closed.  emberSerialReadByte() then
+    // sees the end of the input.
+    if (count == 0 && __atomic_load_n(&input->ended, __ATOMIC_ACQUIRE)) {
+      count = __atomic_load_n(&input->head, __ATOMIC_ACQUIRE) - input->tail;
+      return (count == 0 ? 1 : count);
+    }
+  }
+  return (count > MAX_INT16U_VALUE ? MAX_INT16U_VALUE : count);
+}
 
-  fdsWithData = select(DATA_READER(port) + 1,   // per the man page
-                       &readSet, 
-                       NULL, 
-                       NULL,
-                       &timeout);
-  if (fdsWithData < 0) {
-    fprintf(stderr, 
-            "Fatal: select() returned error: %s\n", 
-            strerror(errno));
-    assert(FALSE);
+// Takes a byte from the queue.  Returns the number of bytes read, which is
+// zero once the input has ended and the queue is empty.
+static int8u inputRead(int8u port, int8u *dataByte)
+{
+  InputPort* input = &inputPorts[port];
+  int32u tail = input->tail;
+  if (__atomic_load_n(&input->head, __ATOMIC_ACQUIRE) == tail) {
+    return 0;
   }
-  return (fdsWithData > 0 ? 1 : 0);
+  *dataByte = input->buffer[tail & (INPUT_QUEUE_SIZE - 1)];
+  __atomic_store_n(&input->tail, tail + 1, __ATOMIC_RELEASE);
+  return 1;
 }
 
-// This should only be called by the parent process (i.e. the main app)
+// This should only be called by the main thread (i.e. the main app)
 EmberStatus emberSerialReadByte(int8u port, int8u *dataByte)
 {
   static boolean sendGoAhead = TRUE;
   static boolean waitForEol = FALSE;
-  size_t bytes;
+  int8u bytes;
 
   if (backchannelEnable
       && !handleRemoteConnection(port)) {
@@ -558,10 +622,10 @@ EmberStatus emberSerialReadByte(int8u port, int8u *dataByte)
   // The command interpreter reads bytes until it gets an EOL.
   // The CLI reads bytes until it gets a "\r\n".  
   // The latter is easily supported since the data is sitting
-  // in our data pipe.  The former requires a little extra work.
+  // in our queue.  The former requires a little extra work.
 
   // For the command interpreter We don't want to send the 'go-ahead' until
-  // the parent reads a byte of data after it has read the EOL.
+  // the application reads a byte of data after it has read the EOL.
   if (waitForEol) {
     waitForEol = FALSE;
     return EMBER_SERIAL_RX_EMPTY;
@@ -575,11 +639,10 @@ EmberStatus emberSerialReadByte(int8u port, int8u *dataByte)
     return EMBER_SERIAL_RX_EMPTY;
   }
 
-  //  debugPrint("Parent: Data is ready.\n");
-  bytes = read(DATA_READER(port), (void*)dataByte, 1);
+  bytes = inputRead(port, dataByte);
 
-  // We have read the entire line of input, the serial input process will
-  // be blocking until we tell it to go ahead and read more input.
+  // We have read the entire line of input, the input thread will
+  // be waiting until we tell it to go ahead and read more input.
   // BugzId:12928 Treat EOF as an EOL
   if (port == SERIAL_PORT_CLI && (bytes == 0 || *dataByte == '\n')) {
     sendGoAhead = TRUE;
@@ -591,24 +654,28 @@ EmberStatus emberSerialReadByte(int8u port, int8u *dataByte)
   if (bytes == 1) {
 //    debugPrint("emberSerialReadByte(): %c\n", (char)*dataByte);
     return EMBER_SUCCESS;
-  } else if (bytes == 0) {
+  } else {
     // BugzId:12928 clean up for new client
-    // read() only returns 0 on EOF; a non-blocking
-    // read() returns -1/EAGAIN on no data but that shouldn't
-    // happen per the emberSerialReadAvailable() check above.
-    kill(childPid[port], SIGTERM); // Should be superfluous, but make sure
-    parentCleanupAfterChildDied();
+    inputStop(port);
+    if (backchannelEnable) {
+      backchannelCloseConnection(port);
+    }
     *dataByte = '\n';
     return EMBER_SUCCESS;
-  } else {
-    return EMBER_ERR_FATAL;
   }
 }
 
 #if !READLINE_SUPPORT
-// Support for those systems without the readline library.
+// Support for those systems without the readline library.  As with
+// readline(), input comes from rl_instream and the prompt goes to
+// rl_outstream, or stdin and stdout when they are not set.
+static FILE* rl_instream = NULL;
+static FILE* rl_outstream = NULL;
+
 static char* readline(const char* prompt)
 {
+  int inputFd = (rl_instream == NULL ? STDIN : fileno(rl_instream));
+  FILE* output = (rl_outstream == NULL ? stdout : rl_outstream);
   int8u i = 0;
   char* data = malloc(EMBER_COMMAND_BUFFER_LENGTH + 1);  // add 1 for '\0'
   EmberStatus status;
@@ -619,11 +686,11 @@ static char* readline(const char* prompt)
   if (data == NULL) 
     return NULL;
 
-  fprintf(stdout, "%s", prompt);
-  fflush(stdout);
+  fprintf(output, "%s", prompt);
+  fflush(output);
   
   while (!done && i < EMBER_COMMAND_BUFFER_LENGTH) {
-    ssize_t bytes = read(STDIN, &(data[i]), 1);
+    ssize_t bytes = read(inputFd, &(data[i]), 1);
     if (bytes == -1) {
       if (errno == EINTR) {
         continue;
@@ -674,76 +741,293 @@ EmberStatus emberSerialReadLine(int8u port, char *data, int8u max)
   return EMBER_SUCCESS;
 }
 
-// Read a line of data and write it to our pipe.
-// Wait for the other process to give us the go-ahead.
+// The input thread.  Read a line of data and add it to our queue.
+// Wait for the application to give us the go-ahead.
 
-static void processSerialInput(int8u port)
+static void* processSerialInput(void* context)
 {
+  int8u port = (int8u)(unsigned long)context;
+  InputPort* input = &inputPorts[port];
   int length;
   char* readData = NULL;
   char newLine[] = "\r\n";  // The CLI code requires \r\n as the final bytes.
-  char goAhead;
-  char singleByte[2];
+  char singleByte;
+  sigset_t signals;
+
+  // Signals are left to the main thread.
+  sigfillset(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
 
   if (port == SERIAL_PORT_CLI) {
+#if READLINE_SUPPORT
+    // readline() must not take over the process's signal handlers.
+    rl_catch_signals = 0;
+    rl_catch_sigwinch = 0;
+#endif
+    if (input->in != NULL) {
+      rl_instream = input->in;
+      rl_outstream = input->out;
+    } else {
+      rl_instream = stdin;
+      rl_outstream = stdout;
+    }
     initializeHistory();
   }
 
   debugPrint("Processing input for port %d.\n", port);
 
   while (1) {
-    if (port == SERIAL_PORT_CLI && useControlChannel) {
-      // Wait for the parent to give the "go ahead"
-      debugPrint("Child process waiting for parent's 'go-ahead'.\n");
-      read(CONTROL_READER(port), &goAhead, 1);
-    }
-
     if (port == SERIAL_PORT_CLI) {
-      // If we are operating in a backchannel environment, then STDIN has
-      // already been re-mapped to the correct socket.  
+      if (useControlChannel) {
+        // Wait for the application to give the "go ahead"
+        debugPrint("Input thread waiting for 'go-ahead'.\n");
+        sem_wait(&input->goAhead);
+      }
 
       // This performs a malloc()
+      input->inReadline = TRUE;
       readData = readline(prompt);
+      input->inReadline = FALSE;
+      if (readData == NULL) {
+        // BugzId:12928 On disconnect, stop reading; the application will
+        // deal with it
+        fprintf(stderr,
+                "Serial input got EOF. Exiting\n");
+        writeHistory();
+        break;
+      }
+
+      length = strnlen(readData, 255);  // 255 is an arbitrary maximum
+      debugPrint("readline() input (%d bytes): %s\n", length, readData);
+      inputQueue(input, readData, length);
+      inputQueue(input, newLine, 2);
+      if (length > 0) {
+        add_history(readData);
+      }
+      free(readData);
     } else {
       // Raw data
-      readData = &(singleByte[0]);
-      boolean success = (backchannelEnable
-                         ? (EMBER_SUCCESS == backchannelReceive(port, readData))
-                         : (1 != read(STDIN, readData, 1)));
+      if (1 != read(input->fd, &singleByte, 1)) {
+        break;
+      }
+      inputQueue(input, &singleByte, 1);
+    }
+    inputWake(input);
+  }
+
+  __atomic_store_n(&input->ended, TRUE, __ATOMIC_RELEASE);
+  inputWake(input);
+  return NULL;
+}
 
-      if (!success) {
-        childCleanupAndExit();
+//------------------------------------------------------------------------------
+// Standard Output
+
+#if EMBER_SERIAL_ASYNC_OUTPUT_SIZE > 0
+
+// Text is formatted by the caller and copied into a ring buffer, which the
+// output thread writes to stdout.  Only the application thread moves
+// outputHead and only the output thread moves outputTail, so neither needs a
+// lock.  Both count bytes since start up and are masked to index the buffer.
+// The output thread writes everything that has built up each time, so a busy
+// application gets a few large writes rather than one per line.  When the
+// buffer is empty it waits on outputReady, which the application posts when
+// it adds text to an empty buffer.
+//
+// Anything written to stdout other than through this file, such as the
+// readline() prompt, may come out ahead of text that is still in the buffer,
+// so the buffer is drained before the input thread is let go ahead.
+
+#define OUTPUT_MASK (EMBER_SERIAL_ASYNC_OUTPUT_SIZE - 1)
+#define OUTPUT_LINE_SIZE 256
+#define OUTPUT_WAIT_US 100
+
+static char outputBuffer[EMBER_SERIAL_ASYNC_OUTPUT_SIZE];
+static int32u outputHead = 0;
+static int32u outputTail = 0;
+static boolean outputThreadRunning = FALSE;
+static boolean outputThreadFailed = FALSE;
+static pthread_t outputThread;
+static sem_t outputReady;
+
+static void* outputThreadRun(void* unused)
+{
+  int32u tail = outputTail;
+  sigset_t signals;
+
+  // Signals are left to the main thread.
+  sigfillset(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+  for (;;) {
+    // The tail is stored before the head is read, and the application
+    // stores the head before reading the tail, so either the application
+    // sees an empty buffer and posts or this sees the new text.
+    int32u head = __atomic_load_n(&outputHead, __ATOMIC_SEQ_CST);
+    int32u start = tail & OUTPUT_MASK;
+    int32u length = head - tail;
+    ssize_t written;
+
+    if (length == 0) {
+      sem_wait(&outputReady);
+      continue;
+    }
+    if (start + length > EMBER_SERIAL_ASYNC_OUTPUT_SIZE) {
+      length = EMBER_SERIAL_ASYNC_OUTPUT_SIZE - start;
+    }
+    written = write(STDOUT_FILENO, outputBuffer + start, length);
+    if (written < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
       }
-      singleByte[1] = '\0';
+      // Drop what cannot be written so that the application does not wait
+      // forever for space.
+      written = length;
     }
-    if (readData == NULL) {
-      // BugzId:12928 On disconnect, let child die; parent will deal with it
-      fprintf(stderr,
-              "Child process for serial input got EOF. Exiting\n");
-      childCleanupAndExit();
+    tail += written;
+    __atomic_store_n(&outputTail, tail, __ATOMIC_SEQ_CST);
+  }
+  return NULL;
+}
+
+// Waits until the output thread has written everything in the buffer.
+static void outputDrain(void)
+{
+  if (outputThreadRunning) {
+    while (__atomic_load_n(&outputTail, __ATOMIC_ACQUIRE) != outputHead) {
+      usleep(OUTPUT_WAIT_US);
     }
-    length = (port == SERIAL_PORT_CLI
-              ? strnlen(readData, 255)  // 255 is an arbitrary maximum
-              : 1);                     
-    assert(-1 < write(DATA_WRITER(port), readData, length));
+  }
+}
 
-    if (port == SERIAL_PORT_CLI) {
-      debugPrint("readline() input (%d bytes): %s\n", length, readData);
-      assert(2 == write(DATA_WRITER(port), &newLine, 2));
-      if (length > 0) {
-        add_history(readData);
-      }
+static boolean outputThreadReady(void)
+{
+  if (!outputThreadRunning && !outputThreadFailed) {
+    // Anything already in stdio's buffer must come out first.
+    fflush(stdout);
+    if (sem_init(&outputReady, 0, 0) == 0
+        && pthread_create(&outputThread, NULL, outputThreadRun, NULL) == 0) {
+      outputThreadRunning = TRUE;
+      atexit(outputDrain);
+    } else {
+      debugPrint("Could not start output thread: %s\n", strerror(errno));
+      outputThreadFailed = TRUE;
     }
+  }
+  return outputThreadRunning;
+}
 
-    if (port == SERIAL_PORT_CLI) {
-      free(readData);
+// Copies text into the buffer, waiting for the output thread to make room
+// when it is full.
+static void outputQueue(const char* data, int32u length)
+{
+  while (length > 0) {
+    int32u head = outputHead;
+    int32u space = (EMBER_SERIAL_ASYNC_OUTPUT_SIZE
+                    - (head - __atomic_load_n(&outputTail, __ATOMIC_ACQUIRE)));
+    int32u start = head & OUTPUT_MASK;
+    int32u chunk = length;
+
+    if (space == 0) {
+      usleep(OUTPUT_WAIT_US);
+      continue;
+    }
+    if (chunk > space) {
+      chunk = space;
+    }
+    if (start + chunk > EMBER_SERIAL_ASYNC_OUTPUT_SIZE) {
+      chunk = EMBER_SERIAL_ASYNC_OUTPUT_SIZE - start;
     }
+    MEMCOPY(outputBuffer + start, data, chunk);
+    __atomic_store_n(&outputHead, head + chunk, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&outputTail, __ATOMIC_SEQ_CST) == head) {
+      sem_post(&outputReady);
+    }
+    data += chunk;
+    length -= chunk;
   }
 }
 
+static EmberStatus stdoutVprintf(const char* formatString, va_list ap)
+{
+  char line[OUTPUT_LINE_SIZE];
+  char* text = line;
+  va_list copy;
+  int length;
+
+  if (!outputThreadReady()) {
+    length = vprintf(formatString, ap);
+    fflush(stdout);
+    return (length == 0 ? EMBER_ERR_FATAL : EMBER_SUCCESS);
+  }
+
+  va_copy(copy, ap);
+  length = vsnprintf(line, OUTPUT_LINE_SIZE, formatString, ap);
+  if (length >= OUTPUT_LINE_SIZE) {
+    text = malloc(length + 1);
+    if (text == NULL) {
+      va_end(copy);
+      return EMBER_NO_BUFFERS;
+    }
+    vsnprintf(text, length + 1, formatString, copy);
+  }
+  va_end(copy);
+  if (length > 0) {
+    outputQueue(text, length);
+  }
+  if (text != line) {
+    free(text);
+  }
+  return (length == 0 ? EMBER_ERR_FATAL : EMBER_SUCCESS);
+}
+
+static EmberStatus stdoutWrite(const int8u* data, int16u length)
+{
+  if (!outputThreadReady()) {
+    return (fwrite(data, length, 1, stdout) == 1
+            ? EMBER_SUCCESS
+            : EMBER_ERR_FATAL);
+  }
+  outputQueue((const char*)data, length);
+  return EMBER_SUCCESS;
+}
+
+static void stdoutFlush(void)
+{
+  outputDrain();
+  fflush(stdout);
+}
+
+#else // EMBER_SERIAL_ASYNC_OUTPUT_SIZE == 0
+
+static EmberStatus stdoutVprintf(const char* formatString, va_list ap)
+{
+  EmberStatus stat = (0 == vprintf(formatString, ap)
+                      ? EMBER_ERR_FATAL
+                      : EMBER_SUCCESS);
+  fflush(stdout);
+  return stat;
+}
+
+static EmberStatus stdoutWrite(const int8u* data, int16u length)
+{
+  return (fwrite(data, length, 1, stdout) == 1
+          ? EMBER_SUCCESS
+          : EMBER_ERR_FATAL);
+}
+
+static void stdoutFlush(void)
+{
+  fflush(stdout);
+}
+
+#endif // EMBER_SERIAL_ASYNC_OUTPUT_SIZE > 0
+
 //------------------------------------------------------------------------------
 // Serial Output
 
+// As on the embedded platforms, the text has been written out by the time
+// this returns, even when other output is being written by a separate thread.
 EmberStatus emberSerialGuaranteedPrintf(int8u port, PGM_P format, ...) 
 {
   va_list vargs;
@@ -752,6 +1036,7 @@ EmberStatus emberSerialGuaranteedPrintf(int8u port, PGM_P format, ...)
   va_start(vargs, format);
   stat = emberSerialPrintfVarArg(port, format, vargs);
   va_end(vargs);
+  emberSerialWaitSend(port);
   return stat;
 }
 
@@ -770,12 +1055,14 @@ int8u emPrintfInternal(emPrintfFlushHandler handler,
 }
 
 // Main printing routine.
-// Calls into normal C 'vprintf()'
+// Calls into normal C 'vprintf()'.  Converted format strings are cached, so
+// each format is only converted the first time it is printed.
 EmberStatus emberSerialPrintfVarArg(int8u port, PGM_P formatString, va_list ap)
 {
   EmberStatus stat = EMBER_SERIAL_INVALID_PORT;
-  char* newFormatString = transformEmberPrintfToStandardPrintf(formatString,
-                                                               !backchannelEnable);
+  const char* newFormatString
+    = transformEmberPrintfToStandardPrintfCached(formatString,
+                                                 !backchannelEnable);
   if (newFormatString == NULL) {
     return EMBER_NO_BUFFERS;
   }
@@ -787,12 +1074,8 @@ EmberStatus emberSerialPrintfVarArg(int8u port, PGM_P formatString, va_list ap)
       }
     }
   } else {
-    stat = (0 == vprintf(newFormatString, ap)
-            ? EMBER_ERR_FATAL
-            : EMBER_SUCCESS);
-    fflush(stdout);
+    stat = stdoutVprintf(newFormatString, ap);
   }
-  free(newFormatString);
   return stat;
 }
 
@@ -853,9 +1136,7 @@ EmberStatus emberSerialWriteData(int8u port, int8u *data, int8u length)
 
   } else {
     // Normal IO
-    if (fwrite(data, length, 1, stdout) == 1) {
-      stat = EMBER_SUCCESS;
-    }
+    stat = stdoutWrite(data, length);
   }
   return stat;
 }
@@ -863,7 +1144,7 @@ EmberStatus emberSerialWriteData(int8u port, int8u *data, int8u length)
 EmberStatus emberSerialWaitSend(int8u port)
 {
   if (!backchannelEnable) {
-    fflush(stdout);
+    stdoutFlush();
   }
   return EMBER_SUCCESS;
 }
@@ -873,9 +1154,9 @@ EmberStatus emberSerialWaitSend(int8u port)
 
 void emberSerialFlushRx(int8u port)
 {
-  char buf;
-  while (0 < emberSerialReadAvailable(port)) {
-    read(DATA_READER(port), &buf, 1);
+  int8u buf;
+  while (0 < emberSerialReadAvailable(port)
+         && 0 < inputRead(port, &buf)) {
   }
 }
 
@@ -1184,27 +1465,8 @@ static void writeHistory(void)
 
 //------------------------------------------------------------------------------
 
-/*
-Ideally we want the parent process to catch SIGCHLD and then 
-cleanup after the child.  If the CLI terminated, the parent
-process will also quit.
-
-  The question is, how do I determine which child quit?
-  Presumably this can be done with wait(), which returns the
-  child's pid and its associated status.
-
-  The one tricky part is the issue with handling the signal
-  SIGCHLD during normal shutdown.  I presume that a signal
-  handler cannot be fired within a signal handel, but I am
-  not certain.  I need a way of telling whether this
-  is a graceful shutdown or not.  Basically if the parent
-  initiated the shutdown the children should just go away
-  and the parent would ignore notification that they did that
-  (SIGCHLD).  If the child died unexpectedly then the parent 
-  will not ignore that and should nicely cleanup
-  and not necessarily exit (in the case of the CLI we presume 
-  it would).
-*/
+// Signals are blocked in the input and output threads, so the handler always
+// runs on the main thread and can stop the others before exiting.
 
 static void signalHandler(int signal)
 {
@@ -1224,22 +1486,9 @@ static void signalHandler(int signal)
     return;
   }
 
-  /*
-  if (signal == SIGCHLD) {
-    if (amParent) {
-      parentCleanupAfterChildDied();
-    }
-    return;
-  }
-  */
-
   // Assume that this is only called for SIGTERM and SIGINT
-  if (amParent) {
-    emberSerialCleanup();
-    exit(-1);
-  } else {
-    childCleanupAndExit();
-  }
+  emberSerialCleanup();
+  exit(-1);
 }
 
 static void installSignalHandler(void)
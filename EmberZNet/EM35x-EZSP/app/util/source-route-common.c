@@ -16,62 +16,108 @@
 #ifndef ZA_NO_SOURCE_ROUTING
 
 // The number of entries in use.
-static int8u entryCount = 0;
+static SourceRouteIndex entryCount = 0;
 
-// The index of the most recently added entry.
-static int8u newestIndex = NULL_INDEX;
+// The indexes of the most and least recently added entries.
+static SourceRouteIndex newestIndex = NULL_INDEX;
+static SourceRouteIndex oldestIndex = NULL_INDEX;
+
+#define bucketFor(id) (&sourceRouteTable[(id) % sourceRouteTableSize].hashHead)
 
 // Return the index of the entry with the specified destination.
-int8u sourceRouteFindIndex(EmberNodeId id)
+SourceRouteIndex sourceRouteFindIndex(EmberNodeId id)
 {
-  int8u i;
-  for (i = 0; i < entryCount; i++) {
-    if (sourceRouteTable[i].destination == id) {
-      return i;
+  SourceRouteIndex index;
+  if (entryCount == 0) {
+    return NULL_INDEX;
+  }
+  for (index = *bucketFor(id);
+       index != NULL_INDEX;
+       index = sourceRouteTable[index].hashNext) {
+    if (sourceRouteTable[index].destination == id) {
+      return index;
     }
   }
   return NULL_INDEX;
 }
 
+static void removeFromBucket(SourceRouteIndex index)
+{
+  SourceRouteIndex *link = bucketFor(sourceRouteTable[index].destination);
+  while (*link != index) {
+    link = &sourceRouteTable[*link].hashNext;
+  }
+  *link = sourceRouteTable[index].hashNext;
+}
+
+static void removeFromAgeList(SourceRouteIndex index)
+{
+  SourceRouteTableEntry *entry = &sourceRouteTable[index];
+  if (entry->olderIndex == NULL_INDEX) {
+    oldestIndex = entry->newerIndex;
+  } else {
+    sourceRouteTable[entry->olderIndex].newerIndex = entry->newerIndex;
+  }
+  if (entry->newerIndex == NULL_INDEX) {
+    newestIndex = entry->olderIndex;
+  } else {
+    sourceRouteTable[entry->newerIndex].olderIndex = entry->olderIndex;
+  }
+}
+
 // Create an entry with the given id or update an existing entry. furtherIndex
 // is the entry one hop further from the gateway.
-int8u sourceRouteAddEntry(EmberNodeId id, int8u furtherIndex)
+//
+// An entry is always added after the entries that point to it, so the oldest
+// entry, which is the one replaced when the table is full, is never a relay on
+// another entry's route.
+SourceRouteIndex sourceRouteAddEntry(EmberNodeId id,
+                                     SourceRouteIndex furtherIndex)
 {
   // See if the id already exists in the table.
-  int8u index = sourceRouteFindIndex(id);
-  int8u i;
+  SourceRouteIndex index = sourceRouteFindIndex(id);
 
   if (index == NULL_INDEX) {
+    if (entryCount == 0) {
+      // The table is empty, so there is nothing in the buckets.
+      for (index = 0; index < sourceRouteTableSize; index++) {
+        sourceRouteTable[index].hashHead = NULL_INDEX;
+      }
+      newestIndex = NULL_INDEX;
+      oldestIndex = NULL_INDEX;
+    }
     if (entryCount < sourceRouteTableSize) {
       // No existing entry. Table is not full. Add new entry.
       index = entryCount;
       entryCount += 1;
     } else {
       // No existing entry. Table is full. Replace oldest entry.
-      index = newestIndex;
-      while (sourceRouteTable[index].olderIndex != NULL_INDEX) {
-        index = sourceRouteTable[index].olderIndex;
-      }
+      index = oldestIndex;
+      removeFromBucket(index);
+      removeFromAgeList(index);
     }
+    sourceRouteTable[index].destination = id;
+    sourceRouteTable[index].hashNext = *bucketFor(id);
+    *bucketFor(id) = index;
+  } else if (index != newestIndex) {
+    removeFromAgeList(index);
   }
 
-  // Update the pointers (only) if something has changed.
+  // Make this the newest entry (only) if something has changed.
   if (index != newestIndex) {
-    for (i = 0; i < entryCount; i++) {
-      if (sourceRouteTable[i].olderIndex == index) {
-        sourceRouteTable[i].olderIndex = sourceRouteTable[index].olderIndex;
-        break;
-      }
-    }
     sourceRouteTable[index].olderIndex = newestIndex;
+    sourceRouteTable[index].newerIndex = NULL_INDEX;
+    if (newestIndex == NULL_INDEX) {
+      oldestIndex = index;
+    } else {
+      sourceRouteTable[newestIndex].newerIndex = index;
+    }
     newestIndex = index;
   }
 
   // Add the entry.
-  sourceRouteTable[index].destination = id;
   sourceRouteTable[index].closerIndex = NULL_INDEX;
 
-
   // The current index is one hop closer to the gateway than furtherIndex.
   if (furtherIndex != NULL_INDEX) {
     sourceRouteTable[furtherIndex].closerIndex = index;
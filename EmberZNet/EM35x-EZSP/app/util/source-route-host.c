@@ -11,8 +11,8 @@
 // route (using emberFindSourceRoute() provided in this file) and then call
 // ezspSetSourceRoute().
 //
-// In this implementation, the maximum table size is 255 entries since a
-// one-byte index is used and the index 0xFF is reserved.
+// In this implementation, the maximum table size is 65535 entries since a
+// two-byte index is used and the index 0xFFFF is reserved.
 // 
 // Copyright 2007 by Ember Corporation. All rights reserved.                *80*
 
@@ -29,7 +29,7 @@
 #ifndef ZA_NO_SOURCE_ROUTING
 
 static SourceRouteTableEntry table[EZSP_HOST_SOURCE_ROUTE_TABLE_SIZE];
-int8u sourceRouteTableSize = EZSP_HOST_SOURCE_ROUTE_TABLE_SIZE;
+SourceRouteIndex sourceRouteTableSize = EZSP_HOST_SOURCE_ROUTE_TABLE_SIZE;
 SourceRouteTableEntry *sourceRouteTable = table;
 
 void ezspIncomingRouteRecordHandler(EmberNodeId source,
@@ -39,7 +39,7 @@ void ezspIncomingRouteRecordHandler(EmberNodeId source,
                                     int8u relayCount,
                                     int8u *relayList)
 {
-  int8u previous;
+  SourceRouteIndex previous;
   int8u i;
 
   if (sourceRouteTableSize == 0) {
@@ -64,7 +64,7 @@ boolean emberFindSourceRoute(EmberNodeId destination,
                              int8u *relayCount,
                              int16u *relayList)
 {
-  int8u index = sourceRouteFindIndex(destination);
+  SourceRouteIndex index = sourceRouteFindIndex(destination);
 
   if (index == NULL_INDEX) {
     return FALSE;
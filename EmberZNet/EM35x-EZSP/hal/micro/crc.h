@@ -27,6 +27,22 @@
  */
 int16u halCommonCrc16(int8u newByte, int16u prevResult);
 
+/** @brief Calculates the 16-bit CITT CRC of an array of bytes.
+ *
+ * Gives the same result as calling ::halCommonCrc16() on each byte in turn,
+ * but uses a lookup table to process several bytes per step. Intended for
+ * hosts, where the 2 KB of RAM for the table is not a concern.
+ *
+ * @param data        The bytes to be run through CRC.
+ *
+ * @param length      The number of bytes.
+ *
+ * @param prevResult  The previous CRC result.
+ *
+ * @return The new CRC result.
+ */
+int16u halCommonCrc16Array(const int8u *data, int16u length, int16u prevResult);
+
 
 /** @brief Calculates 32-bit cyclic redundancy code
  *
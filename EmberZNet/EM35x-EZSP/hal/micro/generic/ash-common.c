@@ -50,11 +50,46 @@ static int8u decodeFlip;      // ASH_FLIP if previous byte was ASH_ESC
 static int8u decodeByte1;     // a 2 byte queue to avoid outputting crc bytes - 
 static int8u decodeByte2;     // at frame end, they contain the received crc
 static int16u decodeCrc;
+static int8u decodeRandom;    // next derandomizing value (block decoder only)
+
+// Bitmap of the bytes that ashDecodeBlock() cannot treat as frame data.
+// Everything else is passed through in runs.
+static const int8u reservedBytes[32] = {
+#ifdef EZSP_HOST
+  0x00, 0x00, 0x0A, 0x05,     // ASH_XON, ASH_XOFF, ASH_SUB, ASH_CAN
+#else
+  0x00, 0x00, 0x00, 0x05,     // ASH_SUB, ASH_CAN
+#endif
+  0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x60,     // ASH_ESC, ASH_FLAG
+  0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00
+};
+#define isReservedByte(byte) \
+  ((reservedBytes[(byte) >> 3] & (1 << ((byte) & 7))) != 0)
+
+// The encoder always escapes XON and XOFF, even where the decoder does not
+// treat them as reserved.
+#ifdef EZSP_HOST
+  #define isStuffedByte(byte) isReservedByte(byte)
+#else
+  #define isStuffedByte(byte) \
+    (isReservedByte(byte) || (byte) == ASH_XON || (byte) == ASH_XOFF)
+#endif
 
 //------------------------------------------------------------------------------
 // Forward Declarations
 
 static int8u ashEncodeStuffByte(int8u byte);
+static int8u *ashStuffArray(const int8u *in, int8u len, int8u *out);
+static void ashDecodeRun(const int8u *run,
+                         int16u count,
+                         int8u *frame,
+                         int8u *frameLen,
+                         boolean derandomize);
 
 //------------------------------------------------------------------------------
 // Functions
@@ -93,6 +128,50 @@ int8u ashEncodeByte(int8u len, int8u byte, int8u *offset)
   return ASH_FLAG;
 }
 
+int16u ashEncodeFrame(int8u control,
+                      const int8u *data,
+                      int8u dataLen,
+                      int8u *out)
+{
+  int8u *start = out;
+  int16u crc;
+  int8u crcBytes[ASH_CRC_LEN];
+
+  crc = halCommonCrc16(control, 0xFFFF);
+  crc = halCommonCrc16Array(data, dataLen, crc);
+  crcBytes[0] = HIGH_BYTE(crc);
+  crcBytes[1] = LOW_BYTE(crc);
+
+  out = ashStuffArray(&control, 1, out);
+  out = ashStuffArray(data, dataLen, out);
+  out = ashStuffArray(crcBytes, ASH_CRC_LEN, out);
+  *out++ = ASH_FLAG;
+  return out - start;
+}
+
+// Copies bytes to the output, escaping any that are reserved.
+static int8u *ashStuffArray(const int8u *in, int8u len, int8u *out)
+{
+  const int8u *end = in + len;
+  const int8u *run;
+
+  while (in < end) {
+    run = in;
+    while (in < end && !isStuffedByte(*in)) {
+      in++;
+    }
+    if (in != run) {
+      MEMCOPY(out, run, in - run);
+      out += in - run;
+    }
+    if (in < end) {
+      *out++ = ASH_ESC;
+      *out++ = *in++ ^ ASH_FLIP;
+    }
+  }
+  return out;
+}
+
 // A helper for ashEncodeByte(), this determines whether a byte
 // about to be sent is a reserved value that must be escaped.
 static int8u ashEncodeStuffByte(int8u byte)
@@ -188,6 +267,181 @@ EzspStatus ashDecodeByte(int8u byte, int8u *out, int8u *outLen)
   return status;
 }
 
+EzspStatus ashDecodeBlock(const int8u *in,
+                          int16u inLen,
+                          int16u *consumed,
+                          int8u *frame,
+                          int8u *frameLen,
+                          boolean derandomize)
+{
+  EzspStatus status = EZSP_ASH_IN_PROGRESS;
+  const int8u *next = in;
+  const int8u *end = in + inLen;
+  const int8u *run;
+  int8u byte;
+
+  *consumed = 0;
+  if (inLen == 0) {
+    return status;
+  }
+  if (!ashDecodeInProgress) {
+    decodeLen = 0;
+    decodeByte1 = 0;
+    decodeByte2 = 0;
+    decodeFlip = 0;
+    decodeCrc = 0xFFFF;
+    decodeRandom = 0;
+    *frameLen = 0;
+  }
+
+  while (next < end && status == EZSP_ASH_IN_PROGRESS) {
+    byte = *next;
+    if (!isReservedByte(byte)) {
+      if (decodeFlip) {           // the byte after an escape is done alone
+        byte ^= decodeFlip;
+        decodeFlip = 0;
+        ashDecodeRun(&byte, 1, frame, frameLen, derandomize);
+        next++;
+      } else {                    // otherwise take the whole run of data
+        run = next;
+        do {
+          next++;
+        } while (next < end && !isReservedByte(*next));
+        ashDecodeRun(run, next - run, frame, frameLen, derandomize);
+      }
+      continue;
+    }
+    next++;
+
+    // The reserved bytes are handled exactly as in ashDecodeByte().
+    switch (byte) {
+    case ASH_FLAG:
+      if (decodeLen == 0) {
+        decodeFlip = 0;
+      } else if (decodeLen == 0xFF) {
+        status = EZSP_ASH_COMM_ERROR;
+      } else if (decodeCrc != ((int16u)decodeByte2 << 8) + decodeByte1) {
+        status = EZSP_ASH_BAD_CRC;
+      } else if (decodeLen < ASH_MIN_FRAME_WITH_CRC_LEN) {
+        status = EZSP_ASH_TOO_SHORT;
+      } else if (decodeLen > ASH_MAX_FRAME_WITH_CRC_LEN) {
+        status = EZSP_ASH_TOO_LONG;
+      } else {
+        status = EZSP_SUCCESS;
+      }
+      break;
+    case ASH_ESC:
+      decodeFlip = ASH_FLIP;
+      break;
+    case ASH_CAN:
+      status = EZSP_ASH_CANCELLED;
+      break;
+    case ASH_SUB:
+      decodeLen = 0xFF;
+      break;
+#ifdef EZSP_HOST
+    case ASH_XON:
+    case ASH_XOFF:
+      if (!ashReadConfig(rtsCts)) {
+        status = EZSP_ASH_ERROR_XON_XOFF;
+      }
+      break;
+#endif
+    }
+  }
+
+  *consumed = next - in;
+  ashDecodeInProgress = (status == EZSP_ASH_IN_PROGRESS);
+  return status;
+}
+
+// Feeds a run of data bytes through the two byte delay line that holds back
+// the crc. The bytes pushed out of the far end are added to the crc and,
+// up to the maximum frame length, copied to the frame and derandomized.
+// This is equivalent to calling ashDecodeByte() on each byte of the run.
+static void ashDecodeRun(const int8u *run,
+                         int16u count,
+                         int8u *frame,
+                         int8u *frameLen,
+                         boolean derandomize)
+{
+  int8u held[2];
+  int8u heldCount;
+  int16u emit;                // number of bytes pushed out of the delay line
+  int16u position;            // frame offset of the next byte pushed out
+  boolean store;
+  int16u n;
+  int16u i;
+  const int8u *src;
+
+  held[0] = decodeByte2;
+  held[1] = decodeByte1;
+  heldCount = (decodeLen < 2) ? decodeLen : 2;
+  emit = (heldCount + count > ASH_CRC_LEN) ? heldCount + count - ASH_CRC_LEN : 0;
+  store = (decodeLen <= ASH_MAX_FRAME_WITH_CRC_LEN);
+  position = (decodeLen > ASH_CRC_LEN) ? decodeLen - ASH_CRC_LEN : 0;
+
+  // First any held bytes, then the front of the run.
+  for (i = 0; i < 2 && emit > 0; i++) {
+    if (i == 0) {
+      n = (heldCount == 2) ? 1 : 0;
+      src = &held[0];
+    } else {
+      n = (heldCount == 0) ? 0 : 1;
+      src = &held[1];
+    }
+    if (n > emit) {
+      n = emit;
+    }
+    if (n == 0) {
+      continue;
+    }
+    decodeCrc = halCommonCrc16Array(src, n, decodeCrc);
+    if (store && position < ASH_MAX_FRAME_LEN) {
+      frame[position] = *src;
+    }
+    position += n;
+    emit -= n;
+  }
+  if (emit > 0) {
+    decodeCrc = halCommonCrc16Array(run, emit, decodeCrc);
+    if (store && position < ASH_MAX_FRAME_LEN) {
+      n = (emit < ASH_MAX_FRAME_LEN - position)
+          ? emit
+          : ASH_MAX_FRAME_LEN - position;
+      MEMCOPY(frame + position, run, n);
+    }
+    position += emit;
+  }
+
+  if (store) {
+    i = (position < ASH_MAX_FRAME_LEN) ? position : ASH_MAX_FRAME_LEN;
+    // DATA frame fields follow the control byte at offset 0.
+    if (derandomize
+        && i > 1
+        && i > *frameLen
+        && (frame[0] & ASH_DFRAME_MASK) == ASH_CONTROL_DATA) {
+      n = (*frameLen > 1) ? *frameLen : 1;
+      decodeRandom = ashRandomizeArray(decodeRandom, frame + n, i - n);
+    }
+    if (i > *frameLen) {
+      *frameLen = i;
+    }
+    n = decodeLen + count;
+    decodeLen = (n > ASH_MAX_FRAME_WITH_CRC_LEN + 1)
+                ? ASH_MAX_FRAME_WITH_CRC_LEN + 1
+                : n;
+  }
+
+  if (count >= 2) {
+    decodeByte2 = run[count - 2];
+    decodeByte1 = run[count - 1];
+  } else {
+    decodeByte2 = decodeByte1;
+    decodeByte1 = run[0];
+  }
+}
+
 int8u ashRandomizeArray(int8u seed, int8u *buf, int8u len)
 {
   if (seed == 0) {
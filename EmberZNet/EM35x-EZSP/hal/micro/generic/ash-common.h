@@ -43,6 +43,28 @@
  */
 int8u ashEncodeByte(int8u len, int8u byte, int8u *offset);
 
+/** @brief Encodes a complete ASH frame in one pass: adds the crc, byte
+ * stuffing and the end flag. The output is identical to that produced by
+ * calling ashEncodeByte() for every byte of the frame. Does not use or
+ * disturb the state of ashEncodeByte().
+ *
+ * @param control the control byte
+ *
+ * @param data    the data field (already randomized for a DATA frame);
+ *                may be NULL if dataLen is 0
+ *
+ * @param dataLen the length of the data field
+ *
+ * @param out     where to write the encoded frame, which must have room for
+ *                ASH_MAX_STUFFED_FRAME_LEN bytes
+ *
+ * @return the number of bytes written to out
+ */
+int16u ashEncodeFrame(int8u control,
+                      const int8u *data,
+                      int8u dataLen,
+                      int8u *out);
+
 /** @brief Decodes and validates an ASH frame. Data is passed to it
  * one byte at a time. Decodes byte stuffing, checks crc, finds the end flag
  * and (if enabled) terminates the frame early on CAN or SUB bytes.
@@ -66,6 +88,38 @@ int8u ashEncodeByte(int8u len, int8u byte, int8u *offset);
 */
 EzspStatus ashDecodeByte(int8u byte, int8u *out, int8u *outLen);
 
+/** @brief Decodes and validates an ASH frame from a block of input data.
+ * Produces the same frame and status as passing each byte in turn to
+ * ashDecodeByte(), but copies runs of unescaped data with memcpy and
+ * computes the crc a block at a time. Decoding stops at the end of a frame
+ * or when the input is used up, in which case the next call continues the
+ * same frame. The two decoders share state and may be mixed freely.
+ *
+ * @param in          the input data
+ *
+ * @param inLen       the number of bytes of input data
+ *
+ * @param consumed    pointer to where the number of input bytes used is
+ *                    written. Bytes following the end of a frame are not used.
+ *
+ * @param frame       the frame being decoded, of at least ASH_MAX_FRAME_LEN
+ *                    bytes. Must be the same for every call for a frame.
+ *
+ * @param frameLen    number of bytes output so far; set to 0 when a new
+ *                    frame is started
+ *
+ * @param derandomize if TRUE, the data field of a DATA frame is XORed with
+ *                    the ashRandomizeArray() sequence as it is output
+ *
+ * @return status of frame decoding, as for ashDecodeByte()
+ */
+EzspStatus ashDecodeBlock(const int8u *in,
+                          int16u inLen,
+                          int16u *consumed,
+                          int8u *frame,
+                          int8u *frameLen,
+                          boolean derandomize);
+
 /** @brief Randomizes array contents by XORing with an 8-bit pseudo
  * random sequence. This reduces the likelihood that byte-stuffing will 
  * greatly increase the size of the payload. (This could happen if a DATA
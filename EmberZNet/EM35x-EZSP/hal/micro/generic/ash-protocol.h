@@ -46,6 +46,8 @@
 #define ASH_CRC_LEN               2
 #define ASH_MIN_FRAME_WITH_CRC_LEN  (ASH_MIN_FRAME_LEN + ASH_CRC_LEN)
 #define ASH_MAX_FRAME_WITH_CRC_LEN  (ASH_MAX_FRAME_LEN + ASH_CRC_LEN)
+// Longest frame on the wire: every byte escaped, plus the flag
+#define ASH_MAX_STUFFED_FRAME_LEN   (2 * ASH_MAX_FRAME_WITH_CRC_LEN + 1)
 
 // Define lengths of short frames - includes control byte and data field
 #define ASH_NCP_SHFRAME_RX_LEN    2     /*!< longest non-data frame received */
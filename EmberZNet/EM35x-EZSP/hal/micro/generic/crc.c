@@ -38,6 +38,64 @@ int16u halCommonCrc16( int8u newByte, int16u prevResult  )
   return prevResult;
 }
 
+//--------------------------------------------------------------
+// Table driven CRC-CCITT for long blocks of data.
+//
+// crc16Table[0] is the usual byte-at-a-time table: the CRC of a single byte
+// shifted into a zero register. crc16Table[k][n] is the contribution of byte
+// n when it is followed by k more bytes, which lets the loop below fold four
+// input bytes into the register with four independent lookups (slicing-by-4).
+// The 2 KB table is built the first time it is needed.
+
+#define CRC16_POLYNOMIAL  0x1021
+#define CRC16_SLICES      4
+
+static int16u crc16Table[CRC16_SLICES][256];
+static boolean crc16TableReady = FALSE;
+
+static void crc16TableInit(void)
+{
+  int16u n;
+  int8u k;
+  int16u crc;
+
+  for (n = 0; n < 256; n++) {
+    crc = n << 8;
+    for (k = 0; k < 8; k++) {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ CRC16_POLYNOMIAL) : (crc << 1);
+    }
+    crc16Table[0][n] = crc;
+  }
+  for (n = 0; n < 256; n++) {
+    for (k = 1; k < CRC16_SLICES; k++) {
+      crc = crc16Table[k - 1][n];
+      crc16Table[k][n] = (crc << 8) ^ crc16Table[0][crc >> 8];
+    }
+  }
+  crc16TableReady = TRUE;
+}
+
+int16u halCommonCrc16Array(const int8u *data, int16u length, int16u prevResult)
+{
+  int16u crc = prevResult;
+
+  if (!crc16TableReady) {
+    crc16TableInit();
+  }
+  while (length >= CRC16_SLICES) {
+    crc = (crc16Table[3][(crc >> 8) ^ data[0]]
+           ^ crc16Table[2][(crc & 0xFF) ^ data[1]]
+           ^ crc16Table[1][data[2]]
+           ^ crc16Table[0][data[3]]);
+    data += CRC16_SLICES;
+    length -= CRC16_SLICES;
+  }
+  while (length--) {
+    crc = (crc << 8) ^ crc16Table[0][(crc >> 8) ^ *data++];
+  }
+  return crc;
+}
+
 //--------------------------------------------------------------
 // CRC-32 
 #define POLYNOMIAL              (0xEDB88320L)
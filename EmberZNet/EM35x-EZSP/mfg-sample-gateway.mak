@@ -110,7 +110,8 @@ APP_FILE= $(OUTPUT_DIR)/mfg-sample-gateway
 CPPFLAGS= $(INCLUDES) $(DEFINES) $(OPTIONS)
 LINK_FLAGS= \
   -lreadline \
- -lncurses
+ -lncurses \
+ -lpthread
 
 # Rules
 
@@ -116,7 +116,8 @@ APP_FILE= $(OUTPUT_DIR)/sink-gateway
 CPPFLAGS= $(INCLUDES) $(DEFINES) $(OPTIONS)
 LINK_FLAGS= \
   -lreadline \
- -lncurses
+ -lncurses \
+ -lpthread
 
 # Rules
 
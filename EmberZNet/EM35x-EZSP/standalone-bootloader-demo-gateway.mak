@@ -113,7 +113,8 @@ APP_FILE= $(OUTPUT_DIR)/standalone-bootloader-demo-gateway
 CPPFLAGS= $(INCLUDES) $(DEFINES) $(OPTIONS)
 LINK_FLAGS= \
   -lreadline \
- -lncurses
+ -lncurses \
+ -lpthread
 
 # Rules
 
@@ -123,7 +123,8 @@ APP_FILE= $(OUTPUT_DIR)/sp-gateway
 CPPFLAGS= $(INCLUDES) $(DEFINES) $(OPTIONS)
 LINK_FLAGS= \
   -lreadline \
- -lncurses
+ -lncurses \
+ -lpthread
 
 # Rules
 
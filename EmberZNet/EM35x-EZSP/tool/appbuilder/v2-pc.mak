@@ -144,7 +144,7 @@ APPLICATION_OBJECTS= $(shell echo $(APPLICATION_FILES) | xargs -n1 echo | sed -e
 APP_FILE= $(OUTPUT_DIR)/_replace_projectName_
 
 CPPFLAGS= $(INCLUDES) $(DEFINES) $(OPTIONS)
-LINK_FLAGS=
+LINK_FLAGS= -lpthread
 
 ifdef NO_READLINE
   CPPFLAGS += -DNO_READLINE
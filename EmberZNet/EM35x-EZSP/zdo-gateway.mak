@@ -113,7 +113,8 @@ APP_FILE= $(OUTPUT_DIR)/zdo-gateway
 CPPFLAGS= $(INCLUDES) $(DEFINES) $(OPTIONS)
 LINK_FLAGS= \
   -lreadline \
- -lncurses
+ -lncurses \
+ -lpthread
 
 # Rules
 
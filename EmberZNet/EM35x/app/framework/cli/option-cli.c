@@ -238,6 +238,10 @@ static void optionBindingTablePrintCommand(void)
   emberAfAppPrintln("%d of %d bindings used",
                     bindings,
                     emberAfGetBindingTableSize());
+#if defined(EZSP_HOST)
+  emberAfAppPrintln("%l reads answered by the host copy",
+                    ezspBindingMirrorSavedCommands());
+#endif
 #endif //defined(EMBER_AF_PRINT_ENABLE) && defined(EMBER_AF_PRINT_APP)
 }
 
@@ -605,6 +605,47 @@ boolean emberAfEndpointEnableDisable(int8u endpoint, boolean enable);
  */
 boolean emberAfEndpointIndexIsEnabled(int8u index);
 
+#if defined(DOXYGEN_SHOULD_SKIP_THIS) || defined(EZSP_HOST)
+/**
+ * @brief Adds an endpoint at run time, with the clusters and attributes of
+ * the given endpoint type, such as one of those generated by AppBuilder.
+ * The attributes are set to their defaults and the cluster init callbacks
+ * are called.  The endpoint is also added to the NCP.  At most
+ * EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT endpoints may be added, and the
+ * endpoint type's storage must fit in EMBER_AF_DYNAMIC_ENDPOINT_DATA_SIZE.
+ * Plugins that keep per endpoint state in tables sized at compile time do
+ * not serve dynamic endpoints.
+ *
+ * The NCP keeps a removed endpoint, disabled, until it is reset.  Adding the
+ * endpoint again before then enables it, so it must have the same profile,
+ * device id, version and clusters.  Otherwise the NCP must be reset first.
+ * At most EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT endpoint numbers may be used
+ * between resets of the NCP.
+ *
+ * @return ::EMBER_SUCCESS, ::EMBER_INVALID_ENDPOINT if the endpoint number
+ * is invalid or in use, ::EMBER_BAD_ARGUMENT if the attributes do not fit,
+ * ::EMBER_INVALID_CALL if the NCP has the endpoint with a different profile,
+ * device or clusters, ::EMBER_TABLE_FULL, or ::EMBER_ERR_FATAL if the NCP
+ * could not create it.
+ */
+EmberStatus emberAfAddDynamicEndpoint(int8u endpoint,
+                                      EmberAfEndpointType *endpointType,
+                                      EmberAfProfileId profileId,
+                                      int16u deviceId,
+                                      int8u deviceVersion,
+                                      int8u networkIndex);
+
+/**
+ * @brief Removes an endpoint added by emberAfAddDynamicEndpoint().  It
+ * remains on the NCP, but disabled, until the NCP is reset.  Its scenes,
+ * group memberships, reporting configurations and bindings are removed
+ * first.
+ *
+ * @return ::EMBER_SUCCESS or ::EMBER_INVALID_ENDPOINT.
+ */
+EmberStatus emberAfRemoveDynamicEndpoint(int8u endpoint);
+#endif
+
 
 /**
  * @brief This indicates a new image verification is taking place.
@@ -1031,7 +1072,10 @@ void emberAfEndpointEventControlSetActive(EmberEventControl *controls, int8u end
 /**
  * @brief A convenience function that sets the ::EmberEventControl for the
  * specified endpoint to run "timeMs" milliseconds in the future using
- * ::emberAfEventControlSetDelay.
+ * ::emberAfEventControlSetDelay.  Endpoint event controls are generated for
+ * the endpoints configured at startup only, so for a dynamic endpoint the
+ * endpoint event control functions do nothing and this returns
+ * ::EMBER_INVALID_ENDPOINT.
  */
 EmberStatus emberAfEndpointEventControlSetDelay(EmberEventControl *controls, int8u endpoint, int32u timeMs);
 /**
@@ -16,6 +16,50 @@ static boolean bindingGroupMatch(int8u endpoint,
 
 static int8u findGroupIndex(int8u endpoint, int16u groupId);
 
+#if defined(EZSP_HOST)
+// Every multicast frame received asks whether its endpoint is in its group.
+// So that this does not mean searching the binding table, the host indexes
+// the group memberships by group id, each group with the set of local
+// endpoints that are members.  The functions below keep the index up to
+// date; when anything else changes the binding table, such as a remote bind
+// request, a CLI command or an NCP reset, the index is rebuilt from the
+// table the next time it is used.
+
+#define GROUP_INDEX_NULL 0xFF
+#define GROUP_INDEX_BUCKETS 16
+#define groupHash(groupId) \
+  (((int8u)(groupId) ^ (int8u)((groupId) >> 8)) % GROUP_INDEX_BUCKETS)
+
+typedef struct {
+  int16u groupId;
+  int8u next;          // the next group in the same bucket
+  int8u memberCount;   // zero if the entry is not in use
+  int8u members[32];   // a bit for each endpoint
+} GroupMembers;
+
+#define isMember(group, endpoint) \
+  (((group)->members[(endpoint) >> 3] & BIT((endpoint) & 7)) != 0)
+
+// Each membership takes a binding, so there are no more groups than that.
+static GroupMembers groups[EMBER_BINDING_TABLE_SIZE];
+static int8u groupHeads[GROUP_INDEX_BUCKETS];
+static boolean groupIndexValid = FALSE;
+static int16u groupIndexVersion;
+
+static void refreshGroupIndex(void);
+static GroupMembers *findGroup(int16u groupId);
+static void indexMembership(int8u endpoint, int16u groupId, boolean member);
+static void updateGroupIndex(int16u version,
+                             int8u endpoint,
+                             int16u groupId,
+                             boolean member);
+
+#define bindingTableVersion() ezspBindingTableVersion()
+#else
+#define bindingTableVersion() 0
+#define updateGroupIndex(version, endpoint, groupId, member) UNUSED_VAR(version)
+#endif //EZSP_HOST
+
 void emberAfGroupsClusterServerInitCallback(int8u endpoint)
 {
   // The high bit of Name Support indicates whether group names are supported.
@@ -56,6 +100,7 @@ static EmberAfStatus addEntryToGroupTable(int8u endpoint, int16u groupId, int8u
     if (emberGetBinding(i, &binding) == EMBER_SUCCESS
         && binding.type == EMBER_UNUSED_BINDING) {
       EmberStatus status;
+      int16u version = bindingTableVersion();
       binding.type = EMBER_MULTICAST_BINDING;
       binding.identifier[0] = LOW_BYTE(groupId);
       binding.identifier[1] = HIGH_BYTE(groupId);
@@ -63,6 +108,7 @@ static EmberAfStatus addEntryToGroupTable(int8u endpoint, int16u groupId, int8u
 
       status = emberSetBinding(i, &binding);
       if (status == EMBER_SUCCESS) {
+        updateGroupIndex(version, endpoint, groupId, TRUE);
         // Set the group name, if supported
         emberAfPluginGroupsServerSetGroupNameCallback(endpoint,
                                                       groupId,
@@ -82,9 +128,11 @@ static EmberAfStatus removeEntryFromGroupTable(int8u endpoint, int16u groupId)
 {
   if(isGroupPresent(endpoint, groupId)) {
     int8u bindingIndex = findGroupIndex(endpoint, groupId);
+    int16u version = bindingTableVersion();
     EmberStatus status = emberDeleteBinding(bindingIndex);
     if (status == EMBER_SUCCESS) {
       int8u groupName[ZCL_GROUPS_CLUSTER_MAXIMUM_NAME_LENGTH + 1] = {0};
+      updateGroupIndex(version, endpoint, groupId, FALSE);
       emberAfPluginGroupsServerSetGroupNameCallback(endpoint,
                                                     groupId,
                                                     groupName);
@@ -154,7 +202,7 @@ boolean emberAfGroupsClusterViewGroupCallback(int16u groupId)
 boolean emberAfGroupsClusterGetGroupMembershipCallback(int8u groupCount,
                                                        int8u *groupList)
 {
-  int8u i, j;
+  int8u i;
   int8u count = 0;
   int8u list[EMBER_BINDING_TABLE_SIZE << 1];
   int8u listLen = 0;
@@ -178,6 +226,18 @@ boolean emberAfGroupsClusterGetGroupMembershipCallback(int8u groupCount,
   // When Group Count is zero, respond with a list of all active groups.
   // Otherwise, respond with a list of matches.
   if (groupCount == 0) {
+#if defined(EZSP_HOST)
+    int8u endpoint = emberAfCurrentEndpoint();
+    refreshGroupIndex();
+    for (i = 0; i < EMBER_BINDING_TABLE_SIZE; i++) {
+      if (groups[i].memberCount != 0 && isMember(&groups[i], endpoint)) {
+        list[listLen]     = LOW_BYTE(groups[i].groupId);
+        list[listLen + 1] = HIGH_BYTE(groups[i].groupId);
+        listLen += 2;
+        count++;
+      }
+    }
+#else
     for (i = 0; i < EMBER_BINDING_TABLE_SIZE; i++) {
       EmberBindingTableEntry entry;
       emberGetBinding(i, &entry);
@@ -190,22 +250,16 @@ boolean emberAfGroupsClusterGetGroupMembershipCallback(int8u groupCount,
         }
       }
     }
+#endif //EZSP_HOST
   } else {
+    // There is at most one binding for each group and endpoint.
     for (i = 0; i < groupCount; i++) {
       int16u groupId = emberAfGetInt16u(groupList + (i << 1), 0, 2);
-      for (j = 0; j < EMBER_BINDING_TABLE_SIZE; j++) {
-        EmberBindingTableEntry entry;
-        emberGetBinding(j, &entry);
-        if (entry.type == EMBER_MULTICAST_BINDING) {
-          if (entry.local == emberAfCurrentEndpoint()
-              && entry.identifier[0] == LOW_BYTE(groupId)
-              && entry.identifier[1] == HIGH_BYTE(groupId)) {
-            list[listLen]     = entry.identifier[0];
-            list[listLen + 1] = entry.identifier[1];
-            listLen += 2;
-            count++;
-          }
-        }
+      if (isGroupPresent(emberAfCurrentEndpoint(), groupId)) {
+        list[listLen]     = LOW_BYTE(groupId);
+        list[listLen + 1] = HIGH_BYTE(groupId);
+        listLen += 2;
+        count++;
       }
     }
   }
@@ -266,6 +320,7 @@ boolean emberAfGroupsClusterRemoveAllGroupsCallback(void)
     if(emberGetBinding(i, &binding) == EMBER_SUCCESS) {
       if (binding.type == EMBER_MULTICAST_BINDING
           && endpoint == binding.local) {
+        int16u version = bindingTableVersion();
         EmberStatus status = emberDeleteBinding(i);
         if (status != EMBER_SUCCESS) {
           success = FALSE;
@@ -276,6 +331,7 @@ boolean emberAfGroupsClusterRemoveAllGroupsCallback(void)
           int8u groupName[ZCL_GROUPS_CLUSTER_MAXIMUM_NAME_LENGTH + 1] = {0};
           int16u groupId = HIGH_LOW_TO_INT(binding.identifier[1], 
                                            binding.identifier[0]);
+          updateGroupIndex(version, endpoint, groupId, FALSE);
           emberAfPluginGroupsServerSetGroupNameCallback(endpoint, 
                                                         groupId, 
                                                         groupName);
@@ -342,6 +398,10 @@ void emberAfGroupsClusterClearGroupTableCallback(int8u endpoint)
 
 static boolean isGroupPresent(int8u endpoint, int16u groupId)
 {
+#if defined(EZSP_HOST)
+  GroupMembers *group = findGroup(groupId);
+  return (group != NULL && isMember(group, endpoint));
+#else
   int8u i;
 
   for (i = 0; i < EMBER_BINDING_TABLE_SIZE; i++) {
@@ -354,6 +414,7 @@ static boolean isGroupPresent(int8u endpoint, int16u groupId)
   }
   
   return FALSE;
+#endif //EZSP_HOST
 }
 
 static boolean bindingGroupMatch(int8u endpoint,
@@ -378,3 +439,100 @@ static int8u findGroupIndex(int8u endpoint, int16u groupId)
   }
   return EMBER_AF_GROUP_TABLE_NULL_INDEX;
 }
+
+#if defined(EZSP_HOST)
+// Rebuilds the index if the binding table has changed under it.
+static void refreshGroupIndex(void)
+{
+  int8u i;
+
+  if (groupIndexValid && groupIndexVersion == ezspBindingTableVersion()) {
+    return;
+  }
+  groupIndexVersion = ezspBindingTableVersion();
+  MEMSET(groups, 0, sizeof(groups));
+  MEMSET(groupHeads, GROUP_INDEX_NULL, sizeof(groupHeads));
+  for (i = 0; i < EMBER_BINDING_TABLE_SIZE; i++) {
+    EmberBindingTableEntry binding;
+    if (emberGetBinding(i, &binding) == EMBER_SUCCESS
+        && binding.type == EMBER_MULTICAST_BINDING) {
+      indexMembership(binding.local,
+                      HIGH_LOW_TO_INT(binding.identifier[1],
+                                      binding.identifier[0]),
+                      TRUE);
+    }
+  }
+  groupIndexValid = TRUE;
+}
+
+// Returns the group's entry in the index, or NULL if no endpoint is a member.
+static GroupMembers *findGroup(int16u groupId)
+{
+  int8u i;
+
+  refreshGroupIndex();
+  for (i = groupHeads[groupHash(groupId)];
+       i != GROUP_INDEX_NULL;
+       i = groups[i].next) {
+    if (groups[i].groupId == groupId) {
+      return &groups[i];
+    }
+  }
+  return NULL;
+}
+
+static void indexMembership(int8u endpoint, int16u groupId, boolean member)
+{
+  int8u *link = &groupHeads[groupHash(groupId)];
+  GroupMembers *group;
+
+  while (*link != GROUP_INDEX_NULL && groups[*link].groupId != groupId) {
+    link = &groups[*link].next;
+  }
+
+  if (*link == GROUP_INDEX_NULL) {
+    int8u i;
+    if (!member) {
+      return;
+    }
+    for (i = 0;
+         i < EMBER_BINDING_TABLE_SIZE && groups[i].memberCount != 0;
+         i++) {
+    }
+    if (i == EMBER_BINDING_TABLE_SIZE) {
+      return;
+    }
+    groups[i].groupId = groupId;
+    groups[i].next = GROUP_INDEX_NULL;
+    *link = i;
+  }
+
+  group = &groups[*link];
+  if (member && !isMember(group, endpoint)) {
+    group->members[endpoint >> 3] |= BIT(endpoint & 7);
+    group->memberCount++;
+  } else if (!member && isMember(group, endpoint)) {
+    group->members[endpoint >> 3] &= ~BIT(endpoint & 7);
+    group->memberCount--;
+    if (group->memberCount == 0) {
+      *link = group->next;
+    }
+  }
+}
+
+// Records a change this file has just made to the binding table, which was
+// at the given version before.  If anything else has changed the table since
+// the index was last brought up to date, it is left to be rebuilt instead.
+static void updateGroupIndex(int16u version,
+                             int8u endpoint,
+                             int16u groupId,
+                             boolean member)
+{
+  if (groupIndexValid
+      && groupIndexVersion == version
+      && ezspBindingTableVersion() == (int16u)(version + 1)) {
+    indexMembership(endpoint, groupId, member);
+    groupIndexVersion++;
+  }
+}
+#endif //EZSP_HOST
@@ -6,6 +6,14 @@
 // *******************************************************************
 
 
+// The number of key establishments that may be in progress at once.  The
+// NCP's CBKE library holds the ephemeral keys of one key establishment at a
+// time, so only one of them generates keys and SMACs at once; the others
+// exchange certificates with their partners or wait their turn.
+#ifndef EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS
+#define EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS 4
+#endif //EMBER_AF_PLUGIN_KEY_ESTABLISHMENT_MAX_SESSIONS
+
 // Init - bytes: suite (2), key gen time (1), derive secret time (1), cert (48)
 #define EM_AF_KE_INITIATE_SIZE (2 + 1 + 1 + EMBER_CERTIFICATE_SIZE)
 
@@ -0,0 +1,718 @@
+// *****************************************************************************
+// * meter-mirror-store-posix.c
+// *
+// * The meter mirror store's files, kept in a POSIX filesystem and memory
+// * mapped.  See meter-mirror-store.h for how they are laid out.
+// *
+// * Copyright 2012 by Ember Corporation. All rights reserved.              *80*
+// *****************************************************************************
+
+#include PLATFORM_HEADER //compiler/micro specifics, types
+
+#include "stack/include/ember-types.h"
+#include "stack/include/error.h"
+
+#include <stdio.h>      // snprintf, rename
+#include <stdlib.h>     // malloc, free
+#include <string.h>     // strlen, strcpy
+#include <errno.h>      // errno
+#include <fcntl.h>      // open
+#include <unistd.h>     // close, ftruncate, read, write
+#include <sys/types.h>  // mkdir
+#include <sys/stat.h>   // fstat, mkdir
+#include <sys/mman.h>   // mmap, munmap, msync
+
+#include "meter-mirror-store.h"
+
+//------------------------------------------------------------------------------
+// Files
+//
+// A file is a file header followed by its segments.  The headers are kept in
+// the gateway's own byte order, since the files never leave it.
+
+#define FILE_MAGIC_NUMBER   0x53534D4DUL    // "MMSS"
+#define FILE_VERSION        1
+#define FILE_HEADER_SIZE    32
+#define SEGMENT_SIZE        4096
+#define SEGMENT_HEADER_SIZE 32
+#define SEGMENT_DATA_SIZE   (SEGMENT_SIZE - SEGMENT_HEADER_SIZE)
+#define MAX_PATH_LENGTH     1000
+
+// The mirrors file records which endpoint mirrors which meter, as an endpoint
+// byte followed by the meter's EUI64 for each mirror.
+#define MIRRORS_FILE_NAME   "mirrors"
+#define MIRROR_RECORD_SIZE  (1 + EUI64_SIZE)
+
+// A time difference takes up to five bytes as a varint and a value
+// difference up to ten.
+#define MAX_ENCODED_READING_SIZE 15
+
+typedef struct {
+  int32u magicNumber;
+  int8u version;
+  int8u channel;
+  int8u intervalPeriod;
+  int8u reserved0;
+  int32u segmentCount;      // segments in use
+  int32u reserved1;
+  EmberEUI64 eui64;
+  int8u reserved2[8];
+} FileHeader;
+
+// The first reading of a segment is in its header.  The rest follow it, each
+// encoded as the difference from the one before.
+typedef struct {
+  int64u firstValue;
+  int64u lastValue;
+  int32u firstTime;
+  int32u lastTime;
+  int16u used;              // bytes of encoded readings
+  int16u count;             // readings, including the first
+  int32u reserved;
+} SegmentHeader;
+
+typedef struct Series {
+  struct Series *next;      // next series in the same hash bucket
+  EmberEUI64 eui64;
+  int8u channel;
+  int8u *mapping;
+  size_t mappingSize;
+} Series;
+
+static char *storeDirectory = NULL;
+static Series *seriesHash[EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS];
+
+// The number of seconds in each ZCL interval period.
+static const int32u intervalPeriodSeconds[] = {
+  86400,  // daily
+  3600,   // 60 minutes
+  1800,   // 30 minutes
+  900,    // 15 minutes
+  600,    // 10 minutes
+  450,    // 7.5 minutes
+  300,    // 5 minutes
+  150,    // 2.5 minutes
+};
+
+#define INTERVAL_PERIOD_COUNT \
+  (sizeof(intervalPeriodSeconds) / sizeof(intervalPeriodSeconds[0]))
+
+#define fileHeader(series) ((FileHeader *)(series)->mapping)
+
+#define segmentHeader(series, index)              \
+  ((SegmentHeader *)((series)->mapping            \
+                     + FILE_HEADER_SIZE           \
+                     + (size_t)(index) * SEGMENT_SIZE))
+
+#define segmentData(segment) ((int8u *)(segment) + SEGMENT_HEADER_SIZE)
+
+#define segmentCapacity(series) \
+  (((series)->mappingSize - FILE_HEADER_SIZE) / SEGMENT_SIZE)
+
+static Series **seriesBucket(EmberEUI64 eui64, int8u channel)
+{
+  int32u hash = channel;
+  int8u i;
+  for (i = 0; i < EUI64_SIZE; i++) {
+    hash = (hash * 31) + eui64[i];
+  }
+  return &seriesHash[hash % EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS];
+}
+
+// Files are named by the EUI64, most significant byte first, and channel.
+static void seriesPath(Series *series, char *path)
+{
+  const int8u *e = series->eui64;
+  snprintf(path,
+           MAX_PATH_LENGTH,
+           "%s/%02X%02X%02X%02X%02X%02X%02X%02X-%d.mms",
+           storeDirectory,
+           e[7], e[6], e[5], e[4], e[3], e[2], e[1], e[0],
+           series->channel);
+}
+
+static boolean mapSeries(Series *series, int fd, size_t size)
+{
+  void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return FALSE;
+  }
+  series->mapping = (int8u *)mapping;
+  series->mappingSize = size;
+  return TRUE;
+}
+
+// Maps a meter's file, creating it if asked to and it does not exist.
+static boolean openSeries(Series *series, boolean create)
+{
+  char path[MAX_PATH_LENGTH];
+  struct stat statInfo;
+  FileHeader *header;
+  boolean isNew;
+  int fd;
+
+  seriesPath(series, path);
+  fd = open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+  if (fd < 0) {
+    return FALSE;
+  }
+  if (fstat(fd, &statInfo) != 0) {
+    close(fd);
+    return FALSE;
+  }
+  isNew = (statInfo.st_size == 0);
+  if (isNew) {
+    statInfo.st_size = FILE_HEADER_SIZE + SEGMENT_SIZE;
+    if (ftruncate(fd, statInfo.st_size) != 0) {
+      close(fd);
+      return FALSE;
+    }
+  } else if (statInfo.st_size < FILE_HEADER_SIZE + SEGMENT_SIZE) {
+    close(fd);
+    return FALSE;
+  }
+  // The mapping holds its own reference to the file.
+  if (!mapSeries(series, fd, statInfo.st_size)) {
+    close(fd);
+    return FALSE;
+  }
+  close(fd);
+
+  header = fileHeader(series);
+  if (isNew) {
+    header->magicNumber = FILE_MAGIC_NUMBER;
+    header->version = FILE_VERSION;
+    header->channel = series->channel;
+    header->intervalPeriod = EMBER_AF_PLUGIN_METER_MIRROR_STORE_NO_INTERVAL_PERIOD;
+    header->segmentCount = 0;
+    MEMCOPY(header->eui64, series->eui64, EUI64_SIZE);
+  } else if (header->magicNumber != FILE_MAGIC_NUMBER
+             || header->version != FILE_VERSION
+             || header->segmentCount > segmentCapacity(series)) {
+    munmap(series->mapping, series->mappingSize);
+    series->mapping = NULL;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+// Doubles the room for segments in a meter's file.
+static boolean growSeries(Series *series)
+{
+  char path[MAX_PATH_LENGTH];
+  size_t size = (FILE_HEADER_SIZE
+                 + 2 * segmentCapacity(series) * SEGMENT_SIZE);
+  boolean mapped;
+  int fd;
+
+  seriesPath(series, path);
+  fd = open(path, O_RDWR);
+  if (fd < 0) {
+    return FALSE;
+  }
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    return FALSE;
+  }
+  munmap(series->mapping, series->mappingSize);
+  series->mapping = NULL;
+  mapped = mapSeries(series, fd, size);
+  close(fd);
+  return mapped;
+}
+
+// Finds the series for a meter's channel, opening its file the first time
+// and creating it if asked to.  Returns NULL if the meter has no file.
+static Series *findSeries(EmberEUI64 eui64, int8u channel, boolean create)
+{
+  Series **bucket = seriesBucket(eui64, channel);
+  Series *series = *bucket;
+
+  while (series != NULL
+         && (series->channel != channel
+             || MEMCOMPARE(series->eui64, eui64, EUI64_SIZE) != 0)) {
+    series = series->next;
+  }
+  if (series != NULL) {
+    // A file whose growth failed is mapped again as it is.
+    return ((series->mapping != NULL || openSeries(series, FALSE))
+            ? series
+            : NULL);
+  }
+  if (storeDirectory == NULL
+      || channel >= EMBER_AF_PLUGIN_METER_MIRROR_STORE_CHANNEL_COUNT) {
+    return NULL;
+  }
+
+  series = (Series *)malloc(sizeof(Series));
+  if (series == NULL) {
+    return NULL;
+  }
+  MEMCOPY(series->eui64, eui64, EUI64_SIZE);
+  series->channel = channel;
+  series->mapping = NULL;
+  series->mappingSize = 0;
+  if (!openSeries(series, create)) {
+    free(series);
+    return NULL;
+  }
+  series->next = *bucket;
+  *bucket = series;
+  return series;
+}
+
+//------------------------------------------------------------------------------
+// Encoding
+
+static int8u putVarint(int8u *to, int64u value)
+{
+  int8u length = 0;
+  while (value >= 0x80) {
+    to[length++] = (int8u)(value | 0x80);
+    value >>= 7;
+  }
+  to[length++] = (int8u)value;
+  return length;
+}
+
+static const int8u *getVarint(const int8u *from, int64u *value)
+{
+  int64u result = 0;
+  int8u shift = 0;
+  while (*from & 0x80) {
+    result |= (int64u)(*from++ & 0x7F) << shift;
+    shift += 7;
+  }
+  *value = result | ((int64u)*from++ << shift);
+  return from;
+}
+
+// Value differences are zigzag encoded, so that small decreases are as short
+// as small increases.
+#define zigzag(difference) \
+  ((((int64u)(difference)) << 1) ^ (int64u)((int64s)(difference) >> 63))
+#define unzigzag(encoded) \
+  (((encoded) >> 1) ^ (int64u)(-(int64s)((encoded) & 1)))
+
+static EmberStatus appendReading(Series *series, int32u time, int64u value)
+{
+  int8u encoded[MAX_ENCODED_READING_SIZE];
+  int32u count = fileHeader(series)->segmentCount;
+  SegmentHeader *segment;
+  int8u length;
+
+  if (count > 0) {
+    segment = segmentHeader(series, count - 1);
+    if (time < segment->lastTime) {
+      return EMBER_BAD_ARGUMENT;
+    }
+    length = putVarint(encoded, time - segment->lastTime);
+    length += putVarint(encoded + length, zigzag(value - segment->lastValue));
+    if (segment->used + length <= SEGMENT_DATA_SIZE) {
+      MEMCOPY(segmentData(segment) + segment->used, encoded, length);
+      // The header is updated after the reading is in place.
+      segment->used += length;
+      segment->count++;
+      segment->lastTime = time;
+      segment->lastValue = value;
+      return EMBER_SUCCESS;
+    }
+  }
+
+  if (count == segmentCapacity(series) && !growSeries(series)) {
+    return EMBER_ERR_FATAL;
+  }
+  segment = segmentHeader(series, count);
+  segment->firstTime = time;
+  segment->lastTime = time;
+  segment->firstValue = value;
+  segment->lastValue = value;
+  segment->used = 0;
+  segment->count = 1;
+  fileHeader(series)->segmentCount = count + 1;
+  return EMBER_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// Searching
+
+// Returns the last segment that starts at or before time, or the first
+// segment if they all start after it.
+static int32u findSegment(Series *series, int32u time)
+{
+  int32u low = 0;
+  int32u high = fileHeader(series)->segmentCount;
+  while (high - low > 1) {
+    int32u middle = low + (high - low) / 2;
+    if (segmentHeader(series, middle)->firstTime <= time) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+static int32u readSeries(Series *series,
+                         int32u startTime,
+                         int32u endTime,
+                         EmberAfMeterReading *readings,
+                         int32u maxReadings)
+{
+  int32u segmentCount = fileHeader(series)->segmentCount;
+  int32u readCount = 0;
+  int32u index;
+
+  if (segmentCount == 0) {
+    return 0;
+  }
+  for (index = findSegment(series, startTime);
+       index < segmentCount && readCount < maxReadings;
+       index++) {
+    SegmentHeader *segment = segmentHeader(series, index);
+    const int8u *next = segmentData(segment);
+    const int8u *end = next + segment->used;
+    int32u time = segment->firstTime;
+    int64u value = segment->firstValue;
+    int64u difference;
+
+    if (segment->lastTime < startTime) {
+      continue;
+    }
+    while (TRUE) {
+      if (time > endTime) {
+        return readCount;
+      }
+      if (startTime <= time) {
+        readings[readCount].time = time;
+        readings[readCount].value = value;
+        if (++readCount == maxReadings) {
+          return readCount;
+        }
+      }
+      if (next == end) {
+        break;
+      }
+      next = getVarint(next, &difference);
+      time += (int32u)difference;
+      next = getVarint(next, &difference);
+      value += unzigzag(difference);
+    }
+  }
+  return readCount;
+}
+
+static int32u latestTime(Series *series, int32u time)
+{
+  SegmentHeader *segment;
+  const int8u *next;
+  const int8u *end;
+  int32u latest;
+  int64u difference;
+
+  if (fileHeader(series)->segmentCount == 0) {
+    return 0;
+  }
+  segment = segmentHeader(series, findSegment(series, time));
+  if (time < segment->firstTime) {
+    return 0;
+  }
+  if (segment->lastTime <= time) {
+    return segment->lastTime;
+  }
+  next = segmentData(segment);
+  end = next + segment->used;
+  latest = segment->firstTime;
+  while (next != end) {
+    next = getVarint(next, &difference);
+    if (time < latest + (int32u)difference) {
+      break;
+    }
+    latest += (int32u)difference;
+    next = getVarint(next, &difference);
+  }
+  return latest;
+}
+
+//------------------------------------------------------------------------------
+// Public API
+
+EmberStatus emberAfPluginMeterMirrorStoreOpen(const char *directory)
+{
+  emberAfPluginMeterMirrorStoreClose();
+  if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+    return EMBER_ERR_FATAL;
+  }
+  storeDirectory = (char *)malloc(strlen(directory) + 1);
+  if (storeDirectory == NULL) {
+    return EMBER_NO_BUFFERS;
+  }
+  strcpy(storeDirectory, directory);
+  return EMBER_SUCCESS;
+}
+
+void emberAfPluginMeterMirrorStoreClose(void)
+{
+  int16u i;
+  for (i = 0; i < EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS; i++) {
+    while (seriesHash[i] != NULL) {
+      Series *series = seriesHash[i];
+      seriesHash[i] = series->next;
+      if (series->mapping != NULL) {
+        munmap(series->mapping, series->mappingSize);
+      }
+      free(series);
+    }
+  }
+  if (storeDirectory != NULL) {
+    free(storeDirectory);
+    storeDirectory = NULL;
+  }
+}
+
+void emberAfPluginMeterMirrorStoreFlush(void)
+{
+  Series *series;
+  int16u i;
+  for (i = 0; i < EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS; i++) {
+    for (series = seriesHash[i]; series != NULL; series = series->next) {
+      if (series->mapping != NULL) {
+        msync(series->mapping, series->mappingSize, MS_ASYNC);
+      }
+    }
+  }
+}
+
+// The file is written in full to a temporary file and renamed over the old
+// one, so a restart part way through leaves the old mirrors in place.
+EmberStatus emberAfPluginMeterMirrorStoreSaveMirrors(EmberEUI64 *meters,
+                                                     const boolean *isMirror)
+{
+  int8u records[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT
+                * MIRROR_RECORD_SIZE];
+  char path[MAX_PATH_LENGTH];
+  char newPath[MAX_PATH_LENGTH];
+  int16u length = 0;
+  int16u endpoint;
+  boolean written;
+  int fd;
+
+  if (storeDirectory == NULL) {
+    return EMBER_INVALID_CALL;
+  }
+  for (endpoint = 0;
+       endpoint < EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT;
+       endpoint++) {
+    if (isMirror[endpoint]) {
+      records[length] = (int8u)endpoint;
+      MEMCOPY(records + length + 1, meters[endpoint], EUI64_SIZE);
+      length += MIRROR_RECORD_SIZE;
+    }
+  }
+
+  snprintf(path, MAX_PATH_LENGTH, "%s/" MIRRORS_FILE_NAME, storeDirectory);
+  snprintf(newPath,
+           MAX_PATH_LENGTH,
+           "%s/" MIRRORS_FILE_NAME ".new",
+           storeDirectory);
+  fd = open(newPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return EMBER_ERR_FATAL;
+  }
+  written = (write(fd, records, length) == length);
+  if (close(fd) != 0 || !written || rename(newPath, path) != 0) {
+    unlink(newPath);
+    return EMBER_ERR_FATAL;
+  }
+  return EMBER_SUCCESS;
+}
+
+EmberStatus emberAfPluginMeterMirrorStoreLoadMirrors(EmberEUI64 *meters,
+                                                     boolean *isMirror)
+{
+  int8u record[MIRROR_RECORD_SIZE];
+  char path[MAX_PATH_LENGTH];
+  ssize_t length;
+  int fd;
+
+  MEMSET(isMirror,
+         FALSE,
+         EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT * sizeof(boolean));
+  if (storeDirectory == NULL) {
+    return EMBER_INVALID_CALL;
+  }
+  snprintf(path, MAX_PATH_LENGTH, "%s/" MIRRORS_FILE_NAME, storeDirectory);
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    // A store that has never had a mirror has no mirrors file.
+    return (errno == ENOENT ? EMBER_SUCCESS : EMBER_ERR_FATAL);
+  }
+  while ((length = read(fd, record, MIRROR_RECORD_SIZE))
+         == MIRROR_RECORD_SIZE) {
+    MEMCOPY(meters[record[0]], record + 1, EUI64_SIZE);
+    isMirror[record[0]] = TRUE;
+  }
+  close(fd);
+  return (length == 0 ? EMBER_SUCCESS : EMBER_ERR_FATAL);
+}
+
+EmberStatus emberAfPluginMeterMirrorStoreAppend(EmberEUI64 meter,
+                                               int8u channel,
+                                               int32u time,
+                                               int64u value)
+{
+  Series *series;
+  if (storeDirectory == NULL) {
+    return EMBER_INVALID_CALL;
+  }
+  if (channel >= EMBER_AF_PLUGIN_METER_MIRROR_STORE_CHANNEL_COUNT) {
+    return EMBER_BAD_ARGUMENT;
+  }
+  series = findSeries(meter, channel, TRUE);
+  if (series == NULL) {
+    return EMBER_ERR_FATAL;
+  }
+  return appendReading(series, time, value);
+}
+
+EmberStatus emberAfPluginMeterMirrorStoreAppendProfile(EmberEUI64 meter,
+                                                      int8u channel,
+                                                      int32u endTime,
+                                                      int8u intervalPeriod,
+                                                      int8u numberOfPeriods,
+                                                      const int32u *intervals)
+{
+  Series *series;
+  int32u period;
+  int32u latest;
+  int32u time;
+  int8u i;
+
+  if (storeDirectory == NULL) {
+    return EMBER_INVALID_CALL;
+  }
+  if (channel >= EMBER_AF_PLUGIN_METER_MIRROR_STORE_CHANNEL_COUNT
+      || intervalPeriod >= INTERVAL_PERIOD_COUNT) {
+    return EMBER_BAD_ARGUMENT;
+  }
+  series = findSeries(meter, channel, TRUE);
+  if (series == NULL) {
+    return EMBER_ERR_FATAL;
+  }
+  fileHeader(series)->intervalPeriod = intervalPeriod;
+  period = intervalPeriodSeconds[intervalPeriod];
+  latest = (fileHeader(series)->segmentCount == 0
+            ? 0
+            : segmentHeader(series,
+                            fileHeader(series)->segmentCount - 1)->lastTime);
+
+  // Oldest first.
+  for (i = numberOfPeriods; i > 0; i--) {
+    EmberStatus status;
+    if (endTime < (int32u)(i - 1) * period) {
+      continue;
+    }
+    time = endTime - (int32u)(i - 1) * period;
+    if (time <= latest) {
+      continue;
+    }
+    status = appendReading(series, time, intervals[i - 1]);
+    if (status != EMBER_SUCCESS) {
+      return status;
+    }
+  }
+  return EMBER_SUCCESS;
+}
+
+int32u emberAfPluginMeterMirrorStoreRead(EmberEUI64 meter,
+                                         int8u channel,
+                                         int32u startTime,
+                                         int32u endTime,
+                                         EmberAfMeterReading *readings,
+                                         int32u maxReadings)
+{
+  Series *series = findSeries(meter, channel, FALSE);
+  if (series == NULL || maxReadings == 0 || endTime < startTime) {
+    return 0;
+  }
+  return readSeries(series, startTime, endTime, readings, maxReadings);
+}
+
+int32u emberAfPluginMeterMirrorStoreLatestTime(EmberEUI64 meter,
+                                               int8u channel,
+                                               int32u time)
+{
+  Series *series = findSeries(meter, channel, FALSE);
+  return (series == NULL ? 0 : latestTime(series, time));
+}
+
+int8u emberAfPluginMeterMirrorStoreGetProfile(EmberEUI64 meter,
+                                              int8u channel,
+                                              int32u *endTime,
+                                              int8u *intervalPeriod,
+                                              int8u numberOfPeriods,
+                                              int32u *intervals)
+{
+  EmberAfMeterReading readings[EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS];
+  Series *series = findSeries(meter, channel, FALSE);
+  int32u period, last, first, readCount, i;
+
+  if (series == NULL
+      || fileHeader(series)->intervalPeriod >= INTERVAL_PERIOD_COUNT
+      || fileHeader(series)->segmentCount == 0) {
+    return 0;
+  }
+  period = intervalPeriodSeconds[fileHeader(series)->intervalPeriod];
+  last = latestTime(series, (*endTime == 0 ? 0xFFFFFFFFUL : *endTime));
+  if (last == 0) {
+    return 0;
+  }
+
+  // Only the intervals back to the first one stored are delivered.
+  first = segmentHeader(series, 0)->firstTime;
+  if (numberOfPeriods > EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS) {
+    numberOfPeriods = EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS;
+  }
+  if ((last - first) / period + 1 < numberOfPeriods) {
+    numberOfPeriods = (last - first) / period + 1;
+  }
+  MEMSET(intervals, 0, numberOfPeriods * sizeof(int32u));
+  readCount = readSeries(series,
+                         last - (numberOfPeriods - 1) * period,
+                         last,
+                         readings,
+                         numberOfPeriods);
+  for (i = 0; i < readCount; i++) {
+    int32u age = last - readings[i].time;
+    if (age % period == 0) {
+      intervals[age / period] = (int32u)readings[i].value;
+    }
+  }
+  *endTime = last;
+  *intervalPeriod = fileHeader(series)->intervalPeriod;
+  return numberOfPeriods;
+}
+
+int64u emberAfPluginMeterMirrorStoreSize(void)
+{
+  int64u size = 0;
+  Series *series;
+  int32u count;
+  int16u i;
+  for (i = 0; i < EMBER_AF_PLUGIN_METER_MIRROR_STORE_HASH_BUCKETS; i++) {
+    for (series = seriesHash[i]; series != NULL; series = series->next) {
+      // A file whose growth failed is not mapped until it is next used.
+      if (series->mapping == NULL) {
+        continue;
+      }
+      count = fileHeader(series)->segmentCount;
+      size += FILE_HEADER_SIZE;
+      if (count > 0) {
+        size += ((int64u)(count - 1) * SEGMENT_SIZE
+                 + SEGMENT_HEADER_SIZE
+                 + segmentHeader(series, count - 1)->used);
+      }
+    }
+  }
+  return size;
+}
@@ -0,0 +1,137 @@
+// *****************************************************************************
+// * meter-mirror-store.c
+// *
+// * Records the summations written to mirror endpoints in the meter mirror
+// * store and answers Get Profile commands sent to them from it.
+// *
+// * Copyright 2012 by Ember Corporation. All rights reserved.              *80*
+// *****************************************************************************
+
+#include "app/framework/include/af.h"
+#include "app/framework/util/common.h"
+#include "meter-mirror-store.h"
+
+// The meter each endpoint mirrors, by endpoint number.  The map is saved in
+// the store whenever a mirror is added or removed and loaded when the store is
+// opened, since the mirror endpoints outlive a restart of the gateway.
+static EmberEUI64 mirrorMeters[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+static boolean mirrorIsUsed[EMBER_AF_PLUGIN_METER_MIRROR_STORE_ENDPOINT_COUNT];
+
+static void saveMirrors(void)
+{
+  if (emberAfPluginMeterMirrorStoreSaveMirrors(mirrorMeters, mirrorIsUsed)
+      != EMBER_SUCCESS) {
+    emberAfSimpleMeteringClusterPrintln("ERR: can't save meter mirrors");
+  }
+}
+
+void emberAfPluginMeterMirrorStoreInitCallback(void)
+{
+  if (emberAfPluginMeterMirrorStoreOpen(EMBER_AF_PLUGIN_METER_MIRROR_STORE_DIRECTORY)
+      != EMBER_SUCCESS) {
+    emberAfSimpleMeteringClusterPrintln("ERR: can't open meter mirror store %s",
+                                        EMBER_AF_PLUGIN_METER_MIRROR_STORE_DIRECTORY);
+  } else if (emberAfPluginMeterMirrorStoreLoadMirrors(mirrorMeters,
+                                                      mirrorIsUsed)
+             != EMBER_SUCCESS) {
+    emberAfSimpleMeteringClusterPrintln("ERR: can't load meter mirrors");
+  }
+}
+
+void emberAfPluginMeterMirrorStoreMirrorAdded(int8u endpoint,
+                                              EmberEUI64 meter)
+{
+  MEMCOPY(mirrorMeters[endpoint], meter, EUI64_SIZE);
+  mirrorIsUsed[endpoint] = TRUE;
+  saveMirrors();
+}
+
+void emberAfPluginMeterMirrorStoreMirrorRemoved(int8u endpoint)
+{
+  mirrorIsUsed[endpoint] = FALSE;
+  saveMirrors();
+}
+
+void emberAfSimpleMeteringClusterServerAttributeChangedCallback(int8u endpoint,
+                                                                EmberAfAttributeId attributeId)
+{
+  int8u summation[6];
+  int64u value = 0;
+  int8u channel;
+  int8u i;
+
+  if (!mirrorIsUsed[endpoint]) {
+    return;
+  }
+  if (attributeId == ZCL_CURRENT_SUMMATION_DELIVERED_ATTRIBUTE_ID) {
+    channel = EMBER_AF_PLUGIN_METER_MIRROR_STORE_SUMMATION_DELIVERED;
+  } else if (attributeId == ZCL_CURRENT_SUMMATION_RECEIVED_ATTRIBUTE_ID) {
+    channel = EMBER_AF_PLUGIN_METER_MIRROR_STORE_SUMMATION_RECEIVED;
+  } else {
+    return;
+  }
+  if (emberAfReadServerAttribute(endpoint,
+                                 ZCL_SIMPLE_METERING_CLUSTER_ID,
+                                 attributeId,
+                                 summation,
+                                 sizeof(summation))
+      != EMBER_ZCL_STATUS_SUCCESS) {
+    return;
+  }
+  for (i = 0; i < sizeof(summation); i++) {
+    value = ((value << 8)
+             | summation[BIGENDIAN_CPU ? i : sizeof(summation) - 1 - i]);
+  }
+  if (emberAfPluginMeterMirrorStoreAppend(mirrorMeters[endpoint],
+                                          channel,
+                                          emberAfGetCurrentTime(),
+                                          value)
+      != EMBER_SUCCESS) {
+    emberAfSimpleMeteringClusterPrintln("ERR: can't store summation for ep %x",
+                                        endpoint);
+  }
+}
+
+boolean emberAfPluginMeterMirrorStoreGetProfileCommand(int8u endpoint,
+                                                       int8u intervalChannel,
+                                                       int32u endTime,
+                                                       int8u numberOfPeriods)
+{
+  int32u intervals[EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS];
+  int8u intervalData[EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS * 3];
+  int8u intervalPeriod = 0;
+  int8u delivered = 0;
+  int8u status;
+  int8u i;
+
+  if (!mirrorIsUsed[endpoint]) {
+    return FALSE;
+  }
+
+  // Status 0x01 is an undefined interval channel and 0x05 no intervals
+  // available for the requested time.
+  if (intervalChannel > EMBER_AF_PLUGIN_METER_MIRROR_STORE_INTERVAL_RECEIVED) {
+    status = 0x01;
+  } else {
+    delivered = emberAfPluginMeterMirrorStoreGetProfile(mirrorMeters[endpoint],
+                                                        intervalChannel,
+                                                        &endTime,
+                                                        &intervalPeriod,
+                                                        numberOfPeriods,
+                                                        intervals);
+    status = (delivered == 0 ? 0x05 : 0x00);
+  }
+  for (i = 0; i < delivered; i++) {
+    emberAfCopyInt24u(intervalData, i * 3, intervals[i]);
+  }
+
+  emberAfFillCommandSimpleMeteringClusterGetProfileResponse(endTime,
+                                                            status,
+                                                            intervalPeriod,
+                                                            delivered,
+                                                            intervalData,
+                                                            delivered * 3);
+  appResponseData[1] = emberAfIncomingZclSequenceNumber;
+  emberAfSendResponse();
+  return TRUE;
+}
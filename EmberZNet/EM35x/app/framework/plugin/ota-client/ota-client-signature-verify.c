@@ -42,11 +42,14 @@
 // Globals
 //------------------------------------------------------------------------------
 
-// The size of this buffer is based on the max size that EZSP can handle, 
-// including framing.
 // This MUST be a multiple of 16, because the emberAesMmmoHashUpdate()
-// code requires this.
-#define MAX_BLOCK_SIZE_FOR_HASH 96
+// code requires this.  The host hashes in software, so it can take larger
+// blocks and read the image in fewer pieces.
+#if defined(EZSP_HOST)
+  #define MAX_BLOCK_SIZE_FOR_HASH 1024
+#else
+  #define MAX_BLOCK_SIZE_FOR_HASH 96
+#endif
 
 #define MAX_SIGNERS 3
 static const int8u PGM_NO_CONST allowedSignerEuiBigEndian[MAX_SIGNERS][EUI64_SIZE] = {
@@ -84,17 +87,6 @@ typedef enum {
 #if defined (EZSP_HOST)
 // External
 void emberReverseMemCopy(int8u* dest, const int8u* src, int16u length);
-
-
-// For now we declare these here, but they should be moved to a more appropriate
-// header.
-void emberAesMmoHashInit(EmberAesMmoHashContext* context);
-EmberStatus emberAesMmoHashUpdate(EmberAesMmoHashContext* context,
-                                  int32u length,
-                                  const int8u* data);
-EmberStatus emberAesMmoHashFinal(EmberAesMmoHashContext* context,
-                                 int32u length,
-                                 const int8u* finalData);
 #endif // EZSP_HOST
 
 static boolean checkSigner(const int8u* bigEndianSignerEui64);
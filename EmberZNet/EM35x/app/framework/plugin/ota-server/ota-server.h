@@ -22,6 +22,9 @@ int8u emAfOtaPageRequestHandler(int8u endpoint,
 
 boolean emAfOtaServerHandlingPageRequest(void);
 
+// Prints each client's page request session and its throughput.
+void emAfOtaPageRequestPrintSessions(void);
+
 // This will eventually be moved into a Plugin specific callbacks file.
 void emberAfOtaServerSendUpgradeCommandCallback(EmberNodeId dest,
                                                 int8u endpoint,
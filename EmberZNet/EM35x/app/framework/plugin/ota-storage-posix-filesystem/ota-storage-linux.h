@@ -9,8 +9,18 @@ typedef struct {
   boolean ignoreFilesWithUnderscorePrefix;
   boolean printFileDiscoveryOrRemoval;
   EmAfOtaStorageFileAddedHandler* fileAddedHandler;
+  boolean useHeaderIndex;   // keep parsed headers in the storage directory
+  boolean watchDirectory;   // notice images added or removed (Linux only)
 } EmAfOtaStorageLinuxConfig;
 
 void emAfOtaStorageGetConfig(EmAfOtaStorageLinuxConfig* currentConfig);
 void emAfOtaStorageSetConfig(const EmAfOtaStorageLinuxConfig* newConfig);
 
+// Adds and removes the images that have been added to or removed from the
+// storage directory since it was last checked.  This is done whenever the
+// cache is searched or iterated, but an application may also wait for the
+// watch file descriptor to become readable and call this itself.  The file
+// descriptor is -1 if the directory is not being watched.
+void emAfOtaStorageCheckDirectory(void);
+int emAfOtaStorageGetWatchFd(void);
+
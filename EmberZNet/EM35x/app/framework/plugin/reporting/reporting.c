@@ -17,12 +17,20 @@
 #define READ_DATA_SIZE 8 // max size if attributes aren't present
 #endif
 
-#define NULL_INDEX 0xFF
+// The last reported value is kept for attributes up to this size, which
+// covers every type other than strings.
+#define REPORT_VALUE_SIZE 8
+
+#define NULL_INDEX 0xFFFF
+
+#if !defined(EZSP_HOST) && EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE > 255
+  #error "The reporting table is stored in indexed tokens, which allow at most 255 entries."
+#endif
 
 static void conditionallySendReport(int8u endpoint, EmberAfClusterId clusterId);
 static void scheduleTick(void);
-static void removeConfiguration(int8u index);
-static void removeConfigurationAndScheduleTick(int8u index);
+static void removeConfiguration(int16u index);
+static void removeConfigurationAndScheduleTick(int16u index);
 static EmberAfStatus configureReceivedAttribute(const EmberAfClusterCommand *cmd,
                                                 EmberAfAttributeId attributeId,
                                                 int8u mask,
@@ -32,39 +40,393 @@ static void putReportableChangeInResp(const EmberAfPluginReportingEntry *entry,
 
 EmberEventControl emberAfPluginReportingTickEventControl;
 
+// Used entries are kept in lists by a hash of their endpoint, cluster,
+// attribute, mask, and manufacturer code, so that an entry can be found
+// without reading the whole table.  Unused entries are kept in a list of their
+// own.  Reported entries that have a report pending, either because of a
+// reportable change or because they have a maximum interval, are kept in a
+// heap ordered by the time the report is due.  Each tick only reads the
+// entries that are due, and the next tick is scheduled from the top of the
+// heap.
+//
+// The links in the lists and the positions in the heap are stored as one
+// more than the index, so that 0 means none.
 typedef struct {
   int32u lastReportTime;
-  int32u lastReportValue;
+  int8u lastReportValue[REPORT_VALUE_SIZE];
   boolean reportableChange;
+  int16u next;
+  int16u previous;
+  int16u heapIndex;
 } EmAfPluginReportingVolatileData;
 static EmAfPluginReportingVolatileData volatileData[EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE];
 
+static int16u buckets[EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE];
+static int16u unusedEntries;
+
+typedef struct {
+  int32u deadline;
+  int16u index;
+} ReportDeadline;
+static ReportDeadline heap[EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE];
+static int16u heapCount;
+
+// The reports that are due in a tick, sorted so that attributes that are
+// reported together in the same frame are next to each other.
+typedef struct {
+  int16u index;
+  int8u endpoint;
+  int8u mask;
+  EmberAfClusterId clusterId;
+  int16u manufacturerCode;
+  EmberAfAttributeId attributeId;
+  int16u maxInterval;
+} DueReport;
+static DueReport dueReports[EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE];
+
+static void storeEntry(int16u index, EmberAfPluginReportingEntry *value);
+static void indexEntry(int16u index, const EmberAfPluginReportingEntry *entry);
+static void unindexEntry(int16u index);
+
 #ifdef EZSP_HOST
 static EmberAfPluginReportingEntry table[EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE];
-void emAfPluginReportingGetEntry(int8u index, EmberAfPluginReportingEntry *result)
+void emAfPluginReportingGetEntry(int16u index, EmberAfPluginReportingEntry *result)
 {
   MEMCOPY(result, &table[index], sizeof(EmberAfPluginReportingEntry));
 }
-void emAfPluginReportingSetEntry(int8u index, EmberAfPluginReportingEntry *value)
+static void storeEntry(int16u index, EmberAfPluginReportingEntry *value)
 {
   MEMCOPY(&table[index], value, sizeof(EmberAfPluginReportingEntry));
 }
 #else
-void emAfPluginReportingGetEntry(int8u index, EmberAfPluginReportingEntry *result)
+void emAfPluginReportingGetEntry(int16u index, EmberAfPluginReportingEntry *result)
 {
   halCommonGetIndexedToken(result, TOKEN_REPORT_TABLE, index);
 }
-void emAfPluginReportingSetEntry(int8u index, EmberAfPluginReportingEntry *value)
+static void storeEntry(int16u index, EmberAfPluginReportingEntry *value)
 {
   halCommonSetIndexedToken(TOKEN_REPORT_TABLE, index, value);
 }
 #endif
 
+void emAfPluginReportingSetEntry(int16u index, EmberAfPluginReportingEntry *value)
+{
+  unindexEntry(index);
+  storeEntry(index, value);
+  indexEntry(index, value);
+}
+
+//------------------------------------------------------------------------------
+// Lists of entries
+
+static int16u *findList(int8u endpoint,
+                        EmberAfClusterId clusterId,
+                        EmberAfAttributeId attributeId,
+                        int8u mask,
+                        int16u manufacturerCode)
+{
+  int32u hash;
+  if (endpoint == EMBER_AF_PLUGIN_REPORTING_UNUSED_ENDPOINT_ID) {
+    return &unusedEntries;
+  }
+  hash = endpoint;
+  hash = hash * 31 + clusterId;
+  hash = hash * 31 + attributeId;
+  hash = hash * 31 + mask;
+  hash = hash * 31 + manufacturerCode;
+  return &buckets[hash % EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE];
+}
+
+static int16u *findEntryList(const EmberAfPluginReportingEntry *entry)
+{
+  return findList(entry->endpoint,
+                  entry->clusterId,
+                  entry->attributeId,
+                  entry->mask,
+                  entry->manufacturerCode);
+}
+
+static void linkEntry(int16u *list, int16u index)
+{
+  volatileData[index].previous = 0;
+  volatileData[index].next = *list;
+  if (*list != 0) {
+    volatileData[*list - 1].previous = index + 1;
+  }
+  *list = index + 1;
+}
+
+static void unlinkEntry(int16u *list, int16u index)
+{
+  int16u next = volatileData[index].next;
+  int16u previous = volatileData[index].previous;
+  if (previous == 0) {
+    *list = next;
+  } else {
+    volatileData[previous - 1].next = next;
+  }
+  if (next != 0) {
+    volatileData[next - 1].previous = previous;
+  }
+  volatileData[index].next = 0;
+  volatileData[index].previous = 0;
+}
+
+// Returns the index of the matching entry and copies it into the result, or
+// returns NULL_INDEX.  The source and source endpoint are only checked for
+// received entries.
+static int16u findEntry(EmberAfReportingDirection direction,
+                        int8u endpoint,
+                        EmberAfClusterId clusterId,
+                        EmberAfAttributeId attributeId,
+                        int8u mask,
+                        int16u manufacturerCode,
+                        EmberNodeId source,
+                        int8u sourceEndpoint,
+                        EmberAfPluginReportingEntry *result)
+{
+  int16u next = *findList(endpoint,
+                          clusterId,
+                          attributeId,
+                          mask,
+                          manufacturerCode);
+  while (next != 0) {
+    int16u index = next - 1;
+    emAfPluginReportingGetEntry(index, result);
+    if (result->direction == direction
+        && result->endpoint == endpoint
+        && result->clusterId == clusterId
+        && result->attributeId == attributeId
+        && result->mask == mask
+        && result->manufacturerCode == manufacturerCode
+        && (direction == EMBER_ZCL_REPORTING_DIRECTION_REPORTED
+            || (result->data.received.source == source
+                && result->data.received.endpoint == sourceEndpoint))) {
+      return index;
+    }
+    next = volatileData[index].next;
+  }
+  return NULL_INDEX;
+}
+
+//------------------------------------------------------------------------------
+// Heap of report deadlines
+
+// Millisecond times are compared allowing for wrapping.
+#define isEarlier(a, b) ((int32s)((a) - (b)) < 0)
+
+static void heapSet(int16u position, ReportDeadline deadline)
+{
+  heap[position] = deadline;
+  volatileData[deadline.index].heapIndex = position + 1;
+}
+
+static void siftUp(int16u position)
+{
+  ReportDeadline deadline = heap[position];
+  while (position > 0) {
+    int16u parent = (position - 1) / 2;
+    if (!isEarlier(deadline.deadline, heap[parent].deadline)) {
+      break;
+    }
+    heapSet(position, heap[parent]);
+    position = parent;
+  }
+  heapSet(position, deadline);
+}
+
+static void siftDown(int16u position)
+{
+  ReportDeadline deadline = heap[position];
+  for (;;) {
+    int16u child = 2 * position + 1;
+    if (child >= heapCount) {
+      break;
+    }
+    if (child + 1 < heapCount
+        && isEarlier(heap[child + 1].deadline, heap[child].deadline)) {
+      child++;
+    }
+    if (!isEarlier(heap[child].deadline, deadline.deadline)) {
+      break;
+    }
+    heapSet(position, heap[child]);
+    position = child;
+  }
+  heapSet(position, deadline);
+}
+
+static void heapRemove(int16u index)
+{
+  int16u position = volatileData[index].heapIndex - 1;
+  int32u removed = heap[position].deadline;
+  heapCount--;
+  if (position < heapCount) {
+    heapSet(position, heap[heapCount]);
+    if (isEarlier(heap[position].deadline, removed)) {
+      siftUp(position);
+    } else {
+      siftDown(position);
+    }
+  }
+  volatileData[index].heapIndex = 0;
+}
+
+// Puts a reported entry in the heap at the time its next report is due, or
+// takes it out if no report is pending.  A report is due once the minimum
+// interval has passed if there has been a reportable change, or else once the
+// maximum interval has passed, if there is one.
+static void scheduleReport(int16u index, int16u minInterval, int16u maxInterval)
+{
+  EmAfPluginReportingVolatileData *data = &volatileData[index];
+  ReportDeadline deadline;
+
+  if (data->reportableChange) {
+    deadline.deadline = (data->lastReportTime
+                         + minInterval * MILLISECOND_TICKS_PER_SECOND);
+  } else if (maxInterval != 0x0000) {
+    deadline.deadline = (data->lastReportTime
+                         + maxInterval * MILLISECOND_TICKS_PER_SECOND);
+  } else {
+    if (data->heapIndex != 0) {
+      heapRemove(index);
+    }
+    return;
+  }
+
+  deadline.index = index;
+  if (data->heapIndex == 0) {
+    heapCount++;
+    heapSet(heapCount - 1, deadline);
+    siftUp(heapCount - 1);
+  } else {
+    int16u position = data->heapIndex - 1;
+    int32u previous = heap[position].deadline;
+    heap[position].deadline = deadline.deadline;
+    if (isEarlier(deadline.deadline, previous)) {
+      siftUp(position);
+    } else {
+      siftDown(position);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static void indexEntry(int16u index, const EmberAfPluginReportingEntry *entry)
+{
+  linkEntry(findEntryList(entry), index);
+  if (entry->endpoint != EMBER_AF_PLUGIN_REPORTING_UNUSED_ENDPOINT_ID
+      && entry->direction == EMBER_ZCL_REPORTING_DIRECTION_REPORTED) {
+    scheduleReport(index,
+                   entry->data.reported.minInterval,
+                   entry->data.reported.maxInterval);
+  }
+}
+
+static void unindexEntry(int16u index)
+{
+  EmberAfPluginReportingEntry entry;
+  emAfPluginReportingGetEntry(index, &entry);
+  unlinkEntry(findEntryList(&entry), index);
+  if (volatileData[index].heapIndex != 0) {
+    heapRemove(index);
+  }
+}
+
+// Returns the magnitude of the difference between two values of the given
+// size in the byte order of attribute storage, or MAX_INT32U_VALUE if it does
+// not fit in 32 bits.  Values are compared as unsigned numbers.
+static int32u getDifference(const int8u *value1,
+                            const int8u *value2,
+                            int8u size)
+{
+#if (BIGENDIAN_CPU)
+  #define VALUE_BYTE(value, i) ((value)[size - (i) - 1])
+#else
+  #define VALUE_BYTE(value, i) ((value)[i])
+#endif
+  const int8u *larger = value1;
+  const int8u *smaller = value2;
+  int32u difference = 0;
+  int16s borrow = 0;
+  int8u i;
+
+  // Find the larger value by comparing from the most significant byte.
+  for (i = size; i > 0; i--) {
+    if (VALUE_BYTE(value1, i - 1) != VALUE_BYTE(value2, i - 1)) {
+      if (VALUE_BYTE(value1, i - 1) < VALUE_BYTE(value2, i - 1)) {
+        larger = value2;
+        smaller = value1;
+      }
+      break;
+    }
+  }
+
+  // Subtract from the least significant byte.
+  for (i = 0; i < size; i++) {
+    int16s byte = (VALUE_BYTE(larger, i) - VALUE_BYTE(smaller, i) - borrow);
+    borrow = (byte < 0 ? 1 : 0);
+    byte &= 0xFF;
+    if (i < sizeof(difference)) {
+      difference |= (int32u)byte << (8 * i);
+    } else if (byte != 0) {
+      return MAX_INT32U_VALUE;
+    }
+  }
+  return difference;
+#undef VALUE_BYTE
+}
+
 void emberAfPluginReportingInitCallback(void)
 {
+  int16u i;
+
+  MEMSET(buckets, 0, sizeof(buckets));
+  unusedEntries = 0;
+  heapCount = 0;
+  for (i = EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i > 0; i--) {
+    EmberAfPluginReportingEntry entry;
+    emAfPluginReportingGetEntry(i - 1, &entry);
+    volatileData[i - 1].heapIndex = 0;
+    indexEntry(i - 1, &entry);
+  }
   scheduleTick();
 }
 
+// Sorts the due reports by endpoint, cluster, direction, and manufacturer
+// code, which together decide where a report is sent.  Shell sort is used as
+// it needs no extra memory.
+static boolean dueReportAfter(const DueReport *a, const DueReport *b)
+{
+  if (a->endpoint != b->endpoint) {
+    return a->endpoint > b->endpoint;
+  } else if (a->clusterId != b->clusterId) {
+    return a->clusterId > b->clusterId;
+  } else if (a->mask != b->mask) {
+    return a->mask > b->mask;
+  } else if (a->manufacturerCode != b->manufacturerCode) {
+    return a->manufacturerCode > b->manufacturerCode;
+  }
+  return a->index > b->index;
+}
+
+static void sortDueReports(int16u count)
+{
+  int16u gap, i, j;
+  for (gap = count / 2; gap > 0; gap /= 2) {
+    for (i = gap; i < count; i++) {
+      DueReport report = dueReports[i];
+      for (j = i;
+           j >= gap && dueReportAfter(&dueReports[j - gap], &report);
+           j -= gap) {
+        dueReports[j] = dueReports[j - gap];
+      }
+      dueReports[j] = report;
+    }
+  }
+}
+
 void emberAfPluginReportingTickEventHandler(void)
 {
   EmberApsFrame *apsFrame = NULL;
@@ -73,50 +435,72 @@ void emberAfPluginReportingTickEventHandler(void)
   int32u currentTime = halCommonGetInt32uMillisecondTick();
   int16u manufacturerCode;
   int8u readData[READ_DATA_SIZE];
-  int8u i, dataSize;
+  int8u dataSize;
+  int16u i, dueCount = 0;
   boolean clientToServer;
 
-  for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
+  // We will only send reports for active reported attributes and only if a
+  // reportable change has occurred and the minimum interval has elapsed or
+  // if the maximum interval is set and has elapsed.  Those are the entries at
+  // the top of the heap.
+  while (heapCount > 0 && !isEarlier(currentTime, heap[0].deadline)) {
     EmberAfPluginReportingEntry entry;
-    emAfPluginReportingGetEntry(i, &entry);
-
-    // We will only send reports for active reported attributes and only if a
-    // reportable change has occurred and the minimum interval has elapsed or
-    // if the maximum interval is set and has elapsed.
-    if (entry.endpoint == EMBER_AF_PLUGIN_REPORTING_UNUSED_ENDPOINT_ID
-        || entry.direction != EMBER_ZCL_REPORTING_DIRECTION_REPORTED
-        || (currentTime - volatileData[i].lastReportTime
-            < entry.data.reported.minInterval * MILLISECOND_TICKS_PER_SECOND)
-        || (!volatileData[i].reportableChange
-            && (currentTime - volatileData[i].lastReportTime
-                < (entry.data.reported.maxInterval
-                   * MILLISECOND_TICKS_PER_SECOND)))) {
-      continue;
-    }
-
-    status = emAfReadAttribute(entry.endpoint,
-                               entry.clusterId,
-                               entry.attributeId,
-                               entry.mask,
-                               entry.manufacturerCode,
+    DueReport *report = &dueReports[dueCount++];
+    report->index = heap[0].index;
+    heapRemove(report->index);
+    emAfPluginReportingGetEntry(report->index, &entry);
+    report->endpoint = entry.endpoint;
+    report->mask = entry.mask;
+    report->clusterId = entry.clusterId;
+    report->manufacturerCode = entry.manufacturerCode;
+    report->attributeId = entry.attributeId;
+    report->maxInterval = entry.data.reported.maxInterval;
+  }
+  sortDueReports(dueCount);
+
+  for (i = 0; i < dueCount; i++) {
+    DueReport *report = &dueReports[i];
+    EmAfPluginReportingVolatileData *data = &volatileData[report->index];
+    boolean client = ((report->mask & CLUSTER_MASK_CLIENT) != 0);
+
+    // Whether or not the report is sent, the next one is not due until the
+    // maximum interval has passed again, unless there is another change.
+    // This keeps an attribute that cannot be read from being retried on
+    // every tick.
+    data->reportableChange = FALSE;
+    data->lastReportTime = currentTime;
+    scheduleReport(report->index, 0, report->maxInterval);
+
+    status = emAfReadAttribute(report->endpoint,
+                               report->clusterId,
+                               report->attributeId,
+                               report->mask,
+                               report->manufacturerCode,
                                (int8u *)&readData,
                                READ_DATA_SIZE,
                                &dataType);
     if (status != EMBER_ZCL_STATUS_SUCCESS) {
       emberAfReportingPrintln("ERR: reading cluster 0x%2x attribute 0x%2x: 0x%x",
-                              entry.clusterId,
-                              entry.attributeId,
+                              report->clusterId,
+                              report->attributeId,
                               status);
       continue;
     }
 
-    // If we have already started a report for a different attribute or
-    // destination, send it and create a new one.
-    if (apsFrame != NULL &&
-        !(entry.endpoint == apsFrame->sourceEndpoint
-          && entry.clusterId == apsFrame->clusterId
-          && emberAfClusterIsClient(&entry) == clientToServer
-          && entry.manufacturerCode == manufacturerCode)) {
+    dataSize = (emberAfIsThisDataTypeAStringType(dataType)
+                ? emberAfStringLength(readData) + 1
+                : emberAfGetDataSize(dataType));
+
+    // If we have already started a report for a different cluster or
+    // destination, or this attribute will not fit in it, send it and create
+    // a new one.
+    if (apsFrame != NULL
+        && !(report->endpoint == apsFrame->sourceEndpoint
+             && report->clusterId == apsFrame->clusterId
+             && client == clientToServer
+             && report->manufacturerCode == manufacturerCode
+             && (appResponseLength + 3 + dataSize
+                 <= EMBER_AF_RESPONSE_BUFFER_LEN))) {
       conditionallySendReport(apsFrame->sourceEndpoint, apsFrame->clusterId);
       apsFrame = NULL;
     }
@@ -124,7 +508,7 @@ void emberAfPluginReportingTickEventHandler(void)
     // If we haven't made the message header, make it.
     if (apsFrame == NULL) {
       apsFrame = emberAfGetCommandApsFrame();
-      clientToServer = emberAfClusterIsClient(&entry);
+      clientToServer = client;
       // The manufacturer-specfic version of the fill API only creates a
       // manufacturer-specfic command if the manufacturer code is set.  For
       // non-manufacturer-specfic reports, the manufacturer code is unset, so
@@ -136,22 +520,19 @@ void emberAfPluginReportingTickEventHandler(void)
                                                      : (ZCL_PROFILE_WIDE_COMMAND
                                                         | ZCL_FRAME_CONTROL_SERVER_TO_CLIENT
                                                         | EMBER_AF_DEFAULT_RESPONSE_POLICY_REQUESTS)),
-                                                    entry.clusterId,
-                                                    entry.manufacturerCode,
+                                                    report->clusterId,
+                                                    report->manufacturerCode,
                                                     ZCL_REPORT_ATTRIBUTES_COMMAND_ID,
                                                     "");
-      apsFrame->sourceEndpoint = entry.endpoint;
+      apsFrame->sourceEndpoint = report->endpoint;
       apsFrame->options = EMBER_AF_DEFAULT_APS_OPTIONS;
-      manufacturerCode = entry.manufacturerCode;
+      manufacturerCode = report->manufacturerCode;
     }
 
     // Payload is [attribute id:2] [type:1] [data:N].
-    emberAfPutInt16uInResp(entry.attributeId);
+    emberAfPutInt16uInResp(report->attributeId);
     emberAfPutInt8uInResp(dataType);
 
-    dataSize = (emberAfIsThisDataTypeAStringType(dataType)
-                ? emberAfStringLength(readData) + 1
-                : emberAfGetDataSize(dataType));
 #if (BIGENDIAN_CPU)
     if (isThisDataTypeSentLittleEndianOTA(dataType)) {
       int8u i;
@@ -165,22 +546,11 @@ void emberAfPluginReportingTickEventHandler(void)
     emberAfPutBlockInResp(readData, dataSize);
 #endif
 
-    // Store the last reported time and value so that we can track intervals
-    // and changes.  We only track changes for data types that are small enough
-    // for us to compare.
-    volatileData[i].reportableChange = FALSE;
-    volatileData[i].lastReportTime = currentTime;
-    if (dataSize <= sizeof(volatileData[i].lastReportValue)) {
-      volatileData[i].lastReportValue = 0;
-#if (BIGENDIAN_CPU)
-      MEMCOPY(((int8u *)&volatileData[i].lastReportValue
-               + sizeof(volatileData[i].lastReportValue)
-               - dataSize),
-              readData,
-              dataSize);
-#else
-      MEMCOPY(&volatileData[i].lastReportValue, readData, dataSize);
-#endif
+    // Store the last reported value so that we can track changes.  We only
+    // track changes for data types that are small enough for us to compare.
+    if (!emberAfIsThisDataTypeAStringType(dataType)
+        && dataSize <= REPORT_VALUE_SIZE) {
+      MEMCOPY(data->lastReportValue, readData, dataSize);
     }
   }
 
@@ -377,8 +747,7 @@ boolean emberAfReadReportingConfigurationCommandCallback(const EmberAfClusterCom
     EmberAfAttributeMetadata *metadata;
     EmberAfPluginReportingEntry entry;
     EmberAfReportingDirection direction;
-    int8u i;
-    boolean found = FALSE;
+    boolean found;
 
     direction = emberAfGetInt8u(cmd->buffer, bufIndex, cmd->bufLen);
     bufIndex++;
@@ -411,21 +780,16 @@ boolean emberAfReadReportingConfigurationCommandCallback(const EmberAfClusterCom
     // 075123r03 seems to suggest that SUCCESS is returned even if reporting
     // isn't configured for the requested attribute.  The individual fields
     // of the response for this attribute get populated with defaults.
-    for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
-      emAfPluginReportingGetEntry(i, &entry);
-      if (entry.direction == direction
-          && entry.endpoint == cmd->apsFrame->destinationEndpoint
-          && entry.clusterId == cmd->apsFrame->clusterId
-          && entry.attributeId == attributeId
-          && entry.mask == mask
-          && entry.manufacturerCode == cmd->mfgCode
-          && (entry.direction == EMBER_ZCL_REPORTING_DIRECTION_REPORTED
-              || (entry.data.received.source == cmd->source
-                  && entry.data.received.endpoint == cmd->apsFrame->sourceEndpoint))) {
-        found = TRUE;
-        break;
-      }
-    }
+    found = (findEntry(direction,
+                       cmd->apsFrame->destinationEndpoint,
+                       cmd->apsFrame->clusterId,
+                       attributeId,
+                       mask,
+                       cmd->mfgCode,
+                       cmd->source,
+                       cmd->apsFrame->sourceEndpoint,
+                       &entry)
+             != NULL_INDEX);
     emberAfPutInt8uInResp(EMBER_ZCL_STATUS_SUCCESS);
     emberAfPutInt8uInResp(direction);
     emberAfPutInt16uInResp(attributeId);
@@ -451,7 +815,7 @@ boolean emberAfReadReportingConfigurationCommandCallback(const EmberAfClusterCom
 
 EmberStatus emberAfClearReportTableCallback(void)
 {
-  int8u i;
+  int16u i;
   for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
     removeConfiguration(i);
   }
@@ -459,7 +823,21 @@ EmberStatus emberAfClearReportTableCallback(void)
   return EMBER_SUCCESS;
 }
 
-EmberStatus emAfPluginReportingRemoveEntry(int8u index)
+EmberStatus emberAfClearEndpointReportTableCallback(int8u endpoint)
+{
+  int16u i;
+  for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
+    EmberAfPluginReportingEntry entry;
+    emAfPluginReportingGetEntry(i, &entry);
+    if (entry.endpoint == endpoint) {
+      removeConfiguration(i);
+    }
+  }
+  scheduleTick();
+  return EMBER_SUCCESS;
+}
+
+EmberStatus emAfPluginReportingRemoveEntry(int16u index)
 {
   EmberStatus status = EMBER_INDEX_OUT_OF_RANGE;
   if (index < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE) {
@@ -477,64 +855,68 @@ void emberAfReportingAttributeChangeCallback(int8u endpoint,
                                              EmberAfAttributeType type,
                                              int8u *data)
 {
-  int32u currentTime = halCommonGetInt32uMillisecondTick();
-  int8u i;
-  for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
-    EmberAfPluginReportingEntry entry;
-    emAfPluginReportingGetEntry(i, &entry);
-    if (entry.direction == EMBER_ZCL_REPORTING_DIRECTION_REPORTED
-        && entry.endpoint == endpoint
-        && entry.clusterId == clusterId
-        && entry.attributeId == attributeId
-        && entry.mask == mask
-        && entry.manufacturerCode == manufacturerCode) {
-      // If we are reporting this particular attribute, we only care whether
-      // the new value meets the reportable change criteria.  If it does, we
-      // mark the entry as ready to report and reschedule the tick.  Whether
-      // the tick will be scheduled for immediate or delayed execution depends
-      // on the minimum reporting interval.  This is handled in the scheduler.
-      int32u difference = emberAfGetDifference(data,
-                                               volatileData[i].lastReportValue,
-                                               emberAfGetDataSize(type));
-      int8u analogOrDiscrete = emberAfGetAttributeAnalogOrDiscreteType(type);
-      if ((analogOrDiscrete == EMBER_AF_DATA_TYPE_DISCRETE && difference != 0)
-          || (analogOrDiscrete == EMBER_AF_DATA_TYPE_ANALOG
-              && entry.data.reported.reportableChange <= difference)) {
-        volatileData[i].reportableChange = TRUE;
-        scheduleTick();
-      }
-      break;
-    }
+  EmberAfPluginReportingEntry entry;
+  EmAfPluginReportingVolatileData *volatileEntry;
+  int8u analogOrDiscrete;
+  int8u dataSize;
+  boolean change;
+  int16u index = findEntry(EMBER_ZCL_REPORTING_DIRECTION_REPORTED,
+                           endpoint,
+                           clusterId,
+                           attributeId,
+                           mask,
+                           manufacturerCode,
+                           EMBER_NULL_NODE_ID,
+                           0,
+                           &entry);
+
+  // If we are reporting this particular attribute, we only care whether the
+  // new value meets the reportable change criteria.  If it does, we mark the
+  // entry as ready to report and reschedule it.  Whether it will be reported
+  // immediately or later depends on the minimum reporting interval.  An entry
+  // that is already marked has already been rescheduled, so further changes
+  // before the report is sent cost nothing more.
+  if (index == NULL_INDEX) {
+    return;
+  }
+  volatileEntry = &volatileData[index];
+  if (volatileEntry->reportableChange) {
+    return;
+  }
+
+  analogOrDiscrete = emberAfGetAttributeAnalogOrDiscreteType(type);
+  dataSize = emberAfGetDataSize(type);
+  if (emberAfIsThisDataTypeAStringType(type)
+      || dataSize > REPORT_VALUE_SIZE) {
+    // We do not keep the last value, so any write is taken as a change.
+    change = TRUE;
+  } else {
+    int32u difference = getDifference(data,
+                                      volatileEntry->lastReportValue,
+                                      dataSize);
+    change = ((analogOrDiscrete == EMBER_AF_DATA_TYPE_DISCRETE
+               && difference != 0)
+              || (analogOrDiscrete == EMBER_AF_DATA_TYPE_ANALOG
+                  && entry.data.reported.reportableChange <= difference));
+  }
+
+  if (change) {
+    volatileEntry->reportableChange = TRUE;
+    scheduleReport(index,
+                   entry.data.reported.minInterval,
+                   entry.data.reported.maxInterval);
+    scheduleTick();
   }
 }
 
+// The next tick is when the report at the top of the heap is due.
 static void scheduleTick(void)
 {
-  int32u delay = MAX_INT32U_VALUE;
-  int32u currentTime = halCommonGetInt32uMillisecondTick();
-  int8u i;
-  for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
-    EmberAfPluginReportingEntry entry;
-    emAfPluginReportingGetEntry(i, &entry);
-    if (entry.endpoint != EMBER_AF_PLUGIN_REPORTING_UNUSED_ENDPOINT_ID
-        && entry.direction == EMBER_ZCL_REPORTING_DIRECTION_REPORTED) {
-      int32u minInterval = (entry.data.reported.minInterval
-                            * MILLISECOND_TICKS_PER_SECOND);
-      int32u elapsed = currentTime - volatileData[i].lastReportTime;
-      int32u remaining = MAX_INT32U_VALUE;
-      if (volatileData[i].reportableChange) {
-        remaining = (minInterval < elapsed ? 0 : minInterval - elapsed);
-      } else if (entry.data.reported.maxInterval != 0x0000) {
-        remaining = (entry.data.reported.maxInterval
-                     * MILLISECOND_TICKS_PER_SECOND
-                     - elapsed);
-      }
-      if (remaining < delay) {
-        delay = remaining;
-      }
-    }
-  }
-  if (delay != MAX_INT32U_VALUE) {
+  if (heapCount > 0) {
+    int32u currentTime = halCommonGetInt32uMillisecondTick();
+    int32u delay = (isEarlier(currentTime, heap[0].deadline)
+                    ? heap[0].deadline - currentTime
+                    : 0);
     emberAfDebugPrintln("sched report event for: 0x%4x", delay);
     emberAfEventControlSetDelay(&emberAfPluginReportingTickEventControl, delay);
   } else {
@@ -543,7 +925,7 @@ static void scheduleTick(void)
   }
 }
 
-static void removeConfiguration(int8u index)
+static void removeConfiguration(int16u index)
 {
   EmberAfPluginReportingEntry entry;
   emAfPluginReportingGetEntry(index, &entry);
@@ -552,7 +934,7 @@ static void removeConfiguration(int8u index)
   emberAfPluginReportingConfiguredCallback(&entry);
 }
 
-static void removeConfigurationAndScheduleTick(int8u index)
+static void removeConfigurationAndScheduleTick(int16u index)
 {
   removeConfiguration(index);
   scheduleTick();
@@ -569,9 +951,8 @@ EmberAfStatus emAfPluginReportingConfigureReportedAttribute(const EmberAfCluster
   EmberAfAttributeMetadata *metadata;
   EmberAfPluginReportingEntry entry;
   EmberAfStatus status;
-  int8u i, index = NULL_INDEX;
-  boolean initialize = TRUE;
-
+  int16u index;
+  boolean initialize = FALSE;
 
   // Verify that we support the attribute and that the data type matches.
   metadata = emberAfLocateAttributeMetadata(cmd->apsFrame->destinationEndpoint,
@@ -590,40 +971,38 @@ EmberAfStatus emAfPluginReportingConfigureReportedAttribute(const EmberAfCluster
     return EMBER_ZCL_STATUS_INVALID_VALUE;
   }
 
-  // Check the table for an entry that matches this request and also watch for
-  // empty slots along the way.  If a report exists, it will be overwritten
-  // with the new configuration.  Otherwise, a new entry will be created and
-  // initialized.
-  for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
-    emAfPluginReportingGetEntry(i, &entry);
-    if (entry.direction == EMBER_ZCL_REPORTING_DIRECTION_REPORTED
-        && entry.endpoint == cmd->apsFrame->destinationEndpoint
-        && entry.clusterId == cmd->apsFrame->clusterId
-        && entry.attributeId == attributeId
-        && entry.mask == mask
-        && entry.manufacturerCode == cmd->mfgCode) {
-      initialize = FALSE;
-      index = i;
-      break;
-    } else if (entry.endpoint == EMBER_AF_PLUGIN_REPORTING_UNUSED_ENDPOINT_ID
-               && index == NULL_INDEX) {
-      index = i;
-    }
-  }
+  // Look for an entry that matches this request.  If a report exists, it will
+  // be overwritten with the new configuration.  Otherwise, a new entry will be
+  // created in an unused slot and initialized.
+  index = findEntry(EMBER_ZCL_REPORTING_DIRECTION_REPORTED,
+                    cmd->apsFrame->destinationEndpoint,
+                    cmd->apsFrame->clusterId,
+                    attributeId,
+                    mask,
+                    cmd->mfgCode,
+                    EMBER_NULL_NODE_ID,
+                    0,
+                    &entry);
 
   // If the maximum reporting interval is 0xFFFF, the device shall not issue
   // reports for the attribute and the configuration information for that
   // attribute need not be maintained.
   if (maxInterval == 0xFFFF) {
-    if (!initialize) {
+    if (index != NULL_INDEX) {
       removeConfigurationAndScheduleTick(index);
     }
     return EMBER_ZCL_STATUS_SUCCESS;
   }
 
   if (index == NULL_INDEX) {
-    return EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
-  } else if (initialize) {
+    if (unusedEntries == 0) {
+      return EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
+    }
+    index = unusedEntries - 1;
+    initialize = TRUE;
+  }
+
+  if (initialize) {
     entry.direction = EMBER_ZCL_REPORTING_DIRECTION_REPORTED;
     entry.endpoint = cmd->apsFrame->destinationEndpoint;
     entry.clusterId = cmd->apsFrame->clusterId;
@@ -631,7 +1010,8 @@ EmberAfStatus emAfPluginReportingConfigureReportedAttribute(const EmberAfCluster
     entry.mask = mask;
     entry.manufacturerCode = cmd->mfgCode;
     volatileData[index].lastReportTime = halCommonGetInt32uMillisecondTick();
-    volatileData[index].lastReportValue = 0;
+    volatileData[index].reportableChange = FALSE;
+    MEMSET(volatileData[index].lastReportValue, 0, REPORT_VALUE_SIZE);
   }
 
   // For new or updated entries, set the intervals and reportable change.
@@ -661,35 +1041,30 @@ static EmberAfStatus configureReceivedAttribute(const EmberAfClusterCommand *cmd
 {
   EmberAfPluginReportingEntry entry;
   EmberAfStatus status;
-  int8u i, index = NULL_INDEX;
-  boolean initialize = TRUE;
-
-  // Check the table for an entry that matches this request and also watch for
-  // empty slots along the way.  If a report exists, it will be overwritten
-  // with the new configuration.  Otherwise, a new entry will be created and
-  // initialized.
-  for (i = 0; i < EMBER_AF_PLUGIN_REPORTING_TABLE_SIZE; i++) {
-    emAfPluginReportingGetEntry(i, &entry);
-    if (entry.direction == EMBER_ZCL_REPORTING_DIRECTION_RECEIVED
-        && entry.endpoint == cmd->apsFrame->destinationEndpoint
-        && entry.clusterId == cmd->apsFrame->clusterId
-        && entry.attributeId == attributeId
-        && entry.mask == mask
-        && entry.manufacturerCode == cmd->mfgCode
-        && entry.data.received.source == cmd->source
-        && entry.data.received.endpoint == cmd->apsFrame->sourceEndpoint) {
-      initialize = FALSE;
-      index = i;
-      break;
-    } else if (entry.endpoint == EMBER_AF_PLUGIN_REPORTING_UNUSED_ENDPOINT_ID
-               && index == NULL_INDEX) {
-      index = i;
+  int16u index;
+  boolean initialize = FALSE;
+
+  // Look for an entry that matches this request.  If a report exists, it will
+  // be overwritten with the new configuration.  Otherwise, a new entry will be
+  // created in an unused slot and initialized.
+  index = findEntry(EMBER_ZCL_REPORTING_DIRECTION_RECEIVED,
+                    cmd->apsFrame->destinationEndpoint,
+                    cmd->apsFrame->clusterId,
+                    attributeId,
+                    mask,
+                    cmd->mfgCode,
+                    cmd->source,
+                    cmd->apsFrame->sourceEndpoint,
+                    &entry);
+  if (index == NULL_INDEX) {
+    if (unusedEntries == 0) {
+      return EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
     }
+    index = unusedEntries - 1;
+    initialize = TRUE;
   }
 
-  if (index == NULL_INDEX) {
-    return EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
-  } else if (initialize) {
+  if (initialize) {
     entry.direction = EMBER_ZCL_REPORTING_DIRECTION_RECEIVED;
     entry.endpoint = cmd->apsFrame->destinationEndpoint;
     entry.clusterId = cmd->apsFrame->clusterId;
@@ -13,11 +13,91 @@
   #include "../zll-scenes-server/zll-scenes-server.h"
 #endif
 
+#if defined(EZSP_HOST)
+  #include <stdlib.h>   // realloc
+
+// A bridge on the host may have hundreds of endpoints, each with many scenes,
+// so the host's table starts with EMBER_AF_PLUGIN_SCENES_TABLE_SIZE entries
+// and doubles in size whenever it fills.  The entries in use are chained into
+// two hash tables, each with as many buckets as the table has entries: one by
+// endpoint, group and scene, for the commands that name a scene, and one by
+// endpoint and group, for those that act on every scene in a group.  They are
+// also chained by endpoint, for clearing the scenes of an endpoint.  The
+// unused entries are chained into a free list.
+#define MAX_TABLE_SIZE (EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX - 1)
+
+typedef struct {
+  int16u sceneNext;     // in the same scene bucket, or on the free list
+  int16u groupNext;     // in the same group bucket
+  int16u endpointNext;  // on the same endpoint
+  int16u endpointPrev;
+} SceneLinks;
+
+int16u emberAfPluginScenesServerEntriesInUse = 0;
+EmberAfSceneTableEntry *emberAfPluginScenesServerSceneTable = NULL;
+static SceneLinks *sceneLinks = NULL;
+static int16u *sceneHeads = NULL;
+static int16u *groupHeads = NULL;
+static int16u endpointHeads[256];
+static int16u tableSize = 0;
+static int16u unusedHead = EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+
+#define sceneTableSize() tableSize
+
+static int16u removeEndpointScenes(int8u endpoint);
+#else
 int8u emberAfPluginScenesServerEntriesInUse = 0;
-#if !defined(EMBER_AF_PLUGIN_SCENES_USE_TOKENS) || defined(EZSP_HOST)
+#if !defined(EMBER_AF_PLUGIN_SCENES_USE_TOKENS)
   EmberAfSceneTableEntry emberAfPluginScenesServerSceneTable[EMBER_AF_PLUGIN_SCENES_TABLE_SIZE];
 #endif
 
+#define sceneTableSize() EMBER_AF_PLUGIN_SCENES_TABLE_SIZE
+#endif //EZSP_HOST
+
+// The attributes stored in the extension fields of a scene.
+enum {
+#ifdef ZCL_USING_ON_OFF_CLUSTER_SERVER
+  ON_OFF_EXTENSION,
+#endif
+#ifdef ZCL_USING_LEVEL_CONTROL_CLUSTER_SERVER
+  CURRENT_LEVEL_EXTENSION,
+#endif
+#ifdef ZCL_USING_THERMOSTAT_CLUSTER_SERVER
+  OCCUPIED_COOLING_SETPOINT_EXTENSION,
+  OCCUPIED_HEATING_SETPOINT_EXTENSION,
+  SYSTEM_MODE_EXTENSION,
+#endif
+#ifdef ZCL_USING_COLOR_CONTROL_CLUSTER_SERVER
+  CURRENT_X_EXTENSION,
+  CURRENT_Y_EXTENSION,
+  ENHANCED_CURRENT_HUE_EXTENSION,
+  CURRENT_SATURATION_EXTENSION,
+  COLOR_LOOP_ACTIVE_EXTENSION,
+  COLOR_LOOP_DIRECTION_EXTENSION,
+  COLOR_LOOP_TIME_EXTENSION,
+#endif
+#ifdef ZCL_USING_DOOR_LOCK_CLUSTER_SERVER
+  LOCK_STATE_EXTENSION,
+#endif
+#ifdef ZCL_USING_WINDOW_COVERING_CLUSTER_SERVER
+  LIFT_PERCENTAGE_EXTENSION,
+  TILT_PERCENTAGE_EXTENSION,
+#endif
+  EXTENSION_COUNT
+};
+
+#if defined(EZSP_HOST)
+// Storing or recalling a scene reads or writes every extension attribute on
+// the endpoint, so the host looks each one up once and keeps its location
+// until the endpoints change.
+static struct {
+  EmAfAttributeLocation location;
+  boolean isLocated;
+  int16u version;   // of the attribute locations when this was found
+} extensionLocations[256][EXTENSION_COUNT];
+#endif
+
+#if !defined(EZSP_HOST)
 static boolean readServerAttribute(int8u endpoint,
                                    EmberAfClusterId clusterId,
                                    EmberAfAttributeId attributeId,
@@ -40,6 +120,7 @@ static boolean readServerAttribute(int8u endpoint,
   }
   return success;
 }
+#endif
 
 static EmberAfStatus writeServerAttribute(int8u endpoint,
                                           EmberAfClusterId clusterId,
@@ -59,6 +140,94 @@ static EmberAfStatus writeServerAttribute(int8u endpoint,
   return status;
 }
 
+
+#if defined(EZSP_HOST)
+static const EmAfAttributeLocation *locateExtension(EmberAfAttributeSearchRecord *record,
+                                                    int8u endpoint,
+                                                    int8u extension,
+                                                    EmberAfClusterId clusterId,
+                                                    EmberAfAttributeId attributeId)
+{
+  int16u version = emAfAttributeLocationVersion();
+  record->endpoint = endpoint;
+  record->clusterId = clusterId;
+  record->clusterMask = CLUSTER_MASK_SERVER;
+  record->attributeId = attributeId;
+  record->manufacturerCode = EMBER_AF_NULL_MANUFACTURER_CODE;
+  if (!extensionLocations[endpoint][extension].isLocated
+      || extensionLocations[endpoint][extension].version != version) {
+    emAfLocateAttribute(record,
+                        &extensionLocations[endpoint][extension].location);
+    extensionLocations[endpoint][extension].isLocated = TRUE;
+    extensionLocations[endpoint][extension].version = version;
+  }
+  return &extensionLocations[endpoint][extension].location;
+}
+#endif //EZSP_HOST
+
+static boolean readExtension(int8u endpoint,
+                             int8u extension,
+                             EmberAfClusterId clusterId,
+                             EmberAfAttributeId attributeId,
+                             PGM_P name,
+                             int8u *data,
+                             int8u size)
+{
+#if defined(EZSP_HOST)
+  EmberAfAttributeSearchRecord record;
+  const EmAfAttributeLocation *location = locateExtension(&record,
+                                                          endpoint,
+                                                          extension,
+                                                          clusterId,
+                                                          attributeId);
+  EmberAfStatus status;
+  if (location->metadata == NULL) {
+    return FALSE;
+  }
+  status = emAfReadOrWriteLocatedAttribute(&record,
+                                           location,
+                                           data,
+                                           size,
+                                           FALSE); // write?
+  if (status != EMBER_ZCL_STATUS_SUCCESS) {
+    emberAfScenesClusterPrintln("ERR: %ping %p 0x%x", "read", name, status);
+    return FALSE;
+  }
+  return TRUE;
+#else
+  return readServerAttribute(endpoint, clusterId, attributeId, name, data, size);
+#endif
+}
+
+static void writeExtension(int8u endpoint,
+                           int8u extension,
+                           EmberAfClusterId clusterId,
+                           EmberAfAttributeId attributeId,
+                           PGM_P name,
+                           int8u *data,
+                           EmberAfAttributeType type)
+{
+#if defined(EZSP_HOST)
+  EmberAfAttributeSearchRecord record;
+  const EmAfAttributeLocation *location = locateExtension(&record,
+                                                          endpoint,
+                                                          extension,
+                                                          clusterId,
+                                                          attributeId);
+  EmberAfStatus status = emAfWriteLocatedAttribute(&record,
+                                                   location,
+                                                   data,
+                                                   type,
+                                                   TRUE,   // override read-only?
+                                                   FALSE); // just test?
+  if (status != EMBER_ZCL_STATUS_SUCCESS) {
+    emberAfScenesClusterPrintln("ERR: %ping %p 0x%x", "writ", name, status);
+  }
+#else
+  writeServerAttribute(endpoint, clusterId, attributeId, name, data, type);
+#endif
+}
+
 void emberAfScenesClusterServerInitCallback(int8u endpoint)
 {
 #ifdef EMBER_AF_PLUGIN_SCENES_NAME_SUPPORT
@@ -73,7 +242,15 @@ void emberAfScenesClusterServerInitCallback(int8u endpoint)
                          ZCL_BITMAP8_ATTRIBUTE_TYPE);
   }
 #endif
-#if !defined(EMBER_AF_PLUGIN_SCENES_USE_TOKENS) || defined(EZSP_HOST)
+#if defined(EZSP_HOST)
+  {
+    // Endpoints may be added while the host is running, so only the scenes of
+    // this endpoint are forgotten.
+    int16u removed = removeEndpointScenes(endpoint);
+    emberAfPluginScenesServerSetNumSceneEntriesInUse(emberAfPluginScenesServerNumSceneEntriesInUse()
+                                                     - removed);
+  }
+#elif !defined(EMBER_AF_PLUGIN_SCENES_USE_TOKENS)
   {
     int8u i;
     for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
@@ -90,13 +267,15 @@ void emberAfScenesClusterServerInitCallback(int8u endpoint)
 }
 
 EmberAfStatus emberAfScenesSetSceneCountAttribute(int8u endpoint,
-                                                  int8u newCount)
+                                                  int16u newCount)
 {
+  // The host's table may hold more scenes than the attribute can count.
+  int8u sceneCount = (newCount < 0xFF ? (int8u)newCount : 0xFF);
   return writeServerAttribute(endpoint,
                               ZCL_SCENES_CLUSTER_ID,
                               ZCL_SCENE_COUNT_ATTRIBUTE_ID,
                               "scene count",
-                              (int8u *)&newCount,
+                              (int8u *)&sceneCount,
                               ZCL_INT8U_ATTRIBUTE_TYPE);
 }
 
@@ -151,14 +330,14 @@ EmberAfStatus emberAfScenesClusterMakeInvalidCallback(int8u endpoint)
 
 void emAfPluginScenesServerPrintInfo(void)
 {
-  int8u i;
+  EmberAfPluginScenesServerIndex i;
   EmberAfSceneTableEntry entry;
-  emberAfCorePrintln("using 0x%x out of 0x%x table slots",
+  emberAfCorePrintln("using 0x%2x out of 0x%2x table slots",
                      emberAfPluginScenesServerNumSceneEntriesInUse(),
-                     EMBER_AF_PLUGIN_SCENES_TABLE_SIZE);
-  for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+                     sceneTableSize());
+  for (i = 0; i < sceneTableSize(); i++) {
     emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-    emberAfCorePrint("%x: ", i);
+    emberAfCorePrint("%2x: ", i);
     if (entry.endpoint != EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID) {
       emberAfCorePrint("ep %x grp %2x scene %x tt %d",
                        entry.endpoint,
@@ -245,21 +424,19 @@ boolean emberAfScenesClusterRemoveSceneCallback(int16u groupId, int8u sceneId)
                                                       groupId)) {
     status = EMBER_ZCL_STATUS_INVALID_FIELD;
   } else {
-    int8u i;
-    for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+    EmberAfPluginScenesServerIndex i
+      = emberAfPluginScenesServerFindScene(emberAfCurrentEndpoint(),
+                                           groupId,
+                                           sceneId);
+    if (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
       EmberAfSceneTableEntry entry;
       emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-      if (entry.endpoint == emberAfCurrentEndpoint()
-          && entry.groupId == groupId
-          && entry.sceneId == sceneId) {
-        entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
-        emberAfPluginScenesServerSaveSceneEntry(entry, i);
-        emberAfPluginScenesServerDecrNumSceneEntriesInUse();
-        emberAfScenesSetSceneCountAttribute(emberAfCurrentEndpoint(),
-                                            emberAfPluginScenesServerNumSceneEntriesInUse());
-        status = EMBER_ZCL_STATUS_SUCCESS;
-        break;
-      }
+      entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
+      emberAfPluginScenesServerSaveSceneEntry(entry, i);
+      emberAfPluginScenesServerDecrNumSceneEntriesInUse();
+      emberAfScenesSetSceneCountAttribute(emberAfCurrentEndpoint(),
+                                          emberAfPluginScenesServerNumSceneEntriesInUse());
+      status = EMBER_ZCL_STATUS_SUCCESS;
     }
   }
 
@@ -284,17 +461,19 @@ boolean emberAfScenesClusterRemoveAllScenesCallback(int16u groupId)
   if (groupId == ZCL_SCENES_GLOBAL_SCENE_GROUP_ID
       || emberAfGroupsClusterEndpointInGroupCallback(emberAfCurrentEndpoint(),
                                                      groupId)) {
-    int8u i;
+    EmberAfPluginScenesServerIndex i
+      = emberAfPluginScenesServerFirstSceneInGroup(emberAfCurrentEndpoint(),
+                                                   groupId);
     status = EMBER_ZCL_STATUS_SUCCESS;
-    for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+    while (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
       EmberAfSceneTableEntry entry;
       emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-      if (entry.endpoint == emberAfCurrentEndpoint()
-          && entry.groupId == groupId) {
-        entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
-        emberAfPluginScenesServerSaveSceneEntry(entry, i);
-        emberAfPluginScenesServerDecrNumSceneEntriesInUse();
-      }
+      entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
+      emberAfPluginScenesServerSaveSceneEntry(entry, i);
+      emberAfPluginScenesServerDecrNumSceneEntriesInUse();
+      i = emberAfPluginScenesServerNextSceneInGroup(emberAfCurrentEndpoint(),
+                                                    groupId,
+                                                    i);
     }
     emberAfScenesSetSceneCountAttribute(emberAfCurrentEndpoint(),
                                         emberAfPluginScenesServerNumSceneEntriesInUse());
@@ -344,6 +523,19 @@ boolean emberAfScenesClusterRecallSceneCallback(int16u groupId, int8u sceneId)
   return TRUE;
 }
 
+// The capacity reported in Get Scene Membership responses, where 0xFE means
+// at least that many more scenes can be added.
+static int8u sceneCapacity(void)
+{
+#if defined(EZSP_HOST)
+  int16u capacity = MAX_TABLE_SIZE - emberAfPluginScenesServerNumSceneEntriesInUse();
+  return (capacity < 0xFE ? (int8u)capacity : 0xFE);
+#else
+  return (EMBER_AF_PLUGIN_SCENES_TABLE_SIZE
+          - emberAfPluginScenesServerNumSceneEntriesInUse());
+#endif
+}
+
 boolean emberAfScenesClusterGetSceneMembershipCallback(int16u groupId)
 {
   EmberAfStatus status = EMBER_ZCL_STATUS_SUCCESS;
@@ -376,24 +568,26 @@ boolean emberAfScenesClusterGetSceneMembershipCallback(int16u groupId)
                             ZCL_GET_SCENE_MEMBERSHIP_RESPONSE_COMMAND_ID,
                             "uuv",
                             status,
-                            (EMBER_AF_PLUGIN_SCENES_TABLE_SIZE
-                             - emberAfPluginScenesServerNumSceneEntriesInUse()), // capacity
+                            sceneCapacity(),
                             groupId);
   if (status == EMBER_ZCL_STATUS_SUCCESS) {
-    int8u i, sceneList[EMBER_AF_PLUGIN_SCENES_TABLE_SIZE];
-    for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+    // The scene count goes before the scene list, so it is filled in once the
+    // scenes have been counted.
+    int8u *count = &appResponseData[appResponseLength];
+    EmberAfPluginScenesServerIndex i
+      = emberAfPluginScenesServerFirstSceneInGroup(emberAfCurrentEndpoint(),
+                                                   groupId);
+    emberAfPutInt8uInResp(0); // temporary scene count
+    while (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
       EmberAfSceneTableEntry entry;
       emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-      if (entry.endpoint == emberAfCurrentEndpoint()
-          && entry.groupId == groupId) {
-        sceneList[sceneCount] = entry.sceneId;
-        sceneCount++;
-      }
-    }
-    emberAfPutInt8uInResp(sceneCount);
-    for (i = 0; i < sceneCount; i++) {
-      emberAfPutInt8uInResp(sceneList[i]);
+      emberAfPutInt8uInResp(entry.sceneId);
+      sceneCount++;
+      i = emberAfPluginScenesServerNextSceneInGroup(emberAfCurrentEndpoint(),
+                                                    groupId,
+                                                    i);
     }
+    *count = sceneCount;
   }
 
   // Get Scene Membership commands are only responded to when they are
@@ -411,7 +605,8 @@ EmberAfStatus emberAfScenesClusterStoreCurrentSceneCallback(int8u endpoint,
                                                             int8u sceneId)
 {
   EmberAfSceneTableEntry entry;
-  int8u i, index = EMBER_AF_SCENE_TABLE_NULL_INDEX;
+  EmberAfPluginScenesServerIndex index;
+  boolean newEntry = FALSE;
 
   // If a group id is specified but this endpoint isn't in it, take no action.
   if (groupId != ZCL_SCENES_GLOBAL_SCENE_GROUP_ID
@@ -419,21 +614,14 @@ EmberAfStatus emberAfScenesClusterStoreCurrentSceneCallback(int8u endpoint,
     return EMBER_ZCL_STATUS_INVALID_FIELD;
   }
 
-  for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
-    emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-    if (entry.endpoint == endpoint
-        && entry.groupId == groupId
-        && entry.sceneId == sceneId) {
-      index = i;
-      break;
-    } else if (index == EMBER_AF_SCENE_TABLE_NULL_INDEX
-               && entry.endpoint == EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID) {
-      index = i;
-    }
+  index = emberAfPluginScenesServerFindScene(endpoint, groupId, sceneId);
+  if (index == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    index = emberAfPluginScenesServerFindUnusedEntry();
+    newEntry = TRUE;
   }
 
-  // If the target index is still zero, the table is full.
-  if (index == EMBER_AF_SCENE_TABLE_NULL_INDEX) {
+  // If there is still no target index, the table is full.
+  if (index == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
     return EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
   }
 
@@ -442,116 +630,131 @@ EmberAfStatus emberAfScenesClusterStoreCurrentSceneCallback(int8u endpoint,
   // When creating a new entry or refreshing an existing one, the extension
   // fields are updated with the current state of other clusters on the device.
 #ifdef ZCL_USING_ON_OFF_CLUSTER_SERVER
-  entry.hasOnOffValue = readServerAttribute(endpoint,
-                                            ZCL_ON_OFF_CLUSTER_ID,
-                                            ZCL_ON_OFF_ATTRIBUTE_ID,
-                                            "on/off",
-                                            (int8u *)&entry.onOffValue,
-                                            sizeof(entry.onOffValue));
+  entry.hasOnOffValue = readExtension(endpoint,
+                                      ON_OFF_EXTENSION,
+                                      ZCL_ON_OFF_CLUSTER_ID,
+                                      ZCL_ON_OFF_ATTRIBUTE_ID,
+                                      "on/off",
+                                      (int8u *)&entry.onOffValue,
+                                      sizeof(entry.onOffValue));
 #endif
 #ifdef ZCL_USING_LEVEL_CONTROL_CLUSTER_SERVER
-  entry.hasCurrentLevelValue = readServerAttribute(endpoint,
-                                                   ZCL_LEVEL_CONTROL_CLUSTER_ID,
-                                                   ZCL_CURRENT_LEVEL_ATTRIBUTE_ID,
-                                                   "current level",
-                                                   (int8u *)&entry.currentLevelValue,
-                                                   sizeof(entry.currentLevelValue));
+  entry.hasCurrentLevelValue = readExtension(endpoint,
+                                             CURRENT_LEVEL_EXTENSION,
+                                             ZCL_LEVEL_CONTROL_CLUSTER_ID,
+                                             ZCL_CURRENT_LEVEL_ATTRIBUTE_ID,
+                                             "current level",
+                                             (int8u *)&entry.currentLevelValue,
+                                             sizeof(entry.currentLevelValue));
 #endif
 #ifdef ZCL_USING_THERMOSTAT_CLUSTER_SERVER
-  entry.hasOccupiedCoolingSetpointValue = readServerAttribute(endpoint,
-                                                              ZCL_THERMOSTAT_CLUSTER_ID,
-                                                              ZCL_OCCUPIED_COOLING_SETPOINT_ATTRIBUTE_ID,
-                                                              "occupied cooling setpoint",
-                                                              (int8u *)&entry.occupiedCoolingSetpointValue,
-                                                              sizeof(entry.occupiedCoolingSetpointValue));
-  entry.hasOccupiedHeatingSetpointValue = readServerAttribute(endpoint,
-                                                              ZCL_THERMOSTAT_CLUSTER_ID,
-                                                              ZCL_OCCUPIED_HEATING_SETPOINT_ATTRIBUTE_ID,
-                                                              "occupied heating setpoint",
-                                                              (int8u *)&entry.occupiedHeatingSetpointValue,
-                                                              sizeof(entry.occupiedHeatingSetpointValue));
-  entry.hasSystemModeValue = readServerAttribute(endpoint,
-                                                 ZCL_THERMOSTAT_CLUSTER_ID,
-                                                 ZCL_SYSTEM_MODE_ATTRIBUTE_ID,
-                                                 "system mode",
-                                                 (int8u *)&entry.systemModeValue,
-                                                 sizeof(entry.systemModeValue));
+  entry.hasOccupiedCoolingSetpointValue = readExtension(endpoint,
+                                                        OCCUPIED_COOLING_SETPOINT_EXTENSION,
+                                                        ZCL_THERMOSTAT_CLUSTER_ID,
+                                                        ZCL_OCCUPIED_COOLING_SETPOINT_ATTRIBUTE_ID,
+                                                        "occupied cooling setpoint",
+                                                        (int8u *)&entry.occupiedCoolingSetpointValue,
+                                                        sizeof(entry.occupiedCoolingSetpointValue));
+  entry.hasOccupiedHeatingSetpointValue = readExtension(endpoint,
+                                                        OCCUPIED_HEATING_SETPOINT_EXTENSION,
+                                                        ZCL_THERMOSTAT_CLUSTER_ID,
+                                                        ZCL_OCCUPIED_HEATING_SETPOINT_ATTRIBUTE_ID,
+                                                        "occupied heating setpoint",
+                                                        (int8u *)&entry.occupiedHeatingSetpointValue,
+                                                        sizeof(entry.occupiedHeatingSetpointValue));
+  entry.hasSystemModeValue = readExtension(endpoint,
+                                           SYSTEM_MODE_EXTENSION,
+                                           ZCL_THERMOSTAT_CLUSTER_ID,
+                                           ZCL_SYSTEM_MODE_ATTRIBUTE_ID,
+                                           "system mode",
+                                           (int8u *)&entry.systemModeValue,
+                                           sizeof(entry.systemModeValue));
 #endif
 #ifdef ZCL_USING_COLOR_CONTROL_CLUSTER_SERVER
-  entry.hasCurrentXValue = readServerAttribute(endpoint,
-                                               ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                               ZCL_COLOR_CONTROL_CURRENT_X_ATTRIBUTE_ID,
-                                               "current x",
-                                               (int8u *)&entry.currentXValue,
-                                               sizeof(entry.currentXValue));
-  entry.hasCurrentYValue = readServerAttribute(endpoint,
-                                               ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                               ZCL_COLOR_CONTROL_CURRENT_Y_ATTRIBUTE_ID,
-                                               "current y",
-                                               (int8u *)&entry.currentYValue,
-                                               sizeof(entry.currentYValue));
+  entry.hasCurrentXValue = readExtension(endpoint,
+                                         CURRENT_X_EXTENSION,
+                                         ZCL_COLOR_CONTROL_CLUSTER_ID,
+                                         ZCL_COLOR_CONTROL_CURRENT_X_ATTRIBUTE_ID,
+                                         "current x",
+                                         (int8u *)&entry.currentXValue,
+                                         sizeof(entry.currentXValue));
+  entry.hasCurrentYValue = readExtension(endpoint,
+                                         CURRENT_Y_EXTENSION,
+                                         ZCL_COLOR_CONTROL_CLUSTER_ID,
+                                         ZCL_COLOR_CONTROL_CURRENT_Y_ATTRIBUTE_ID,
+                                         "current y",
+                                         (int8u *)&entry.currentYValue,
+                                         sizeof(entry.currentYValue));
   if (emberIsZllNetwork()) {
-    entry.hasEnhancedCurrentHueValue = readServerAttribute(endpoint,
-                                                           ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                                           ZCL_COLOR_CONTROL_ENHANCED_CURRENT_HUE_ATTRIBUTE_ID,
-                                                           "enhanced current hue",
-                                                           (int8u *)&entry.enhancedCurrentHueValue,
-                                                           sizeof(entry.enhancedCurrentHueValue));
-    entry.hasCurrentSaturationValue = readServerAttribute(endpoint,
-                                                          ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                                          ZCL_COLOR_CONTROL_CURRENT_SATURATION_ATTRIBUTE_ID,
-                                                          "current saturation",
-                                                          (int8u *)&entry.currentSaturationValue,
-                                                          sizeof(entry.currentSaturationValue));
-    entry.hasColorLoopActiveValue = readServerAttribute(endpoint,
-                                                        ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                                        ZCL_COLOR_CONTROL_COLOR_LOOP_ACTIVE_ATTRIBUTE_ID,
-                                                        "color loop active",
-                                                        (int8u *)&entry.colorLoopActiveValue,
-                                                        sizeof(entry.colorLoopActiveValue));
-    entry.hasColorLoopDirectionValue = readServerAttribute(endpoint,
-                                                           ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                                           ZCL_COLOR_CONTROL_COLOR_LOOP_DIRECTION_ATTRIBUTE_ID,
-                                                           "color loop direction",
-                                                           (int8u *)&entry.colorLoopDirectionValue,
-                                                           sizeof(entry.colorLoopDirectionValue));
-    entry.hasColorLoopTimeValue = readServerAttribute(endpoint,
-                                                      ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                                      ZCL_COLOR_CONTROL_COLOR_LOOP_TIME_ATTRIBUTE_ID,
-                                                      "color loop time",
-                                                      (int8u *)&entry.colorLoopTimeValue,
-                                                      sizeof(entry.colorLoopTimeValue));
+    entry.hasEnhancedCurrentHueValue = readExtension(endpoint,
+                                                     ENHANCED_CURRENT_HUE_EXTENSION,
+                                                     ZCL_COLOR_CONTROL_CLUSTER_ID,
+                                                     ZCL_COLOR_CONTROL_ENHANCED_CURRENT_HUE_ATTRIBUTE_ID,
+                                                     "enhanced current hue",
+                                                     (int8u *)&entry.enhancedCurrentHueValue,
+                                                     sizeof(entry.enhancedCurrentHueValue));
+    entry.hasCurrentSaturationValue = readExtension(endpoint,
+                                                    CURRENT_SATURATION_EXTENSION,
+                                                    ZCL_COLOR_CONTROL_CLUSTER_ID,
+                                                    ZCL_COLOR_CONTROL_CURRENT_SATURATION_ATTRIBUTE_ID,
+                                                    "current saturation",
+                                                    (int8u *)&entry.currentSaturationValue,
+                                                    sizeof(entry.currentSaturationValue));
+    entry.hasColorLoopActiveValue = readExtension(endpoint,
+                                                  COLOR_LOOP_ACTIVE_EXTENSION,
+                                                  ZCL_COLOR_CONTROL_CLUSTER_ID,
+                                                  ZCL_COLOR_CONTROL_COLOR_LOOP_ACTIVE_ATTRIBUTE_ID,
+                                                  "color loop active",
+                                                  (int8u *)&entry.colorLoopActiveValue,
+                                                  sizeof(entry.colorLoopActiveValue));
+    entry.hasColorLoopDirectionValue = readExtension(endpoint,
+                                                     COLOR_LOOP_DIRECTION_EXTENSION,
+                                                     ZCL_COLOR_CONTROL_CLUSTER_ID,
+                                                     ZCL_COLOR_CONTROL_COLOR_LOOP_DIRECTION_ATTRIBUTE_ID,
+                                                     "color loop direction",
+                                                     (int8u *)&entry.colorLoopDirectionValue,
+                                                     sizeof(entry.colorLoopDirectionValue));
+    entry.hasColorLoopTimeValue = readExtension(endpoint,
+                                                COLOR_LOOP_TIME_EXTENSION,
+                                                ZCL_COLOR_CONTROL_CLUSTER_ID,
+                                                ZCL_COLOR_CONTROL_COLOR_LOOP_TIME_ATTRIBUTE_ID,
+                                                "color loop time",
+                                                (int8u *)&entry.colorLoopTimeValue,
+                                                sizeof(entry.colorLoopTimeValue));
 
   }
 #endif //ZCL_USING_COLOR_CONTROL_CLUSTER_SERVER
 #ifdef ZCL_USING_DOOR_LOCK_CLUSTER_SERVER
-  entry.hasLockStateValue = readServerAttribute(endpoint,
-                                                ZCL_DOOR_LOCK_CLUSTER_ID,
-                                                ZCL_LOCK_STATE_ATTRIBUTE_ID,
-                                                "lock state",
-                                                (int8u *)&entry.lockStateValue,
-                                                sizeof(entry.lockStateValue));
+  entry.hasLockStateValue = readExtension(endpoint,
+                                          LOCK_STATE_EXTENSION,
+                                          ZCL_DOOR_LOCK_CLUSTER_ID,
+                                          ZCL_LOCK_STATE_ATTRIBUTE_ID,
+                                          "lock state",
+                                          (int8u *)&entry.lockStateValue,
+                                          sizeof(entry.lockStateValue));
 #endif
 #ifdef ZCL_USING_WINDOW_COVERING_CLUSTER_SERVER
-  entry.hasCurrentPositionLiftPercentageValue = readServerAttribute(endpoint,
-                                                                    ZCL_WINDOW_COVERING_CLUSTER_ID,
-                                                                    ZCL_CURRENT_LIFT_PERCENTAGE_ATTRIBUTE_ID,
-                                                                    "current position lift percentage",
-                                                                    (int8u *)&entry.currentPositionLiftPercentageValue,
-                                                                    sizeof(entry.currentPositionLiftPercentageValue));
-  entry.hasCurrentPositionTiltPercentageValue = readServerAttribute(endpoint,
-                                                                    ZCL_WINDOW_COVERING_CLUSTER_ID,
-                                                                    ZCL_CURRENT_TILT_PERCENTAGE_ATTRIBUTE_ID,
-                                                                    "current position tilt percentage",
-                                                                    (int8u *)&entry.currentPositionTiltPercentageValue,
-                                                                    sizeof(entry.currentPositionTiltPercentageValue));
+  entry.hasCurrentPositionLiftPercentageValue = readExtension(endpoint,
+                                                              LIFT_PERCENTAGE_EXTENSION,
+                                                              ZCL_WINDOW_COVERING_CLUSTER_ID,
+                                                              ZCL_CURRENT_LIFT_PERCENTAGE_ATTRIBUTE_ID,
+                                                              "current position lift percentage",
+                                                              (int8u *)&entry.currentPositionLiftPercentageValue,
+                                                              sizeof(entry.currentPositionLiftPercentageValue));
+  entry.hasCurrentPositionTiltPercentageValue = readExtension(endpoint,
+                                                              TILT_PERCENTAGE_EXTENSION,
+                                                              ZCL_WINDOW_COVERING_CLUSTER_ID,
+                                                              ZCL_CURRENT_TILT_PERCENTAGE_ATTRIBUTE_ID,
+                                                              "current position tilt percentage",
+                                                              (int8u *)&entry.currentPositionTiltPercentageValue,
+                                                              sizeof(entry.currentPositionTiltPercentageValue));
 #endif
 
   // When creating a new entry, the name is set to the null string (i.e., the
   // length is set to zero) and the transition time is set to zero.  The scene
   // count must be increased and written to the attribute table when adding a
   // new scene.  Otherwise, these fields and the count are left alone.
-  if (i != index) {
+  if (newEntry) {
     entry.endpoint = endpoint;
     entry.groupId = groupId;
     entry.sceneId = sceneId;
@@ -582,150 +785,162 @@ EmberAfStatus emberAfScenesClusterRecallSavedSceneCallback(int8u endpoint,
       && !emberAfGroupsClusterEndpointInGroupCallback(endpoint, groupId)) {
     return EMBER_ZCL_STATUS_INVALID_FIELD;
   } else {
-    int8u i;
-    for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+    EmberAfPluginScenesServerIndex i
+      = emberAfPluginScenesServerFindScene(endpoint, groupId, sceneId);
+    if (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
       EmberAfSceneTableEntry entry;
       emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-      if (entry.endpoint == endpoint
-          && entry.groupId == groupId
-          && entry.sceneId == sceneId) {
 #ifdef ZCL_USING_ON_OFF_CLUSTER_SERVER
-        if (entry.hasOnOffValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_ON_OFF_CLUSTER_ID,
-                               ZCL_ON_OFF_ATTRIBUTE_ID,
-                               "on/off",
-                               (int8u *)&entry.onOffValue,
-                               ZCL_BOOLEAN_ATTRIBUTE_TYPE);
-        }
+      if (entry.hasOnOffValue) {
+        writeExtension(endpoint,
+                       ON_OFF_EXTENSION,
+                       ZCL_ON_OFF_CLUSTER_ID,
+                       ZCL_ON_OFF_ATTRIBUTE_ID,
+                       "on/off",
+                       (int8u *)&entry.onOffValue,
+                       ZCL_BOOLEAN_ATTRIBUTE_TYPE);
+      }
 #endif
 #ifdef ZCL_USING_LEVEL_CONTROL_CLUSTER_SERVER
-        if (entry.hasCurrentLevelValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_LEVEL_CONTROL_CLUSTER_ID,
-                               ZCL_CURRENT_LEVEL_ATTRIBUTE_ID,
-                               "current level",
-                               (int8u *)&entry.currentLevelValue,
-                               ZCL_INT8U_ATTRIBUTE_TYPE);
-        }
+      if (entry.hasCurrentLevelValue) {
+        writeExtension(endpoint,
+                       CURRENT_LEVEL_EXTENSION,
+                       ZCL_LEVEL_CONTROL_CLUSTER_ID,
+                       ZCL_CURRENT_LEVEL_ATTRIBUTE_ID,
+                       "current level",
+                       (int8u *)&entry.currentLevelValue,
+                       ZCL_INT8U_ATTRIBUTE_TYPE);
+      }
 #endif
 #ifdef ZCL_USING_THERMOSTAT_CLUSTER_SERVER
-        if (entry.hasOccupiedCoolingSetpointValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_THERMOSTAT_CLUSTER_ID,
-                               ZCL_OCCUPIED_COOLING_SETPOINT_ATTRIBUTE_ID,
-                               "occupied cooling setpoint",
-                               (int8u *)&entry.occupiedCoolingSetpointValue,
-                               ZCL_INT16S_ATTRIBUTE_TYPE);
-        }
-        if (entry.hasOccupiedHeatingSetpointValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_THERMOSTAT_CLUSTER_ID,
-                               ZCL_OCCUPIED_HEATING_SETPOINT_ATTRIBUTE_ID,
-                               "occupied heating setpoint",
-                               (int8u *)&entry.occupiedHeatingSetpointValue,
-                               ZCL_INT16S_ATTRIBUTE_TYPE);
-        }
-        if (entry.hasSystemModeValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_THERMOSTAT_CLUSTER_ID,
-                               ZCL_SYSTEM_MODE_ATTRIBUTE_ID,
-                               "system mode",
-                               (int8u *)&entry.systemModeValue,
-                               ZCL_INT8U_ATTRIBUTE_TYPE);
-        }
+      if (entry.hasOccupiedCoolingSetpointValue) {
+        writeExtension(endpoint,
+                       OCCUPIED_COOLING_SETPOINT_EXTENSION,
+                       ZCL_THERMOSTAT_CLUSTER_ID,
+                       ZCL_OCCUPIED_COOLING_SETPOINT_ATTRIBUTE_ID,
+                       "occupied cooling setpoint",
+                       (int8u *)&entry.occupiedCoolingSetpointValue,
+                       ZCL_INT16S_ATTRIBUTE_TYPE);
+      }
+      if (entry.hasOccupiedHeatingSetpointValue) {
+        writeExtension(endpoint,
+                       OCCUPIED_HEATING_SETPOINT_EXTENSION,
+                       ZCL_THERMOSTAT_CLUSTER_ID,
+                       ZCL_OCCUPIED_HEATING_SETPOINT_ATTRIBUTE_ID,
+                       "occupied heating setpoint",
+                       (int8u *)&entry.occupiedHeatingSetpointValue,
+                       ZCL_INT16S_ATTRIBUTE_TYPE);
+      }
+      if (entry.hasSystemModeValue) {
+        writeExtension(endpoint,
+                       SYSTEM_MODE_EXTENSION,
+                       ZCL_THERMOSTAT_CLUSTER_ID,
+                       ZCL_SYSTEM_MODE_ATTRIBUTE_ID,
+                       "system mode",
+                       (int8u *)&entry.systemModeValue,
+                       ZCL_INT8U_ATTRIBUTE_TYPE);
+      }
 #endif
 #ifdef ZCL_USING_COLOR_CONTROL_CLUSTER_SERVER
-        if (entry.hasCurrentXValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_COLOR_CONTROL_CLUSTER_ID,
-                               ZCL_COLOR_CONTROL_CURRENT_X_ATTRIBUTE_ID,
-                               "current x",
-                               (int8u *)&entry.currentXValue,
-                               ZCL_INT16U_ATTRIBUTE_TYPE);
+      if (entry.hasCurrentXValue) {
+        writeExtension(endpoint,
+                       CURRENT_X_EXTENSION,
+                       ZCL_COLOR_CONTROL_CLUSTER_ID,
+                       ZCL_COLOR_CONTROL_CURRENT_X_ATTRIBUTE_ID,
+                       "current x",
+                       (int8u *)&entry.currentXValue,
+                       ZCL_INT16U_ATTRIBUTE_TYPE);
+      }
+      if (entry.hasCurrentYValue) {
+        writeExtension(endpoint,
+                       CURRENT_Y_EXTENSION,
+                       ZCL_COLOR_CONTROL_CLUSTER_ID,
+                       ZCL_COLOR_CONTROL_CURRENT_Y_ATTRIBUTE_ID,
+                       "current y",
+                       (int8u *)&entry.currentYValue,
+                       ZCL_INT16U_ATTRIBUTE_TYPE);
+      }
+      if (emberIsZllNetwork()) {
+        if (entry.hasEnhancedCurrentHueValue) {
+          writeExtension(endpoint,
+                         ENHANCED_CURRENT_HUE_EXTENSION,
+                         ZCL_COLOR_CONTROL_CLUSTER_ID,
+                         ZCL_COLOR_CONTROL_ENHANCED_CURRENT_HUE_ATTRIBUTE_ID,
+                         "enhanced current hue",
+                         (int8u *)&entry.enhancedCurrentHueValue,
+                         ZCL_INT16U_ATTRIBUTE_TYPE);
         }
-        if (entry.hasCurrentYValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_COLOR_CONTROL_CLUSTER_ID,
-                               ZCL_COLOR_CONTROL_CURRENT_Y_ATTRIBUTE_ID,
-                               "current y",
-                               (int8u *)&entry.currentYValue,
-                               ZCL_INT16U_ATTRIBUTE_TYPE);
+        if (entry.hasCurrentSaturationValue) {
+          writeExtension(endpoint,
+                         CURRENT_SATURATION_EXTENSION,
+                         ZCL_COLOR_CONTROL_CLUSTER_ID,
+                         ZCL_COLOR_CONTROL_CURRENT_SATURATION_ATTRIBUTE_ID,
+                         "current saturation",
+                         (int8u *)&entry.currentSaturationValue,
+                         ZCL_INT8U_ATTRIBUTE_TYPE);
         }
-        if (emberIsZllNetwork()) {
-          if (entry.hasEnhancedCurrentHueValue) {
-            writeServerAttribute(endpoint,
-                                 ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                 ZCL_COLOR_CONTROL_ENHANCED_CURRENT_HUE_ATTRIBUTE_ID,
-                                 "enhanced current hue",
-                                 (int8u *)&entry.enhancedCurrentHueValue,
-                                 ZCL_INT16U_ATTRIBUTE_TYPE);
-          }
-          if (entry.hasCurrentSaturationValue) {
-            writeServerAttribute(endpoint,
-                                 ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                 ZCL_COLOR_CONTROL_CURRENT_SATURATION_ATTRIBUTE_ID,
-                                 "current saturation",
-                                 (int8u *)&entry.currentSaturationValue,
-                                 ZCL_INT8U_ATTRIBUTE_TYPE);
-          }
-          if (entry.hasColorLoopActiveValue) {
-            writeServerAttribute(endpoint,
-                                 ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                 ZCL_COLOR_CONTROL_COLOR_LOOP_ACTIVE_ATTRIBUTE_ID,
-                                 "color loop active",
-                                 (int8u *)&entry.colorLoopActiveValue,
-                                 ZCL_INT8U_ATTRIBUTE_TYPE);
-          }
-          if (entry.hasColorLoopDirectionValue) {
-            writeServerAttribute(endpoint,
-                                 ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                 ZCL_COLOR_CONTROL_COLOR_LOOP_DIRECTION_ATTRIBUTE_ID,
-                                 "color loop direction",
-                                 (int8u *)&entry.colorLoopDirectionValue,
-                                 ZCL_INT8U_ATTRIBUTE_TYPE);
-          }
-          if (entry.hasColorLoopTimeValue) {
-            writeServerAttribute(endpoint,
-                                 ZCL_COLOR_CONTROL_CLUSTER_ID,
-                                 ZCL_COLOR_CONTROL_COLOR_LOOP_TIME_ATTRIBUTE_ID,
-                                 "color loop time",
-                                 (int8u *)&entry.colorLoopTimeValue,
-                                 ZCL_INT16U_ATTRIBUTE_TYPE);
+        if (entry.hasColorLoopActiveValue) {
+          writeExtension(endpoint,
+                         COLOR_LOOP_ACTIVE_EXTENSION,
+                         ZCL_COLOR_CONTROL_CLUSTER_ID,
+                         ZCL_COLOR_CONTROL_COLOR_LOOP_ACTIVE_ATTRIBUTE_ID,
+                         "color loop active",
+                         (int8u *)&entry.colorLoopActiveValue,
+                         ZCL_INT8U_ATTRIBUTE_TYPE);
         }
+        if (entry.hasColorLoopDirectionValue) {
+          writeExtension(endpoint,
+                         COLOR_LOOP_DIRECTION_EXTENSION,
+                         ZCL_COLOR_CONTROL_CLUSTER_ID,
+                         ZCL_COLOR_CONTROL_COLOR_LOOP_DIRECTION_ATTRIBUTE_ID,
+                         "color loop direction",
+                         (int8u *)&entry.colorLoopDirectionValue,
+                         ZCL_INT8U_ATTRIBUTE_TYPE);
         }
+        if (entry.hasColorLoopTimeValue) {
+          writeExtension(endpoint,
+                         COLOR_LOOP_TIME_EXTENSION,
+                         ZCL_COLOR_CONTROL_CLUSTER_ID,
+                         ZCL_COLOR_CONTROL_COLOR_LOOP_TIME_ATTRIBUTE_ID,
+                         "color loop time",
+                         (int8u *)&entry.colorLoopTimeValue,
+                         ZCL_INT16U_ATTRIBUTE_TYPE);
+        }
+      }
 #endif //ZCL_USING_COLOR_CONTROL_CLUSTER_SERVER
 #ifdef ZCL_USING_DOOR_LOCK_CLUSTER_SERVER
-        if (entry.hasLockStateValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_DOOR_LOCK_CLUSTER_ID,
-                               ZCL_LOCK_STATE_ATTRIBUTE_ID,
-                               "lock state",
-                               (int8u *)&entry.lockStateValue,
-                               ZCL_INT8U_ATTRIBUTE_TYPE);
-        }
+      if (entry.hasLockStateValue) {
+        writeExtension(endpoint,
+                       LOCK_STATE_EXTENSION,
+                       ZCL_DOOR_LOCK_CLUSTER_ID,
+                       ZCL_LOCK_STATE_ATTRIBUTE_ID,
+                       "lock state",
+                       (int8u *)&entry.lockStateValue,
+                       ZCL_INT8U_ATTRIBUTE_TYPE);
+      }
 #endif
 #ifdef ZCL_USING_WINDOW_COVERING_CLUSTER_SERVER
-        if (entry.hasCurrentPositionLiftPercentageValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_WINDOW_COVERING_CLUSTER_ID,
-                               ZCL_CURRENT_LIFT_PERCENTAGE_ATTRIBUTE_ID,
-                               "current position lift percentage",
-                               (int8u *)&entry.currentPositionLiftPercentageValue,
-                               ZCL_INT8U_ATTRIBUTE_TYPE);
-        }
-        if (entry.hasCurrentPositionTiltPercentageValue) {
-          writeServerAttribute(endpoint,
-                               ZCL_WINDOW_COVERING_CLUSTER_ID,
-                               ZCL_CURRENT_TILT_PERCENTAGE_ATTRIBUTE_ID,
-                               "current position tilt percentage",
-                               (int8u *)&entry.currentPositionTiltPercentageValue,
-                               ZCL_INT8U_ATTRIBUTE_TYPE);
-        }
-#endif
-        emberAfScenesMakeValid(endpoint, sceneId, groupId);
-        return EMBER_ZCL_STATUS_SUCCESS;
+      if (entry.hasCurrentPositionLiftPercentageValue) {
+        writeExtension(endpoint,
+                       LIFT_PERCENTAGE_EXTENSION,
+                       ZCL_WINDOW_COVERING_CLUSTER_ID,
+                       ZCL_CURRENT_LIFT_PERCENTAGE_ATTRIBUTE_ID,
+                       "current position lift percentage",
+                       (int8u *)&entry.currentPositionLiftPercentageValue,
+                       ZCL_INT8U_ATTRIBUTE_TYPE);
       }
+      if (entry.hasCurrentPositionTiltPercentageValue) {
+        writeExtension(endpoint,
+                       TILT_PERCENTAGE_EXTENSION,
+                       ZCL_WINDOW_COVERING_CLUSTER_ID,
+                       ZCL_CURRENT_TILT_PERCENTAGE_ATTRIBUTE_ID,
+                       "current position tilt percentage",
+                       (int8u *)&entry.currentPositionTiltPercentageValue,
+                       ZCL_INT8U_ATTRIBUTE_TYPE);
+      }
+#endif
+      emberAfScenesMakeValid(endpoint, sceneId, groupId);
+      return EMBER_ZCL_STATUS_SUCCESS;
     }
   }
 
@@ -734,8 +949,21 @@ EmberAfStatus emberAfScenesClusterRecallSavedSceneCallback(int8u endpoint,
 
 void emberAfScenesClusterClearSceneTableCallback(int8u endpoint)
 {
-  int8u i, networkIndex = emberGetCurrentNetwork();
-  for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+  EmberAfPluginScenesServerIndex i, removed = 0;
+  int8u networkIndex = emberGetCurrentNetwork();
+#if defined(EZSP_HOST)
+  if (endpoint == EMBER_BROADCAST_ENDPOINT) {
+    for (i = 0; i < emberAfEndpointCount(); i++) {
+      int8u ep = emberAfEndpointFromIndex(i);
+      if (emberAfNetworkIndexFromEndpoint(ep) == networkIndex) {
+        removed += removeEndpointScenes(ep);
+      }
+    }
+  } else {
+    removed = removeEndpointScenes(endpoint);
+  }
+#else
+  for (i = 0; i < sceneTableSize(); i++) {
     EmberAfSceneTableEntry entry;
     emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
     if (entry.endpoint != EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID
@@ -745,9 +973,13 @@ void emberAfScenesClusterClearSceneTableCallback(int8u endpoint)
                     == emberAfNetworkIndexFromEndpoint(entry.endpoint))))) {
       entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
       emberAfPluginScenesServerSaveSceneEntry(entry, i);
+      removed++;
     }
   }
-  emberAfPluginScenesServerSetNumSceneEntriesInUse(0);
+#endif
+  // Scenes on other networks' endpoints are kept, so they are still counted.
+  emberAfPluginScenesServerSetNumSceneEntriesInUse(emberAfPluginScenesServerNumSceneEntriesInUse()
+                                                   - removed);
   if (endpoint == EMBER_BROADCAST_ENDPOINT) {
     for (i = 0; i < emberAfEndpointCount(); i++) {
       if (emberAfNetworkIndexFromEndpointIndex(i) == networkIndex) {
@@ -777,7 +1009,8 @@ boolean emberAfPluginScenesServerParseAddScene(const EmberAfClusterCommand *cmd,
                                      + emberAfStringLength(sceneName) + 1));
   int16u extensionFieldSetsIndex = 0;
   int8u endpoint = cmd->apsFrame->destinationEndpoint;
-  int8u i, index = EMBER_AF_SCENE_TABLE_NULL_INDEX;
+  EmberAfPluginScenesServerIndex index;
+  boolean newEntry = FALSE;
 
   emberAfScenesClusterPrint("RX: %pAddScene 0x%2x, 0x%x, 0x%2x, \"",
                             (enhanced ? "Enhanced" : ""),
@@ -805,21 +1038,14 @@ boolean emberAfPluginScenesServerParseAddScene(const EmberAfClusterCommand *cmd,
     goto kickout;
   }
 
-  for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
-    emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-    if (entry.endpoint == endpoint
-        && entry.groupId == groupId
-        && entry.sceneId == sceneId) {
-      index = i;
-      break;
-    } else if (index == EMBER_AF_SCENE_TABLE_NULL_INDEX
-               && entry.endpoint == EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID) {
-      index = i;
-    }
+  index = emberAfPluginScenesServerFindScene(endpoint, groupId, sceneId);
+  if (index == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    index = emberAfPluginScenesServerFindUnusedEntry();
+    newEntry = TRUE;
   }
 
-  // If the target index is still zero, the table is full.
-  if (index == EMBER_AF_SCENE_TABLE_NULL_INDEX) {
+  // If there is still no target index, the table is full.
+  if (index == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
     status = EMBER_ZCL_STATUS_INSUFFICIENT_SPACE;
     goto kickout;
   }
@@ -846,7 +1072,7 @@ boolean emberAfPluginScenesServerParseAddScene(const EmberAfClusterCommand *cmd,
 
   // When adding a new scene, wipe out all of the extensions before parsing the
   // extension field sets data.
-  if (i != index) {
+  if (newEntry) {
 #ifdef ZCL_USING_ON_OFF_CLUSTER_SERVER
     entry.hasOnOffValue = FALSE;
 #endif
@@ -1039,7 +1265,7 @@ boolean emberAfPluginScenesServerParseAddScene(const EmberAfClusterCommand *cmd,
   // If we got this far, we either added a new entry or updated an existing one.
   // If we added, store the basic data and increment the scene count.  In either
   // case, save the entry.
-  if (i != index) {
+  if (newEntry) {
     entry.endpoint = endpoint;
     entry.groupId = groupId;
     entry.sceneId = sceneId;
@@ -1097,15 +1323,11 @@ boolean emberAfPluginScenesServerParseViewScene(const EmberAfClusterCommand *cmd
                                                              groupId)) {
     status = EMBER_ZCL_STATUS_INVALID_FIELD;
   } else {
-    int8u i;
-    for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+    EmberAfPluginScenesServerIndex i
+      = emberAfPluginScenesServerFindScene(endpoint, groupId, sceneId);
+    if (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
       emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-      if (entry.endpoint == endpoint
-          && entry.groupId == groupId
-          && entry.sceneId == sceneId) {
-        status = EMBER_ZCL_STATUS_SUCCESS;
-        break;
-      }
+      status = EMBER_ZCL_STATUS_SUCCESS;
     }
   }
 
@@ -1235,19 +1457,322 @@ boolean emberAfPluginScenesServerParseViewScene(const EmberAfClusterCommand *cmd
 
 void emberAfScenesClusterRemoveScenesInGroupCallback(int8u endpoint,
                                                        int16u groupId)
+{
+  EmberAfPluginScenesServerIndex i
+    = emberAfPluginScenesServerFirstSceneInGroup(endpoint, groupId);
+  while (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    EmberAfSceneTableEntry entry;
+    emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
+    entry.groupId = ZCL_SCENES_GLOBAL_SCENE_GROUP_ID;
+    entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
+    emberAfPluginScenesServerSaveSceneEntry(entry, i);
+    emberAfPluginScenesServerDecrNumSceneEntriesInUse();
+    emberAfScenesSetSceneCountAttribute(emberAfCurrentEndpoint(),
+                                        emberAfPluginScenesServerNumSceneEntriesInUse());
+    i = emberAfPluginScenesServerNextSceneInGroup(endpoint, groupId, i);
+  }
+}
+
+#if defined(EZSP_HOST)
+
+static int16u sceneBucket(int8u endpoint, int16u groupId, int8u sceneId)
+{
+  int32u hash = ((((int32u)groupId << 16) | ((int16u)endpoint << 8) | sceneId)
+                 * 0x9E3779B1UL);
+  return (int16u)((hash >> 16) % tableSize);
+}
+
+static int16u groupBucket(int8u endpoint, int16u groupId)
+{
+  int32u hash = ((((int32u)groupId << 8) | endpoint) * 0x9E3779B1UL);
+  return (int16u)((hash >> 16) % tableSize);
+}
+
+static void linkEntry(int16u i)
+{
+  EmberAfSceneTableEntry *entry = &emberAfPluginScenesServerSceneTable[i];
+  int16u *head = &sceneHeads[sceneBucket(entry->endpoint,
+                                         entry->groupId,
+                                         entry->sceneId)];
+  sceneLinks[i].sceneNext = *head;
+  *head = i;
+  head = &groupHeads[groupBucket(entry->endpoint, entry->groupId)];
+  sceneLinks[i].groupNext = *head;
+  *head = i;
+  head = &endpointHeads[entry->endpoint];
+  sceneLinks[i].endpointNext = *head;
+  sceneLinks[i].endpointPrev = EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+  if (*head != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    sceneLinks[*head].endpointPrev = i;
+  }
+  *head = i;
+}
+
+// Leaves groupNext and endpointNext alone, so that a walk through a group or
+// an endpoint can go on past an entry that has just been removed.
+static void unlinkEntry(int16u i)
+{
+  EmberAfSceneTableEntry *entry = &emberAfPluginScenesServerSceneTable[i];
+  int16u next = sceneLinks[i].endpointNext;
+  int16u prev = sceneLinks[i].endpointPrev;
+  int16u *link = &sceneHeads[sceneBucket(entry->endpoint,
+                                         entry->groupId,
+                                         entry->sceneId)];
+  while (*link != i) {
+    link = &sceneLinks[*link].sceneNext;
+  }
+  *link = sceneLinks[i].sceneNext;
+  link = &groupHeads[groupBucket(entry->endpoint, entry->groupId)];
+  while (*link != i) {
+    link = &sceneLinks[*link].groupNext;
+  }
+  *link = sceneLinks[i].groupNext;
+  if (prev == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    endpointHeads[entry->endpoint] = next;
+  } else {
+    sceneLinks[prev].endpointNext = next;
+  }
+  if (next != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    sceneLinks[next].endpointPrev = prev;
+  }
+}
+
+static void addUnusedEntry(int16u i)
+{
+  sceneLinks[i].sceneNext = unusedHead;
+  unusedHead = i;
+}
+
+// Entries are normally taken from the head of the free list.
+static void removeUnusedEntry(int16u i)
+{
+  int16u *link = &unusedHead;
+  while (*link != i) {
+    link = &sceneLinks[*link].sceneNext;
+  }
+  *link = sceneLinks[i].sceneNext;
+}
+
+static boolean growTable(void)
+{
+  EmberAfSceneTableEntry *table;
+  SceneLinks *links;
+  int16u *heads;
+  int16u size, i;
+
+  if (tableSize == MAX_TABLE_SIZE) {
+    return FALSE;
+  }
+  size = (tableSize == 0
+          ? EMBER_AF_PLUGIN_SCENES_TABLE_SIZE
+          : (tableSize < MAX_TABLE_SIZE / 2 ? tableSize * 2 : MAX_TABLE_SIZE));
+
+  // Until every array has grown, tableSize keeps the old size.
+  table = (EmberAfSceneTableEntry *)realloc(emberAfPluginScenesServerSceneTable,
+                                            size * sizeof(EmberAfSceneTableEntry));
+  if (table == NULL) {
+    return FALSE;
+  }
+  emberAfPluginScenesServerSceneTable = table;
+  links = (SceneLinks *)realloc(sceneLinks, size * sizeof(SceneLinks));
+  if (links == NULL) {
+    return FALSE;
+  }
+  sceneLinks = links;
+  heads = (int16u *)realloc(sceneHeads, size * sizeof(int16u));
+  if (heads == NULL) {
+    return FALSE;
+  }
+  sceneHeads = heads;
+  heads = (int16u *)realloc(groupHeads, size * sizeof(int16u));
+  if (heads == NULL) {
+    return FALSE;
+  }
+  groupHeads = heads;
+
+  for (i = tableSize; i < size; i++) {
+    table[i].endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
+  }
+  tableSize = size;
+
+  // Every entry moves to a new bucket.  The free list is rebuilt lowest
+  // entry first, as a search of the table would find them.
+  MEMSET(sceneHeads, 0xFF, size * sizeof(int16u));
+  MEMSET(groupHeads, 0xFF, size * sizeof(int16u));
+  MEMSET(endpointHeads, 0xFF, sizeof(endpointHeads));
+  unusedHead = EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+  for (i = size; i > 0; i--) {
+    if (table[i - 1].endpoint == EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID) {
+      addUnusedEntry(i - 1);
+    } else {
+      linkEntry(i - 1);
+    }
+  }
+  return TRUE;
+}
+
+void emAfPluginScenesServerSaveSceneEntry(const EmberAfSceneTableEntry *entry,
+                                          EmberAfPluginScenesServerIndex i)
+{
+  EmberAfSceneTableEntry *saved = &emberAfPluginScenesServerSceneTable[i];
+  boolean wasUsed = (saved->endpoint != EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID);
+  boolean isUsed = (entry->endpoint != EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID);
+  boolean rechain = !(wasUsed
+                      && isUsed
+                      && saved->endpoint == entry->endpoint
+                      && saved->groupId == entry->groupId
+                      && saved->sceneId == entry->sceneId);
+
+  if (rechain) {
+    if (wasUsed) {
+      unlinkEntry(i);
+    } else {
+      removeUnusedEntry(i);
+    }
+  }
+  *saved = *entry;
+  if (rechain) {
+    if (isUsed) {
+      linkEntry(i);
+    } else {
+      addUnusedEntry(i);
+    }
+  }
+}
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFindScene(int8u endpoint,
+                                                                  int16u groupId,
+                                                                  int8u sceneId)
+{
+  int16u i;
+
+  if (tableSize == 0) {
+    return EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+  }
+  for (i = sceneHeads[sceneBucket(endpoint, groupId, sceneId)];
+       i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+       i = sceneLinks[i].sceneNext) {
+    EmberAfSceneTableEntry *entry = &emberAfPluginScenesServerSceneTable[i];
+    if (entry->endpoint == endpoint
+        && entry->groupId == groupId
+        && entry->sceneId == sceneId) {
+      return i;
+    }
+  }
+  return EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+}
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFindUnusedEntry(void)
+{
+  if (unusedHead == EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    growTable();
+  }
+  return unusedHead;
+}
+
+// Returns the first entry for the group's scenes from i on along its bucket.
+static int16u sceneInGroup(int8u endpoint, int16u groupId, int16u i)
+{
+  while (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX
+         && (emberAfPluginScenesServerSceneTable[i].endpoint != endpoint
+             || emberAfPluginScenesServerSceneTable[i].groupId != groupId)) {
+    i = sceneLinks[i].groupNext;
+  }
+  return i;
+}
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFirstSceneInGroup(int8u endpoint,
+                                                                          int16u groupId)
+{
+  if (tableSize == 0) {
+    return EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+  }
+  return sceneInGroup(endpoint,
+                      groupId,
+                      groupHeads[groupBucket(endpoint, groupId)]);
+}
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerNextSceneInGroup(int8u endpoint,
+                                                                         int16u groupId,
+                                                                         EmberAfPluginScenesServerIndex index)
+{
+  return sceneInGroup(endpoint, groupId, sceneLinks[index].groupNext);
+}
+
+// Removes every scene on an endpoint and returns how many there were.
+static int16u removeEndpointScenes(int8u endpoint)
+{
+  int16u i = (tableSize == 0
+              ? EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX
+              : endpointHeads[endpoint]);
+  int16u removed = 0;
+  while (i != EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX) {
+    EmberAfSceneTableEntry entry;
+    emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
+    entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
+    emberAfPluginScenesServerSaveSceneEntry(entry, i);
+    removed++;
+    i = sceneLinks[i].endpointNext;
+  }
+  return removed;
+}
+
+#else
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFindScene(int8u endpoint,
+                                                                  int16u groupId,
+                                                                  int8u sceneId)
 {
   int8u i;
   for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
     EmberAfSceneTableEntry entry;
     emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
-    if (entry.endpoint == endpoint &&
-        entry.groupId == groupId) {
-      entry.groupId = ZCL_SCENES_GLOBAL_SCENE_GROUP_ID;
-      entry.endpoint = EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID;
-      emberAfPluginScenesServerSaveSceneEntry(entry, i);
-      emberAfPluginScenesServerDecrNumSceneEntriesInUse();
-      emberAfScenesSetSceneCountAttribute(emberAfCurrentEndpoint(),
-                                          emberAfPluginScenesServerNumSceneEntriesInUse());
+    if (entry.endpoint == endpoint
+        && entry.groupId == groupId
+        && entry.sceneId == sceneId) {
+      return i;
+    }
+  }
+  return EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+}
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFindUnusedEntry(void)
+{
+  int8u i;
+  for (i = 0; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+    EmberAfSceneTableEntry entry;
+    emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
+    if (entry.endpoint == EMBER_AF_SCENE_TABLE_UNUSED_ENDPOINT_ID) {
+      return i;
+    }
+  }
+  return EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
+}
+
+// Returns the first entry for the group's scenes from i on.
+static int8u sceneInGroup(int8u endpoint, int16u groupId, int8u i)
+{
+  for (; i < EMBER_AF_PLUGIN_SCENES_TABLE_SIZE; i++) {
+    EmberAfSceneTableEntry entry;
+    emberAfPluginScenesServerRetrieveSceneEntry(entry, i);
+    if (entry.endpoint == endpoint && entry.groupId == groupId) {
+      return i;
     }
   }
+  return EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX;
 }
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFirstSceneInGroup(int8u endpoint,
+                                                                          int16u groupId)
+{
+  return sceneInGroup(endpoint, groupId, 0);
+}
+
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerNextSceneInGroup(int8u endpoint,
+                                                                         int16u groupId,
+                                                                         EmberAfPluginScenesServerIndex index)
+{
+  return sceneInGroup(endpoint, groupId, index + 1);
+}
+
+#endif //EZSP_HOST
@@ -6,7 +6,7 @@
 // *******************************************************************
 
 EmberAfStatus emberAfScenesSetSceneCountAttribute(int8u endpoint,
-                                                  int8u newCount);
+                                                  int16u newCount);
 EmberAfStatus emberAfScenesMakeValid(int8u endpoint,
                                      int8u sceneId,
                                      int16u groupId);
@@ -16,7 +16,18 @@ EmberAfStatus emberAfScenesMakeValid(int8u endpoint,
 
 void emAfPluginScenesServerPrintInfo(void);
 
-extern int8u emberAfPluginScenesServerEntriesInUse;
+#if defined(EZSP_HOST)
+  // The host's scene table is a pool that grows as scenes are added, so it
+  // may have more entries than an int8u can count or index.
+  typedef int16u EmberAfPluginScenesServerIndex;
+  #define EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX 0xFFFF
+  extern int16u emberAfPluginScenesServerEntriesInUse;
+#else
+  typedef int8u EmberAfPluginScenesServerIndex;
+  #define EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX EMBER_AF_SCENE_TABLE_NULL_INDEX
+  extern int8u emberAfPluginScenesServerEntriesInUse;
+#endif
+
 #if defined(EMBER_AF_PLUGIN_SCENES_USE_TOKENS) && !defined(EZSP_HOST)
   // In this case, we use token storage
   #define emberAfPluginScenesServerRetrieveSceneEntry(entry, i) \
@@ -39,11 +50,21 @@ extern int8u emberAfPluginScenesServerEntriesInUse;
      halCommonSetToken(TOKEN_SCENES_NUM_ENTRIES, &emberAfPluginScenesServerEntriesInUse))
 #else
   // Use normal RAM storage
-  extern EmberAfSceneTableEntry emberAfPluginScenesServerSceneTable[];
+  #if defined(EZSP_HOST)
+    // The host indexes the entries by their endpoint, group and scene, so an
+    // entry is saved through a function that keeps the index up to date.
+    extern EmberAfSceneTableEntry *emberAfPluginScenesServerSceneTable;
+    void emAfPluginScenesServerSaveSceneEntry(const EmberAfSceneTableEntry *entry,
+                                              EmberAfPluginScenesServerIndex i);
+    #define emberAfPluginScenesServerSaveSceneEntry(entry, i) \
+      emAfPluginScenesServerSaveSceneEntry(&(entry), i)
+  #else
+    extern EmberAfSceneTableEntry emberAfPluginScenesServerSceneTable[];
+    #define emberAfPluginScenesServerSaveSceneEntry(entry, i) \
+      (emberAfPluginScenesServerSceneTable[i] = entry)
+  #endif
   #define emberAfPluginScenesServerRetrieveSceneEntry(entry, i) \
     (entry = emberAfPluginScenesServerSceneTable[i])
-  #define emberAfPluginScenesServerSaveSceneEntry(entry, i) \
-    (emberAfPluginScenesServerSceneTable[i] = entry)
   #define emberAfPluginScenesServerNumSceneEntriesInUse() \
     (emberAfPluginScenesServerEntriesInUse)
   #define emberAfPluginScenesServerSetNumSceneEntriesInUse(x) \
@@ -54,6 +75,27 @@ extern int8u emberAfPluginScenesServerEntriesInUse;
     (--emberAfPluginScenesServerEntriesInUse)
 #endif // Use tokens
 
+// Returns the index of the entry for a scene on an endpoint, or
+// EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX if there is none.
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFindScene(int8u endpoint,
+                                                                  int16u groupId,
+                                                                  int8u sceneId);
+
+// Returns the index of an unused entry, or
+// EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX if the table is full.  On the host
+// this may grow the table.
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFindUnusedEntry(void);
+
+// Walk the entries for the scenes of a group on an endpoint, ending with
+// EMBER_AF_PLUGIN_SCENES_SERVER_NULL_INDEX.  The entry the walk has reached
+// may be removed before asking for the next one, but no entry may be added
+// during the walk.
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerFirstSceneInGroup(int8u endpoint,
+                                                                          int16u groupId);
+EmberAfPluginScenesServerIndex emberAfPluginScenesServerNextSceneInGroup(int8u endpoint,
+                                                                         int16u groupId,
+                                                                         EmberAfPluginScenesServerIndex index);
+
 boolean emberAfPluginScenesServerParseAddScene(const EmberAfClusterCommand *cmd,
                                                int16u groupId,
                                                int8u sceneId,
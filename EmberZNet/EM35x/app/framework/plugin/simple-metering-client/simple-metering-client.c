@@ -8,6 +8,43 @@
 #include "../../include/af.h"
 #include "../../util/common.h"
 #include "simple-metering-client-callback.h"
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+  #include "app/framework/plugin/meter-mirror-store/meter-mirror-store.h"
+#endif
+
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+// Get Profile Responses do not say which interval channel was asked for, so
+// the channel of each Get Profile command sent directly to a meter is kept
+// until the response with the same sequence number comes back.  When the
+// table is full, the oldest request is forgotten.
+#define PROFILE_REQUEST_TABLE_SIZE 8
+
+typedef struct {
+  boolean inUse;
+  EmberNodeId meter;
+  int8u sequenceNumber;
+  int8u intervalChannel;
+} ProfileRequest;
+
+static ProfileRequest profileRequests[PROFILE_REQUEST_TABLE_SIZE];
+static int8u nextProfileRequest = 0;
+
+// Returns the interval channel of the request a response answers, or 0xFF if
+// the request is not known.
+static int8u takeProfileRequest(EmberNodeId meter, int8u sequenceNumber)
+{
+  int8u i;
+  for (i = 0; i < PROFILE_REQUEST_TABLE_SIZE; i++) {
+    if (profileRequests[i].inUse
+        && profileRequests[i].meter == meter
+        && profileRequests[i].sequenceNumber == sequenceNumber) {
+      profileRequests[i].inUse = FALSE;
+      return profileRequests[i].intervalChannel;
+    }
+  }
+  return 0xFF;
+}
+#endif //EMBER_AF_PLUGIN_METER_MIRROR_STORE
 
 static void clusterRequestCommon(int8u responseCommandId)
 {
@@ -24,6 +61,16 @@ static void clusterRequestCommon(int8u responseCommandId)
                 ? emberAfPluginSimpleMeteringClientRequestMirrorCallback(otaEui)
                 : emberAfPluginSimpleMeteringClientRemoveMirrorCallback(otaEui));
 
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+  if (endpointId != 0xFFFF) {
+    if (ZCL_REQUEST_MIRROR_RESPONSE_COMMAND_ID == responseCommandId) {
+      emberAfPluginMeterMirrorStoreMirrorAdded((int8u)endpointId, otaEui);
+    } else {
+      emberAfPluginMeterMirrorStoreMirrorRemoved((int8u)endpointId);
+    }
+  }
+#endif
+
   emberAfFillExternalBuffer(ZCL_CLUSTER_SPECIFIC_COMMAND
                             | ZCL_FRAME_CONTROL_CLIENT_TO_SERVER
                             | EMBER_AF_DEFAULT_RESPONSE_POLICY_RESPONSES,
@@ -41,6 +88,12 @@ boolean emberAfSimpleMeteringClusterGetProfileResponseCallback(int32u endTime,
                                                                int8u* intervals)
 {
   int8u i;
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+  int32u values[EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS];
+  EmberEUI64 meter;
+  int8u channel = takeProfileRequest(emberAfCurrentCommand()->source,
+                                     emberAfCurrentCommand()->seqNum);
+#endif
   emberAfSimpleMeteringClusterPrint("RX: GetProfileResponse 0x%4x, 0x%x, 0x%x, 0x%x",
                                     endTime,
                                     status,
@@ -51,6 +104,27 @@ boolean emberAfSimpleMeteringClusterGetProfileResponseCallback(int32u endTime,
                                       emberAfGetInt24u(intervals + i * 3, 0, 3));
   }
   emberAfSimpleMeteringClusterPrintln("");
+
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+  // Intervals for a request this plugin did not see sent are not stored,
+  // since their channel is not known.
+  if (status == 0x00
+      && channel <= EMBER_AF_PLUGIN_METER_MIRROR_STORE_INTERVAL_RECEIVED
+      && numberOfPeriodsDelivered <= EMBER_AF_PLUGIN_METER_MIRROR_STORE_MAX_PROFILE_PERIODS
+      && (emberLookupEui64ByNodeId(emberAfCurrentCommand()->source, meter)
+          == EMBER_SUCCESS)) {
+    for (i = 0; i < numberOfPeriodsDelivered; i++) {
+      values[i] = emberAfGetInt24u(intervals + i * 3, 0, 3);
+    }
+    emberAfPluginMeterMirrorStoreAppendProfile(meter,
+                                               channel,
+                                               endTime,
+                                               profileIntervalPeriod,
+                                               numberOfPeriodsDelivered,
+                                               values);
+  }
+#endif
+
   emberAfSendImmediateDefaultResponse(EMBER_ZCL_STATUS_SUCCESS);
   return TRUE;
 }
@@ -78,3 +152,34 @@ boolean emberAfSimpleMeteringClusterRequestFastPollModeResponseCallback(int8u ap
   emberAfSendImmediateDefaultResponse(EMBER_ZCL_STATUS_SUCCESS);
   return TRUE;
 }
+
+void emberAfSimpleMeteringClusterClientMessageSentCallback(EmberOutgoingMessageType type,
+                                                           int16u indexOrDestination,
+                                                           EmberApsFrame *apsFrame,
+                                                           int16u msgLen,
+                                                           int8u *message,
+                                                           EmberStatus status)
+{
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+  ProfileRequest *request;
+
+  // The interval channel follows the frame control, sequence number and
+  // command id of a Get Profile command.  Only when the command was sent
+  // directly is the meter's node id known.
+  if (type != EMBER_OUTGOING_DIRECT
+      || msgLen < 4
+      || (message[0] & ZCL_MANUFACTURER_SPECIFIC_MASK)
+      || message[2] != ZCL_GET_PROFILE_COMMAND_ID) {
+    return;
+  }
+
+  // A repeated request replaces the one it repeats.
+  takeProfileRequest(indexOrDestination, message[1]);
+  request = &profileRequests[nextProfileRequest];
+  nextProfileRequest = (nextProfileRequest + 1) % PROFILE_REQUEST_TABLE_SIZE;
+  request->inUse = TRUE;
+  request->meter = indexOrDestination;
+  request->sequenceNumber = message[1];
+  request->intervalChannel = message[3];
+#endif
+}
@@ -9,6 +9,9 @@
 #include "../../include/af.h"
 #include "../../util/common.h"
 #include "simple-metering-test.h"
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+  #include "app/framework/plugin/meter-mirror-store/meter-mirror-store.h"
+#endif
 
 static int32u fastPollEndTimeUtcTable[EMBER_AF_SIMPLE_METERING_CLUSTER_SERVER_ENDPOINT_COUNT];
 
@@ -48,6 +51,15 @@ boolean emberAfSimpleMeteringClusterGetProfileCallback(int8u intervalChannel,
                                                        int32u endTime,
                                                        int8u numberOfPeriods)
 {
+#ifdef EMBER_AF_PLUGIN_METER_MIRROR_STORE
+  // Mirrors answer from the intervals their meters have delivered.
+  if (emberAfPluginMeterMirrorStoreGetProfileCommand(emberAfCurrentCommand()->apsFrame->destinationEndpoint,
+                                                     intervalChannel,
+                                                     endTime,
+                                                     numberOfPeriods)) {
+    return TRUE;
+  }
+#endif
   return emAfTestMeterGetProfiles(intervalChannel, endTime, numberOfPeriods);
 }
 
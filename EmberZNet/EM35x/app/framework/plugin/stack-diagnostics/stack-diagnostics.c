@@ -93,6 +93,10 @@ static void printChildTable(void)
   int8u used = 0;
 
   emberAfAppPrintln("#  type    id     eui64");
+#ifdef EZSP_HOST
+  // Pipeline the reads rather than waiting for each entry in turn.
+  ezspTableMirrorSnapshot(EZSP_CHILD_TABLE_MIRROR, 0, size);
+#endif
   for (i = 0; i < size; i++) {
     EmberNodeId childId;
     EmberEUI64 childEui64;
@@ -124,6 +128,11 @@ static void printNeighborTable(void)
   EmberNeighborTableEntry n;
 
   emberAfAppPrintln("#  id     lqi  in  out  age  eui");
+#ifdef EZSP_HOST
+  ezspTableMirrorSnapshot(EZSP_NEIGHBOR_TABLE_MIRROR,
+                          0,
+                          emberAfGetNeighborTableSize());
+#endif
   for (i = 0; i < emberAfGetNeighborTableSize(); i++) {
     EmberStatus status = emberGetNeighbor(i, &n);
     if ((status != EMBER_SUCCESS)
@@ -164,6 +173,11 @@ static void printRouteTable(void)
   EmberRouteTableEntry entry;
 
   emberAfAppPrintln("#  id      next    age  conc    status");
+#ifdef EZSP_HOST
+  ezspTableMirrorSnapshot(EZSP_ROUTE_TABLE_MIRROR,
+                          0,
+                          emberAfGetRouteTableSize());
+#endif
   for (i = 0; i < emberAfGetRouteTableSize(); i++) {
     if (EMBER_SUCCESS !=  emberGetRouteTableEntry(i, &entry)
         || entry.destination == EMBER_NULL_NODE_ID) {
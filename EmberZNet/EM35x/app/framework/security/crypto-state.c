@@ -50,6 +50,13 @@ EmAfCryptoStatus emAfGetCryptoStatus(void)
   return cryptoStatus;
 }
 
+#if defined(EZSP_HOST)
+int32u emAfCryptoOperationMsToTimeout(void)
+{
+  return emberMsToNextEvent(emAfCryptoEvents, CRYPTO_OPERATION_TIMEOUT_MS);
+}
+#endif //EZSP_HOST
+
 void emAfSetCryptoStatus(EmAfCryptoStatus newStatus)
 {
   cryptoStatus = newStatus;
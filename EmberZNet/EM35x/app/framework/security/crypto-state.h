@@ -33,6 +33,12 @@ typedef int8u EmAfCryptoStatus;
 EmAfCryptoStatus emAfGetCryptoStatus(void);
 void emAfSetCryptoStatus(EmAfCryptoStatus newStatus);
 
+#if defined(EZSP_HOST)
+// Returns the milliseconds until an operation in progress is given up on, so
+// the host can sleep while waiting for the NCP to finish it.
+int32u emAfCryptoOperationMsToTimeout(void);
+#endif //EZSP_HOST
+
 #define emAfSetCryptoOperationInProgress() \
   (emAfSetCryptoStatus(EM_AF_CRYPTO_OPERATION_IN_PROGRESS))
 
@@ -5,6 +5,7 @@
 // Copyright 2010 by Ember Corporation. All rights reserved.                *80*
 
 #include PLATFORM_HEADER     // Micro and compiler specific typedefs and macros
+#include <stdlib.h>
 #include "stack/include/ember-types.h"
 #include "hal/hal.h"
 #include "stack/include/event.h"
@@ -14,29 +15,216 @@ extern EmberTaskControl emTasks[];
 extern PGM int8u emTaskCount;
 static int8u emActiveTaskCount = 0;
 
+// The number of different arrays of events that may be run.  Each task has
+// one, and emberRunEvents() may also be called directly with others.
+#ifndef EMBER_EVENT_QUEUE_COUNT
+  #define EMBER_EVENT_QUEUE_COUNT 8
+#endif
+
+// Each array of events has a queue, which is a binary min-heap of its active
+// events ordered by the millisecond tick at which they are due.  Setting an
+// event adds it to the heap or moves it within the heap, so finding the next
+// event takes constant time and running events only touches those that are
+// due, however many events there are.
+//
+// emberEventControlSetInactive() is a macro that only changes the status, so
+// an inactive event may still be in the heap.  It is discarded when it
+// reaches the top.
+
+typedef struct {
+  int32u deadline;              // millisecond tick
+  EmberEventControl *control;
+} HeapEntry;
+
+typedef struct {
+  EmberEventData *events;
+  HeapEntry *heap;
+  int16u heapCount;
+  EmberEventControl **due;      // used by emberRunEvents()
+} EventQueue;
+
+static EventQueue queues[EMBER_EVENT_QUEUE_COUNT];
+static int8u queueCount = 0;
+
+// Tick values are compared allowing for wrapping, as elsewhere.
+#define isEarlier(a, b) ((int32s)((a) - (b)) < 0)
+
+static void heapSet(EventQueue *queue, int16u position, HeapEntry entry)
+{
+  queue->heap[position] = entry;
+  entry.control->heapIndex = position + 1;
+}
+
+static void siftUp(EventQueue *queue, int16u position)
+{
+  HeapEntry entry = queue->heap[position];
+  while (position > 0) {
+    int16u parent = (position - 1) / 2;
+    if (!isEarlier(entry.deadline, queue->heap[parent].deadline)) {
+      break;
+    }
+    heapSet(queue, position, queue->heap[parent]);
+    position = parent;
+  }
+  heapSet(queue, position, entry);
+}
+
+static void siftDown(EventQueue *queue, int16u position)
+{
+  HeapEntry entry = queue->heap[position];
+  for (;;) {
+    int16u child = 2 * position + 1;
+    if (child >= queue->heapCount) {
+      break;
+    }
+    if (child + 1 < queue->heapCount
+        && isEarlier(queue->heap[child + 1].deadline,
+                     queue->heap[child].deadline)) {
+      child++;
+    }
+    if (!isEarlier(queue->heap[child].deadline, entry.deadline)) {
+      break;
+    }
+    heapSet(queue, position, queue->heap[child]);
+    position = child;
+  }
+  heapSet(queue, position, entry);
+}
+
+static void heapRemove(EventQueue *queue, int16u position)
+{
+  EmberEventControl *control = queue->heap[position].control;
+  int32u deadline = queue->heap[position].deadline;
+  queue->heapCount--;
+  if (position < queue->heapCount) {
+    heapSet(queue, position, queue->heap[queue->heapCount]);
+    if (isEarlier(queue->heap[position].deadline, deadline)) {
+      siftUp(queue, position);
+    } else {
+      siftDown(queue, position);
+    }
+  }
+  control->heapIndex = 0;
+}
+
+// Adds an event to its queue's heap, or moves it if it is already there.
+// An event whose array has not been run yet has no queue; it is added when
+// the array is first seen.
+static void scheduleEvent(EmberEventControl *control, int32u deadline)
+{
+  EventQueue *queue;
+  if (control->queue == 0) {
+    return;
+  }
+  queue = &queues[control->queue - 1];
+  if (control->heapIndex != 0) {
+    int16u position = control->heapIndex - 1;
+    int32u previous = queue->heap[position].deadline;
+    queue->heap[position].deadline = deadline;
+    if (isEarlier(deadline, previous)) {
+      siftUp(queue, position);
+    } else {
+      siftDown(queue, position);
+    }
+  } else {
+    HeapEntry entry;
+    entry.deadline = deadline;
+    entry.control = control;
+    queue->heapCount++;
+    queue->heap[queue->heapCount - 1] = entry;
+    siftUp(queue, queue->heapCount - 1);
+  }
+}
+
+// Works out when an event that was set before its array was first seen is
+// due, from its status and 16-bit time.
+static int32u eventDeadline(EmberEventControl *control, int32u nowMS32)
+{
+  int8u shift;
+  int32u now;
+  switch (control->status) {
+  case EMBER_EVENT_MS_TIME:
+    shift = 0;
+    break;
+  case EMBER_EVENT_QS_TIME:
+    shift = 8;
+    break;
+  case EMBER_EVENT_MINUTE_TIME:
+    shift = 16;
+    break;
+  default:
+    return nowMS32;
+  }
+  now = nowMS32 >> shift;
+  return (now + (int16s)(control->timeToExecute - (int16u)now)) << shift;
+}
+
+// Returns the queue for an array of events, creating it the first time.
+static EventQueue *findQueue(EmberEventData *events)
+{
+  EventQueue *queue;
+  int32u nowMS32;
+  int16u count;
+  int8u i;
+
+  for (i = 0; i < queueCount; i++) {
+    if (queues[i].events == events) {
+      return &queues[i];
+    }
+  }
+
+  assert(queueCount < EMBER_EVENT_QUEUE_COUNT);
+  queue = &queues[queueCount++];
+  for (count = 0; events[count].control != NULL; count++) {
+  }
+  queue->events = events;
+  queue->heapCount = 0;
+  queue->heap = (HeapEntry *)malloc((count + 1) * sizeof(HeapEntry));
+  queue->due = (EmberEventControl **)malloc((count + 1)
+                                            * sizeof(EmberEventControl *));
+  assert(queue->heap != NULL && queue->due != NULL);
+
+  nowMS32 = halCommonGetInt32uMillisecondTick();
+  for (count = 0; events[count].control != NULL; count++) {
+    EmberEventControl *control = events[count].control;
+    control->queue = queueCount;
+    control->eventIndex = count;
+    control->heapIndex = 0;
+    if (control->status != EMBER_EVENT_INACTIVE) {
+      scheduleEvent(control, eventDeadline(control, nowMS32));
+    }
+  }
+  return queue;
+}
 
 void emEventControlSetActive(EmberEventControl *event)
 {
   event->status = EMBER_EVENT_ZERO_DELAY;
+  scheduleEvent(event, halCommonGetInt32uMillisecondTick());
 }
 
 void emEventControlSetDelayMS(EmberEventControl*event, int16u delay)
 {
-  event->timeToExecute = halCommonGetInt16uMillisecondTick() + delay;
+  int32u nowMS32 = halCommonGetInt32uMillisecondTick();
+  event->timeToExecute = (int16u)nowMS32 + delay;
   event->status = EMBER_EVENT_MS_TIME;
+  scheduleEvent(event, nowMS32 + delay);
 }
 
 void emEventControlSetDelayQS(EmberEventControl*event, int16u delay)
 {
-  event->timeToExecute = halCommonGetInt16uQuarterSecondTick() + delay;
+  int32u nowQS = halCommonGetInt32uMillisecondTick() >> 8;
+  event->timeToExecute = (int16u)nowQS + delay;
   event->status = EMBER_EVENT_QS_TIME;
+  scheduleEvent(event, (nowQS + delay) << 8);
 }
 
 void emEventControlSetDelayMinutes(EmberEventControl*event, int16u delay)
 {
-  event->timeToExecute =
-    ((int16u) (halCommonGetInt32uMillisecondTick() >> 16)) + delay;
+  int32u nowMinutes = halCommonGetInt32uMillisecondTick() >> 16;
+  event->timeToExecute = (int16u)nowMinutes + delay;
   event->status = EMBER_EVENT_MINUTE_TIME;
+  scheduleEvent(event, (nowMinutes + delay) << 16);
 }
 
 void emberRunTask(EmberTaskId taskid)
@@ -45,80 +233,71 @@ void emberRunTask(EmberTaskId taskid)
   emberRunEvents(task->events);
 }
 
+// Every due event is taken out of the heap before any handler is called, so
+// that each runs at most once per call, as with a scan of the array.  A
+// handler that leaves its event active without setting it again runs again
+// on the next call.  Due events run in the order they became due.
 void emberRunEvents(EmberEventData *events)
 {
-  int16u times[4];
-  EmberEventData *nextEvent;
+  EventQueue *queue = findQueue(events);
   int32u nowMS32 = halCommonGetInt32uMillisecondTick();
+  int16u dueCount = 0;
+  int16u i;
 
-  times[EMBER_EVENT_MS_TIME]     = (int16u) nowMS32;
-  times[EMBER_EVENT_QS_TIME]     = (int16u) (nowMS32 >> 8);
-  times[EMBER_EVENT_MINUTE_TIME] = (int16u) (nowMS32 >> 16);
+  while (queue->heapCount > 0
+         && !isEarlier(nowMS32, queue->heap[0].deadline)) {
+    EmberEventControl *control = queue->heap[0].control;
+    heapRemove(queue, 0);
+    if (control->status != EMBER_EVENT_INACTIVE) {
+      queue->due[dueCount++] = control;
+    }
+  }
 
-  for (nextEvent = events; ; nextEvent++) {
-    EmberEventControl *control = nextEvent->control;
-    if (control == NULL)
-      break;
-    if (control->status == EMBER_EVENT_ZERO_DELAY
-        || (control->status != EMBER_EVENT_INACTIVE
-            && (elapsedTimeInt16u(control->timeToExecute, 
-                                  times[control->status]) <=
-                (((int32u)MAX_INT16U_VALUE + 1) / 2)))) 
-    {
-      ((void (*)(EmberEventControl *))(nextEvent->handler))(control);
+  for (i = 0; i < dueCount; i++) {
+    EmberEventControl *control = queue->due[i];
+    // An earlier handler may have cancelled or rescheduled this event.
+    if (control->status == EMBER_EVENT_INACTIVE
+        || control->heapIndex != 0) {
+      continue;
+    }
+    ((void (*)(EmberEventControl *))(events[control->eventIndex].handler))(control);
+    if (control->status != EMBER_EVENT_INACTIVE
+        && control->heapIndex == 0) {
+      scheduleEvent(control, nowMS32);
     }
   }
 }
 
 int32u emberMsToNextEventExtended(EmberEventData *events, int32u maxTime, int8u* returnIndex)
 {
-  int16u times[4];
-  EmberEventData *nextEvent;
-  int32u time = maxTime;
+  EventQueue *queue = findQueue(events);
   int32u nowMS32 = halCommonGetInt32uMillisecondTick();
-  int8u index = 0;
+  int32u waitTime;
+  EmberEventControl *control;
+
   if (returnIndex != NULL) {
     *returnIndex = 0xFF;
   }
-  
-  times[EMBER_EVENT_MS_TIME]     = (int16u) nowMS32;
-  times[EMBER_EVENT_QS_TIME]     = (int16u) (nowMS32 >> 8);
-  times[EMBER_EVENT_MINUTE_TIME] = (int16u) (nowMS32 >> 16);
-
-  for (nextEvent = events; ; nextEvent++) {
-    EmberEventControl *control = nextEvent->control;
-    int8u eventStatus;
-    int16u eventTime;
-    int32u waitTime;
-
-    if (control == NULL
-        || time == 0)
-      break;
 
-    eventStatus = control->status;
-    if (eventStatus != EMBER_EVENT_INACTIVE) {
-      eventTime = control->timeToExecute;
-      waitTime = elapsedTimeInt16u(times[eventStatus], eventTime);
-      if (control->status == EMBER_EVENT_ZERO_DELAY
-          || timeGTorEqualInt16u(times[eventStatus], eventTime)) {
-        waitTime = 0;
-      } else if (eventStatus == EMBER_EVENT_QS_TIME) {
-        waitTime = ((waitTime << 8)
-                    - (times[EMBER_EVENT_MS_TIME] & 0xFF));
-      } else if (eventStatus == EMBER_EVENT_MINUTE_TIME) {
-        waitTime = ((waitTime << 16)
-                    - times[EMBER_EVENT_MS_TIME]);
-      }
-      if (waitTime < time) {
-        time = waitTime;
-        if (returnIndex != NULL) {
-          *returnIndex = index;
-        }
-      }
+  while (queue->heapCount > 0
+         && queue->heap[0].control->status == EMBER_EVENT_INACTIVE) {
+    heapRemove(queue, 0);
+  }
+  if (queue->heapCount == 0) {
+    return maxTime;
+  }
+
+  control = queue->heap[0].control;
+  waitTime = (isEarlier(nowMS32, queue->heap[0].deadline)
+              ? queue->heap[0].deadline - nowMS32
+              : 0);
+  if (waitTime < maxTime) {
+    maxTime = waitTime;
+    if (returnIndex != NULL) {
+      *returnIndex = control->eventIndex;
     }
-    index++;
   }
-  return time;
+  return maxTime;
 }
 
 int32u emberMsToNextEvent(EmberEventData *events, int32u maxMs)
@@ -141,6 +320,7 @@ EmberTaskId emberTaskInit(EmberEventData *events)
   
   task = &(emTasks[id]);
   task->events = events;
+  (void)findQueue(events);
   
   return id;
 }
@@ -264,14 +264,32 @@ EmberStatus emberAfSendUnicastToBindings(EmberApsFrame *apsFrame,
                                          int8u* message)
 {
   EmberStatus status = EMBER_INVALID_BINDING_INDEX;
+  EmberBindingTableEntry binding;
   int8u i;
 
+#ifdef EZSP_HOST
+  // The host's copy of the binding table finds the bindings for the endpoint
+  // and cluster without reading the table from the NCP.  As with a scan of
+  // the table, finding none is not an error.
+  if (EMBER_BINDING_TABLE_SIZE != 0) {
+    status = EMBER_SUCCESS;
+  }
+  for (i = ezspFindBinding(0xFF,
+                           apsFrame->sourceEndpoint,
+                           apsFrame->clusterId,
+                           &binding);
+       i != 0xFF;
+       i = ezspFindBinding(i,
+                           apsFrame->sourceEndpoint,
+                           apsFrame->clusterId,
+                           &binding)) {
+#else
   for (i = 0; i < EMBER_BINDING_TABLE_SIZE; i++) {
-    EmberBindingTableEntry binding;
     status = emberGetBinding(i, &binding);
     if (status != EMBER_SUCCESS) {
       return status;
     }
+#endif
     if (binding.type == EMBER_UNICAST_BINDING
         && binding.local == apsFrame->sourceEndpoint
         && binding.clusterId == apsFrame->clusterId) {
@@ -154,7 +154,7 @@ static int8u emActiveTaskCount = 0;
   #error EMBER_AF_BAUD_RATE set to an invalid baud rate
 #endif
 
-#define MAX_CLUSTER 58
+#define MAX_CLUSTER EMBER_AF_NCP_ENDPOINT_MAX_CLUSTER
 
 // We only get the sender EUI callback when the sender EUI is in the incoming
 // message. This keeps track of if the value in the variable is valid or not.
@@ -448,10 +448,19 @@ void emAfResetAndInitNCP(void)
   emberAfNcpInitCallback(memoryAllocation);
 
   // create endpoints
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+  emAfClearNcpEndpoints();
+#endif
   for ( ep = 0; ep < emberAfEndpointCount(); ep++ ) {
     createEndpoint(emberAfEndpointFromIndex(ep));
   }
 
+  // the NCP has restored its binding table, so refresh the host's copy
+  ezspBindingMirrorLoad();
+
+  // the host's copies of the other stack tables are out of date
+  ezspTableMirrorInvalidate(EZSP_ALL_TABLE_MIRRORS);
+
   // network init if possible - the node type this device was previously
   // needs to match or the device can be a ZC and joined a network as a ZR.
   {
@@ -547,8 +556,10 @@ int main( MAIN_FUNCTION_PARAMETERS )
     }
 
     // Wait until ECC operations are done.  Don't allow any of the clusters
-    // to send messages as the NCP is busy doing ECC
+    // to send messages as the NCP is busy doing ECC.  Sleep on the serial
+    // port in the meantime rather than spinning through the loop.
     if (emAfIsCryptoOperationInProgress()) {
+      ezspWaitForNcp(emAfCryptoOperationMsToTimeout());
       continue;
     }
 
@@ -769,6 +780,11 @@ static EzspStatus createEndpoint(int8u endpoint)
   if (status != EZSP_SUCCESS) {
     emberAfAppPrintln("Error in creating endpoint %d: 0x%x", endpoint, status);
   } else {
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+    if (emAfIsDynamicEndpoint(endpoint)) {
+      emAfNcpEndpointCreated(endpoint);
+    }
+#endif
     emberAfAppPrintln("Ezsp Endpoint %d added, profile 0x%2x, in clusters: %d, out clusters %d",
                       endpoint,
                       emberAfProfileIdFromIndex(endpointIndex),
@@ -780,6 +796,71 @@ static EzspStatus createEndpoint(int8u endpoint)
   return status;
 }
 
+#if EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+// The NCP has no way to remove an endpoint, so a removed endpoint is only
+// disabled there.  If it is added again it is enabled, but only if its
+// profile, device and clusters are those the NCP already has.  Otherwise it
+// cannot be added until the NCP is reset.  Endpoints are created on the NCP
+// each time it is reset and initialized, so there is nothing more to do if
+// that is pending.
+EmberStatus emberAfAddDynamicEndpoint(int8u endpoint,
+                                      EmberAfEndpointType *endpointType,
+                                      EmberAfProfileId profileId,
+                                      int16u deviceId,
+                                      int8u deviceVersion,
+                                      int8u networkIndex)
+{
+  boolean onNcp;
+  EmberStatus status = emAfAddDynamicEndpoint(endpoint,
+                                              endpointType,
+                                              profileId,
+                                              deviceId,
+                                              deviceVersion,
+                                              networkIndex);
+  if (status != EMBER_SUCCESS || ncpNeedsResetAndInit) {
+    return status;
+  }
+
+  status = emAfCheckNcpEndpoint(endpoint, &onNcp);
+  if (status == EMBER_SUCCESS) {
+    if (onNcp) {
+      ezspEnableEndpoint(endpoint);
+    } else if (createEndpoint(endpoint) != EZSP_SUCCESS) {
+      status = EMBER_ERR_FATAL;
+    }
+  }
+  if (status != EMBER_SUCCESS) {
+    emberAfRemoveDynamicEndpoint(endpoint);
+  }
+  return status;
+}
+
+// The scenes, groups, reports and bindings of a removed endpoint would
+// otherwise apply to the next endpoint added with the same number, so they
+// are cleared while the endpoint still exists.
+EmberStatus emberAfRemoveDynamicEndpoint(int8u endpoint)
+{
+  int8u i;
+
+  if (!emAfIsDynamicEndpoint(endpoint)) {
+    return EMBER_INVALID_ENDPOINT;
+  }
+
+  emberAfScenesClusterClearSceneTableCallback(endpoint);
+  emberAfGroupsClusterClearGroupTableCallback(endpoint);
+  emberAfClearEndpointReportTableCallback(endpoint);
+  for (i = 0; i < EMBER_BINDING_TABLE_SIZE; i++) {
+    EmberBindingTableEntry binding;
+    if (emberGetBinding(i, &binding) == EMBER_SUCCESS
+        && binding.type != EMBER_UNUSED_BINDING
+        && binding.local == endpoint) {
+      emberDeleteBinding(i);
+    }
+  }
+  return emAfRemoveDynamicEndpoint(endpoint);
+}
+#endif // EMBER_AF_MAX_DYNAMIC_ENDPOINT_COUNT > 0
+
 
 // *******************************************************************
 // Handlers required to use the Ember Stack.
@@ -824,8 +905,9 @@ EmberStatus emberGetSenderEui64(EmberEUI64 senderEui64)
     MEMCOPY(senderEui64, currentSenderEui64, EUI64_SIZE);
     return EMBER_SUCCESS;
   }
-  // in the not valid case just return error
-  return EMBER_ERR_FATAL;
+  // otherwise the sender may be known from an earlier message, without
+  // asking the NCP
+  return ezspAddressCacheLookupEui64(currentSender, senderEui64);
 }
 
 //
@@ -11,6 +11,7 @@
 #define ZCL_UTIL_ATTRIBUTE_TABLE_H
 
 #include "../include/af.h"
+#include "attribute-storage.h"
 
 #define ZCL_NULL_ATTRIBUTE_TABLE_INDEX 0xFFFF
 
@@ -57,6 +58,15 @@ EmberAfStatus emAfWriteAttribute(int8u endpoint,
                                  boolean overrideReadOnlyAndDataType,
                                  boolean justTest);
 
+// As emAfWriteAttribute(), for an attribute already located with
+// emAfLocateAttribute().
+EmberAfStatus emAfWriteLocatedAttribute(EmberAfAttributeSearchRecord *record,
+                                        const EmAfAttributeLocation *location,
+                                        int8u *data,
+                                        EmberAfAttributeType dataType,
+                                        boolean overrideReadOnlyAndDataType,
+                                        boolean justTest);
+
 EmberAfStatus emAfReadAttribute(int8u endpoint,
                                 EmberAfClusterId cluster,
                                 EmberAfAttributeId attributeID,
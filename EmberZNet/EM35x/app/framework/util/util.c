@@ -35,7 +35,7 @@ static void platformTick(void);
 // Globals
 
 // Storage and functions for turning on and off devices
-boolean afDeviceEnabled[MAX_ENDPOINT_COUNT];
+boolean afDeviceEnabled[EMBER_AF_ENDPOINT_TABLE_SIZE];
 
 #ifdef EMBER_AF_ENABLE_STATISTICS
 // a variable containing the number of messages send from the utilities
@@ -805,7 +805,7 @@ int8u emberAfMaximumApsPayloadLength(EmberOutgoingMessageType type,
 
 #if !defined(ZA_NO_SOURCE_ROUTING) && !defined(EMBER_AF_PLUGIN_CONCENTRATOR_NCP_SUPPORT)
   if (destination != EMBER_UNKNOWN_NODE_ID) {
-    int8u index = sourceRouteFindIndex(destination);
+    SourceRouteIndex index = sourceRouteFindIndex(destination);
     if (index != NULL_INDEX) {
       max -= EMBER_AF_NWK_SOURCE_ROUTE_OVERHEAD;
       while (sourceRouteTable[index].closerIndex != NULL_INDEX) {
@@ -928,46 +928,68 @@ int32u emberAfGetCurrentTime(void)
 #endif
 }
 
+// The generated endpoint event controls only cover the endpoints configured
+// at startup, so there are none for dynamic endpoints.
+static EmberEventControl *endpointEventControl(EmberEventControl *controls,
+                                               int8u endpoint)
+{
+  int8u index = emAfStaticIndexFromEndpoint(endpoint);
+  return (index == 0xFF ? NULL : controls + index);
+}
+
 void emberAfEndpointEventControlSetInactive(EmberEventControl *controls, int8u endpoint)
 {
-  EmberEventControl *control = controls + emberAfIndexFromEndpoint(endpoint);
-  emberEventControlSetInactive(*control);
+  EmberEventControl *control = endpointEventControl(controls, endpoint);
+  if (control != NULL) {
+    emberEventControlSetInactive(*control);
+  }
 }
 
 boolean emberAfEndpointEventControlGetActive(EmberEventControl *controls, int8u endpoint)
 {
-  EmberEventControl *control = controls + emberAfIndexFromEndpoint(endpoint);
-  return emberEventControlGetActive(*control);
+  EmberEventControl *control = endpointEventControl(controls, endpoint);
+  return (control != NULL && emberEventControlGetActive(*control));
 }
 
 void emberAfEndpointEventControlSetActive(EmberEventControl *controls, int8u endpoint)
 {
-  EmberEventControl *control = controls + emberAfIndexFromEndpoint(endpoint);
-  emberEventControlSetActive(*control);
+  EmberEventControl *control = endpointEventControl(controls, endpoint);
+  if (control != NULL) {
+    emberEventControlSetActive(*control);
+  }
 }
 
 EmberStatus emberAfEndpointEventControlSetDelay(EmberEventControl *controls, int8u endpoint, int32u timeMs)
 {
-  EmberEventControl *control = controls + emberAfIndexFromEndpoint(endpoint);
+  EmberEventControl *control = endpointEventControl(controls, endpoint);
+  if (control == NULL) {
+    return EMBER_INVALID_ENDPOINT;
+  }
   return emberAfEventControlSetDelay(control, timeMs);
 }
 
 void emberAfEndpointEventControlSetDelayMS(EmberEventControl *controls, int8u endpoint, int16u delay)
 {
-  EmberEventControl *control = controls + emberAfIndexFromEndpoint(endpoint);
-  emberEventControlSetDelayMS(*control, delay);
+  EmberEventControl *control = endpointEventControl(controls, endpoint);
+  if (control != NULL) {
+    emberEventControlSetDelayMS(*control, delay);
+  }
 }
 
 void emberAfEndpointEventControlSetDelayQS(EmberEventControl *controls, int8u endpoint, int16u delay)
 {
-  EmberEventControl *control = controls + emberAfIndexFromEndpoint(endpoint);
-  emberEventControlSetDelayQS(*control, delay);
+  EmberEventControl *control = endpointEventControl(controls, endpoint);
+  if (control != NULL) {
+    emberEventControlSetDelayQS(*control, delay);
+  }
 }
 
 void emberAfEndpointEventControlSetDelayMinutes(EmberEventControl *controls, int8u endpoint, int16u delay)
 {
-  EmberEventControl *control = controls + emberAfIndexFromEndpoint(endpoint);
-  emberEventControlSetDelayMinutes(*control, delay);
+  EmberEventControl *control = endpointEventControl(controls, endpoint);
+  if (control != NULL) {
+    emberEventControlSetDelayMinutes(*control, delay);
+  }
 }
 
 // *******************************************************
@@ -21,9 +21,10 @@
 void printNeighborTable(int8u serialPort)
 {
   EmberNeighborTableEntry n;
+  int8u count = emberNeighborCount();
   int8u i;
 
-  for (i = 0; i < emberNeighborCount(); i++) {
+  for (i = 0; i < count; i++) {
     emberGetNeighbor(i, &n);
     emberSerialPrintf(serialPort, 
             "id:%2X lqi:%d in:%d out:%d age:%d eui:(>)%X%X%X%X%X%X%X%X\r\n",
@@ -37,7 +38,7 @@ void printNeighborTable(int8u serialPort)
     emberSerialWaitSend(serialPort);
     emberSerialBufferTick();
   }
-  if (emberNeighborCount() == 0) {
+  if (count == 0) {
     emberSerialPrintf(serialPort, "empty neighbor table\r\n");
   }
 }
@@ -9,22 +9,40 @@
 #ifndef __SOURCE_ROUTE_COMMON_H__
 #define __SOURCE_ROUTE_COMMON_H__
 
+// Hosts may have much larger tables than nodes, so they use two-byte indexes.
+#ifdef EZSP_HOST
+  typedef int16u SourceRouteIndex;
+#else
+  typedef int8u SourceRouteIndex;
+#endif
+
+// Each destination has one entry, which points to the entry for the next relay
+// towards the gateway, so the entries for relays are shared by every route that
+// uses them.  The entries are also kept in a doubly-linked list from the most
+// to the least recently added, and in chains by a hash of the destination.
+// The table serves as the array of hash buckets as well: hashHead in the
+// entry at index i is the first entry whose destination hashes to i.
 typedef struct {
   EmberNodeId destination;
-  int8u closerIndex;          // The entry one hop closer to the gateway.
-  int8u olderIndex;           // The entry touched before this one.
+  SourceRouteIndex closerIndex;   // The entry one hop closer to the gateway.
+  SourceRouteIndex olderIndex;    // The entry touched before this one.
+  SourceRouteIndex newerIndex;    // The entry touched after this one.
+  SourceRouteIndex hashHead;      // The first entry in this bucket.
+  SourceRouteIndex hashNext;      // The next entry in this entry's bucket.
 } SourceRouteTableEntry;
 
-extern int8u sourceRouteTableSize;
+extern SourceRouteIndex sourceRouteTableSize;
 extern SourceRouteTableEntry *sourceRouteTable;
 
 // A special index. For destinations that are neighbors of the gateway,
-// closerIndex is set to 0xFF. For the oldest entry, olderIndex is set to
-// 0xFF.
-#define NULL_INDEX 0xFF
+// closerIndex is set to NULL_INDEX. For the oldest entry, olderIndex is set
+// to NULL_INDEX, and for the newest, newerIndex is.  It also ends the hash
+// chains.
+#define NULL_INDEX ((SourceRouteIndex) -1)
 
-int8u sourceRouteFindIndex(EmberNodeId id);
-int8u sourceRouteAddEntry(EmberNodeId id, int8u furtherIndex);
+SourceRouteIndex sourceRouteFindIndex(EmberNodeId id);
+SourceRouteIndex sourceRouteAddEntry(EmberNodeId id,
+                                     SourceRouteIndex furtherIndex);
 void sourceRouteInit(void);
 
 #endif // __SOURCE_ROUTE_COMMON_H__
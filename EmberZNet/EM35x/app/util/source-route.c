@@ -37,7 +37,7 @@
 
 #ifndef EXTERNAL_TABLE
 static SourceRouteTableEntry table[EMBER_SOURCE_ROUTE_TABLE_SIZE];
-int8u sourceRouteTableSize = EMBER_SOURCE_ROUTE_TABLE_SIZE;
+SourceRouteIndex sourceRouteTableSize = EMBER_SOURCE_ROUTE_TABLE_SIZE;
 SourceRouteTableEntry *sourceRouteTable = table;
 #endif
 
@@ -48,7 +48,7 @@ void emberIncomingRouteRecordHandler(EmberNodeId source,
                                      EmberMessageBuffer header,
                                      int8u relayListIndex)
 {
-  int8u previous;
+  SourceRouteIndex previous;
   int8u i;
 
   // If the following message has APS Encryption, our node will need to know
@@ -80,11 +80,11 @@ void emberIncomingRouteRecordHandler(EmberNodeId source,
 int8u emberAppendSourceRouteHandler(EmberNodeId destination,
                                     EmberMessageBuffer header)
 {
-  int8u foundIndex = sourceRouteFindIndex(destination);
+  SourceRouteIndex foundIndex = sourceRouteFindIndex(destination);
   int8u relayCount = 0;
   int8u addedBytes;
   int8u bufferLength = emberMessageBufferLength(header);
-  int8u i;
+  SourceRouteIndex i;
 
   if (foundIndex == NULL_INDEX) {
     return 0;
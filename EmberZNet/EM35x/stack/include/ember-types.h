@@ -1183,6 +1183,14 @@ typedef int8u EmberTaskId;
      *  Units are determined by the event status. 
      */
     int16u timeToExecute;
+    /** The following are used by the host's event scheduler: the event's
+     *  queue (one more than its index; 0 before it is known), its index in
+     *  the array of ::EmberEventData, and its position in the queue's heap
+     *  (again one more than the index; 0 when not in the heap).
+     */
+    int8u queue;
+    int16u eventIndex;
+    int16u heapIndex;
   } EmberEventControl;
 #endif
 